@@ -20,7 +20,9 @@
 #include <linux/devfreq.h>
 #include <linux/devfreq-event.h>
 #include <linux/input.h>
+#include <linux/iopoll.h>
 #include <linux/jiffies.h>
+#include <linux/mfd/syscon.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/of.h>
@@ -28,13 +30,68 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/pm_opp.h>
+#include <linux/regmap.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/suspend.h>
 #include <linux/time.h>
+#include <../drivers/devfreq/governor.h>
 #include "../crashdump/sunxi-crashdump.h"
 
 #define DRIVER_NAME	"devfreq Driver"
 #define DEVFREQ_EN 0x4
 
+/* nsi probe counters, same layout as the RA1 probe used by sunxi-nsipmu */
+#define NSI_PROBE_PE		0x00
+#define NSI_PROBE_PC		0x04
+#define NSI_PROBE_PP		0x08
+#define NSI_PROBE_DR		0x14
+#define NSI_PROBE_DW		0x18
+
+#define PERIOD			100	/* ms, counter period of the nsi probes */
+#define SECOND			1000	/* ms(const) */
+
+#define SUNXI_DMC_MAX_FREQ	4
+#define SUNXI_DMC_MAX_MASTERS	4
+#define SUNXI_DMC_POLL_US	20
+#define SUNXI_DMC_TIMEOUT_US	400000
+
+#define SUNXI_BW_UPTHRESHOLD		70
+#define SUNXI_BW_LATENCY_UPTHRESHOLD	50
+#define SUNXI_BW_LATENCY_ACTIVE		(1 << 20)	/* bytes per PERIOD */
+#define SUNXI_BW_DOWN_SAMPLES		3
+
+/* one PERIOD worth of traffic, in bytes */
+struct sunxi_dmc_bw_sample {
+	u64 total;
+	u64 latency;
+};
+
+struct sunxi_dmc_bw_state {
+	unsigned long freq;
+	unsigned int down_cnt;
+};
+
+struct sunxi_dmc_stats {
+	u64 trans;
+	u64 fail;
+	u64 lat_total_ns;
+	u64 lat_max_ns;
+	u64 residency_ns[SUNXI_DMC_MAX_FREQ];
+	ktime_t last;
+};
+
+/* result of replaying a recorded bandwidth trace through the governor */
+struct sunxi_dmc_replay {
+	struct sunxi_dmc_bw_state state;
+	u64 samples;
+	u64 up;
+	u64 down;
+	/* samples spent below the frequency the traffic asked for */
+	u64 short_samples;
+	u64 residency[SUNXI_DMC_MAX_FREQ];
+};
+
 struct sunxi_dmcfreq {
 	struct device *dev;
 	struct devfreq *devfreq;
@@ -52,6 +109,24 @@ struct sunxi_dmcfreq {
 	struct timer_list boost_timer;
 
 	unsigned long rate, target_rate;
+
+	/* ascending, as added by sunxi_adjust_freq() */
+	unsigned long freq_table[SUNXI_DMC_MAX_FREQ];
+	unsigned int nr_freq;
+	u32 trans_timeout_us;
+	struct sunxi_dmc_stats stats;
+
+	/* sunxi_bw governor */
+	struct regmap *nsi_regmap;
+	u32 masters[SUNXI_DMC_MAX_MASTERS];
+	unsigned int nr_masters;
+	u32 bw_upthreshold;
+	u32 latency_upthreshold;
+	u32 latency_active;
+	u32 latency_min_freq;
+	u32 down_samples;
+	struct sunxi_dmc_bw_state bw_state;
+	struct sunxi_dmc_replay replay;
 };
 
 static const struct input_device_id sunxi_dmcfreq_input_ids[] = {
@@ -176,6 +251,103 @@ static void sunxi_dmcfreq_boost_init(struct sunxi_dmcfreq *dmcfreq)
 		sunxi_err(dmcfreq->dev, "failed to register input handler\n");
 }
 
+/*
+ * Per master nsi probes (display, VIN, ...), listed in "latency-masters" by
+ * the offset of their PE register in the nsi syscon.
+ */
+static void sunxi_dmc_masters_start(struct sunxi_dmcfreq *dmcfreq)
+{
+	unsigned int i, val;
+
+	if (!dmcfreq->nsi_regmap)
+		return;
+
+	/* Automatically updated every PERIOD */
+	val = ((clk_get_rate(dmcfreq->dmc_clk) >> 1) / SECOND) * PERIOD;
+	for (i = 0; i < dmcfreq->nr_masters; i++) {
+		regmap_write(dmcfreq->nsi_regmap, dmcfreq->masters[i] + NSI_PROBE_PP, val);
+		regmap_update_bits(dmcfreq->nsi_regmap, dmcfreq->masters[i] + NSI_PROBE_PE, BIT(0), -1U);
+	}
+}
+
+static void sunxi_dmc_masters_stop(struct sunxi_dmcfreq *dmcfreq)
+{
+	unsigned int i;
+
+	if (!dmcfreq->nsi_regmap)
+		return;
+
+	for (i = 0; i < dmcfreq->nr_masters; i++) {
+		regmap_update_bits(dmcfreq->nsi_regmap, dmcfreq->masters[i] + NSI_PROBE_PE, BIT(0), 0);
+		regmap_update_bits(dmcfreq->nsi_regmap, dmcfreq->masters[i] + NSI_PROBE_PC, BIT(0), -1U);
+		udelay(1);
+		regmap_update_bits(dmcfreq->nsi_regmap, dmcfreq->masters[i] + NSI_PROBE_PC, BIT(0), 0);
+	}
+}
+
+/* bytes moved by the latency sensitive masters in the last PERIOD */
+static u64 sunxi_dmc_masters_read(struct sunxi_dmcfreq *dmcfreq)
+{
+	unsigned int i, read_data, write_data;
+	u64 bytes = 0;
+
+	if (!dmcfreq->nsi_regmap)
+		return 0;
+
+	for (i = 0; i < dmcfreq->nr_masters; i++) {
+		regmap_read(dmcfreq->nsi_regmap, dmcfreq->masters[i] + NSI_PROBE_DR, &read_data);
+		regmap_read(dmcfreq->nsi_regmap, dmcfreq->masters[i] + NSI_PROBE_DW, &write_data);
+		bytes += (u64)read_data + write_data;
+	}
+
+	return bytes;
+}
+
+static int sunxi_dmc_freq_index(struct sunxi_dmcfreq *dmcfreq, unsigned long freq)
+{
+	unsigned int i;
+
+	for (i = 0; i < dmcfreq->nr_freq; i++) {
+		if (dmcfreq->freq_table[i] / 1000000 == freq / 1000000)
+			return i;
+	}
+
+	return -1;
+}
+
+/* called with dmcfreq->lock held */
+static void sunxi_dmc_stats_residency(struct sunxi_dmcfreq *dmcfreq, unsigned long rate)
+{
+	struct sunxi_dmc_stats *stats = &dmcfreq->stats;
+	ktime_t now = ktime_get();
+	int idx = sunxi_dmc_freq_index(dmcfreq, rate);
+
+	if (idx >= 0)
+		stats->residency_ns[idx] += ktime_to_ns(ktime_sub(now, stats->last));
+	stats->last = now;
+}
+
+/* called with dmcfreq->lock held */
+static void sunxi_dmc_stats_trans(struct sunxi_dmcfreq *dmcfreq, unsigned long old_rate,
+				  ktime_t start, int rc)
+{
+	struct sunxi_dmc_stats *stats = &dmcfreq->stats;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	/* the time spent switching is accounted to the old rate */
+	sunxi_dmc_stats_residency(dmcfreq, old_rate);
+
+	if (rc) {
+		stats->fail++;
+		return;
+	}
+
+	stats->trans++;
+	stats->lat_total_ns += ns;
+	if (ns > stats->lat_max_ns)
+		stats->lat_max_ns = ns;
+}
+
 static int sunxi_dmc_target(struct device *dev,
 						unsigned long *freq, u32 flags)
 {
@@ -184,7 +356,6 @@ static int sunxi_dmc_target(struct device *dev,
 	unsigned long last_rate_tmp;
 	struct dev_pm_opp *opp;
 	int rc = 0;
-	unsigned int timeout;
 	u64 start_time;
 	u64 end_time;
 
@@ -213,23 +384,25 @@ static int sunxi_dmc_target(struct device *dev,
 	if (rc)
 		goto out;
 
-	timeout = 200;
-	while ((dmcfreq->rate = clk_get_rate(dmcfreq->dmc_clk)) != target_rate) {
-		if (!timeout) {
-			sunxi_err(dev, "change dram clock error!\n");
-			rc = -ETIMEDOUT;
-			goto out;
-		}
-
-		timeout--;
-		cpu_relax();
-		msleep(2);
+	/*
+	 * The switch usually lands well below a millisecond, poll with a short
+	 * sleep so that neither the devfreq lock nor the governor is held for
+	 * longer than the transition itself.
+	 */
+	rc = read_poll_timeout(clk_get_rate, dmcfreq->rate, dmcfreq->rate == target_rate,
+			       SUNXI_DMC_POLL_US, dmcfreq->trans_timeout_us, false,
+			       dmcfreq->dmc_clk);
+	if (rc) {
+		sunxi_err(dev, "change dram clock error!\n");
+		goto out;
 	}
 
 	devfreq_event_disable_edev(dmcfreq->edev);
 	devfreq_event_enable_edev(dmcfreq->edev);
+	sunxi_dmc_masters_start(dmcfreq);
 
 out:
+	sunxi_dmc_stats_trans(dmcfreq, last_rate_tmp, start_time, rc);
 	mutex_unlock(&dmcfreq->lock);
 	end_time = ktime_get();
 	sunxi_get_freq_info(dev, NULL, start_time, end_time, last_rate_tmp, target_rate);
@@ -263,8 +436,16 @@ static int sunxi_dmcfreq_get_cur_freq(struct device *dev, unsigned long *freq)
 	return 0;
 }
 
-static void sunxi_adjust_freq(struct device *dev, unsigned long freq, unsigned int dram_div)
+static int sunxi_dmc_freq_cmp(const void *a, const void *b)
 {
+	unsigned long fa = *(const unsigned long *)a, fb = *(const unsigned long *)b;
+
+	return fa < fb ? -1 : fa > fb;
+}
+
+static void sunxi_adjust_freq(struct sunxi_dmcfreq *dmcfreq, unsigned long freq, unsigned int dram_div)
+{
+	struct device *dev = dmcfreq->dev;
 	unsigned long freq0 = (freq << 2) / (((dram_div >> 24) & 0x1f) + 1);
 	unsigned long freq1 = (freq << 2) / (((dram_div >> 16) & 0x1f) + 1);
 	unsigned long freq2 = (freq << 2) / (((dram_div >> 8) & 0x1f) + 1);
@@ -275,6 +456,13 @@ static void sunxi_adjust_freq(struct device *dev, unsigned long freq, unsigned i
 	dev_pm_opp_add(dev, freq1, 0);
 	dev_pm_opp_add(dev, freq2, 0);
 	dev_pm_opp_add(dev, freq3, 0);
+
+	dmcfreq->freq_table[0] = freq0;
+	dmcfreq->freq_table[1] = freq1;
+	dmcfreq->freq_table[2] = freq2;
+	dmcfreq->freq_table[3] = freq3;
+	dmcfreq->nr_freq = SUNXI_DMC_MAX_FREQ;
+	sort(dmcfreq->freq_table, dmcfreq->nr_freq, sizeof(unsigned long), sunxi_dmc_freq_cmp, NULL);
 }
 
 static struct devfreq_dev_profile sunxi_dmcfreq_profile = {
@@ -284,6 +472,243 @@ static struct devfreq_dev_profile sunxi_dmcfreq_profile = {
 	.get_cur_freq   = sunxi_dmcfreq_get_cur_freq,
 };
 
+/*
+ * The dram moves dram_clk * 8 bytes per second at full utilisation (see
+ * sunxi-nsipmu). Ask for the rate that keeps the measured traffic below the
+ * up threshold; while a latency sensitive master is moving data use the
+ * lower latency threshold and the latency-min-freq floor, so that display
+ * and VIN keep their headroom.
+ */
+static unsigned long sunxi_dmc_bw_need(struct sunxi_dmcfreq *dmcfreq,
+				       const struct sunxi_dmc_bw_sample *sample)
+{
+	bool latency = sample->latency >= dmcfreq->latency_active;
+	u32 up = latency ? dmcfreq->latency_upthreshold : dmcfreq->bw_upthreshold;
+	u64 need;
+
+	need = div_u64(sample->total * (SECOND / PERIOD) * 100, 8 * up);
+	if (latency)
+		need = max_t(u64, need, dmcfreq->latency_min_freq);
+
+	return (unsigned long)min_t(u64, need, ULONG_MAX);
+}
+
+/*
+ * Lowest OPP covering @need. Going up is immediate, going down only after
+ * down_samples periods in a row asked for less.
+ */
+static unsigned long sunxi_dmc_bw_pick(struct sunxi_dmcfreq *dmcfreq,
+				       struct sunxi_dmc_bw_state *state,
+				       unsigned long need)
+{
+	unsigned long target = dmcfreq->freq_table[dmcfreq->nr_freq - 1];
+	unsigned int i;
+
+	for (i = 0; i < dmcfreq->nr_freq; i++) {
+		if (dmcfreq->freq_table[i] >= need) {
+			target = dmcfreq->freq_table[i];
+			break;
+		}
+	}
+
+	if (target < state->freq && ++state->down_cnt < dmcfreq->down_samples)
+		return state->freq;
+
+	state->down_cnt = 0;
+	state->freq = target;
+
+	return target;
+}
+
+static int sunxi_bw_governor_get_target(struct devfreq *devfreq,
+					unsigned long *freq)
+{
+	struct sunxi_dmcfreq *dmcfreq = dev_get_drvdata(devfreq->dev.parent);
+	struct devfreq_dev_status *stat;
+	struct sunxi_dmc_bw_sample sample;
+	int err;
+
+	err = devfreq_update_stats(devfreq);
+	if (err)
+		return err;
+
+	stat = &devfreq->last_status;
+
+	/* busy_time is the nsipmu byte count of the last PERIOD */
+	sample.total = stat->busy_time;
+	sample.latency = sunxi_dmc_masters_read(dmcfreq);
+
+	dmcfreq->bw_state.freq = stat->current_frequency;
+	*freq = sunxi_dmc_bw_pick(dmcfreq, &dmcfreq->bw_state,
+				  sunxi_dmc_bw_need(dmcfreq, &sample));
+
+	return 0;
+}
+
+static int sunxi_bw_governor_event_handler(struct devfreq *devfreq,
+					   unsigned int event, void *data)
+{
+	struct sunxi_dmcfreq *dmcfreq = dev_get_drvdata(devfreq->dev.parent);
+
+	switch (event) {
+	case DEVFREQ_GOV_START:
+		sunxi_dmc_masters_start(dmcfreq);
+		devfreq_monitor_start(devfreq);
+		break;
+
+	case DEVFREQ_GOV_STOP:
+		devfreq_monitor_stop(devfreq);
+		sunxi_dmc_masters_stop(dmcfreq);
+		break;
+
+	case DEVFREQ_GOV_UPDATE_INTERVAL:
+		devfreq_update_interval(devfreq, (unsigned int *)data);
+		break;
+
+	case DEVFREQ_GOV_SUSPEND:
+		devfreq_monitor_suspend(devfreq);
+		break;
+
+	case DEVFREQ_GOV_RESUME:
+		devfreq_monitor_resume(devfreq);
+		break;
+	}
+
+	return 0;
+}
+
+static struct devfreq_governor sunxi_bw_governor = {
+	.name = "sunxi_bw",
+	.attrs = DEVFREQ_GOV_ATTR_POLLING_INTERVAL,
+	.get_target_freq = sunxi_bw_governor_get_target,
+	.event_handler = sunxi_bw_governor_event_handler,
+};
+
+static ssize_t dmc_stats_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct sunxi_dmcfreq *dmcfreq = dev_get_drvdata(dev);
+	struct sunxi_dmc_stats *stats = &dmcfreq->stats;
+	ssize_t len = 0;
+	unsigned int i;
+
+	mutex_lock(&dmcfreq->lock);
+	sunxi_dmc_stats_residency(dmcfreq, clk_get_rate(dmcfreq->dmc_clk));
+
+	len += sprintf(buf + len, "transitions: %llu\n", stats->trans);
+	len += sprintf(buf + len, "failed: %llu\n", stats->fail);
+	len += sprintf(buf + len, "latency avg: %llu us, max: %llu us\n",
+		       stats->trans ? div64_u64(stats->lat_total_ns, stats->trans) / NSEC_PER_USEC : 0,
+		       stats->lat_max_ns / NSEC_PER_USEC);
+	len += sprintf(buf + len, "residency:\n");
+	for (i = 0; i < dmcfreq->nr_freq; i++)
+		len += sprintf(buf + len, "  %4luM: %llu ms\n", dmcfreq->freq_table[i] / 1000000,
+			       div_u64(stats->residency_ns[i], NSEC_PER_MSEC));
+	mutex_unlock(&dmcfreq->lock);
+
+	return len;
+}
+static DEVICE_ATTR_RO(dmc_stats);
+
+/*
+ * Replay a recorded bandwidth trace through the sunxi_bw decision logic
+ * without touching the hardware. One sample per line, the bytes moved in a
+ * PERIOD by all masters and by the latency sensitive ones:
+ *
+ *   echo "reset" > bw_replay
+ *   cat trace.txt > bw_replay
+ *   cat bw_replay
+ *
+ * Writes append to the current replay, so long traces can be fed in chunks.
+ */
+static ssize_t bw_replay_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct sunxi_dmcfreq *dmcfreq = dev_get_drvdata(dev);
+	struct sunxi_dmc_replay *replay = &dmcfreq->replay;
+	ssize_t len = 0;
+	unsigned int i;
+
+	mutex_lock(&dmcfreq->lock);
+	len += sprintf(buf + len, "samples: %llu\n", replay->samples);
+	len += sprintf(buf + len, "up: %llu, down: %llu\n", replay->up, replay->down);
+	len += sprintf(buf + len, "under-provisioned: %llu\n", replay->short_samples);
+	len += sprintf(buf + len, "residency:\n");
+	for (i = 0; i < dmcfreq->nr_freq; i++)
+		len += sprintf(buf + len, "  %4luM: %llu samples (%llu%%)\n",
+			       dmcfreq->freq_table[i] / 1000000, replay->residency[i],
+			       replay->samples ? div64_u64(replay->residency[i] * 100, replay->samples) : 0);
+	mutex_unlock(&dmcfreq->lock);
+
+	return len;
+}
+
+static ssize_t bw_replay_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct sunxi_dmcfreq *dmcfreq = dev_get_drvdata(dev);
+	struct sunxi_dmc_replay *replay = &dmcfreq->replay;
+	struct sunxi_dmc_bw_sample sample;
+	unsigned long need, freq, old;
+	char *dup, *cur, *line;
+	int idx;
+
+	if (sysfs_streq(buf, "reset")) {
+		mutex_lock(&dmcfreq->lock);
+		memset(replay, 0, sizeof(*replay));
+		mutex_unlock(&dmcfreq->lock);
+		return count;
+	}
+
+	dup = kstrndup(buf, count, GFP_KERNEL);
+	if (!dup)
+		return -ENOMEM;
+
+	mutex_lock(&dmcfreq->lock);
+	if (!replay->state.freq)
+		replay->state.freq = dmcfreq->freq_table[0];
+
+	cur = dup;
+	while ((line = strsep(&cur, "\n")) != NULL) {
+		sample.latency = 0;
+		if (sscanf(line, "%llu %llu", &sample.total, &sample.latency) < 1)
+			continue;
+
+		old = replay->state.freq;
+		need = sunxi_dmc_bw_need(dmcfreq, &sample);
+		freq = sunxi_dmc_bw_pick(dmcfreq, &replay->state, need);
+
+		if (freq > old)
+			replay->up++;
+		else if (freq < old)
+			replay->down++;
+		if (freq < need && freq < dmcfreq->freq_table[dmcfreq->nr_freq - 1])
+			replay->short_samples++;
+
+		idx = sunxi_dmc_freq_index(dmcfreq, freq);
+		if (idx >= 0)
+			replay->residency[idx]++;
+		replay->samples++;
+	}
+	mutex_unlock(&dmcfreq->lock);
+
+	kfree(dup);
+
+	return count;
+}
+static DEVICE_ATTR_RW(bw_replay);
+
+static struct attribute *sunxi_dmcfreq_attrs[] = {
+	&dev_attr_dmc_stats.attr,
+	&dev_attr_bw_replay.attr,
+	NULL,
+};
+
+static const struct attribute_group sunxi_dmcfreq_group = {
+	.attrs = sunxi_dmcfreq_attrs,
+};
+
 static const struct of_device_id sunxi_dmcfreq_match[] = {
 	{ .compatible = "allwinner,sunxi-dmc" },
 	{},
@@ -296,6 +721,8 @@ static int sunxi_dmcfreq_probe(struct platform_device *pdev)
 	struct device_node *np = pdev->dev.of_node;
 	struct device_node *dram_np;
 	struct sunxi_dmcfreq *dmcfreq;
+	struct device_node *nsi_np;
+	const char *governor = "performance";
 	unsigned int tpr13;
 	unsigned int dram_div;
 	int rc = 0;
@@ -361,29 +788,73 @@ static int sunxi_dmcfreq_probe(struct platform_device *pdev)
 	of_property_read_u32(np, "downdifferential",
 			     &dmcfreq->ondemand_data.downdifferential);
 
-	dmcfreq->rate = clk_get_rate(dmcfreq->dmc_clk);
-	sunxi_adjust_freq(dev, dmcfreq->rate, dram_div);
+	dmcfreq->trans_timeout_us = SUNXI_DMC_TIMEOUT_US;
+	of_property_read_u32(np, "transition-timeout-us", &dmcfreq->trans_timeout_us);
+
+	/* sunxi_bw governor tunables */
+	dmcfreq->bw_upthreshold = SUNXI_BW_UPTHRESHOLD;
+	dmcfreq->latency_upthreshold = SUNXI_BW_LATENCY_UPTHRESHOLD;
+	dmcfreq->latency_active = SUNXI_BW_LATENCY_ACTIVE;
+	dmcfreq->down_samples = SUNXI_BW_DOWN_SAMPLES;
+	of_property_read_u32(np, "bw-upthreshold", &dmcfreq->bw_upthreshold);
+	of_property_read_u32(np, "latency-upthreshold", &dmcfreq->latency_upthreshold);
+	of_property_read_u32(np, "latency-active-bytes", &dmcfreq->latency_active);
+	of_property_read_u32(np, "latency-min-freq", &dmcfreq->latency_min_freq);
+	of_property_read_u32(np, "down-samples", &dmcfreq->down_samples);
+	if (!dmcfreq->bw_upthreshold || dmcfreq->bw_upthreshold > 100)
+		dmcfreq->bw_upthreshold = SUNXI_BW_UPTHRESHOLD;
+	if (!dmcfreq->latency_upthreshold || dmcfreq->latency_upthreshold > 100)
+		dmcfreq->latency_upthreshold = SUNXI_BW_LATENCY_UPTHRESHOLD;
+
+	rc = of_property_read_variable_u32_array(np, "latency-masters", dmcfreq->masters,
+						 1, SUNXI_DMC_MAX_MASTERS);
+	nsi_np = of_parse_phandle(np, "devfreq-events", 0);
+	if (rc > 0 && nsi_np) {
+		dmcfreq->nsi_regmap = syscon_node_to_regmap(nsi_np);
+		if (IS_ERR(dmcfreq->nsi_regmap)) {
+			sunxi_err(&pdev->dev, "no nsi regmap, latency masters ignored\n");
+			dmcfreq->nsi_regmap = NULL;
+		} else {
+			dmcfreq->nr_masters = rc;
+		}
+	}
+	of_node_put(nsi_np);
+	of_property_read_string(np, "governor", &governor);
+
 	dmcfreq->dev = dev;
+	dmcfreq->rate = clk_get_rate(dmcfreq->dmc_clk);
+	sunxi_adjust_freq(dmcfreq, dmcfreq->rate, dram_div);
+	dmcfreq->stats.last = ktime_get();
 	platform_set_drvdata(pdev, dmcfreq);
 
+	rc = devfreq_add_governor(&sunxi_bw_governor);
+	if (rc) {
+		sunxi_err(&pdev->dev, "Failed to add governor: %d\n", rc);
+		goto err;
+	}
+
 	/* Add devfreq device to monitor */
 	dmcfreq->devfreq = devm_devfreq_add_device(dev,
 						   &sunxi_dmcfreq_profile,
-						   "performance",
+						   governor,
 						   &(dmcfreq->ondemand_data));
 	if (IS_ERR(dmcfreq->devfreq)) {
 		sunxi_err(&pdev->dev, "devm_devfreq_add_device error!\n");
 		rc = PTR_ERR(dmcfreq->devfreq);
-		goto err;
+		goto err_governor;
 	}
 	devm_devfreq_register_opp_notifier(dev, dmcfreq->devfreq);
 
 	rc = devfreq_event_enable_edev(dmcfreq->edev);
 	if (rc < 0) {
 		sunxi_err(&pdev->dev, "devfreq_event_enable_edev error!\n");
-		goto err;
+		goto err_governor;
 	}
 
+	rc = devm_device_add_group(dev, &sunxi_dmcfreq_group);
+	if (rc)
+		sunxi_err(&pdev->dev, "failed to create sysfs nodes\n");
+
 	/* input boost init */
 	rc = of_property_read_u32(np, "input-boost-enable",
 			     &dmcfreq->input_boost_enable);
@@ -407,6 +878,8 @@ static int sunxi_dmcfreq_probe(struct platform_device *pdev)
 
 	return 0;
 
+err_governor:
+	devfreq_remove_governor(&sunxi_bw_governor);
 err:
 	dev_pm_opp_of_remove_table(dev);
 err_opp:
@@ -427,6 +900,7 @@ static int sunxi_dmcfreq_remove(struct platform_device *pdev)
 		destroy_workqueue(dmcfreq->boost_workqueue);
 	}
 
+	devfreq_remove_governor(&sunxi_bw_governor);
 	dev_pm_opp_of_remove_table(dev);
 	devfreq_event_disable_edev(dmcfreq->edev);
 	return 0;
@@ -495,4 +969,4 @@ MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("SUNXI dmcfreq driver");
 MODULE_ALIAS("platform:" DRIVER_NAME);
 MODULE_AUTHOR("fanqinghua <fanqinghua@allwinnertech.com>");
-MODULE_VERSION("1.0.0");
+MODULE_VERSION("1.1.0");
@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner DMA descriptor benchmark
+ *
+ * Measures the prep+submit cost of freshly prepared and reused memcpy
+ * descriptors and the memcpy throughput of the DMA controller. The test
+ * runs once when the module is loaded, results go to the kernel log:
+ *
+ *   insmod sunxi-dma-bench.ko iterations=1000 size=4096 depth=16
+ */
+
+#define pr_fmt(fmt) "sunxi-dma-bench: " fmt
+
+#include <linux/completion.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Number of transfers per test (default: 1000)");
+
+static unsigned int size = 4096;
+module_param(size, uint, 0444);
+MODULE_PARM_DESC(size, "Transfer size in bytes (default: 4096)");
+
+static unsigned int depth = 16;
+module_param(depth, uint, 0444);
+MODULE_PARM_DESC(depth, "Descriptors in flight for the throughput test (default: 16)");
+
+#define BENCH_TIMEOUT	msecs_to_jiffies(3000)
+
+struct bench_ctx {
+	struct dma_chan		*chan;
+	struct device		*dev;
+	void			*src;
+	void			*dst;
+	dma_addr_t		src_dma;
+	dma_addr_t		dst_dma;
+	struct completion	done;
+};
+
+struct bench_stat {
+	u64			total_ns;
+	u64			max_ns;
+	u32			count;
+};
+
+static void bench_callback(void *param)
+{
+	struct bench_ctx *ctx = param;
+
+	complete(&ctx->done);
+}
+
+static void bench_stat_add(struct bench_stat *stat, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	stat->total_ns += ns;
+	stat->count++;
+	if (ns > stat->max_ns)
+		stat->max_ns = ns;
+}
+
+static void bench_stat_print(const char *name, struct bench_stat *stat)
+{
+	if (!stat->count)
+		return;
+
+	pr_info("%-8s prep+submit: avg %llu ns, max %llu ns (%u runs)\n", name,
+		div_u64(stat->total_ns, stat->count), stat->max_ns, stat->count);
+}
+
+static int bench_wait(struct bench_ctx *ctx)
+{
+	if (!wait_for_completion_timeout(&ctx->done, BENCH_TIMEOUT)) {
+		pr_err("transfer timed out\n");
+		dmaengine_terminate_sync(ctx->chan);
+		return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+/* A new descriptor for every transfer: exercises the LLI/descriptor caches */
+static int bench_prep(struct bench_ctx *ctx)
+{
+	struct dma_async_tx_descriptor *tx;
+	struct bench_stat stat = { 0 };
+	ktime_t start;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < iterations; i++) {
+		reinit_completion(&ctx->done);
+
+		start = ktime_get();
+		tx = dmaengine_prep_dma_memcpy(ctx->chan, ctx->dst_dma,
+					       ctx->src_dma, size,
+					       DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+		if (!tx) {
+			pr_err("prep failed at run %u\n", i);
+			return -ENOMEM;
+		}
+		tx->callback = bench_callback;
+		tx->callback_param = ctx;
+		if (dma_submit_error(dmaengine_submit(tx)))
+			return -EIO;
+		bench_stat_add(&stat, start);
+
+		dma_async_issue_pending(ctx->chan);
+		ret = bench_wait(ctx);
+		if (ret)
+			return ret;
+
+		if (!i && memcmp(ctx->src, ctx->dst, size)) {
+			pr_err("data mismatch\n");
+			return -EIO;
+		}
+	}
+
+	bench_stat_print("prep", &stat);
+
+	return 0;
+}
+
+/* One DMA_CTRL_REUSE descriptor submitted over and over */
+static int bench_reuse(struct bench_ctx *ctx)
+{
+	struct dma_async_tx_descriptor *tx;
+	struct bench_stat stat = { 0 };
+	ktime_t start;
+	unsigned int i;
+	int ret;
+
+	tx = dmaengine_prep_dma_memcpy(ctx->chan, ctx->dst_dma, ctx->src_dma,
+				       size, DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!tx)
+		return -ENOMEM;
+
+	ret = dmaengine_desc_set_reuse(tx);
+	if (ret) {
+		pr_info("descriptor reuse not supported\n");
+		dmaengine_desc_free(tx);
+		return 0;
+	}
+	tx->callback = bench_callback;
+	tx->callback_param = ctx;
+
+	for (i = 0; i < iterations; i++) {
+		reinit_completion(&ctx->done);
+
+		start = ktime_get();
+		if (dma_submit_error(dmaengine_submit(tx))) {
+			ret = -EIO;
+			break;
+		}
+		bench_stat_add(&stat, start);
+
+		dma_async_issue_pending(ctx->chan);
+		ret = bench_wait(ctx);
+		if (ret)
+			break;
+
+		/*
+		 * The callback runs before the descriptor is put back on the
+		 * allocated list, let the completion tasklet finish first.
+		 */
+		dmaengine_synchronize(ctx->chan);
+	}
+
+	dmaengine_desc_free(tx);
+
+	bench_stat_print("reuse", &stat);
+
+	return ret;
+}
+
+static int bench_throughput(struct bench_ctx *ctx)
+{
+	struct dma_async_tx_descriptor *tx;
+	unsigned int i, j, rounds;
+	u64 bytes = 0, ns;
+	ktime_t start;
+	int ret;
+
+	rounds = max(iterations / depth, 1U);
+
+	start = ktime_get();
+	for (i = 0; i < rounds; i++) {
+		reinit_completion(&ctx->done);
+
+		for (j = 0; j < depth; j++) {
+			tx = dmaengine_prep_dma_memcpy(ctx->chan, ctx->dst_dma,
+						       ctx->src_dma, size,
+						       DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+			if (!tx) {
+				dmaengine_terminate_sync(ctx->chan);
+				return -ENOMEM;
+			}
+			if (j == depth - 1) {
+				tx->callback = bench_callback;
+				tx->callback_param = ctx;
+			}
+			dmaengine_submit(tx);
+		}
+
+		dma_async_issue_pending(ctx->chan);
+		ret = bench_wait(ctx);
+		if (ret)
+			return ret;
+
+		bytes += (u64)size * depth;
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	pr_info("memcpy   %u x %u bytes, depth %u: %llu MB/s\n",
+		rounds * depth, size, depth,
+		div64_u64(bytes * NSEC_PER_SEC, max_t(u64, ns, 1)) >> 20);
+
+	return 0;
+}
+
+static int __init sunxi_dma_bench_init(void)
+{
+	struct bench_ctx *ctx;
+	dma_cap_mask_t mask;
+	int ret;
+
+	if (!iterations || !size || !depth)
+		return -EINVAL;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	init_completion(&ctx->done);
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_MEMCPY, mask);
+	ctx->chan = dma_request_chan_by_mask(&mask);
+	if (IS_ERR(ctx->chan)) {
+		ret = PTR_ERR(ctx->chan);
+		pr_err("no memcpy channel: %d\n", ret);
+		goto err_free_ctx;
+	}
+	ctx->dev = ctx->chan->device->dev;
+
+	ctx->src = dma_alloc_coherent(ctx->dev, size, &ctx->src_dma, GFP_KERNEL);
+	ctx->dst = dma_alloc_coherent(ctx->dev, size, &ctx->dst_dma, GFP_KERNEL);
+	if (!ctx->src || !ctx->dst) {
+		ret = -ENOMEM;
+		goto err_free_buf;
+	}
+	memset(ctx->src, 0x5a, size);
+	memset(ctx->dst, 0, size);
+
+	pr_info("%s: %u iterations, %u bytes\n", dma_chan_name(ctx->chan),
+		iterations, size);
+
+	ret = bench_prep(ctx);
+	if (!ret)
+		ret = bench_reuse(ctx);
+	if (!ret)
+		ret = bench_throughput(ctx);
+
+err_free_buf:
+	if (ctx->dst)
+		dma_free_coherent(ctx->dev, size, ctx->dst, ctx->dst_dma);
+	if (ctx->src)
+		dma_free_coherent(ctx->dev, size, ctx->src, ctx->src_dma);
+	dma_release_channel(ctx->chan);
+err_free_ctx:
+	kfree(ctx);
+	return ret;
+}
+module_init(sunxi_dma_bench_init);
+
+static void __exit sunxi_dma_bench_exit(void)
+{
+}
+module_exit(sunxi_dma_bench_exit);
+
+MODULE_DESCRIPTION("Allwinner DMA descriptor benchmark");
+MODULE_LICENSE("GPL");
@@ -9,6 +9,7 @@
  */
 
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dmaengine.h>
 #include <linux/dmapool.h>
@@ -18,12 +19,13 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/reset.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/types.h>
 #include <virt-dma.h>
 #include "sunxi-dma.h"
 
-#define SUNXI_DMA_MODULE_VERSION	"1.0.13"
+#define SUNXI_DMA_MODULE_VERSION	"1.0.15"
 /*
  * Common registers
  */
@@ -217,16 +219,42 @@ struct sun6i_desc {
 	struct virt_dma_desc	vd;
 	dma_addr_t		p_lli;
 	struct sun6i_dma_lli	*v_lli;
+	enum dma_transfer_direction dir;
+	unsigned int		nr_lli;
 };
 
+/*
+ * Each vchan keeps a few LLIs and descriptors around, so that clients
+ * queueing transfers at a high rate neither hit the allocator for every
+ * transfer nor fail under memory pressure with GFP_NOWAIT.
+ */
+#define SUN6I_DMA_LLI_PREALLOC		16
+#define SUN6I_DMA_LLI_CACHE_MAX		64
+#define SUN6I_DMA_TXD_PREALLOC		4
+#define SUN6I_DMA_TXD_CACHE_MAX		16
+
 struct sun6i_pchan {
 	u32			idx;
 	void __iomem		*base;
 	struct sun6i_vchan	*vchan;
 	struct sun6i_desc	*desc;
-	struct sun6i_desc	*done;
 };
 
+/*
+ * Scheduling classes for the physical channels, highest priority first.
+ * Cyclic transfers (audio) always run as realtime, channels handed out
+ * through the device tree default to latency and memcpy users to bulk.
+ */
+enum sun6i_dma_prio {
+	SUN6I_DMA_PRIO_RT = 0,
+	SUN6I_DMA_PRIO_LATENCY,
+	SUN6I_DMA_PRIO_BULK,
+	SUN6I_DMA_PRIO_NR,
+};
+
+/* log2(us) buckets of the time a vchan waits for a physical channel */
+#define SUN6I_DMA_LAT_BUCKETS	16
+
 struct sun6i_vchan {
 	struct virt_dma_chan	vc;
 	struct list_head	node;
@@ -235,7 +263,21 @@ struct sun6i_vchan {
 	u8			port;
 	u8			irq_type;
 	bool			cyclic;
+	enum sun6i_dma_prio	prio;
 	struct sunxi_dma_desc	*extend_desc;
+
+	/* free LLIs (linked by v_lli_next) and descriptors */
+	spinlock_t		cache_lock;
+	struct sun6i_dma_lli	*lli_cache;
+	u32			lli_cached;
+	struct list_head	txd_cache;
+	u32			txd_cached;
+
+	/* queue latency statistics, protected by sdev->lock */
+	ktime_t			queued_at;
+	u32			lat_count;
+	u32			lat_max_us;
+	u32			lat_hist[SUN6I_DMA_LAT_BUCKETS];
 };
 
 struct sun6i_dma_dev {
@@ -250,7 +292,7 @@ struct sun6i_dma_dev {
 	struct reset_control	*rstc;
 	struct tasklet_struct	task;
 	atomic_t		tasklet_shutdown;
-	struct list_head	pending;
+	struct list_head	pending[SUN6I_DMA_PRIO_NR];
 	struct dma_pool		*pool;
 	struct sun6i_pchan	*pchans;
 	struct sun6i_vchan	*vchans;
@@ -258,6 +300,8 @@ struct sun6i_dma_dev {
 	u32			num_pchans;
 	u32			num_vchans;
 	u32			max_request;
+	u32			num_rt_pchans;
+	struct dentry		*debugfs;
 };
 
 static struct device *chan2dev(struct dma_chan *chan)
@@ -492,6 +536,164 @@ static size_t sun6i_get_chan_size(struct sun6i_pchan *pchan)
 	return bytes;
 }
 
+static struct sun6i_dma_lli *sun6i_dma_lli_get(struct sun6i_dma_dev *sdev,
+					       struct sun6i_vchan *vchan,
+					       dma_addr_t *p_lli)
+{
+	struct sun6i_dma_lli *v_lli;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vchan->cache_lock, flags);
+	v_lli = vchan->lli_cache;
+	if (v_lli) {
+		vchan->lli_cache = v_lli->v_lli_next;
+		vchan->lli_cached--;
+	}
+	spin_unlock_irqrestore(&vchan->cache_lock, flags);
+
+	if (!v_lli) {
+		v_lli = dma_pool_alloc(sdev->pool, GFP_NOWAIT, p_lli);
+		if (!v_lli)
+			return NULL;
+		v_lli->this_phy = *p_lli;
+	}
+
+	*p_lli = v_lli->this_phy;
+
+	return v_lli;
+}
+
+static void sun6i_dma_lli_put(struct sun6i_dma_dev *sdev,
+			      struct sun6i_vchan *vchan,
+			      struct sun6i_dma_lli *v_lli)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&vchan->cache_lock, flags);
+	if (vchan->lli_cached < SUN6I_DMA_LLI_CACHE_MAX) {
+		v_lli->v_lli_next = vchan->lli_cache;
+		vchan->lli_cache = v_lli;
+		vchan->lli_cached++;
+		v_lli = NULL;
+	}
+	spin_unlock_irqrestore(&vchan->cache_lock, flags);
+
+	if (v_lli)
+		dma_pool_free(sdev->pool, v_lli, v_lli->this_phy);
+}
+
+static struct sun6i_desc *sun6i_dma_txd_get(struct sun6i_vchan *vchan)
+{
+	struct sun6i_desc *txd = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vchan->cache_lock, flags);
+	if (!list_empty(&vchan->txd_cache)) {
+		txd = list_first_entry(&vchan->txd_cache,
+				       struct sun6i_desc, vd.node);
+		list_del(&txd->vd.node);
+		vchan->txd_cached--;
+	}
+	spin_unlock_irqrestore(&vchan->cache_lock, flags);
+
+	if (txd)
+		memset(txd, 0, sizeof(*txd));
+	else
+		txd = kzalloc(sizeof(*txd), GFP_NOWAIT);
+
+	return txd;
+}
+
+static void sun6i_dma_txd_put(struct sun6i_vchan *vchan,
+			      struct sun6i_desc *txd)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&vchan->cache_lock, flags);
+	if (vchan->txd_cached < SUN6I_DMA_TXD_CACHE_MAX) {
+		list_add(&txd->vd.node, &vchan->txd_cache);
+		vchan->txd_cached++;
+		txd = NULL;
+	}
+	spin_unlock_irqrestore(&vchan->cache_lock, flags);
+
+	kfree(txd);
+}
+
+/* Release every LLI of @txd, including a partially built chain */
+static void sun6i_dma_txd_free_lli(struct sun6i_dma_dev *sdev,
+				   struct sun6i_vchan *vchan,
+				   struct sun6i_desc *txd)
+{
+	struct sun6i_dma_lli *v_lli, *v_next;
+
+	for (v_lli = txd->v_lli; v_lli; v_lli = v_next) {
+		v_next = v_lli->v_lli_next;
+		sun6i_dma_lli_put(sdev, vchan, v_lli);
+	}
+	txd->v_lli = NULL;
+}
+
+static void sun6i_dma_cache_fill(struct sun6i_dma_dev *sdev,
+				 struct sun6i_vchan *vchan)
+{
+	struct sun6i_dma_lli *v_lli;
+	struct sun6i_desc *txd;
+	dma_addr_t p_lli;
+	int i;
+
+	for (i = vchan->lli_cached; i < SUN6I_DMA_LLI_PREALLOC; i++) {
+		v_lli = dma_pool_alloc(sdev->pool, GFP_KERNEL, &p_lli);
+		if (!v_lli)
+			break;
+		v_lli->this_phy = p_lli;
+		sun6i_dma_lli_put(sdev, vchan, v_lli);
+	}
+
+	for (i = vchan->txd_cached; i < SUN6I_DMA_TXD_PREALLOC; i++) {
+		txd = kzalloc(sizeof(*txd), GFP_KERNEL);
+		if (!txd)
+			break;
+		sun6i_dma_txd_put(vchan, txd);
+	}
+}
+
+static void sun6i_dma_cache_drain(struct sun6i_dma_dev *sdev,
+				  struct sun6i_vchan *vchan)
+{
+	struct sun6i_dma_lli *v_lli;
+	struct sun6i_desc *txd, *tmp;
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	spin_lock_irqsave(&vchan->cache_lock, flags);
+	v_lli = vchan->lli_cache;
+	vchan->lli_cache = NULL;
+	vchan->lli_cached = 0;
+	list_splice_init(&vchan->txd_cache, &head);
+	vchan->txd_cached = 0;
+	spin_unlock_irqrestore(&vchan->cache_lock, flags);
+
+	while (v_lli) {
+		struct sun6i_dma_lli *v_next = v_lli->v_lli_next;
+
+		dma_pool_free(sdev->pool, v_lli, v_lli->this_phy);
+		v_lli = v_next;
+	}
+
+	list_for_each_entry_safe(txd, tmp, &head, vd.node)
+		kfree(txd);
+}
+
+static inline u32 sun6i_dma_high_addr(struct sun6i_dma_dev *sdev,
+				      dma_addr_t src, dma_addr_t dst)
+{
+	if (sdev->cfg->has_support_32G)
+		return SET_DST_HIGH_32G_ADDR(dst) | SET_SRC_HIGH_32G_ADDR(src);
+
+	return SET_DST_HIGH_ADDR(dst) | SET_SRC_HIGH_ADDR(src);
+}
+
 static void *sun6i_dma_lli_add(struct sun6i_dma_lli *prev,
 			       struct sun6i_dma_lli *next,
 			       dma_addr_t next_phy,
@@ -531,30 +733,17 @@ static void sun6i_dma_free_desc(struct virt_dma_desc *vd)
 {
 	struct sun6i_desc *txd = to_sun6i_desc(&vd->tx);
 	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(vd->tx.chan->device);
-	struct sun6i_dma_lli *v_lli, *v_next;
-	dma_addr_t p_lli, p_next;
+	struct sun6i_vchan *vchan = to_sun6i_vchan(vd->tx.chan);
 
 	if (unlikely(!txd))
 		return;
 
-	p_lli = txd->p_lli;
-	v_lli = txd->v_lli;
-
-	while (v_lli) {
-		v_next = v_lli->v_lli_next;
-		p_next = v_lli->p_lli_next;
-
-		dma_pool_free(sdev->pool, v_lli, p_lli);
-
-		v_lli = v_next;
-		p_lli = p_next;
-	}
+	sun6i_dma_txd_free_lli(sdev, vchan, txd);
 
 	txd->vd.tx.callback = NULL;
 	txd->vd.tx.callback_result = NULL;
 	txd->vd.tx.callback_param = NULL;
-	kfree(txd);
-	txd = NULL;
+	sun6i_dma_txd_put(vchan, txd);
 }
 
 static int sun6i_dma_start_desc(struct sun6i_vchan *vchan)
@@ -569,14 +758,12 @@ static int sun6i_dma_start_desc(struct sun6i_vchan *vchan)
 
 	if (!desc) {
 		pchan->desc = NULL;
-		pchan->done = NULL;
 		return -EAGAIN;
 	}
 
 	list_del(&desc->node);
 
 	pchan->desc = to_sun6i_desc(&desc->tx);
-	pchan->done = NULL;
 
 	sun6i_dma_dump_lli(vchan, pchan->desc->v_lli);
 
@@ -600,78 +787,172 @@ static int sun6i_dma_start_desc(struct sun6i_vchan *vchan)
 	return 0;
 }
 
-static void sun6i_dma_tasklet(unsigned long data)
+static inline enum sun6i_dma_prio sun6i_vchan_prio(struct sun6i_vchan *vchan)
 {
-	struct sun6i_dma_dev *sdev = (struct sun6i_dma_dev *)data;
-	struct sun6i_vchan *vchan;
-	struct sun6i_pchan *pchan;
-	unsigned int pchan_alloc = 0;
-	unsigned int pchan_idx;
+	return vchan->cyclic ? SUN6I_DMA_PRIO_RT : vchan->prio;
+}
 
-	list_for_each_entry(vchan, &sdev->slave.channels, vc.chan.device_node) {
-		spin_lock_irq(&vchan->vc.lock);
+/*
+ * The last @num_rt_pchans physical channels are kept for realtime
+ * (cyclic) users, so that audio never waits behind bulk copies.
+ */
+static inline bool sun6i_pchan_is_reserved(struct sun6i_dma_dev *sdev,
+					   struct sun6i_pchan *pchan)
+{
+	return pchan->idx >= sdev->num_pchans - sdev->num_rt_pchans;
+}
 
-		pchan = vchan->phy;
+/* Must be called with sdev->lock held */
+static void sun6i_dma_enqueue(struct sun6i_dma_dev *sdev,
+			      struct sun6i_vchan *vchan)
+{
+	vchan->queued_at = ktime_get();
+	list_add_tail(&vchan->node, &sdev->pending[sun6i_vchan_prio(vchan)]);
+}
 
-		if (pchan && pchan->done) {
-			if (sun6i_dma_start_desc(vchan)) {
-				/*
-				 * No current txd associated with this channel
-				 */
-				dev_dbg(sdev->slave.dev, "pchan %u: free\n",
-					pchan->idx);
+/* Must be called with sdev->lock held */
+static struct sun6i_vchan *sun6i_dma_pick_waiter(struct sun6i_dma_dev *sdev,
+						 struct sun6i_pchan *pchan)
+{
+	int prio, nr_prio;
 
-				/* Mark this channel free */
-				vchan->phy = NULL;
-				pchan->vchan = NULL;
-			}
-		}
-		spin_unlock_irq(&vchan->vc.lock);
+	nr_prio = sun6i_pchan_is_reserved(sdev, pchan) ?
+		  SUN6I_DMA_PRIO_RT + 1 : SUN6I_DMA_PRIO_NR;
+
+	for (prio = 0; prio < nr_prio; prio++) {
+		if (!list_empty(&sdev->pending[prio]))
+			return list_first_entry(&sdev->pending[prio],
+						struct sun6i_vchan, node);
 	}
 
-	spin_lock_irq(&sdev->lock);
-	for (pchan_idx = 0; pchan_idx < sdev->num_pchans; pchan_idx++) {
-		pchan = &sdev->pchans[pchan_idx];
+	return NULL;
+}
 
-		if (pchan->vchan || list_empty(&sdev->pending))
-			continue;
+/* Must be called with sdev->lock held */
+static void sun6i_dma_bind(struct sun6i_dma_dev *sdev,
+			   struct sun6i_pchan *pchan,
+			   struct sun6i_vchan *vchan)
+{
+	s64 wait_us = ktime_us_delta(ktime_get(), vchan->queued_at);
+	u32 bucket = 0;
 
-		vchan = list_first_entry(&sdev->pending,
-					 struct sun6i_vchan, node);
+	/* Remove from pending channels */
+	list_del_init(&vchan->node);
 
-		/* Remove from pending channels */
-		list_del_init(&vchan->node);
-		pchan_alloc |= BIT(pchan_idx);
+	/* Mark this channel allocated */
+	pchan->vchan = vchan;
+	vchan->phy = pchan;
+
+	if (wait_us > 0)
+		bucket = min_t(u32, fls64(wait_us), SUN6I_DMA_LAT_BUCKETS - 1);
+	else
+		wait_us = 0;
+	vchan->lat_hist[bucket]++;
+	vchan->lat_count++;
+	if (wait_us > vchan->lat_max_us)
+		vchan->lat_max_us = min_t(s64, wait_us, U32_MAX);
+
+	dev_dbg(sdev->slave.dev, "pchan %u: alloc vchan %p\n",
+		pchan->idx, &vchan->vc);
+}
+
+/*
+ * Release the physical channel of @vchan and hand it over to the highest
+ * priority waiter. Must be called with vchan->vc.lock held. The returned
+ * vchan, if any, is now bound to the channel and must be started by the
+ * caller once vchan->vc.lock has been dropped.
+ */
+static struct sun6i_vchan *sun6i_dma_release_pchan(struct sun6i_dma_dev *sdev,
+						   struct sun6i_vchan *vchan)
+{
+	struct sun6i_pchan *pchan = vchan->phy;
+	struct sun6i_vchan *next;
+
+	if (!pchan)
+		return NULL;
+
+	dev_dbg(sdev->slave.dev, "pchan %u: free\n", pchan->idx);
+
+	spin_lock(&sdev->lock);
+
+	/* Mark this channel free */
+	vchan->phy = NULL;
+	pchan->vchan = NULL;
+	pchan->desc = NULL;
+
+	next = sun6i_dma_pick_waiter(sdev, pchan);
+	if (next)
+		sun6i_dma_bind(sdev, pchan, next);
+
+	spin_unlock(&sdev->lock);
+
+	return next;
+}
+
+/*
+ * Start a vchan that has just been bound to a physical channel. If it has
+ * nothing left to run (terminated in the meantime), pass the channel on.
+ */
+static void sun6i_dma_launch(struct sun6i_dma_dev *sdev,
+			     struct sun6i_vchan *vchan)
+{
+	struct sun6i_vchan *next;
+	unsigned long flags;
+
+	while (vchan) {
+		next = NULL;
+
+		spin_lock_irqsave(&vchan->vc.lock, flags);
+		if (sun6i_dma_start_desc(vchan))
+			next = sun6i_dma_release_pchan(sdev, vchan);
+		spin_unlock_irqrestore(&vchan->vc.lock, flags);
 
-		/* Mark this channel allocated */
-		pchan->vchan = vchan;
-		vchan->phy = pchan;
-		dev_dbg(sdev->slave.dev, "pchan %u: alloc vchan %p\n",
-			pchan->idx, &vchan->vc);
+		vchan = next;
 	}
-	spin_unlock_irq(&sdev->lock);
+}
+
+static void sun6i_dma_tasklet(unsigned long data)
+{
+	struct sun6i_dma_dev *sdev = (struct sun6i_dma_dev *)data;
+	struct sun6i_vchan *launch[DMA_MAX_CHANNELS];
+	struct sun6i_vchan *vchan;
+	struct sun6i_pchan *pchan;
+	unsigned int nr_launch = 0;
+	unsigned int pchan_idx;
 
-	for (pchan_idx = 0; pchan_idx < sdev->num_pchans; pchan_idx++) {
-		if (!(pchan_alloc & BIT(pchan_idx)))
+	/*
+	 * Completed channels are restarted or handed over straight from the
+	 * interrupt handler, so only the pending queues are left to serve
+	 * here. Walk from the top so that realtime users fill the reserved
+	 * channels first and leave the shared ones to everybody else.
+	 */
+	spin_lock_irq(&sdev->lock);
+	for (pchan_idx = sdev->num_pchans; pchan_idx-- > 0; ) {
+		pchan = &sdev->pchans[pchan_idx];
+
+		if (pchan->vchan)
 			continue;
 
-		pchan = sdev->pchans + pchan_idx;
-		vchan = pchan->vchan;
-		if (vchan) {
-			spin_lock_irq(&vchan->vc.lock);
-			sun6i_dma_start_desc(vchan);
-			spin_unlock_irq(&vchan->vc.lock);
-		}
+		vchan = sun6i_dma_pick_waiter(sdev, pchan);
+		if (!vchan)
+			continue;
+
+		sun6i_dma_bind(sdev, pchan, vchan);
+		launch[nr_launch++] = vchan;
 	}
+	spin_unlock_irq(&sdev->lock);
+
+	while (nr_launch)
+		sun6i_dma_launch(sdev, launch[--nr_launch]);
 }
 
 static irqreturn_t sun6i_dma_interrupt(int irq, void *dev_id)
 {
 	struct sun6i_dma_dev *sdev = dev_id;
-	struct sun6i_vchan *vchan;
+	struct sun6i_vchan *vchan, *waiter;
 	struct sun6i_pchan *pchan;
 	int j, ret = IRQ_NONE;
-	u32 status;
+	u32 status, idx;
 	u32 i, count;
 
 	/* The actual @num_pchans may be less than 8, so need to
@@ -691,7 +972,11 @@ static irqreturn_t sun6i_dma_interrupt(int irq, void *dev_id)
 		sdev->cfg->clear_irq_status(sdev, i, status);
 
 		for (j = 0; (j < sdev->cfg->channum_per_reg) && status; j++) {
-			pchan = sdev->pchans + j;
+			idx = i * sdev->cfg->channum_per_reg + j;
+			if (idx >= sdev->num_pchans)
+				break;
+
+			pchan = sdev->pchans + idx;
 			vchan = pchan->vchan;
 			if (!pchan->desc)
 				goto next;
@@ -710,12 +995,21 @@ static irqreturn_t sun6i_dma_interrupt(int irq, void *dev_id)
 					if (cb)
 						cb(cb_data);
 				} else {
+					waiter = NULL;
+
 					spin_lock(&vchan->vc.lock);
-					if (pchan->desc) {
+					if (vchan->phy == pchan && pchan->desc) {
 						vchan_cookie_complete(&pchan->desc->vd);
-						pchan->done = pchan->desc;
+						/*
+						 * Chain the next descriptor right away, or give
+						 * the channel to the most urgent waiter.
+						 */
+						if (sun6i_dma_start_desc(vchan))
+							waiter = sun6i_dma_release_pchan(sdev, vchan);
 					}
 					spin_unlock(&vchan->vc.lock);
+
+					sun6i_dma_launch(sdev, waiter);
 				}
 			} else if (vchan && (status & DMA_IRQ_TIMEOUT) && (vchan->cyclic)) {
 					sunxi_dma_timeout_callback cb = NULL;
@@ -813,17 +1107,18 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy(
 	if (!len)
 		return NULL;
 
-	txd = kzalloc(sizeof(*txd), GFP_NOWAIT);
+	txd = sun6i_dma_txd_get(vchan);
 	if (!txd)
 		return NULL;
 
-
-	v_lli = dma_pool_alloc(sdev->pool, GFP_NOWAIT, &p_lli);
+	v_lli = sun6i_dma_lli_get(sdev, vchan, &p_lli);
 	if (!v_lli) {
 		dev_err(sdev->slave.dev, "Failed to alloc lli memory\n");
 		goto err_txd_free;
 	}
-	v_lli->this_phy = p_lli;
+
+	txd->dir = DMA_MEM_TO_MEM;
+	txd->nr_lli = 1;
 
 	v_lli->src = src;
 	v_lli->dst = dest;
@@ -855,7 +1150,7 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_memcpy(
 	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
 
 err_txd_free:
-	kfree(txd);
+	sun6i_dma_txd_put(vchan, txd);
 	return NULL;
 }
 
@@ -895,16 +1190,18 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_slave_sg(
 		return NULL;
 	}
 
-	txd = kzalloc(sizeof(*txd), GFP_NOWAIT);
+	txd = sun6i_dma_txd_get(vchan);
 	if (!txd)
 		return NULL;
 
+	txd->dir = dir;
+	txd->nr_lli = sg_len;
+
 	for_each_sg(sgl, sg, sg_len, i) {
-		v_lli = dma_pool_alloc(sdev->pool, GFP_NOWAIT, &p_lli);
+		v_lli = sun6i_dma_lli_get(sdev, vchan, &p_lli);
 		if (!v_lli)
 			goto err_lli_free;
 
-		v_lli->this_phy = p_lli;
 		p_lli = (u32)SET_DESC_HIGH_ADDR(p_lli);
 		v_lli->len = sg_dma_len(sg);
 
@@ -980,9 +1277,8 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_slave_sg(
 	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
 
 err_lli_free:
-	for (prev = txd->v_lli; prev; prev = prev->v_lli_next)
-		dma_pool_free(sdev->pool, prev, prev->this_phy);
-	kfree(txd);
+	sun6i_dma_txd_free_lli(sdev, vchan, txd);
+	sun6i_dma_txd_put(vchan, txd);
 	return NULL;
 }
 
@@ -1023,17 +1319,19 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_cyclic(
 	if (is_bmode && (vchan->extend_desc))
 		lli_cfg |= BMODE;
 
-	txd = kzalloc(sizeof(*txd), GFP_NOWAIT);
+	txd = sun6i_dma_txd_get(vchan);
 	if (!txd)
 		return NULL;
 
+	txd->dir = dir;
+	txd->nr_lli = periods;
+
 	for (i = 0; i < periods; i++) {
-		v_lli = dma_pool_alloc(sdev->pool, GFP_NOWAIT, &p_lli);
+		v_lli = sun6i_dma_lli_get(sdev, vchan, &p_lli);
 		if (!v_lli) {
 			dev_err(sdev->slave.dev, "Failed to alloc lli memory\n");
 			goto err_lli_free;
 		}
-		v_lli->this_phy = p_lli;
 		v_lli->len = period_len;
 
 		if (dir == DMA_MEM_TO_DEV) {
@@ -1097,9 +1395,8 @@ static struct dma_async_tx_descriptor *sun6i_dma_prep_dma_cyclic(
 	return vchan_tx_prep(&vchan->vc, &txd->vd, flags);
 
 err_lli_free:
-	for (prev = txd->v_lli; prev; prev = prev->v_lli_next)
-		dma_pool_free(sdev->pool, prev, prev->this_phy);
-	kfree(txd);
+	sun6i_dma_txd_free_lli(sdev, vchan, txd);
+	sun6i_dma_txd_put(vchan, txd);
 	return NULL;
 }
 
@@ -1150,7 +1447,10 @@ static int sun6i_dma_resume(struct dma_chan *chan)
 		       pchan->base + DMA_CHAN_PAUSE);
 	} else if (!list_empty(&vchan->vc.desc_issued)) {
 		spin_lock(&sdev->lock);
-		list_add_tail(&vchan->node, &sdev->pending);
+		if (list_empty(&vchan->node)) {
+			sun6i_dma_enqueue(sdev, vchan);
+			tasklet_schedule(&sdev->task);
+		}
 		spin_unlock(&sdev->lock);
 	}
 
@@ -1163,7 +1463,7 @@ static int sun6i_dma_terminate_all(struct dma_chan *chan)
 {
 	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
 	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
-	struct sun6i_pchan *pchan = vchan->phy;
+	struct sun6i_pchan *pchan;
 	unsigned long flags;
 	LIST_HEAD(head);
 
@@ -1173,6 +1473,7 @@ static int sun6i_dma_terminate_all(struct dma_chan *chan)
 
 	spin_lock_irqsave(&vchan->vc.lock, flags);
 
+	pchan = vchan->phy;
 	if (vchan->cyclic) {
 		vchan->cyclic = false;
 		if (pchan && pchan->desc) {
@@ -1190,10 +1491,14 @@ static int sun6i_dma_terminate_all(struct dma_chan *chan)
 		writel(DMA_CHAN_ENABLE_STOP, pchan->base + DMA_CHAN_ENABLE);
 		writel(DMA_CHAN_PAUSE_RESUME, pchan->base + DMA_CHAN_PAUSE);
 
+		spin_lock(&sdev->lock);
 		vchan->phy = NULL;
 		pchan->vchan = NULL;
 		pchan->desc = NULL;
-		pchan->done = NULL;
+		spin_unlock(&sdev->lock);
+
+		/* Let the scheduler give the channel to the next waiter */
+		tasklet_schedule(&sdev->task);
 	}
 
 	spin_unlock_irqrestore(&vchan->vc.lock, flags);
@@ -1253,7 +1558,7 @@ static void sun6i_dma_issue_pending(struct dma_chan *chan)
 		spin_lock(&sdev->lock);
 
 		if (!vchan->phy && list_empty(&vchan->node)) {
-			list_add_tail(&vchan->node, &sdev->pending);
+			sun6i_dma_enqueue(sdev, vchan);
 			tasklet_schedule(&sdev->task);
 			dev_dbg(chan2dev(chan), "vchan %p: issued\n",
 				&vchan->vc);
@@ -1268,6 +1573,108 @@ static void sun6i_dma_issue_pending(struct dma_chan *chan)
 	spin_unlock_irqrestore(&vchan->vc.lock, flags);
 }
 
+static bool sun6i_dma_desc_busy(struct sun6i_vchan *vchan,
+				struct sun6i_desc *txd)
+{
+	struct virt_dma_desc *vd;
+
+	if (vchan->phy && vchan->phy->desc == txd)
+		return true;
+
+	list_for_each_entry(vd, &vchan->vc.desc_submitted, node)
+		if (vd == &txd->vd)
+			return true;
+
+	list_for_each_entry(vd, &vchan->vc.desc_issued, node)
+		if (vd == &txd->vd)
+			return true;
+
+	return false;
+}
+
+/**
+ * sunxi_dma_desc_update_sg - retarget a reusable slave descriptor
+ * @tx: descriptor prepared by dmaengine_prep_slave_sg() and marked with
+ *      dmaengine_desc_set_reuse()
+ * @sgl: new memory buffers
+ * @sg_len: number of entries, must match the prepared descriptor
+ *
+ * Only the memory side addresses and the lengths of the LLI chain are
+ * rewritten, the channel configuration is kept. The descriptor must not
+ * be queued; it may be submitted again with dmaengine_submit() afterwards.
+ */
+int sunxi_dma_desc_update_sg(struct dma_async_tx_descriptor *tx,
+			     struct scatterlist *sgl, unsigned int sg_len)
+{
+	struct sun6i_dma_dev *sdev;
+	struct sun6i_vchan *vchan;
+	struct sun6i_dma_lli *v_lli;
+	struct sun6i_desc *txd;
+	struct scatterlist *sg;
+	dma_addr_t addr, none = 0, all = ~(dma_addr_t)0;
+	unsigned long flags;
+	bool to_mem;
+	u32 mask;
+	int i, ret = 0;
+
+	if (!tx || !sgl || tx->chan->device->device_issue_pending !=
+	    sun6i_dma_issue_pending)
+		return -EINVAL;
+
+	sdev = to_sun6i_dma_dev(tx->chan->device);
+	vchan = to_sun6i_vchan(tx->chan);
+	txd = to_sun6i_desc(tx);
+
+	if (!dmaengine_desc_test_reuse(tx) || txd->nr_lli != sg_len ||
+	    txd->dir == DMA_DEV_TO_DEV)
+		return -EINVAL;
+
+	to_mem = txd->dir == DMA_DEV_TO_MEM;
+	mask = to_mem ? sun6i_dma_high_addr(sdev, none, all) :
+			sun6i_dma_high_addr(sdev, all, none);
+
+	spin_lock_irqsave(&vchan->vc.lock, flags);
+
+	if (sun6i_dma_desc_busy(vchan, txd)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	v_lli = txd->v_lli;
+	for_each_sg(sgl, sg, sg_len, i) {
+		addr = sg_dma_address(sg);
+
+		if (to_mem) {
+			v_lli->dst = addr;
+			v_lli->para = (v_lli->para & ~mask) |
+				      sun6i_dma_high_addr(sdev, none, addr);
+		} else {
+			v_lli->src = addr;
+			v_lli->para = (v_lli->para & ~mask) |
+				      sun6i_dma_high_addr(sdev, addr, none);
+		}
+		v_lli->len = sg_dma_len(sg);
+
+		v_lli = v_lli->v_lli_next;
+	}
+
+out:
+	spin_unlock_irqrestore(&vchan->vc.lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(sunxi_dma_desc_update_sg);
+
+static int sun6i_dma_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
+	struct sun6i_vchan *vchan = to_sun6i_vchan(chan);
+
+	sun6i_dma_cache_fill(sdev, vchan);
+
+	return 0;
+}
+
 static void sun6i_dma_free_chan_resources(struct dma_chan *chan)
 {
 	struct sun6i_dma_dev *sdev = to_sun6i_dma_dev(chan->device);
@@ -1276,9 +1683,11 @@ static void sun6i_dma_free_chan_resources(struct dma_chan *chan)
 
 	spin_lock_irqsave(&sdev->lock, flags);
 	list_del_init(&vchan->node);
+	vchan->prio = SUN6I_DMA_PRIO_BULK;
 	spin_unlock_irqrestore(&sdev->lock, flags);
 
 	vchan_free_chan_resources(&vchan->vc);
+	sun6i_dma_cache_drain(sdev, vchan);
 }
 
 static struct dma_chan *sun6i_dma_of_xlate(struct of_phandle_args *dma_spec,
@@ -1299,6 +1708,15 @@ static struct dma_chan *sun6i_dma_of_xlate(struct of_phandle_args *dma_spec,
 	vchan = to_sun6i_vchan(chan);
 	vchan->port = port;
 
+	/*
+	 * Peripheral channels are latency sensitive by default, an optional
+	 * second cell selects the class explicitly (0: realtime, 1: latency,
+	 * 2: bulk).
+	 */
+	vchan->prio = SUN6I_DMA_PRIO_LATENCY;
+	if (dma_spec->args_count > 1 && dma_spec->args[1] < SUN6I_DMA_PRIO_NR)
+		vchan->prio = dma_spec->args[1];
+
 	return chan;
 }
 
@@ -1732,6 +2150,98 @@ static const struct of_device_id sun6i_dma_match[] = {
 };
 MODULE_DEVICE_TABLE(of, sun6i_dma_match);
 
+static const char * const sun6i_dma_prio_name[SUN6I_DMA_PRIO_NR] = {
+	[SUN6I_DMA_PRIO_RT]		= "rt",
+	[SUN6I_DMA_PRIO_LATENCY]	= "latency",
+	[SUN6I_DMA_PRIO_BULK]		= "bulk",
+};
+
+static int sun6i_dma_sched_show(struct seq_file *s, void *unused)
+{
+	struct sun6i_dma_dev *sdev = s->private;
+	struct sun6i_vchan *vchan;
+	struct sun6i_pchan *pchan;
+	unsigned long flags;
+	int i, b;
+
+	spin_lock_irqsave(&sdev->lock, flags);
+
+	seq_printf(s, "pchans: %u (%u reserved for rt)\n",
+		   sdev->num_pchans, sdev->num_rt_pchans);
+	for (i = 0; i < sdev->num_pchans; i++) {
+		pchan = &sdev->pchans[i];
+		vchan = pchan->vchan;
+		if (vchan)
+			seq_printf(s, "  pchan%-2d vchan%-3d port %-3u %s\n", i,
+				   vchan->vc.chan.chan_id, vchan->port,
+				   sun6i_dma_prio_name[sun6i_vchan_prio(vchan)]);
+		else
+			seq_printf(s, "  pchan%-2d idle\n", i);
+	}
+
+	seq_puts(s, "\nqueue latency, log2(us) buckets:\n");
+	for (i = 0; i < sdev->num_vchans; i++) {
+		vchan = &sdev->vchans[i];
+		if (!vchan->lat_count)
+			continue;
+
+		seq_printf(s, "vchan%-3d port %-3u %-7s count %u max %uus\n ",
+			   vchan->vc.chan.chan_id, vchan->port,
+			   sun6i_dma_prio_name[sun6i_vchan_prio(vchan)],
+			   vchan->lat_count, vchan->lat_max_us);
+		for (b = 0; b < SUN6I_DMA_LAT_BUCKETS; b++)
+			seq_printf(s, " %u", vchan->lat_hist[b]);
+		seq_putc(s, '\n');
+	}
+
+	spin_unlock_irqrestore(&sdev->lock, flags);
+
+	return 0;
+}
+
+static int sun6i_dma_sched_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sun6i_dma_sched_show, inode->i_private);
+}
+
+/* Any write clears the latency statistics */
+static ssize_t sun6i_dma_sched_write(struct file *file, const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct sun6i_dma_dev *sdev = s->private;
+	struct sun6i_vchan *vchan;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&sdev->lock, flags);
+	for (i = 0; i < sdev->num_vchans; i++) {
+		vchan = &sdev->vchans[i];
+		vchan->lat_count = 0;
+		vchan->lat_max_us = 0;
+		memset(vchan->lat_hist, 0, sizeof(vchan->lat_hist));
+	}
+	spin_unlock_irqrestore(&sdev->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations sun6i_dma_sched_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sun6i_dma_sched_open,
+	.read		= seq_read,
+	.write		= sun6i_dma_sched_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void sun6i_dma_debugfs_init(struct sun6i_dma_dev *sdev)
+{
+	sdev->debugfs = debugfs_create_dir(dev_name(sdev->slave.dev), NULL);
+	debugfs_create_file("sched", 0644, sdev->debugfs, sdev,
+			    &sun6i_dma_sched_fops);
+}
+
 static int sun6i_dma_probe(struct platform_device *pdev)
 {
 	struct device_node *np = pdev->dev.of_node;
@@ -1792,7 +2302,8 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 	}
 
 	platform_set_drvdata(pdev, sdc);
-	INIT_LIST_HEAD(&sdc->pending);
+	for (i = 0; i < SUN6I_DMA_PRIO_NR; i++)
+		INIT_LIST_HEAD(&sdc->pending[i]);
 	spin_lock_init(&sdc->lock);
 
 	dma_cap_set(DMA_PRIVATE, sdc->slave.cap_mask);
@@ -1801,6 +2312,7 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 	dma_cap_set(DMA_CYCLIC, sdc->slave.cap_mask);
 
 	INIT_LIST_HEAD(&sdc->slave.channels);
+	sdc->slave.device_alloc_chan_resources	= sun6i_dma_alloc_chan_resources;
 	sdc->slave.device_free_chan_resources	= sun6i_dma_free_chan_resources;
 	sdc->slave.device_tx_status		= sun6i_dma_tx_status;
 	sdc->slave.device_issue_pending		= sun6i_dma_issue_pending;
@@ -1818,6 +2330,7 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 	sdc->slave.directions			= BIT(DMA_DEV_TO_MEM) |
 						  BIT(DMA_MEM_TO_DEV);
 	sdc->slave.residue_granularity		= DMA_RESIDUE_GRANULARITY_BURST;
+	sdc->slave.descriptor_reuse		= true;
 	sdc->slave.dev = &pdev->dev;
 
 	sdc->num_pchans = sdc->cfg->nr_max_channels;
@@ -1844,6 +2357,18 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 	if (!sdc->num_vchans)
 		sdc->num_vchans = 2 * (sdc->max_request + 1);
 
+	/*
+	 * Optionally keep some physical channels for cyclic transfers only,
+	 * at least one channel is always left to everybody else.
+	 */
+	of_property_read_u32(np, "allwinner,rt-reserved-channels",
+			     &sdc->num_rt_pchans);
+	if (sdc->num_rt_pchans >= sdc->num_pchans) {
+		dev_warn(&pdev->dev, "Too many reserved channels: %u\n",
+			 sdc->num_rt_pchans);
+		sdc->num_rt_pchans = 0;
+	}
+
 	sdc->pchans = devm_kcalloc(&pdev->dev, sdc->num_pchans,
 				   sizeof(struct sun6i_pchan), GFP_KERNEL);
 	if (!sdc->pchans)
@@ -1867,6 +2392,9 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 		struct sun6i_vchan *vchan = &sdc->vchans[i];
 
 		INIT_LIST_HEAD(&vchan->node);
+		INIT_LIST_HEAD(&vchan->txd_cache);
+		spin_lock_init(&vchan->cache_lock);
+		vchan->prio = SUN6I_DMA_PRIO_BULK;
 		vchan->vc.desc_free = sun6i_dma_free_desc;
 		vchan_init(&vchan->vc, &sdc->slave);
 	}
@@ -1940,6 +2468,8 @@ static int sun6i_dma_probe(struct platform_device *pdev)
 		writel(DMA_IRQ_MCU_DISABLE_MASK, sdc->base + DMA_IRQ_MCU_EN_REG);
 	}
 
+	sun6i_dma_debugfs_init(sdc);
+
 	dev_info(&pdev->dev, "sunxi dma probed, driver version: %s\n",
 			SUNXI_DMA_MODULE_VERSION);
 
@@ -1968,6 +2498,7 @@ static int sun6i_dma_remove(struct platform_device *pdev)
 {
 	struct sun6i_dma_dev *sdc = platform_get_drvdata(pdev);
 
+	debugfs_remove_recursive(sdc->debugfs);
 	of_dma_controller_free(pdev->dev.of_node);
 	dma_async_device_unregister(&sdc->slave);
 
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM sunxi_dsufreq
+
+#if !defined(_SUNXI_DSUFREQ_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SUNXI_DSUFREQ_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(dsufreq_gov_sample,
+	TP_PROTO(u64 l3, u64 refill, unsigned long bw_vote, unsigned long bw_freq,
+		 unsigned long cpu_vote, unsigned long cap),
+	TP_ARGS(l3, refill, bw_vote, bw_freq, cpu_vote, cap),
+	TP_STRUCT__entry(
+		__field(u64, l3)
+		__field(u64, refill)
+		__field(unsigned long, bw_vote)
+		__field(unsigned long, bw_freq)
+		__field(unsigned long, cpu_vote)
+		__field(unsigned long, cap)
+	),
+	TP_fast_assign(
+		__entry->l3 = l3;
+		__entry->refill = refill;
+		__entry->bw_vote = bw_vote;
+		__entry->bw_freq = bw_freq;
+		__entry->cpu_vote = cpu_vote;
+		__entry->cap = cap;
+	),
+
+	TP_printk("l3:%llu refill:%llu bw_vote:%lu bw_freq:%lu cpu_vote:%lu cap:%lu",
+		  __entry->l3, __entry->refill, __entry->bw_vote, __entry->bw_freq,
+		  __entry->cpu_vote, __entry->cap)
+);
+
+TRACE_EVENT(dsufreq_set_rate,
+	TP_PROTO(unsigned long old_freq, unsigned long new_freq, int ret),
+	TP_ARGS(old_freq, new_freq, ret),
+	TP_STRUCT__entry(
+		__field(unsigned long, old_freq)
+		__field(unsigned long, new_freq)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__entry->old_freq = old_freq;
+		__entry->new_freq = new_freq;
+		__entry->ret = ret;
+	),
+
+	TP_printk("%lu -> %lu Hz ret:%d", __entry->old_freq, __entry->new_freq,
+		  __entry->ret)
+);
+
+#endif /* _SUNXI_DSUFREQ_TRACE_H */
+
+/* This must be outside ifdef _SUNXI_DSUFREQ_TRACE_H */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE sunxi-dsufreq-trace
+#include <trace/define_trace.h>
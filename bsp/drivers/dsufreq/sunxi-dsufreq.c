@@ -19,6 +19,12 @@
 #include <linux/io.h>
 #include <sunxi-sid.h>
 #include <linux/version.h>
+#include <linux/cpu.h>
+#include <linux/perf_event.h>
+#include <linux/workqueue.h>
+
+#define CREATE_TRACE_POINTS
+#include "sunxi-dsufreq-trace.h"
 
 #define MAX_NAME_LEN                     8
 #define POLICY_NUM                       2
@@ -31,6 +37,57 @@
 #define CPUL_CORE_NUM			(0)
 #define FREQUENCY_SCALING_TRIGGER_MIN	(1000000)
 
+/*
+ * Bandwidth governor: a deferrable polling work reads L3 access and refill
+ * counters and turns them into a DSU frequency floor, on top of the vote
+ * derived from the cpu cluster frequencies. The voltage bound cap always
+ * wins. With pmu_type left at PERF_TYPE_RAW the events are counted per cpu
+ * by the cpu PMUs; each counter reports every raw_period events from its
+ * own overflow interrupt, so the work never has to IPI the cpus to read
+ * them and idle cpus stay idle. Pass the type of the arm_dsu PMU from
+ * /sys/bus/event_source/devices/arm_dsu_0/type to count them once for the
+ * whole cluster instead.
+ */
+static bool governor = true;
+module_param(governor, bool, 0444);
+MODULE_PARM_DESC(governor, "Enable the bandwidth governor at probe (default: Y)");
+
+static int pmu_type = PERF_TYPE_RAW;
+module_param(pmu_type, int, 0444);
+MODULE_PARM_DESC(pmu_type, "perf type of the counters, arm_dsu PMU type or PERF_TYPE_RAW");
+
+static unsigned int raw_period = 65536;
+module_param(raw_period, uint, 0444);
+MODULE_PARM_DESC(raw_period, "Events per overflow of the per cpu counters (default: 65536)");
+
+static unsigned int l3_event = 0x2b;
+module_param(l3_event, uint, 0444);
+MODULE_PARM_DESC(l3_event, "L3 access event (default: 0x2b, L3D_CACHE)");
+
+static unsigned int refill_event = 0x2a;
+module_param(refill_event, uint, 0444);
+MODULE_PARM_DESC(refill_event, "L3 miss event (default: 0x2a, L3D_CACHE_REFILL)");
+
+static unsigned int polling_ms = 50;
+module_param(polling_ms, uint, 0644);
+MODULE_PARM_DESC(polling_ms, "Governor sample period in ms (default: 50)");
+
+static unsigned int refill_cost = 2;
+module_param(refill_cost, uint, 0644);
+MODULE_PARM_DESC(refill_cost, "DSU cycles per L3 refill, one access is one cycle (default: 2)");
+
+static unsigned int target_util = 60;
+module_param(target_util, uint, 0644);
+MODULE_PARM_DESC(target_util, "Percent of DSU cycles L3 traffic may use (default: 60)");
+
+static unsigned int down_hyst = 10;
+module_param(down_hyst, uint, 0644);
+MODULE_PARM_DESC(down_hyst, "Percent the bandwidth vote must drop to lower the floor (default: 10)");
+
+static unsigned int down_hold = 3;
+module_param(down_hold, uint, 0644);
+MODULE_PARM_DESC(down_hold, "Samples the lower vote must persist (default: 3)");
+
 typedef enum {
 	DSUFREQ_NOT_SCALING = 0,
 	DSUFREQ_SCALING_DOWN,
@@ -43,6 +100,30 @@ struct dsu_opp_table {
 	unsigned long  volt_uv;
 };
 
+struct dsu_gov_counter {
+	struct perf_event             *l3;
+	struct perf_event             *refill;
+	u64                           l3_prev;
+	u64                           refill_prev;
+};
+
+struct dsu_gov_state {
+	unsigned long                 bw_freq;
+	unsigned int                  below;
+	u64                           samples;
+	u64                           raises;
+	u64                           drops;
+};
+
+struct dsu_gov_replay {
+	struct dsu_gov_state          state;
+	unsigned long                 target;
+	unsigned long                 min;
+	unsigned long                 max;
+	u64                           sum_khz;
+	u64                           changes;
+};
+
 struct sunxi_dsufreq_dev {
 	struct device                 *dev;
 	struct clk                    *clk;
@@ -61,6 +142,19 @@ struct sunxi_dsufreq_dev {
 	dsufreq_scaling_direction_e   scaling_direction;
 	unsigned int                  policy_cnt;
 	struct cpufreq_policy         *policy[POLICY_NUM];
+	/* serializes the cpufreq callbacks against the governor */
+	struct mutex                  lock;
+	bool                          in_transition;
+	bool                          gov_enabled;
+	struct delayed_work           gov_work;
+	ktime_t                       gov_last;
+	struct dsu_gov_counter        *counters;
+	int                           nr_counters;
+	/* per cpu counters: events reported by the overflow handler */
+	atomic64_t                    l3_acc;
+	atomic64_t                    refill_acc;
+	struct dsu_gov_state          gov;
+	struct dsu_gov_replay         replay;
 };
 
 static struct sunxi_dsufreq_dev *dsufreq_dev_temp;
@@ -133,19 +227,6 @@ static ssize_t dsu_cooling_store(struct class *class, struct class_attribute *at
 }
 static CLASS_ATTR_RW(dsu_cooling);
 
-static struct attribute *dsufreq_class_attrs[] = {
-	&class_attr_scaling_available_frequencies.attr,
-	&class_attr_scaling_cur_freq.attr,
-	&class_attr_dsu_cooling.attr,
-	NULL,
-};
-ATTRIBUTE_GROUPS(dsufreq_class);
-
-static struct class dsufreq_class = {
-	.name		= "dsufreq",
-	.class_groups	= dsufreq_class_groups,
-};
-
 static int _set_dsu_clk_only(struct device *dev, struct clk *clk,
 	unsigned long freq)
 {
@@ -159,6 +240,7 @@ static int _set_dsu_clk_only(struct device *dev, struct clk *clk,
 		WARN(1, "%s: dsu freq is abnormal: %lu KHz\n", __func__, freq/1000);
 
 	ret = clk_set_rate(clk, freq);
+	trace_dsufreq_set_rate(dsufreq_dev_temp ? dsufreq_dev_temp->cur_freq : 0, freq, ret);
 	if (ret)
 		sunxi_err(dev, "%s: failed to set clock rate: %d\n", __func__, ret);
 
@@ -198,6 +280,41 @@ static unsigned long get_dsu_max_freq_by_cur_volt(struct sunxi_dsufreq_dev *dsuf
 	return dsu_max_freq;
 }
 
+/* 3/4 of the cpu frequency, in 24MHz steps */
+static unsigned long dsu_freq_by_cpu_freq(unsigned long cpu_freq)
+{
+	unsigned long dsu_freq = (cpu_freq * 3)/4;
+
+	if (dsu_freq % 24000000)
+		dsu_freq -= (dsu_freq % 24000000);
+
+	return dsu_freq;
+}
+
+/* lowest opp that satisfies @freq, the highest one if none does */
+static unsigned long dsu_opp_ceil(struct sunxi_dsufreq_dev *dsufreq_dev, unsigned long freq)
+{
+	int i;
+
+	if (!freq)
+		return 0;
+
+	for (i = 0; i < dsufreq_dev->opp_count; i++) {
+		if (dsufreq_dev->opp[i].freq_hz >= freq)
+			return dsufreq_dev->opp[i].freq_hz;
+	}
+
+	return dsufreq_dev->opp[dsufreq_dev->opp_count - 1].freq_hz;
+}
+
+static unsigned long dsu_gov_floor(struct sunxi_dsufreq_dev *dsufreq_dev)
+{
+	if (!dsufreq_dev->gov_enabled)
+		return 0;
+
+	return dsu_opp_ceil(dsufreq_dev, dsufreq_dev->gov.bw_freq);
+}
+
 static unsigned long sunxi_get_dsu_next_freq(struct sunxi_dsufreq_dev *dsufreq_dev,
 	struct cpufreq_policy *policy, unsigned long freq, unsigned long *big_core_next_freq)
 {
@@ -205,9 +322,8 @@ static unsigned long sunxi_get_dsu_next_freq(struct sunxi_dsufreq_dev *dsufreq_d
 	unsigned long dsu_max_freq = 0;
 
 	*big_core_next_freq = 0;
-	dsu_next_freq = (freq * 3)/4;
-	if (dsu_next_freq % 24000000)
-		dsu_next_freq -= (dsu_next_freq % 24000000);
+	dsu_next_freq = dsu_freq_by_cpu_freq(freq);
+	dsu_next_freq = max(dsu_next_freq, dsu_gov_floor(dsufreq_dev));
 
 	dsu_max_freq = get_dsu_max_freq_by_cur_volt(dsufreq_dev, freq);
 
@@ -247,9 +363,8 @@ static unsigned long sunxi_big_little_get_dsu_next_freq(struct sunxi_dsufreq_dev
 		*big_core_next_freq = freq;
 	}
 
-	dsu_next_freq = (max_next_freq * 3)/4;
-	if (dsu_next_freq % 24000000)
-		dsu_next_freq -= (dsu_next_freq % 24000000);
+	dsu_next_freq = dsu_freq_by_cpu_freq(max_next_freq);
+	dsu_next_freq = max(dsu_next_freq, dsu_gov_floor(dsufreq_dev));
 
 	dsu_max_freq = get_dsu_max_freq_by_cur_volt(dsufreq_dev, little_core_next_freq);
 
@@ -266,6 +381,14 @@ static int set_dsufreq_scaling_down(struct cpufreq_policy *policy, unsigned long
 		return -ENODEV;
 	}
 
+	/*
+	 * The lock only covers this callback, in_transition stays set until
+	 * set_dsufreq_scaling_up() runs once the cpu opp is set, the governor
+	 * leaves the clock alone meanwhile.
+	 */
+	mutex_lock(&dsufreq_dev->lock);
+	dsufreq_dev->in_transition = true;
+
 	if (dsufreq_dev->policy_cnt == 1)
 		dsufreq_dev->next_freq = sunxi_get_dsu_next_freq(dsufreq_dev, policy, freq, &big_core_next_freq);
 	else
@@ -293,6 +416,7 @@ static int set_dsufreq_scaling_down(struct cpufreq_policy *policy, unsigned long
 	} else {
 		dsufreq_dev->scaling_direction = DSUFREQ_SCALING_UP;
 	}
+	mutex_unlock(&dsufreq_dev->lock);
 
 	return 0;
 }
@@ -302,6 +426,7 @@ static int set_dsufreq_scaling_up(struct cpufreq_policy *policy,
 {
 	struct sunxi_dsufreq_dev *dsufreq_dev = dsufreq_dev_temp;
 
+	mutex_lock(&dsufreq_dev->lock);
 	if ((dsufreq_dev->scaling_direction == DSUFREQ_SCALING_DOWN)
 		|| (dsufreq_dev->scaling_direction == DSUFREQ_SCALING_EXTEND)) {
 		if (set_opp_fail) {
@@ -324,10 +449,361 @@ static int set_dsufreq_scaling_up(struct cpufreq_policy *policy,
 		else
 			dsufreq_dev->big_core_cur_freq = freq;
 	}
+	dsufreq_dev->in_transition = false;
+	mutex_unlock(&dsufreq_dev->lock);
+
+	return 0;
+}
+
+/* DSU cycles per second the L3 traffic of one period needs at target_util */
+static unsigned long dsu_gov_bw_vote(u64 l3, u64 refill, unsigned int period_ms)
+{
+	u64 cycles = l3 + refill * refill_cost;
+
+	return div64_u64(cycles * MSEC_PER_SEC * 100,
+			 (u64)max(period_ms, 1U) * clamp(target_util, 1U, 100U));
+}
+
+/* follow a higher vote at once, a lower one after down_hold samples */
+static void dsu_gov_update(struct dsu_gov_state *st, unsigned long vote)
+{
+	st->samples++;
+
+	if (vote >= st->bw_freq) {
+		if (vote > st->bw_freq)
+			st->raises++;
+		st->bw_freq = vote;
+		st->below = 0;
+	} else if ((u64)vote * 100 < (u64)st->bw_freq * (100 - min(down_hyst, 100U))) {
+		if (++st->below >= down_hold) {
+			st->bw_freq = vote;
+			st->below = 0;
+			st->drops++;
+		}
+	} else {
+		st->below = 0;
+	}
+}
+
+/*
+ * The higher of the cpu and the bandwidth vote, bounded by the voltage the
+ * little cluster runs at. A fast big cluster keeps the DSU at least at the
+ * highest opp of the minimum voltage, like set_dsufreq_scaling_down() does.
+ */
+static unsigned long dsu_gov_target(struct sunxi_dsufreq_dev *dsufreq_dev,
+	unsigned long little_freq, unsigned long big_freq, unsigned long bw_freq,
+	unsigned long *cpu_vote, unsigned long *cap)
+{
+	unsigned long target;
+
+	*cpu_vote = dsu_freq_by_cpu_freq(max(little_freq, big_freq));
+	*cap = get_dsu_max_freq_by_cur_volt(dsufreq_dev, little_freq);
+	target = min(max(*cpu_vote, dsu_opp_ceil(dsufreq_dev, bw_freq)), *cap);
+	if (big_freq >= BIG_CORE_THRESHOLD_EXT)
+		target = max(target, DSU_MAX_FREQ_BY_MIN_VOLT);
+
+	return target;
+}
+
+static void dsu_gov_read(struct sunxi_dsufreq_dev *dsufreq_dev, u64 *l3, u64 *refill)
+{
+	struct dsu_gov_counter *counter;
+	u64 enabled, running, value;
+	int i;
+
+	if (pmu_type == PERF_TYPE_RAW) {
+		*l3 = atomic64_xchg(&dsufreq_dev->l3_acc, 0);
+		*refill = atomic64_xchg(&dsufreq_dev->refill_acc, 0);
+		return;
+	}
+
+	/* a single cluster wide pair, see dsu_gov_init_counters() */
+	*l3 = 0;
+	*refill = 0;
+	for (i = 0; i < dsufreq_dev->nr_counters; i++) {
+		counter = &dsufreq_dev->counters[i];
+
+		value = perf_event_read_value(counter->l3, &enabled, &running);
+		*l3 += value - counter->l3_prev;
+		counter->l3_prev = value;
+
+		value = perf_event_read_value(counter->refill, &enabled, &running);
+		*refill += value - counter->refill_prev;
+		counter->refill_prev = value;
+	}
+}
+
+static void dsu_gov_work(struct work_struct *work)
+{
+	struct sunxi_dsufreq_dev *dsufreq_dev = container_of(to_delayed_work(work),
+		struct sunxi_dsufreq_dev, gov_work);
+	unsigned long bw_vote, cpu_vote, cap, target;
+	ktime_t now = ktime_get();
+	u64 l3, refill;
+
+	dsu_gov_read(dsufreq_dev, &l3, &refill);
+	bw_vote = dsu_gov_bw_vote(l3, refill, ktime_ms_delta(now, dsufreq_dev->gov_last));
+	dsufreq_dev->gov_last = now;
+
+	mutex_lock(&dsufreq_dev->lock);
+	dsu_gov_update(&dsufreq_dev->gov, bw_vote);
+	/* a cpu opp change in flight applies the new floor by itself */
+	if (!dsufreq_dev->in_transition) {
+		target = dsu_gov_target(dsufreq_dev, dsufreq_dev->little_core_cur_freq,
+			dsufreq_dev->big_core_cur_freq, dsufreq_dev->gov.bw_freq, &cpu_vote, &cap);
+		trace_dsufreq_gov_sample(l3, refill, bw_vote, dsufreq_dev->gov.bw_freq,
+			cpu_vote, cap);
+		if ((target != dsufreq_dev->cur_freq) &&
+		    !_set_dsu_clk_only(dsufreq_dev->dev, dsufreq_dev->clk, target)) {
+			dsufreq_dev->prev_freq = dsufreq_dev->cur_freq;
+			dsufreq_dev->cur_freq = target;
+		}
+	}
+	mutex_unlock(&dsufreq_dev->lock);
+
+	queue_delayed_work(system_freezable_power_efficient_wq, &dsufreq_dev->gov_work,
+		msecs_to_jiffies(max(polling_ms, 1U)));
+}
+
+/* runs on the counting cpu, in the PMU interrupt */
+static void dsu_gov_overflow(struct perf_event *event, struct perf_sample_data *data,
+	struct pt_regs *regs)
+{
+	atomic64_add(event->hw.last_period, event->overflow_handler_context);
+}
+
+static struct perf_event *dsu_gov_create_event(int cpu, unsigned int config,
+	atomic64_t *acc)
+{
+	struct perf_event_attr attr = {
+		.type = pmu_type,
+		.size = sizeof(attr),
+		.config = config,
+		.pinned = 1,
+	};
+
+	if (pmu_type != PERF_TYPE_RAW)
+		return perf_event_create_kernel_counter(&attr, cpu, NULL, NULL, NULL);
+
+	attr.sample_period = max(raw_period, 1U);
+	return perf_event_create_kernel_counter(&attr, cpu, NULL, dsu_gov_overflow, acc);
+}
+
+static void dsu_gov_release_counters(struct sunxi_dsufreq_dev *dsufreq_dev)
+{
+	int i;
+
+	for (i = 0; i < dsufreq_dev->nr_counters; i++) {
+		perf_event_release_kernel(dsufreq_dev->counters[i].refill);
+		perf_event_release_kernel(dsufreq_dev->counters[i].l3);
+	}
+	dsufreq_dev->nr_counters = 0;
+}
+
+static int dsu_gov_init_counters(struct sunxi_dsufreq_dev *dsufreq_dev)
+{
+	struct dsu_gov_counter *counter;
+	int cpu, ret = 0;
+
+	if (!dsufreq_dev->counters) {
+		dsufreq_dev->counters = devm_kcalloc(dsufreq_dev->dev, nr_cpu_ids,
+			sizeof(*dsufreq_dev->counters), GFP_KERNEL);
+		if (!dsufreq_dev->counters)
+			return -ENOMEM;
+	}
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		counter = &dsufreq_dev->counters[dsufreq_dev->nr_counters];
+		memset(counter, 0, sizeof(*counter));
+
+		counter->l3 = dsu_gov_create_event(cpu, l3_event, &dsufreq_dev->l3_acc);
+		if (IS_ERR(counter->l3)) {
+			ret = PTR_ERR(counter->l3);
+			break;
+		}
+
+		counter->refill = dsu_gov_create_event(cpu, refill_event,
+			&dsufreq_dev->refill_acc);
+		if (IS_ERR(counter->refill)) {
+			ret = PTR_ERR(counter->refill);
+			perf_event_release_kernel(counter->l3);
+			break;
+		}
+		dsufreq_dev->nr_counters++;
+
+		/* the DSU PMU counts for the whole cluster */
+		if (pmu_type != PERF_TYPE_RAW)
+			break;
+	}
+	cpus_read_unlock();
+
+	if (ret)
+		dsu_gov_release_counters(dsufreq_dev);
+
+	return ret;
+}
+
+static int dsu_gov_start(struct sunxi_dsufreq_dev *dsufreq_dev)
+{
+	u64 l3, refill;
+	int ret;
+
+	if (dsufreq_dev->gov_enabled)
+		return 0;
+
+	if (!dsufreq_dev->nr_counters) {
+		ret = dsu_gov_init_counters(dsufreq_dev);
+		if (ret)
+			return ret;
+	}
+
+	dsu_gov_read(dsufreq_dev, &l3, &refill);
+	dsufreq_dev->gov_last = ktime_get();
+
+	mutex_lock(&dsufreq_dev->lock);
+	memset(&dsufreq_dev->gov, 0, sizeof(dsufreq_dev->gov));
+	dsufreq_dev->gov_enabled = true;
+	mutex_unlock(&dsufreq_dev->lock);
+
+	queue_delayed_work(system_freezable_power_efficient_wq, &dsufreq_dev->gov_work,
+		msecs_to_jiffies(max(polling_ms, 1U)));
 
 	return 0;
 }
 
+/* the floor is dropped, the next cpu opp change settles the clock */
+static void dsu_gov_stop(struct sunxi_dsufreq_dev *dsufreq_dev)
+{
+	if (!dsufreq_dev->gov_enabled)
+		return;
+
+	cancel_delayed_work_sync(&dsufreq_dev->gov_work);
+
+	mutex_lock(&dsufreq_dev->lock);
+	dsufreq_dev->gov_enabled = false;
+	dsufreq_dev->gov.bw_freq = 0;
+	mutex_unlock(&dsufreq_dev->lock);
+}
+
+static DEFINE_MUTEX(dsu_gov_ctl_lock);
+
+static ssize_t governor_show(struct class *class, struct class_attribute *attr,
+			 char *buf)
+{
+	struct sunxi_dsufreq_dev *dsufreq_dev = dsufreq_dev_temp;
+	struct dsu_gov_state *st = &dsufreq_dev->gov;
+
+	return sprintf(buf, "enabled:%d counters:%d floor:%luKHz samples:%llu raises:%llu drops:%llu\n",
+		dsufreq_dev->gov_enabled, dsufreq_dev->nr_counters,
+		dsu_gov_floor(dsufreq_dev)/1000, st->samples, st->raises, st->drops);
+}
+
+static ssize_t governor_store(struct class *class, struct class_attribute *attr,
+		const char *buf, size_t count)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool(buf, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&dsu_gov_ctl_lock);
+	if (enable) {
+		ret = dsu_gov_start(dsufreq_dev_temp);
+	} else {
+		dsu_gov_stop(dsufreq_dev_temp);
+		ret = 0;
+	}
+	mutex_unlock(&dsu_gov_ctl_lock);
+
+	return ret ? ret : count;
+}
+static CLASS_ATTR_RW(governor);
+
+static ssize_t governor_replay_show(struct class *class, struct class_attribute *attr,
+			 char *buf)
+{
+	struct dsu_gov_replay *r = &dsufreq_dev_temp->replay;
+
+	return sprintf(buf, "samples:%llu raises:%llu drops:%llu changes:%llu cur:%luKHz min:%luKHz max:%luKHz avg:%lluKHz\n",
+		r->state.samples, r->state.raises, r->state.drops, r->changes,
+		r->target/1000, r->min/1000, r->max/1000,
+		r->state.samples ? div64_u64(r->sum_khz, r->state.samples) : 0);
+}
+
+/*
+ * Runs a recorded trace through the governor without touching the clock,
+ * one "<little KHz> <big KHz> <l3 accesses> <l3 refills>" line per
+ * polling_ms period, "reset" clears the result.
+ */
+static ssize_t governor_replay_store(struct class *class, struct class_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct sunxi_dsufreq_dev *dsufreq_dev = dsufreq_dev_temp;
+	struct dsu_gov_replay *r = &dsufreq_dev->replay;
+	unsigned long little_khz, big_khz, cpu_vote, cap, target;
+	char *dup, *cur, *line;
+	u64 l3, refill;
+	int ret = 0;
+
+	if (sysfs_streq(buf, "reset")) {
+		mutex_lock(&dsufreq_dev->lock);
+		memset(r, 0, sizeof(*r));
+		mutex_unlock(&dsufreq_dev->lock);
+		return count;
+	}
+
+	dup = kstrndup(buf, count, GFP_KERNEL);
+	if (!dup)
+		return -ENOMEM;
+
+	mutex_lock(&dsufreq_dev->lock);
+	cur = dup;
+	while ((line = strsep(&cur, "\n"))) {
+		if (!*skip_spaces(line))
+			continue;
+
+		if (sscanf(line, "%lu %lu %llu %llu", &little_khz, &big_khz, &l3, &refill) != 4) {
+			ret = -EINVAL;
+			break;
+		}
+
+		dsu_gov_update(&r->state, dsu_gov_bw_vote(l3, refill, polling_ms));
+		target = dsu_gov_target(dsufreq_dev, little_khz * 1000, big_khz * 1000,
+			r->state.bw_freq, &cpu_vote, &cap);
+
+		if ((r->state.samples > 1) && (target != r->target))
+			r->changes++;
+		if (!r->min || target < r->min)
+			r->min = target;
+		r->max = max(r->max, target);
+		r->target = target;
+		r->sum_khz += target/1000;
+	}
+	mutex_unlock(&dsufreq_dev->lock);
+	kfree(dup);
+
+	return ret ? ret : count;
+}
+static CLASS_ATTR_RW(governor_replay);
+
+static struct attribute *dsufreq_class_attrs[] = {
+	&class_attr_scaling_available_frequencies.attr,
+	&class_attr_scaling_cur_freq.attr,
+	&class_attr_dsu_cooling.attr,
+	&class_attr_governor.attr,
+	&class_attr_governor_replay.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(dsufreq_class);
+
+static struct class dsufreq_class = {
+	.name		= "dsufreq",
+	.class_groups	= dsufreq_class_groups,
+};
+
 static void sunxi_dsu_nvmem(char *name)
 {
 	u32 index = 0x0100;
@@ -513,6 +989,11 @@ static int sunxi_dsufreq_probe(struct platform_device *pdev)
 	}
 
 	dsufreq_dev->cur_freq = clk_get_rate(dsufreq_dev->clk);
+	dsufreq_dev->little_core_cur_freq = (unsigned long)dsufreq_dev->policy[0]->cur * 1000;
+	if (dsufreq_dev->policy_cnt > 1)
+		dsufreq_dev->big_core_cur_freq = (unsigned long)dsufreq_dev->policy[1]->cur * 1000;
+	mutex_init(&dsufreq_dev->lock);
+	INIT_DEFERRABLE_WORK(&dsufreq_dev->gov_work, dsu_gov_work);
 	platform_set_drvdata(pdev, dsufreq_dev);
 	dsufreq_dev_temp = dsufreq_dev;
 	set_dsufreq_cb(set_dsufreq_scaling_down, set_dsufreq_scaling_up);
@@ -523,6 +1004,13 @@ static int sunxi_dsufreq_probe(struct platform_device *pdev)
 		return err;
 	}
 
+	if (governor) {
+		err = dsu_gov_start(dsufreq_dev);
+		if (err)
+			sunxi_warn(dev, "bandwidth governor off, no L3 counters: %d\n", err);
+		err = 0;
+	}
+
 #ifdef CONFIG_AW_SUNXI_DSUFREQ_ADJUST
 	policy = cpufreq_cpu_get(CPUL_CORE_NUM);
 	if (!policy) {
@@ -553,6 +1041,8 @@ static int sunxi_dsufreq_remove(struct platform_device *pdev)
 	struct device __maybe_unused *dev = &pdev->dev;
 
 	class_unregister(&dsufreq_class);
+	dsu_gov_stop(dsufreq_dev);
+	dsu_gov_release_counters(dsufreq_dev);
 	set_dsufreq_cb(NULL, NULL);
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5, 13, 0)
@@ -592,4 +1082,4 @@ MODULE_LICENSE("GPL v2");
 MODULE_DESCRIPTION("Allwinner dsufreq driver");
 MODULE_ALIAS("platform:sunxi_dsufreq");
 MODULE_AUTHOR("panzhijian <panzhijian@allwinnertech.com>");
-MODULE_VERSION("1.0.1");
+MODULE_VERSION("1.1.0");
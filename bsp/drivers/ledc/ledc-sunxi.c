@@ -29,6 +29,9 @@
 #include <linux/delay.h>
 #include <linux/regulator/consumer.h>
 #include <linux/reset.h>
+#include <linux/iopoll.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
 
 #if IS_ENABLED(CONFIG_PM)
 #include <linux/pm.h>
@@ -1202,6 +1205,82 @@ static void sunxi_ledc_dma_terminate(struct sunxi_led *led)
 	}
 }
 
+/*
+ * Frame pipeline: the frame buffers are allocated once at probe and stay
+ * mapped, the dma channel is requested and configured once when
+ * /dev/sunxi-ledc is opened. A queued frame has its descriptor prepared
+ * right away, the transfer finish interrupt of the previous frame only
+ * submits it and restarts the controller.
+ */
+
+/* called with led->lock held */
+static void sunxi_ledc_frame_start(struct sunxi_led *led, int index)
+{
+	struct sunxi_ledc_frame_buf *buf = &led->frame[index];
+	u32 reg_val;
+
+	led->frame_active = index;
+	led->length = buf->length;
+
+	/* the finish interrupt just soft reset the controller */
+	readl_poll_timeout_atomic(led->iomem_reg_base + LEDC_CTRL_REG_OFFSET,
+				  reg_val, !(reg_val & (1 << 1)), 0, 10);
+
+	dmaengine_submit(buf->desc);
+	buf->desc = NULL;
+	dma_async_issue_pending(led->dma_chan);
+
+	ktime_get_coarse_real_ts64(&(led->start_time));
+	sunxi_ledc_set_time(led);
+	sunxi_ledc_set_output_mode(led, led->output_mode.str);
+	sunxi_ledc_set_dma_mode(led);
+	sunxi_ledc_set_length(led);
+	sunxi_ledc_enable_irq(LEDC_TRANS_FINISH_INT_EN | LEDC_WAITDATA_TIMEOUT_INT_EN
+			| LEDC_FIFO_OVERFLOW_INT_EN | LEDC_GLOBAL_INT_EN);
+	sunxi_ledc_enable(led);
+}
+
+/* called with led->lock held */
+static void sunxi_ledc_frame_done(struct sunxi_led *led, bool ok)
+{
+	int next = led->frame_pending;
+
+	if (led->frame_active < 0)
+		return;
+
+	led->frame[led->frame_active].busy = false;
+	led->frame_active = -1;
+	if (ok)
+		led->frames_done++;
+	else
+		led->frames_dropped++;
+
+	if (next >= 0) {
+		led->frame_pending = -1;
+		sunxi_ledc_frame_start(led, next);
+	}
+
+	wake_up(&led->frame_wait);
+}
+
+/* called with led->lock held, the controller has been reset */
+static void sunxi_ledc_frame_abort(struct sunxi_led *led)
+{
+	int pending = led->frame_pending;
+
+	/* this also frees the prepared descriptor of the pending frame */
+	dmaengine_terminate_async(led->dma_chan);
+
+	if (pending >= 0) {
+		led->frame[pending].desc = NULL;
+		led->frame[pending].busy = false;
+		led->frame_pending = -1;
+		led->frames_dropped++;
+	}
+
+	sunxi_ledc_frame_done(led, false);
+}
+
 static int sunxi_ledc_complete(struct sunxi_led *led)
 {
 	unsigned long flags = 0;
@@ -1250,6 +1329,29 @@ static irqreturn_t sunxi_ledc_irq_handler(int irq, void *dev_id)
 
 	sunxi_ledc_clear_all_irq();
 
+	/* the frame pipeline drops a broken frame instead of retrying it */
+	if (led->frame_mode) {
+		if (irq_status & LEDC_TRANS_FINISH_INT) {
+			sunxi_ledc_reset(led);
+			sunxi_ledc_frame_done(led, true);
+		} else if (irq_status & LEDC_FIFO_OVERFLOW_INT) {
+			LED_ERR("fifo overflow, frame dropped!\n");
+			sunxi_ledc_reset(led);
+			sunxi_ledc_frame_abort(led);
+		} else if (irq_status & LEDC_WAITDATA_TIMEOUT_INT) {
+			ktime_get_coarse_real_ts64(&current_time);
+			delta_time_ns = current_time.tv_sec - led->start_time.tv_sec;
+			delta_time_ns *= 1000 * 1000 * 1000;
+			delta_time_ns += current_time.tv_nsec - led->start_time.tv_nsec;
+			if (delta_time_ns > led->wait_data_time_ns) {
+				LED_ERR("wait data timeout, frame dropped!\n");
+				sunxi_ledc_reset(led);
+				sunxi_ledc_frame_abort(led);
+			}
+		}
+		goto out;
+	}
+
 	if (irq_status & LEDC_TRANS_FINISH_INT) {
 		sunxi_ledc_reset(led);
 		led->length = 0;
@@ -1397,6 +1499,437 @@ static void sunxi_ledc_dma_put(struct sunxi_led *led)
 	}
 }
 
+static bool sunxi_ledc_frame_idle(struct sunxi_led *led)
+{
+	return READ_ONCE(led->frame_active) < 0 && READ_ONCE(led->frame_pending) < 0;
+}
+
+static int sunxi_ledc_frame_get(struct sunxi_led *led)
+{
+	struct dma_slave_config slave_config = { 0 };
+	int i, err;
+
+	mutex_lock(&led->mutex_lock);
+	if (led->frame_mode) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	err = sunxi_ledc_dma_get(led);
+	if (err)
+		goto out;
+
+	slave_config.direction = DMA_MEM_TO_DEV;
+	slave_config.dst_addr = led->res->start + LEDC_DATA_REG_OFFSET;
+	slave_config.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	slave_config.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	slave_config.src_maxburst = 4;
+	slave_config.dst_maxburst = 4;
+
+	err = dmaengine_slave_config(led->dma_chan, &slave_config);
+	if (err < 0) {
+		LED_ERR("dmaengine_slave_config failed!\n");
+		sunxi_ledc_dma_put(led);
+		goto out;
+	}
+
+	spin_lock_irq(&led->lock);
+	for (i = 0; i < SUNXI_LEDC_FRAME_BUFS; i++) {
+		led->frame[i].busy = false;
+		led->frame[i].desc = NULL;
+	}
+	led->frame_active = -1;
+	led->frame_pending = -1;
+	led->frames_done = 0;
+	led->frames_dropped = 0;
+	led->frame_mode = true;
+	spin_unlock_irq(&led->lock);
+
+out:
+	mutex_unlock(&led->mutex_lock);
+	return err;
+}
+
+static void sunxi_ledc_frame_put(struct sunxi_led *led)
+{
+	unsigned long flags;
+
+	mutex_lock(&led->mutex_lock);
+
+	/* let the queued frames go out, unless the controller is stuck */
+	if (!wait_event_timeout(led->frame_wait, sunxi_ledc_frame_idle(led), 5*HZ)) {
+		LED_ERR("frame pipeline timeout\n");
+		spin_lock_irqsave(&led->lock, flags);
+		sunxi_ledc_reset(led);
+		sunxi_ledc_frame_abort(led);
+		spin_unlock_irqrestore(&led->lock, flags);
+	}
+
+	spin_lock_irqsave(&led->lock, flags);
+	led->frame_mode = false;
+	led->length = 0;
+	spin_unlock_irqrestore(&led->lock, flags);
+
+	dmaengine_terminate_sync(led->dma_chan);
+	sunxi_ledc_dma_put(led);
+
+	mutex_unlock(&led->mutex_lock);
+}
+
+static int sunxi_ledc_frame_free_index(struct sunxi_led *led)
+{
+	unsigned long flags;
+	int i, index = -1;
+
+	spin_lock_irqsave(&led->lock, flags);
+	for (i = 0; i < SUNXI_LEDC_FRAME_BUFS; i++) {
+		if (!led->frame[i].busy) {
+			index = i;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&led->lock, flags);
+
+	return index;
+}
+
+/* returns a buffer that is neither queued nor shifting out */
+static int sunxi_ledc_frame_wait(struct sunxi_led *led, int timeout_ms)
+{
+	int index = -1;
+	long ret;
+
+	if (timeout_ms < 0) {
+		ret = wait_event_interruptible(led->frame_wait,
+			(index = sunxi_ledc_frame_free_index(led)) >= 0);
+	} else {
+		ret = wait_event_interruptible_timeout(led->frame_wait,
+			(index = sunxi_ledc_frame_free_index(led)) >= 0,
+			msecs_to_jiffies(timeout_ms));
+		if (!ret)
+			return -ETIMEDOUT;
+	}
+
+	return ret < 0 ? ret : index;
+}
+
+static int sunxi_ledc_frame_queue(struct sunxi_led *led, u32 index, u32 length)
+{
+	struct sunxi_ledc_frame_buf *buf;
+	unsigned long flags;
+	int ret = 0;
+
+	if (index >= SUNXI_LEDC_FRAME_BUFS || !length || length > led->led_count)
+		return -EINVAL;
+
+	buf = &led->frame[index];
+
+	/* prepared under the lock, an aborted frame terminates the channel */
+	spin_lock_irqsave(&led->lock, flags);
+	if (!led->frame_mode) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	if (buf->busy || led->frame_pending >= 0) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	buf->desc = dmaengine_prep_slave_single(led->dma_chan, buf->dma,
+						length * 4, DMA_MEM_TO_DEV,
+						DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!buf->desc) {
+		LED_ERR("dmaengine_prep_slave_single failed!\n");
+		ret = -ENOMEM;
+		goto out;
+	}
+	buf->length = length;
+	buf->busy = true;
+
+	if (led->frame_active < 0)
+		sunxi_ledc_frame_start(led, index);
+	else
+		led->frame_pending = index;
+
+out:
+	spin_unlock_irqrestore(&led->lock, flags);
+	return ret;
+}
+
+static int sunxi_ledc_frame_open(struct inode *inode, struct file *file)
+{
+	struct sunxi_led *led = container_of(file->private_data,
+					     struct sunxi_led, frame_misc);
+	int err;
+
+	err = sunxi_ledc_frame_get(led);
+	if (err)
+		return err;
+
+	file->private_data = led;
+
+	return 0;
+}
+
+static int sunxi_ledc_frame_release(struct inode *inode, struct file *file)
+{
+	sunxi_ledc_frame_put(file->private_data);
+
+	return 0;
+}
+
+static long sunxi_ledc_frame_ioctl(struct file *file, unsigned int cmd,
+				   unsigned long arg)
+{
+	struct sunxi_led *led = file->private_data;
+	void __user *uarg = (void __user *)arg;
+	struct sunxi_ledc_frame_info info;
+	struct sunxi_ledc_frame frame;
+	int ret;
+
+	switch (cmd) {
+	case SUNXI_LEDC_IOC_GET_INFO:
+		memset(&info, 0, sizeof(info));
+		info.led_count = led->led_count;
+		info.frame_size = led->frame_size;
+		info.nr_buffers = SUNXI_LEDC_FRAME_BUFS;
+		info.frames_done = led->frames_done;
+		info.frames_dropped = led->frames_dropped;
+		if (copy_to_user(uarg, &info, sizeof(info)))
+			return -EFAULT;
+		return 0;
+
+	case SUNXI_LEDC_IOC_WAIT_FRAME:
+		if (copy_from_user(&frame, uarg, sizeof(frame)))
+			return -EFAULT;
+		ret = sunxi_ledc_frame_wait(led, frame.timeout_ms);
+		if (ret < 0)
+			return ret;
+		frame.index = ret;
+		if (copy_to_user(uarg, &frame, sizeof(frame)))
+			return -EFAULT;
+		return 0;
+
+	case SUNXI_LEDC_IOC_QUEUE_FRAME:
+		if (copy_from_user(&frame, uarg, sizeof(frame)))
+			return -EFAULT;
+		return sunxi_ledc_frame_queue(led, frame.index, frame.length);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int sunxi_ledc_frame_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct sunxi_led *led = file->private_data;
+	size_t size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff || size > led->frame_size * SUNXI_LEDC_FRAME_BUFS)
+		return -EINVAL;
+
+	return dma_mmap_coherent(led->dev, vma, led->frame_vaddr,
+				 led->frame_dma, size);
+}
+
+static const struct file_operations sunxi_ledc_frame_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sunxi_ledc_frame_open,
+	.release	= sunxi_ledc_frame_release,
+	.unlocked_ioctl	= sunxi_ledc_frame_ioctl,
+#ifdef CONFIG_COMPAT
+	/* fixed size structures only, same layout for 32 bit callers */
+	.compat_ioctl	= sunxi_ledc_frame_ioctl,
+#endif
+	.mmap		= sunxi_ledc_frame_mmap,
+};
+
+static int sunxi_ledc_frame_init(struct sunxi_led *led)
+{
+	size_t size;
+	int i, err;
+
+	led->frame_active = -1;
+	led->frame_pending = -1;
+	init_waitqueue_head(&led->frame_wait);
+
+	led->frame_size = PAGE_ALIGN(led->led_count * sizeof(u32));
+	size = led->frame_size * SUNXI_LEDC_FRAME_BUFS;
+	led->frame_vaddr = dmam_alloc_coherent(led->dev, size, &led->frame_dma,
+					       GFP_KERNEL);
+	if (!led->frame_vaddr)
+		return -ENOMEM;
+
+	for (i = 0; i < SUNXI_LEDC_FRAME_BUFS; i++) {
+		led->frame[i].vaddr = led->frame_vaddr + i * led->frame_size;
+		led->frame[i].dma = led->frame_dma + i * led->frame_size;
+	}
+
+	led->frame_misc.minor = MISC_DYNAMIC_MINOR;
+	led->frame_misc.name = "sunxi-ledc";
+	led->frame_misc.fops = &sunxi_ledc_frame_fops;
+	led->frame_misc.parent = led->dev;
+
+	err = misc_register(&led->frame_misc);
+	if (err)
+		led->frame_misc.this_device = NULL;
+
+	return err;
+}
+
+static void sunxi_ledc_frame_deinit(struct sunxi_led *led)
+{
+	if (led->frame_misc.this_device)
+		misc_deregister(&led->frame_misc);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static char frame_bench_result[128];
+
+static void sunxi_ledc_bench_fill(u32 *data, u32 length, u32 frame)
+{
+	u32 i, v;
+
+	for (i = 0; i < length; i++) {
+		v = (frame + i) & 0x3f;
+		data[i] = (v << 16) | (((v + 21) & 0x3f) << 8) | ((v + 42) & 0x3f);
+	}
+}
+
+/* what led_store() does: map, configure, prepare and wait for every frame */
+static int sunxi_ledc_bench_legacy(struct sunxi_led *led, u32 frames,
+				   u32 length, u64 *ns)
+{
+	ktime_t start;
+	int err = 0;
+	u32 i;
+
+	mutex_lock(&led->mutex_lock);
+	if (led->frame_mode) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	start = ktime_get();
+	for (i = 0; i < frames; i++) {
+		sunxi_ledc_bench_fill(led->data, length, i);
+		led->length = length;
+
+		if (length > SUNXI_LEDC_FIFO_DEPTH) {
+			err = sunxi_ledc_dma_get(led);
+			if (err)
+				break;
+		}
+
+		sunxi_ledc_trans_data(led);
+		err = sunxi_ledc_complete(led);
+
+		if (length > SUNXI_LEDC_FIFO_DEPTH)
+			sunxi_ledc_dma_put(led);
+		if (err)
+			break;
+	}
+	*ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+out:
+	mutex_unlock(&led->mutex_lock);
+	return err;
+}
+
+static int sunxi_ledc_bench_frames(struct sunxi_led *led, u32 frames,
+				   u32 length, u64 *ns)
+{
+	ktime_t start;
+	int index, err;
+	u32 i;
+
+	err = sunxi_ledc_frame_get(led);
+	if (err)
+		return err;
+
+	start = ktime_get();
+	for (i = 0; i < frames; i++) {
+		index = sunxi_ledc_frame_wait(led, 5000);
+		if (index < 0) {
+			err = index;
+			break;
+		}
+
+		sunxi_ledc_bench_fill(led->frame[index].vaddr, length, i);
+		err = sunxi_ledc_frame_queue(led, index, length);
+		if (err)
+			break;
+	}
+
+	if (!err && !wait_event_timeout(led->frame_wait,
+					sunxi_ledc_frame_idle(led), 5*HZ))
+		err = -ETIMEDOUT;
+	*ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (!err && led->frames_dropped)
+		err = -EIO;
+
+	sunxi_ledc_frame_put(led);
+
+	return err;
+}
+
+static ssize_t frame_bench_write(struct file *filp, const char __user *buf,
+			size_t count, loff_t *offp)
+{
+	struct sunxi_led *led = sunxi_led_global;
+	u64 legacy_ns = 0, frame_ns = 0;
+	u32 frames, length;
+	char buffer[64];
+	int err;
+
+	if (count >= sizeof(buffer))
+		return -EINVAL;
+
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	buffer[count] = '\0';
+
+	if (sscanf(buffer, "%u %u", &frames, &length) != 2 || !frames ||
+	    !length || length > led->led_count) {
+		LED_ERR("usage: <frames> <leds>, leds 1-%u\n", led->led_count);
+		return -EINVAL;
+	}
+
+	err = sunxi_ledc_bench_legacy(led, frames, length, &legacy_ns);
+	if (!err)
+		err = sunxi_ledc_bench_frames(led, frames, length, &frame_ns);
+	if (err)
+		return err;
+
+	snprintf(frame_bench_result, sizeof(frame_bench_result),
+		 "%u frames x %u leds: legacy %llu fps, pipelined %llu fps\n",
+		 frames, length,
+		 div64_u64((u64)frames * NSEC_PER_SEC, max_t(u64, legacy_ns, 1)),
+		 div64_u64((u64)frames * NSEC_PER_SEC, max_t(u64, frame_ns, 1)));
+	pr_info("%s", frame_bench_result);
+
+	*offp += count;
+
+	return count;
+}
+
+static ssize_t frame_bench_read(struct file *filp, char __user *buf,
+			size_t count, loff_t *offp)
+{
+	return simple_read_from_buffer(buf, count, offp, frame_bench_result,
+				       strlen(frame_bench_result));
+}
+
+static const struct file_operations frame_bench_fops = {
+	.owner = THIS_MODULE,
+	.write = frame_bench_write,
+	.read  = frame_bench_read,
+};
+#endif /* CONFIG_DEBUG_FS */
+
 static int sunxi_set_led_brightness(struct led_classdev *led_cdev,
 			enum led_brightness value)
 {
@@ -1435,6 +1968,12 @@ static int sunxi_set_led_brightness(struct led_classdev *led_cdev,
 	if (((old_data >> shift) & 0xFF) == value)
 		return 0;
 
+	mutex_lock(&led->mutex_lock);
+	if (led->frame_mode) {
+		mutex_unlock(&led->mutex_lock);
+		return -EBUSY;
+	}
+
 	if (pinfo->type != LED_TYPE_R)
 		r = pcdev_group->r.cdev.brightness;
 	if (pinfo->type != LED_TYPE_G)
@@ -1454,8 +1993,10 @@ static int sunxi_set_led_brightness(struct led_classdev *led_cdev,
 	/* prepare for dma xfer, dynamic apply dma channel */
 	if (led->length > SUNXI_LEDC_FIFO_DEPTH) {
 		err = sunxi_ledc_dma_get(led);
-		if (err)
+		if (err) {
+			mutex_unlock(&led->mutex_lock);
 			return err;
+		}
 	}
 
 	sunxi_ledc_trans_data(led);
@@ -1467,8 +2008,9 @@ static int sunxi_set_led_brightness(struct led_classdev *led_cdev,
 	sunxi_ledc_complete(led);
 
 	/* dynamic release dma chan, release at the end of a transmission */
-	if (led->length > SUNXI_LEDC_FIFO_DEPTH)
+	if (length > SUNXI_LEDC_FIFO_DEPTH)
 		sunxi_ledc_dma_put(led);
+	mutex_unlock(&led->mutex_lock);
 
 	if (debug_mask & DEBUG_INFO1)
 		pr_warn("num = %03u\n", length);
@@ -1736,6 +2278,10 @@ static ssize_t led_store(struct class *class, struct class_attribute *attr,
 
 	/* This mutex is used to avoid concurrency problems when multiple user processes call led_store() at the same time. */
 	mutex_lock(&led->mutex_lock);
+	if (led->frame_mode) {
+		mutex_unlock(&led->mutex_lock);
+		return -EBUSY;
+	}
 
 	for (i = 0; i < len/3; i++) {
 		r = buf[i * 3];
@@ -1878,6 +2424,15 @@ static int sunxi_led_probe(struct platform_device *pdev)
 
 	mutex_init(&led->mutex_lock);
 
+	err = sunxi_ledc_frame_init(led);
+	if (err)
+		LED_ERR("frame interface not available: %d\n", err);
+#ifdef CONFIG_DEBUG_FS
+	else if (led->debugfs_dir)
+		debugfs_create_file("frame_bench", 0660, led->debugfs_dir, NULL,
+				    &frame_bench_fops);
+#endif /* CONFIG_DEBUG_FS */
+
 	dprintk(DEBUG_INIT, "finish\n");
 	return 0;
 
@@ -1914,6 +2469,8 @@ static int sunxi_led_remove(struct platform_device *pdev)
 {
 	struct sunxi_led *led = platform_get_drvdata(pdev);
 
+	sunxi_ledc_frame_deinit(led);
+
 	mutex_destroy(&led->mutex_lock);
 
 	class_destroy(led_class);
@@ -2111,7 +2668,7 @@ module_param_named(debug, debug_mask, int, 0664);
 
 MODULE_ALIAS("sunxi-ledc-dirver");
 MODULE_LICENSE("GPL v2");
-MODULE_VERSION("1.2.4");
+MODULE_VERSION("1.3.0");
 MODULE_AUTHOR("Albert Yu <yuxyun@allwinnertech.com>");
 MODULE_AUTHOR("liuyu <SWCliuyus@allwinnertech.com>");
 MODULE_DESCRIPTION("Allwinner ledc-controller driver");
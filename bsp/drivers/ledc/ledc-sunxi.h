@@ -14,11 +14,13 @@
 
 #include <linux/device.h>
 #include <linux/list.h>
+#include <linux/miscdevice.h>
 #include <linux/mutex.h>
 #include <linux/rwsem.h>
 #include <linux/spinlock.h>
 #include <linux/timer.h>
 #include <linux/workqueue.h>
+#include <linux/sunxi-ledc.h>
 
 #define HEXADECIMAL	(0x10)
 #define REG_INTERVAL	(0x04)
@@ -147,6 +149,15 @@ static u32 sunxi_led_regs_offset[] = {
 #endif
 };
 
+/* frame buffer of the /dev/sunxi-ledc pipeline */
+struct sunxi_ledc_frame_buf {
+	u32 *vaddr;
+	dma_addr_t dma;
+	u32 length;
+	bool busy;	/* queued or shifting out */
+	struct dma_async_tx_descriptor *desc;
+};
+
 struct sunxi_led {
 	u32 reset_ns;
 	u32 t1h_ns;
@@ -180,6 +191,18 @@ struct sunxi_led {
 	struct regulator *regulator;
 	struct reset_control *reset;
 	u32 regs_backup[ARRAY_SIZE(sunxi_led_regs_offset)];
+	/* frame pipeline, led->lock protects the buffer states */
+	struct miscdevice frame_misc;
+	struct sunxi_ledc_frame_buf frame[SUNXI_LEDC_FRAME_BUFS];
+	void *frame_vaddr;
+	dma_addr_t frame_dma;
+	size_t frame_size;
+	bool frame_mode;
+	int frame_active;
+	int frame_pending;
+	wait_queue_head_t frame_wait;
+	u64 frames_done;
+	u64 frames_dropped;
 };
 
 enum {
@@ -24,6 +24,10 @@
 #include <linux/slab.h>
 #include <linux/hwmon.h>
 #include <linux/hwmon-sysfs.h>
+#include <linux/hrtimer.h>
+#include <linux/cpuhotplug.h>
+#include <linux/perf_event.h>
+#include <linux/workqueue.h>
 #include <asm/cacheflush.h>
 
 #define DRIVER_NAME                 "MBUS"
@@ -1142,6 +1146,711 @@ mbus_master_manager_deinit(__maybe_unused struct device *dev)
 		devm_kfree(dev, mbus_master_manager.mbus_groups[0].attrs);
 }
 
+/*
+ * perf PMU and QoS regulator
+ *
+ * The bandwidth counters are 32 bit and free running. A periodic hrtimer
+ * folds them into 64 bit totals, which back the perf events, and hands the
+ * per period deltas to the regulator. The regulator raises QoS and priority
+ * of latency critical masters and caps bulk masters with the absolute
+ * bandwidth limit while a critical master gets less than it needs on a
+ * busy bus, or while a display driver reported underflow risk.
+ */
+#define MBUS_PERF_CNT_MAX		16
+#define MBUS_QOS_PORTS_MAX		8
+#define MBUS_PERF_PERIOD_MS		20
+#define MBUS_QOS_HOLD			10
+
+struct mbus_perf {
+	struct pmu pmu;
+	struct hrtimer timer;
+	ktime_t period;
+	unsigned int period_ms;
+	unsigned int unit;		/* bytes per counter step */
+	int cpu;			/* events live here, moved on hotplug */
+	enum cpuhp_state cpuhp_state;
+	atomic_t users;
+	raw_spinlock_t lock;
+	u32 last[MBUS_PERF_CNT_MAX];
+	u64 total[MBUS_PERF_CNT_MAX];
+	u64 tick_total[MBUS_PERF_CNT_MAX];
+	u64 delta[MBUS_PERF_CNT_MAX];
+	struct attribute **event_attrs;
+	struct attribute_group events_group;
+	bool registered;
+};
+
+static struct mbus_perf mbus_perf;
+
+struct mbus_qos_port {
+	u32 port;
+	u32 pmu;		/* critical masters only */
+	u32 min_bw;		/* MB/s, critical masters only */
+	u32 saved_qos;
+	u32 saved_pri;
+	u32 saved_abs;
+};
+
+struct mbus_qos_state {
+	bool risk;
+	u32 calm;
+	u64 samples;
+	u64 risky;
+	u64 boosts;
+};
+
+struct mbus_qos {
+	bool enabled;
+	bool applied;
+	int total_pmu;		/* -1: sum of all counters */
+	u32 busy_bw;		/* MB/s */
+	u32 bulk_limit;
+	u32 hold;
+	u32 nr_critical;
+	u32 nr_bulk;
+	struct mbus_qos_port critical[MBUS_QOS_PORTS_MAX];
+	struct mbus_qos_port bulk[MBUS_QOS_PORTS_MAX];
+	struct mbus_qos_state state;
+	struct mbus_qos_state replay;
+	atomic_t underflow;
+	struct work_struct work;
+	struct mutex lock;
+};
+
+static struct mbus_qos mbus_qos;
+
+static u64 mbus_perf_to_mbps(u64 delta)
+{
+	return div_u64(delta * mbus_perf.unit, mbus_perf.period_ms * 1000);
+}
+
+/* caller holds mbus_perf.lock */
+static void mbus_perf_update_locked(void)
+{
+	u32 value;
+	int i;
+
+	for (i = 0; i < mbus_master_manager.pmu_max; i++) {
+		value = readl_relaxed(mbus_ctrl_base + MBUS_PMU_CNT_REG(i));
+		mbus_perf.total[i] += (u32)(value - mbus_perf.last[i]);
+		mbus_perf.last[i] = value;
+	}
+}
+
+/**
+ * mbus_qos_decide() - one regulator step
+ *
+ * @qos: regulator configuration
+ * @st: state to advance, live or replay
+ * @delta: counter deltas of the last period
+ * @hint: a display driver reported underflow risk
+ *
+ * Return: true if the regulation state changed
+ */
+static bool mbus_qos_decide(struct mbus_qos *qos, struct mbus_qos_state *st,
+			    const u64 *delta, bool hint)
+{
+	bool starving = false, risky;
+	u64 total = 0;
+	int i;
+
+	if (qos->total_pmu >= 0) {
+		total = delta[qos->total_pmu];
+	} else {
+		for (i = 0; i < mbus_master_manager.pmu_max; i++)
+			total += delta[i];
+	}
+
+	/* an idle critical master is not at risk */
+	for (i = 0; i < qos->nr_critical; i++) {
+		u64 bw = mbus_perf_to_mbps(delta[qos->critical[i].pmu]);
+
+		if (bw && bw < qos->critical[i].min_bw)
+			starving = true;
+	}
+
+	risky = hint || (starving && mbus_perf_to_mbps(total) >= qos->busy_bw);
+
+	st->samples++;
+	if (risky) {
+		st->risky++;
+		st->calm = 0;
+		if (!st->risk) {
+			st->risk = true;
+			st->boosts++;
+			return true;
+		}
+	} else if (st->risk && ++st->calm >= qos->hold) {
+		st->risk = false;
+		return true;
+	}
+
+	return false;
+}
+
+static enum hrtimer_restart mbus_perf_timer_fn(struct hrtimer *timer)
+{
+	bool changed = false;
+	int i;
+
+	raw_spin_lock(&mbus_perf.lock);
+	mbus_perf_update_locked();
+	for (i = 0; i < mbus_master_manager.pmu_max; i++) {
+		mbus_perf.delta[i] = mbus_perf.total[i] - mbus_perf.tick_total[i];
+		mbus_perf.tick_total[i] = mbus_perf.total[i];
+	}
+
+	if (READ_ONCE(mbus_qos.enabled))
+		changed = mbus_qos_decide(&mbus_qos, &mbus_qos.state, mbus_perf.delta,
+					  atomic_xchg(&mbus_qos.underflow, 0));
+	raw_spin_unlock(&mbus_perf.lock);
+
+	if (changed)
+		schedule_work(&mbus_qos.work);
+
+	hrtimer_forward_now(timer, mbus_perf.period);
+
+	return HRTIMER_RESTART;
+}
+
+static void mbus_perf_get(void)
+{
+	unsigned long flags;
+	int i;
+
+	if (atomic_inc_return(&mbus_perf.users) != 1)
+		return;
+
+	if (!mbus_pmu_getstate())
+		mbus_pmu_enable();
+
+	/* whatever the counters did while nobody watched is not ours */
+	raw_spin_lock_irqsave(&mbus_perf.lock, flags);
+	for (i = 0; i < mbus_master_manager.pmu_max; i++) {
+		mbus_perf.last[i] = readl_relaxed(mbus_ctrl_base + MBUS_PMU_CNT_REG(i));
+		mbus_perf.tick_total[i] = mbus_perf.total[i];
+	}
+	raw_spin_unlock_irqrestore(&mbus_perf.lock, flags);
+
+	hrtimer_start(&mbus_perf.timer, mbus_perf.period, HRTIMER_MODE_REL);
+}
+
+static void mbus_perf_put(void)
+{
+	if (atomic_dec_and_test(&mbus_perf.users))
+		hrtimer_cancel(&mbus_perf.timer);
+}
+
+static u64 mbus_perf_read_total(unsigned int idx)
+{
+	unsigned long flags;
+	u64 total;
+
+	raw_spin_lock_irqsave(&mbus_perf.lock, flags);
+	mbus_perf_update_locked();
+	total = mbus_perf.total[idx];
+	raw_spin_unlock_irqrestore(&mbus_perf.lock, flags);
+
+	return total;
+}
+
+static void mbus_perf_event_update(struct perf_event *event)
+{
+	u64 now = mbus_perf_read_total(event->attr.config);
+	u64 prev = local64_xchg(&event->hw.prev_count, now);
+
+	local64_add((now - prev) * mbus_perf.unit, &event->count);
+}
+
+static int mbus_perf_event_init(struct perf_event *event)
+{
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	/* uncore counters: no sampling, no task context */
+	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+		return -EOPNOTSUPP;
+
+	if (event->cpu < 0)
+		return -EINVAL;
+
+	if (event->attr.config >= mbus_master_manager.pmu_max ||
+	    event->attr.config >= MBUS_PERF_CNT_MAX)
+		return -EINVAL;
+
+	event->cpu = mbus_perf.cpu;
+
+	return 0;
+}
+
+static void mbus_perf_event_start(struct perf_event *event, int flags)
+{
+	local64_set(&event->hw.prev_count, mbus_perf_read_total(event->attr.config));
+	event->hw.state = 0;
+}
+
+static void mbus_perf_event_stop(struct perf_event *event, int flags)
+{
+	if (event->hw.state & PERF_HES_STOPPED)
+		return;
+
+	if (flags & PERF_EF_UPDATE)
+		mbus_perf_event_update(event);
+	event->hw.state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int mbus_perf_event_add(struct perf_event *event, int flags)
+{
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	mbus_perf_get();
+	if (flags & PERF_EF_START)
+		mbus_perf_event_start(event, flags);
+
+	return 0;
+}
+
+static void mbus_perf_event_del(struct perf_event *event, int flags)
+{
+	mbus_perf_event_stop(event, PERF_EF_UPDATE);
+	mbus_perf_put();
+}
+
+static ssize_t mbus_perf_cpumask_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	return cpumap_print_to_pagebuf(true, buf, cpumask_of(mbus_perf.cpu));
+}
+
+static DEVICE_ATTR(cpumask, 0444, mbus_perf_cpumask_show, NULL);
+PMU_FORMAT_ATTR(master, "config:0-7");
+
+static struct attribute *mbus_perf_format_attrs[] = {
+	&format_attr_master.attr,
+	NULL,
+};
+
+static struct attribute_group mbus_perf_format_group = {
+	.name = "format",
+	.attrs = mbus_perf_format_attrs,
+};
+
+static struct attribute *mbus_perf_cpumask_attrs[] = {
+	&dev_attr_cpumask.attr,
+	NULL,
+};
+
+static struct attribute_group mbus_perf_cpumask_group = {
+	.attrs = mbus_perf_cpumask_attrs,
+};
+
+static const struct attribute_group *mbus_perf_groups[] = {
+	&mbus_perf_format_group,
+	&mbus_perf.events_group,
+	&mbus_perf_cpumask_group,
+	NULL,
+};
+
+/* one "events/<master_pmu_names>" alias per counter from the fdt */
+static int mbus_perf_events_init(struct device *dev, int count)
+{
+	struct perf_pmu_events_attr *attrs;
+	int i;
+
+	mbus_perf.event_attrs = devm_kcalloc(dev, count + 1, sizeof(*mbus_perf.event_attrs),
+					     GFP_KERNEL);
+	attrs = devm_kcalloc(dev, count, sizeof(*attrs), GFP_KERNEL);
+	if (!mbus_perf.event_attrs || !attrs)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		sysfs_attr_init(&attrs[i].attr.attr);
+		attrs[i].attr.attr.name = mbus_master_manager.name_buf[i];
+		attrs[i].attr.attr.mode = 0444;
+		attrs[i].attr.show = perf_event_sysfs_show;
+		attrs[i].id = mbus_master_manager.pmu_idxs[i];
+		attrs[i].event_str = devm_kasprintf(dev, GFP_KERNEL, "master=0x%x",
+						    mbus_master_manager.pmu_idxs[i]);
+		if (!attrs[i].event_str)
+			return -ENOMEM;
+		mbus_perf.event_attrs[i] = &attrs[i].attr.attr;
+	}
+
+	mbus_perf.events_group.name = "events";
+	mbus_perf.events_group.attrs = mbus_perf.event_attrs;
+
+	return 0;
+}
+
+/* hand the events over to another cpu when theirs goes offline */
+static int mbus_perf_offline_cpu(unsigned int cpu)
+{
+	unsigned int target;
+
+	if (cpu != mbus_perf.cpu)
+		return 0;
+
+	target = cpumask_any_but(cpu_online_mask, cpu);
+	if (target >= nr_cpu_ids)
+		return 0;
+
+	perf_pmu_migrate_context(&mbus_perf.pmu, cpu, target);
+	mbus_perf.cpu = target;
+
+	return 0;
+}
+
+static int mbus_perf_init(struct device *dev, int nr_events)
+{
+	u32 period_ms = MBUS_PERF_PERIOD_MS, unit = 1;
+	int ret;
+
+	if (mbus_master_manager.pmu_max > MBUS_PERF_CNT_MAX) {
+		dev_warn(dev, "%d counters, perf supports %d\n",
+			 mbus_master_manager.pmu_max, MBUS_PERF_CNT_MAX);
+		mbus_master_manager.pmu_max = MBUS_PERF_CNT_MAX;
+	}
+
+	of_property_read_u32(dev->of_node, "pmu-sample-ms", &period_ms);
+	of_property_read_u32(dev->of_node, "pmu-unit-bytes", &unit);
+	mbus_perf.period_ms = max_t(u32, period_ms, 1);
+	mbus_perf.period = ms_to_ktime(mbus_perf.period_ms);
+	mbus_perf.unit = max_t(u32, unit, 1);
+	mbus_perf.cpu = raw_smp_processor_id();
+	atomic_set(&mbus_perf.users, 0);
+	raw_spin_lock_init(&mbus_perf.lock);
+	hrtimer_init(&mbus_perf.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	mbus_perf.timer.function = mbus_perf_timer_fn;
+
+	ret = mbus_perf_events_init(dev, nr_events);
+	if (ret)
+		return ret;
+
+	mbus_perf.pmu = (struct pmu) {
+		.module		= THIS_MODULE,
+		.task_ctx_nr	= perf_invalid_context,
+		.capabilities	= PERF_PMU_CAP_NO_EXCLUDE,
+		.attr_groups	= mbus_perf_groups,
+		.event_init	= mbus_perf_event_init,
+		.add		= mbus_perf_event_add,
+		.del		= mbus_perf_event_del,
+		.start		= mbus_perf_event_start,
+		.stop		= mbus_perf_event_stop,
+		.read		= mbus_perf_event_update,
+	};
+
+	ret = perf_pmu_register(&mbus_perf.pmu, "sunxi_mbus", -1);
+	if (ret)
+		return ret;
+
+	ret = cpuhp_setup_state_nocalls(CPUHP_AP_ONLINE_DYN, "perf/sunxi_mbus:online",
+					NULL, mbus_perf_offline_cpu);
+	if (ret < 0) {
+		perf_pmu_unregister(&mbus_perf.pmu);
+		return ret;
+	}
+	mbus_perf.cpuhp_state = ret;
+	mbus_perf.registered = true;
+
+	return 0;
+}
+
+static void mbus_perf_exit(void)
+{
+	if (mbus_perf.registered) {
+		cpuhp_remove_state_nocalls(mbus_perf.cpuhp_state);
+		perf_pmu_unregister(&mbus_perf.pmu);
+	}
+	mbus_perf.registered = false;
+}
+
+static u32 mbus_port_getqos(u32 port)
+{
+	return (readl_relaxed(mbus_ctrl_base + MBUS_MAST_CFG0_REG(port)) >>
+		MBUS_QOS_SHIFT) & MBUS_QOS_MAX;
+}
+
+static u32 mbus_port_getpri(u32 port)
+{
+#if (defined MBUS_MAST_ACPR_CFG_REG)
+	return (readl_relaxed(mbus_ctrl_base + MBUS_MAST_ACPR_CFG_REG) >> port) & 1;
+#else
+	return (readl_relaxed(mbus_ctrl_base + MBUS_MAST_CFG0_REG(port)) >>
+		MBUS_PRI_SHIFT) & 1;
+#endif
+}
+
+static void mbus_qos_apply(bool risk)
+{
+	struct mbus_qos_port *p;
+	int i;
+
+	if (risk == mbus_qos.applied)
+		return;
+
+	for (i = 0; i < mbus_qos.nr_critical; i++) {
+		p = &mbus_qos.critical[i];
+		if (risk) {
+			p->saved_qos = mbus_port_getqos(p->port);
+			p->saved_pri = mbus_port_getpri(p->port);
+			mbus_port_setqos(p->port, MBUS_QOS_MAX);
+			mbus_port_setpri(p->port, 1);
+		} else {
+			mbus_port_setqos(p->port, p->saved_qos);
+			mbus_port_setpri(p->port, p->saved_pri);
+		}
+	}
+
+	for (i = 0; i < mbus_qos.nr_bulk; i++) {
+		p = &mbus_qos.bulk[i];
+		if (risk) {
+			p->saved_abs = readl_relaxed(mbus_ctrl_base +
+						     MBUS_MAST_ABS_BWL_REG(p->port));
+			mbus_port_set_abs_bwl(p->port, mbus_qos.bulk_limit);
+			mbus_port_set_abs_bwlen(p->port, 1);
+		} else {
+			mbus_port_set_abs_bwl(p->port, (p->saved_abs >> MBUS_ABS_BWL_SHIFT) &
+					      MBUS_ABS_BWL_MAX);
+			mbus_port_set_abs_bwlen(p->port, (p->saved_abs >> MBUS_ABS_BWLEN_SHIFT) & 1);
+		}
+	}
+
+	mbus_qos.applied = risk;
+}
+
+static void mbus_qos_work(struct work_struct *work)
+{
+	mutex_lock(&mbus_qos.lock);
+	mbus_qos_apply(READ_ONCE(mbus_qos.state.risk) && mbus_qos.enabled);
+	mutex_unlock(&mbus_qos.lock);
+}
+
+/**
+ * mbus_qos_underflow_hint() - report display underflow risk
+ *
+ * Lets a display driver that sees its FIFO running low force one risky
+ * regulator sample, in addition to the bandwidth based detection.
+ */
+void mbus_qos_underflow_hint(void)
+{
+	atomic_set(&mbus_qos.underflow, 1);
+}
+EXPORT_SYMBOL_GPL(mbus_qos_underflow_hint);
+
+static void mbus_qos_set_enabled(bool enable)
+{
+	mutex_lock(&mbus_qos.lock);
+	if (enable == mbus_qos.enabled) {
+		mutex_unlock(&mbus_qos.lock);
+		return;
+	}
+
+	WRITE_ONCE(mbus_qos.enabled, enable);
+	if (!enable) {
+		raw_spin_lock_irq(&mbus_perf.lock);
+		mbus_qos.state.risk = false;
+		mbus_qos.state.calm = 0;
+		raw_spin_unlock_irq(&mbus_perf.lock);
+		mbus_qos_apply(false);
+	}
+	mutex_unlock(&mbus_qos.lock);
+
+	if (enable)
+		mbus_perf_get();
+	else
+		mbus_perf_put();
+}
+
+static int mbus_qos_parse_ports(struct device_node *np, const char *prop,
+				struct mbus_qos_port *ports)
+{
+	int i, count = of_property_count_u32_elems(np, prop);
+
+	if (count <= 0)
+		return 0;
+
+	count = min(count, MBUS_QOS_PORTS_MAX);
+	for (i = 0; i < count; i++) {
+		of_property_read_u32_index(np, prop, i, &ports[i].port);
+		if (ports[i].port >= MBUS_PORTS_MAX)
+			return -EINVAL;
+	}
+
+	return count;
+}
+
+/*
+ * qos-critical-ports, qos-critical-pmus and qos-critical-min-bw describe the
+ * latency critical masters (display, VIN), qos-bulk-ports the masters that
+ * get throttled (GPU, VE, NPU) to qos-bulk-limit. Regulation starts when the
+ * bus carries at least qos-busy-bw MB/s, measured on qos-total-pmu or the
+ * sum of all counters.
+ */
+static int mbus_qos_init(struct device *dev)
+{
+	struct device_node *np = dev->of_node;
+	int ret, i, nr_critical;
+
+	mutex_init(&mbus_qos.lock);
+	INIT_WORK(&mbus_qos.work, mbus_qos_work);
+	atomic_set(&mbus_qos.underflow, 0);
+	mbus_qos.total_pmu = -1;
+	mbus_qos.hold = MBUS_QOS_HOLD;
+	mbus_qos.bulk_limit = MBUS_ABS_BWL_MAX / 4;
+
+	/* nr_critical turns the regulator on, only set it once all is valid */
+	ret = mbus_qos_parse_ports(np, "qos-critical-ports", mbus_qos.critical);
+	if (ret <= 0)
+		return ret;
+	nr_critical = ret;
+
+	for (i = 0; i < nr_critical; i++) {
+		of_property_read_u32_index(np, "qos-critical-pmus", i,
+					   &mbus_qos.critical[i].pmu);
+		of_property_read_u32_index(np, "qos-critical-min-bw", i,
+					   &mbus_qos.critical[i].min_bw);
+		if (mbus_qos.critical[i].pmu >= mbus_master_manager.pmu_max)
+			return -EINVAL;
+	}
+
+	ret = mbus_qos_parse_ports(np, "qos-bulk-ports", mbus_qos.bulk);
+	if (ret < 0)
+		return ret;
+	mbus_qos.nr_bulk = ret;
+	mbus_qos.nr_critical = nr_critical;
+
+	of_property_read_u32(np, "qos-bulk-limit", &mbus_qos.bulk_limit);
+	of_property_read_u32(np, "qos-busy-bw", &mbus_qos.busy_bw);
+	of_property_read_u32(np, "qos-hold-samples", &mbus_qos.hold);
+	of_property_read_s32(np, "qos-total-pmu", &mbus_qos.total_pmu);
+	if (mbus_qos.total_pmu >= mbus_master_manager.pmu_max)
+		mbus_qos.total_pmu = -1;
+	mbus_qos.bulk_limit = min_t(u32, mbus_qos.bulk_limit, MBUS_ABS_BWL_MAX);
+
+	mbus_qos_set_enabled(true);
+
+	dev_info(dev, "qos regulator: %u critical, %u bulk masters\n",
+		 mbus_qos.nr_critical, mbus_qos.nr_bulk);
+
+	return 0;
+}
+
+static void mbus_qos_exit(void)
+{
+	if (!mbus_qos.nr_critical)
+		return;
+
+	mbus_qos_set_enabled(false);
+	cancel_work_sync(&mbus_qos.work);
+}
+
+static ssize_t qos_regulator_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct mbus_qos_state *st = &mbus_qos.state;
+
+	return sprintf(buf, "enabled:%u active:%u samples:%llu risky:%llu boosts:%llu\n",
+		       mbus_qos.enabled, mbus_qos.applied, st->samples, st->risky,
+		       st->boosts);
+}
+
+static ssize_t qos_regulator_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool(buf, &enable);
+	if (ret)
+		return ret;
+
+	if (!mbus_qos.nr_critical)
+		return -ENODEV;
+
+	mbus_qos_set_enabled(enable);
+
+	return count;
+}
+
+static ssize_t qos_replay_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct mbus_qos_state *st = &mbus_qos.replay;
+
+	return sprintf(buf, "samples:%llu risky:%llu boosts:%llu regulating:%u\n",
+		       st->samples, st->risky, st->boosts, st->risk);
+}
+
+/*
+ * Feeds recorded counter deltas through the live decision logic without
+ * touching the hardware: one line per pmu-sample-ms period with the delta
+ * of every counter in counter index order, "reset" clears the result.
+ */
+static ssize_t qos_replay_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	u64 delta[MBUS_PERF_CNT_MAX];
+	char *dup, *line, *tok, *cur;
+	int i, ret = 0;
+
+	if (sysfs_streq(buf, "reset")) {
+		mutex_lock(&mbus_qos.lock);
+		memset(&mbus_qos.replay, 0, sizeof(mbus_qos.replay));
+		mutex_unlock(&mbus_qos.lock);
+		return count;
+	}
+
+	if (!mbus_qos.nr_critical)
+		return -ENODEV;
+
+	dup = kstrndup(buf, count, GFP_KERNEL);
+	if (!dup)
+		return -ENOMEM;
+
+	mutex_lock(&mbus_qos.lock);
+	cur = dup;
+	while ((line = strsep(&cur, "\n"))) {
+		if (!*line)
+			continue;
+
+		memset(delta, 0, sizeof(delta));
+		for (i = 0; (tok = strsep(&line, " \t")); ) {
+			if (!*tok)
+				continue;
+			if (i >= mbus_master_manager.pmu_max) {
+				ret = -EINVAL;
+				goto out;
+			}
+			ret = kstrtou64(tok, 0, &delta[i++]);
+			if (ret)
+				goto out;
+		}
+
+		mbus_qos_decide(&mbus_qos, &mbus_qos.replay, delta, false);
+	}
+
+out:
+	mutex_unlock(&mbus_qos.lock);
+	kfree(dup);
+
+	return ret ? ret : count;
+}
+
+static DEVICE_ATTR_RW(qos_regulator);
+static DEVICE_ATTR_RW(qos_replay);
+
+static struct attribute *mbus_qos_attrs[] = {
+	&dev_attr_qos_regulator.attr,
+	&dev_attr_qos_replay.attr,
+	NULL,
+};
+
+static const struct attribute_group mbus_qos_group = {
+	.attrs = mbus_qos_attrs,
+};
+
 static int mbus_pmu_probe(struct platform_device *pdev)
 {
 	int ret;
@@ -1167,6 +1876,19 @@ static int mbus_pmu_probe(struct platform_device *pdev)
 	hw_mbus_pmu.valid = 0;
 	mutex_init(&hw_mbus_pmu.update_lock);
 
+	ret = mbus_perf_init(&pdev->dev,
+			     of_property_count_u32_elems(pdev->dev.of_node, "master_pmu_idxs"));
+	if (ret)
+		dev_warn(&pdev->dev, "perf pmu not registered: %d\n", ret);
+
+	ret = mbus_qos_init(&pdev->dev);
+	if (ret)
+		dev_warn(&pdev->dev, "qos regulator disabled: %d\n", ret);
+
+	ret = devm_device_add_group(&pdev->dev, &mbus_qos_group);
+	if (ret)
+		dev_warn(&pdev->dev, "qos sysfs not created: %d\n", ret);
+
 	return 0;
 
 out_err:
@@ -1178,6 +1900,8 @@ out_err:
 
 static int mbus_pmu_remove(struct platform_device *pdev)
 {
+	mbus_qos_exit();
+	mbus_perf_exit();
 	hwmon_device_unregister(hw_mbus_pmu.hwmon_dev);
 	mbus_master_manager_deinit(&pdev->dev);
 	sysfs_remove_group(&pdev->dev.kobj, mbus_master_manager.mbus_groups);
@@ -1245,4 +1969,4 @@ device_initcall(mbus_pmu_init);
 MODULE_LICENSE("GPL v2");
 MODULE_DESCRIPTION("SUNXI GENERIC MBUS Driver");
 MODULE_AUTHOR("ouyangkun <ouyangkun@allwinnertech.com>");
-MODULE_VERSION("1.0.0");
+MODULE_VERSION("1.1.0");
@@ -770,6 +770,37 @@ sunxi_mmc_set_perf(struct device *dev, struct device_attribute *attr,
 	return count;
 }
 
+static ssize_t
+sunxi_mmc_show_des_stat(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct mmc_host	*mmc = platform_get_drvdata(pdev);
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
+	struct sunxi_mmc_des_stat *stat = &host->des_stat;
+
+	return sprintf(buf, "prebuilt: %llu\n"
+			"rebuilt: %llu\n"
+			"merged segments: %llu\n"
+			"auto cmd23: %llu\n",
+			stat->prebuilt, stat->rebuilt,
+			stat->merged, stat->acmd23);
+}
+
+static ssize_t
+sunxi_mmc_clear_des_stat(struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct mmc_host	*mmc = platform_get_drvdata(pdev);
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
+
+	mmc_claim_host(mmc);
+	memset(&host->des_stat, 0, sizeof(host->des_stat));
+	mmc_release_host(mmc);
+
+	return count;
+}
+
 extern void sunxi_mmc_set_ds_dl_raw(struct sunxi_mmc_host *host, int sunxi_ds_dl);
 extern void sunxi_mmc_set_samp_dl_raw(struct sunxi_mmc_host *host, int sunxi_samp_dl);
 extern ssize_t sunxi_mmc_panic_rtest(struct device *dev, struct device_attribute *attr, char *buf);
@@ -1095,6 +1126,15 @@ int mmc_create_sys_fs(struct sunxi_mmc_host *host, struct platform_device *pdev)
 	host->host_mwr.attr.mode = S_IRUGO | S_IWUSR;
 	ret = device_create_file(&pdev->dev, &host->host_mwr);
 
+	host->host_des_stat.show = sunxi_mmc_show_des_stat;
+	host->host_des_stat.store = sunxi_mmc_clear_des_stat;
+	sysfs_attr_init(&(host->host_des_stat.attr));
+	host->host_des_stat.attr.name = "sunxi_host_des_stat";
+	host->host_des_stat.attr.mode = S_IRUGO | S_IWUSR;
+	ret = device_create_file(&pdev->dev, &host->host_des_stat);
+	if (ret)
+		return ret;
+
 	host->sd_detect_pin_status.show = sunxi_detect_pin_status;
 	sysfs_attr_init(&(host->sd_detect_pin_status.attr));
 	host->sd_detect_pin_status.attr.name = "sunxi_sd_detect_pin_status";
@@ -1130,6 +1170,7 @@ void mmc_remove_sys_fs(struct sunxi_mmc_host *host,
 {
 	device_remove_file(&pdev->dev, &host->host_mwr);
 	device_remove_file(&pdev->dev, &host->host_perf);
+	device_remove_file(&pdev->dev, &host->host_des_stat);
 	device_remove_file(&pdev->dev, &host->maual_insert);
 	device_remove_file(&pdev->dev, &host->dump_register[0]);
 	device_remove_file(&pdev->dev, &host->dump_register[1]);
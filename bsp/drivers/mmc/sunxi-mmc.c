@@ -640,89 +640,164 @@ static int sunxi_mmc_init_host(struct mmc_host *mmc)
 	return 0;
 }
 
+static u32 sunxi_mmc_fill_idma_des(struct sunxi_mmc_host *host,
+				   struct sunxi_mmc_des_ring *ring, u32 n,
+				   dma_addr_t addr, u32 len)
+{
+	struct sunxi_idma_des *pdes = (struct sunxi_idma_des *)ring->cpu;
+	u32 max_len = host->mmc->max_seg_size;
+	u32 size;
+
+	while (len) {
+		size = min(len, max_len);
+		pdes[n].config = SDXC_IDMAC_DES0_CH | SDXC_IDMAC_DES0_OWN |
+				 SDXC_IDMAC_DES0_DIC;
+		pdes[n].buf_size = size;
+		pdes[n].buf_addr_ptr1 = sunxi_mmc_host_des_addr(host, addr);
+		pdes[n].buf_addr_ptr2 = (u32)sunxi_mmc_host_des_addr(host,
+				ring->dma + (n + 1) * sizeof(struct sunxi_idma_des));
+		addr += size;
+		len -= size;
+		n++;
+	}
+
+	return n;
+}
+
 static void sunxi_mmc_init_idma_des(struct sunxi_mmc_host *host,
-				    struct mmc_data *data)
+				    struct mmc_data *data,
+				    struct sunxi_mmc_des_ring *ring)
 {
-	struct sunxi_idma_des *pdes = (struct sunxi_idma_des *)host->sg_cpu;
-	struct sunxi_idma_des *pdes_pa = (struct sunxi_idma_des *)host->sg_dma;
+	struct sunxi_idma_des *pdes = (struct sunxi_idma_des *)ring->cpu;
 	struct mmc_host *mmc = host->mmc;
 	struct scatterlist *sg = NULL;
-	int i = 0, j = 0;
-	int count = 0;
-	int cycles_count = 0;
-	unsigned int remainder = 0;
-/*
-*	unsigned long tick = 0;
-*	static int old_data_is_read = 123;
-*/
+	dma_addr_t addr = 0;
+	u32 len = 0, n = 0, merged = 0;
+	int i;
 
-	for (i = 0; i < data->sg_len; i++) {
-		sg = sg ?  sg_next(sg) : (data->sg);
-		cycles_count = (sg->length - 1) / mmc->max_seg_size + 1;
-		remainder = ((sg->length - 1) % (mmc->max_seg_size)) + 1;
-		for (j = 0; j < cycles_count; j++) {
-/*
-*			tick = jiffies + msecs_to_jiffies(250) + 1;
-*			if (((pdes[i + count].config) & SDXC_IDMAC_DES0_OWN) && (host->mrq_retry == NULL)) {
-*				if (host->phy_index == 1) {
-*					SM_ERR(mmc_dev(mmc), "old_data_is_read - %d\n", old_data_is_read);
-*				}
-*			}
-*			while (((pdes[i + count].config) & SDXC_IDMAC_DES0_OWN) && (host->mrq_retry == NULL)) {
-*				if(!time_before(jiffies, tick))  {
-*					if ((pdes[i + count].config) & SDXC_IDMAC_DES0_OWN)
-*						SM_ERR(mmc_dev(mmc), "wait dma owns clear timeout \n");
-*					break;
-*				}
-*			}
-*/
-			pdes[i + count].config = SDXC_IDMAC_DES0_CH | SDXC_IDMAC_DES0_OWN |
-			    SDXC_IDMAC_DES0_DIC;
-			pdes[i + count].buf_size = (j != (cycles_count - 1)) ? (mmc->max_seg_size):(remainder);
-			pdes[i + count].buf_addr_ptr1 = sunxi_mmc_host_des_addr(host,
-								sg_dma_address(sg) + j * mmc->max_seg_size);
-			/* We use size_t only to avoid compile waring */
-			/*  pdes[i].buf_addr_ptr2 = (u32) (size_t) &pdes_pa[i + 1]; */
-			pdes[i + count].buf_addr_ptr2 = (u32)sunxi_mmc_host_des_addr(host, (size_t)&pdes_pa[i + count + 1]);
-			count++;
+	for_each_sg(data->sg, sg, data->sg_len, i) {
+		/* segments that are back to back in bus space share a descriptor */
+		if (len && (addr + len == sg_dma_address(sg))
+				&& (len + sg->length <= mmc->max_seg_size)) {
+			len += sg->length;
+			merged++;
+			continue;
 		}
-		count--;
+		n = sunxi_mmc_fill_idma_des(host, ring, n, addr, len);
+		addr = sg_dma_address(sg);
+		len = sg->length;
 	}
+	n = sunxi_mmc_fill_idma_des(host, ring, n, addr, len);
 
-	if ((i + count) > mmc->max_segs) {
+	if (n > mmc->max_segs) {
 		SM_ERR(mmc_dev(mmc), "sg_len greater than max_segs\n");
 	}
 
 	pdes[0].config |= SDXC_IDMAC_DES0_FD;
-	pdes[i + count - 1].config |= SDXC_IDMAC_DES0_LD;
-	pdes[i + count - 1].config &= ~SDXC_IDMAC_DES0_DIC;
-	host->des_cnt = i + count;
+	pdes[n - 1].config |= SDXC_IDMAC_DES0_LD;
+	pdes[n - 1].config &= ~SDXC_IDMAC_DES0_DIC;
+	ring->des_cnt = n;
+	host->des_stat.merged += merged;
 
 	/*
 	 * **Avoid the io-store starting the idmac hitting io-mem before the
 	 * descriptors hit the main-mem.
 	 */
 	wmb();
+}
+
+/* Build the chain of a pre mapped request into a free ring */
+static void sunxi_mmc_prebuild_des(struct sunxi_mmc_host *host,
+				   struct mmc_data *data)
+{
+	struct sunxi_mmc_des_ring *ring = NULL;
+	unsigned long iflags;
+	int i;
+
+	if (data->host_cookie != COOKIE_PRE_MAPPED
+			|| host->sunxi_mmc_on_off_emce)
+		return;
+
+	spin_lock_irqsave(&host->des_lock, iflags);
+	for (i = 1; i < SUNXI_DES_RING_NUM; i++) {
+		if (!host->des_ring[i].data) {
+			ring = &host->des_ring[i];
+			ring->data = data;
+			ring->prebuilt = false;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&host->des_lock, iflags);
+
+	if (!ring)
+		return;
+
+	sunxi_mmc_init_idma_des(host, data, ring);
+
+	spin_lock_irqsave(&host->des_lock, iflags);
+	ring->prebuilt = true;
+	spin_unlock_irqrestore(&host->des_lock, iflags);
+}
+
 /*
-*	if (host->phy_index == 1) {
-*		if (data->flags & MMC_DATA_READ)
-*			old_data_is_read = 1;
-*		else if (data->flags & MMC_DATA_WRITE)
-*			old_data_is_read = 0;
-*		else
-*			SM_ERR(mmc_dev(mmc), "--------data->flags error\n");
-*	}
-*/
+ * Pick the ring for a request that is about to start. A prebuilt chain
+ * is used as is, otherwise the chain is (re)built, e.g. for a retry the
+ * idmac has already cleared the OWN bits of the first run.
+ */
+static struct sunxi_mmc_des_ring *sunxi_mmc_get_des_ring(struct sunxi_mmc_host *host,
+							 struct mmc_data *data)
+{
+	struct sunxi_mmc_des_ring *ring = &host->des_ring[0];
+	unsigned long iflags;
+	bool prebuilt = false;
+	int i;
+
+	spin_lock_irqsave(&host->des_lock, iflags);
+	for (i = 1; i < SUNXI_DES_RING_NUM; i++) {
+		if (host->des_ring[i].data == data) {
+			ring = &host->des_ring[i];
+			prebuilt = ring->prebuilt;
+			ring->prebuilt = false;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&host->des_lock, iflags);
+
+	if (prebuilt) {
+		host->des_stat.prebuilt++;
+	} else {
+		sunxi_mmc_init_idma_des(host, data, ring);
+		host->des_stat.rebuilt++;
+	}
+
+	return ring;
+}
+
+static void sunxi_mmc_put_des_ring(struct sunxi_mmc_host *host,
+				   struct mmc_data *data)
+{
+	unsigned long iflags;
+	int i;
+
+	spin_lock_irqsave(&host->des_lock, iflags);
+	for (i = 1; i < SUNXI_DES_RING_NUM; i++) {
+		if (host->des_ring[i].data == data) {
+			host->des_ring[i].data = NULL;
+			host->des_ring[i].prebuilt = false;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&host->des_lock, iflags);
 }
 
 static void sunxi_mmc_wait_dma_done(struct sunxi_mmc_host *host,
 				    struct mmc_data *data)
 {
-	struct sunxi_idma_des *pdes = (struct sunxi_idma_des *)host->sg_cpu;
+	struct sunxi_idma_des *pdes = (struct sunxi_idma_des *)host->des_cur->cpu;
 	struct mmc_host *mmc = host->mmc;
 	int i = 0, j = 0;
 
-	for (i = 0; i < host->des_cnt; i++) {
+	for (i = 0; i < host->des_cur->des_cnt; i++) {
 		for (j = 0; j < SUNXI_DES_CLR_WAIT_CNT; j++) {
 			if (!(pdes[i].config & SDXC_IDMAC_DES0_OWN))
 				break;
@@ -809,9 +884,11 @@ static int sunxi_mmc_map_dma(struct sunxi_mmc_host *host, struct mmc_data *data,
 static int sunxi_mmc_start_dma(struct sunxi_mmc_host *host,
 				struct mmc_data *data, bool atomic)
 {
+	struct sunxi_mmc_des_ring *ring;
 	u32 rval;
 
-	sunxi_mmc_init_idma_des(host, data);
+	ring = sunxi_mmc_get_des_ring(host, data);
+	host->des_cur = ring;
 
 	if (!atomic) {
 		sunxi_mmc_reset_fifo(host);
@@ -833,6 +910,8 @@ static int sunxi_mmc_start_dma(struct sunxi_mmc_host *host,
 		}
 	}
 
+	mmc_writel(host, REG_DLBA, sunxi_mmc_host_des_addr(host, ring->dma));
+
 	rval = mmc_readl(host, REG_GCTRL);
 	rval |= SDXC_DMA_ENABLE_BIT;
 	mmc_writel(host, REG_GCTRL, rval);
@@ -1048,8 +1127,10 @@ static int sunxi_mmc_finalize_request(struct sunxi_mmc_host *host)
 		mmc_writel(host, REG_GCTRL, rval);
 		rval |= SDXC_FIFO_RESET;
 		mmc_writel(host, REG_GCTRL, rval);
-		if (host->mrq_retry == NULL)
+		if (host->mrq_retry == NULL) {
 			sunxi_mmc_wait_dma_done(host, data);
+			sunxi_mmc_put_des_ring(host, data);
+		}
 		if (data->host_cookie != COOKIE_PRE_MAPPED) {
 			dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
 				     sunxi_mmc_get_dma_dir(data));
@@ -2524,8 +2605,10 @@ static int sunxi_mmc_set_dat(struct sunxi_mmc_host *host, struct mmc_host *mmc,
 	ret = sunxi_mmc_start_dma(host, data, atomic);
 	if (ret)
 		return -EBUSY;
-	if (host->sunxi_mmc_opacmd23 && sbc)
+	if (host->sunxi_mmc_opacmd23 && sbc) {
 		host->sunxi_mmc_opacmd23(host, true, sbc->arg, NULL);
+		host->des_stat.acmd23++;
+	}
 	return 0;
 }
 
@@ -2553,9 +2636,11 @@ static void sunxi_mmc_exe_cmd(struct sunxi_mmc_host *host,
 static void sunxi_mmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
 				int err)
 {
+	struct sunxi_mmc_host *host = mmc_priv(mmc);
 	struct mmc_data *data = mrq->data;
 	/* SM_DBG(mmc_dev(mmc), "int post request\n"); */
 
+	sunxi_mmc_put_des_ring(host, data);
 	if (data->host_cookie != COOKIE_UNMAPPED) {
 		dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len,
 			     sunxi_mmc_get_dma_dir(data));
@@ -2572,6 +2657,7 @@ static void sunxi_mmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq)
 	data->host_cookie = COOKIE_UNMAPPED;
 
 	sunxi_mmc_map_dma(host, data, COOKIE_PRE_MAPPED);
+	sunxi_mmc_prebuild_des(host, data);
 	SM_DBG(mmc_dev(mmc), "prepare request %p\n", data);
 
 }
@@ -2837,6 +2923,7 @@ static void sunxi_mmc_request(struct mmc_host *mmc, struct mmc_request *mrq)
 				ret = redeposit_read_data(info, data->sg, data->sg_len, (cmd->arg), data->blocks);
 			} else if ((data->flags & MMC_DATA_WRITE)) {
 				write_io_num(info);
+				redeposit_invalidate(info, mrq->cmd->arg, data->blocks);
 			}
 
 			if (ret == true) {
@@ -3796,7 +3883,12 @@ static int sunxi_mmc_extra_of_parse(struct mmc_host *mmc)
 		}
 	}
 
-	if (of_property_read_bool(np, "cap-cmd23"))
+	/*
+	 * With auto cmd23 the block count goes out in hardware, so use
+	 * pre-defined transfers whenever the card supports them.
+	 */
+	if (of_property_read_bool(np, "cap-cmd23")
+			|| (host->sunxi_mmc_opacmd23 && !of_property_read_bool(np, "no-cmd23")))
 		mmc->caps |= MMC_CAP_CMD23;
 	if (of_property_read_bool(np, "cap-pack-write"))
 		mmc->caps2 |= MMC_CAP2_PACKED_WR;
@@ -3938,7 +4030,7 @@ static int sunxi_mmc_probe(struct platform_device *pdev)
 #if IS_ENABLED(CONFIG_AW_MMC_CQHCI)
 	struct cqhci_host *cq_host;
 #endif
-	int ret;
+	int ret, i;
 	/* define for sizeof count */
 	struct sunxi_idma_des *for_sizeof;
 
@@ -3996,13 +4088,19 @@ static int sunxi_mmc_probe(struct platform_device *pdev)
 	host->dma_mask = DMA_BIT_MASK(64);
 	pdev->dev.coherent_dma_mask = DMA_BIT_MASK(64);
 	pdev->dev.dma_mask = &host->dma_mask;
-	host->sg_cpu = dma_alloc_coherent(&pdev->dev, PAGE_SIZE * host->req_page_count,
+	host->sg_cpu = dma_alloc_coherent(&pdev->dev, SUNXI_DES_MEM_SIZE(host),
 					  &host->sg_dma, GFP_KERNEL);
 	if (!host->sg_cpu) {
 		SM_ERR(&pdev->dev, "Failed to allocate DMA descriptor mem\n");
 		ret = -ENOMEM;
 		goto error_free_host;
 	}
+	spin_lock_init(&host->des_lock);
+	for (i = 0; i < SUNXI_DES_RING_NUM; i++) {
+		host->des_ring[i].cpu = host->sg_cpu + i * PAGE_SIZE * host->req_page_count;
+		host->des_ring[i].dma = host->sg_dma + i * PAGE_SIZE * host->req_page_count;
+	}
+	host->des_cur = &host->des_ring[0];
 
 	mmc->ops = &sunxi_mmc_ops;
 	mmc->max_blk_count = 8192;
@@ -4096,7 +4194,7 @@ static int sunxi_mmc_probe(struct platform_device *pdev)
 	return 0;
 
 error_free_dma:
-	dma_free_coherent(&pdev->dev, PAGE_SIZE * host->req_page_count, host->sg_cpu,
+	dma_free_coherent(&pdev->dev, SUNXI_DES_MEM_SIZE(host), host->sg_cpu,
 			  host->sg_dma);
 error_free_host:
 	mmc_free_host(mmc);
@@ -4136,7 +4234,7 @@ static int sunxi_mmc_remove(struct platform_device *pdev)
 		regulator_disable(host->supply.vdmmc);
 	sunxi_mmc_regulator_release_supply(mmc);
 
-	dma_free_coherent(&pdev->dev, PAGE_SIZE * host->req_page_count, host->sg_cpu,
+	dma_free_coherent(&pdev->dev, SUNXI_DES_MEM_SIZE(host), host->sg_cpu,
 			  host->sg_dma);
 	mmc_free_host(mmc);
 
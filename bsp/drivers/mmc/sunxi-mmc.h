@@ -311,6 +311,34 @@ struct sunxi_idma_des {
 	volatile u32 buf_addr_ptr2;
 };
 
+/*
+ * Descriptor chains: ring 0 is built when a request is started,
+ * the others are filled by pre_req() while the previous request
+ * is still on the bus.
+ */
+#define SUNXI_DES_RING_NUM	4
+#define SUNXI_DES_MEM_SIZE(host)	\
+	(PAGE_SIZE * (host)->req_page_count * SUNXI_DES_RING_NUM)
+
+struct sunxi_mmc_des_ring {
+	void *cpu;
+	dma_addr_t dma;
+	u32 des_cnt;
+	/* request the chain belongs to, NULL if the ring is free */
+	struct mmc_data *data;
+	/* chain has not been handed to the idmac yet */
+	bool prebuilt;
+};
+
+struct sunxi_mmc_des_stat {
+	u64 prebuilt;
+	u64 rebuilt;
+	/* contiguous segments folded into one descriptor */
+	u64 merged;
+	/* requests sent with hardware auto cmd23 */
+	u64 acmd23;
+};
+
 struct sunxi_mmc_ctrl_regs {
 	u32 gctrl;
 	u32 clkc;
@@ -391,9 +419,13 @@ struct sunxi_mmc_host {
 	/* dma */
 	u32 req_page_count;
 	u32 idma_des_size_bits;
-	u32 des_cnt;
 	dma_addr_t sg_dma;
 	void *sg_cpu;
+	struct sunxi_mmc_des_ring des_ring[SUNXI_DES_RING_NUM];
+	/* ring the idmac is working on */
+	struct sunxi_mmc_des_ring *des_cur;
+	spinlock_t des_lock;
+	struct sunxi_mmc_des_stat des_stat;
 	bool wait_dma;
 	u32 dma_tl;
 	u64 dma_mask;
@@ -531,6 +563,7 @@ struct sunxi_mmc_host {
 	unsigned int filter_speed;
 	unsigned int debounce_value;
 	struct device_attribute host_mwr;
+	struct device_attribute host_des_stat;
 
 	void *version_priv_dat;
 
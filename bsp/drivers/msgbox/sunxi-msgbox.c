@@ -24,7 +24,16 @@
 #include <linux/reset.h>
 #include <linux/spinlock.h>
 #include <linux/bitops.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/mailbox_client.h>
 #include <linux/mailbox_controller.h>
+#include <linux/sunxi-msgbox.h>
 
 #define SUNXI_MSGBOX_OFFSET(n)			(0x100 * (n))
 #define SUNXI_MSGBOX_READ_IRQ_ENABLE(n)		(0x20 + SUNXI_MSGBOX_OFFSET(n))
@@ -61,6 +70,21 @@
 #define WR_IRQ_THR_MASK			0x3
 #define WR_IRQ_THR_SHIFT		0
 
+/* SUNXI_MSGBOX_DEBUG_REGISTER */
+#define DBG_MODE_EN_MASK		0x1
+#define DBG_MODE_EN_SHIFT		0
+
+/* Words popped from a FIFO per burst read, at least the FIFO depth */
+#define SUNXI_MSGBOX_RX_BURST		8
+
+static unsigned int poll_threshold = 4;
+module_param(poll_threshold, uint, 0644);
+MODULE_PARM_DESC(poll_threshold, "FIFO level that moves a channel from IRQ to polled receive, 0 disables polling (default: 4)");
+
+static unsigned int poll_budget = 64;
+module_param(poll_budget, uint, 0644);
+MODULE_PARM_DESC(poll_budget, "Words received per channel in one IRQ or poll pass (default: 64)");
+
 /*
  * AW msgbox hardware data information
  * Each msgox can be used for RX by current processor, it can trigger
@@ -95,6 +119,71 @@ static u32 sunxi_msgbox_regs_offset[] = {
 };
 #endif /* CONFIG_PM  */
 
+/*
+ * Per channel receive state and counters
+ *
+ * @polling:		The read IRQ is masked and the poll tasklet drains the FIFO
+ * @rx_stamp:		Time the pending receive event was raised by the read IRQ
+ * @tx_words:		Words written to the remote FIFO
+ * @tx_batches:		Send calls, one per mbox_send_message() or batch
+ * @tx_full:		Send calls that found less room in the FIFO than they had words
+ * @rx_words:		Words received
+ * @rx_irqs:		Read IRQs handled
+ * @rx_polls:		Poll passes over the channel
+ * @rx_poll_entries:	Switches from IRQ to polled receive
+ * @rx_level_max:	Highest FIFO level seen by the read IRQ
+ * @rx_lat_events:	Receive events completed, i.e. FIFO drained to empty
+ * @rx_lat_sum_ns:	Sum of the read IRQ to FIFO empty latencies
+ * @rx_lat_max_ns:	Worst read IRQ to FIFO empty latency
+ */
+struct sunxi_msgbox_chan_data {
+	bool polling;
+	ktime_t rx_stamp;
+	u64 tx_words;
+	u64 tx_batches;
+	u64 tx_full;
+	u64 rx_words;
+	u64 rx_irqs;
+	u64 rx_polls;
+	u64 rx_poll_entries;
+	u32 rx_level_max;
+	u64 rx_lat_events;
+	u64 rx_lat_sum_ns;
+	u32 rx_lat_max_ns;
+};
+
+struct sunxi_msgbox_lb_result {
+	int result;
+	int a, b;
+	u32 words;
+	u32 errors;
+	u64 stream_ns;
+	u32 rounds;
+	u64 rtt_sum_ns;
+	u32 rtt_min_ns;
+	u32 rtt_max_ns;
+};
+
+/*
+ * Loopback test between two free channels of the local processor
+ *
+ * The test writes into the local receive FIFOs with the msgbox debug mode,
+ * so the words go through the real read IRQ and poll paths. A stream of
+ * @words words on channel a measures throughput, then each ping-pong round
+ * sends one word to a, whose receive path forwards it to b.
+ */
+struct sunxi_msgbox_loopback {
+	struct mbox_client client;
+	struct mbox_chan *a, *b;
+	bool pingpong;
+	u32 words;
+	u32 received;
+	u32 expect;
+	ktime_t sent;
+	struct completion done;
+	struct sunxi_msgbox_lb_result res;
+};
+
 /**
  * AW msgbox controller data
  *
@@ -112,6 +201,14 @@ static u32 sunxi_msgbox_regs_offset[] = {
  * @irq_cnt:	The msgbox irq num, irq_cnt should equal to hwdata->processors_max
  * @local_id:	Curren process id num for all msgbox controller
  * @regs_backup Save msgbox status register values during sleep
+ * @lock:	Protects the read IRQ enable registers and the receive state
+ * @chan_data:	Per channel receive state and counters
+ * @poll_tasklet: Drains the channels that left IRQ mode under load
+ * @stat_since:	Time the counters were last cleared
+ * @lb:		Running loopback test, NULL if none
+ * @lb_mutex:	Serializes loopback tests
+ * @lb_last:	Result of the last loopback test
+ * @debugfs:	debugfs directory of the controller
  * @base_addr:	Base address of the register mapping region
  */
 struct sunxi_msgbox {
@@ -128,6 +225,14 @@ struct sunxi_msgbox {
 #if IS_ENABLED(CONFIG_PM)
 	u32 regs_backup[ARRAY_SIZE(sunxi_msgbox_regs_offset)];
 #endif /* CONFIG_PM  */
+	spinlock_t lock;
+	struct sunxi_msgbox_chan_data *chan_data;
+	struct tasklet_struct poll_tasklet;
+	ktime_t stat_since;
+	struct sunxi_msgbox_loopback *lb;
+	struct mutex lb_mutex;
+	struct sunxi_msgbox_lb_result lb_last;
+	struct dentry *debugfs;
 	void __iomem *base_addr[0];
 };
 
@@ -228,25 +333,209 @@ static void sunxi_msgbox_set_write_irq_threshold(struct sunxi_msgbox *chip,
 	reg_val_update(reg, WR_IRQ_THR_MASK, WR_IRQ_THR_SHIFT, thr_val);
 }
 
+static inline struct sunxi_msgbox_chan_data *to_chan_data(struct sunxi_msgbox *chip, struct mbox_chan *chan)
+{
+	return &chip->chan_data[chan - chan->mbox->chans];
+}
+
+/*
+ * Fill FIFO @p of coefficient @n with as many of the @count words as it has
+ * room for. The level is sampled once and the words go out in one burst.
+ * Return the number of words written.
+ */
+static int sunxi_msgbox_fifo_write(struct sunxi_msgbox *chip, void __iomem *base, int n, int p,
+				   const u32 *msg, int count)
+{
+	int space;
+
+	space = chip->hwdata->fifo_msg_max - (int)get_field(base + SUNXI_MSGBOX_MSG_STATUS(n, p), MSG_NUM_MASK);
+	if (space <= 0)
+		return 0;
+
+	count = min(count, space);
+	writesl(base + SUNXI_MSGBOX_MSG_FIFO(n, p), msg, count);
+
+	return count;
+}
+
+/* Called with chip->lock held, returns true if @chan belongs to the loopback test */
+static bool sunxi_msgbox_loopback_rx(struct sunxi_msgbox *chip, struct mbox_chan *chan, u32 msg)
+{
+	struct sunxi_msgbox_loopback *lb = chip->lb;
+	int local_n, p;
+	u32 rtt;
+
+	if (chan == lb->a) {
+		if (msg != lb->expect++)
+			lb->res.errors++;
+
+		if (!lb->pingpong) {
+			if (++lb->received == lb->words)
+				complete(&lb->done);
+			return true;
+		}
+
+		/* Second hop of a ping-pong round */
+		mbox_chan_to_coef_n_p(chip, lb->b, &local_n, &p);
+		if (!sunxi_msgbox_fifo_write(chip, sunxi_msgbox_reg_base(chip, chip->local_id),
+					     local_n, p, &msg, 1))
+			lb->res.errors++;
+		return true;
+	}
+
+	if (chan == lb->b) {
+		rtt = ktime_to_ns(ktime_sub(ktime_get(), lb->sent));
+		lb->res.rounds++;
+		lb->res.rtt_sum_ns += rtt;
+		lb->res.rtt_min_ns = min(lb->res.rtt_min_ns, rtt);
+		lb->res.rtt_max_ns = max(lb->res.rtt_max_ns, rtt);
+		complete(&lb->done);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Pop up to @budget words from the read FIFO. Every pass samples the FIFO
+ * level once and reads all the words it reports in one burst, instead of
+ * checking the level again before every word. Called with chip->lock held.
+ */
+static int sunxi_msgbox_rx_drain(struct sunxi_msgbox *chip, struct mbox_chan *chan,
+				 void __iomem *base, int local_n, int p, int budget)
+{
+	struct sunxi_msgbox_chan_data *cd = to_chan_data(chip, chan);
+	u32 msg[SUNXI_MSGBOX_RX_BURST];
+	int level, done = 0, i;
+
+	while (done < budget) {
+		level = get_field(base + SUNXI_MSGBOX_MSG_STATUS(local_n, p), MSG_NUM_MASK);
+		if (!level)
+			break;
+
+		level = min3(level, (int)ARRAY_SIZE(msg), budget - done);
+		readsl(base + SUNXI_MSGBOX_MSG_FIFO(local_n, p), msg, level);
+
+		for (i = 0; i < level; i++) {
+			if (unlikely(chip->lb) && sunxi_msgbox_loopback_rx(chip, chan, msg[i]))
+				continue;
+			dev_dbg(chip->dev, "process-%d read data [0x%x] by channel %d from processor-%d success\n",
+					chip->local_id, msg[i], p, sunxi_msgbox_remote_id(chip, chip->local_id, local_n));
+			mbox_chan_received_data(chan, &msg[i]);
+		}
+		done += level;
+	}
+	cd->rx_words += done;
+
+	return done;
+}
+
+/* The FIFO ran empty, account the receive event and ack it */
+static void sunxi_msgbox_rx_complete(struct sunxi_msgbox *chip, struct mbox_chan *chan,
+				     void __iomem *base, int local_n, int p)
+{
+	struct sunxi_msgbox_chan_data *cd = to_chan_data(chip, chan);
+	u32 lat;
+
+	lat = min_t(s64, ktime_to_ns(ktime_sub(ktime_get(), cd->rx_stamp)), U32_MAX);
+	cd->rx_lat_events++;
+	cd->rx_lat_sum_ns += lat;
+	cd->rx_lat_max_ns = max(cd->rx_lat_max_ns, lat);
+
+	/* The IRQ pending can be cleared only once the FIFO is empty. */
+	set_bits(base + SUNXI_MSGBOX_READ_IRQ_STATUS(local_n), RD_IRQ_PEND_MASK << RD_IRQ_PEND_SHIFT(p));
+}
+
+/*
+ * Move a busy channel to polled receive, like NAPI: mask its read IRQ and let
+ * the poll tasklet drain it in budgeted passes until the FIFO runs empty.
+ * Called with chip->lock held.
+ */
+static void sunxi_msgbox_poll_start(struct sunxi_msgbox *chip, struct mbox_chan *chan,
+				    void __iomem *base, int local_n, int p)
+{
+	struct sunxi_msgbox_chan_data *cd = to_chan_data(chip, chan);
+
+	clear_field(base + SUNXI_MSGBOX_READ_IRQ_ENABLE(local_n), RD_IRQ_EN_MASK << RD_IRQ_EN_SHIFT(p));
+	cd->polling = true;
+	cd->rx_poll_entries++;
+	tasklet_schedule(&chip->poll_tasklet);
+}
+
+/* Called with chip->lock held */
 static void sunxi_msgbox_read_handler(struct sunxi_msgbox *chip, struct mbox_chan *chan,
 				  void __iomem *base, int local_n, int p)
 {
+	struct sunxi_msgbox_chan_data *cd = to_chan_data(chip, chan);
 	unsigned long timeout = jiffies + msecs_to_jiffies(10);
-	u32 msg;
-	int ret = -1;
-
-	while (sunxi_msgbox_peek_data(chan) && time_before(jiffies, timeout)) {
-		msg = readl(base + SUNXI_MSGBOX_MSG_FIFO(local_n, p));
-		dev_dbg(chip->dev, "process-%d read data [0x%x] by channel %d from processor-%d success\n",
-				chip->local_id, msg, p, sunxi_msgbox_remote_id(chip, chip->local_id, local_n));
-		mbox_chan_received_data(chan, &msg);
-		ret = 0;
+	u32 level;
+	int done;
+
+	cd->rx_irqs++;
+	cd->rx_stamp = ktime_get();
+	level = get_field(base + SUNXI_MSGBOX_MSG_STATUS(local_n, p), MSG_NUM_MASK);
+	cd->rx_level_max = max(cd->rx_level_max, level);
+
+	if (poll_threshold) {
+		/* A FIFO that filled up before the IRQ got here is streaming */
+		if (level >= poll_threshold) {
+			sunxi_msgbox_poll_start(chip, chan, base, local_n, p);
+			return;
+		}
+
+		done = sunxi_msgbox_rx_drain(chip, chan, base, local_n, p, max(poll_budget, 1U));
+		if (sunxi_msgbox_peek_data(chan)) {
+			sunxi_msgbox_poll_start(chip, chan, base, local_n, p);
+			return;
+		}
+	} else {
+		done = 0;
+		do {
+			level = sunxi_msgbox_rx_drain(chip, chan, base, local_n, p, SUNXI_MSGBOX_RX_BURST);
+			done += level;
+		} while (level && time_before(jiffies, timeout));
 	}
-	if (ret)
+	if (!done)
 		dev_err(chip->dev, "read data timeout\n");
 
-	/* The IRQ pending can be cleared only once the FIFO is empty. */
-	set_bits(base + SUNXI_MSGBOX_READ_IRQ_STATUS(local_n), RD_IRQ_PEND_MASK << RD_IRQ_PEND_SHIFT(p));
+	sunxi_msgbox_rx_complete(chip, chan, base, local_n, p);
+}
+
+static void sunxi_msgbox_poll(unsigned long data)
+{
+	struct sunxi_msgbox *chip = (struct sunxi_msgbox *)data;
+	void __iomem *base = sunxi_msgbox_reg_base(chip, chip->local_id);
+	struct sunxi_msgbox_chan_data *cd;
+	struct mbox_chan *chan;
+	unsigned long flags;
+	bool again = false;
+	int i, local_n, p;
+
+	spin_lock_irqsave(&chip->lock, flags);
+	for (i = 0; i < chip->hwdata->mbox_num_chans; i++) {
+		cd = &chip->chan_data[i];
+		if (!cd->polling)
+			continue;
+
+		chan = &chip->controller.chans[i];
+		mbox_chan_id_to_coef_n_p(chip, i, &local_n, &p);
+
+		cd->rx_polls++;
+		sunxi_msgbox_rx_drain(chip, chan, base, local_n, p, max(poll_budget, 1U));
+		if (sunxi_msgbox_peek_data(chan)) {
+			again = true;
+			continue;
+		}
+
+		/* Drained, back to IRQ mode. Words that arrive now raise the IRQ again. */
+		sunxi_msgbox_rx_complete(chip, chan, base, local_n, p);
+		cd->polling = false;
+		set_bits(base + SUNXI_MSGBOX_READ_IRQ_ENABLE(local_n), RD_IRQ_EN_MASK << RD_IRQ_EN_SHIFT(p));
+	}
+	spin_unlock_irqrestore(&chip->lock, flags);
+
+	if (again)
+		tasklet_schedule(&chip->poll_tasklet);
 }
 
 #if IS_ENABLED(CONFIG_AW_MAILBOX_SUPPORT_TXDONE_IRQ)
@@ -295,12 +584,21 @@ static irqreturn_t sunxi_msgbox_handler(int irq, void *dev_id)
 		read_reg_base = sunxi_msgbox_reg_base(chip, local_id);
 		write_reg_base = sunxi_msgbox_reg_base(chip, remote_id);
 
+		/*
+		 * Several IRQ lines share this handler, and the poll tasklet and
+		 * channel shutdown mask the read IRQ under chip->lock as well.
+		 */
+		spin_lock(&chip->lock);
 		read_irq_en = get_field(
 				read_reg_base + SUNXI_MSGBOX_READ_IRQ_ENABLE(local_n),
 				RD_IRQ_EN_MASK << RD_IRQ_EN_SHIFT(p));
 		read_irq_pending = get_field(
 				read_reg_base + SUNXI_MSGBOX_READ_IRQ_STATUS(local_n),
 				RD_IRQ_PEND_MASK << RD_IRQ_PEND_SHIFT(p));
+		if (read_irq_en && read_irq_pending)
+			sunxi_msgbox_read_handler(chip, chan, read_reg_base, local_n, p);
+		spin_unlock(&chip->lock);
+
 		write_irq_en = get_field(
 				write_reg_base + SUNXI_MSGBOX_WRITE_IRQ_ENABLE(remote_n),
 				WR_IRQ_EN_MASK << WR_IRQ_EN_SHIFT(p));
@@ -308,9 +606,6 @@ static irqreturn_t sunxi_msgbox_handler(int irq, void *dev_id)
 				write_reg_base + SUNXI_MSGBOX_WRITE_IRQ_STATUS(remote_n),
 				WR_IRQ_PEND_MASK << WR_IRQ_PEND_SHIFT(p));
 
-		if (read_irq_en && read_irq_pending)
-			sunxi_msgbox_read_handler(chip, chan, read_reg_base, local_n, p);
-
 #if IS_ENABLED(CONFIG_AW_MAILBOX_SUPPORT_TXDONE_IRQ)
 		if (write_irq_en && write_irq_pending)
 			sunxi_msgbox_write_handler(chip, chan, write_reg_base, remote_n, p);
@@ -327,6 +622,7 @@ static int sunxi_msgbox_startup(struct mbox_chan *chan)
 	void __iomem *read_reg_base;
 	void __iomem *write_reg_base;
 	unsigned long timeout = jiffies + msecs_to_jiffies(10);
+	unsigned long flags;
 
 	mbox_chan_to_coef_n_p(chip, chan, &local_n, &p);
 	local_id = chip->local_id;
@@ -343,7 +639,10 @@ static int sunxi_msgbox_startup(struct mbox_chan *chan)
 	set_bits(read_reg_base + SUNXI_MSGBOX_READ_IRQ_STATUS(local_n), RD_IRQ_PEND_MASK << RD_IRQ_PEND_SHIFT(p));
 
 	/* Enable read IRQ */
+	spin_lock_irqsave(&chip->lock, flags);
+	to_chan_data(chip, chan)->polling = false;
 	set_bits(read_reg_base + SUNXI_MSGBOX_READ_IRQ_ENABLE(local_n), RD_IRQ_EN_MASK << RD_IRQ_EN_SHIFT(p));
+	spin_unlock_irqrestore(&chip->lock, flags);
 
 	/* Clear remote process's write IRQ pending */
 	set_bits(write_reg_base + SUNXI_MSGBOX_WRITE_IRQ_STATUS(remote_n), WR_IRQ_PEND_MASK << WR_IRQ_PEND_SHIFT(p));
@@ -374,7 +673,9 @@ static int sunxi_msgbox_send_data(struct mbox_chan *chan, void *data)
 	struct sunxi_msgbox *chip = to_sunxi_msgbox(chan);
 	int local_id = chip->local_id;
 	int local_n, remote_id, remote_n, p;
-	u32 remaining_space_in_fifo, msg;
+	struct sunxi_msgbox_chan_data *cd = to_chan_data(chip, chan);
+	int remaining_space_in_fifo;
+	u32 msg;
 	void __iomem *write_reg_base; /* the base addr of the msgbox controller that you want to send */
 
 	/*
@@ -398,13 +699,16 @@ static int sunxi_msgbox_send_data(struct mbox_chan *chan, void *data)
 	 * in FIFO anyway.
 	 */
 	remaining_space_in_fifo = chip->hwdata->fifo_msg_max - get_field(write_reg_base + SUNXI_MSGBOX_MSG_STATUS(remote_n, p), MSG_NUM_MASK);
+	cd->tx_batches++;
 	if (remaining_space_in_fifo <= 0) {
+		cd->tx_full++;
 		dev_err(chip->dev, "Channel %d to processor %d: FIFO is full\n", p, remote_id);
 		return -EBUSY;
 	}
 
 	/* Write message to remote process's msgbox controller's FIFO */
 	writel(msg, write_reg_base + SUNXI_MSGBOX_MSG_FIFO(remote_n, p));
+	cd->tx_words++;
 
 	dev_dbg(chip->dev, "processor-%d use channel %d send data [0x%x] to processor-%d success\n",
 			local_id, p, msg, remote_id);
@@ -419,6 +723,7 @@ static void sunxi_msgbox_shutdown(struct mbox_chan *chan)
 	void __iomem *read_reg_base;
 	void __iomem *write_reg_base;
 	unsigned long timeout = jiffies + msecs_to_jiffies(10);
+	unsigned long flags;
 
 	mbox_chan_to_coef_n_p(chip, chan, &local_n, &p);
 	local_id = chip->local_id;
@@ -427,6 +732,12 @@ static void sunxi_msgbox_shutdown(struct mbox_chan *chan)
 	read_reg_base = sunxi_msgbox_reg_base(chip, local_id);
 	write_reg_base = sunxi_msgbox_reg_base(chip, remote_id);
 
+	/* Stop the read IRQ and the poll tasklet from delivering to the client */
+	spin_lock_irqsave(&chip->lock, flags);
+	to_chan_data(chip, chan)->polling = false;
+	clear_field(read_reg_base + SUNXI_MSGBOX_READ_IRQ_ENABLE(local_n), RD_IRQ_EN_MASK << RD_IRQ_EN_SHIFT(p));
+	spin_unlock_irqrestore(&chip->lock, flags);
+
 	/* Disable the write IRQ */
 	clear_field(write_reg_base + SUNXI_MSGBOX_WRITE_IRQ_ENABLE(remote_n), WR_IRQ_EN_MASK << WR_IRQ_EN_SHIFT(p));
 	/* Clear write IRQ pending */
@@ -517,6 +828,57 @@ static const struct mbox_chan_ops sunxi_msgbox_chan_ops = {
 	.peek_data    = sunxi_msgbox_peek_data,
 };
 
+/**
+ * sunxi_msgbox_send_batch() - write several words to a channel in one go
+ * @chan:	msgbox channel the caller got from mbox_request_channel()
+ * @msg:	words to send, in order
+ * @count:	number of words
+ *
+ * The remote FIFO level is sampled once and the free entries are filled in
+ * one burst, without the per word tx_done round trip of mbox_send_message().
+ * Words that do not fit are left to the caller, which retries later, e.g.
+ * from its tx_done or rx callback.
+ *
+ * Return: number of words written, 0 if the FIFO is full, -EBUSY while a
+ * message queued with mbox_send_message() is still pending on @chan.
+ */
+int sunxi_msgbox_send_batch(struct mbox_chan *chan, const u32 *msg, int count)
+{
+	struct sunxi_msgbox *chip;
+	struct sunxi_msgbox_chan_data *cd;
+	int local_n, remote_id, remote_n, p;
+	unsigned long flags;
+	int ret;
+
+	if (!chan || !chan->cl || chan->mbox->ops != &sunxi_msgbox_chan_ops || !msg || count <= 0)
+		return -EINVAL;
+
+	chip = to_sunxi_msgbox(chan);
+	cd = to_chan_data(chip, chan);
+	mbox_chan_to_coef_n_p(chip, chan, &local_n, &p);
+	remote_id = sunxi_msgbox_remote_id(chip, chip->local_id, local_n);
+	remote_n = sunxi_msgbox_coef_n(chip, remote_id, chip->local_id);
+
+	/* chan->lock keeps the words behind any message the framework still holds */
+	spin_lock_irqsave(&chan->lock, flags);
+	if (chan->active_req || chan->msg_count) {
+		ret = -EBUSY;
+	} else {
+		ret = sunxi_msgbox_fifo_write(chip, sunxi_msgbox_reg_base(chip, remote_id),
+					      remote_n, p, msg, count);
+		cd->tx_batches++;
+		cd->tx_words += ret;
+		if (ret < count)
+			cd->tx_full++;
+	}
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	dev_dbg(chip->dev, "processor-%d use channel %d send %d/%d words to processor-%d\n",
+			chip->local_id, p, ret, count, remote_id);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(sunxi_msgbox_send_batch);
+
 /* Note:
  * When support new platform, msgbox driver maintainers need to
  * add coefficients N, remote_id and local_id table according to
@@ -849,6 +1211,312 @@ static void sunxi_msgbox_hw_deinit(struct sunxi_msgbox *chip)
 	clk_disable_unprepare(chip->clk);
 }
 
+#define SUNXI_MSGBOX_LB_TIMEOUT_MS	2000
+#define SUNXI_MSGBOX_LB_ROUNDS		1000
+
+static int sunxi_msgbox_loopback_claim(struct mbox_chan *chan, struct mbox_client *cl)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	if (chan->cl)
+		ret = -EBUSY;
+	else
+		chan->cl = cl;
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	return ret;
+}
+
+static void sunxi_msgbox_loopback_release(struct mbox_chan *chan)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	chan->cl = NULL;
+	spin_unlock_irqrestore(&chan->lock, flags);
+}
+
+static int sunxi_msgbox_loopback_stream(struct sunxi_msgbox *chip, struct sunxi_msgbox_loopback *lb,
+					void __iomem *base, int n, int p)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(SUNXI_MSGBOX_LB_TIMEOUT_MS);
+	u32 buf[SUNXI_MSGBOX_RX_BURST];
+	u32 sent = 0;
+	ktime_t start;
+	int i, cnt;
+
+	start = ktime_get();
+	while (sent < lb->words) {
+		cnt = min_t(u32, lb->words - sent, ARRAY_SIZE(buf));
+		for (i = 0; i < cnt; i++)
+			buf[i] = sent + i;
+
+		cnt = sunxi_msgbox_fifo_write(chip, base, n, p, buf, cnt);
+		sent += cnt;
+		if (cnt)
+			continue;
+
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+		cond_resched();
+	}
+
+	if (!wait_for_completion_timeout(&lb->done, max_t(long, timeout - jiffies, 1)))
+		return -ETIMEDOUT;
+	lb->res.stream_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return 0;
+}
+
+static int sunxi_msgbox_loopback_pingpong(struct sunxi_msgbox *chip, struct sunxi_msgbox_loopback *lb,
+					  void __iomem *base, int n, int p)
+{
+	unsigned long flags;
+	u32 i, rounds = min_t(u32, lb->words, SUNXI_MSGBOX_LB_ROUNDS);
+
+	spin_lock_irqsave(&chip->lock, flags);
+	lb->pingpong = true;
+	lb->expect = 0;
+	spin_unlock_irqrestore(&chip->lock, flags);
+
+	for (i = 0; i < rounds; i++) {
+		reinit_completion(&lb->done);
+		lb->sent = ktime_get();
+		if (!sunxi_msgbox_fifo_write(chip, base, n, p, &i, 1))
+			return -EBUSY;
+		if (!wait_for_completion_timeout(&lb->done, msecs_to_jiffies(100)))
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+/*
+ * Run the loopback test on the free channels @a and @b. The local processor
+ * feeds its own receive FIFOs in debug mode, no remote processor is involved.
+ */
+static int sunxi_msgbox_loopback_run(struct sunxi_msgbox *chip, int a, int b, u32 words)
+{
+	void __iomem *base = sunxi_msgbox_reg_base(chip, chip->local_id);
+	struct sunxi_msgbox_loopback *lb;
+	int a_n, a_p, b_n, b_p, ret;
+	unsigned long flags;
+
+	if (a < 0 || b < 0 || a >= chip->hwdata->mbox_num_chans ||
+	    b >= chip->hwdata->mbox_num_chans || a == b || !words)
+		return -EINVAL;
+
+	lb = kzalloc(sizeof(*lb), GFP_KERNEL);
+	if (!lb)
+		return -ENOMEM;
+
+	lb->a = &chip->controller.chans[a];
+	lb->b = &chip->controller.chans[b];
+	lb->words = words;
+	init_completion(&lb->done);
+	lb->res.a = a;
+	lb->res.b = b;
+	lb->res.words = words;
+	lb->res.rtt_min_ns = U32_MAX;
+
+	/* Hold both channels so that mbox_request_channel() fails on them meanwhile */
+	ret = sunxi_msgbox_loopback_claim(lb->a, &lb->client);
+	if (ret)
+		goto out_free;
+	ret = sunxi_msgbox_loopback_claim(lb->b, &lb->client);
+	if (ret)
+		goto out_release_a;
+
+	mbox_chan_to_coef_n_p(chip, lb->a, &a_n, &a_p);
+	mbox_chan_to_coef_n_p(chip, lb->b, &b_n, &b_p);
+
+	sunxi_msgbox_startup(lb->a);
+	sunxi_msgbox_startup(lb->b);
+	set_bits(base + SUNXI_MSGBOX_DEBUG_REGISTER(a_n), DBG_MODE_EN_MASK << DBG_MODE_EN_SHIFT);
+	set_bits(base + SUNXI_MSGBOX_DEBUG_REGISTER(b_n), DBG_MODE_EN_MASK << DBG_MODE_EN_SHIFT);
+
+	spin_lock_irqsave(&chip->lock, flags);
+	chip->lb = lb;
+	spin_unlock_irqrestore(&chip->lock, flags);
+
+	ret = sunxi_msgbox_loopback_stream(chip, lb, base, a_n, a_p);
+	if (!ret)
+		ret = sunxi_msgbox_loopback_pingpong(chip, lb, base, a_n, a_p);
+
+	spin_lock_irqsave(&chip->lock, flags);
+	chip->lb = NULL;
+	spin_unlock_irqrestore(&chip->lock, flags);
+
+	clear_field(base + SUNXI_MSGBOX_DEBUG_REGISTER(a_n), DBG_MODE_EN_MASK << DBG_MODE_EN_SHIFT);
+	clear_field(base + SUNXI_MSGBOX_DEBUG_REGISTER(b_n), DBG_MODE_EN_MASK << DBG_MODE_EN_SHIFT);
+	sunxi_msgbox_shutdown(lb->b);
+	sunxi_msgbox_shutdown(lb->a);
+
+	sunxi_msgbox_loopback_release(lb->b);
+out_release_a:
+	sunxi_msgbox_loopback_release(lb->a);
+out_free:
+	lb->res.result = ret;
+	chip->lb_last = lb->res;
+	kfree(lb);
+
+	return ret;
+}
+
+static int sunxi_msgbox_stats_show(struct seq_file *s, void *unused)
+{
+	struct sunxi_msgbox *chip = s->private;
+	struct sunxi_msgbox_chan_data *cd;
+	unsigned long flags;
+	u64 elapsed;
+	int i;
+
+	spin_lock_irqsave(&chip->lock, flags);
+
+	elapsed = max_t(u64, ktime_to_ns(ktime_sub(ktime_get(), chip->stat_since)), 1);
+	seq_printf(s, "elapsed %llu ms, poll_threshold %u, poll_budget %u\n",
+		   div_u64(elapsed, NSEC_PER_MSEC), poll_threshold, poll_budget);
+	seq_puts(s, "chan  tx_words  tx_calls  tx_full  rx_words  rx_words/s  rx_irqs  polled  "
+		    "polls  level_max  lat_avg_ns  lat_max_ns\n");
+	for (i = 0; i < chip->hwdata->mbox_num_chans; i++) {
+		cd = &chip->chan_data[i];
+		if (!cd->tx_batches && !cd->rx_irqs)
+			continue;
+
+		seq_printf(s, "%-4d  %8llu  %8llu  %7llu  %8llu  %10llu  %7llu  %6llu  %5llu  %9u  %10llu  %10u%s\n",
+			   i, cd->tx_words, cd->tx_batches, cd->tx_full, cd->rx_words,
+			   div64_u64(cd->rx_words * NSEC_PER_SEC, elapsed), cd->rx_irqs,
+			   cd->rx_poll_entries, cd->rx_polls, cd->rx_level_max,
+			   cd->rx_lat_events ? div64_u64(cd->rx_lat_sum_ns, cd->rx_lat_events) : 0,
+			   cd->rx_lat_max_ns, cd->polling ? "  polling" : "");
+	}
+
+	spin_unlock_irqrestore(&chip->lock, flags);
+
+	return 0;
+}
+
+static int sunxi_msgbox_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sunxi_msgbox_stats_show, inode->i_private);
+}
+
+/* Any write clears the counters */
+static ssize_t sunxi_msgbox_stats_write(struct file *file, const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct sunxi_msgbox *chip = s->private;
+	struct sunxi_msgbox_chan_data *cd;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&chip->lock, flags);
+	for (i = 0; i < chip->hwdata->mbox_num_chans; i++) {
+		cd = &chip->chan_data[i];
+		cd->tx_words = 0;
+		cd->tx_batches = 0;
+		cd->tx_full = 0;
+		cd->rx_words = 0;
+		cd->rx_irqs = 0;
+		cd->rx_polls = 0;
+		cd->rx_poll_entries = 0;
+		cd->rx_level_max = 0;
+		cd->rx_lat_events = 0;
+		cd->rx_lat_sum_ns = 0;
+		cd->rx_lat_max_ns = 0;
+	}
+	chip->stat_since = ktime_get();
+	spin_unlock_irqrestore(&chip->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations sunxi_msgbox_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sunxi_msgbox_stats_open,
+	.read		= seq_read,
+	.write		= sunxi_msgbox_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int sunxi_msgbox_loopback_show(struct seq_file *s, void *unused)
+{
+	struct sunxi_msgbox *chip = s->private;
+	struct sunxi_msgbox_lb_result *res = &chip->lb_last;
+
+	mutex_lock(&chip->lb_mutex);
+
+	if (!res->words) {
+		seq_puts(s, "echo \"<chan_a> <chan_b> <words>\" > loopback, both channels unused\n");
+		goto out;
+	}
+
+	seq_printf(s, "channel %d -> %d: %s (%d)\n", res->a, res->b,
+		   res->result ? "failed" : "ok", res->result);
+	if (res->stream_ns)
+		seq_printf(s, "stream: %u words in %llu us, %llu words/s\n", res->words,
+			   div_u64(res->stream_ns, NSEC_PER_USEC),
+			   div64_u64((u64)res->words * NSEC_PER_SEC, res->stream_ns));
+	if (res->rounds)
+		seq_printf(s, "ping-pong: %u rounds, rtt min/avg/max %u/%llu/%u ns\n", res->rounds,
+			   res->rtt_min_ns, div_u64(res->rtt_sum_ns, res->rounds), res->rtt_max_ns);
+	seq_printf(s, "sequence errors: %u\n", res->errors);
+
+out:
+	mutex_unlock(&chip->lb_mutex);
+	return 0;
+}
+
+static int sunxi_msgbox_loopback_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sunxi_msgbox_loopback_show, inode->i_private);
+}
+
+static ssize_t sunxi_msgbox_loopback_write(struct file *file, const char __user *ubuf,
+					   size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct sunxi_msgbox *chip = s->private;
+	char buf[32];
+	int a, b, ret;
+	u32 words;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%d %d %u", &a, &b, &words) != 3)
+		return -EINVAL;
+
+	mutex_lock(&chip->lb_mutex);
+	ret = sunxi_msgbox_loopback_run(chip, a, b, words);
+	mutex_unlock(&chip->lb_mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations sunxi_msgbox_loopback_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sunxi_msgbox_loopback_open,
+	.read		= seq_read,
+	.write		= sunxi_msgbox_loopback_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void sunxi_msgbox_debugfs_init(struct sunxi_msgbox *chip)
+{
+	chip->debugfs = debugfs_create_dir(dev_name(chip->dev), NULL);
+	debugfs_create_file("stats", 0644, chip->debugfs, chip, &sunxi_msgbox_stats_fops);
+	debugfs_create_file("loopback", 0644, chip->debugfs, chip, &sunxi_msgbox_loopback_fops);
+}
+
 static int sunxi_msgbox_probe(struct platform_device *pdev)
 {
 	struct mbox_chan *chans;
@@ -875,6 +1543,16 @@ static int sunxi_msgbox_probe(struct platform_device *pdev)
 	for (i = 0; i < chip->hwdata->mbox_num_chans; i++)
 		chans[i].con_priv = chip;
 
+	chip->chan_data = devm_kcalloc(chip->dev, chip->hwdata->mbox_num_chans,
+				       sizeof(*chip->chan_data), GFP_KERNEL);
+	if (!chip->chan_data)
+		return -ENOMEM;
+
+	spin_lock_init(&chip->lock);
+	mutex_init(&chip->lb_mutex);
+	tasklet_init(&chip->poll_tasklet, sunxi_msgbox_poll, (unsigned long)chip);
+	chip->stat_since = ktime_get();
+
 	ret = sunxi_msgbox_resource_get(chip);
 	if (ret) {
 		dev_err(chip->dev, "Error: Failed to get resource\n");
@@ -907,6 +1585,8 @@ static int sunxi_msgbox_probe(struct platform_device *pdev)
 		goto err1;
 	}
 
+	sunxi_msgbox_debugfs_init(chip);
+
 	dev_info(chip->dev, "%s(): sunxi msgbox probe success\n", __func__);
 	return 0;
 
@@ -921,6 +1601,15 @@ err0:
 static int sunxi_msgbox_remove(struct platform_device *pdev)
 {
 	struct sunxi_msgbox *chip = platform_get_drvdata(pdev);
+	int i;
+
+	debugfs_remove_recursive(chip->debugfs);
+
+	/* Nothing can schedule the poll tasklet once the IRQ lines are off */
+	for (i = 0; i < chip->irq_cnt; i++)
+		disable_irq(chip->irq[i]);
+	tasklet_kill(&chip->poll_tasklet);
+	sunxi_msgbox_disable_irq(chip);
 
 	sunxi_msgbox_hw_deinit(chip);
 	sunxi_msgbox_resource_put(chip);
@@ -1022,4 +1711,4 @@ MODULE_AUTHOR("wujiayi <wujiayi@allwinnertech.com>");
 MODULE_AUTHOR("xuminghui <xuminghui@allwinnertech.com>");
 MODULE_AUTHOR("zhaiyaya <zhaiyaya@allwinnertech.com>");
 MODULE_LICENSE("GPL v2");
-MODULE_VERSION("1.1.5");
+MODULE_VERSION("1.2.0");
@@ -49,6 +49,11 @@ int aicwf_sdio_writeb(struct aic_sdio_dev *sdiodev, uint regaddr, u8 val)
 	return ret;
 }
 int tx_aggr_counter = 64;
+/* 0 aggregates up to the fw credits, as before */
+static int tx_aggr_latency_us = 2000;
+module_param(tx_aggr_latency_us, int, 0644);
+static bool tx_xmit_more = true;
+module_param(tx_xmit_more, bool, 0644);
 int aicwf_sdio_flow_ctrl_msg(struct aic_sdio_dev *sdiodev)
 {
 	int ret = -1;
@@ -719,15 +724,18 @@ struct sk_buff *aicwf_sdio_readframes(struct aic_sdio_dev *sdiodev)
 	}
 
 	size = sdiodev->rx_priv->data_len;
-	skb =  __dev_alloc_skb(size, GFP_KERNEL);
+	skb = aicwf_rx_pool_get(sdiodev->rx_priv, size);
 	if (!skb) {
 		return NULL;
 	}
 
 	ret = aicwf_sdio_recv_pkt(sdiodev, skb, size);
 	if (ret) {
-		dev_kfree_skb(skb);
+		aicwf_rx_pool_put(sdiodev->rx_priv, skb);
 		skb = NULL;
+	} else {
+		sdiodev->rx_priv->stats.reads++;
+		sdiodev->rx_priv->stats.read_bytes += size;
 	}
 
 	return skb;
@@ -803,6 +811,17 @@ static int aicwf_sdio_tx_msg(struct aic_sdio_dev *sdiodev)
 	return err;
 }
 
+static int aicwf_sdio_tx_credits(struct aic_sdio_dev *sdiodev)
+{
+	ktime_t start = ktime_get();
+	int cnt;
+
+	cnt = aicwf_sdio_flow_ctrl(sdiodev);
+	sdiodev->tx_priv->stats.fc_wait_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return cnt;
+}
+
 static void aicwf_sdio_tx_process(struct aic_sdio_dev *sdiodev)
 {
 	int err = 0;
@@ -849,12 +868,13 @@ static void aicwf_sdio_tx_process(struct aic_sdio_dev *sdiodev)
 		return;
 	}
 
-	sdiodev->tx_priv->fw_avail_bufcnt = aicwf_sdio_flow_ctrl(sdiodev);
+	sdiodev->tx_priv->fw_avail_bufcnt = aicwf_sdio_tx_credits(sdiodev);
 	while (!aicwf_is_framequeue_empty(&sdiodev->tx_priv->txq)) {
 		if (sdiodev->tx_priv->fw_avail_bufcnt <= DATA_FLOW_CTRL_THRESH) {
 			if (sdiodev->tx_priv->cmd_txstate)
 				break;
-			sdiodev->tx_priv->fw_avail_bufcnt = aicwf_sdio_flow_ctrl(sdiodev);
+			sdiodev->tx_priv->stats.credit_stalls++;
+			sdiodev->tx_priv->fw_avail_bufcnt = aicwf_sdio_tx_credits(sdiodev);
 		} else {
 			if (sdiodev->tx_priv->cmd_txstate) {
 				aicwf_sdio_send(sdiodev->tx_priv, 1);
@@ -874,8 +894,12 @@ static int aicwf_sdio_bus_txdata(struct device *dev, struct sk_buff *pkt)
 	int ret = -EBADE;
 	struct aicwf_bus *bus_if = dev_get_drvdata(dev);
 	struct aic_sdio_dev *sdiodev = bus_if->bus_priv.sdio;
+	struct rwnx_txhdr *hdr = (struct rwnx_txhdr *)pkt->data;
 
-	prio = (pkt->priority & 0x7);
+	/* BCMC rides with best effort */
+	prio = hdr->sw_hdr->hw_queue;
+	if (prio >= TX_AC_NUM)
+		prio = RWNX_HWQ_BE;
 	spin_lock_bh(&sdiodev->tx_priv->txqlock);
 	if (!aicwf_frame_enq(sdiodev->dev, &sdiodev->tx_priv->txq, pkt, prio)) {
 		struct rwnx_txhdr *txhdr = (struct rwnx_txhdr *)pkt->data;
@@ -897,12 +921,66 @@ static int aicwf_sdio_bus_txdata(struct device *dev, struct sk_buff *pkt)
 
 	atomic_inc(&sdiodev->tx_priv->tx_pktcnt);
 	spin_unlock_bh(&sdiodev->tx_priv->txqlock);
-	if (atomic_read(&sdiodev->tx_priv->tx_pktcnt) == 1)
+
+	/*
+	 * The stack has more frames for us: leave the bus thread asleep so
+	 * it finds the whole burst queued, rwnx_start_xmit() kicks it once
+	 * the last frame is in.
+	 */
+	if (tx_xmit_more && sdiodev->tx_priv->xmit_more &&
+		atomic_read(&sdiodev->tx_priv->tx_pktcnt) < tx_aggr_counter) {
+		if (atomic_xchg(&sdiodev->tx_priv->xmit_pending, 1))
+			sdiodev->tx_priv->stats.xmit_deferred++;
+		return ret;
+	}
+
+	if (atomic_xchg(&sdiodev->tx_priv->xmit_pending, 0) ||
+		atomic_read(&sdiodev->tx_priv->tx_pktcnt) == 1)
 		complete(&bus_if->bustx_trgg);
 
 	return ret;
 }
 
+void aicwf_sdio_tx_kick(struct aic_sdio_dev *sdiodev)
+{
+	if (atomic_xchg(&sdiodev->tx_priv->xmit_pending, 0))
+		complete(&sdiodev->bus_if->bustx_trgg);
+}
+
+/* Called with txqlock held. Bytes stand in for airtime: the fw does rate
+ * control, so the bus time a frame takes is the cost the host can see. */
+static struct sk_buff *aicwf_sdio_tx_dequeue(struct aicwf_tx_priv *tx_priv)
+{
+	struct frame_queue *pq = &tx_priv->txq;
+	struct sk_buff_head *q;
+	struct sk_buff *pkt;
+	int ac, i;
+
+	if (pq->qcnt == 0)
+		return NULL;
+
+	for (i = 0; i <= 2 * TX_AC_NUM; i++) {
+		ac = tx_priv->ac_cur;
+		q = &pq->queuelist[ac];
+		pkt = skb_peek(q);
+		if (!pkt) {
+			tx_priv->ac_deficit[ac] = 0;
+		} else if (tx_priv->ac_deficit[ac] >= (int)pkt->len) {
+			__skb_unlink(pkt, q);
+			pq->qcnt--;
+			tx_priv->ac_deficit[ac] -= pkt->len;
+			tx_priv->stats.ac_frames[ac]++;
+			tx_priv->stats.ac_bytes[ac] += pkt->len;
+			return pkt;
+		} else {
+			tx_priv->ac_deficit[ac] += (ac + 1) * TX_AC_QUANTUM;
+		}
+		tx_priv->ac_cur = (ac + 1) % TX_AC_NUM;
+	}
+
+	return aicwf_frame_dequeue(pq);
+}
+
 static int aicwf_sdio_bus_txmsg(struct device *dev, u8 *msg, uint msglen)
 {
 	struct aicwf_bus *bus_if = dev_get_drvdata(dev);
@@ -945,7 +1023,7 @@ int aicwf_sdio_send(struct aicwf_tx_priv *tx_priv, u8 txnow)
 		}
 	} else {
 		spin_lock_bh(&sdiodev->tx_priv->txqlock);
-		pkt = aicwf_frame_dequeue(&sdiodev->tx_priv->txq);
+		pkt = aicwf_sdio_tx_dequeue(sdiodev->tx_priv);
 		if (pkt == NULL) {
 			sdio_err("txq no pkt\n");
 			spin_unlock_bh(&sdiodev->tx_priv->txqlock);
@@ -963,7 +1041,8 @@ int aicwf_sdio_send(struct aicwf_tx_priv *tx_priv, u8 txnow)
 		}
 
 		//when aggr finish or there is cmd to send, just send this aggr pkt to fw
-		if ((int)atomic_read(&sdiodev->tx_priv->tx_pktcnt) == 0 || txnow || (atomic_read(&tx_priv->aggr_count) == (tx_priv->fw_avail_bufcnt - DATA_FLOW_CTRL_THRESH))) {
+		if ((int)atomic_read(&sdiodev->tx_priv->tx_pktcnt) == 0 || txnow || (atomic_read(&tx_priv->aggr_count) == (tx_priv->fw_avail_bufcnt - DATA_FLOW_CTRL_THRESH)) ||
+			(tx_priv->aggr_target && (tx_priv->tail - tx_priv->head) >= tx_priv->aggr_target)) {
 			tx_priv->fw_avail_bufcnt -= atomic_read(&tx_priv->aggr_count);
 			aicwf_sdio_aggr_send(tx_priv);
 		} else
@@ -1064,11 +1143,38 @@ int aicwf_sdio_aggr(struct aicwf_tx_priv *tx_priv, struct sk_buff *pkt)
 	return 0;
 }
 
+static void aicwf_sdio_aggr_account(struct aicwf_tx_priv *tx_priv, u32 len, int frames, u64 ns)
+{
+	struct aicwf_tx_stats *st = &tx_priv->stats;
+	u32 sample, target;
+
+	st->aggrs++;
+	st->frames += frames;
+	st->bytes += len;
+	st->busy_ns += ns;
+	st->depth[min(fls(frames) - 1, TX_AGGR_DEPTH_BUCKETS - 1)]++;
+
+	if (!ns)
+		return;
+
+	sample = (u32)min_t(u64, div64_u64((u64)len * NSEC_PER_MSEC, ns), U32_MAX / 8);
+	tx_priv->bus_rate = tx_priv->bus_rate ? (tx_priv->bus_rate * 7 + sample) / 8 : sample;
+
+	if (tx_aggr_latency_us <= 0) {
+		tx_priv->aggr_target = 0;
+		return;
+	}
+	target = (u32)div_u64((u64)tx_priv->bus_rate * tx_aggr_latency_us, USEC_PER_MSEC);
+	tx_priv->aggr_target = clamp_t(u32, target, BUFFER_SIZE, MAX_AGGR_TXPKT_LEN - 2 * BUFFER_SIZE);
+}
+
 void aicwf_sdio_aggr_send(struct aicwf_tx_priv *tx_priv)
 {
 	struct sk_buff *tx_buf = tx_priv->aggr_buf;
 	int ret = 0;
 	int curr_len = 0;
+	int frames = atomic_read(&tx_priv->aggr_count);
+	ktime_t start;
 
 	//link tail is necessary
 	curr_len = tx_priv->tail - tx_priv->head;
@@ -1078,9 +1184,13 @@ void aicwf_sdio_aggr_send(struct aicwf_tx_priv *tx_priv)
 	}
 
 	tx_buf->len = tx_priv->tail - tx_priv->head;
+	start = ktime_get();
 	ret = aicwf_sdio_txpkt(tx_priv->sdiodev, tx_buf);
 	if (ret < 0) {
 		sdio_err("fail to send aggr pkt!\n");
+	} else if (frames > 0) {
+		aicwf_sdio_aggr_account(tx_priv, roundup(tx_buf->len, SDIOWIFI_FUNC_BLOCKSIZE), frames,
+					ktime_to_ns(ktime_sub(ktime_get(), start)));
 	}
 
 	aicwf_sdio_aggrbuf_reset(tx_priv);
@@ -1138,6 +1248,9 @@ int bustx_thread_prio = 1;
 module_param(bustx_thread_prio, int, 0);
 int busrx_thread_prio = 1;
 module_param(busrx_thread_prio, int, 0);
+/* reads drained per interrupt while the block count stays non zero */
+static int rx_burst = 8;
+module_param(rx_burst, int, 0644);
 
 int sdio_bustx_thread(void *data)
 {
@@ -1283,7 +1396,7 @@ static void aicwf_sdio_enq_rxpkt(struct aic_sdio_dev *sdiodev, struct sk_buff *p
 	spin_lock_irqsave(&rx_priv->rxqlock, flags);
 	if (!aicwf_rxframe_enqueue(sdiodev->dev, &rx_priv->rxq, pkt)) {
 		spin_unlock_irqrestore(&rx_priv->rxqlock, flags);
-		aicwf_dev_skb_free(pkt);
+		aicwf_rx_pool_put(rx_priv, pkt);
 		return;
 	}
 	spin_unlock_irqrestore(&rx_priv->rxqlock, flags);
@@ -1302,6 +1415,7 @@ void aicwf_sdio_hal_irqhandler(struct sdio_func *func)
 	struct sk_buff *pkt = NULL;
 	int ret;
 	int retry = 10;
+	int burst = 0;
 
 	if ((sdiodev->rwnx_hw) == NULL || (sdiodev->rwnx_hw->irq_enable) != true) {
 		sdio_err("waiting for rwnx_hw->irq_enable is true\r\n");
@@ -1317,33 +1431,54 @@ void aicwf_sdio_hal_irqhandler(struct sdio_func *func)
 	}
 	if (sdiodev->rwnx_hw->chipid == PRODUCT_ID_AIC8800D || sdiodev->rwnx_hw->chipid == PRODUCT_ID_AIC8800DC ||
 		sdiodev->rwnx_hw->chipid == PRODUCT_ID_AIC8800DW) {
-		ret = aicwf_sdio_readb(sdiodev, sdiodev->sdio_reg.block_cnt_reg, &intstatus);
-		while (ret || (intstatus & SDIO_OTHER_INTERRUPT)) {
-			sdio_err("ret=%d, intstatus=%x\r\n", ret, intstatus);
+		/*
+		 * The firmware keeps aggregating into the fifo while the host
+		 * reads, so look at the block count again after every read and
+		 * take what is pending now instead of waiting for the next
+		 * interrupt. One host claim covers the whole burst.
+		 */
+		sdio_claim_host(sdiodev->func);
+		do {
+			retry = 10;
 			ret = aicwf_sdio_readb(sdiodev, sdiodev->sdio_reg.block_cnt_reg, &intstatus);
-			if (retry-- <= 0)
-				break;
-		}
-		sdiodev->rx_priv->data_len = intstatus * SDIOWIFI_FUNC_BLOCKSIZE;
+			while (ret || (intstatus & SDIO_OTHER_INTERRUPT)) {
+				sdio_err("ret=%d, intstatus=%x\r\n", ret, intstatus);
+				ret = aicwf_sdio_readb(sdiodev, sdiodev->sdio_reg.block_cnt_reg, &intstatus);
+				if (retry-- <= 0)
+					break;
+			}
+			sdiodev->rx_priv->data_len = intstatus * SDIOWIFI_FUNC_BLOCKSIZE;
 
-		if (intstatus > 0) {
-			if (intstatus < 64) {
-				pkt = aicwf_sdio_readframes(sdiodev);
+			if (intstatus > 0) {
+				if (intstatus < 64) {
+					pkt = aicwf_sdio_readframes(sdiodev);
+				} else {
+					aicwf_sdio_intr_get_len_bytemode(sdiodev, &byte_len);//byte_len must<= 128
+					sdio_info("byte mode len=%d\r\n", byte_len);
+					pkt = aicwf_sdio_readframes(sdiodev);
+				}
 			} else {
-				aicwf_sdio_intr_get_len_bytemode(sdiodev, &byte_len);//byte_len must<= 128
-				sdio_info("byte mode len=%d\r\n", byte_len);
-				pkt = aicwf_sdio_readframes(sdiodev);
+			#ifndef CONFIG_PLATFORM_ALLWINNER
+				if (!burst)
+					sdio_err("Interrupt but no data\n");
+			#endif
 			}
-		} else {
-		#ifndef CONFIG_PLATFORM_ALLWINNER
-			sdio_err("Interrupt but no data\n");
-		#endif
-		}
 
-		if (pkt)
+			if (!pkt)
+				break;
 			aicwf_sdio_enq_rxpkt(sdiodev, pkt);
+			pkt = NULL;
+			burst++;
+		} while (intstatus < 64 && burst < rx_burst);
+		sdio_release_host(sdiodev->func);
 
-		if (atomic_read(&sdiodev->rx_priv->rx_cnt) == 1 &&
+		if (burst) {
+			sdiodev->rx_priv->stats.irqs++;
+			if (burst > sdiodev->rx_priv->stats.burst_max)
+				sdiodev->rx_priv->stats.burst_max = burst;
+		}
+
+		if (burst && atomic_read(&sdiodev->rx_priv->rx_cnt) <= burst &&
 			sdiodev->oob_enable == false){
 			complete(&bus_if->busrx_trgg);
 		}
@@ -1401,8 +1536,10 @@ void aicwf_sdio_hal_irqhandler(struct sdio_func *func)
 		#endif
 		}
 
-		if (pkt)
+		if (pkt) {
 			aicwf_sdio_enq_rxpkt(sdiodev, pkt);
+			sdiodev->rx_priv->stats.irqs++;
+		}
 
 		if (atomic_read(&sdiodev->rx_priv->rx_cnt) == 1 &&
 			sdiodev->oob_enable == false){
@@ -1703,8 +1840,10 @@ void *aicwf_sdio_bus_init(struct aic_sdio_dev *sdiodev)
 		goto fail;
 	}
 	sdiodev->tx_priv = tx_priv;
-	aicwf_frame_queue_init(&tx_priv->txq, 8, TXQLEN);
+	aicwf_frame_queue_init(&tx_priv->txq, TX_AC_NUM, TXQLEN);
 	spin_lock_init(&tx_priv->txqlock);
+	atomic_set(&tx_priv->xmit_pending, 0);
+	tx_priv->stats.since = ktime_get();
 	sema_init(&tx_priv->txctl_sema, 1);
 	sema_init(&tx_priv->cmd_txsema, 1);
 	init_waitqueue_head(&tx_priv->cmd_txdone_wait);
@@ -133,6 +133,7 @@ int aicwf_sdio_aggr(struct aicwf_tx_priv *tx_priv, struct sk_buff *pkt);
 int aicwf_sdio_send(struct aicwf_tx_priv *tx_priv, u8 txnow);
 void aicwf_sdio_aggr_send(struct aicwf_tx_priv *tx_priv);
 void aicwf_sdio_aggrbuf_reset(struct aicwf_tx_priv *tx_priv);
+void aicwf_sdio_tx_kick(struct aic_sdio_dev *sdiodev);
 extern void aicwf_hostif_ready(void);
 extern void aicwf_hostif_fail(void);
 #ifdef CONFIG_PLATFORM_NANOPI
@@ -236,6 +236,164 @@ static void aicwf_count_rx_tp(struct aicwf_rx_priv *rx_priv, int len)
 	}
 }
 
+#ifdef AICWF_SDIO_SUPPORT
+static int rx_pool_size = 8;
+module_param(rx_pool_size, int, 0444);
+MODULE_PARM_DESC(rx_pool_size, "Number of preallocated sdio rx fifo buffers");
+static bool rx_gro = true;
+module_param(rx_gro, bool, 0444);
+MODULE_PARM_DESC(rx_gro, "Hand received frames to the stack with napi_gro_receive");
+
+static void aicwf_rx_pool_init(struct aicwf_rx_priv *rx_priv)
+{
+	struct sk_buff *skb;
+	int i;
+
+	skb_queue_head_init(&rx_priv->rx_pool);
+	for (i = 0; i < rx_pool_size; i++) {
+		skb = __dev_alloc_skb(RX_POOL_BUFSZ, GFP_KERNEL);
+		if (!skb)
+			break;
+		rx_priv->rx_pool_headroom = skb_headroom(skb);
+		skb_queue_tail(&rx_priv->rx_pool, skb);
+	}
+	rx_priv->rx_pool_cnt = i;
+	if (i < rx_pool_size)
+		txrx_err("rx pool: %d of %d buffers\n", i, rx_pool_size);
+}
+
+struct sk_buff *aicwf_rx_pool_get(struct aicwf_rx_priv *rx_priv, u32 size)
+{
+	struct sk_buff *skb = NULL;
+
+	if (size <= RX_POOL_BUFSZ)
+		skb = skb_dequeue(&rx_priv->rx_pool);
+	if (skb) {
+		rx_priv->stats.pool_hits++;
+		return skb;
+	}
+
+	rx_priv->stats.pool_misses++;
+	return __dev_alloc_skb(size, GFP_KERNEL);
+}
+
+void aicwf_rx_pool_put(struct aicwf_rx_priv *rx_priv, struct sk_buff *skb)
+{
+	if (skb_queue_len(&rx_priv->rx_pool) >= rx_priv->rx_pool_cnt ||
+		skb_end_offset(skb) < rx_priv->rx_pool_headroom + RX_POOL_BUFSZ ||
+		skb_cloned(skb) || skb_shared(skb)) {
+		dev_kfree_skb(skb);
+		return;
+	}
+
+	skb->data = skb->head + rx_priv->rx_pool_headroom;
+	skb->len = 0;
+	skb_reset_tail_pointer(skb);
+	skb_queue_tail(&rx_priv->rx_pool, skb);
+}
+
+static int aicwf_rx_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct aicwf_rx_priv *rx_priv = container_of(napi, struct aicwf_rx_priv, napi);
+	struct sk_buff *skb;
+	int done = 0;
+
+	while (done < budget) {
+		skb = skb_dequeue(&rx_priv->napi_q);
+		if (!skb)
+			break;
+		napi_gro_receive(napi, skb);
+		done++;
+	}
+
+	rx_priv->stats.napi_polls++;
+	rx_priv->stats.napi_pkts += done;
+
+	if (done < budget) {
+		napi_complete_done(napi, done);
+		if (!skb_queue_empty(&rx_priv->napi_q))
+			napi_schedule(napi);
+	}
+
+	return done;
+}
+
+static void aicwf_rx_napi_kick(struct aicwf_rx_priv *rx_priv)
+{
+	if (!rx_priv->napi_dev || skb_queue_empty(&rx_priv->napi_q))
+		return;
+
+	/* run the poll now rather than at the next irq exit */
+	local_bh_disable();
+	napi_schedule(&rx_priv->napi);
+	local_bh_enable();
+}
+
+/*
+ * Called by the rx paths in place of netif_receive_skb(). Frames split out
+ * by the bus rx thread are kicked once per batch, so GRO sees the whole
+ * read; reorder timeouts flush from their own context and kick right away.
+ */
+bool aicwf_rx_napi_enqueue(struct aicwf_rx_priv *rx_priv, struct sk_buff *skb)
+{
+	if (!rx_priv->napi_dev)
+		return false;
+
+	if (skb_queue_len(&rx_priv->napi_q) >= MAX_RXQLEN) {
+		rx_priv->stats.napi_drops++;
+		dev_kfree_skb_any(skb);
+		return true;
+	}
+
+	skb_queue_tail(&rx_priv->napi_q, skb);
+	if (!rx_priv->napi_batch || skb_queue_len(&rx_priv->napi_q) >= NAPI_POLL_WEIGHT)
+		aicwf_rx_napi_kick(rx_priv);
+
+	return true;
+}
+
+static void aicwf_rx_napi_init(struct aicwf_rx_priv *rx_priv)
+{
+	skb_queue_head_init(&rx_priv->napi_q);
+	if (!rx_gro)
+		return;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+	rx_priv->napi_dev = alloc_netdev_dummy(0);
+#else
+	rx_priv->napi_dev = kzalloc(sizeof(struct net_device), GFP_KERNEL);
+	if (rx_priv->napi_dev)
+		init_dummy_netdev(rx_priv->napi_dev);
+#endif
+	if (!rx_priv->napi_dev) {
+		txrx_err("no napi dev, rx goes through netif_receive_skb\n");
+		return;
+	}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 1, 0)
+	netif_napi_add(rx_priv->napi_dev, &rx_priv->napi, aicwf_rx_napi_poll, NAPI_POLL_WEIGHT);
+#else
+	netif_napi_add(rx_priv->napi_dev, &rx_priv->napi, aicwf_rx_napi_poll);
+#endif
+	napi_enable(&rx_priv->napi);
+}
+
+static void aicwf_rx_napi_deinit(struct aicwf_rx_priv *rx_priv)
+{
+	if (rx_priv->napi_dev) {
+		napi_disable(&rx_priv->napi);
+		netif_napi_del(&rx_priv->napi);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+		free_netdev(rx_priv->napi_dev);
+#else
+		kfree(rx_priv->napi_dev);
+#endif
+		rx_priv->napi_dev = NULL;
+	}
+	skb_queue_purge(&rx_priv->napi_q);
+}
+#endif
+
 int aicwf_process_rxframes(struct aicwf_rx_priv *rx_priv)
 {
 #ifdef AICWF_SDIO_SUPPORT
@@ -248,6 +406,7 @@ int aicwf_process_rxframes(struct aicwf_rx_priv *rx_priv)
 	u8 *data = NULL;
 	u8_l *msg = NULL;
 
+	rx_priv->napi_batch = true;
 	while (1) {
 		spin_lock_irqsave(&rx_priv->rxqlock, flags);
 		if (aicwf_is_framequeue_empty(&rx_priv->rxq)) {
@@ -282,6 +441,8 @@ int aicwf_process_rxframes(struct aicwf_rx_priv *rx_priv)
 				skb_put(skb_inblock, aggr_len);
 				memcpy(skb_inblock->data, data, aggr_len);
 				aicwf_count_rx_tp(rx_priv, aggr_len);
+				rx_priv->stats.frames++;
+				rx_priv->stats.frame_bytes += aggr_len;
 				rwnx_rxdataind_aicwf(rx_priv->sdiodev->rwnx_hw, skb_inblock, (void *)rx_priv);
 				skb_pull(skb, adjust_len);
 			} else {
@@ -297,10 +458,13 @@ int aicwf_process_rxframes(struct aicwf_rx_priv *rx_priv)
 				if (msg == NULL) {
 					txrx_err("no more space for msg!\n");
 					aicwf_dev_skb_free(skb);
+					rx_priv->napi_batch = false;
+					aicwf_rx_napi_kick(rx_priv);
 					return -EBADE;
 				}
 
 				memcpy(msg, data, aggr_len + 4);
+				rx_priv->stats.msgs++;
 				if ((*(msg + 2) & 0x7f) == SDIO_TYPE_CFG_CMD_RSP)
 					rwnx_rx_handle_msg(rx_priv->sdiodev->rwnx_hw, (struct ipc_e2a_msg *)(msg + 4));
 
@@ -315,9 +479,11 @@ int aicwf_process_rxframes(struct aicwf_rx_priv *rx_priv)
 			}
 		}
 
-		dev_kfree_skb(skb);
+		aicwf_rx_pool_put(rx_priv, skb);
 		atomic_dec(&rx_priv->rx_cnt);
 	}
+	rx_priv->napi_batch = false;
+	aicwf_rx_napi_kick(rx_priv);
 
 #if defined(CONFIG_SDIO_PWRCTRL)
 	aicwf_sdio_pwr_stctl(rx_priv->sdiodev, SDIO_ACTIVE_ST);
@@ -443,6 +609,11 @@ struct aicwf_rx_priv *aicwf_rx_init(void *arg)
 	aicwf_frame_queue_init(&rx_priv->rxq, 1, MAX_RXQLEN);
 	spin_lock_init(&rx_priv->rxqlock);
 	atomic_set(&rx_priv->rx_cnt, 0);
+#ifdef AICWF_SDIO_SUPPORT
+	aicwf_rx_pool_init(rx_priv);
+	aicwf_rx_napi_init(rx_priv);
+	rx_priv->stats.since = ktime_get();
+#endif
 
 #ifdef AICWF_RX_REORDER
 	INIT_LIST_HEAD(&rx_priv->rxframes_freequeue);
@@ -450,6 +621,10 @@ struct aicwf_rx_priv *aicwf_rx_init(void *arg)
 	rx_priv->recv_frames = aicwf_rxframe_queue_init(&rx_priv->rxframes_freequeue, MAX_REORD_RXFRAME);
 	if (!rx_priv->recv_frames) {
 		txrx_err("no enough buffer for free recv frame queue!\n");
+#ifdef AICWF_SDIO_SUPPORT
+		aicwf_rx_napi_deinit(rx_priv);
+		skb_queue_purge(&rx_priv->rx_pool);
+#endif
 		kfree(rx_priv);
 		return NULL;
 	}
@@ -502,6 +677,10 @@ void aicwf_rx_deinit(struct aicwf_rx_priv *rx_priv)
 #endif
 
 	aicwf_frame_queue_flush(&rx_priv->rxq);
+#ifdef AICWF_SDIO_SUPPORT
+	aicwf_rx_napi_deinit(rx_priv);
+	skb_queue_purge(&rx_priv->rx_pool);
+#endif
 #ifdef AICWF_RX_REORDER
 	aicwf_recvframe_queue_deinit(&rx_priv->rxframes_freequeue);
 	if (rx_priv->recv_frames)
@@ -10,6 +10,7 @@
 #define _AICWF_TXRXIF_H_
 
 #include <linux/skbuff.h>
+#include <linux/netdevice.h>
 #include <linux/sched.h>
 #include "ipc_shared.h"
 #ifdef AICWF_SDIO_SUPPORT
@@ -23,11 +24,19 @@
 #define MAX_AGGR_TXPKT_LEN          (1536*64)
 #define CMD_TX_TIMEOUT              5000
 #define TX_ALIGNMENT                4
+#ifdef AICWF_SDIO_SUPPORT
+#define TX_AC_NUM                   4       /* RWNX_HWQ_BK .. RWNX_HWQ_VO */
+#define TX_AC_QUANTUM               2048    /* bytes, scaled by ac + 1 */
+#define TX_AGGR_DEPTH_BUCKETS       8
+#endif
 
 #define RX_HWHRD_LEN                60 //58->60 word allined
 #define CCMP_OR_WEP_INFO            8
 #define MAX_RXQLEN                  2000
 #define RX_ALIGNMENT                4
+#ifdef AICWF_SDIO_SUPPORT
+#define RX_POOL_BUFSZ               (64 * SDIOWIFI_FUNC_BLOCKSIZE)
+#endif
 
 #define DEBUG_ERROR_LEVEL           0
 #define DEBUG_DEBUG_LEVEL           1
@@ -92,6 +101,22 @@ struct aicwf_bus {
 	struct task_struct *busrx_thread;
 };
 
+#ifdef AICWF_SDIO_SUPPORT
+struct aicwf_tx_stats {
+	ktime_t since;
+	u64 aggrs;          /* CMD53 data writes */
+	u64 frames;
+	u64 bytes;          /* written to the fifo, block padding included */
+	u64 busy_ns;        /* spent in data writes */
+	u64 fc_wait_ns;     /* spent polling the flow control register */
+	u64 credit_stalls;  /* fw ran out of buffers with data queued */
+	u64 xmit_deferred;  /* bus thread wakeups saved by xmit_more */
+	u64 ac_frames[TX_AC_NUM];
+	u64 ac_bytes[TX_AC_NUM];
+	u32 depth[TX_AGGR_DEPTH_BUCKETS]; /* aggregates of 1, 2-3, 4-7 ... frames */
+};
+#endif
+
 struct aicwf_tx_priv {
 #ifdef AICWF_SDIO_SUPPORT
 	struct aic_sdio_dev *sdiodev;
@@ -106,9 +131,19 @@ struct aicwf_tx_priv {
 	//for data tx
 	atomic_t tx_pktcnt;
 
-	struct frame_queue txq;
+	struct frame_queue txq;     /* one queue per access category */
 	spinlock_t txqlock;
 	struct semaphore txctl_sema;
+	/* deficit round robin over the access categories */
+	int ac_deficit[TX_AC_NUM];
+	u8 ac_cur;
+	/* aggregate size from the measured bus rate and the latency budget */
+	u32 bus_rate;               /* bytes per ms, ewma */
+	u32 aggr_target;            /* bytes, 0 until the first sample */
+	/* set under rwnx_hw->tx_lock while the stack has more frames coming */
+	bool xmit_more;
+	atomic_t xmit_pending;
+	struct aicwf_tx_stats stats;
 #endif
 #ifdef AICWF_USB_SUPPORT
 	struct aic_usb_dev *usbdev;
@@ -164,9 +199,37 @@ struct recv_msdu {
 };
 #endif
 
+#ifdef AICWF_SDIO_SUPPORT
+struct aicwf_rx_stats {
+	ktime_t since;
+	u64 irqs;           /* interrupts which carried data */
+	u64 reads;          /* CMD53 reads from the rx fifo */
+	u64 read_bytes;
+	u64 frames;         /* data frames split out of the reads */
+	u64 frame_bytes;
+	u64 msgs;           /* config frames: cmd rsp, tx cfm, fw print */
+	u64 pool_hits;
+	u64 pool_misses;
+	u64 napi_polls;
+	u64 napi_pkts;
+	u64 napi_drops;
+	u32 burst_max;      /* most reads done in one interrupt */
+};
+#endif
+
 struct aicwf_rx_priv {
 #ifdef AICWF_SDIO_SUPPORT
 	struct aic_sdio_dev *sdiodev;
+	/* recycled RX_POOL_BUFSZ skbs for the fifo reads */
+	struct sk_buff_head rx_pool;
+	u32 rx_pool_cnt;
+	u32 rx_pool_headroom;
+	/* frames handed to the stack through napi_gro_receive() */
+	struct net_device *napi_dev;
+	struct napi_struct napi;
+	struct sk_buff_head napi_q;
+	bool napi_batch;
+	struct aicwf_rx_stats stats;
 #endif
 #ifdef AICWF_USB_SUPPORT
 	struct aic_usb_dev *usbdev;
@@ -239,5 +302,10 @@ void aicwf_frame_tx(void *dev, struct sk_buff *skb);
 void aicwf_dev_skb_free(struct sk_buff *skb);
 struct sk_buff *aicwf_frame_dequeue(struct frame_queue *pq);
 struct sk_buff *aicwf_frame_queue_peek_tail(struct frame_queue *pq, int *prio_out);
+#ifdef AICWF_SDIO_SUPPORT
+struct sk_buff *aicwf_rx_pool_get(struct aicwf_rx_priv *rx_priv, u32 size);
+void aicwf_rx_pool_put(struct aicwf_rx_priv *rx_priv, struct sk_buff *skb);
+bool aicwf_rx_napi_enqueue(struct aicwf_rx_priv *rx_priv, struct sk_buff *skb);
+#endif
 
 #endif /* _AICWF_TXRXIF_H_ */
@@ -21,6 +21,9 @@
 #include "rwnx_msg_tx.h"
 #include "rwnx_radar.h"
 #include "rwnx_tx.h"
+#ifdef AICWF_SDIO_SUPPORT
+#include "aicwf_txrxif.h"
+#endif
 
 #ifdef CONFIG_DEBUG_FS
 #ifdef CONFIG_RWNX_FULLMAC
@@ -530,6 +533,123 @@ static ssize_t rwnx_dbgfs_acsinfo_read(struct file *file,
 
 DEBUGFS_READ_FILE_OPS(acsinfo);
 
+#ifdef AICWF_SDIO_SUPPORT
+static ssize_t rwnx_dbgfs_sdio_rx_read(struct file *file,
+									   char __user *user_buf,
+									   size_t count, loff_t *ppos)
+{
+	struct rwnx_hw *priv = file->private_data;
+	struct aicwf_rx_priv *rx_priv = priv->sdiodev->rx_priv;
+	struct aicwf_rx_stats *st = &rx_priv->stats;
+	char buf[640];
+	int len = 0;
+	u64 us, kbps = 0;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), st->since));
+	if (us)
+		kbps = div64_u64(st->read_bytes * 8 * 1000, us);
+
+	len += scnprintf(&buf[len], sizeof(buf) - len,
+					 "interrupts   %llu\n"
+					 "reads        %llu (max %u per interrupt)\n"
+					 "read bytes   %llu\n"
+					 "frames       %llu\n"
+					 "frame bytes  %llu\n"
+					 "cfg msgs     %llu\n",
+					 st->irqs, st->reads, st->burst_max, st->read_bytes,
+					 st->frames, st->frame_bytes, st->msgs);
+	len += scnprintf(&buf[len], sizeof(buf) - len,
+					 "pool         %u/%u free, %llu hits, %llu misses\n",
+					 skb_queue_len(&rx_priv->rx_pool), rx_priv->rx_pool_cnt,
+					 st->pool_hits, st->pool_misses);
+	len += scnprintf(&buf[len], sizeof(buf) - len,
+					 "napi         %s, %llu polls, %llu pkts, %llu drops\n",
+					 rx_priv->napi_dev ? "gro" : "off",
+					 st->napi_polls, st->napi_pkts, st->napi_drops);
+	len += scnprintf(&buf[len], sizeof(buf) - len,
+					 "throughput   %llu kbit/s over %llu ms\n",
+					 kbps, div_u64(us, 1000));
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
+}
+
+static ssize_t rwnx_dbgfs_sdio_rx_write(struct file *file,
+										const char __user *user_buf,
+										size_t count, loff_t *ppos)
+{
+	struct rwnx_hw *priv = file->private_data;
+	struct aicwf_rx_stats *st = &priv->sdiodev->rx_priv->stats;
+
+	/* counters are bumped locklessly from the rx paths, a reset
+	 * racing with them only skews the next sample */
+	memset(st, 0, sizeof(*st));
+	st->since = ktime_get();
+
+	return count;
+}
+
+DEBUGFS_READ_WRITE_FILE_OPS(sdio_rx);
+
+static ssize_t rwnx_dbgfs_sdio_tx_read(struct file *file,
+									   char __user *user_buf,
+									   size_t count, loff_t *ppos)
+{
+	static const char * const ac_name[TX_AC_NUM] = {"BK", "BE", "VI", "VO"};
+	struct rwnx_hw *priv = file->private_data;
+	struct aicwf_tx_priv *tx_priv = priv->sdiodev->tx_priv;
+	struct aicwf_tx_stats *st = &tx_priv->stats;
+	char buf[1024];
+	int len = 0, i;
+	u64 us, busy = 0, fc = 0, kbps = 0;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), st->since));
+	if (us) {
+		busy = div64_u64(st->busy_ns, us * 10);
+		fc = div64_u64(st->fc_wait_ns, us * 10);
+		kbps = div64_u64(st->bytes * 8 * 1000, us);
+	}
+
+	len += scnprintf(&buf[len], sizeof(buf) - len,
+					 "aggregates   %llu, %llu frames, %llu bytes\n"
+					 "bus busy     %llu%% writing, %llu%% waiting for credits\n"
+					 "throughput   %llu kbit/s over %llu ms\n"
+					 "bus rate     %u bytes/ms, target %u bytes\n"
+					 "stalls       %llu credit, %llu wakeups saved by xmit_more\n",
+					 st->aggrs, st->frames, st->bytes, busy, fc, kbps,
+					 div_u64(us, 1000), tx_priv->bus_rate, tx_priv->aggr_target,
+					 st->credit_stalls, st->xmit_deferred);
+
+	len += scnprintf(&buf[len], sizeof(buf) - len, "depth       ");
+	for (i = 0; i < TX_AGGR_DEPTH_BUCKETS; i++)
+		len += scnprintf(&buf[len], sizeof(buf) - len, " %u+:%u",
+						 1 << i, st->depth[i]);
+	len += scnprintf(&buf[len], sizeof(buf) - len, "\n");
+
+	for (i = 0; i < TX_AC_NUM; i++)
+		len += scnprintf(&buf[len], sizeof(buf) - len,
+						 "%s           %llu frames, %llu bytes, deficit %d\n",
+						 ac_name[i], st->ac_frames[i], st->ac_bytes[i],
+						 tx_priv->ac_deficit[i]);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
+}
+
+static ssize_t rwnx_dbgfs_sdio_tx_write(struct file *file,
+										const char __user *user_buf,
+										size_t count, loff_t *ppos)
+{
+	struct rwnx_hw *priv = file->private_data;
+	struct aicwf_tx_stats *st = &priv->sdiodev->tx_priv->stats;
+
+	memset(st, 0, sizeof(*st));
+	st->since = ktime_get();
+
+	return count;
+}
+
+DEBUGFS_READ_WRITE_FILE_OPS(sdio_tx);
+#endif
+
 static ssize_t rwnx_dbgfs_fw_dbg_read(struct file *file,
 										   char __user *user_buf,
 										   size_t count, loff_t *ppos)
@@ -2009,6 +2129,10 @@ int rwnx_dbgfs_register(struct rwnx_hw *rwnx_hw, const char *name)
 	DEBUGFS_ADD_FILE(sys_stats, dir_drv,  S_IRUSR);
 	DEBUGFS_ADD_FILE(txq, dir_drv, S_IRUSR);
 	DEBUGFS_ADD_FILE(acsinfo, dir_drv, S_IRUSR);
+#ifdef AICWF_SDIO_SUPPORT
+	DEBUGFS_ADD_FILE(sdio_rx, dir_drv, S_IWUSR | S_IRUSR);
+	DEBUGFS_ADD_FILE(sdio_tx, dir_drv, S_IWUSR | S_IRUSR);
+#endif
 #ifdef CONFIG_RWNX_MUMIMO_TX
 	DEBUGFS_ADD_FILE(mu_group, dir_drv, S_IRUSR);
 #endif
@@ -367,24 +367,13 @@ void rwnx_rx_data_skb_resend(struct rwnx_hw *rwnx_hw, struct rwnx_vif *rwnx_vif,
 	}
 }
 
-static void rwnx_rx_data_skb_forward(struct rwnx_hw *rwnx_hw, struct rwnx_vif *rwnx_vif,
-							 struct sk_buff *skb,  struct hw_rxhdr *rxhdr)
+static void rwnx_rx_netif_skb(struct rwnx_hw *rwnx_hw, struct sk_buff *rx_skb)
 {
-	struct sk_buff *rx_skb;
-
-	rx_skb = skb;
-	rx_skb->dev = rwnx_vif->ndev;
-	skb_reset_mac_header(rx_skb);
-
-	/* Update statistics */
-	rwnx_vif->net_stats.rx_packets++;
-	rwnx_vif->net_stats.rx_bytes += rx_skb->len;
-
-	//printk("forward\n");
+#ifdef AICWF_SDIO_SUPPORT
+	if (aicwf_rx_napi_enqueue(rwnx_hw->sdiodev->rx_priv, rx_skb))
+		return;
+#endif
 
-	rx_skb->protocol = eth_type_trans(rx_skb, rwnx_vif->ndev);
-	memset(rx_skb->cb, 0, sizeof(rx_skb->cb));
-	REG_SW_SET_PROFILING(rwnx_hw, SW_PROF_IEEE80211RX);
 	#ifdef CONFIG_RX_NETIF_RECV_SKB
 	local_bh_disable();
 	netif_receive_skb(rx_skb);
@@ -408,6 +397,27 @@ static void rwnx_rx_data_skb_forward(struct rwnx_hw *rwnx_hw, struct rwnx_vif *r
 	#endif
 	}
 	#endif
+}
+
+static void rwnx_rx_data_skb_forward(struct rwnx_hw *rwnx_hw, struct rwnx_vif *rwnx_vif,
+							 struct sk_buff *skb,  struct hw_rxhdr *rxhdr)
+{
+	struct sk_buff *rx_skb;
+
+	rx_skb = skb;
+	rx_skb->dev = rwnx_vif->ndev;
+	skb_reset_mac_header(rx_skb);
+
+	/* Update statistics */
+	rwnx_vif->net_stats.rx_packets++;
+	rwnx_vif->net_stats.rx_bytes += rx_skb->len;
+
+	//printk("forward\n");
+
+	rx_skb->protocol = eth_type_trans(rx_skb, rwnx_vif->ndev);
+	memset(rx_skb->cb, 0, sizeof(rx_skb->cb));
+	REG_SW_SET_PROFILING(rwnx_hw, SW_PROF_IEEE80211RX);
+	rwnx_rx_netif_skb(rwnx_hw, rx_skb);
 	REG_SW_CLEAR_PROFILING(rwnx_hw, SW_PROF_IEEE80211RX);
 
 	rwnx_hw->stats.last_rx = jiffies;
@@ -531,29 +541,7 @@ static bool rwnx_rx_data_skb(struct rwnx_hw *rwnx_hw, struct rwnx_vif *rwnx_vif,
 #endif
 			memset(rx_skb->cb, 0, sizeof(rx_skb->cb));
 			REG_SW_SET_PROFILING(rwnx_hw, SW_PROF_IEEE80211RX);
-			#ifdef CONFIG_RX_NETIF_RECV_SKB
-			local_bh_disable();
-			netif_receive_skb(rx_skb);
-			local_bh_enable();
-			#else
-			if (in_interrupt()) {
-				netif_rx(rx_skb);
-			} else {
-			/*
-			* If the receive is not processed inside an ISR, the softirqd must be woken explicitly to service the NET_RX_SOFTIRQ.
-			* * In 2.6 kernels, this is handledby netif_rx_ni(), but in earlier kernels, we need to do it manually.
-			*/
-			#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 0)
-				netif_rx_ni(rx_skb);
-			#else
-				ulong flags;
-				netif_rx(rx_skb);
-				local_irq_save(flags);
-				RAISE_RX_SOFTIRQ();
-				local_irq_restore(flags);
-			#endif
-			}
-			#endif
+			rwnx_rx_netif_skb(rwnx_hw, rx_skb);
 			REG_SW_CLEAR_PROFILING(rwnx_hw, SW_PROF_IEEE80211RX);
 
 			rwnx_hw->stats.last_rx = jiffies;
@@ -1358,29 +1346,7 @@ int reord_single_frame_ind(struct aicwf_rx_priv *rx_priv, struct recv_msdu *prfr
 		filter_rx_tcp_ack(rwnx_vif->rwnx_hw, rx_skb->data, cpu_to_le16(skb->len));
 #endif
 
-#ifdef CONFIG_RX_NETIF_RECV_SKB /* AIDEN test */
-		local_bh_disable();
-		netif_receive_skb(rx_skb);
-		local_bh_enable();
-#else
-		if (in_interrupt()) {
-			netif_rx(rx_skb);
-		} else {
-		/*
-		 * If the receive is not processed inside an ISR, the softirqd must be woken explicitly to service the NET_RX_SOFTIRQ.
-		 * * In 2.6 kernels, this is handledby netif_rx_ni(), but in earlier kernels, we need to do it manually.
-		 */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 0)
-			netif_rx_ni(rx_skb);
-#else
-			ulong flags;
-			netif_rx(rx_skb);
-			local_irq_save(flags);
-			RAISE_RX_SOFTIRQ();
-			local_irq_restore(flags);
-#endif
-		}
-#endif /* CONFIG_RX_NETIF_RECV_SKB */
+		rwnx_rx_netif_skb(rwnx_vif->rwnx_hw, rx_skb);
 	}
 
 	prframe->pkt = NULL;
@@ -1029,19 +1029,8 @@ end:
 }
 #endif /* CONFIG_RWNX_AMSDUS_TX */
 
-/**
- * netdev_tx_t (*ndo_start_xmit)(struct sk_buff *skb,
- *                               struct net_device *dev);
- *	Called when a packet needs to be transmitted.
- *	Must return NETDEV_TX_OK , NETDEV_TX_BUSY.
- *        (can also return NETDEV_TX_LOCKED if NETIF_F_LLTX)
- *
- *  - Initialize the desciptor for this pkt (stored in skb before data)
- *  - Push the pkt in the corresponding Txq
- *  - If possible (i.e. credit available and not in PS) the pkt is pushed
- *    to fw
- */
-netdev_tx_t rwnx_start_xmit(struct sk_buff *skb, struct net_device *dev)
+static netdev_tx_t __rwnx_start_xmit(struct sk_buff *skb, struct net_device *dev,
+									 bool xmit_more)
 {
 	struct rwnx_vif *rwnx_vif = netdev_priv(dev);
 	struct rwnx_hw *rwnx_hw = rwnx_vif->rwnx_hw;
@@ -1174,8 +1163,14 @@ netdev_tx_t rwnx_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	desc->host.hostid = sw_txhdr->dma_addr;
 
 	spin_lock_bh(&rwnx_hw->tx_lock);
+#ifdef AICWF_SDIO_SUPPORT
+	rwnx_hw->sdiodev->tx_priv->xmit_more = xmit_more;
+#endif
 	if (rwnx_txq_queue_skb(skb, txq, rwnx_hw, false))
 		rwnx_hwq_process(rwnx_hw, txq->hwq);
+#ifdef AICWF_SDIO_SUPPORT
+	rwnx_hw->sdiodev->tx_priv->xmit_more = false;
+#endif
 	spin_unlock_bh(&rwnx_hw->tx_lock);
 
 	return NETDEV_TX_OK;
@@ -1186,6 +1181,46 @@ free:
 	return NETDEV_TX_OK;
 }
 
+/**
+ * netdev_tx_t (*ndo_start_xmit)(struct sk_buff *skb,
+ *                               struct net_device *dev);
+ *	Called when a packet needs to be transmitted.
+ *	Must return NETDEV_TX_OK , NETDEV_TX_BUSY.
+ *        (can also return NETDEV_TX_LOCKED if NETIF_F_LLTX)
+ *
+ *  - Initialize the desciptor for this pkt (stored in skb before data)
+ *  - Push the pkt in the corresponding Txq
+ *  - If possible (i.e. credit available and not in PS) the pkt is pushed
+ *    to fw
+ *  - On SDIO the bus thread is only woken for the last frame of a burst,
+ *    whatever path that frame took, or once the queue got stopped: the
+ *    stack then makes no next call and the deferred frames hold the credits
+ */
+netdev_tx_t rwnx_start_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	netdev_tx_t ret;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+	bool xmit_more = netdev_xmit_more();
+#else
+	bool xmit_more = skb->xmit_more;
+#endif
+#ifdef AICWF_SDIO_SUPPORT
+	/* the skb may be gone once queued, look the txq up first */
+	struct netdev_queue *txq = netdev_get_tx_queue(dev, skb_get_queue_mapping(skb));
+#endif
+
+	ret = __rwnx_start_xmit(skb, dev, xmit_more);
+#ifdef AICWF_SDIO_SUPPORT
+	if (!xmit_more || ret != NETDEV_TX_OK || netif_xmit_stopped(txq)) {
+		struct rwnx_vif *rwnx_vif = netdev_priv(dev);
+
+		aicwf_sdio_tx_kick(rwnx_vif->rwnx_hw->sdiodev);
+	}
+#endif
+
+	return ret;
+}
+
 /**
  * rwnx_start_mgmt_xmit - Transmit a management frame
  *
@@ -87,7 +87,7 @@ int xradio_sta_add(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 	}
 	entry->status = XRADIO_LINK_HARD;
 	while ((skb = skb_dequeue(&entry->rx_queue)))
-		mac80211_rx_irqsafe(priv->hw, skb);
+		xradio_rx_deliver(priv->hw, skb);
 	spin_unlock_bh(&priv->ps_state_lock);
 
 #ifdef AP_AGGREGATE_FW_FIX
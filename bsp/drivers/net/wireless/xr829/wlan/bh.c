@@ -43,8 +43,13 @@
 #define SKB_CACHE_LEN    xr_sdio_blksize_align(500)
 #endif
 #define SKB_RESV_MAX    (1900)
+/* In AP mode RXed SKB can be looped back as a broadcast.
+ * Here we reserve enough space for headers. */
+#define SKB_RX_RESERVE  (WSM_TX_EXTRA_HEADROOM + 8 /* TKIP IV */ \
+			 - WSM_RX_EXTRA_HEADROOM)
 
 int tx_burst_limit = BH_TX_BURST_NONTXOP;
+u32 bh_bus_batch = BH_BUS_BATCH;
 
 /* Suspend state privates */
 enum xradio_bh_pm_state {
@@ -71,6 +76,7 @@ static inline u32 bh_time_interval(struct timespec64 *oldtime)
 int wsm_release_buffer_to_fw(struct xradio_vif *priv, int count);
 #endif
 static int xradio_bh(void *arg);
+static void xradio_skb_ring_refill(struct xradio_common *hw_priv);
 static void xradio_put_skb(struct xradio_common *hw_priv, struct sk_buff *skb);
 static struct sk_buff *xradio_get_skb(struct xradio_common *hw_priv, size_t len, u8 *flags);
 static inline int xradio_put_resv_skb(struct xradio_common *hw_priv,
@@ -463,6 +469,9 @@ static int xradio_proc(void *arg)
 		}
 		PERF_INFO_STAMP_UPDATE(&proc_start_time, &proc_wait, 0);
 
+#if BH_PROC_RX
+		xradio_rx_napi_batch(hw_priv, true);
+#endif
 		while (rx || tx) {
 			bh_printk(XRADIO_DBG_NIY, "%s rx=%d, tx=%d\n",
 				__func__, rx, tx);
@@ -579,6 +588,9 @@ static int xradio_proc(void *arg)
 			}
 #endif
 		}  /* while */
+#if BH_PROC_RX
+		xradio_rx_napi_batch(hw_priv, false);
+#endif
 
 		if (hw_priv->proc.proc_state) {
 			/* proc error occurs, to restart driver.*/
@@ -1002,6 +1014,9 @@ int xradio_init_resv_skb(struct xradio_common *hw_priv)
 	bh_printk(XRADIO_DBG_TRC, "%s\n", __func__);
 
 	spin_lock_init(&hw_priv->cache_lock);
+	skb_queue_head_init(&hw_priv->skb_ring);
+	xradio_skb_ring_refill(hw_priv);
+	hw_priv->bh_stats.since = ktime_get();
 	hw_priv->skb_reserved = xr_alloc_skb(len);
 	if (hw_priv->skb_reserved) {
 		hw_priv->skb_resv_len = len;
@@ -1023,6 +1038,7 @@ void xradio_deinit_resv_skb(struct xradio_common *hw_priv)
 		hw_priv->skb_reserved = NULL;
 		hw_priv->skb_resv_len = 0;
 	}
+	skb_queue_purge(&hw_priv->skb_ring);
 }
 
 int xradio_realloc_resv_skb(struct xradio_common *hw_priv,
@@ -1072,52 +1088,82 @@ static inline int xradio_put_resv_skb(struct xradio_common *hw_priv,
 	return 1; /* sbk not put to reserve*/
 }
 
+static inline size_t xradio_skb_alloc_len(size_t len)
+{
+	size_t alloc_len = (len > SKB_CACHE_LEN) ? len : SKB_CACHE_LEN;
+
+	/* TKIP IV + TKIP ICV and MIC - Piggyback.*/
+	return alloc_len + WSM_TX_EXTRA_HEADROOM + 8 + 12 - 2;
+}
+
+/*
+ * Top the skb ring up to XRADIO_SKB_RING_LEN. Called from process context
+ * while the bh is idle, so the rx path itself only dequeues.
+ */
+static void xradio_skb_ring_refill(struct xradio_common *hw_priv)
+{
+	struct sk_buff *skb;
+
+	while (skb_queue_len(&hw_priv->skb_ring) < XRADIO_SKB_RING_LEN) {
+		skb = xr_alloc_skb(xradio_skb_alloc_len(SKB_CACHE_LEN));
+		if (!skb)
+			break;
+		skb_reserve(skb, SKB_RX_RESERVE);
+		hw_priv->skb_ring_headroom = skb_headroom(skb);
+		skb_queue_tail(&hw_priv->skb_ring, skb);
+	}
+}
+
 static struct sk_buff *xradio_get_skb(struct xradio_common *hw_priv, size_t len, u8 *flags)
 {
 	struct sk_buff *skb = NULL;
-	size_t alloc_len = (len > SKB_CACHE_LEN) ? len : SKB_CACHE_LEN;
+	size_t alloc_len = xradio_skb_alloc_len(len);
 	bh_printk(XRADIO_DBG_TRC, "%s\n", __func__);
 
-	/* TKIP IV + TKIP ICV and MIC - Piggyback.*/
-	alloc_len += WSM_TX_EXTRA_HEADROOM + 8 + 12 - 2;
-	if (len > SKB_CACHE_LEN || !hw_priv->skb_cache) {
-		skb = xr_alloc_skb_pf(alloc_len);
-		/* In AP mode RXed SKB can be looped back as a broadcast.
-		 * Here we reserve enough space for headers. */
+	if (len <= SKB_CACHE_LEN) {
+		/* don't care size because min len is SKB_CACHE_LEN*/
+		skb = skb_dequeue(&hw_priv->skb_ring);
 		if (skb) {
-			skb_reserve(skb, WSM_TX_EXTRA_HEADROOM + 8 /* TKIP IV */
-					    - WSM_RX_EXTRA_HEADROOM);
-		} else {
-			skb = xradio_get_resv_skb(hw_priv, alloc_len);
-			if (skb) {
-				*flags |= ITEM_F_RESERVE;
-				bh_printk(XRADIO_DBG_WARN, "%s get skb_reserved(%zu)!\n",
-					__func__, alloc_len);
-			} else {
-				bh_printk(XRADIO_DBG_ERROR, "%s xr_alloc_skb failed(%zu)!\n",
-					__func__, alloc_len);
-			}
+			hw_priv->bh_stats.ring_hits++;
+			return skb;
 		}
+		hw_priv->bh_stats.ring_misses++;
+	}
+
+	skb = xr_alloc_skb_pf(alloc_len);
+	if (skb) {
+		skb_reserve(skb, SKB_RX_RESERVE);
 	} else {
-		/* don't care cache because min len is SKB_CACHE_LEN*/
-		/* spin_lock(&hw_priv->cache_lock); */
-		skb = hw_priv->skb_cache;
-		hw_priv->skb_cache = NULL;
-		/* spin_unlock(&hw_priv->cache_lock); */
+		skb = xradio_get_resv_skb(hw_priv, alloc_len);
+		if (skb) {
+			*flags |= ITEM_F_RESERVE;
+			bh_printk(XRADIO_DBG_WARN, "%s get skb_reserved(%zu)!\n",
+				__func__, alloc_len);
+		} else {
+			bh_printk(XRADIO_DBG_ERROR, "%s xr_alloc_skb failed(%zu)!\n",
+				__func__, alloc_len);
+		}
 	}
 	return skb;
 }
 
+/* May run in the proc thread while the bh dequeues, the ring has its own lock. */
 static void xradio_put_skb(struct xradio_common *hw_priv, struct sk_buff *skb)
 {
 	bh_printk(XRADIO_DBG_TRC, "%s\n", __func__);
-	/* spin_lock(&hw_priv->cache_lock); */
-	if (hw_priv->skb_cache)
+	if (skb_queue_len(&hw_priv->skb_ring) >= XRADIO_SKB_RING_LEN ||
+	    !hw_priv->skb_ring_headroom || skb_cloned(skb) || skb_shared(skb) ||
+	    skb_end_offset(skb) < hw_priv->skb_ring_headroom - SKB_RX_RESERVE +
+				  xradio_skb_alloc_len(SKB_CACHE_LEN)) {
 		dev_kfree_skb(skb);
-	else {
-		hw_priv->skb_cache = skb;
+		return;
 	}
-	/* spin_unlock(&hw_priv->cache_lock); */
+
+	/* wsm_handle_rx may have pulled headers, rewind to a fresh buffer. */
+	skb->data = skb->head + hw_priv->skb_ring_headroom;
+	skb->len = 0;
+	skb_reset_tail_pointer(skb);
+	skb_queue_tail(&hw_priv->skb_ring, skb);
 }
 
 static int xradio_bh_read_ctrl_reg(struct xradio_common *hw_priv,
@@ -1224,6 +1270,33 @@ static bool xradio_comingrx_update(struct xradio_common *hw_priv)
 }
 #endif
 
+/*
+ * The bh keeps the sdio host claimed across a run of transfers instead of
+ * claiming it for every WSM message, xradio_data_read/write nest inside.
+ * The claim is dropped before the bh sleeps or waits for an interrupt and
+ * after bh_bus_batch transfers, so other host users are not starved.
+ * bh_bus_batch of 0 or 1 claims per transfer as before.
+ */
+static inline void xradio_bh_bus_drop(struct xradio_common *hw_priv, u32 *held)
+{
+	if (*held) {
+		hw_priv->sbus_ops->unlock(hw_priv->sbus_priv);
+		*held = 0;
+	}
+}
+
+static inline void xradio_bh_bus_hold(struct xradio_common *hw_priv, u32 *held)
+{
+	if (*held >= bh_bus_batch)
+		xradio_bh_bus_drop(hw_priv, held);
+	if (!*held) {
+		hw_priv->sbus_ops->lock(hw_priv->sbus_priv);
+		hw_priv->bh_stats.bus_holds++;
+	}
+	if (++*held > hw_priv->bh_stats.hold_max)
+		hw_priv->bh_stats.hold_max = *held;
+}
+
 /* Must be called from BH thraed. */
 void xradio_enable_powersave(struct xradio_vif *priv, bool enable)
 {
@@ -1283,6 +1356,7 @@ static int xradio_bh(void *arg)
 #endif
 	int reg_read = 1;
 	int vif_selected;
+	u32 bus_held = 0;
 
 	bh_printk(XRADIO_DBG_MSG, "%s\n", __func__);
 	ret = sched_setscheduler(hw_priv->bh_thread, SCHED_FIFO, &param);
@@ -1292,6 +1366,13 @@ static int xradio_bh(void *arg)
 
 	PERF_INFO_GETTIME(&last_showtime);
 	for (;;) {
+		/* Release the bus and hand the rx batch up before waiting. */
+		xradio_bh_bus_drop(hw_priv, &bus_held);
+#if !BH_PROC_RX
+		xradio_rx_napi_batch(hw_priv, false);
+#endif
+		xradio_skb_ring_refill(hw_priv);
+
 		PERF_INFO_GETTIME(&bh_start_time);
 		/* Check if devices can sleep, and set time to wait for interrupt. */
 		if (!hw_priv->hw_bufs_used && !pending_tx &&
@@ -1531,6 +1612,9 @@ data_proc:
 		term = kthread_should_stop();
 		if (hw_priv->bh_error || term)
 			break;
+#if !BH_PROC_RX
+		xradio_rx_napi_batch(hw_priv, true);
+#endif
 		/*pre-txrx*/
 		tx_bursted = 0;
 
@@ -1576,6 +1660,7 @@ rx:
 				((ITEM_RESERVED*PROC_POOL_NUM) - XRWL_MAX_QUEUE_SZ - 1))) {
 				bh_printk(XRADIO_DBG_WARN,
 					"Too many rx packets, proc cannot handle in time!\n");
+				xradio_bh_bus_drop(hw_priv, &bus_held);
 				msleep(10);
 				goto tx; /* too many rx packets to be handled, do tx first*/
 			}
@@ -1615,11 +1700,13 @@ rx:
 
 			/* Read data from device. */
 			PERF_INFO_GETTIME(&rx_start_time2);
+			xradio_bh_bus_hold(hw_priv, &bus_held);
 			if (SYS_WARN(xradio_data_read(hw_priv, data, alloc_len))) {
 				hw_priv->bh_error = __LINE__;
 				break;
 			}
 			DBG_INT_ADD(rx_total_cnt);
+			hw_priv->bh_stats.rx_msgs++;
 
 			PERF_INFO_STAMP_UPDATE(&rx_start_time2, &sdio_read, alloc_len);
 
@@ -1751,6 +1838,9 @@ rx:
 			if (!read_len) {
 				rx = 0;
 				rx_burst = 0;
+#if !BH_PROC_RX
+				xradio_rx_napi_kick(hw_priv);
+#endif
 				goto tx;
 			} else if (rx_burst) {
 				xradio_debug_rx_burst(hw_priv);
@@ -1781,6 +1871,8 @@ tx:
 			PERF_INFO_GETTIME(&tx_start_time1);
 			/* Wake up the devices */
 			if (hw_priv->device_can_sleep) {
+				/* wakeup waits for the irq, which needs the host. */
+				xradio_bh_bus_drop(hw_priv, &bus_held);
 				ret = xradio_device_wakeup(hw_priv, &ctrl_reg);
 				if (SYS_WARN(ret < 0)) {
 					hw_priv->bh_error = __LINE__;
@@ -1870,6 +1962,7 @@ tx:
 				PERF_INFO_STAMP(&tx_start_time1, &prepare_tx, tx_len);
 				PERF_INFO_GETTIME(&tx_start_time2);
 				/* Send the data to devices. */
+				xradio_bh_bus_hold(hw_priv, &bus_held);
 				if (SYS_WARN(xradio_data_write(hw_priv, data, tx_len))) {
 					wsm_release_tx_buffer(hw_priv, 1);
 					bh_printk(XRADIO_DBG_ERROR, "xradio_data_write failed\n");
@@ -1877,6 +1970,7 @@ tx:
 					break;
 				}
 				DBG_INT_ADD(tx_total_cnt);
+				hw_priv->bh_stats.tx_msgs++;
 				PERF_INFO_STAMP(&tx_start_time2, &sdio_write, tx_len);
 
 #if defined(CONFIG_XRADIO_DEBUG)
@@ -2017,6 +2111,11 @@ tx:
 #endif
 	}			/* for (;;) */
 
+	xradio_bh_bus_drop(hw_priv, &bus_held);
+#if !BH_PROC_RX
+	xradio_rx_napi_batch(hw_priv, false);
+#endif
+
 	/* Free the SKB buffer when exit. */
 	if (skb_rx) {
 		dev_kfree_skb(skb_rx);
@@ -25,6 +25,25 @@
 #define BH_WAITING_RX_THRESHOLD  8
 #endif
 
+/* rx skbs kept ready by the bh, refilled while it is idle. */
+#define XRADIO_SKB_RING_LEN  16
+/* sdio transfers the bh may do under one host claim. */
+#define BH_BUS_BATCH         32
+
+/* Data path counters, shown and cleared by debugfs bh_pps. */
+struct xradio_bh_stats {
+	ktime_t  since;
+	u32      rx_msgs;      /* WSM messages read from device */
+	u32      tx_msgs;      /* WSM messages written to device */
+	u32      rx_frames;    /* frames handed to mac80211 */
+	u32      bus_holds;    /* host claims taken by the bh */
+	u32      hold_max;     /* most transfers under one claim */
+	u32      ring_hits;
+	u32      ring_misses;
+	u32      napi_polls;
+	u32      napi_frames;
+};
+
 #ifdef BH_PROC_THREAD
 struct bh_items {
 	struct list_head  head;
@@ -87,6 +106,7 @@ int xradio_init_resv_skb(struct xradio_common *hw_priv);
 void xradio_deinit_resv_skb(struct xradio_common *hw_priv);
 int xradio_realloc_resv_skb(struct xradio_common *hw_priv,
 							struct sk_buff *skb, u8 flags);
+extern u32 bh_bus_batch;
 
 #ifdef BH_PROC_THREAD
 void xradio_proc_wakeup(struct xradio_common *hw_priv);
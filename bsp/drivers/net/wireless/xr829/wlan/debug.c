@@ -2609,6 +2609,46 @@ static const struct file_operations fops_bh_stat = {
 	.llseek = default_llseek,
 };
 
+/* messages and frames per second since the last read, which clears them. */
+static ssize_t xradio_bh_pps(struct file *file,
+	char __user *user_buf, size_t count, loff_t *ppos)
+{
+	struct xradio_common *hw_priv = file->private_data;
+	struct xradio_bh_stats *st = &hw_priv->bh_stats;
+	ktime_t now = ktime_get();
+	u64 ms = ktime_ms_delta(now, st->since);
+	char buf[512];
+	size_t size = 0;
+
+	if (!ms)
+		ms = 1;
+#define PPS(n) ((u32)div64_u64((u64)(n) * 1000, ms))
+	sprintf(buf, "time=%llums, rx_msgs=%u(%u/s), tx_msgs=%u(%u/s), "
+		"rx_frames=%u(%u/s)\n"
+		"bus_holds=%u, msgs/hold=%u, hold_max=%u, bus_batch=%u\n"
+		"ring_hits=%u, ring_misses=%u, napi_polls=%u, napi_frames=%u\n",
+		ms, st->rx_msgs, PPS(st->rx_msgs), st->tx_msgs, PPS(st->tx_msgs),
+		st->rx_frames, PPS(st->rx_frames),
+		st->bus_holds, st->bus_holds ?
+		(st->rx_msgs + st->tx_msgs) / st->bus_holds : 0,
+		st->hold_max, bh_bus_batch, st->ring_hits, st->ring_misses,
+		st->napi_polls, st->napi_frames);
+#undef PPS
+	size = strlen(buf);
+
+	/*clear counters*/
+	memset(st, 0, sizeof(*st));
+	st->since = now;
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, size);
+}
+
+static const struct file_operations fops_bh_pps = {
+	.open = xradio_generic_open,
+	.read = xradio_bh_pps,
+	.llseek = default_llseek,
+};
+
 /* time info of bh tx and rx */
 #if PERF_INFO_TEST
 static inline void perf_info_reset(struct perf_info *info)
@@ -3959,6 +3999,9 @@ int xradio_host_dbg_init(void)
 	debugfs_create_u32("tx_burst_limit", S_IRUSR | S_IWUSR,
 				   debugfs_host, &tx_burst_limit);
 
+	debugfs_create_u32("bh_bus_batch", S_IRUSR | S_IWUSR,
+				   debugfs_host, &bh_bus_batch);
+
 #ifdef ERROR_HANG_DRIVER
 	debugfs_create_u8("error_hang_driver", S_IRUSR | S_IWUSR,
 				   debugfs_host, &error_hang_driver);
@@ -4123,6 +4166,10 @@ int xradio_debug_init_common(struct xradio_common *hw_priv)
 		  hw_priv, &fops_bh_stat))
 		ERR_LINE;
 
+	if (!debugfs_create_file("bh_pps", S_IRUSR, d->debugfs_phy,
+		  hw_priv, &fops_bh_pps))
+		ERR_LINE;
+
 #if PERF_INFO_TEST
 	if (!debugfs_create_file("perf_info", S_IRUSR, d->debugfs_phy,
 		  hw_priv, &fops_perf_info))
@@ -964,6 +964,7 @@ struct ieee80211_hw *xradio_init_common(size_t hw_priv_data_len)
 	spin_lock_init(&hw_priv->wsm_cmd.lock);
 	tx_policy_init(hw_priv);
 	xradio_init_resv_skb(hw_priv);
+	xradio_rx_napi_init(hw_priv);
 
 	for (i = 0; i < XRWL_MAX_VIFS; i++)
 		hw_priv->hw_bufs_used_vif[i] = 0;
@@ -1042,11 +1043,8 @@ void xradio_free_common(struct ieee80211_hw *dev)
 	destroy_workqueue(hw_priv->spare_workqueue);
 	hw_priv->spare_workqueue = NULL;
 
+	xradio_rx_napi_deinit(hw_priv);
 	xradio_deinit_resv_skb(hw_priv);
-	if (hw_priv->skb_cache) {
-		dev_kfree_skb(hw_priv->skb_cache);
-		hw_priv->skb_cache = NULL;
-	}
 
 	for (i = 0; i < 4; ++i)
 		xradio_queue_deinit(&hw_priv->tx_queue[i]);
@@ -1106,6 +1104,8 @@ void xradio_unregister_common(struct ieee80211_hw *dev)
 #endif
 
 	if (wiphy_dev(dev->wiphy)) {
+		/* no frames may reach mac80211 once it is gone. */
+		xradio_rx_napi_deinit(hw_priv);
 		mac80211_unregister_hw(dev);
 		SET_IEEE80211_DEV(dev, NULL);
 		xradio_debug_release_common(hw_priv);
@@ -1991,7 +1991,7 @@ void xradio_event_handler(struct work_struct *work)
 								    IEEE80211_STYPE_DEAUTH);
 				deauth->u.deauth.reason_code = WLAN_REASON_DEAUTH_LEAVING;
 				deauth->seq_ctrl = 0;
-				mac80211_rx_irqsafe(priv->hw, skb);
+				xradio_rx_deliver(priv->hw, skb);
 				sta_printk(XRADIO_DBG_WARN, "Inactivity Deauth Frame sent" \
 					   " for MAC SA %pM and DA %pM\n",
 					   deauth->sa, deauth->da);
@@ -3209,10 +3209,10 @@ void xradio_rx_cb(struct xradio_vif *priv,
 			skb_queue_tail(&entry->rx_queue, skb);
 			txrx_printk(XRADIO_DBG_WARN, "***skb_queue_tail\n");
 		} else
-			mac80211_rx_irqsafe(priv->hw, skb);
+			xradio_rx_deliver(priv->hw, skb);
 		spin_unlock_bh(&priv->ps_state_lock);
 	} else {
-		mac80211_rx_irqsafe(priv->hw, skb);
+		xradio_rx_deliver(priv->hw, skb);
 	}
 	*skb_p = NULL;
 	PERF_INFO_STAMP(&upper_rx_time, &mac_rx, upper_rx_size);
@@ -3227,6 +3227,126 @@ drop:
 /* ******************************************************************** */
 /* Security								*/
 
+/*
+ * All frames for mac80211 go through here. With BH_RX_NAPI they are queued
+ * and handed up from a NAPI poll, so data frames reach GRO and the bh only
+ * pays for a list append. mac80211 must not get frames from napi and from
+ * its irqsafe tasklet at once, so the tasklet is used only without napi.
+ */
+void xradio_rx_deliver(struct ieee80211_hw *hw, struct sk_buff *skb)
+{
+	struct xradio_common *hw_priv = hw->priv;
+
+	hw_priv->bh_stats.rx_frames++;
+#ifdef BH_RX_NAPI
+	if (hw_priv->rx_napi_dev) {
+		skb_queue_tail(&hw_priv->rx_napi_q, skb);
+		/* the batching thread kicks once it has drained the device */
+		if (hw_priv->rx_napi_batch != current ||
+		    skb_queue_len(&hw_priv->rx_napi_q) >= NAPI_POLL_WEIGHT)
+			xradio_rx_napi_kick(hw_priv);
+		return;
+	}
+#endif
+	mac80211_rx_irqsafe(hw, skb);
+}
+
+#ifdef BH_RX_NAPI
+static int xradio_rx_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct xradio_common *hw_priv =
+		container_of(napi, struct xradio_common, rx_napi);
+	struct sk_buff *skb;
+	int done = 0;
+
+	while (done < budget) {
+		skb = skb_dequeue(&hw_priv->rx_napi_q);
+		if (!skb)
+			break;
+		mac80211_rx_napi(hw_priv->hw, NULL, skb, napi);
+		done++;
+	}
+
+	hw_priv->bh_stats.napi_polls++;
+	hw_priv->bh_stats.napi_frames += done;
+
+	if (done < budget) {
+		napi_complete_done(napi, done);
+		if (!skb_queue_empty(&hw_priv->rx_napi_q))
+			napi_schedule(napi);
+	}
+	return done;
+}
+
+void xradio_rx_napi_kick(struct xradio_common *hw_priv)
+{
+	if (!hw_priv->rx_napi_dev || skb_queue_empty(&hw_priv->rx_napi_q))
+		return;
+
+	/* run the poll now rather than at the next irq exit */
+	local_bh_disable();
+	napi_schedule(&hw_priv->rx_napi);
+	local_bh_enable();
+}
+
+/* Defer the kicks of frames delivered by the calling thread until !start. */
+void xradio_rx_napi_batch(struct xradio_common *hw_priv, bool start)
+{
+	if (start) {
+		hw_priv->rx_napi_batch = current;
+	} else {
+		hw_priv->rx_napi_batch = NULL;
+		xradio_rx_napi_kick(hw_priv);
+	}
+}
+
+void xradio_rx_napi_init(struct xradio_common *hw_priv)
+{
+	skb_queue_head_init(&hw_priv->rx_napi_q);
+	hw_priv->rx_napi_batch = NULL;
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0))
+	hw_priv->rx_napi_dev = alloc_netdev_dummy(0);
+#else
+	hw_priv->rx_napi_dev = xr_kzalloc(sizeof(struct net_device), false);
+	if (hw_priv->rx_napi_dev)
+		init_dummy_netdev(hw_priv->rx_napi_dev);
+#endif
+	if (!hw_priv->rx_napi_dev) {
+		txrx_printk(XRADIO_DBG_WARN,
+			    "%s no napi dev, rx goes by tasklet.\n", __func__);
+		return;
+	}
+
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(6, 1, 0))
+	netif_napi_add(hw_priv->rx_napi_dev, &hw_priv->rx_napi,
+		       xradio_rx_napi_poll, NAPI_POLL_WEIGHT);
+#else
+	netif_napi_add(hw_priv->rx_napi_dev, &hw_priv->rx_napi,
+		       xradio_rx_napi_poll);
+#endif
+	napi_enable(&hw_priv->rx_napi);
+}
+
+void xradio_rx_napi_deinit(struct xradio_common *hw_priv)
+{
+	struct net_device *dev = hw_priv->rx_napi_dev;
+
+	if (!dev)
+		return;
+
+	napi_disable(&hw_priv->rx_napi);
+	hw_priv->rx_napi_dev = NULL;
+	netif_napi_del(&hw_priv->rx_napi);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0))
+	free_netdev(dev);
+#else
+	kfree(dev);
+#endif
+	skb_queue_purge(&hw_priv->rx_napi_q);
+}
+#endif /* BH_RX_NAPI */
+
 int xradio_alloc_key(struct xradio_common *hw_priv)
 {
 	int idx;
@@ -198,6 +198,23 @@ void xradio_rx_cb(struct xradio_vif *priv,
 		  struct wsm_rx *arg,
 		  struct sk_buff **skb_p);
 
+/* ******************************************************************** */
+/* Rx delivery								*/
+
+void xradio_rx_deliver(struct ieee80211_hw *hw, struct sk_buff *skb);
+#ifdef BH_RX_NAPI
+void xradio_rx_napi_init(struct xradio_common *hw_priv);
+void xradio_rx_napi_deinit(struct xradio_common *hw_priv);
+void xradio_rx_napi_kick(struct xradio_common *hw_priv);
+void xradio_rx_napi_batch(struct xradio_common *hw_priv, bool start);
+#else
+static inline void xradio_rx_napi_init(struct xradio_common *hw_priv) {}
+static inline void xradio_rx_napi_deinit(struct xradio_common *hw_priv) {}
+static inline void xradio_rx_napi_kick(struct xradio_common *hw_priv) {}
+static inline void xradio_rx_napi_batch(struct xradio_common *hw_priv,
+					bool start) {}
+#endif
+
 /* ******************************************************************** */
 /* Timeout								*/
 
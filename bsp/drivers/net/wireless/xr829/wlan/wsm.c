@@ -1561,7 +1561,7 @@ void wsm_send_deauth_to_self(struct xradio_common *hw_priv,
 				memcpy(deauth->bssid, priv->vif->addr, ETH_ALEN);
 				deauth->seq_ctrl = 0;
 				deauth->u.deauth.reason_code = WLAN_REASON_DEAUTH_LEAVING;
-				mac80211_rx_irqsafe(priv->hw, skb);
+				xradio_rx_deliver(priv->hw, skb);
 			}
 		}
 	} else if (priv->join_status == XRADIO_JOIN_STATUS_STA) {
@@ -1584,7 +1584,7 @@ void wsm_send_deauth_to_self(struct xradio_common *hw_priv,
 		memcpy(deauth->bssid, priv->join_bssid, ETH_ALEN);
 		deauth->seq_ctrl = 0;
 		deauth->u.deauth.reason_code = WLAN_REASON_DEAUTH_LEAVING;
-		mac80211_rx_irqsafe(priv->hw, skb);
+		xradio_rx_deliver(priv->hw, skb);
 		priv->setbssparams_done = false;
 	}
 }
@@ -1618,7 +1618,7 @@ void wsm_send_disassoc_to_self(struct xradio_common *hw_priv,
 				disassoc->seq_ctrl = 0;
 				disassoc->u.disassoc.reason_code =
 				      WLAN_REASON_DISASSOC_STA_HAS_LEFT;
-				mac80211_rx_irqsafe(priv->hw, skb);
+				xradio_rx_deliver(priv->hw, skb);
 			}
 		}
 	} else if (priv->join_status == XRADIO_JOIN_STATUS_STA) {
@@ -1642,7 +1642,7 @@ void wsm_send_disassoc_to_self(struct xradio_common *hw_priv,
 		disassoc->seq_ctrl = 0;
 		disassoc->u.disassoc.reason_code =
 		     WLAN_REASON_DISASSOC_DUE_TO_INACTIVITY;
-		mac80211_rx_irqsafe(priv->hw, skb);
+		xradio_rx_deliver(priv->hw, skb);
 		priv->setbssparams_done = false;
 	}
 }
@@ -2974,7 +2974,7 @@ int wsm_handle_rx(struct xradio_common *hw_priv, u8 flags, struct sk_buff **skb_
 					if (!hw_priv->beacon_bkp)
 						hw_priv->beacon_bkp = \
 						skb_copy(hw_priv->beacon, GFP_ATOMIC);
-					mac80211_rx_irqsafe(hw_priv->hw, hw_priv->beacon);
+					xradio_rx_deliver(hw_priv->hw, hw_priv->beacon);
 					hw_priv->beacon = hw_priv->beacon_bkp;
 
 					hw_priv->beacon_bkp = NULL;
@@ -362,10 +362,18 @@ struct xradio_common {
 	int				wsm_tx_seq;	/* byte */
 	int				hw_bufs_used;
 	int				hw_bufs_used_vif[XRWL_MAX_VIFS];
-	struct sk_buff			*skb_cache;
+	struct sk_buff_head		skb_ring;
+	int				skb_ring_headroom;
 	struct sk_buff			*skb_reserved;
 	int						 skb_resv_len;
 	spinlock_t				 cache_lock;
+	struct xradio_bh_stats		bh_stats;
+#ifdef BH_RX_NAPI
+	struct net_device		*rx_napi_dev;
+	struct napi_struct		rx_napi;
+	struct sk_buff_head		rx_napi_q;
+	struct task_struct		*rx_napi_batch;
+#endif
 	bool				powersave_enabled;
 	bool				device_can_sleep;
 	/* Keep xradio awake (WUP = 1) 1 second after each scan to avoid
@@ -878,6 +878,11 @@ static vip_status_e do_destroy(void)
     }
 #endif
 
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+    /* give the small-block arena of this process back to the shared heap */
+    gckvip_heap_arena_release(&context->video_mem_heap, gckvip_os_get_pid());
+#endif
+
     /* Mark uninitialized. */
 #if vpmdENABLE_MULTIPLE_TASK
     if (VIP_SUCCESS == gckvip_hashmap_remove(&context->process_id, GCKVIPUINT64_TO_PTR(gckvip_os_get_pid()))) {
@@ -1097,7 +1102,7 @@ static vip_status_e do_allocation_videomem(void *data)
 {
     vip_status_e status = VIP_SUCCESS;
     gckvip_allocation_t *allocation = (gckvip_allocation_t *)data;
-    vip_uint32_t alloc_flag = allocation->alloc_flag;
+    vip_uint32_t alloc_flag = allocation->alloc_flag & ~GCVIP_VIDEO_MEM_ALLOC_PROCESS_ARENA;
     gckvip_video_memory_t memory = {0};
     phy_address_t physical_tmp = 0;
     vip_uint32_t handle_id = 0;
@@ -1107,8 +1112,8 @@ static vip_status_e do_allocation_videomem(void *data)
     GCKVIP_CHECK_INIT();
 
     status = gckvip_mem_allocate_videomemory(context, allocation->size, &memory.handle,
-                                             &memory.logical, &physical_tmp,
-                                             allocation->align, alloc_flag);
+                                             &memory.logical, &physical_tmp, allocation->align,
+                                             alloc_flag | GCVIP_VIDEO_MEM_ALLOC_PROCESS_ARENA);
     if (status != VIP_SUCCESS) {
         PRINTK_E("fail to allocate video memory in allocation videomem, size=0x%x, status=%d\n",
                   allocation->size, status);
@@ -1290,6 +1295,66 @@ onError:
     return status;
 }
 
+#if vpmdENABLE_DMA_FENCE
+static vip_status_e do_submit_fence(void *data)
+{
+    vip_status_e status = VIP_SUCCESS;
+    gckvip_commit_fence_t *info = (gckvip_commit_fence_t *)data;
+    GET_CONTEXTK();
+    gcIsNULL(info);
+    GCKVIP_CHECK_DEV(info->commit.device_id);
+    GCKVIP_CHECK_INIT();
+
+    status = gckvip_cmd_do_submit_fence(context, info);
+    if (status != VIP_SUCCESS) {
+        PRINTK_E("fail to do fence submit handle=0x%x, status=%d.\n", info->commit.cmd_handle, status);
+        gcGoOnError(status);
+    }
+
+onError:
+    return status;
+}
+
+/*
+@brief queue several commits in one call, the commits are executed back to back by the
+       multi-task thread. stop at the first failure, queued returns how many are submitted.
+*/
+static vip_status_e do_submit_batch(void *data)
+{
+    vip_status_e status = VIP_SUCCESS;
+    gckvip_commit_batch_t *batch = (gckvip_commit_batch_t *)data;
+    vip_uint32_t i = 0;
+    GET_CONTEXTK();
+    gcIsNULL(batch);
+    batch->queued = 0;
+    GCKVIP_CHECK_INIT();
+
+    if ((0 == batch->count) || (batch->count > GCKVIP_MAX_BATCH_COMMIT)) {
+        PRINTK_E("fail to batch submit, count=%d\n", batch->count);
+        gcGoOnError(VIP_ERROR_INVALID_ARGUMENTS);
+    }
+    for (i = 0; i < batch->count; i++) {
+        gckvip_commit_fence_t *info = &batch->commits[i];
+        info->out_fence_fd = GCKVIP_FENCE_FD_NONE;
+        GCKVIP_CHECK_DEV(info->commit.device_id);
+        status = gckvip_cmd_do_submit_fence(context, info);
+        if (status != VIP_SUCCESS) {
+            PRINTK_E("fail to batch submit commit%d handle=0x%x, status=%d.\n",
+                      i, info->commit.cmd_handle, status);
+            break;
+        }
+        batch->queued++;
+    }
+
+onError:
+    /* the out-fences of queued commits have to reach user space */
+    if ((batch != VIP_NULL) && (batch->queued > 0)) {
+        status = VIP_SUCCESS;
+    }
+    return status;
+}
+#endif
+
 /*
 @brief query wait-link address info for agent driver used.
 */
@@ -1903,6 +1968,11 @@ vip_status_e gckvip_destroy(void)
                 }
                 else {
                     /* del directly */
+                    #if vpmdENABLE_DMA_FENCE
+                    gckvip_os_lock_mutex(m_task->cancel_mutex);
+                    gckvip_cmd_drop_fence(m_task, VIP_ERROR_CANCELED);
+                    gckvip_os_unlock_mutex(m_task->cancel_mutex);
+                    #endif
                     m_task->status = GCKVIP_TASK_EMPTY;
                     if (VIP_NULL != m_task->queue_data) {
                         m_task->queue_data->v2 = VIP_ERROR_CANCELED;
@@ -2094,6 +2164,16 @@ vip_status_e gckvip_kernel_call(
         status = do_submit(data);
         break;
 
+#if vpmdENABLE_DMA_FENCE
+    case KERNEL_CMD_SUBMIT_FENCE:   /* command buffer submit gated by sync_file fences. */
+        status = do_submit_fence(data);
+        break;
+
+    case KERNEL_CMD_SUBMIT_BATCH:   /* queue several command buffers at once. */
+        status = do_submit_batch(data);
+        break;
+#endif
+
     case KERNEL_CMD_ALLOCATION:     /* VIP buffer allocation command. */
         status = do_allocation_videomem(data);
         break;
@@ -154,6 +154,12 @@ typedef struct _gckvip_submit
     vip_uint32_t    pid;
     vip_uint32_t    time_out;
 #endif
+#if vpmdENABLE_DMA_FENCE
+    /* waited before committing to hardware */
+    gckvip_fence    in_fence;
+    /* signaled when inference done, the task is retired without user wait */
+    gckvip_fence    out_fence;
+#endif
 } gckvip_submit_t;
 
 typedef struct _gckvip_wait_cmd
@@ -448,6 +448,11 @@ vip_status_e gckvip_cmd_thread_handle(
     gckvip_pm_t* pm = &device->dp_management;
 #endif
     gckvip_wait_cmd_t wait_data;
+#if vpmdENABLE_DMA_FENCE
+    gckvip_fence in_fence = VIP_NULL;
+    gckvip_fence out_fence = VIP_NULL;
+    vip_status_e fence_status = VIP_SUCCESS;
+#endif
     wait_data.mask = 0xFFFFFFFF;
 
     gckvip_os_set_atomic(device->mt_thread_running, vip_true_e);
@@ -468,10 +473,26 @@ vip_status_e gckvip_cmd_thread_handle(
             }
             PRINTK_I("multi-task dev%d task slot index=%d, start submit command mem_handle=0x%"PRPx"\n",
                      device_id, queue_data->v1, m_task->submit_handle.cmd_handle);
+        #if vpmdENABLE_DMA_FENCE
+            /* wait the producer without holding any lock, the task can be canceled meanwhile */
+            gckvip_os_lock_mutex(m_task->cancel_mutex);
+            in_fence = m_task->submit_handle.in_fence;
+            m_task->submit_handle.in_fence = VIP_NULL;
+            gckvip_os_unlock_mutex(m_task->cancel_mutex);
+            fence_status = VIP_SUCCESS;
+            if (in_fence != VIP_NULL) {
+                fence_status = gckvip_os_wait_fence(in_fence, m_task->submit_handle.time_out);
+                gckvip_os_put_fence(in_fence);
+                in_fence = VIP_NULL;
+            }
+        #endif
             /* make sure other thread can not change power state during submit */
             gckvip_lock_recursive_mutex(&pm->mutex);
             gckvip_os_lock_mutex(m_task->cancel_mutex);
             if (m_task->status != GCKVIP_TASK_WITH_DATA) {
+            #if vpmdENABLE_DMA_FENCE
+                gckvip_cmd_drop_fence(m_task, VIP_ERROR_CANCELED);
+            #endif
                 gckvip_os_unlock_mutex(m_task->cancel_mutex);
                 gckvip_unlock_recursive_mutex(&pm->mutex);
                 gckvip_hashmap_unuse(&device->mt_hashmap, queue_data->v1, vip_true_e);
@@ -479,6 +500,12 @@ vip_status_e gckvip_cmd_thread_handle(
                 continue;
             }
             /* submit command buffer */
+        #if vpmdENABLE_DMA_FENCE
+            if (fence_status != VIP_SUCCESS) {
+                status = fence_status;
+            }
+            else
+        #endif
             status = gckvip_cmd_submit(context, (void*)&m_task->submit_handle);
             m_task->status = GCKVIP_TASK_INFER_START;
             m_task->inference_running = vip_true_e;
@@ -502,10 +529,28 @@ vip_status_e gckvip_cmd_thread_handle(
             m_task->inference_running = vip_false_e;
             m_task->queue_data->v2 = status;
             gckvip_os_lock_mutex(m_task->cancel_mutex);
+        #if vpmdENABLE_DMA_FENCE
+            out_fence = m_task->submit_handle.out_fence;
+            m_task->submit_handle.out_fence = VIP_NULL;
+            if ((out_fence != VIP_NULL) && (m_task->status != GCKVIP_TASK_CANCELED)) {
+                /* nobody waits a fenced task, retire it so the same command can be submitted again */
+                gckvip_hashmap_remove(&device->mt_hashmap, m_task->submit_handle.cmd_handle);
+                m_task->submit_handle.cmd_handle = VIP_NULL;
+                m_task->status = GCKVIP_TASK_EMPTY;
+            }
+            else
+        #endif
             /* wait do cancel end */
             m_task->status = GCKVIP_TASK_INFER_END;
             gckvip_os_unlock_mutex(m_task->cancel_mutex);
             gckvip_hashmap_unuse(&device->mt_hashmap, queue_data->v1, vip_true_e);
+        #if vpmdENABLE_DMA_FENCE
+            if (out_fence != VIP_NULL) {
+                gckvip_os_signal_fence(out_fence, status);
+                gckvip_os_put_fence(out_fence);
+                out_fence = VIP_NULL;
+            }
+        #endif
         }
     }
 
@@ -671,9 +716,11 @@ onError:
     return status;
 }
 
-vip_status_e gckvip_cmd_do_submit(
+static vip_status_e cmd_do_submit(
     gckvip_context_t *context,
-    gckvip_commit_t *commit
+    gckvip_commit_t *commit,
+    gckvip_fence in_fence,
+    gckvip_fence out_fence
     )
 {
     vip_status_e status = VIP_SUCCESS;
@@ -698,6 +745,13 @@ vip_status_e gckvip_cmd_do_submit(
 
 #if vpmdREGISTER_NETWORK
     if (vip_true_e == gckvip_check_segment_skip(cmd_handle)) {
+    #if vpmdENABLE_DMA_FENCE
+        /* nothing to run, release the producer and complete the consumer now */
+        if (in_fence != VIP_NULL) {
+            gckvip_os_put_fence(in_fence);
+        }
+        gckvip_os_signal_fence(out_fence, VIP_SUCCESS);
+    #endif
         goto Skip;
     }
 #endif
@@ -811,6 +865,11 @@ Expand:
     #endif
         m_task->queue_data->v1 = i;
         m_task->queue_data->v2 = VIP_ERROR_FAILURE;
+    #if vpmdENABLE_DMA_FENCE
+        /* the task owns the in-fence once queued, and holds its own reference of out-fence */
+        m_task->submit_handle.in_fence = in_fence;
+        m_task->submit_handle.out_fence = (out_fence != VIP_NULL) ? gckvip_os_get_fence(out_fence) : VIP_NULL;
+    #endif
         PRINTK_D("user put mem_handle=0x%"PRPx" into task slot index=%d, status=0x%x\n",
                   cmd_handle, i, m_task->status);
 
@@ -819,6 +878,13 @@ Expand:
         gckvip_os_unlock_mutex(m_task->cancel_mutex);
         if (!ret) {
             PRINTK_E("failed to write task into queue\n");
+        #if vpmdENABLE_DMA_FENCE
+            if (m_task->submit_handle.out_fence != VIP_NULL) {
+                gckvip_os_put_fence(m_task->submit_handle.out_fence);
+            }
+            m_task->submit_handle.in_fence = VIP_NULL;
+            m_task->submit_handle.out_fence = VIP_NULL;
+        #endif
             m_task->status = GCKVIP_TASK_EMPTY;
             gckvip_hashmap_remove(&device->mt_hashmap, m_task->submit_handle.cmd_handle);
             gckvip_hashmap_unuse(&device->mt_hashmap, i, vip_false_e);
@@ -890,6 +956,76 @@ onError:
     return status;
 }
 
+vip_status_e gckvip_cmd_do_submit(
+    gckvip_context_t *context,
+    gckvip_commit_t *commit
+    )
+{
+    return cmd_do_submit(context, commit, VIP_NULL, VIP_NULL);
+}
+
+#if vpmdENABLE_DMA_FENCE
+vip_status_e gckvip_cmd_drop_fence(
+    gckvip_task_slot_t *m_task,
+    vip_status_e status
+    )
+{
+    gckvip_submit_t *submit = &m_task->submit_handle;
+
+    if (submit->in_fence != VIP_NULL) {
+        gckvip_os_put_fence(submit->in_fence);
+        submit->in_fence = VIP_NULL;
+    }
+    if (submit->out_fence != VIP_NULL) {
+        gckvip_os_signal_fence(submit->out_fence, status);
+        gckvip_os_put_fence(submit->out_fence);
+        submit->out_fence = VIP_NULL;
+    }
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e gckvip_cmd_do_submit_fence(
+    gckvip_context_t *context,
+    gckvip_commit_fence_t *info
+    )
+{
+    vip_status_e status = VIP_SUCCESS;
+    gckvip_fence in_fence = VIP_NULL;
+    gckvip_fence out_fence = VIP_NULL;
+
+    info->out_fence_fd = GCKVIP_FENCE_FD_NONE;
+    if (info->in_fence_fd >= 0) {
+        gcOnError(gckvip_os_import_fence(info->in_fence_fd, &in_fence));
+    }
+    if (info->flags & GCKVIP_COMMIT_FLAG_OUT_FENCE) {
+        gcOnError(gckvip_os_create_fence(&out_fence));
+    }
+
+    gcOnError(cmd_do_submit(context, &info->commit, in_fence, out_fence));
+    in_fence = VIP_NULL;
+
+    if (out_fence != VIP_NULL) {
+        /* the task has been queued and retires by itself, only the fd is lost on failure */
+        status = gckvip_os_export_fence(out_fence, &info->out_fence_fd);
+        if (status != VIP_SUCCESS) {
+            PRINTK_E("fail to export out-fence of handle=0x%x, status=%d\n", info->commit.cmd_handle, status);
+        }
+        gckvip_os_put_fence(out_fence);
+    }
+
+    return status;
+onError:
+    if (in_fence != VIP_NULL) {
+        gckvip_os_put_fence(in_fence);
+    }
+    if (out_fence != VIP_NULL) {
+        gckvip_os_put_fence(out_fence);
+    }
+    return status;
+}
+#endif
+
 #if vpmdENABLE_CANCELATION
 vip_status_e gckvip_hardware_do_cancel(
     gckvip_task_slot_t *m_task,
@@ -1055,6 +1191,9 @@ vip_status_e gckvip_cmd_do_cancel(
                 if (VIP_SUCCESS == gckvip_queue_clean(&device->mt_input_queue, (void*)&m_task->queue_data->v1)) {
                     /* this task remove from queue */
                     wake_up_user = vip_true_e;
+                #if vpmdENABLE_DMA_FENCE
+                    gckvip_cmd_drop_fence(m_task, VIP_ERROR_CANCELED);
+                #endif
                 }
                 PRINTK_D("with data cancel task_slot index=%d, task_status=0x%x\n", i, m_task->status);
             }
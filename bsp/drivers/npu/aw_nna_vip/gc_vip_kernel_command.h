@@ -111,6 +111,25 @@ vip_status_e gckvip_cmd_do_wait(
     gckvip_wait_t *info
     );
 
+#if vpmdENABLE_DMA_FENCE
+/*
+@brief submit a command buffer gated by an in-fence, optionally return an out-fence.
+*/
+vip_status_e gckvip_cmd_do_submit_fence(
+    gckvip_context_t *context,
+    gckvip_commit_fence_t *info
+    );
+
+/*
+@brief release the fences of a task which is not going to be executed.
+       should be called with the cancel_mutex of task locked.
+*/
+vip_status_e gckvip_cmd_drop_fence(
+    gckvip_task_slot_t *m_task,
+    vip_status_e status
+    );
+#endif
+
 #if vpmdENABLE_CANCELATION
 vip_status_e gckvip_cmd_do_cancel(
     gckvip_context_t *context,
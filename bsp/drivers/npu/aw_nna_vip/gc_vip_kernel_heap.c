@@ -67,56 +67,52 @@
 #define STATUS_FREE     0x5A5A5A5A
 #define STATUS_INIT     0xCDCDCDCD
 
-static vip_status_e new_node(
-    gckvip_heap_t *heap,
-    gckvip_heap_node_t **node
+#define HEAP_BENCH_SLOTS        512
+
+#define IS_POOL_END(pool, node) (&(node)->list == &(pool)->list)
+
+static vip_uint32_t heap_fls(
+    vip_uint32_t value
     )
 {
-    vip_status_e status = VIP_SUCCESS;
-    vip_uint32_t i = 0;
+    return 31 - __builtin_clz(value);
+}
 
-    do {
-        if (heap->node_count >= heap->node_capacity) {
-            PRINTK_E("vide mem node count=%d, node capacity=%d\n",
-                      heap->node_count, heap->node_capacity);
-            status = VIP_ERROR_OUT_OF_RESOURCE;
-            break;
-        }
+static vip_uint32_t heap_ffs(
+    vip_uint32_t value
+    )
+{
+    return __builtin_ctz(value);
+}
 
-        for (i = 0; i < heap->node_capacity; i++) {
-            if (heap->nodes[i].status == STATUS_INIT) {
-                break;
-            }
-        }
-        if (i >= heap->node_capacity) {
-            PRINTK_E("new_node fail i=%d, node capacity=%d\n", i, heap->node_capacity);
-            status = VIP_ERROR_OUT_OF_RESOURCE;
-            break;
-        }
+static gckvip_heap_node_t *new_node(
+    gckvip_heap_t *heap
+    )
+{
+    gckvip_heap_node_t *node = heap->node_free;
 
-        *node = &heap->nodes[i];
-        heap->node_count++;
-    } while(0);
+    if (VIP_NULL == node) {
+        return VIP_NULL;
+    }
 
-    return status;
+    heap->node_free = node->free_next;
+    node->free_next = VIP_NULL;
+    node->free_prev = VIP_NULL;
+    heap->node_count++;
+
+    return node;
 }
 
-static vip_status_e del_node(
+static void del_node(
     gckvip_heap_t *heap,
     gckvip_heap_node_t *node
     )
 {
-    vip_status_e status = VIP_SUCCESS;
-
-    if (VIP_NULL == node) {
-        PRINTK_E("failed to delete node, node is NULL\n");
-        return VIP_ERROR_INVALID_ARGUMENTS;
-    }
-
     node->status = STATUS_INIT;
+    node->pool = VIP_NULL;
+    node->free_next = heap->node_free;
+    heap->node_free = node;
     heap->node_count--;
-
-    return status;
 }
 
 /* Add the list item in front of "head". */
@@ -154,107 +150,357 @@ static void delete_list(
     }
 }
 
-static vip_status_e split_node(
-    gckvip_heap_t *heap,
-    gckvip_heap_node_t *node,
+/* size class of a free block, size >= GCKVIP_HEAP_MIN_BLOCK */
+static void mapping_insert(
     vip_uint32_t size,
-    vip_uint32_t offset
+    vip_uint32_t *fl,
+    vip_uint32_t *sl
     )
 {
-    vip_status_e status = VIP_SUCCESS;
-    gckvip_heap_node_t *split = VIP_NULL;
+    vip_uint32_t f = heap_fls(size);
 
-    do {
-        /* Allocate a new node. */
-        status = new_node(heap, &split);
-        if (status != VIP_SUCCESS) {
-            PRINTK_E("fail to split node status=%d\n", status);
-            break;
-        }
+    *sl = (size >> (f - GCKVIP_HEAP_SL_SHIFT)) & (GCKVIP_HEAP_SL_COUNT - 1);
+    *fl = f - GCKVIP_HEAP_MIN_SHIFT;
+}
 
-        /* Fill in the data of this node of the remaning size. */
-        split->offset = node->offset + size + offset;
-        split->size = node->size - size - offset;
-        split->status = STATUS_FREE;
+/* round the request up to the next size class, so any block found fits */
+static void mapping_search(
+    vip_uint32_t size,
+    vip_uint32_t *fl,
+    vip_uint32_t *sl
+    )
+{
+    size += (1 << (heap_fls(size) - GCKVIP_HEAP_SL_SHIFT)) - 1;
+    mapping_insert(size, fl, sl);
+}
 
-        /* Add the new node before the current node. */
-        add_list_tail(&split->list, &node->list);
+static void insert_free(
+    gckvip_heap_pool_t *pool,
+    gckvip_heap_node_t *node
+    )
+{
+    vip_uint32_t fl = 0, sl = 0;
+    gckvip_heap_node_t *head = VIP_NULL;
 
-        /* Adjust the size of the current node. */
-        node->size = size + offset;
-    } while(0);
+    mapping_insert(node->size, &fl, &sl);
+    head = pool->free_list[fl][sl];
 
-    return status;
+    node->status = STATUS_FREE;
+    node->free_prev = VIP_NULL;
+    node->free_next = head;
+    if (head != VIP_NULL) {
+        head->free_prev = node;
+    }
+    pool->free_list[fl][sl] = node;
+    pool->fl_bitmap |= 1 << fl;
+    pool->sl_bitmap[fl] |= 1 << sl;
+}
+
+static void remove_free(
+    gckvip_heap_pool_t *pool,
+    gckvip_heap_node_t *node
+    )
+{
+    vip_uint32_t fl = 0, sl = 0;
+
+    mapping_insert(node->size, &fl, &sl);
+
+    if (node->free_next != VIP_NULL) {
+        node->free_next->free_prev = node->free_prev;
+    }
+    if (node->free_prev != VIP_NULL) {
+        node->free_prev->free_next = node->free_next;
+    }
+    else {
+        pool->free_list[fl][sl] = node->free_next;
+        if (VIP_NULL == node->free_next) {
+            pool->sl_bitmap[fl] &= ~(1 << sl);
+            if (0 == pool->sl_bitmap[fl]) {
+                pool->fl_bitmap &= ~(1 << fl);
+            }
+        }
+    }
+    node->free_next = VIP_NULL;
+    node->free_prev = VIP_NULL;
 }
 
-static vip_bool_e gckvip_heap_query(
+static gckvip_heap_node_t *find_suitable(
+    gckvip_heap_pool_t *pool,
+    vip_uint32_t fl,
+    vip_uint32_t sl
+    )
+{
+    vip_uint32_t sl_map = pool->sl_bitmap[fl] & (~0U << sl);
+
+    if (0 == sl_map) {
+        vip_uint32_t fl_map = 0;
+        if ((fl + 1) < GCKVIP_HEAP_FL_COUNT) {
+            fl_map = pool->fl_bitmap & (~0U << (fl + 1));
+        }
+        if (0 == fl_map) {
+            return VIP_NULL;
+        }
+        fl = heap_ffs(fl_map);
+        sl_map = pool->sl_bitmap[fl];
+    }
+    sl = heap_ffs(sl_map);
+
+    return pool->free_list[fl][sl];
+}
+
+static vip_status_e pool_init(
     gckvip_heap_t *heap,
+    gckvip_heap_pool_t *pool,
+    vip_uint32_t offset,
     vip_uint32_t size
     )
 {
-    vip_uint32_t max_size = 0;
-    gckvip_heap_node_t *pos = VIP_NULL;
-    vip_bool_e support = vip_false_e;
-    if (0 == heap->total_size) {
-        return vip_false_e;
+    gckvip_heap_node_t *node = VIP_NULL;
+
+    gckvip_os_zero_memory(pool, sizeof(gckvip_heap_pool_t));
+    GCKVIP_INIT_LIST_HEAD(&pool->list);
+
+    node = new_node(heap);
+    if (VIP_NULL == node) {
+        PRINTK_E("vide mem node count=%d, node capacity=%d\n",
+                  heap->node_count, heap->node_capacity);
+        return VIP_ERROR_OUT_OF_RESOURCE;
+    }
+    node->offset = offset;
+    node->size = size;
+    node->pool = pool;
+    add_list_tail(&node->list, &pool->list);
+    insert_free(pool, node);
+
+    pool->offset = offset;
+    pool->size = size;
+    pool->free_bytes = size;
+
+    return VIP_SUCCESS;
+}
+
+/*
+@brief take a block from the pool.
+@param offset, return the aligned offset of the block in the heap.
+*/
+static gckvip_heap_node_t *pool_alloc(
+    gckvip_heap_t *heap,
+    gckvip_heap_pool_t *pool,
+    vip_uint32_t size,
+    vip_uint32_t align,
+    vip_uint32_t *offset
+    )
+{
+    gckvip_heap_node_t *node = VIP_NULL;
+    gckvip_heap_node_t *split = VIP_NULL;
+    vip_uint32_t search = 0, pad = 0, addr = 0;
+    vip_uint32_t fl = 0, sl = 0;
+
+    if (align < GCKVIP_HEAP_MIN_BLOCK) {
+        align = GCKVIP_HEAP_MIN_BLOCK;
+    }
+    size = GCVIP_ALIGN(size, GCKVIP_HEAP_MIN_BLOCK);
+    /* worst case padding, block offsets are multiple of GCKVIP_HEAP_MIN_BLOCK */
+    search = size + align - GCKVIP_HEAP_MIN_BLOCK;
+    if ((0 == size) || (search < size) || (search > pool->free_bytes)) {
+        return VIP_NULL;
     }
 
-    if (size > heap->free_bytes) {
-        return vip_false_e;
+    mapping_search(search, &fl, &sl);
+    if (fl >= GCKVIP_HEAP_FL_COUNT) {
+        return VIP_NULL;
+    }
+    node = find_suitable(pool, fl, sl);
+    if (VIP_NULL == node) {
+        return VIP_NULL;
+    }
+    remove_free(pool, node);
+
+    /* only the low bits matter, align is a power of 2 below 4G */
+    addr = (vip_uint32_t)(heap->physical + node->offset);
+    pad = GCVIP_ALIGN(addr, align) - addr;
+    if (pad > 0) {
+        /* give the alignment gap back as a free block, its left neighbour is used */
+        split = new_node(heap);
+        if (split != VIP_NULL) {
+            split->offset = node->offset;
+            split->size = pad;
+            split->pool = pool;
+            add_list(&split->list, node->list.prev, &node->list);
+            insert_free(pool, split);
+            node->offset += pad;
+            node->size -= pad;
+            pad = 0;
+        }
     }
 
-    if (0 == heap->node_count) {
-        return vip_false_e;
+    if ((node->size - pad - size) >= GCKVIP_HEAP_MIN_BLOCK) {
+        split = new_node(heap);
+        if (split != VIP_NULL) {
+            split->offset = node->offset + pad + size;
+            split->size = node->size - pad - size;
+            split->pool = pool;
+            add_list(&split->list, &node->list, node->list.next);
+            insert_free(pool, split);
+            node->size = pad + size;
+        }
     }
 
-    pos = (gckvip_heap_node_t *)heap->list.next;
-    if (VIP_NULL == pos) {
-        PRINTK_E("fail video memory heap list next is NULL");
-        return vip_false_e;
+    node->status = STATUS_USED;
+    pool->free_bytes -= node->size;
+    pool->used_count++;
+    *offset = node->offset + pad;
+
+    return node;
+}
+
+/* give a block back to its pool and merge it with free neighbours */
+static void pool_free(
+    gckvip_heap_t *heap,
+    gckvip_heap_node_t *node
+    )
+{
+    gckvip_heap_pool_t *pool = node->pool;
+    gckvip_heap_node_t *prev = (gckvip_heap_node_t *)node->list.prev;
+    gckvip_heap_node_t *next = (gckvip_heap_node_t *)node->list.next;
+
+    pool->free_bytes += node->size;
+    pool->used_count--;
+
+    if (!IS_POOL_END(pool, prev) && (STATUS_FREE == prev->status)) {
+        remove_free(pool, prev);
+        prev->size += node->size;
+        delete_list(&node->list);
+        del_node(heap, node);
+        node = prev;
     }
 
-    for (; &pos->list != &heap->list; pos = (gckvip_heap_node_t*)pos->list.next) {
-        if ((pos != VIP_NULL) && (pos->status == STATUS_FREE)) {
-            if (pos->size > max_size) {
-                max_size = pos->size;
-            }
+    if (!IS_POOL_END(pool, next) && (STATUS_FREE == next->status)) {
+        remove_free(pool, next);
+        node->size += next->size;
+        delete_list(&next->list);
+        del_node(heap, next);
+    }
+
+    insert_free(pool, node);
+}
+
+static gckvip_heap_arena_t *find_arena(
+    gckvip_heap_t *heap,
+    vip_uint32_t id,
+    vip_bool_e create
+    )
+{
+    gckvip_heap_arena_t *arena = heap->arenas;
+
+    for (; arena != VIP_NULL; arena = arena->next) {
+        if ((arena->id == id) && (vip_false_e == arena->released)) {
+            return arena;
         }
     }
 
-    if (max_size > heap->free_bytes) {
-        max_size = heap->free_bytes;
+    if (create) {
+        if (VIP_SUCCESS != gckvip_os_allocate_memory(sizeof(gckvip_heap_arena_t), (void**)&arena)) {
+            PRINTK_E("fail to allocate heap arena\n");
+            return VIP_NULL;
+        }
+        gckvip_os_zero_memory(arena, sizeof(gckvip_heap_arena_t));
+        arena->id = id;
+        arena->next = heap->arenas;
+        heap->arenas = arena;
     }
 
-    if (size > max_size) {
-        return vip_false_e;
+    return arena;
+}
+
+/* drop every node of the chunk and give its backing block to the shared pool */
+static void chunk_destroy(
+    gckvip_heap_t *heap,
+    gckvip_heap_pool_t *chunk
+    )
+{
+    gckvip_heap_node_t *pos = (gckvip_heap_node_t *)chunk->list.next;
+    gckvip_heap_node_t *n = VIP_NULL;
+
+    for (; !IS_POOL_END(chunk, pos); pos = n) {
+        n = (gckvip_heap_node_t *)pos->list.next;
+        del_node(heap, pos);
     }
 
-    if ((heap->node_count + 1) >= heap->node_capacity) {
-        /* The node cap needs to be extended */
-        #if !vpmdNODE_MEMORY_IN_HEAP
-        void *tmp_buffer = VIP_NULL;
-        vip_status_e status = VIP_SUCCESS;
-        vip_uint32_t buf_size = 0, new_node_cap = 0;
-        new_node_cap = heap->node_capacity + 64;
-        buf_size = sizeof(gckvip_heap_node_t) * new_node_cap;
-        status = gckvip_os_allocate_memory(buf_size, (void**)&tmp_buffer);
-        if (status != VIP_SUCCESS) {
-            PRINTK_E("fail to alloc memory for extend heap node cap\n");
-            return vip_false_e;
+    pool_free(heap, chunk->backing);
+    chunk->arena->chunk_count--;
+    gckvip_os_free_memory(chunk);
+}
+
+/* unlink the chunk from its arena, free it and drop the arena once a released one is empty */
+static void chunk_release(
+    gckvip_heap_t *heap,
+    gckvip_heap_pool_t *chunk
+    )
+{
+    gckvip_heap_arena_t *arena = chunk->arena;
+    gckvip_heap_arena_t **apos = VIP_NULL;
+    gckvip_heap_pool_t **pos = VIP_NULL;
+
+    for (pos = &arena->chunks; *pos != VIP_NULL; pos = &(*pos)->next) {
+        if (*pos == chunk) {
+            *pos = chunk->next;
+            break;
+        }
+    }
+    chunk_destroy(heap, chunk);
+
+    if (arena->released && (0 == arena->chunk_count)) {
+        for (apos = &heap->arenas; *apos != VIP_NULL; apos = &(*apos)->next) {
+            if (*apos == arena) {
+                *apos = arena->next;
+                break;
+            }
+        }
+        gckvip_os_free_memory(arena);
+    }
+}
+
+static gckvip_heap_node_t *arena_alloc(
+    gckvip_heap_t *heap,
+    gckvip_heap_arena_t *arena,
+    vip_uint32_t size,
+    vip_uint32_t align,
+    vip_uint32_t *offset
+    )
+{
+    gckvip_heap_pool_t *chunk = arena->chunks;
+    gckvip_heap_node_t *node = VIP_NULL;
+    gckvip_heap_node_t *backing = VIP_NULL;
+    vip_uint32_t chunk_offset = 0;
+
+    for (; chunk != VIP_NULL; chunk = chunk->next) {
+        node = pool_alloc(heap, chunk, size, align, offset);
+        if (node != VIP_NULL) {
+            return node;
         }
-        gckvip_os_zero_memory(tmp_buffer, buf_size);
-        gckvip_os_memcopy(tmp_buffer, heap->nodes, buf_size);
-        gckvip_os_free_memory(heap->nodes);
-        heap->nodes = tmp_buffer;
-        heap->node_capacity = new_node_cap;
-        #else
-        return vip_false_e;
-        #endif
     }
 
-    support = vip_true_e;
+    backing = pool_alloc(heap, &heap->pool, GCKVIP_HEAP_ARENA_CHUNK_SIZE, 4096, &chunk_offset);
+    if (VIP_NULL == backing) {
+        return VIP_NULL;
+    }
+    if (VIP_SUCCESS != gckvip_os_allocate_memory(sizeof(gckvip_heap_pool_t), (void**)&chunk)) {
+        pool_free(heap, backing);
+        return VIP_NULL;
+    }
+    if (VIP_SUCCESS != pool_init(heap, chunk, chunk_offset, GCKVIP_HEAP_ARENA_CHUNK_SIZE)) {
+        gckvip_os_free_memory(chunk);
+        pool_free(heap, backing);
+        return VIP_NULL;
+    }
+    chunk->arena = arena;
+    chunk->backing = backing;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->chunk_count++;
 
-    return support;
+    return pool_alloc(heap, chunk, size, align, offset);
 }
 
 void *gckvip_heap_alloc(
@@ -262,30 +508,30 @@ void *gckvip_heap_alloc(
     vip_uint32_t size,
     void **logical,
     phy_address_t *physical,
-    vip_uint32_t align
+    vip_uint32_t align,
+    vip_uint32_t arena_id
     )
 {
-    vip_uint32_t aligned_size = 0;
-    gckvip_heap_node_t *pos = VIP_NULL;
+    gckvip_heap_node_t *node = VIP_NULL;
+    gckvip_heap_arena_t *arena = VIP_NULL;
     vip_uint32_t offset = 0;
-    vip_uint8_t alloc_flag = 0;
+    vip_uint32_t shared_align = align;
     vip_status_e status = VIP_SUCCESS;
-    vip_bool_e support = vip_false_e;
     (void)status;/* keep compiler happy */
 
     if ((VIP_NULL == logical) || (VIP_NULL == physical)) {
         PRINTK_E("heap alloc, logical parameter is NULL\n");
         return VIP_NULL;
     }
-    if (0 == heap->total_size) {
+    if ((0 == heap->total_size) || (0 == size)) {
         return VIP_NULL;
     }
 
 #if vpmdENABLE_MULTIPLE_TASK || vpmdENABLE_VIDEO_MEMORY_CACHE
 #if defined(__linux__)
-    /* return 4Kbytes alignment on Linux, not request by VIP */
-    if (align < 4096) {
-        align = 4096;
+    /* return 4Kbytes alignment on Linux for blocks shared between processes, not request by VIP */
+    if (shared_align < 4096) {
+        shared_align = 4096;
     }
 #endif
 #endif
@@ -298,43 +544,27 @@ void *gckvip_heap_alloc(
     }
 #endif
 
-    /* Align the size to align bytes. */
-    aligned_size = GCVIP_ALIGN(size, align);
-
-    support = gckvip_heap_query(heap, aligned_size);
-    if (!support) {
-        gcGoOnError(VIP_ERROR_OUT_OF_MEMORY);
+    /* small blocks of one process are packed with cache line alignment */
+    if ((arena_id != 0) && (size <= GCKVIP_HEAP_ARENA_MAX_ALLOC) && (align <= 4096)) {
+        arena = find_arena(heap, arena_id, vip_true_e);
+        if (arena != VIP_NULL) {
+            node = arena_alloc(heap, arena, size,
+                               align < gcdVIP_MEMORY_ALIGN_SIZE ? gcdVIP_MEMORY_ALIGN_SIZE : align,
+                               &offset);
+        }
     }
 
-    /* Walk the heap backwards. */
-    pos = (gckvip_heap_node_t *)heap->list.next;
-    for (; &pos->list != &heap->list; pos = (gckvip_heap_node_t*)pos->list.next) {
-        /* Check if the current node is free_bytes and is big enough. */
-        offset = GCVIP_ALIGN(heap->physical + pos->offset, align) - (heap->physical + pos->offset);
-        if ((pos->status == STATUS_FREE) && (pos->size >= (aligned_size + offset))) {
-            /* See if we the current node is big enough to split. */
-            if ((pos->size - aligned_size) > align) {
-                split_node(heap, pos, aligned_size, offset);
-            }
-
-            /* Mark the current node as used. */
-            pos->status = STATUS_USED;
-
-            /*  Return the logical/physical address. */
-            *logical = (vip_uint8_t *)heap->memory + pos->offset + offset;
-            *physical = heap->physical + pos->offset + offset;
-
-            /* Update free size. */
-            heap->free_bytes -= pos->size;
-
-            alloc_flag = 1;
-            break;
-        }
+    if (VIP_NULL == node) {
+        node = pool_alloc(heap, &heap->pool, size, shared_align, &offset);
     }
 
-    if (0 == alloc_flag) {
-        pos = VIP_NULL;
-        status = VIP_ERROR_FAILURE;
+    if (node != VIP_NULL) {
+        /*  Return the logical/physical address. */
+        *logical = (vip_uint8_t *)heap->memory + offset;
+        *physical = heap->physical + offset;
+    }
+    else {
+        heap->alloc_fail++;
     }
 
 #if vpmdENABLE_MULTIPLE_TASK
@@ -344,14 +574,7 @@ void *gckvip_heap_alloc(
     }
 #endif
 
-    return (void*)pos;
-onError:
-#if vpmdENABLE_MULTIPLE_TASK
-    if (VIP_SUCCESS != gckvip_os_unlock_mutex(heap->mutex)) {
-        PRINTK_E("failed to unlock video memory heap mutex\n");
-    }
-#endif
-    return VIP_NULL;
+    return (void*)node;
 }
 
 vip_status_e gckvip_heap_free(
@@ -360,8 +583,8 @@ vip_status_e gckvip_heap_free(
     )
 {
     vip_status_e status = VIP_SUCCESS;
-    gckvip_heap_node_t *pos = VIP_NULL;
     gckvip_heap_node_t *node = VIP_NULL;
+    gckvip_heap_pool_t *chunk = VIP_NULL;
 
     if (handle == VIP_NULL) {
         PRINTK_E("failed to free heap memory\n");
@@ -394,27 +617,13 @@ vip_status_e gckvip_heap_free(
         return VIP_SUCCESS;
     }
 
-    /* Mark node as free_bytes. */
-    node->status = STATUS_FREE;
+    chunk = node->pool;
+    pool_free(heap, node);
 
-    /* Add node size to free_bytes count. */
-    heap->free_bytes += node->size;
-
-    pos = (gckvip_heap_node_t *)heap->list.next;
-    for (; &pos->list != &heap->list; pos = (gckvip_heap_node_t*)pos->list.next) {
-        if ((pos != VIP_NULL) && (pos->status == STATUS_FREE)) {
-            if (pos->offset == (node->offset + node->size)) {
-                node->size += pos->size;
-                delete_list(&pos->list);
-                del_node(heap, pos);
-            }
-            else if ((pos->offset + pos->size) == node->offset) {
-                pos->size += node->size;
-                delete_list(&node->list);
-                del_node(heap, node);
-                node = pos;
-            }
-        }
+    /* keep the last chunk of a live arena for the next network of the process */
+    if ((chunk->arena != VIP_NULL) && (0 == chunk->used_count) &&
+        ((chunk->arena->chunk_count > 1) || chunk->arena->released)) {
+        chunk_release(heap, chunk);
     }
 
 #if vpmdENABLE_MULTIPLE_TASK
@@ -427,26 +636,60 @@ vip_status_e gckvip_heap_free(
     return status;
 }
 
-vip_status_e gckvip_heap_construct(
+vip_status_e gckvip_heap_arena_release(
     gckvip_heap_t *heap,
-    vip_uint32_t size,
-    void *logical,
-    phy_address_t physical
+    vip_uint32_t arena_id
     )
 {
     vip_status_e status = VIP_SUCCESS;
-    gckvip_heap_node_t *node = VIP_NULL;
-    vip_uint32_t nodes_size = 0;
-    vip_uint32_t node_cap = 0;
-    vip_uint32_t i = 0;
+    gckvip_heap_arena_t *arena = VIP_NULL;
+    gckvip_heap_pool_t *chunk = VIP_NULL;
+    gckvip_heap_pool_t *next = VIP_NULL;
 
-    if (0 == size) {
-        heap->total_size = 0;
-        heap->node_count = 0;
-        heap->free_bytes = 0;
+    if (0 == heap->total_size) {
         return VIP_SUCCESS;
     }
 
+#if vpmdENABLE_MULTIPLE_TASK
+    status = gckvip_os_lock_mutex(heap->mutex);
+    if (status != VIP_SUCCESS) {
+        PRINTK_E("failed to lock video memory heap mutex\n");
+        return VIP_ERROR_FAILURE;
+    }
+#endif
+
+    arena = find_arena(heap, arena_id, vip_false_e);
+    if (arena != VIP_NULL) {
+        /* blocks still referenced keep their chunk until they are freed */
+        arena->released = vip_true_e;
+        chunk = arena->chunks;
+        while (chunk != VIP_NULL) {
+            next = chunk->next;
+            if (0 == chunk->used_count) {
+                chunk_release(heap, chunk);
+            }
+            else {
+                PRINTK_I("arena 0x%x still has %d blocks in use\n", arena_id, chunk->used_count);
+            }
+            chunk = next;
+        }
+    }
+
+#if vpmdENABLE_MULTIPLE_TASK
+    if (VIP_SUCCESS != gckvip_os_unlock_mutex(heap->mutex)) {
+        PRINTK_E("failed to unlock video memory heap mutex\n");
+    }
+#endif
+
+    return status;
+}
+
+static vip_uint32_t heap_node_capacity(
+    vip_uint32_t size
+    )
+{
+    vip_uint32_t node_cap = 0;
+
     if (size > 0x6400000) {/* 100M bytes*/
         node_cap = size / 1024 / 100; /* 100k bytes pre-node */
     }
@@ -460,48 +703,86 @@ vip_status_e gckvip_heap_construct(
         node_cap = size / 1024;
     }
 
-    do {
-        GCKVIP_INIT_LIST_HEAD(&heap->list);
+    return node_cap;
+}
+
+/* lay out the node stack and the shared pool over [0, size) */
+static vip_status_e heap_setup(
+    gckvip_heap_t *heap,
+    vip_uint32_t size,
+    void *logical,
+    phy_address_t physical,
+    gckvip_heap_node_t *nodes,
+    vip_uint32_t node_cap
+    )
+{
+    vip_uint32_t i = 0;
+
+    heap->nodes = nodes;
+    heap->node_capacity = node_cap;
+    heap->node_count = 0;
+    heap->node_free = VIP_NULL;
+    for (i = node_cap; i > 0; i--) {
+        heap->nodes[i - 1].status = STATUS_INIT;
+        heap->nodes[i - 1].free_next = heap->node_free;
+        heap->node_free = &heap->nodes[i - 1];
+    }
+
+    heap->memory = logical;
+    heap->physical = physical;
+    heap->arenas = VIP_NULL;
+    heap->alloc_fail = 0;
 
+    return pool_init(heap, &heap->pool, 0, GCVIP_ALIGN_BASE(size, GCKVIP_HEAP_MIN_BLOCK));
+}
+
+vip_status_e gckvip_heap_construct(
+    gckvip_heap_t *heap,
+    vip_uint32_t size,
+    void *logical,
+    phy_address_t physical
+    )
+{
+    vip_status_e status = VIP_SUCCESS;
+    gckvip_heap_node_t *nodes = VIP_NULL;
+    vip_uint32_t nodes_size = 0;
+    vip_uint32_t node_cap = 0;
+
+    if (0 == size) {
+        heap->total_size = 0;
+        heap->node_count = 0;
+        heap->pool.free_bytes = 0;
+        return VIP_SUCCESS;
+    }
+
+    node_cap = heap_node_capacity(size);
+
+    do {
         nodes_size = sizeof(gckvip_heap_node_t) * node_cap;
         nodes_size = GCVIP_ALIGN(nodes_size, 32);
         if (nodes_size < 256) {
             nodes_size = 256;/* reserved 256bytes gap */
         }
     #if vpmdNODE_MEMORY_IN_HEAP
-        heap->nodes = (gckvip_heap_node_t *)((vip_uint8_t *)logical + (size - nodes_size));
+        nodes = (gckvip_heap_node_t *)((vip_uint8_t *)logical + (size - nodes_size));
     #else
-        status = gckvip_os_allocate_memory(nodes_size, (void**)&heap->nodes);
+        status = gckvip_os_allocate_memory(nodes_size, (void**)&nodes);
         if (status != VIP_SUCCESS) {
             PRINTK_E("fail to alloc memory for heap nodes\n");
             break;
         }
         nodes_size = 0;
     #endif
-        heap->node_capacity = node_cap;
-        heap->memory = logical;
-        heap->free_bytes = size - nodes_size;
-        heap->physical = physical;
         heap->total_size = size;
-        heap->node_count = 0;
-
-        PRINTK_I("video memory heap total free: 0x%x bytes, node used: 0x%x bytes, node capacity: %d\n",
-                heap->free_bytes, nodes_size, node_cap);
 
-        for (i = 0; i < node_cap; i++) {
-            heap->nodes[i].status = STATUS_INIT;
-        }
-
-        status = new_node(heap, &node);
+        status = heap_setup(heap, size - nodes_size, logical, physical, nodes, node_cap);
         if (status != VIP_SUCCESS) {
             PRINTK_E("failed to new node.\n");
             break;
         }
 
-        node->offset = 0;
-        node->size = heap->free_bytes;
-        node->status = STATUS_FREE;
-        add_list_tail(&node->list, &heap->list);
+        PRINTK_I("video memory heap total free: 0x%x bytes, node used: 0x%x bytes, node capacity: %d\n",
+                heap->pool.free_bytes, nodes_size, node_cap);
     } while (0);
 
 #if vpmdENABLE_MULTIPLE_TASK
@@ -521,9 +802,8 @@ vip_status_e gckvip_heap_destroy(
     gckvip_heap_t *heap
     )
 {
-    gckvip_heap_node_t *pos = VIP_NULL;
-    gckvip_heap_node_t *n = VIP_NULL;
-    gckvip_list_head_t *hlist = VIP_NULL;
+    gckvip_heap_arena_t *arena = VIP_NULL;
+    gckvip_heap_pool_t *chunk = VIP_NULL;
 
     if (heap == VIP_NULL) {
         PRINTK_E("failed to destroy heap\n");
@@ -540,37 +820,204 @@ vip_status_e gckvip_heap_destroy(
     }
 #endif
 
-    if ((heap != VIP_NULL) && (heap->node_count != 0)) {
-        pos = (gckvip_heap_node_t *)heap->list.next;
-        n = (gckvip_heap_node_t *)pos->list.next;
-        hlist = &heap->list;
-        /* Process each node. */
-        for (; &pos->list != hlist; n = (gckvip_heap_node_t *)pos->list.next) {
-            /* Remove it from the linked list. */
-            delete_list(&pos->list);
-            /* Free up the memory. */
-            del_node(heap, pos);
-            pos = n;
-            if (heap->node_count == 0) {
-                break;
+    /* the nodes live in the node array, only the arena bookkeeping is allocated */
+    while (heap->arenas != VIP_NULL) {
+        arena = heap->arenas;
+        heap->arenas = arena->next;
+        while (arena->chunks != VIP_NULL) {
+            chunk = arena->chunks;
+            arena->chunks = chunk->next;
+            gckvip_os_free_memory(chunk);
+        }
+        gckvip_os_free_memory(arena);
+    }
+
+    /* zero heap */
+    GCKVIP_INIT_LIST_HEAD(&heap->pool.list);
+    heap->pool.free_bytes = 0;
+    heap->node_capacity = 0;
+    heap->physical = 0;
+#if !vpmdNODE_MEMORY_IN_HEAP
+    if (heap->nodes != VIP_NULL) {
+        gckvip_os_free_memory(heap->nodes);
+    }
+#endif
+    heap->nodes = VIP_NULL;
+    heap->node_free = VIP_NULL;
+    heap->node_count = 0;
+
+    return VIP_SUCCESS;
+}
+
+static void pool_stats(
+    gckvip_heap_pool_t *pool,
+    gckvip_heap_stats_t *stats
+    )
+{
+    gckvip_heap_node_t *pos = (gckvip_heap_node_t *)pool->list.next;
+    vip_uint32_t fl = 0;
+
+    for (; !IS_POOL_END(pool, pos); pos = (gckvip_heap_node_t *)pos->list.next) {
+        if (STATUS_FREE == pos->status) {
+            stats->free_blocks++;
+            if (pos->size > stats->largest_free) {
+                stats->largest_free = pos->size;
             }
+            fl = heap_fls(pos->size) - GCKVIP_HEAP_MIN_SHIFT;
+            stats->free_hist[fl]++;
+        }
+        else if (STATUS_USED == pos->status) {
+            stats->used_blocks++;
+        }
+    }
+}
+
+vip_status_e gckvip_heap_get_stats(
+    gckvip_heap_t *heap,
+    gckvip_heap_stats_t *stats
+    )
+{
+    vip_status_e status = VIP_SUCCESS;
+    gckvip_heap_arena_t *arena = VIP_NULL;
+    gckvip_heap_pool_t *chunk = VIP_NULL;
+
+    gckvip_os_zero_memory(stats, sizeof(gckvip_heap_stats_t));
+    if (0 == heap->total_size) {
+        return VIP_SUCCESS;
+    }
+
+#if vpmdENABLE_MULTIPLE_TASK
+    status = gckvip_os_lock_mutex(heap->mutex);
+    if (status != VIP_SUCCESS) {
+        PRINTK_E("failed to lock video memory heap mutex\n");
+        return VIP_ERROR_FAILURE;
+    }
+#endif
+
+    stats->total_size = heap->pool.size;
+    stats->free_bytes = heap->pool.free_bytes;
+    stats->node_count = heap->node_count;
+    stats->node_capacity = heap->node_capacity;
+    stats->alloc_fail = heap->alloc_fail;
+    pool_stats(&heap->pool, stats);
+    /* a chunk counts as one used block of the shared pool */
+    for (arena = heap->arenas; arena != VIP_NULL; arena = arena->next) {
+        stats->arena_count++;
+        for (chunk = arena->chunks; chunk != VIP_NULL; chunk = chunk->next) {
+            stats->arena_chunks++;
+            stats->arena_free_bytes += chunk->free_bytes;
+            stats->used_blocks += chunk->used_count;
+        }
+    }
+
+#if vpmdENABLE_MULTIPLE_TASK
+    if (VIP_SUCCESS != gckvip_os_unlock_mutex(heap->mutex)) {
+        PRINTK_E("failed to unlock video memory heap mutex\n");
+    }
+#endif
+
+    return status;
+}
+
+/* tensor like size mix: mostly small blocks, some medium, a few large */
+static vip_uint32_t bench_size(
+    vip_uint32_t *seed
+    )
+{
+    vip_uint32_t r = 0;
+
+    *seed = *seed * 1103515245 + 12345;
+    r = *seed >> 8;
+    if ((r & 0xf) < 12) {
+        return 64 + (r >> 4) % 4096;
+    }
+    else if ((r & 0xf) < 15) {
+        return 4096 + (r >> 4) % 0xF000;
+    }
+
+    return 0x10000 + (r >> 4) % 0xF0000;
+}
+
+vip_status_e gckvip_heap_benchmark(
+    vip_uint32_t heap_size,
+    vip_uint32_t loops,
+    vip_uint64_t *time_us,
+    gckvip_heap_stats_t *stats
+    )
+{
+    vip_status_e status = VIP_SUCCESS;
+    gckvip_heap_t *heap = VIP_NULL;
+    gckvip_heap_node_t *nodes = VIP_NULL;
+    void **slots = VIP_NULL;
+    vip_uint32_t node_cap = heap_node_capacity(heap_size);
+    vip_uint32_t seed = 0x1234567;
+    vip_uint64_t start = 0;
+    vip_uint32_t i = 0, slot = 0, size = 0;
+    phy_address_t physical = 0;
+    void *logical = VIP_NULL;
+
+    /* arena chunks and alignment gaps need more nodes than one per block */
+    node_cap = node_cap * 2 + HEAP_BENCH_SLOTS * 2;
+
+    gcOnError(gckvip_os_allocate_memory(sizeof(gckvip_heap_t), (void**)&heap));
+    gckvip_os_zero_memory(heap, sizeof(gckvip_heap_t));
+    gcOnError(gckvip_os_allocate_memory(sizeof(gckvip_heap_node_t) * node_cap, (void**)&nodes));
+    gcOnError(gckvip_os_allocate_memory(sizeof(void *) * HEAP_BENCH_SLOTS, (void**)&slots));
+    gckvip_os_zero_memory(slots, sizeof(void *) * HEAP_BENCH_SLOTS);
+
+    /* the scratch heap is never touched, only its offsets are handed out */
+    heap->total_size = heap_size;
+    gcOnError(heap_setup(heap, heap_size, VIP_NULL, 0x40000000, nodes, node_cap));
+#if vpmdENABLE_MULTIPLE_TASK
+    gcOnError(gckvip_os_create_mutex(&heap->mutex));
+#endif
+
+    start = gckvip_os_get_time();
+    for (i = 0; i < loops; i++) {
+        size = bench_size(&seed);
+        slot = (seed >> 4) % HEAP_BENCH_SLOTS;
+        if (slots[slot] != VIP_NULL) {
+            gckvip_heap_free(heap, slots[slot]);
+            slots[slot] = VIP_NULL;
         }
+        else {
+            slots[slot] = gckvip_heap_alloc(heap, size, &logical, &physical,
+                                            (seed & 0x100) ? 4096 : 64, (seed & 0x200) ? 1 : 0);
+        }
+    }
+    *time_us = gckvip_os_get_time() - start;
+
+    gckvip_heap_get_stats(heap, stats);
 
-        /* zero heap */
-        heap->free_bytes = 0;
-        hlist = VIP_NULL;
-        heap->node_capacity = 0;
-        heap->physical = 0;
-    #if !vpmdNODE_MEMORY_IN_HEAP
-        if (heap->nodes != VIP_NULL) {
-            gckvip_os_free_memory(heap->nodes);
+    for (slot = 0; slot < HEAP_BENCH_SLOTS; slot++) {
+        if (slots[slot] != VIP_NULL) {
+            gckvip_heap_free(heap, slots[slot]);
+        }
+    }
+    gckvip_heap_arena_release(heap, 1);
+    if ((heap->pool.free_bytes != heap->pool.size) || (heap->node_count != 1)) {
+        PRINTK_E("heap benchmark leak: free=0x%x, size=0x%x, nodes=%d\n",
+                 heap->pool.free_bytes, heap->pool.size, heap->node_count);
+        status = VIP_ERROR_FAILURE;
+    }
+
+onError:
+    if (heap != VIP_NULL) {
+    #if vpmdENABLE_MULTIPLE_TASK
+        if (heap->mutex != VIP_NULL) {
+            gckvip_os_destroy_mutex(heap->mutex);
         }
     #endif
-        heap->nodes = VIP_NULL;
-        heap->node_count = 0;
+        gckvip_os_free_memory(heap);
+    }
+    if (nodes != VIP_NULL) {
+        gckvip_os_free_memory(nodes);
+    }
+    if (slots != VIP_NULL) {
+        gckvip_os_free_memory(slots);
     }
 
-    return VIP_SUCCESS;
+    return status;
 }
 
 /*
@@ -69,17 +69,79 @@ typedef struct _gckvip_list_head {
         (entry)->next = (entry);\
         (entry)->prev = (entry);
 
+/*
+  Two-level segregated fit: a free block of size s lives in list [fl][sl],
+  fl = log2(s), sl = the next GCKVIP_HEAP_SL_SHIFT bits of s. Allocation and
+  free are a couple of bit scans plus O(1) list operations.
+*/
+#define GCKVIP_HEAP_MIN_SHIFT       6   /* 64 bytes, cache line granule */
+#define GCKVIP_HEAP_MIN_BLOCK       (1 << GCKVIP_HEAP_MIN_SHIFT)
+#define GCKVIP_HEAP_SL_SHIFT        3
+#define GCKVIP_HEAP_SL_COUNT        (1 << GCKVIP_HEAP_SL_SHIFT)
+#define GCKVIP_HEAP_FL_COUNT        (32 - GCKVIP_HEAP_MIN_SHIFT)
+
+/* per-process arena: small blocks are packed in chunks owned by one process */
+#define GCKVIP_HEAP_ARENA_CHUNK_SIZE    0x40000 /* 256K bytes */
+#define GCKVIP_HEAP_ARENA_MAX_ALLOC     0x10000 /* 64K bytes */
+
+struct _gckvip_heap_pool;
+
 typedef struct _gckvip_heap_node {
+    /* all blocks of the pool in address order */
     gckvip_list_head_t list;
+    /* size class list when free, unused node stack when STATUS_INIT */
+    struct _gckvip_heap_node *free_next;
+    struct _gckvip_heap_node *free_prev;
+    struct _gckvip_heap_pool *pool;
     vip_uint32_t    offset;
     vip_uint32_t    size;
     vip_uint32_t    status;
 } gckvip_heap_node_t;
 
-typedef struct _gckvip_heap {
-    vip_uint32_t    free_bytes;
+typedef struct _gckvip_heap_pool {
+    vip_uint32_t    fl_bitmap;
+    vip_uint32_t    sl_bitmap[GCKVIP_HEAP_FL_COUNT];
+    gckvip_heap_node_t *free_list[GCKVIP_HEAP_FL_COUNT][GCKVIP_HEAP_SL_COUNT];
     gckvip_list_head_t list;
 
+    vip_uint32_t    offset;
+    vip_uint32_t    size;
+    vip_uint32_t    free_bytes;
+    vip_uint32_t    used_count;
+
+    /* arena chunk only */
+    struct _gckvip_heap_arena *arena;
+    gckvip_heap_node_t *backing;
+    struct _gckvip_heap_pool *next;
+} gckvip_heap_pool_t;
+
+typedef struct _gckvip_heap_arena {
+    vip_uint32_t    id;
+    vip_uint32_t    chunk_count;
+    vip_bool_e      released;
+    gckvip_heap_pool_t *chunks;
+    struct _gckvip_heap_arena *next;
+} gckvip_heap_arena_t;
+
+typedef struct _gckvip_heap_stats {
+    vip_uint32_t    total_size;
+    vip_uint32_t    free_bytes;
+    vip_uint32_t    largest_free;
+    vip_uint32_t    free_blocks;
+    vip_uint32_t    used_blocks;
+    vip_uint32_t    node_count;
+    vip_uint32_t    node_capacity;
+    vip_uint32_t    arena_count;
+    vip_uint32_t    arena_chunks;
+    vip_uint32_t    arena_free_bytes;
+    /* free blocks per power of 2 size class, [i] counts sizes in [64 << i, 128 << i) */
+    vip_uint32_t    free_hist[GCKVIP_HEAP_FL_COUNT];
+    vip_uint32_t    alloc_fail;
+} gckvip_heap_stats_t;
+
+typedef struct _gckvip_heap {
+    gckvip_heap_pool_t pool;
+
     phy_address_t   physical;
     vip_uint32_t    total_size;
     void            *memory;
@@ -87,6 +149,10 @@ typedef struct _gckvip_heap {
     vip_uint32_t    node_count;
     vip_uint32_t    node_capacity;
     gckvip_heap_node_t *nodes;
+    gckvip_heap_node_t *node_free;
+
+    gckvip_heap_arena_t *arenas;
+    vip_uint32_t    alloc_fail;
 #if vpmdENABLE_MULTIPLE_TASK
     gckvip_mutex       mutex;
 #endif
@@ -103,12 +169,18 @@ vip_status_e gckvip_heap_destroy(
     gckvip_heap_t *heap
     );
 
+/*
+@brief allocate from the heap.
+@param arena_id, 0 for the shared heap, otherwise small blocks are packed in
+       the arena of this id (the owner process id) with the requested alignment.
+*/
 void *gckvip_heap_alloc(
     gckvip_heap_t *heap,
     vip_uint32_t size,
     void **logical,
     phy_address_t *physical,
-    vip_uint32_t align
+    vip_uint32_t align,
+    vip_uint32_t arena_id
     );
 
 vip_status_e gckvip_heap_free(
@@ -116,10 +188,36 @@ vip_status_e gckvip_heap_free(
     void *handle
     );
 
+/*
+@brief release an arena. its empty chunks go back to the shared pool right away,
+       a chunk that still has blocks allocated stays until the last of them is
+       freed by gckvip_heap_free(), those handles remain valid until then.
+*/
+vip_status_e gckvip_heap_arena_release(
+    gckvip_heap_t *heap,
+    vip_uint32_t arena_id
+    );
+
 vip_uint32_t gckvip_heap_capability(
     gckvip_heap_t *heap
     );
 
+vip_status_e gckvip_heap_get_stats(
+    gckvip_heap_t *heap,
+    gckvip_heap_stats_t *stats
+    );
+
+/*
+@brief run random alloc/free rounds on a scratch heap of heap_size bytes.
+@param time_us, total time of the run in micro second.
+*/
+vip_status_e gckvip_heap_benchmark(
+    vip_uint32_t heap_size,
+    vip_uint32_t loops,
+    vip_uint64_t *time_us,
+    gckvip_heap_stats_t *stats
+    );
+
 #endif
 
 #endif
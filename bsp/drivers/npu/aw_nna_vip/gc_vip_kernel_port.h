@@ -129,6 +129,7 @@ typedef   void*        gckvip_atomic;
 typedef   void*        gckvip_signal;
 typedef   void*        gckvip_thread;
 typedef   void*        gckvip_timer;
+typedef   void*        gckvip_fence;
 
 typedef vip_int32_t (* gckvip_thread_func) (vip_ptr param);
 typedef void (* gckvip_timer_func) (vip_ptr param);
@@ -505,4 +506,75 @@ vip_status_e gckvip_os_destroy_timer(
     );
 #endif
 
+#if vpmdENABLE_DMA_FENCE
+/*
+@brief get the fence of a sync_file fd. put it by gckvip_os_put_fence.
+@param fd, the file descriptor of sync_file.
+@param fence, the fence handle.
+*/
+vip_status_e gckvip_os_import_fence(
+    IN vip_int32_t fd,
+    OUT gckvip_fence *fence
+    );
+
+/*
+@brief create a fence on a timeline of its own, it is signaled by gckvip_os_signal_fence.
+@param fence, the fence handle, hold one reference.
+*/
+vip_status_e gckvip_os_create_fence(
+    OUT gckvip_fence *fence
+    );
+
+/*
+@brief get one more reference of the fence.
+*/
+gckvip_fence gckvip_os_get_fence(
+    IN gckvip_fence fence
+    );
+
+/*
+@brief drop one reference of the fence.
+*/
+vip_status_e gckvip_os_put_fence(
+    IN gckvip_fence fence
+    );
+
+/*
+@brief create a sync_file for the fence and reserve a fd of the calling process for it.
+       the fd is only usable once gckvip_os_finish_fence_fds installs it.
+@param fd, the file descriptor of sync_file.
+*/
+vip_status_e gckvip_os_export_fence(
+    IN gckvip_fence fence,
+    OUT vip_int32_t *fd
+    );
+
+/*
+@brief install the sync_file fds the calling thread exported, or release them when
+       the reply carrying their numbers did not reach user space.
+@param install, vip_true_e to install, vip_false_e to release.
+*/
+void gckvip_os_finish_fence_fds(
+    IN vip_bool_e install
+    );
+
+/*
+@brief waiting for a fence signaled.
+@param timeout, unit ms. vpmdINFINITE, infinite wait.
+*/
+vip_status_e gckvip_os_wait_fence(
+    IN gckvip_fence fence,
+    IN vip_uint32_t timeout
+    );
+
+/*
+@brief signal a fence created by gckvip_os_create_fence.
+@param status, the inference status, the fence carries an error when not VIP_SUCCESS.
+*/
+vip_status_e gckvip_os_signal_fence(
+    IN gckvip_fence fence,
+    IN vip_status_e status
+    );
+#endif
+
 #endif /* __GC_VIP_KERNEL_PORT_H__ */
@@ -1233,6 +1233,9 @@ vip_status_e gckvip_mem_allocate_videomemory(
     vip_uint32_t physical_tmp = 0;
     gckvip_video_mem_handle_t *ptr = VIP_NULL;
     phy_address_t phy_addr = 0;
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+    vip_uint32_t arena_id = 0;
+#endif
 
     if ((VIP_NULL == memory) || (VIP_NULL == context) ||
         (VIP_NULL == physical) || (VIP_NULL == handle)) {
@@ -1244,6 +1247,13 @@ vip_status_e gckvip_mem_allocate_videomemory(
         return VIP_ERROR_INVALID_ARGUMENTS;
     }
 
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+    if (alloc_flag & GCVIP_VIDEO_MEM_ALLOC_PROCESS_ARENA) {
+        arena_id = gckvip_os_get_pid();
+    }
+#endif
+    alloc_flag &= ~GCVIP_VIDEO_MEM_ALLOC_PROCESS_ARENA;
+
     PRINTK_D("video memory alloc_flag=0x%x, align=0x%x, size=0x%x\n", alloc_flag, align, size);
 
     status = gckvip_os_lock_mutex(context->memory_mutex);
@@ -1257,7 +1267,7 @@ vip_status_e gckvip_mem_allocate_videomemory(
     if ((gckvip_heap_capability(&context->video_mem_heap) & alloc_flag) == alloc_flag) {
         gckvip_heap_node_t *node = (gckvip_heap_node_t *)gckvip_heap_alloc(&context->video_mem_heap,
                                                                            size, memory, &phy_addr,
-                                                                           align);
+                                                                           align, arena_id);
         if (node != VIP_NULL) {
             gcOnError(gckvip_os_allocate_memory(sizeof(gckvip_video_mem_handle_t), (void**)&ptr));
             ptr->memory_type = GCVIP_VIDEO_MEMORY_TYPE_VIDO_HEAP;
@@ -1366,7 +1376,8 @@ vip_status_e gckvip_mem_allocate_videomemory(
     #if vpmdENABLE_VIDEO_MEMORY_HEAP
     if ((gckvip_heap_capability(&context->video_mem_heap) & alloc_flag) == alloc_flag) {
         gckvip_heap_node_t *node = (gckvip_heap_node_t *)gckvip_heap_alloc(&context->video_mem_heap,
-                                                                           size, memory, &phy_addr, align);
+                                                                           size, memory, &phy_addr, align,
+                                                                           arena_id);
         if (node != VIP_NULL) {
             gcOnError(gckvip_os_allocate_memory(sizeof(gckvip_video_mem_handle_t), (void**)&ptr));
             ptr->memory_type = GCVIP_VIDEO_MEMORY_TYPE_VIDO_HEAP;
@@ -58,6 +58,9 @@
 #include <gc_vip_kernel.h>
 #include <gc_vip_kernel_mmu.h>
 
+/* kernel internal flag, carve small heap blocks from the arena of the calling process */
+#define GCVIP_VIDEO_MEM_ALLOC_PROCESS_ARENA     0x80000000
+
 typedef enum _gckvip_mem_flag
 {
     GCVIP_MEM_FLAG_NONE               = 0x0000,
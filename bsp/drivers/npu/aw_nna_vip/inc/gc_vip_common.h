@@ -473,6 +473,22 @@ provide richer profiling information of the internal NN/TP. This feature needs h
 #endif
 #endif
 
+/*
+    supports explicit dma-fence synchronization, only Linux/Android supports this feature.
+    submit can wait a sync_file in-fence before the command buffer is committed to hardware
+    and return a sync_file out-fence signaled when the inference is done. several inferences
+    can be queued by one batch submit. depends on vpmdENABLE_MULTIPLE_TASK.
+    when set to 1, enable.
+    when set to 0, disable it.
+*/
+#ifndef vpmdENABLE_DMA_FENCE
+#if defined(LINUX)
+#define vpmdENABLE_DMA_FENCE                 1
+#else
+#define vpmdENABLE_DMA_FENCE                 0
+#endif
+#endif
+
 /*
     Enable node module. Only scaler engine(hardware scaling) support node module.
 */
@@ -773,6 +789,17 @@ only one can be enabled between vpmdPOWER_OFF_TIMEOUT and vpmdENABLE_USER_CONTRO
 #endif
 #endif
 
+#if !vpmdENABLE_MULTIPLE_TASK
+#if vpmdAUTO_CORRECT_CONFLICTS
+#undef vpmdENABLE_DMA_FENCE
+#define vpmdENABLE_DMA_FENCE                 0
+#else
+#if vpmdENABLE_DMA_FENCE
+#error "vpmdENABLE_DMA_FENCE should be enabled together with vpmdENABLE_MULTIPLE_TASK"
+#endif
+#endif
+#endif
+
 #if vpmdENABLE_APP_PROFILING
 #if vpmdAUTO_CORRECT_CONFLICTS
 #undef vpmdREGISTER_NETWORK
@@ -166,6 +166,8 @@ typedef enum _gckvip_command_id
     KERNEL_CMD_REGISTER_SEGMENT_INFO = 29,
     KERNEL_CMD_UNREGISTER_NETWORK_INFO = 30,
     KERNEL_CMD_UNREGISTER_SEGMENT_INFO = 31,
+    KERNEL_CMD_SUBMIT_FENCE = 32,
+    KERNEL_CMD_SUBMIT_BATCH = 33,
     KERNEL_CMD_MAX,
 } gckvip_command_id_e;
 
@@ -358,6 +360,40 @@ typedef struct _gckvip_commit
     vip_uint32_t    time_out;
 } gckvip_commit_t;
 
+/* no in-fence for the submit */
+#define GCKVIP_FENCE_FD_NONE            (-1)
+/* create an out-fence for the submit */
+#define GCKVIP_COMMIT_FLAG_OUT_FENCE    0x01
+
+/*
+submit with explicit synchronization.
+the command buffer is committed to hardware once in_fence_fd signaled. when out-fence is
+requested, the task is retired by kernel after inference, the completion and error status
+are reported by the out-fence. don't call KERNEL_CMD_WAIT for this commit.
+*/
+typedef struct _gckvip_commit_fence
+{
+    gckvip_commit_t commit;
+    /* sync_file fd, GCKVIP_FENCE_FD_NONE for not waiting */
+    vip_int32_t     in_fence_fd;
+    /* GCKVIP_COMMIT_FLAG_xxx */
+    vip_uint32_t    flags;
+    /* return the sync_file fd signaled when inference is done */
+    vip_int32_t     out_fence_fd;
+} gckvip_commit_fence_t;
+
+#define GCKVIP_MAX_BATCH_COMMIT         8
+/*
+queue several commits by one call, the multi-task thread commits them back to back.
+*/
+typedef struct _gckvip_commit_batch
+{
+    vip_uint32_t    count;
+    /* return the number of commits queued, the commits after it are not submitted */
+    vip_uint32_t    queued;
+    gckvip_commit_fence_t commits[GCKVIP_MAX_BATCH_COMMIT];
+} gckvip_commit_batch_t;
+
 typedef struct _gckvip_query_address_info
 {
     /* the user space logical address of wait-link buffer */
@@ -552,7 +588,9 @@ static const vip_char_t ioctl_cmd_string[KERNEL_CMD_MAX][48] = {
     "CMD_REGISTER_NETWORK_INFO",   /* 28 */
     "CMD_REGISTER_SEGMENT_INFO",   /* 29 */
     "CMD_UNREGISTER_NETWORK_INFO", /* 30 */
-    "CMD_UNREGISTER_SEGMENT_INFO"  /* 31 */
+    "CMD_UNREGISTER_SEGMENT_INFO", /* 31 */
+    "CMD_SUBMIT_FENCE",            /* 32 */
+    "CMD_SUBMIT_BATCH"             /* 33 */
 };
 #endif
 
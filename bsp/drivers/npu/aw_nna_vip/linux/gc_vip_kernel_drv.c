@@ -414,6 +414,15 @@ static long drv_ioctl(struct file *file, unsigned int ioctl_code, unsigned long
         PRINTK("vipcore, fail to copy arguments\n");
         return -1;
     }
+    /* the fence commands write results back, the buffer has to be exactly theirs */
+    if (((KERNEL_CMD_SUBMIT_FENCE == arguments.command) &&
+         (arguments.bytes != sizeof(gckvip_commit_fence_t))) ||
+        ((KERNEL_CMD_SUBMIT_BATCH == arguments.command) &&
+         (arguments.bytes != sizeof(gckvip_commit_batch_t)))) {
+        PRINTK("vipcore, command[%d] invalid arguments size: %d\n",
+                arguments.command, arguments.bytes);
+        return -1;
+    }
     if (arguments.bytes > 0) {
         if (arguments.bytes >= sizeof(gckvip_command_data)) {
             gckvip_os_allocate_memory(arguments.bytes, (void **)&heap_data);
@@ -459,12 +468,19 @@ static long drv_ioctl(struct file *file, unsigned int ioctl_code, unsigned long
         goto error;
     }
 
+#if vpmdENABLE_DMA_FENCE
+    /* user space knows the out-fence fds now */
+    gckvip_os_finish_fence_fds(vip_true_e);
+#endif
     if (heap_data != VIP_NULL) {
         gckvip_os_free_memory(heap_data);
     }
     return 0;
 
 error:
+#if vpmdENABLE_DMA_FENCE
+    gckvip_os_finish_fence_fds(vip_false_e);
+#endif
     if ((arguments.error != VIP_ERROR_POWER_OFF) && (arguments.error != VIP_ERROR_CANCELED)) {
         PRINTK("vipocre, failed to ioctl, command[%d]: %s\n",
                arguments.command, ioctl_cmd_string[arguments.command]);
@@ -211,6 +211,8 @@ typedef struct _gckvip_command_data {
         gckvip_wait_t wait;
         gckvip_cancel_t cancel;
         gckvip_commit_t commit;
+        gckvip_commit_fence_t commit_fence;
+        gckvip_commit_batch_t batch;
         gckvip_operate_cache_t flush;
         gckvip_reg_t reg;
         gckvip_query_address_info_t info;
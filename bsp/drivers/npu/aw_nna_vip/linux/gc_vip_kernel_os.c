@@ -77,6 +77,11 @@
 #else
 #include <linux/sched.h>
 #endif
+#if vpmdENABLE_DMA_FENCE
+#include <linux/dma-fence.h>
+#include <linux/sync_file.h>
+#include <linux/file.h>
+#endif
 
 #if (LINUX_VERSION_CODE > KERNEL_VERSION (4,20,17) && !defined(CONFIG_ARCH_NO_SG_CHAIN)) ||   \
     (LINUX_VERSION_CODE >= KERNEL_VERSION (3,6,0)       \
@@ -182,6 +187,22 @@ typedef struct _gckvip_signal_data
 } gckvip_signal_data_t;
 
 
+#if vpmdENABLE_DMA_FENCE
+static DEFINE_SPINLOCK(fence_lock);
+
+/* sync_file fds reserved by a kernel call, installed once the reply reached user space */
+typedef struct _gckvip_fence_fd
+{
+    struct list_head node;
+    struct task_struct *task;
+    vip_int32_t fd;
+    struct file *file;
+} gckvip_fence_fd_t;
+
+static LIST_HEAD(fence_fd_list);
+static DEFINE_SPINLOCK(fence_fd_lock);
+#endif
+
 #if vpmdENABLE_MEMORY_PROFILING
 #define INIT_CAP_NUM     128
 typedef struct _gckvip_mem_profile_table_t
@@ -1435,3 +1456,226 @@ vip_status_e gckvip_os_destroy_timer(
 }
 #endif
 
+#if vpmdENABLE_DMA_FENCE
+static const char *fence_get_driver_name(
+    struct dma_fence *fence
+    )
+{
+    return "vipcore";
+}
+
+static const char *fence_get_timeline_name(
+    struct dma_fence *fence
+    )
+{
+    return "vip-submit";
+}
+
+static bool fence_enable_signaling(
+    struct dma_fence *fence
+    )
+{
+    return true;
+}
+
+static const struct dma_fence_ops vip_fence_ops = {
+    .get_driver_name = fence_get_driver_name,
+    .get_timeline_name = fence_get_timeline_name,
+    .enable_signaling = fence_enable_signaling,
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,0,0)
+    .wait = dma_fence_default_wait,
+#endif
+};
+
+vip_status_e gckvip_os_import_fence(
+    IN vip_int32_t fd,
+    OUT gckvip_fence *fence
+    )
+{
+    struct dma_fence *in = VIP_NULL;
+
+    if (VIP_NULL == fence) {
+        PRINTK_E("failed to import fence, parameter is NULL\n");
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    in = sync_file_get_fence(fd);
+    if (VIP_NULL == in) {
+        PRINTK_E("failed to import fence, fd=%d is not a sync_file\n", fd);
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+    *fence = (gckvip_fence)in;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e gckvip_os_create_fence(
+    OUT gckvip_fence *fence
+    )
+{
+    struct dma_fence *out = VIP_NULL;
+
+    if (VIP_NULL == fence) {
+        PRINTK_E("failed to create fence, parameter is NULL\n");
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    /* dma_fence_free() releases it by kfree_rcu */
+    out = kzalloc(sizeof(struct dma_fence), GFP_KERNEL);
+    if (VIP_NULL == out) {
+        PRINTK_E("failed to allocate fence\n");
+        return VIP_ERROR_OUT_OF_MEMORY;
+    }
+    /*
+    out-fences are signaled from the per-device threads, right away for skipped segments
+    and out of order when dropped, so no two of them share a timeline.
+    */
+    dma_fence_init(out, &vip_fence_ops, &fence_lock, dma_fence_context_alloc(1), 1);
+    *fence = (gckvip_fence)out;
+
+    return VIP_SUCCESS;
+}
+
+gckvip_fence gckvip_os_get_fence(
+    IN gckvip_fence fence
+    )
+{
+    return (gckvip_fence)dma_fence_get((struct dma_fence *)fence);
+}
+
+vip_status_e gckvip_os_put_fence(
+    IN gckvip_fence fence
+    )
+{
+    dma_fence_put((struct dma_fence *)fence);
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e gckvip_os_export_fence(
+    IN gckvip_fence fence,
+    OUT vip_int32_t *fd
+    )
+{
+    struct sync_file *sync = VIP_NULL;
+    gckvip_fence_fd_t *pending = VIP_NULL;
+    vip_int32_t new_fd = -1;
+
+    if ((VIP_NULL == fence) || (VIP_NULL == fd)) {
+        PRINTK_E("failed to export fence, parameter is NULL\n");
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    pending = kzalloc(sizeof(*pending), GFP_KERNEL);
+    if (VIP_NULL == pending) {
+        PRINTK_E("failed to allocate pending fence fd\n");
+        return VIP_ERROR_OUT_OF_MEMORY;
+    }
+
+    new_fd = get_unused_fd_flags(O_CLOEXEC);
+    if (new_fd < 0) {
+        kfree(pending);
+        PRINTK_E("failed to get fd for fence, ret=%d\n", new_fd);
+        return VIP_ERROR_OUT_OF_RESOURCE;
+    }
+    sync = sync_file_create((struct dma_fence *)fence);
+    if (VIP_NULL == sync) {
+        put_unused_fd(new_fd);
+        kfree(pending);
+        PRINTK_E("failed to create sync_file\n");
+        return VIP_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* a fd installed before the reply is copied would leak if that copy fails */
+    pending->task = current;
+    pending->fd = new_fd;
+    pending->file = sync->file;
+    spin_lock(&fence_fd_lock);
+    list_add_tail(&pending->node, &fence_fd_list);
+    spin_unlock(&fence_fd_lock);
+    *fd = new_fd;
+
+    return VIP_SUCCESS;
+}
+
+void gckvip_os_finish_fence_fds(
+    IN vip_bool_e install
+    )
+{
+    gckvip_fence_fd_t *pending = VIP_NULL, *tmp = VIP_NULL;
+    LIST_HEAD(list);
+
+    spin_lock(&fence_fd_lock);
+    list_for_each_entry_safe(pending, tmp, &fence_fd_list, node) {
+        if (pending->task == current) {
+            list_move_tail(&pending->node, &list);
+        }
+    }
+    spin_unlock(&fence_fd_lock);
+
+    list_for_each_entry_safe(pending, tmp, &list, node) {
+        if (install) {
+            fd_install(pending->fd, pending->file);
+        }
+        else {
+            put_unused_fd(pending->fd);
+            fput(pending->file);
+        }
+        list_del(&pending->node);
+        kfree(pending);
+    }
+}
+
+vip_status_e gckvip_os_wait_fence(
+    IN gckvip_fence fence,
+    IN vip_uint32_t timeout
+    )
+{
+    signed long ret = 0;
+    signed long jiffies = MAX_SCHEDULE_TIMEOUT;
+
+    if (VIP_NULL == fence) {
+        return VIP_SUCCESS;
+    }
+
+    if (vpmdINFINITE != timeout) {
+        jiffies = msecs_to_jiffies(timeout);
+    }
+    ret = dma_fence_wait_timeout((struct dma_fence *)fence, true, jiffies);
+    if (0 == ret) {
+        PRINTK_E("wait fence timeout=%dms\n", timeout);
+        return VIP_ERROR_TIMEOUT;
+    }
+    else if (ret < 0) {
+        PRINTK_I("wait fence interrupted, ret=%ld\n", ret);
+        return VIP_ERROR_CANCELED;
+    }
+    if (dma_fence_get_status((struct dma_fence *)fence) < 0) {
+        PRINTK_E("in-fence signaled with error=%d\n",
+                 dma_fence_get_status((struct dma_fence *)fence));
+        return VIP_ERROR_FAILURE;
+    }
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e gckvip_os_signal_fence(
+    IN gckvip_fence fence,
+    IN vip_status_e status
+    )
+{
+    struct dma_fence *out = (struct dma_fence *)fence;
+
+    if (VIP_NULL == out) {
+        return VIP_SUCCESS;
+    }
+
+    if (VIP_SUCCESS != status) {
+        dma_fence_set_error(out, (VIP_ERROR_CANCELED == status) ? -ECANCELED :
+                                 (VIP_ERROR_TIMEOUT == status) ? -ETIMEDOUT : -EIO);
+    }
+    dma_fence_signal(out);
+
+    return VIP_SUCCESS;
+}
+#endif
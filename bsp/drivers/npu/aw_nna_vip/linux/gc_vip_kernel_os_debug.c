@@ -620,6 +620,103 @@ static ssize_t gckvip_mem_profile_set(
   return count;
 }
 
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+/* result of the last heap benchmark run */
+static vip_uint32_t heap_bench_loops;
+static vip_uint64_t heap_bench_time;
+static gckvip_heap_stats_t heap_bench_stats;
+
+static loff_t gckvip_heap_info(
+    void *m,
+    void *data
+    )
+{
+    loff_t len = 0, offset = 0;
+    gckvip_context_t *context = gckvip_get_context();
+    gckvip_heap_stats_t stats;
+    vip_uint64_t frag = 0, ns = 0;
+    vip_uint32_t i = 0;
+#if vpmdUSE_DEBUG_FS
+    struct seq_file *ptr = (struct seq_file*)m;
+#else
+    sys_param *param = (sys_param*)m;
+    char* ptr = param->buf;
+    offset = param->offset;
+#endif
+
+    gckvip_os_zero_memory(&stats, sizeof(gckvip_heap_stats_t));
+    if (context->initialize > 0) {
+        gckvip_heap_get_stats(&context->video_mem_heap, &stats);
+    }
+    if (stats.free_bytes > 0) {
+        frag = (vip_uint64_t)stats.largest_free * 100;
+        do_div(frag, stats.free_bytes);
+        frag = 100 - frag;
+    }
+
+    FS_PRINTF(ptr, len, offset, "video memory heap\n");
+    FS_PRINTF(ptr, len, offset, "  size=0x%08x, free=0x%08x, largest free=0x%08x, fragmentation=%d%%\n",
+              stats.total_size, stats.free_bytes, stats.largest_free, (vip_uint32_t)frag);
+    FS_PRINTF(ptr, len, offset, "  used blocks=%d, free blocks=%d, nodes=%d/%d, alloc fail=%d\n",
+              stats.used_blocks, stats.free_blocks, stats.node_count, stats.node_capacity,
+              stats.alloc_fail);
+    FS_PRINTF(ptr, len, offset, "  arenas=%d, chunks=%d, arena free=0x%08x\n",
+              stats.arena_count, stats.arena_chunks, stats.arena_free_bytes);
+    FS_PRINTF(ptr, len, offset, "  free blocks by size class:\n");
+    for (i = 0; i < GCKVIP_HEAP_FL_COUNT; i++) {
+        if (stats.free_hist[i] > 0) {
+            FS_PRINTF(ptr, len, offset, "    >= 0x%08x : %d\n",
+                      1 << (i + GCKVIP_HEAP_MIN_SHIFT), stats.free_hist[i]);
+        }
+    }
+
+    if (heap_bench_loops > 0) {
+        ns = heap_bench_time * 1000;
+        do_div(ns, heap_bench_loops);
+        FS_PRINTF(ptr, len, offset, "benchmark: %d alloc/free in %"PRId64" us, %"PRId64" ns/op, "
+                  "peak fragmentation free blocks=%d, largest free=0x%08x\n",
+                  heap_bench_loops, heap_bench_time, ns,
+                  heap_bench_stats.free_blocks, heap_bench_stats.largest_free);
+    }
+    else {
+        FS_PRINTF(ptr, len, offset, "benchmark: echo bench <loops> > heap_info\n");
+    }
+
+#if !vpmdUSE_DEBUG_FS
+flush_buffer:
+#endif
+    return len;
+}
+
+static ssize_t gckvip_heap_info_set(
+    const char *buf,
+    size_t count
+    )
+{
+    vip_uint32_t loops = 0;
+    vip_uint64_t time_us = 0;
+    gckvip_heap_stats_t stats;
+
+    if ((sscanf(buf, "bench %u", &loops) != 1) || (0 == loops)) {
+        PRINTK_E("invalid param, usage: echo bench <loops> > heap_info\n");
+        return count;
+    }
+
+    gckvip_os_zero_memory(&stats, sizeof(gckvip_heap_stats_t));
+    /* a scratch heap sized like the default one, nothing is touched in the real heap */
+    if (VIP_SUCCESS == gckvip_heap_benchmark(0x2000000, loops, &time_us, &stats)) {
+        heap_bench_loops = loops;
+        heap_bench_time = time_us;
+        heap_bench_stats = stats;
+    }
+    else {
+        PRINTK_E("heap benchmark failed\n");
+    }
+
+    return count;
+}
+#endif
+
 vip_status_e show_memory_mapping(
     gckvip_video_mem_handle_t *ptr,
     void *m,
@@ -1720,6 +1817,42 @@ static int gcvip_seq_mem_profile_show(
     return gckvip_mem_profile((void*)s, VIP_NULL);
 }
 
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+static ssize_t gcvip_debugfs_heap_info_write(
+    struct file *file,
+    const char __user *ubuf,
+    size_t count,
+    loff_t *ppos
+    )
+{
+    vip_char_t buf[32] = {};
+
+    if (count >= sizeof(buf)) {
+        PRINTK_E("please echo bytes no more than %d\n", (vip_uint32_t)sizeof(buf) - 1);
+        return count;
+    }
+
+    if (copy_from_user(&buf, ubuf, count)) {
+        PRINTK_E("copy user data to kernel space fail\n");
+        return count;
+    }
+
+    mutex_lock(&debugfs_mutex);
+    gckvip_heap_info_set((const char*)&buf, count);
+    mutex_unlock(&debugfs_mutex);
+
+    return count;
+}
+
+static int gcvip_seq_heap_info_show(
+    struct seq_file *s,
+    void *v
+    )
+{
+    return gckvip_heap_info((void*)s, VIP_NULL);
+}
+#endif
+
 static ssize_t gcvip_debugfs_vip_freq_write(
     struct file *file,
     const char __user *ubuf,
@@ -2151,6 +2284,9 @@ unroll_debugfs_file(core_loading)
 unroll_debugfs_file(vip_info)
 unroll_debugfs_file(mem_profile)
 unroll_debugfs_file(mem_mapping)
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+unroll_debugfs_file(heap_info)
+#endif
 #if vpmdENABLE_MMU
 unroll_debugfs_file(dump_mmu_table)
 #endif
@@ -2200,6 +2336,9 @@ vip_status_e gckvip_debug_create_debugfs(void)
     debugfs_create_file("mem_profile", 0644, kdriver->debugfs_parent, NULL, &gcvip_debugfs_mem_profile_ops);
     debugfs_create_file("mem_mapping", 0644, kdriver->debugfs_parent, NULL, &gcvip_debugfs_mem_mapping_ops);
     debugfs_create_file("register_rw", 0644, kdriver->debugfs_parent, NULL, &gcvip_debugfs_register_rw_ops);
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+    debugfs_create_file("heap_info", 0644, kdriver->debugfs_parent, NULL, &gcvip_debugfs_heap_info_ops);
+#endif
 #if vpmdENABLE_DEBUG_LOG > 2
     debugfs_create_file("rt_log", 0644, kdriver->debugfs_parent, NULL, &gcvip_debugfs_rt_log_ops);
 #endif
@@ -2354,6 +2493,39 @@ static ssize_t mem_profile_store(
     return ret;
 }
 
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+static ssize_t heap_info_show(
+    struct file *filp,
+    struct kobject *kobj,
+    struct bin_attribute *attr,
+    char *buf,
+    loff_t off,
+    size_t count)
+{
+    loff_t len = 0;
+    sys_param param;
+    param.buf = buf;
+    param.offset = off;
+    len = (loff_t)gckvip_heap_info((void *)(&param), VIP_NULL);
+
+    return (len >= off ? len - off : 0);
+}
+static ssize_t heap_info_store(
+    struct file *filp,
+    struct kobject *kobj,
+    struct bin_attribute *attr,
+    char *buf,
+    loff_t off,
+    size_t count)
+{
+    ssize_t ret = 0;
+    mutex_lock(&debugfs_mutex);
+    ret = (ssize_t)gckvip_heap_info_set(buf, count);
+    mutex_unlock(&debugfs_mutex);
+    return ret;
+}
+#endif
+
 static ssize_t mem_mapping_show(
     struct file *filp,
     struct kobject *kobj,
@@ -2644,6 +2816,9 @@ sysfs_RW(vip_freq);
 sysfs_RW(core_loading);
 sysfs_RW(mem_profile);
 sysfs_RO(mem_mapping);
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+sysfs_RW(heap_info);
+#endif
 #if vpmdENABLE_MMU
 sysfs_RO(dump_mmu_table);
 #endif
@@ -2682,6 +2857,9 @@ vip_status_e gckvip_debug_create_sysfs(void)
     status |= sysfs_create_bin_file(&kdriver->device->kobj, &sysfs_core_loading_attr);
     status |= sysfs_create_bin_file(&kdriver->device->kobj, &sysfs_mem_profile_attr);
     status |= sysfs_create_bin_file(&kdriver->device->kobj, &sysfs_mem_mapping_attr);
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+    status |= sysfs_create_bin_file(&kdriver->device->kobj, &sysfs_heap_info_attr);
+#endif
 #if vpmdENABLE_MMU
     status |= sysfs_create_bin_file(&kdriver->device->kobj, &sysfs_dump_mmu_table_attr);
 #endif
@@ -2722,6 +2900,9 @@ vip_status_e gckvip_debug_destroy_sysfs(void)
     sysfs_remove_bin_file(&kdriver->device->kobj, &sysfs_core_loading_attr);
     sysfs_remove_bin_file(&kdriver->device->kobj, &sysfs_mem_profile_attr);
     sysfs_remove_bin_file(&kdriver->device->kobj, &sysfs_mem_mapping_attr);
+#if vpmdENABLE_VIDEO_MEMORY_HEAP
+    sysfs_remove_bin_file(&kdriver->device->kobj, &sysfs_heap_info_attr);
+#endif
 #if vpmdENABLE_MMU
     sysfs_remove_bin_file(&kdriver->device->kobj, &sysfs_dump_mmu_table_attr);
 #endif
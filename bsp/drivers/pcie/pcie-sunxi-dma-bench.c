@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner PCIe eDMA throughput benchmark
+ *
+ * Moves a local buffer to (write) or from (read) a remote PCIe bus address
+ * through the eDMA dmaengine channels, first on one channel and then with
+ * up to @channels channels running in parallel. Every descriptor is a
+ * scatterlist of @segs segments, executed as one linked list. Each channel
+ * uses its own @size bytes window starting at @bus_addr, the remote side
+ * has to provide @channels * @size bytes there. The test runs once when the
+ * module is loaded, results go to the kernel log:
+ *
+ *   insmod pcie-sunxi-dma-bench.ko bus_addr=0x20000000 dir=0 channels=4
+ */
+
+#define pr_fmt(fmt) "pcie-sunxi-dma-bench: " fmt
+
+#include <linux/completion.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+
+static char *controller = "";
+module_param(controller, charp, 0444);
+MODULE_PARM_DESC(controller, "PCIe controller device name, empty for any (default: \"\")");
+
+static unsigned long bus_addr;
+module_param(bus_addr, ulong, 0444);
+MODULE_PARM_DESC(bus_addr, "Remote PCIe bus address of the test windows (required)");
+
+static unsigned int dir;
+module_param(dir, uint, 0444);
+MODULE_PARM_DESC(dir, "0: local to remote (eDMA write), 1: remote to local (eDMA read)");
+
+static unsigned int channels = 4;
+module_param(channels, uint, 0444);
+MODULE_PARM_DESC(channels, "Maximum number of channels in parallel (default: 4)");
+
+static unsigned int size = SZ_1M;
+module_param(size, uint, 0444);
+MODULE_PARM_DESC(size, "Bytes per descriptor and channel window (default: 1M)");
+
+static unsigned int segs = 16;
+module_param(segs, uint, 0444);
+MODULE_PARM_DESC(segs, "Scatterlist segments per descriptor (default: 16)");
+
+static unsigned int iterations = 100;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Descriptors per channel and test (default: 100)");
+
+#define BENCH_TIMEOUT	msecs_to_jiffies(3000)
+
+struct bench_chan {
+	struct dma_chan		*chan;
+	struct device		*dev;
+	void			*buf;
+	dma_addr_t		buf_dma;
+	struct sg_table		sgt;
+	struct completion	done;
+};
+
+static enum dma_transfer_direction bench_dir(void)
+{
+	return dir ? DMA_DEV_TO_MEM : DMA_MEM_TO_DEV;
+}
+
+static bool bench_filter(struct dma_chan *chan, void *param)
+{
+	struct device *dev = chan->device->dev;
+	struct dma_slave_caps caps;
+
+	if (!dev->driver || strcmp(dev->driver->name, "sunxi-pcie"))
+		return false;
+
+	if (controller[0] && strcmp(dev_name(dev), controller))
+		return false;
+
+	if (dma_get_slave_caps(chan, &caps))
+		return false;
+
+	return caps.directions & BIT(bench_dir());
+}
+
+static void bench_callback(void *param)
+{
+	struct bench_chan *bc = param;
+
+	complete(&bc->done);
+}
+
+static int bench_chan_init(struct bench_chan *bc, unsigned int idx)
+{
+	struct dma_slave_config config = { 0 };
+	struct scatterlist *sg;
+	dma_cap_mask_t mask;
+	unsigned int i, seg = size / segs;
+	int ret;
+
+	init_completion(&bc->done);
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_SLAVE, mask);
+	bc->chan = dma_request_channel(mask, bench_filter, NULL);
+	if (!bc->chan)
+		return -ENODEV;
+	bc->dev = bc->chan->device->dev;
+
+	bc->buf = dma_alloc_coherent(bc->dev, size, &bc->buf_dma, GFP_KERNEL);
+	if (!bc->buf) {
+		ret = -ENOMEM;
+		goto err_release;
+	}
+	memset(bc->buf, idx, size);
+
+	ret = sg_alloc_table(&bc->sgt, segs, GFP_KERNEL);
+	if (ret)
+		goto err_free_buf;
+
+	/* the buffer is coherent, fill in the bus addresses directly */
+	for_each_sg(bc->sgt.sgl, sg, segs, i) {
+		sg_dma_address(sg) = bc->buf_dma + i * seg;
+		sg_dma_len(sg) = i == segs - 1 ? size - i * seg : seg;
+	}
+
+	if (bench_dir() == DMA_MEM_TO_DEV)
+		config.dst_addr = bus_addr + (u64)idx * size;
+	else
+		config.src_addr = bus_addr + (u64)idx * size;
+	config.direction = bench_dir();
+	ret = dmaengine_slave_config(bc->chan, &config);
+	if (ret)
+		goto err_free_sgt;
+
+	return 0;
+
+err_free_sgt:
+	sg_free_table(&bc->sgt);
+err_free_buf:
+	dma_free_coherent(bc->dev, size, bc->buf, bc->buf_dma);
+err_release:
+	dma_release_channel(bc->chan);
+	bc->chan = NULL;
+	return ret;
+}
+
+static void bench_chan_exit(struct bench_chan *bc)
+{
+	if (!bc->chan)
+		return;
+
+	sg_free_table(&bc->sgt);
+	dma_free_coherent(bc->dev, size, bc->buf, bc->buf_dma);
+	dma_release_channel(bc->chan);
+}
+
+static int bench_submit(struct bench_chan *bc)
+{
+	struct dma_async_tx_descriptor *tx;
+
+	reinit_completion(&bc->done);
+
+	tx = dmaengine_prep_slave_sg(bc->chan, bc->sgt.sgl, segs, bench_dir(),
+				     DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!tx)
+		return -ENOMEM;
+
+	tx->callback = bench_callback;
+	tx->callback_param = bc;
+	if (dma_submit_error(dmaengine_submit(tx)))
+		return -EIO;
+
+	dma_async_issue_pending(bc->chan);
+
+	return 0;
+}
+
+/* @n channels, each with one descriptor in flight */
+static int bench_run(struct bench_chan *bc, unsigned int n)
+{
+	unsigned int i, c;
+	u64 bytes, ns;
+	ktime_t start;
+	int ret;
+
+	start = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		for (c = 0; c < n; c++) {
+			ret = bench_submit(&bc[c]);
+			if (ret) {
+				pr_err("submit failed on channel %u: %d\n", c, ret);
+				return ret;
+			}
+		}
+
+		for (c = 0; c < n; c++) {
+			if (!wait_for_completion_timeout(&bc[c].done, BENCH_TIMEOUT)) {
+				pr_err("%s timed out\n", dma_chan_name(bc[c].chan));
+				for (c = 0; c < n; c++)
+					dmaengine_terminate_sync(bc[c].chan);
+				return -ETIMEDOUT;
+			}
+		}
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	bytes = (u64)size * iterations * n;
+
+	pr_info("%u channel(s): %llu MB/s\n", n,
+		div64_u64(bytes * NSEC_PER_SEC, max_t(u64, ns, 1)) >> 20);
+
+	return 0;
+}
+
+static int __init sunxi_pcie_dma_bench_init(void)
+{
+	struct bench_chan *bc;
+	unsigned int i, n;
+	int ret = 0;
+
+	if (!bus_addr || !iterations || !channels || !segs || size < segs)
+		return -EINVAL;
+
+	bc = kcalloc(channels, sizeof(*bc), GFP_KERNEL);
+	if (!bc)
+		return -ENOMEM;
+
+	for (n = 0; n < channels; n++) {
+		if (bench_chan_init(&bc[n], n))
+			break;
+	}
+	if (!n) {
+		pr_err("no %s channel\n", dir ? "read" : "write");
+		ret = -ENODEV;
+		goto out;
+	}
+
+	pr_info("%s: %u channel(s), %u x %u bytes in %u segments\n",
+		dir ? "read" : "write", n, iterations, size, segs);
+
+	for (i = 1; i <= n; i++) {
+		ret = bench_run(bc, i);
+		if (ret)
+			break;
+	}
+
+out:
+	for (i = 0; i < channels; i++)
+		bench_chan_exit(&bc[i]);
+	kfree(bc);
+	return ret;
+}
+module_init(sunxi_pcie_dma_bench_init);
+
+static void __exit sunxi_pcie_dma_bench_exit(void)
+{
+}
+module_exit(sunxi_pcie_dma_bench_exit);
+
+MODULE_DESCRIPTION("Allwinner PCIe eDMA throughput benchmark");
+MODULE_LICENSE("GPL");
@@ -6,11 +6,19 @@
  * The pcie_dma_chnl_request() is used to apply for pcie DMA channels;
  * The pcie_dma_mem_xxx() is to initiate DMA read and write operations;
  *
+ * The channels not claimed through pcie_dma_chnl_request() are also
+ * registered as a dmaengine device. Those run in linked list mode: each
+ * descriptor is written as a chain of data elements into the channel's
+ * linked list memory, longer scatterlists are fed in chunks from the done
+ * interrupt. Write channels move local memory to the PCIe bus
+ * (DMA_MEM_TO_DEV), read channels the other way round (DMA_DEV_TO_MEM).
  */
 
 #define SUNXI_MODNAME "pcie-edma"
 #include <sunxi-log.h>
 #include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
 #include <linux/fs.h>
 #include <linux/gpio.h>
 #include <linux/init.h>
@@ -29,8 +37,10 @@
 #include <linux/reset.h>
 #include <linux/resource.h>
 #include <linux/signal.h>
+#include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/uaccess.h>
+#include <linux/version.h>
 #include "pcie-sunxi-dma.h"
 
 
@@ -231,6 +241,479 @@ int sunxi_pcie_dma_mem_write(phys_addr_t src_addr, phys_addr_t dst_addr, unsigne
 }
 EXPORT_SYMBOL_GPL(sunxi_pcie_dma_mem_write);
 
+static inline struct sunxi_pcie_edma_chan *to_sunxi_edma_chan(struct dma_chan *c)
+{
+	return container_of(c, struct sunxi_pcie_edma_chan, vc.chan);
+}
+
+static inline struct sunxi_pcie_edma_desc *to_sunxi_edma_desc(struct virt_dma_desc *vd)
+{
+	return container_of(vd, struct sunxi_pcie_edma_desc, vd);
+}
+
+static inline u32 sunxi_pcie_edma_reg(struct sunxi_pcie_edma_chan *chan, u32 wr, u32 rd)
+{
+	return PCIE_DMA_OFFSET + (chan->dir == PCIE_DMA_READ ? rd : wr);
+}
+
+static inline u32 sunxi_pcie_edma_ch_reg(struct sunxi_pcie_edma_chan *chan, u32 wr, u32 rd)
+{
+	return sunxi_pcie_edma_reg(chan, wr, rd) + chan->chnl * 0x200;
+}
+
+/*
+ * Write the next chunk of @desc into the linked list: data elements carry the
+ * chunk's cycle bit, the last one raises the done interrupt, and the link
+ * element toggles the consumer cycle state so the channel stops once the
+ * chunk is consumed.
+ */
+static void sunxi_pcie_edma_write_ll(struct sunxi_pcie_edma_chan *chan,
+				     struct sunxi_pcie_edma_desc *desc)
+{
+	struct edma_ll_data *lli = chan->ll_virt;
+	struct edma_ll_link *llp;
+	struct sunxi_pcie_edma_burst *burst;
+	u32 i;
+
+	desc->count = min_t(u32, desc->nr_bursts - desc->start, PCIE_EDMA_LL_MAX_ELEM);
+
+	for (i = 0; i < desc->count; i++) {
+		burst = &desc->burst[desc->start + i];
+
+		lli[i].control.dword = 0;
+		lli[i].control.cb = desc->cb;
+		lli[i].control.lie = (i == desc->count - 1);
+		lli[i].xfersize = burst->size;
+		lli[i].sarptrlo = lower_32_bits(burst->sar);
+		lli[i].sarptrhi = upper_32_bits(burst->sar);
+		lli[i].darptrlo = lower_32_bits(burst->dar);
+		lli[i].darptrhi = upper_32_bits(burst->dar);
+	}
+
+	llp = (struct edma_ll_link *)&lli[desc->count];
+	llp->control.dword = 0;
+	llp->control.cb = !desc->cb;
+	llp->control.tcb = 1;
+	llp->control.llp = 1;
+	llp->llptrlo = lower_32_bits(chan->ll_phys);
+	llp->llptrhi = upper_32_bits(chan->ll_phys);
+}
+
+/* called with vc.lock held */
+static void sunxi_pcie_edma_start(struct sunxi_pcie_edma_chan *chan, bool first)
+{
+	struct sunxi_pcie *pci = chan->pci;
+	union chan_ctrl_lo ctrllo = {0};
+	union enb enb = {0};
+	union db start = {0};
+
+	sunxi_pcie_edma_write_ll(chan, chan->desc);
+
+	if (first) {
+		enb.enb = 0x1;
+		sunxi_pcie_writel_dbi(pci, sunxi_pcie_edma_reg(chan, PCIE_DMA_WR_ENB, PCIE_DMA_RD_ENB),
+				      enb.dword);
+
+		ctrllo.ccs  = 0x1;
+		ctrllo.llen = 0x1;
+		sunxi_pcie_writel_dbi(pci, sunxi_pcie_edma_ch_reg(chan, PCIE_DMA_WR_CTRL_LO, PCIE_DMA_RD_CTRL_LO),
+				      ctrllo.dword);
+		sunxi_pcie_writel_dbi(pci, sunxi_pcie_edma_ch_reg(chan, PCIE_DMA_WR_CTRL_HI, PCIE_DMA_RD_CTRL_HI),
+				      0x0);
+		sunxi_pcie_writel_dbi(pci, sunxi_pcie_edma_ch_reg(chan, PCIE_DMA_WR_LLP_LO, PCIE_DMA_RD_LLP_LO),
+				      lower_32_bits(chan->ll_phys));
+		sunxi_pcie_writel_dbi(pci, sunxi_pcie_edma_ch_reg(chan, PCIE_DMA_WR_LLP_HI, PCIE_DMA_RD_LLP_HI),
+				      upper_32_bits(chan->ll_phys));
+	}
+
+	start.chnl = chan->chnl;
+	sunxi_pcie_writel_dbi(pci, sunxi_pcie_edma_reg(chan, PCIE_DMA_WR_DOORBELL, PCIE_DMA_RD_DOORBELL),
+			      start.dword);
+}
+
+/* called with vc.lock held */
+static void sunxi_pcie_edma_start_next(struct sunxi_pcie_edma_chan *chan)
+{
+	struct virt_dma_desc *vd = vchan_next_desc(&chan->vc);
+
+	if (!vd) {
+		chan->desc = NULL;
+		return;
+	}
+
+	list_del(&vd->node);
+	chan->desc = to_sunxi_edma_desc(vd);
+	chan->desc->start = 0;
+	chan->desc->cb = true;
+
+	sunxi_pcie_edma_start(chan, true);
+}
+
+/* called with vc.lock held */
+static void sunxi_pcie_edma_stop(struct sunxi_pcie_edma_chan *chan)
+{
+	union db stop = {0};
+
+	stop.chnl = chan->chnl;
+	stop.stop = 0x1;
+	sunxi_pcie_writel_dbi(chan->pci, sunxi_pcie_edma_reg(chan, PCIE_DMA_WR_DOORBELL, PCIE_DMA_RD_DOORBELL),
+			      stop.dword);
+}
+
+/*
+ * Done/abort interrupt of a channel. Returns false when the channel is not
+ * owned by the dmaengine device, the caller then runs the legacy callback.
+ */
+bool sunxi_pcie_edma_handle_irq(struct sunxi_pcie *pci, u32 chnl, enum dma_dir dma_trx, bool abort)
+{
+	struct sunxi_pcie_edma *edma = pci->edma;
+	struct sunxi_pcie_edma_chan *chan;
+	struct sunxi_pcie_edma_desc *desc;
+	unsigned long flags;
+	u32 i, nr = edma ? edma->nr_chans / 2 : 0;
+
+	if (chnl >= nr)
+		return false;
+
+	chan = &edma->chan[dma_trx == PCIE_DMA_READ ? nr + chnl : chnl];
+	if (!chan->ll_virt)
+		return false;
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+
+	desc = chan->desc;
+	if (!desc)
+		goto out;
+
+	if (abort) {
+		desc->vd.tx_result.result = DMA_TRANS_ABORTED;
+		desc->vd.tx_result.residue = desc->residue;
+		vchan_cookie_complete(&desc->vd);
+		sunxi_pcie_edma_start_next(chan);
+		goto out;
+	}
+
+	for (i = 0; i < desc->count; i++)
+		desc->residue -= desc->burst[desc->start + i].size;
+	desc->start += desc->count;
+
+	if (desc->start < desc->nr_bursts) {
+		desc->cb = !desc->cb;
+		sunxi_pcie_edma_start(chan, false);
+		goto out;
+	}
+
+	vchan_cookie_complete(&desc->vd);
+	sunxi_pcie_edma_start_next(chan);
+
+out:
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+
+	return true;
+}
+
+static int sunxi_pcie_edma_alloc_chan_resources(struct dma_chan *c)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+	struct sunxi_pcie *pci = chan->pci;
+	unsigned long *map;
+
+	if (chan->dir == PCIE_DMA_WRITE) {
+		map = pci->wr_edma_map;
+		chan->hw = &pci->dma_wr_chn[chan->chnl];
+	} else {
+		map = pci->rd_edma_map;
+		chan->hw = &pci->dma_rd_chn[chan->chnl];
+	}
+
+	/* the channel may already be handed out by sunxi_pcie_dma_chan_request() */
+	if (test_and_set_bit(chan->chnl, map))
+		return -EBUSY;
+
+	chan->hw->dma_trx = chan->dir;
+	chan->hw->chnl_num = chan->chnl;
+	chan->hw->callback = NULL;
+	chan->hw->callback_param = NULL;
+	chan->hw->cookie = false;
+
+	chan->ll_virt = dma_alloc_coherent(pci->dev, PCIE_EDMA_LL_SIZE, &chan->ll_phys, GFP_KERNEL);
+	if (!chan->ll_virt) {
+		clear_bit(chan->chnl, map);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int sunxi_pcie_edma_terminate_all(struct dma_chan *c)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+
+	if (chan->desc) {
+		sunxi_pcie_edma_stop(chan);
+		vchan_terminate_vdesc(&chan->desc->vd);
+		chan->desc = NULL;
+	}
+	vchan_get_all_descriptors(&chan->vc, &head);
+
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+
+	vchan_dma_desc_free_list(&chan->vc, &head);
+
+	return 0;
+}
+
+static void sunxi_pcie_edma_synchronize(struct dma_chan *c)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+
+	vchan_synchronize(&chan->vc);
+}
+
+static void sunxi_pcie_edma_free_chan_resources(struct dma_chan *c)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+	struct sunxi_pcie *pci = chan->pci;
+	void *ll_virt = chan->ll_virt;
+
+	sunxi_pcie_edma_terminate_all(c);
+	vchan_free_chan_resources(&chan->vc);
+
+	chan->ll_virt = NULL;
+	dma_free_coherent(pci->dev, PCIE_EDMA_LL_SIZE, ll_virt, chan->ll_phys);
+
+	clear_bit(chan->chnl, chan->dir == PCIE_DMA_WRITE ? pci->wr_edma_map : pci->rd_edma_map);
+}
+
+static int sunxi_pcie_edma_config(struct dma_chan *c, struct dma_slave_config *config)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+
+	memcpy(&chan->config, config, sizeof(*config));
+
+	return 0;
+}
+
+static void sunxi_pcie_edma_issue_pending(struct dma_chan *c)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+	unsigned long flags;
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+	if (vchan_issue_pending(&chan->vc) && !chan->desc)
+		sunxi_pcie_edma_start_next(chan);
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+}
+
+static enum dma_status sunxi_pcie_edma_tx_status(struct dma_chan *c, dma_cookie_t cookie,
+						 struct dma_tx_state *state)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+	struct virt_dma_desc *vd;
+	enum dma_status ret;
+	unsigned long flags;
+	size_t residue = 0;
+
+	ret = dma_cookie_status(c, cookie, state);
+	if (ret == DMA_COMPLETE || !state)
+		return ret;
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+	if (chan->desc && chan->desc->vd.tx.cookie == cookie) {
+		residue = chan->desc->residue;
+	} else {
+		vd = vchan_find_desc(&chan->vc, cookie);
+		if (vd)
+			residue = to_sunxi_edma_desc(vd)->residue;
+	}
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+
+	dma_set_residue(state, residue);
+
+	return ret;
+}
+
+static struct dma_async_tx_descriptor *
+sunxi_pcie_edma_prep_slave_sg(struct dma_chan *c, struct scatterlist *sgl, unsigned int sg_len,
+			      enum dma_transfer_direction direction, unsigned long flags, void *context)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+	struct sunxi_pcie_edma_desc *desc;
+	struct sunxi_pcie_edma_burst *burst;
+	struct scatterlist *sg;
+	u64 remote;
+	u32 i;
+
+	if (!sg_len)
+		return NULL;
+
+	if (direction != (chan->dir == PCIE_DMA_WRITE ? DMA_MEM_TO_DEV : DMA_DEV_TO_MEM)) {
+		sunxi_err(chan->pci->dev, "edma %s channel %d: unsupported direction %d\n",
+			  chan->dir ? "read" : "write", chan->chnl, direction);
+		return NULL;
+	}
+
+	desc = kzalloc(struct_size(desc, burst, sg_len), GFP_NOWAIT);
+	if (!desc)
+		return NULL;
+
+	/* the remote side is one contiguous region starting at the slave address */
+	remote = direction == DMA_MEM_TO_DEV ? chan->config.dst_addr : chan->config.src_addr;
+
+	for_each_sg(sgl, sg, sg_len, i) {
+		burst = &desc->burst[i];
+		burst->size = sg_dma_len(sg);
+		if (direction == DMA_MEM_TO_DEV) {
+			burst->sar = sg_dma_address(sg);
+			burst->dar = remote;
+		} else {
+			burst->sar = remote;
+			burst->dar = sg_dma_address(sg);
+		}
+		remote += burst->size;
+		desc->residue += burst->size;
+	}
+	desc->nr_bursts = sg_len;
+
+	return vchan_tx_prep(&chan->vc, &desc->vd, flags);
+}
+
+static struct dma_async_tx_descriptor *
+sunxi_pcie_edma_prep_memcpy(struct dma_chan *c, dma_addr_t dst, dma_addr_t src,
+			    size_t len, unsigned long flags)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+	struct sunxi_pcie_edma_desc *desc;
+
+	/* Transfer size: 1B - 4GB */
+	if (!len || len > U32_MAX)
+		return NULL;
+
+	desc = kzalloc(struct_size(desc, burst, 1), GFP_NOWAIT);
+	if (!desc)
+		return NULL;
+
+	desc->burst[0].sar = src;
+	desc->burst[0].dar = dst;
+	desc->burst[0].size = len;
+	desc->nr_bursts = 1;
+	desc->residue = len;
+
+	return vchan_tx_prep(&chan->vc, &desc->vd, flags);
+}
+
+static void sunxi_pcie_edma_desc_free(struct virt_dma_desc *vd)
+{
+	kfree(to_sunxi_edma_desc(vd));
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+/* lets EP function drivers pick a channel by direction via dma_get_slave_caps() */
+static void sunxi_pcie_edma_caps(struct dma_chan *c, struct dma_slave_caps *caps)
+{
+	struct sunxi_pcie_edma_chan *chan = to_sunxi_edma_chan(c);
+
+	caps->directions = chan->dir == PCIE_DMA_WRITE ? BIT(DMA_MEM_TO_DEV) : BIT(DMA_DEV_TO_MEM);
+}
+#endif
+
+int sunxi_pcie_edma_probe(struct sunxi_pcie *pci)
+{
+	struct sunxi_pcie_edma *edma;
+	struct sunxi_pcie_edma_chan *chan;
+	struct dma_device *dma;
+	u32 i, nr, val;
+	int ret;
+
+	/* only the first channels have an interrupt line */
+	nr = min_t(u32, pci->num_edma, PCIE_DMA_CHN_IRQ_NUM);
+	if (!nr)
+		return 0;
+
+	edma = devm_kzalloc(pci->dev, struct_size(edma, chan, nr * 2), GFP_KERNEL);
+	if (!edma)
+		return -ENOMEM;
+
+	edma->pci = pci;
+	edma->nr_chans = nr * 2;
+	dma = &edma->dma;
+
+	INIT_LIST_HEAD(&dma->channels);
+	for (i = 0; i < edma->nr_chans; i++) {
+		chan = &edma->chan[i];
+		chan->pci = pci;
+		chan->dir = i < nr ? PCIE_DMA_WRITE : PCIE_DMA_READ;
+		chan->chnl = i % nr;
+		chan->vc.desc_free = sunxi_pcie_edma_desc_free;
+		vchan_init(&chan->vc, dma);
+	}
+
+	dma_cap_zero(dma->cap_mask);
+	dma_cap_set(DMA_SLAVE, dma->cap_mask);
+	dma_cap_set(DMA_MEMCPY, dma->cap_mask);
+
+	dma->dev = pci->dev;
+	dma->device_alloc_chan_resources = sunxi_pcie_edma_alloc_chan_resources;
+	dma->device_free_chan_resources = sunxi_pcie_edma_free_chan_resources;
+	dma->device_prep_slave_sg = sunxi_pcie_edma_prep_slave_sg;
+	dma->device_prep_dma_memcpy = sunxi_pcie_edma_prep_memcpy;
+	dma->device_config = sunxi_pcie_edma_config;
+	dma->device_terminate_all = sunxi_pcie_edma_terminate_all;
+	dma->device_synchronize = sunxi_pcie_edma_synchronize;
+	dma->device_issue_pending = sunxi_pcie_edma_issue_pending;
+	dma->device_tx_status = sunxi_pcie_edma_tx_status;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+	dma->device_caps = sunxi_pcie_edma_caps;
+#endif
+	dma->src_addr_widths = BIT(DMA_SLAVE_BUSWIDTH_1_BYTE) | BIT(DMA_SLAVE_BUSWIDTH_2_BYTES) |
+			       BIT(DMA_SLAVE_BUSWIDTH_4_BYTES) | BIT(DMA_SLAVE_BUSWIDTH_8_BYTES);
+	dma->dst_addr_widths = dma->src_addr_widths;
+	dma->directions = BIT(DMA_DEV_TO_MEM) | BIT(DMA_MEM_TO_DEV);
+	dma->residue_granularity = DMA_RESIDUE_GRANULARITY_DESCRIPTOR;
+
+	/* report linked list fetch errors as abort */
+	val = sunxi_pcie_readl_dbi(pci, PCIE_DMA_OFFSET + PCIE_DMA_WR_LL_ERR_EN);
+	sunxi_pcie_writel_dbi(pci, PCIE_DMA_OFFSET + PCIE_DMA_WR_LL_ERR_EN, val | GENMASK(nr - 1, 0));
+	val = sunxi_pcie_readl_dbi(pci, PCIE_DMA_OFFSET + PCIE_DMA_RD_LL_ERR_EN);
+	sunxi_pcie_writel_dbi(pci, PCIE_DMA_OFFSET + PCIE_DMA_RD_LL_ERR_EN, val | GENMASK(nr - 1, 0));
+
+	ret = dma_async_device_register(dma);
+	if (ret) {
+		sunxi_err(pci->dev, "failed to register edma dmaengine device\n");
+		return ret;
+	}
+
+	pci->edma = edma;
+
+	sunxi_info(pci->dev, "edma: %u write and %u read channels in linked list mode\n", nr, nr);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sunxi_pcie_edma_probe);
+
+void sunxi_pcie_edma_remove(struct sunxi_pcie *pci)
+{
+	struct sunxi_pcie_edma *edma = pci->edma;
+	u32 i;
+
+	if (!edma)
+		return;
+
+	dma_async_device_unregister(&edma->dma);
+
+	for (i = 0; i < edma->nr_chans; i++) {
+		list_del(&edma->chan[i].vc.chan.device_node);
+		tasklet_kill(&edma->chan[i].vc.task);
+	}
+
+	pci->edma = NULL;
+}
+EXPORT_SYMBOL_GPL(sunxi_pcie_edma_remove);
+
 struct dma_trx_obj *sunxi_pcie_dma_obj_probe(struct device *dev)
 {
 	struct dma_trx_obj *obj;
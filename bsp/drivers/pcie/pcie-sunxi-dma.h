@@ -15,10 +15,15 @@
 #define _PCIE_SUNXI_DMA_H
 
 #include <linux/debugfs.h>
+#include <linux/dmaengine.h>
 #include <linux/platform_device.h>
+#include <linux/sizes.h>
+#include <virt-dma.h>
 
 #include "pcie-sunxi.h"
 
+struct sunxi_pcie;
+
 #define PCIE_DMA_TABLE_NUM		8
 #define PCIE_DMA_TRX_TYPE_NUM		3
 
@@ -48,6 +53,9 @@
 #define PCIE_DMA_WR_INT_STATUS		0x4c
 #define PCIE_DMA_WR_INT_MASK		0x54
 #define PCIE_DMA_WR_INT_CLEAR		0x58
+#define PCIE_DMA_WR_LL_ERR_EN		0x90
+#define PCIE_DMA_WR_LLP_LO		0x21c
+#define PCIE_DMA_WR_LLP_HI		0x220
 
 #define PCIE_DMA_RD_ENB			0x2c
 #define PCIE_DMA_RD_CTRL_LO		0x300
@@ -63,9 +71,23 @@
 #define PCIE_DMA_RD_INT_STATUS		0xa0
 #define PCIE_DMA_RD_INT_MASK		0xa8
 #define PCIE_DMA_RD_INT_CLEAR		0xac
+#define PCIE_DMA_RD_LL_ERR_EN		0xc4
+#define PCIE_DMA_RD_LLP_LO		0x31c
+#define PCIE_DMA_RD_LLP_HI		0x320
 
 #define PCIE_DMA_INT_MASK		0xf000f
 
+/* one done/abort interrupt line per channel and direction */
+#define PCIE_DMA_CHN_IRQ_NUM		4
+
+/*
+ * Per channel linked list memory. The last slot holds the link element
+ * pointing back to the start of the list.
+ */
+#define PCIE_EDMA_LL_SIZE		SZ_4K
+#define PCIE_EDMA_LL_MAX_ELEM		((PCIE_EDMA_LL_SIZE - sizeof(struct edma_ll_link)) / \
+					 sizeof(struct edma_ll_data))
+
 enum dma_dir {
 	PCIE_DMA_WRITE = 0,
 	PCIE_DMA_READ,
@@ -225,6 +247,65 @@ struct ctx_regs {
 	u32				darptrhi;
 };
 
+/*
+ * Linked list elements, fetched by the channel from local memory when
+ * chan_ctrl_lo.llen is set. The control word uses the cb/tcb/llp/lie/rie
+ * bits of union chan_ctrl_lo.
+ */
+struct edma_ll_data {
+	union chan_ctrl_lo		control;
+	u32				xfersize;
+	u32				sarptrlo;
+	u32				sarptrhi;
+	u32				darptrlo;
+	u32				darptrhi;
+} __packed;
+
+struct edma_ll_link {
+	union chan_ctrl_lo		control;
+	u32				rsvd;
+	u32				llptrlo;
+	u32				llptrhi;
+} __packed;
+
+struct sunxi_pcie_edma_burst {
+	u64				sar;
+	u64				dar;
+	u32				size;
+};
+
+struct sunxi_pcie_edma_desc {
+	struct virt_dma_desc		vd;
+	u32				nr_bursts;
+	/* first burst of the chunk currently in the linked list */
+	u32				start;
+	/* bursts in the chunk currently in the linked list */
+	u32				count;
+	/* cycle bit of the current chunk */
+	bool				cb;
+	size_t				residue;
+	struct sunxi_pcie_edma_burst	burst[];
+};
+
+struct sunxi_pcie_edma_chan {
+	struct virt_dma_chan		vc;
+	struct sunxi_pcie		*pci;
+	struct sunxi_pci_edma_chan	*hw;
+	enum dma_dir			dir;
+	u32				chnl;
+	struct dma_slave_config		config;
+	struct sunxi_pcie_edma_desc	*desc;
+	void				*ll_virt;
+	dma_addr_t			ll_phys;
+};
+
+struct sunxi_pcie_edma {
+	struct dma_device		dma;
+	struct sunxi_pcie		*pci;
+	u32				nr_chans;
+	struct sunxi_pcie_edma_chan	chan[];
+};
+
 struct dma_table {
 	u32				*descs;
 	int				chn;
@@ -275,5 +356,8 @@ int sunxi_pcie_dma_chan_release(struct sunxi_pci_edma_chan *edma_chan, enum dma_
 int sunxi_pcie_dma_mem_read(phys_addr_t sar_addr, phys_addr_t dar_addr, unsigned int size, void *chan);
 int sunxi_pcie_dma_mem_write(phys_addr_t sar_addr, phys_addr_t dar_addr, unsigned int size, void *chan);
 int sunxi_pcie_dma_get_chan(struct platform_device *pdev);
+int sunxi_pcie_edma_probe(struct sunxi_pcie *pci);
+void sunxi_pcie_edma_remove(struct sunxi_pcie *pci);
+bool sunxi_pcie_edma_handle_irq(struct sunxi_pcie *pci, u32 chnl, enum dma_dir dma_trx, bool abort);
 
 #endif
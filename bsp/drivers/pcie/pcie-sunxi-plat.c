@@ -38,7 +38,7 @@
 #include "pcie-sunxi-dma.h"
 #include "pcie-sunxi.h"
 
-#define SUNXI_PCIE_MODULE_VERSION	"1.1.2"
+#define SUNXI_PCIE_MODULE_VERSION	"1.2.0"
 
 void sunxi_pcie_writel(u32 val, struct sunxi_pcie *pcie, u32 offset)
 {
@@ -620,6 +620,9 @@ static void sunxi_pcie_plat_dma_handle_interrupt(struct sunxi_pcie *pci, u32 ch,
 	sunxi_pcie_edma_callback cb = NULL;
 	void *cb_data = NULL;
 
+	if (sunxi_pcie_edma_handle_irq(pci, ch, dma_trx, false))
+		return;
+
 	if (dma_trx == PCIE_DMA_WRITE) {
 		edma_chan = &pci->dma_wr_chn[ch];
 		cb = edma_chan->callback;
@@ -664,6 +667,7 @@ static irqreturn_t sunxi_pcie_##name##_irq_handler				\
 				(dir ? PCIE_DMA_RD_INT_CLEAR : PCIE_DMA_WR_INT_CLEAR), clr.dword);\
 		sunxi_err(pci->dev, "DMA %s channel %d is abort\n",				  \
 							dir ? "read":"write", chn);		  \
+		sunxi_pcie_edma_handle_irq(pci, chn, dir, true);				  \
 	}											  \
 												  \
 	return IRQ_HANDLED;									  \
@@ -904,11 +908,17 @@ static int sunxi_pcie_plat_dma_init(struct sunxi_pcie *pci)
 
 	sunxi_pcie_writel_dbi(pci, PCIE_DMA_OFFSET + PCIE_DMA_WR_INT_MASK, 0x0);
 	sunxi_pcie_writel_dbi(pci, PCIE_DMA_OFFSET + PCIE_DMA_RD_INT_MASK, 0x0);
+
+	/* not fatal, sunxi_pcie_dma_mem_read/write() still work without it */
+	if (sunxi_pcie_edma_probe(pci))
+		sunxi_warn(pci->dev, "edma dmaengine device not available\n");
+
 	return 0;
 }
 
 static void sunxi_pcie_plat_dma_deinit(struct sunxi_pcie *pci)
 {
+	sunxi_pcie_edma_remove(pci);
 	sunxi_pcie_dma_obj_remove(pci->dev);
 
 	sunxi_pcie_writel_dbi(pci, PCIE_DMA_OFFSET + PCIE_DMA_WR_INT_MASK, PCIE_DMA_INT_MASK);
@@ -343,6 +343,7 @@ struct sunxi_pcie {
 	unsigned long		*wr_edma_map;
 	struct sunxi_pci_edma_chan	*dma_wr_chn;
 	struct sunxi_pci_edma_chan	*dma_rd_chn;
+	struct sunxi_pcie_edma	*edma;
 	struct regulator	*pcie1v8;
 	struct regulator	*pcie3v3;
 };
@@ -19,10 +19,17 @@
 #include <linux/random.h>
 #include <linux/irq.h>
 #include <linux/crc32.h>
+#include <linux/ctype.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
 
 #include "redeposit.h"
 static struct redeposit_info *info;
 
+/*relearn the hot set on the next boot when less than this ratio is hit*/
+#define RDPST_RELEARN_PCT	50
+#define RDPST_RELEARN_MIN	64
+
 static inline void *redeposit_get_data(struct redeposit_info *info, u32 index)
 {
 	return &(info->data_buf[index]);
@@ -71,6 +78,22 @@ static struct page *redeposit_get_page(struct redeposit_info *info, u32 index)
 	return page;
 }
 
+static inline u32 redeposit_nr_map_pages(struct redeposit_info *info)
+{
+	return (sizeof(struct redeposit_head) + sizeof(struct redeposit_map) * info->map_index + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+/*page @index of the flash image: head+map pages first, then the data pages*/
+static struct page *redeposit_image_page(struct redeposit_info *info, u32 index, u32 nr_map_page)
+{
+	u32 nr_map_off = info->head->map_size / PAGE_SIZE;
+
+	if (index >= nr_map_page)
+		index += nr_map_off - nr_map_page;
+
+	return redeposit_get_page(info, index);
+}
+
 static void redeposit_build_data(struct redeposit_info *info)
 {
 	struct redeposit_data *data;
@@ -93,6 +116,7 @@ static void redeposit_build_data(struct redeposit_info *info)
 			data->bv_len = RDPST_SECT_SIZE;
 			data->bv_offset = j * RDPST_SECT_SIZE;
 			data->status = 0;
+			data->map_idx = 0;
 		}
 	}
 }
@@ -110,6 +134,20 @@ static bool is_redeposit_addr(struct redeposit_info *info, sector_t sect, sector
 	return is_ro;
 }
 
+/*any overlap with a recorded partition, used by the write path*/
+static bool is_redeposit_range(struct redeposit_info *info, sector_t sect, sector_t blocks)
+{
+	struct redeposit_head *head = (struct redeposit_head *)redeposit_get_head(info);
+	int i;
+
+	for (i = 0; i < head->ro_part_num; i++) {
+		if (sect < head->ropart[i].end && head->ropart[i].start < sect + blocks)
+			return true;
+	}
+
+	return false;
+}
+
 static inline sector_t daddr_remap(struct redeposit_info *data, u32 index)
 {
 	return index << 3;
@@ -207,6 +245,20 @@ static u32 redeposit_data_crc(struct redeposit_info *info)
 	return crc;
 }
 
+static u32 redeposit_extent_crc(struct redeposit_info *info, u32 index, u32 num_sec)
+{
+	struct redeposit_data *data;
+	u32 crc = REDEPOSIT_MAGIC;
+	u32 i;
+
+	for (i = 0; i < num_sec; i++) {
+		data = redeposit_get_data(info, index + i);
+		crc = crc32(crc, (u8 *)page_to_virt(data->bv_page) + data->bv_offset, data->bv_len);
+	}
+
+	return crc;
+}
+
 static u32 redeposit_crc(struct redeposit_info *info, enum redeposit_crc crc_type)
 {
 	u32 crc;
@@ -225,6 +277,9 @@ static void redeposit_release_info(struct redeposit_info *info)
 {
 	u32 nr_bios, nr_page, i;
 
+	if (info->status == STATUS_RELEASE)
+		return;
+
 	nr_bios = (info->mem_size / PAGE_SIZE + BIO_MAX_PAGES - 1) / BIO_MAX_PAGES;
 
 	for (i = 0; i < nr_bios ; i++) {
@@ -235,6 +290,7 @@ static void redeposit_release_info(struct redeposit_info *info)
 		}
 		break;
 	}
+	xa_destroy(&info->i_xarr);
 	vfree(info->data_buf);
 	sg_free_table(&info->sgtable);
 	kfree(info->pages);
@@ -292,10 +348,40 @@ get_dev_failed:
 	return false;
 }
 
+static struct block_device *redeposit_get_disk(struct redeposit_info *info)
+{
+	struct block_device *part, *disk;
+
+	if (!info->ro_part_num)
+		return ERR_PTR(-ENODEV);
+
+	part = blkdev_get_by_path(info->ro_path[0], 0, info);
+	if (IS_ERR(part))
+		return part;
+
+	disk = blkdev_get_by_dev(disk_devt(part->bd_disk), FMODE_READ | FMODE_WRITE, info);
+	blkdev_put(part, 0);
+
+	return disk;
+}
+
+/*fill the head of a recorded image and checksum it*/
+static void redeposit_seal_head(struct redeposit_info *info, enum head_status status)
+{
+	info->head->data_num = info->data_index;
+	info->head->map_num = info->map_index;
+	info->head->status = status;
+	info->head->magic = REDEPOSIT_MAGIC;
+	info->head->ver = REDEPOSIT_VERSION;
+	info->head->map_crc = redeposit_crc(info, CRC_MAP);
+	info->head->data_crc = redeposit_crc(info, CRC_DATA);
+	info->head->head_crc = redeposit_crc(info, CRC_HEAD);
+}
+
 static void redeposit_flush_data(struct redeposit_info *info, enum head_status status)
 {
 	struct page *page;
-	int nr_pages, all_pages, nr_map_page, nr_map_off, nr_page_off;
+	int nr_pages, all_pages, nr_map_page, nr_page_off;
 	int nr_bios;
 	int i, j, k, err;
 	u32 head_crc, map_crc, data_crc, tmp_head_crc, tmp_map_crc, tmp_data_crc;
@@ -317,17 +403,13 @@ static void redeposit_flush_data(struct redeposit_info *info, enum head_status s
 	/*fill the head of redeposit_info*/
 	info->head->data_addr = get_start_sect(info->b_bdev) + (sizeof(struct redeposit_head) +
 			sizeof(struct redeposit_map) * info->map_index + PAGE_SIZE - 1) / PAGE_SIZE;
-	info->head->data_num = info->data_index;
-	info->head->map_num = info->map_index;
-	info->head->status = H_STATUS_HANDLE;
-	info->head->magic = REDEPOSIT_MAGIC;
-	map_crc = info->head->map_crc = redeposit_crc(info, CRC_MAP);
-	data_crc = info->head->data_crc = redeposit_crc(info, CRC_DATA);
-	head_crc = info->head->head_crc = redeposit_crc(info, CRC_HEAD);
-	nr_map_off = info->head->map_size / PAGE_SIZE;
-	nr_map_page = (sizeof(struct redeposit_head) + sizeof(struct redeposit_map) * info->map_index + PAGE_SIZE - 1) / PAGE_SIZE;
+	redeposit_seal_head(info, H_STATUS_HANDLE);
+	map_crc = info->head->map_crc;
+	data_crc = info->head->data_crc;
+	head_crc = info->head->head_crc;
+	nr_map_page = redeposit_nr_map_pages(info);
 
-	all_pages = (sizeof(struct redeposit_head) + sizeof(struct redeposit_map) * info->map_index + PAGE_SIZE - 1) / PAGE_SIZE + SECT_TO_PAGE(info->data_index + PAGE_TO_SECT(1) - 1);
+	all_pages = nr_map_page + SECT_TO_PAGE(info->data_index + PAGE_TO_SECT(1) - 1);
 
 	nr_bios = (all_pages + BIO_MAX_PAGES -1) / BIO_MAX_PAGES;
 
@@ -352,8 +434,7 @@ static void redeposit_flush_data(struct redeposit_info *info, enum head_status s
 		bio_set_op_attrs(bio, REQ_OP_WRITE, REQ_SYNC);
 		for (j = 0; j < nr_pages; j++) {
 			nr_page_off = i * BIO_MAX_PAGES + j;
-			nr_page_off = ((nr_page_off >= nr_map_page) ? (nr_page_off + nr_map_off - nr_map_page) : nr_page_off);
-			page = redeposit_get_page(info, nr_page_off);
+			page = redeposit_image_page(info, nr_page_off, nr_map_page);
 			dev_dbg(&info->pdev->dev, "F:i:%ld, j:%ld, nr_pages:%ld, page:%px, blk_addr:%ld\n", i, j, nr_pages, page, blk_addr);
 			bio_add_page(bio, page, PAGE_SIZE, 0);
 		}
@@ -411,6 +492,11 @@ static void redeposit_flush_data(struct redeposit_info *info, enum head_status s
 		map = redeposit_get_map(info, i);
 		all_pages = SECT_TO_PAGE((map->num_sec + PAGE_TO_SECT(1) - 1));
 		nr_bios = (all_pages + BIO_MAX_PAGES -1) / BIO_MAX_PAGES;
+		/*written after it was recorded, keep the copy just read back*/
+		if (map->flags & RDPST_MAP_INVALID) {
+			data_sec_num += PAGE_TO_SECT(all_pages);
+			continue;
+		}
 		for (k = 0; k < nr_bios; k++) {
 			nr_pages = ((k == (nr_bios - 1)) ? ((all_pages - 1) % BIO_MAX_PAGES + 1) : BIO_MAX_PAGES);
 
@@ -481,11 +567,63 @@ build_part_err:
 	return;
 }
 
+/*
+ * Replay boot: the data is unchanged, write back only head+map so the hits
+ * of this boot and the extents invalidated by writes survive to the next one.
+ */
+static void redeposit_flush_map(struct redeposit_info *info, enum head_status status)
+{
+	struct block_device *bdev;
+	struct bio *bio;
+	u32 i, nr_map_page;
+	int err;
+
+	/*no more prefetch into the pages written below*/
+	info->aread = 0;
+	cancel_delayed_work_sync(&info->redeposit_cache_work);
+
+	bdev = redeposit_get_disk(info);
+	if (IS_ERR(bdev)) {
+		dev_err(&info->pdev->dev, "get disk failed:%ld, map not updated\n", PTR_ERR(bdev));
+		goto get_disk_failed;
+	}
+
+	nr_map_page = redeposit_nr_map_pages(info);
+	info->head->status = status;
+	info->head->map_crc = redeposit_crc(info, CRC_MAP);
+	info->head->head_crc = redeposit_crc(info, CRC_HEAD);
+
+	bio = bio_alloc(GFP_KERNEL, nr_map_page);
+	if (bio == NULL) {
+		dev_err(&info->pdev->dev, "alloc bio failed, map not updated\n");
+		goto alloc_bio_failed;
+	}
+	bio_set_dev(bio, bdev);
+	bio->bi_iter.bi_sector = info->re_part.start;
+	bio->bi_end_io = end_redeposit_bio_write;
+	bio->bi_private = info;
+	bio_set_op_attrs(bio, REQ_OP_WRITE, REQ_SYNC);
+	for (i = 0; i < nr_map_page; i++)
+		bio_add_page(bio, redeposit_get_page(info, i), PAGE_SIZE, 0);
+
+	err = submit_bio_wait(bio);
+	bio_put(bio);
+	dev_info(&info->pdev->dev, "update map:%ld, pages:%ld, status:%ld\n", err, nr_map_page, status);
+
+alloc_bio_failed:
+	blkdev_put(bdev, FMODE_READ | FMODE_WRITE);
+get_disk_failed:
+	redeposit_release_info(info);
+}
+
 static void redeposit_flush_handle(struct work_struct *work)
 {
 	struct redeposit_info *info = container_of(work, struct redeposit_info, redeposit_flush_work.work);
 
-	redeposit_flush_data(info, info->hstatus);
+	if (info->flush_map)
+		redeposit_flush_map(info, info->hstatus);
+	else
+		redeposit_flush_data(info, info->hstatus);
 }
 
 static struct redeposit_data  *redeposit_find_get_data(struct xarray *i_xarr, pgoff_t offset)
@@ -500,11 +638,10 @@ repeat:
 	if (xas_retry(&xas, data))
 		goto repeat;
 
-	if (!data || xa_is_value(data))
-		goto out;
-
+	/*value entries are stale marks left by writes*/
+	if (xa_is_value(data))
+		data = NULL;
 
-out:
 	rcu_read_unlock();
 
 	return data;
@@ -512,20 +649,28 @@ out:
 }
 static int redeposit_add_data_to_cache(struct redeposit_data *data, struct xarray *i_xarr, pgoff_t offset)
 {
-	void *old;
+	struct redeposit_data *old;
+	unsigned long flags;
 	XA_STATE(xas, i_xarr, offset);
 
 	do {
-		xas_lock_irq(&xas);
+		xas_lock_irqsave(&xas, flags);
 		old = xas_load(&xas);
-		if (old && !xa_is_value(old))
+		/*the sector was written before its copy arrived*/
+		if (xa_is_value(old))
+			xas_set_err(&xas, -ESTALE);
+		/*
+		 * a copy already verified is kept and the later one refused,
+		 * only an entry that is not (yet) valid gets replaced
+		 */
+		else if (old && DataUpdate(old))
 			xas_set_err(&xas, -EEXIST);
 		xas_store(&xas, data);
 		if (xas_error(&xas))
 			goto unlock;
 
 unlock:
-		xas_unlock_irq(&xas);
+		xas_unlock_irqrestore(&xas, flags);
 
 	} while (xas_nomem(&xas, (__GFP_NOFAIL | __GFP_NORETRY | GFP_NOFS)));
 
@@ -538,12 +683,31 @@ error:
 	return xas_error(&xas);
 }
 
+/*
+ * Store @entry at @offset whatever was there: the newest recorded copy of a
+ * sector or a stale mark. Called from the request path, so never sleeps.
+ */
+static void redeposit_track_data(void *entry, struct xarray *i_xarr, pgoff_t offset)
+{
+	unsigned long flags;
+	XA_STATE(xas, i_xarr, offset);
+
+	do {
+		xas_lock_irqsave(&xas, flags);
+		xas_store(&xas, entry);
+		xas_unlock_irqrestore(&xas, flags);
+	} while (xas_nomem(&xas, GFP_ATOMIC | __GFP_NOWARN));
+}
+
 /*record start blk, data,write to cache,write back when init ok*/
 bool redeposit_write_data(struct redeposit_info *info, struct scatterlist *sg, unsigned int sg_len, unsigned int blk_addr, unsigned int blocks)
 {
 	struct redeposit_map *map;
+	struct redeposit_data *data;
 	u8 *sg_buf = NULL;
 	unsigned int sg_buf_len = 0;
+	unsigned long flags;
+	u32 crc = REDEPOSIT_MAGIC;
 	int i = 0;
 
 	if (!info || !is_handle_write(info) || !info->build_done) {
@@ -553,14 +717,35 @@ bool redeposit_write_data(struct redeposit_info *info, struct scatterlist *sg, u
 	if (!info->build_done)
 		pr_debug("redeposit:%ld--%ld", blk_addr, blocks);
 
-	if (!is_redeposit_nrblk(info, blocks) || !is_redeposit_addr(info, blk_addr, blocks) || is_over_cap(info, blocks)) {
+	if (!is_redeposit_nrblk(info, blocks) || !is_redeposit_addr(info, blk_addr, blocks)) {
 		return false;
 	}
+
+	spin_lock_irqsave(&info->lock, flags);
+	/*the same extent read again: count it instead of storing it twice*/
+	data = redeposit_find_get_data(&info->i_xarr, blk_addr);
+	if (data) {
+		map = redeposit_get_map(info, data->map_idx);
+		if (map->log_start_sec == blk_addr && map->num_sec == blocks &&
+		    !(map->flags & RDPST_MAP_INVALID)) {
+			map->hits++;
+			spin_unlock_irqrestore(&info->lock, flags);
+			return true;
+		}
+	}
+
+	if (is_over_cap(info, blocks)) {
+		spin_unlock_irqrestore(&info->lock, flags);
+		return false;
+	}
+
 	map = redeposit_get_map(info, info->map_index);
 	info->map_index++;
 	map->log_start_sec = blk_addr;
 	map->phy_start_sec = info->data_index;
 	map->num_sec = blocks;
+	map->hits = 1;
+	map->flags = 0;
 
 	for (i = 0; i < sg_len; i++) {
 		sg_buf = sg_virt(&sg[i]);
@@ -568,7 +753,17 @@ bool redeposit_write_data(struct redeposit_info *info, struct scatterlist *sg, u
 		dev_dbg(&info->pdev->dev, "W:dindex:%ld, mindex:%ld, num_sec:%ld, sg_buf:%px\n",
 			info->data_index, info->map_index, map->num_sec, sg_buf);
 		redeposit_set_data(info, info->data_index, sg_buf, sg_buf_len);
+		crc = crc32(crc, sg_buf, sg_buf_len);
 	}
+	map->crc = crc;
+
+	for (i = 0; i < blocks; i++) {
+		data = redeposit_get_data(info, map->phy_start_sec + i);
+		data->map_idx = info->map_index - 1;
+		redeposit_track_data(data, &info->i_xarr, blk_addr + i);
+	}
+	spin_unlock_irqrestore(&info->lock, flags);
+
 	dev_dbg(&info->pdev->dev, "W:dindex:%ld, mindex:%ld, num_sec:%ld, psSec:%ld, blocks:%ld\n",
 		info->data_index, info->map_index, map->num_sec, map->phy_start_sec, blocks);
 
@@ -576,6 +771,103 @@ bool redeposit_write_data(struct redeposit_info *info, struct scatterlist *sg, u
 }
 EXPORT_SYMBOL_GPL(redeposit_write_data);
 
+/*
+ * A write to @blk_addr: drop every cached copy of the range and mark the
+ * extents holding them invalid so they are neither served nor persisted.
+ * Sectors not loaded yet get a stale mark that stops their copy when it
+ * arrives from flash.
+ */
+void redeposit_invalidate(struct redeposit_info *info, unsigned int blk_addr, unsigned int blocks)
+{
+	struct redeposit_data *data;
+	struct redeposit_map *map;
+	unsigned long flags;
+	unsigned int i;
+
+	if (!info || !(is_handle_read(info) || (is_handle_write(info) && info->build_done)))
+		return;
+
+	if (!is_redeposit_range(info, blk_addr, blocks))
+		return;
+
+	spin_lock_irqsave(&info->lock, flags);
+	for (i = blk_addr; i < blk_addr + blocks; i++) {
+		data = redeposit_find_get_data(&info->i_xarr, i);
+		if (data) {
+			ClearDataUpdate(data);
+			map = redeposit_get_map(info, data->map_idx);
+			map->flags |= RDPST_MAP_INVALID;
+		} else if (is_handle_write(info) || info->cache_done) {
+			continue;
+		}
+		redeposit_track_data(xa_mk_value(0), &info->i_xarr, i);
+		info->iostat.nr_stale++;
+	}
+	spin_unlock_irqrestore(&info->lock, flags);
+}
+EXPORT_SYMBOL_GPL(redeposit_invalidate);
+
+/*the extent just loaded is only served once its crc matches the recorded one*/
+static void redeposit_check_extent(struct redeposit_info *info, struct redeposit_map *map)
+{
+	struct redeposit_data *data;
+	unsigned long flags;
+	u32 crc, i;
+
+	crc = redeposit_extent_crc(info, info->cache_ext_start, map->num_sec);
+
+	spin_lock_irqsave(&info->lock, flags);
+	if (crc != map->crc) {
+		map->flags |= RDPST_MAP_INVALID;
+		info->iostat.nr_crc_err++;
+		dev_err(&info->pdev->dev, "extent:%ld+%ld crc (orgin:%lu != cal:%lu)\n",
+			map->log_start_sec, map->num_sec, map->crc, crc);
+	}
+
+	if (!(map->flags & RDPST_MAP_INVALID)) {
+		for (i = 0; i < map->num_sec; i++) {
+			data = redeposit_get_data(info, info->cache_ext_start + i);
+			SetDataUpdate(data);
+		}
+	}
+	spin_unlock_irqrestore(&info->lock, flags);
+}
+
+/*attach one sector read back from flash to the extent being rebuilt*/
+static void redeposit_load_sect(struct redeposit_info *info, struct page *page, u32 offset)
+{
+	struct redeposit_data *data;
+	struct redeposit_map *map;
+	int ret;
+
+	data = redeposit_get_data(info, info->data_index++);
+	data->bv_page = page;
+	data->bv_len = RDPST_SECT_SIZE;
+	data->bv_offset = offset;
+	data->status = 0;
+
+	/*padding behind the last extent*/
+	if (info->cache_map_index >= info->map_index)
+		return;
+
+	map = redeposit_get_map(info, info->cache_map_index);
+	data->map_idx = info->cache_map_index;
+	if (!info->cache_map_off)
+		info->cache_ext_start = info->data_index - 1;
+
+	if (!(map->flags & RDPST_MAP_INVALID)) {
+		ret = redeposit_add_data_to_cache(data, &info->i_xarr, map->log_start_sec + info->cache_map_off);
+		if (ret == -ESTALE)
+			map->flags |= RDPST_MAP_INVALID;
+	}
+
+	info->cache_map_off++;
+	if (info->cache_map_off >= map->num_sec) {
+		redeposit_check_extent(info, map);
+		info->cache_map_index++;
+		info->cache_map_off = 0;
+	}
+}
 
 void end_redeposit_bio_map(struct bio *bio)
 {
@@ -584,11 +876,10 @@ void end_redeposit_bio_map(struct bio *bio)
 	struct redeposit_map *map;
 	struct page *page;
 	pgoff_t index, end_index, j, page_index;
-	u32 nr_map_pages, nr_update_page = 0;
+	u32 nr_map_pages, nr_update_page = 0, crc;
 	struct bio_vec *bv;
 	struct bvec_iter_all iter_all;
 	int i, k = 0;
-	struct redeposit_data *data;
 
 	info->iostat.start_map = ktime_get();
 	if (bio->bi_status) {
@@ -614,6 +905,20 @@ void end_redeposit_bio_map(struct bio *bio)
 
 	dev_info(&info->pdev->dev, "%s--%d map_index:%ld, nr_map_pages:%ld, map_size:%ld!!\n", __func__, __LINE__, info->map_index, nr_map_pages, info->head->map_size);
 
+	crc = redeposit_crc(info, CRC_MAP);
+	if (crc != head->map_crc) {
+		dev_err(&info->pdev->dev, "map crc (orgin:%lu != cal:%lu)\n", head->map_crc, crc);
+		info->status = STATUS_ERROR;
+		set_handle(info, FLAG_NONE);
+		goto end_bio;
+	}
+
+	/*age the hits of the previous boots, this boot adds its own*/
+	for (i = 0; i < info->map_index; i++) {
+		map = redeposit_get_map(info, i);
+		map->hits >>= 1;
+	}
+
 	/*caculate the num of uptodated page*/
 	nr_update_page = REDEPOSIT_MAP_MAX_SIZE / PAGE_SIZE - nr_map_pages;
 	page_index = nr_map_pages;
@@ -638,17 +943,9 @@ void end_redeposit_bio_map(struct bio *bio)
 					goto end_bio;
 			}
 			dev_dbg(&info->pdev->dev, "%s:i:%ld, j:%ld, page:%px\n", __func__, i, j, page);
-			data = redeposit_get_data(info, info->data_index++);
-			data->bv_page = page;
-			data->bv_len = RDPST_SECT_SIZE;
-			data->bv_offset = k * RDPST_SECT_SIZE;
-			SetDataUpdate(data);
-			redeposit_add_data_to_cache(data, &info->i_xarr, j);
+			redeposit_load_sect(info, page, k * RDPST_SECT_SIZE);
 			k = (k + 1) % PAGE_TO_SECT(1);
-			info->cache_map_off++;
 		}
-		info->cache_map_off = 0;
-		info->cache_map_index++;
 	}
 
 end_bio:
@@ -664,9 +961,7 @@ static void end_redeposit_bio_data(struct bio *bio)
 	struct page *page;
 	struct bio_vec *bv;
 	struct bvec_iter_all iter_all;
-	struct redeposit_data *data;
 	int k, index, off;
-	struct redeposit_map *map;
 
 	info->iostat.start_data = ktime_get();
 	if (bio->bi_status) {
@@ -689,21 +984,8 @@ static void end_redeposit_bio_data(struct bio *bio)
 			ClearPageError(page);
 			BUG_ON(1);
 		} else {
-			for (k = off; k < PAGE_TO_SECT(1); k++) {
-				map = redeposit_get_map(info, info->cache_map_index);
-				data = redeposit_get_data(info, info->data_index++);
-				data->bv_page = page;
-				data->bv_len = RDPST_SECT_SIZE;
-				data->bv_offset = k * RDPST_SECT_SIZE;
-				SetDataUpdate(data);
-				redeposit_add_data_to_cache(data, &info->i_xarr, map->log_start_sec + info->cache_map_off);
-				dev_dbg(&info->pdev->dev, "%s:cache_index:%ld\n", __func__, (map->log_start_sec + info->cache_map_off));
-				info->cache_map_off++;
-				if (info->cache_map_off >= map->num_sec) {
-					info->cache_map_index++;
-					info->cache_map_off = 0;
-				}
-			}
+			for (k = off; k < PAGE_TO_SECT(1); k++)
+				redeposit_load_sect(info, page, k * RDPST_SECT_SIZE);
 			SetPageUptodate(page);
 		}
 	}
@@ -733,11 +1015,13 @@ void end_redeposit_get_handle(struct bio *bio)
 	dev_info(&info->pdev->dev, "head status:%ld\n", head->status);
 	if (head->status == H_STATUS_FINISH) {
 		crc = redeposit_crc(info, CRC_HEAD);
-		if (crc == info->head->head_crc && info->head->magic == REDEPOSIT_MAGIC) {
+		if (crc == info->head->head_crc && info->head->magic == REDEPOSIT_MAGIC &&
+		    info->head->ver == REDEPOSIT_VERSION) {
 			set_handle(info, FLAG_READ);
 		} else {
 			set_handle(info, FLAG_WRITE);
-			dev_err(&info->pdev->dev, "head crc (orgin:%lu != cal:%lu)\n", crc, info->head->head_crc);
+			dev_err(&info->pdev->dev, "head crc (orgin:%lu != cal:%lu), ver:%ld\n",
+				crc, info->head->head_crc, info->head->ver);
 		}
 	} else if (head->status == H_STATUS_WAIT_NEXT) {
 		set_handle(info, FLAG_WRITE);
@@ -854,6 +1138,7 @@ static bool redeposit_reads_flash(struct redeposit_info *info, u32 addr, u32 nr_
 	u32 i, nr_pages;
 	u32 blk_addr;
 	int ret = true;
+	ktime_t start = ktime_get();
 
 	all_pages = (nr_byte + PAGE_SIZE - 1) / PAGE_SIZE;
 	nr_bios = (all_pages + BIO_MAX_PAGES - 1) / BIO_MAX_PAGES;
@@ -867,10 +1152,13 @@ static bool redeposit_reads_flash(struct redeposit_info *info, u32 addr, u32 nr_
 		if (unlikely((!ret || info->status == STATUS_ERROR))) {
 			info->status = STATUS_ERROR;
 			set_handle(info, FLAG_NONE);
-			break;
+			return false;
 		}
 	}
 
+	info->iostat.time_prefetch += ktime_sub(ktime_get(), start);
+	info->iostat.prefetch_bytes += nr_byte;
+
 	return ret;
 }
 
@@ -893,9 +1181,11 @@ static void redeposit_cache_handle(struct work_struct *work)
 	int odd, ret;
 
 	head = info->head;
-	nr_map_pages = (sizeof(struct redeposit_head) + sizeof(struct redeposit_map) * info->map_index + PAGE_SIZE - 1) / PAGE_SIZE;
-	//??
+	nr_map_pages = redeposit_nr_map_pages(info);
 	all_pages = nr_map_pages + SECT_TO_PAGE(head->data_num + PAGE_TO_SECT(1) - 1);
+	if (PAGE_TO_SECT(all_pages) <= info->off_pos)
+		goto cache_done;
+
 	if (PAGE_TO_SECT(all_pages) - info->off_pos < info->nr_rd2 * NR_MAX_HIT) {
 		odd = (PAGE_TO_SECT(all_pages) - info->off_pos) * RDPST_SECT_SIZE;
 	} else {
@@ -904,10 +1194,29 @@ static void redeposit_cache_handle(struct work_struct *work)
 	}
 	dev_info(&info->pdev->dev, "odd:%ld, pos:%ld, max:%ld, all:%ld, rd2:%ld\n", odd, info->off_pos, NR_MAX_HIT, all_pages, info->nr_rd2);
 	ret = redeposit_reads_flash(info, info->off_pos, odd, end_redeposit_bio_data);
-	if (likely(ret)) {
-		info->off_pos += odd / RDPST_SECT_SIZE;
+	if (unlikely(!ret)) {
 		info->do_cache = 0;
+		wake_up(&info->wait);
+		return;
+	}
+
+	info->off_pos += odd / RDPST_SECT_SIZE;
+	/*keep streaming the image in nr_rd2 sized sequential reads*/
+	if (PAGE_TO_SECT(all_pages) > info->off_pos) {
+		if (info->aread && is_handle_read(info)) {
+			queue_delayed_work(system_wq, &info->redeposit_cache_work, 0);
+			return;
+		}
+		info->do_cache = 0;
+		return;
 	}
+
+cache_done:
+	info->cache_done = 1;
+	info->do_cache = 0;
+	wake_up(&info->wait);
+	dev_info(&info->pdev->dev, "prefetch done:%llu bytes in %lld us\n",
+		 info->iostat.prefetch_bytes, ktime_to_us(info->iostat.time_prefetch));
 }
 
 static bool redeposit_build_cache_from_flash(struct redeposit_info *info)
@@ -940,13 +1249,14 @@ static bool redeposit_build_cache_from_flash(struct redeposit_info *info)
 	dev_dbg(&info->pdev->dev, "%s--%d finish redeposit map build!!\n", __func__, __LINE__);
 	/*assume Read back head correctly*/
 	head = info->head;
-	nr_map_pages = (sizeof(struct redeposit_head) + sizeof(struct redeposit_map) * info->map_index + PAGE_SIZE - 1) / PAGE_SIZE;
+	nr_map_pages = redeposit_nr_map_pages(info);
 	all_pages = nr_map_pages + SECT_TO_PAGE(head->data_num + PAGE_TO_SECT(1) - 1);
 
 	/*This can be considered abnormal in normal use*/
 	if (all_pages * PAGE_SIZE <= REDEPOSIT_MAP_MAX_SIZE) {
 		dev_info(&info->pdev->dev, "%s-%d-B:%ld, %ld, %ld!!\n", __func__, __LINE__,
 			 nr_map_pages, all_pages, REDEPOSIT_MAP_MAX_SIZE);
+		info->cache_done = 1;
 		goto build_cache;
 	}
 
@@ -962,6 +1272,15 @@ static bool redeposit_build_cache_from_flash(struct redeposit_info *info)
 
 	info->cache_init = 1;
 
+	/*
+	 * The rest of the image is streamed in right away instead of waiting
+	 * for the first hits, boot IO keeps going to flash on a miss meanwhile.
+	 */
+	if (info->aread && !info->do_cache) {
+		info->do_cache = 1;
+		queue_delayed_work(system_wq, &info->redeposit_cache_work, 0);
+	}
+
 build_cache:
 	dev_dbg(&info->pdev->dev, "%s--%d finish redeposit data build!!\n", __func__, __LINE__);
 
@@ -978,6 +1297,7 @@ bool redeposit_read_data(struct redeposit_info *info, struct scatterlist *sg, un
 	unsigned char *data_buf = NULL, *buf = NULL;
 	unsigned int i, j, sg_buf_len, data_buf_len;
 	struct redeposit_data *data;
+	struct redeposit_map *map;
 	int nr_map_pages, all_pages;
 	struct redeposit_head *head;
 
@@ -1033,9 +1353,15 @@ next_sg:
 
 		}
 		info->cache_hit += nr_blk;
+		info->iostat.nr_hit_req++;
+		data = redeposit_find_get_data(&info->i_xarr, blk_addr);
+		if (data) {
+			map = redeposit_get_map(info, data->map_idx);
+			map->hits++;
+		}
 
 		if (info->cache_init) {
-			nr_map_pages = (sizeof(struct redeposit_head) + sizeof(struct redeposit_map) * info->map_index + PAGE_SIZE - 1) / PAGE_SIZE;
+			nr_map_pages = redeposit_nr_map_pages(info);
 			all_pages = nr_map_pages + SECT_TO_PAGE(head->data_num + PAGE_TO_SECT(1) - 1);
 			if (info->aread && (SECT_TO_PAGE(info->off_pos) < all_pages) && !info->do_cache) {
 				info->do_cache = 1;
@@ -1044,6 +1370,9 @@ next_sg:
 		}
 
 		info->iostat.time_hit += ktime_sub(ktime_get(), info->iostat.start_hit);
+	} else {
+		info->iostat.nr_miss_req++;
+		info->iostat.nr_miss += blocks;
 	}
 
 	if (likely(is_handle_read(info)))
@@ -1056,6 +1385,55 @@ next_sg:
 }
 EXPORT_SYMBOL_GPL(redeposit_read_data);
 
+static bool redeposit_need_relearn(struct redeposit_info *info)
+{
+	u64 hit = info->cache_hit, miss = info->iostat.nr_miss;
+
+	if (hit + miss < RDPST_RELEARN_MIN)
+		return false;
+
+	return (hit * 100 < (hit + miss) * RDPST_RELEARN_PCT);
+}
+
+/*
+ * Rough boot time saved by the hits: the flash time the hit sectors would
+ * have cost at the prefetch throughput, minus the time spent copying them.
+ * Small random reads are slower than the sequential prefetch, so this is a
+ * lower bound.
+ */
+static s64 redeposit_saved_us(struct redeposit_info *info)
+{
+	u64 ns;
+
+	if (!info->iostat.prefetch_bytes)
+		return 0;
+
+	ns = div64_u64((u64)info->cache_hit * RDPST_SECT_SIZE * ktime_to_ns(info->iostat.time_prefetch),
+		       info->iostat.prefetch_bytes);
+
+	return div_s64((s64)ns - ktime_to_ns(info->iostat.time_hit), NSEC_PER_USEC);
+}
+
+static ssize_t stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct redeposit_info *info = platform_get_drvdata(pdev);
+	u64 hit = info->cache_hit, miss = info->iostat.nr_miss;
+
+	return snprintf(buf, PAGE_SIZE,
+			"hit_req:%llu miss_req:%llu\n"
+			"hit_sect:%llu miss_sect:%llu ratio:%llu%%\n"
+			"crc_err:%u invalidated:%u\n"
+			"prefetch:%llu KB in %lld us\n"
+			"saved_est:%lld us\n",
+			info->iostat.nr_hit_req, info->iostat.nr_miss_req,
+			hit, miss, (hit + miss) ? div64_u64(hit * 100, hit + miss) : 0,
+			info->iostat.nr_crc_err, info->iostat.nr_stale,
+			info->iostat.prefetch_bytes >> 10, ktime_to_us(info->iostat.time_prefetch),
+			redeposit_saved_us(info));
+}
+
 static ssize_t handle_status_show(struct device *dev,
 				struct device_attribute *attr, char *buf)
 {
@@ -1084,7 +1462,12 @@ static ssize_t handle_status_store(struct device *dev,
 	}
 
 	if (is_handle_flush(info) && info->status != STATUS_ERROR) {
-		if (old_handle != FLAG_READ && info->status != STATUS_RELEASE) {
+		if (old_handle == FLAG_READ && info->status != STATUS_RELEASE) {
+			/*persist the hits, relearn if the image stopped matching the boot*/
+			info->hstatus = redeposit_need_relearn(info) ? H_STATUS_WAIT_NEXT : H_STATUS_FINISH;
+			info->flush_map = 1;
+			queue_delayed_work(system_wq, &info->redeposit_flush_work, 0);
+		} else if (old_handle != FLAG_READ && info->status != STATUS_RELEASE) {
 			info->hstatus = (old_handle == FLAG_WRITE) ? H_STATUS_FINISH : H_STATUS_WAIT_NEXT;
 			queue_delayed_work(system_wq, &info->redeposit_flush_work, 0);
 		}
@@ -1181,13 +1564,15 @@ static ssize_t debug_store(struct device *dev,
 		for (i = 0; i < info->map_index; i++) {
 			map = redeposit_get_map(info, i);
 			if (map->log_start_sec <= dmod && (dmod <= map->log_start_sec+map->num_sec)) {
-				dev_err(&info->pdev->dev, "addr:%ld, num:%ld, i:%ld\n", map->log_start_sec, map->num_sec, i);
+				dev_err(&info->pdev->dev, "addr:%ld, num:%ld, i:%ld, hits:%ld, flags:%lx\n",
+					map->log_start_sec, map->num_sec, i, map->hits, map->flags);
 			}
 		}
 	} else {
 		for (i = 0; i < info->map_index; i++) {
 			map = redeposit_get_map(info, i);
-			dev_err(&info->pdev->dev, "addr:%ld, num:%ld, i:%ld\n", map->log_start_sec, map->num_sec, i);
+			dev_err(&info->pdev->dev, "addr:%ld, num:%ld, i:%ld, hits:%ld, flags:%lx\n",
+				map->log_start_sec, map->num_sec, i, map->hits, map->flags);
 		}
 	}
 
@@ -1214,7 +1599,8 @@ static ssize_t record_part_store(struct device *dev,
 	const char *p = NULL;
 	char str[RDPST_MAX_PATH] = {'\0'};
 
-	if (!info || likely(is_handle_read(info))) {
+	/*also taken on a replay boot: the disk is needed to update the map*/
+	if (!info) {
 		return count;
 	}
 
@@ -1290,6 +1676,13 @@ static int redeposit_create_sys_fs(struct redeposit_info *info, struct platform_
 	info->record_part.attr.name = "record_part";
 	info->record_part.attr.mode = S_IRUGO | S_IWUSR;
 	ret = device_create_file(&pdev->dev, &info->record_part);
+
+	info->stats.show = stats_show;
+	info->stats.store = NULL;
+	sysfs_attr_init(&(info->stats.attr));
+	info->stats.attr.name = "stats";
+	info->stats.attr.mode = S_IRUGO;
+	ret = device_create_file(&pdev->dev, &info->stats);
 	return ret;
 }
 
@@ -1299,6 +1692,8 @@ static void mmc_remove_sys_fs(struct redeposit_info *info, struct platform_devic
 	device_remove_file(&pdev->dev, &info->bdev_status);
 	device_remove_file(&pdev->dev, &info->allow_read);
 	device_remove_file(&pdev->dev, &info->debug);
+	device_remove_file(&pdev->dev, &info->record_part);
+	device_remove_file(&pdev->dev, &info->stats);
 }
 
 static void redeposit_build_handle(struct work_struct *work)
@@ -1382,47 +1777,27 @@ static void redeposit_get_conf(struct redeposit_info *info, struct device_node *
 	info->mem_size = REDEPOSIT_MEM_SIZE(info->nr_mem);
 }
 
-static int redeposit_probe(struct platform_device *pdev)
+/*layout:/head/ + /map_buf/ + /data_buf/, all of info->mem_size*/
+static int redeposit_alloc_mem(struct redeposit_info *info)
 {
+	struct device *dev = &info->pdev->dev;
 	u32 nr_bios, nr_page, nr_data_buf;
-	struct device_node *np = NULL;
 	int i, ret;
 
-	np = pdev->dev.of_node;
-
-	dev_info(&pdev->dev, "%s\n", RDPST_DRIVER_VERSION);
-	BUG_ON((REDEPOSIT_MAP_MAX_SIZE % PAGE_SIZE));
-
-	info = kzalloc(sizeof(struct redeposit_info), GFP_KERNEL);
-	if (unlikely(!info)) {
-		dev_err(&pdev->dev, "redeposit alloc info failed\n");
-		goto alloc_info_failed;
-	}
-
-	info->aread = 1;
-	info->status_dev = DEV_WAIT_WAKE;
-	platform_set_drvdata(pdev, info);
-	info->pdev = pdev;
-	set_handle(info, FLAG_NONE);
-
-	redeposit_get_conf(info, np);
-
-	redeposit_set_part(info, np);
-
 	nr_bios = (info->mem_size / PAGE_SIZE + BIO_MAX_PAGES - 1) / BIO_MAX_PAGES;
-	info->pages = kmalloc(sizeof(struct page *) * nr_bios, GFP_KERNEL);
-	dev_info(&pdev->dev, "mem region nr_bios:%ld size:%d\n", nr_bios, nr_bios * sizeof(struct page *));
+	info->pages = kcalloc(nr_bios, sizeof(struct page *), GFP_KERNEL);
+	dev_info(dev, "mem region nr_bios:%ld size:%d\n", nr_bios, nr_bios * sizeof(struct page *));
 	if (unlikely(!info->pages)) {
-		dev_err(&pdev->dev, "can not kmalloc mem region nr_bios:%ld size:%d\n",
+		dev_err(dev, "can not kmalloc mem region nr_bios:%ld size:%d\n",
 			nr_bios, nr_bios * sizeof(struct page *));
-		goto free_info;
+		goto alloc_pages_failed;
 	}
 
 	BUG_ON((info->mem_size - REDEPOSIT_MAP_MAX_SIZE) % PAGE_SIZE);
 	nr_data_buf = (info->mem_size - REDEPOSIT_MAP_MAX_SIZE) / RDPST_SECT_SIZE;
 	info->data_buf = vmalloc(sizeof(struct redeposit_data) * nr_data_buf);
 	if (unlikely(!info->data_buf)) {
-		dev_err(&pdev->dev, "can not kmalloc mem region nr_data_buf:%ld size:%d\n",
+		dev_err(dev, "can not kmalloc mem region nr_data_buf:%ld size:%d\n",
 			nr_data_buf, nr_data_buf * sizeof(struct redeposit_data *));
 		goto free_pages;
 	}
@@ -1432,6 +1807,8 @@ static int redeposit_probe(struct platform_device *pdev)
 		goto  free_data_buf;
 	}
 
+	xa_init(&info->i_xarr);
+	spin_lock_init(&info->lock);
 	init_waitqueue_head(&info->wait);
 	init_waitqueue_head(&info->wait_dev);
 	INIT_DELAYED_WORK(&info->redeposit_build_work, redeposit_build_handle);
@@ -1439,32 +1816,27 @@ static int redeposit_probe(struct platform_device *pdev)
 	INIT_DELAYED_WORK(&info->redeposit_cache_work, redeposit_cache_handle);
 	INIT_DELAYED_WORK(&info->redeposit_flush_work, redeposit_flush_handle);
 
-	nr_bios = (info->mem_size / PAGE_SIZE + BIO_MAX_PAGES - 1) / BIO_MAX_PAGES;
 	for (i = 0; i < nr_bios ; i++) {
 		nr_page = (i == nr_bios -1) ? ((info->mem_size / PAGE_SIZE - 1) % BIO_MAX_PAGES + 1):(BIO_MAX_PAGES);
 		info->pages[i] = alloc_pages(GFP_KERNEL, get_order(nr_page * PAGE_SIZE));
 		if (unlikely(!info->pages[i])) {
-			dev_err(&pdev->dev, "i%ld, nr_bios:%ld,nr_page:%ld, MAX_PAGES:%ld, order:%ld\n",
+			dev_err(dev, "i%ld, nr_bios:%ld,nr_page:%ld, MAX_PAGES:%ld, order:%ld\n",
 				i, nr_bios, nr_page, BIO_MAX_PAGES, get_order(nr_page * PAGE_SIZE));
 			goto  free_data_pages;
 		}
 	}
 
-	/*layout:/head/ + /map_buf/ + /data_buf/*/
 	info->head = redeposit_get_head(info);
 	memset(info->head, 0, sizeof(struct redeposit_head));
 	info->head->magic = REDEPOSIT_MAGIC;
 
-	/*we may be try to delay wake up the build work*/
-	queue_delayed_work(system_wq, &info->redeposit_build_work, HZ/2 * info->nr_hz);
-
 	return 0;
 
 free_data_pages:
 	for (i = 0; i < nr_bios ; i++) {
 		nr_page = (i == nr_bios -1) ? ((info->mem_size / PAGE_SIZE - 1) % BIO_MAX_PAGES + 1):(BIO_MAX_PAGES);
 		if (info->pages[i]) {
-			free_pages((unsigned long)(info->pages[i]), get_order(nr_page * PAGE_SIZE));
+			__free_pages(info->pages[i], get_order(nr_page * PAGE_SIZE));
 			continue;
 		}
 		break;
@@ -1475,8 +1847,46 @@ free_data_buf:
 	vfree(info->data_buf);
 free_pages:
 	kfree(info->pages);
+alloc_pages_failed:
+	return -ENOMEM;
+}
+
+static int redeposit_probe(struct platform_device *pdev)
+{
+	struct device_node *np = NULL;
+
+	np = pdev->dev.of_node;
+
+	dev_info(&pdev->dev, "%s\n", RDPST_DRIVER_VERSION);
+	BUG_ON((REDEPOSIT_MAP_MAX_SIZE % PAGE_SIZE));
+
+	info = kzalloc(sizeof(struct redeposit_info), GFP_KERNEL);
+	if (unlikely(!info)) {
+		dev_err(&pdev->dev, "redeposit alloc info failed\n");
+		goto alloc_info_failed;
+	}
+
+	info->aread = 1;
+	info->status_dev = DEV_WAIT_WAKE;
+	platform_set_drvdata(pdev, info);
+	info->pdev = pdev;
+	set_handle(info, FLAG_NONE);
+
+	redeposit_get_conf(info, np);
+
+	redeposit_set_part(info, np);
+
+	if (redeposit_alloc_mem(info))
+		goto free_info;
+
+	/*we may be try to delay wake up the build work*/
+	queue_delayed_work(system_wq, &info->redeposit_build_work, HZ/2 * info->nr_hz);
+
+	return 0;
+
 free_info:
 	kfree(info);
+	info = NULL;
 alloc_info_failed:
 	/*only no mem will cause it probe failed*/
 	return -ENOMEM;
@@ -1514,10 +1924,441 @@ static struct platform_driver redeposit_driver = {
 	.remove = redeposit_remove,
 };
 
-module_platform_driver(redeposit_driver);
+#if IS_ENABLED(CONFIG_SUNXI_REDEPOSIT_REPLAY)
+/*
+ * Block trace replay test.
+ *
+ * A trace written to <debugfs>/redeposit/replay, one "R|W <sector> <blocks>"
+ * line per request, is run when the file is read back. The flash is a RAM
+ * backed stand-in: every sector holds a pattern of its address and of the
+ * last trace write to it, the redeposit partition lives behind the traced
+ * range. The first pass records the reads like a learning boot and
+ * persists the image, the second one loads it like a replay boot, serves
+ * the same reads from the cache and checks every hit against the stand-in.
+ * Writes change the stand-in and invalidate the cache in both passes.
+ */
+#define RDPST_REPLAY_MEM	(16 * 1024 * 1024)
+#define RDPST_REPLAY_TEXT	(1024 * 1024)
+#define RDPST_REPLAY_MAX_BLK	2048
+
+struct redeposit_trace {
+	char op;
+	u32 sect;
+	u32 blocks;
+};
+
+struct redeposit_ramdev {
+	struct redeposit_info *info;
+	/*write generation of every sector written by the trace*/
+	struct xarray gen;
+	unsigned long next_gen;
+	/*the redeposit partition*/
+	u8 *image;
+	u32 image_start;
+	/*request handed from build_request to read_flash*/
+	struct scatterlist *sgl;
+	u32 sg_len;
+	u32 addr;
+};
+
+struct redeposit_replay_res {
+	u32 reads;
+	u32 writes;
+	u32 hits;
+	u32 misses;
+	u32 mismatch;
+};
+
+static struct {
+	struct mutex lock;
+	struct dentry *root;
+	struct platform_device *pdev;
+	char *text;
+	size_t text_len;
+	char *result;
+	size_t result_len;
+} replay;
+
+static void redeposit_ramdev_fill(struct redeposit_ramdev *rd, u32 sect, u32 *buf)
+{
+	void *entry = xa_load(&rd->gen, sect);
+	u32 gen = entry ? xa_to_value(entry) : 0;
+	u64 off;
+	u32 i;
+
+	if (sect >= rd->image_start) {
+		off = (u64)(sect - rd->image_start) * RDPST_SECT_SIZE;
+		if (off < RDPST_REPLAY_MEM)
+			memcpy(buf, rd->image + off, RDPST_SECT_SIZE);
+		else
+			memset(buf, 0, RDPST_SECT_SIZE);
+		return;
+	}
+
+	for (i = 0; i < RDPST_SECT_SIZE / sizeof(u32); i++)
+		buf[i] = sect * 0x9e3779b1 + gen * 0x85ebca6b + i;
+}
+
+static void *redeposit_ramdev_build_request(void *flash, void *buf, u32 sg_len, u32 addr, u32 nr_byte)
+{
+	struct redeposit_ramdev *rd = flash;
+
+	rd->sgl = buf;
+	rd->sg_len = sg_len;
+	rd->addr = addr;
+
+	return rd;
+}
+
+static int redeposit_ramdev_read_flash(void *flash, void *request, struct request_config *conf)
+{
+	struct redeposit_ramdev *rd = request;
+	struct scatterlist *sg;
+	u32 sect = rd->addr;
+	u32 i, j;
+
+	for_each_sg(rd->sgl, sg, rd->sg_len, i) {
+		for (j = 0; j < sg->length; j += RDPST_SECT_SIZE)
+			redeposit_ramdev_fill(rd, sect++, (u32 *)((u8 *)sg_virt(sg) + j));
+	}
+	redeposit_done(rd->info, 0);
+
+	return 0;
+}
+
+static struct redeposit_info *redeposit_replay_get(struct redeposit_ramdev *rd)
+{
+	struct redeposit_info *rinfo;
+
+	rinfo = kzalloc(sizeof(struct redeposit_info), GFP_KERNEL);
+	if (!rinfo)
+		return NULL;
+
+	rinfo->pdev = replay.pdev;
+	rinfo->mem_size = RDPST_REPLAY_MEM;
+	rinfo->nr_blk = RDPST_REPLAY_MAX_BLK / 64;
+	rinfo->nr_rd1 = 1;
+	rinfo->nr_rd2 = 1;
+	rinfo->aread = 1;
+	rinfo->re_part.start = rd->image_start;
+	rinfo->re_part.end = rd->image_start + RDPST_REPLAY_MEM / RDPST_SECT_SIZE;
+	set_handle(rinfo, FLAG_NONE);
+
+	if (redeposit_alloc_mem(rinfo)) {
+		kfree(rinfo);
+		return NULL;
+	}
+
+	rinfo->build_request = redeposit_ramdev_build_request;
+	rinfo->read_flash = redeposit_ramdev_read_flash;
+	rinfo->max_segment = REDEPOSIT_MAP_MAX_SIZE;
+	rinfo->flash = rd;
+	rd->info = rinfo;
+
+	return rinfo;
+}
+
+static void redeposit_replay_put(struct redeposit_info *rinfo)
+{
+	cancel_delayed_work_sync(&rinfo->redeposit_cache_work);
+	cancel_delayed_work_sync(&rinfo->redeposit_irq_work);
+	redeposit_release_info(rinfo);
+	kfree(rinfo);
+}
+
+static void redeposit_replay_pass(struct redeposit_ramdev *rd, struct redeposit_trace *ops, u32 nr_ops,
+				  u8 *buf, u32 *expect, bool record, struct redeposit_replay_res *res)
+{
+	struct redeposit_info *rinfo = rd->info;
+	struct scatterlist sg;
+	u32 i, k;
+
+	for (i = 0; i < nr_ops; i++) {
+		if (ops[i].op == 'W') {
+			/*like the host: invalidate before the data reaches flash*/
+			redeposit_invalidate(rinfo, ops[i].sect, ops[i].blocks);
+			rd->next_gen++;
+			for (k = 0; k < ops[i].blocks; k++)
+				xa_store(&rd->gen, ops[i].sect + k, xa_mk_value(rd->next_gen), GFP_KERNEL);
+			res->writes++;
+			continue;
+		}
+
+		res->reads++;
+		sg_init_one(&sg, buf, ops[i].blocks * RDPST_SECT_SIZE);
+		if (record) {
+			for (k = 0; k < ops[i].blocks; k++)
+				redeposit_ramdev_fill(rd, ops[i].sect + k, (u32 *)(buf + k * RDPST_SECT_SIZE));
+			redeposit_write_data(rinfo, &sg, 1, ops[i].sect, ops[i].blocks);
+			continue;
+		}
+
+		memset(buf, 0, ops[i].blocks * RDPST_SECT_SIZE);
+		if (!redeposit_read_data(rinfo, &sg, 1, ops[i].sect, ops[i].blocks)) {
+			res->misses++;
+			continue;
+		}
+
+		res->hits++;
+		for (k = 0; k < ops[i].blocks; k++) {
+			redeposit_ramdev_fill(rd, ops[i].sect + k, expect);
+			if (memcmp(buf + k * RDPST_SECT_SIZE, expect, RDPST_SECT_SIZE)) {
+				dev_err(&replay.pdev->dev, "op:%ld sect:%ld stale data\n", i, ops[i].sect + k);
+				res->mismatch++;
+				break;
+			}
+		}
+	}
+}
+
+static int redeposit_replay_run(struct redeposit_trace *ops, u32 nr_ops, char *out, size_t size)
+{
+	struct redeposit_replay_res rec = { 0 }, res = { 0 };
+	struct redeposit_ramdev *rd;
+	struct redeposit_info *rinfo;
+	u32 i, end = 0, nr_map_page, all_pages, nr_extent, nr_sect;
+	u32 *expect = NULL;
+	u8 *buf = NULL;
+	int len = 0;
+
+	for (i = 0; i < nr_ops; i++)
+		end = max(end, ops[i].sect + ops[i].blocks);
+
+	rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+	if (!rd)
+		return scnprintf(out, size, "error: no memory\n");
+	xa_init(&rd->gen);
+	rd->image_start = round_up(end, PAGE_TO_SECT(1));
+	rd->image = vzalloc(RDPST_REPLAY_MEM);
+	buf = alloc_pages_exact(RDPST_REPLAY_MAX_BLK * RDPST_SECT_SIZE, GFP_KERNEL);
+	expect = kmalloc(RDPST_SECT_SIZE, GFP_KERNEL);
+	if (!rd->image || !buf || !expect) {
+		len = scnprintf(out, size, "error: no memory\n");
+		goto free_rd;
+	}
+
+	/*learning boot: record the reads and persist the image*/
+	rinfo = redeposit_replay_get(rd);
+	if (!rinfo) {
+		len = scnprintf(out, size, "error: no memory\n");
+		goto free_rd;
+	}
+	set_handle(rinfo, FLAG_WRITE);
+	rinfo->head->ro_part_num = 1;
+	rinfo->head->ropart[0].start = 0;
+	rinfo->head->ropart[0].end = rd->image_start;
+	rinfo->head->map_size = REDEPOSIT_MAP_MAX_SIZE;
+	redeposit_build_data(rinfo);
+	rinfo->build_done = 1;
+
+	redeposit_replay_pass(rd, ops, nr_ops, buf, expect, true, &rec);
+
+	redeposit_seal_head(rinfo, H_STATUS_FINISH);
+	nr_map_page = redeposit_nr_map_pages(rinfo);
+	all_pages = nr_map_page + SECT_TO_PAGE(rinfo->data_index + PAGE_TO_SECT(1) - 1);
+	for (i = 0; i < all_pages; i++)
+		memcpy(rd->image + i * PAGE_SIZE, page_to_virt(redeposit_image_page(rinfo, i, nr_map_page)), PAGE_SIZE);
+	nr_extent = rinfo->map_index;
+	nr_sect = rinfo->data_index;
+	redeposit_replay_put(rinfo);
+
+	/*replay boot: load the image from the stand-in and serve the trace*/
+	rinfo = redeposit_replay_get(rd);
+	if (!rinfo) {
+		len = scnprintf(out, size, "error: no memory\n");
+		goto free_rd;
+	}
+	rinfo->status_dev = DEV_WAKEUP_DEV;
+	if (!redeposit_read_flash(rinfo, 0, PAGE_SIZE, end_redeposit_get_handle)) {
+		len = scnprintf(out, size, "error: read head failed\n");
+		goto put_info;
+	}
+	wait_event(rinfo->wait_dev, (rinfo->status_dev == DEV_GET_HANDLE));
+	if (!is_handle_read(rinfo)) {
+		len = scnprintf(out, size, "error: image rejected, handle:%lu\n", rinfo->handle_flag);
+		goto put_info;
+	}
+	if (!redeposit_build_cache_from_flash(rinfo)) {
+		len = scnprintf(out, size, "error: build cache failed\n");
+		goto put_info;
+	}
+	wait_event_timeout(rinfo->wait, (rinfo->cache_done || !rinfo->do_cache), 10 * HZ);
+	rinfo->build_done = 1;
+
+	redeposit_replay_pass(rd, ops, nr_ops, buf, expect, false, &res);
+
+	len = scnprintf(out, size,
+			"record: reads:%u writes:%u extents:%u sectors:%u\n"
+			"replay: reads:%u hits:%u misses:%u stale:%u\n"
+			"crc_err:%u invalidated:%u prefetch:%llu KB in %lld us\n"
+			"%s\n",
+			rec.reads, rec.writes, nr_extent, nr_sect,
+			res.reads, res.hits, res.misses, res.mismatch,
+			rinfo->iostat.nr_crc_err, rinfo->iostat.nr_stale,
+			rinfo->iostat.prefetch_bytes >> 10, ktime_to_us(rinfo->iostat.time_prefetch),
+			(!res.mismatch && !rinfo->iostat.nr_crc_err && rinfo->cache_done) ? "PASS" : "FAIL");
+
+put_info:
+	redeposit_replay_put(rinfo);
+free_rd:
+	kfree(expect);
+	if (buf)
+		free_pages_exact(buf, RDPST_REPLAY_MAX_BLK * RDPST_SECT_SIZE);
+	vfree(rd->image);
+	xa_destroy(&rd->gen);
+	kfree(rd);
+
+	return len;
+}
+
+/*"<op> <sector> <blocks>" per line, as printed by blkparse -f "%d %S %n\n"*/
+static int redeposit_replay(char *out, size_t size)
+{
+	struct redeposit_trace *ops;
+	char *text, *next, *line, op[8];
+	u32 nr_ops = 0, nr_line = 0, sect, blocks;
+	int len;
+
+	text = vmalloc(replay.text_len + 1);
+	ops = vmalloc(sizeof(*ops) * (replay.text_len / 6 + 1));
+	if (!text || !ops) {
+		len = scnprintf(out, size, "error: no memory\n");
+		goto free_text;
+	}
+	memcpy(text, replay.text, replay.text_len);
+	text[replay.text_len] = '\0';
+
+	next = text;
+	while ((line = strsep(&next, "\n"))) {
+		nr_line++;
+		line = strim(line);
+		if (!*line || *line == '#')
+			continue;
+
+		if (sscanf(line, "%7s %u %u", op, &sect, &blocks) != 3 ||
+		    blocks > RDPST_REPLAY_MAX_BLK || sect + blocks < sect) {
+			len = scnprintf(out, size, "error: line %u: %s\n", nr_line, line);
+			goto free_text;
+		}
+
+		/*discards, flushes and empty requests do not touch the data*/
+		op[0] = toupper(op[0]);
+		if ((op[0] != 'R' && op[0] != 'W') || !blocks)
+			continue;
+
+		ops[nr_ops].op = op[0];
+		ops[nr_ops].sect = sect;
+		ops[nr_ops].blocks = blocks;
+		nr_ops++;
+	}
+
+	if (!nr_ops) {
+		len = scnprintf(out, size, "error: empty trace\n");
+		goto free_text;
+	}
+
+	len = redeposit_replay_run(ops, nr_ops, out, size);
+
+free_text:
+	vfree(ops);
+	vfree(text);
+	return len;
+}
+
+static ssize_t redeposit_replay_write(struct file *file, const char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&replay.lock);
+	if (!*ppos)
+		replay.text_len = 0;
+	ret = simple_write_to_buffer(replay.text, RDPST_REPLAY_TEXT, ppos, ubuf, count);
+	if (ret > 0)
+		replay.text_len = *ppos;
+	mutex_unlock(&replay.lock);
+
+	return ret;
+}
+
+static ssize_t redeposit_replay_read(struct file *file, char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&replay.lock);
+	if (!*ppos)
+		replay.result_len = redeposit_replay(replay.result, PAGE_SIZE);
+	ret = simple_read_from_buffer(ubuf, count, ppos, replay.result, replay.result_len);
+	mutex_unlock(&replay.lock);
+
+	return ret;
+}
+
+static const struct file_operations redeposit_replay_fops = {
+	.owner	= THIS_MODULE,
+	.open	= simple_open,
+	.read	= redeposit_replay_read,
+	.write	= redeposit_replay_write,
+	.llseek	= default_llseek,
+};
+
+static void redeposit_replay_init(void)
+{
+	mutex_init(&replay.lock);
+	replay.text = vmalloc(RDPST_REPLAY_TEXT);
+	replay.result = kzalloc(PAGE_SIZE, GFP_KERNEL);
+	replay.pdev = platform_device_register_simple("redeposit-replay", PLATFORM_DEVID_NONE, NULL, 0);
+	if (!replay.text || !replay.result || IS_ERR(replay.pdev)) {
+		pr_err("redeposit: replay test disabled\n");
+		return;
+	}
+
+	replay.root = debugfs_create_dir(RDPST_DRIVER_NAME, NULL);
+	debugfs_create_file("replay", 0600, replay.root, NULL, &redeposit_replay_fops);
+}
+
+static void redeposit_replay_exit(void)
+{
+	debugfs_remove_recursive(replay.root);
+	if (!IS_ERR_OR_NULL(replay.pdev))
+		platform_device_unregister(replay.pdev);
+	kfree(replay.result);
+	vfree(replay.text);
+}
+#else
+static inline void redeposit_replay_init(void)
+{
+}
+
+static inline void redeposit_replay_exit(void)
+{
+}
+#endif /* IS_ENABLED(CONFIG_SUNXI_REDEPOSIT_REPLAY) */
+
+static int __init redeposit_init(void)
+{
+	int ret;
+
+	ret = platform_driver_register(&redeposit_driver);
+	if (ret)
+		return ret;
+
+	redeposit_replay_init();
+
+	return 0;
+}
+module_init(redeposit_init);
+
+static void __exit redeposit_exit(void)
+{
+	redeposit_replay_exit();
+	platform_driver_unregister(&redeposit_driver);
+}
+module_exit(redeposit_exit);
 
 MODULE_DESCRIPTION("Allwinner's redeposit startup io data");
 MODULE_LICENSE("GPL v2");
 MODULE_AUTHOR("libiao <libiao@allwinnertech.com>");
 MODULE_ALIAS("platform:redeposit");
-MODULE_VERSION("1.0.0");
+MODULE_VERSION("1.1.0");
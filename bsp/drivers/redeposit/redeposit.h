@@ -34,6 +34,8 @@
 
 #define REDEPOSIT_MEM_SIZE(nr)	((nr) * 128 * 1024 * 1024)
 #define REDEPOSIT_MAGIC		0x89119800
+/*v2: per extent hits/crc/flags in redeposit_map*/
+#define REDEPOSIT_VERSION	2
 #define REDEPOSIT_MAP_MAX_SIZE		(BIO_MAX_PAGES * PAGE_SIZE)
 
 #define RDPST_SECT_SIZE		512
@@ -92,6 +94,12 @@ struct redeposit_map {
 	/*redeposit area addr*/
 	u32 phy_start_sec;
 	u32 num_sec;
+	/*hotness, halved on every boot that replays the map*/
+	u32 hits;
+	/*crc32 of the extent data, checked before the extent is served*/
+	u32 crc;
+#define RDPST_MAP_INVALID	(1 << 0)
+	u32 flags;
 };
 
 struct request_config {
@@ -108,10 +116,13 @@ struct redeposit_data {
 	unsigned int	bv_len;
 	unsigned int	bv_offset;
 	unsigned int	status;
+	/*index of the redeposit_map this sector belongs to*/
+	unsigned int	map_idx;
 };
 
 #define SetDataUpdate(data) (data->status = 1)
 #define DataUpdate(data) (data->status == 1)
+#define ClearDataUpdate(data) (data->status = 0)
 
 struct redeposit_iostat {
 	ktime_t start;
@@ -125,6 +136,14 @@ struct redeposit_iostat {
 	ktime_t time_data;
 	ktime_t time_hit;
 	u32 nr_page[8];
+	/*prefetch throughput, used to estimate the time saved by hits*/
+	ktime_t time_prefetch;
+	u64 prefetch_bytes;
+	u64 nr_hit_req;
+	u64 nr_miss_req;
+	u64 nr_miss;
+	u32 nr_crc_err;
+	u32 nr_stale;
 };
 
 struct redeposit_info {
@@ -169,6 +188,7 @@ struct redeposit_info {
 	struct device_attribute allow_read;
 	struct device_attribute debug;
 	struct device_attribute record_part;
+	struct device_attribute stats;
 
 	struct page **pages;
 
@@ -176,6 +196,12 @@ struct redeposit_info {
 
 	u32 cache_map_index;
 	u32 cache_map_off;
+	/*data index of the first sector of the extent being loaded*/
+	u32 cache_ext_start;
+	/*the whole image has been read back*/
+	unsigned int cache_done;
+	/*protect extent validation against invalidation*/
+	spinlock_t lock;
 
 	u32 cache_hit;
 
@@ -203,6 +229,8 @@ struct redeposit_info {
 	u32 max_segment;
 
 	unsigned int build_done;
+	/*flush only head+map: replay boot updating hits and invalid extents*/
+	unsigned int flush_map;
 	struct redeposit_iostat iostat;
 	u32 ro_part_num;
 #define RDPST_MAX_PATH 35
@@ -225,6 +253,8 @@ struct redeposit_info *redeposit_attach_host(void *flash, u32 max_segment,
 
 void write_io_num(struct redeposit_info *info);
 
+void redeposit_invalidate(struct redeposit_info *info, unsigned int blk_addr, unsigned int blocks);
+
 void redeposit_wake_up_dev(struct redeposit_info *info, sector_t sect, sector_t blocks);
 
 
@@ -260,6 +290,10 @@ static inline void write_io_num(struct redeposit_info *info)
 {
 }
 
+static inline void redeposit_invalidate(struct redeposit_info *info, unsigned int blk_addr, unsigned int blocks)
+{
+}
+
 static inline void redeposit_wake_up_dev(struct redeposit_info *info, sector_t sect, sector_t blocks)
 {
 }
@@ -14,8 +14,13 @@
 
 /* #define DEBUG */
 #include <linux/arm-smccc.h>
+#include <linux/crc32.h>
+#include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/firmware.h>
 #include <linux/interrupt.h>
+#include <linux/ktime.h>
 #include <linux/remoteproc.h>
 #include <linux/io.h>
 #include <linux/mailbox_client.h>
@@ -27,7 +32,11 @@
 #include <linux/pm_wakeirq.h>
 #include <linux/regmap.h>
 #include <linux/remoteproc.h>
+#include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/pinctrl/consumer.h>
 #include <linux/platform_device.h>
 #include <linux/workqueue.h>
@@ -45,10 +54,16 @@
 
 #include <remoteproc/sunxi_remoteproc.h>
 
-#define SUNXI_RPROC_VERSION "2.3.2"
+#define SUNXI_RPROC_VERSION "2.4.0"
 
 #define MBOX_NB_VQ		2
 
+#if IS_ENABLED(CONFIG_AW_RPROC_DMA_LOAD)
+#define SUNXI_RPROC_DMA_CHANS		2
+#define SUNXI_RPROC_DMA_MIN_LEN		SZ_16K
+#define SUNXI_RPROC_DMA_TIMEOUT_MS	1000
+#endif
+
 static LIST_HEAD(sunxi_rproc_list);
 struct sunxi_mbox {
 	struct mbox_chan *chan;
@@ -57,6 +72,40 @@ struct sunxi_mbox {
 	int vq_id;
 };
 
+/* boot phases, in the order the remoteproc core walks through them */
+enum sunxi_rproc_boot_phase {
+	SUNXI_RPROC_PHASE_PREPARE,
+	SUNXI_RPROC_PHASE_PARSE_FW,
+	SUNXI_RPROC_PHASE_LOAD,
+	SUNXI_RPROC_PHASE_LOADED,
+	SUNXI_RPROC_PHASE_START,
+	SUNXI_RPROC_PHASE_STARTED,
+	SUNXI_RPROC_PHASE_READY,	/* first kick from the remote */
+	SUNXI_RPROC_PHASE_MAX,
+};
+
+static const char * const sunxi_rproc_phase_name[SUNXI_RPROC_PHASE_MAX] = {
+	[SUNXI_RPROC_PHASE_PREPARE]	= "prepare",
+	[SUNXI_RPROC_PHASE_PARSE_FW]	= "parse_fw",
+	[SUNXI_RPROC_PHASE_LOAD]	= "load",
+	[SUNXI_RPROC_PHASE_LOADED]	= "loaded",
+	[SUNXI_RPROC_PHASE_START]	= "start",
+	[SUNXI_RPROC_PHASE_STARTED]	= "started",
+	[SUNXI_RPROC_PHASE_READY]	= "ready",
+};
+
+struct sunxi_rproc_boot_stat {
+	ktime_t ts[SUNXI_RPROC_PHASE_MAX];
+	u32 boots;
+	u32 recoveries;
+	u32 resident_hits;
+	/* prepare() began this boot, load() must not start another one */
+	bool prepared;
+	size_t dma_bytes;
+	size_t cpu_bytes;
+	int dma_chans;
+};
+
 struct sunxi_rproc {
 	struct sunxi_rproc_priv *rproc_priv;  /* dsp/riscv private resources */
 #if IS_ENABLED(CONFIG_PM_SLEEP)
@@ -69,12 +118,28 @@ struct sunxi_rproc {
 	void __iomem *rsc_table_va;
 	bool is_booted;
 	char *name;
+	struct sunxi_rproc_boot_stat boot_stat;
+	const struct firmware *fw_resident;  /* image kept across restarts */
+	u32 fw_resident_crc;
+	bool fw_resident_en;
 };
 
 int simulator_debug;
 module_param(simulator_debug, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(simulator_debug, "Debug for simulator");
 
+static inline void sunxi_rproc_boot_mark(struct sunxi_rproc *chip,
+					 enum sunxi_rproc_boot_phase phase)
+{
+	chip->boot_stat.ts[phase] = ktime_get();
+}
+
+static void sunxi_rproc_boot_begin(struct sunxi_rproc *chip)
+{
+	memset(chip->boot_stat.ts, 0, sizeof(chip->boot_stat.ts));
+	chip->boot_stat.boots++;
+}
+
 static int sunxi_rproc_pa_to_da(struct rproc *rproc, phys_addr_t pa, u64 *da)
 {
 	struct device *dev = rproc->dev.parent;
@@ -204,6 +269,10 @@ static void sunxi_rproc_mb_rx_callback(struct mbox_client *cl, void *data)
 	 */
 	mb->vq_id = *(u32 *)data;
 
+	if (!chip->boot_stat.ts[SUNXI_RPROC_PHASE_READY] &&
+	    chip->boot_stat.ts[SUNXI_RPROC_PHASE_STARTED])
+		sunxi_rproc_boot_mark(chip, SUNXI_RPROC_PHASE_READY);
+
 	queue_work(chip->workqueue, &mb->vq_work);
 }
 
@@ -277,11 +346,13 @@ static int sunxi_rproc_start(struct rproc *rproc)
 	sunxi_arch_interrupt_save(rproc_priv->share_irq);
 #endif
 
+	sunxi_rproc_boot_mark(chip, SUNXI_RPROC_PHASE_START);
 	ret = sunxi_rproc_priv_start(rproc_priv);
 	if (ret) {
 		dev_err(rproc_priv->dev, "start remoteproc error\n");
 		return ret;
 	}
+	sunxi_rproc_boot_mark(chip, SUNXI_RPROC_PHASE_STARTED);
 
 #if IS_ENABLED(CONFIG_PM_SLEEP)
 	ret = sunxi_rproc_standby_start(chip->rproc_standby);
@@ -388,6 +459,9 @@ static int sunxi_rproc_attach(struct rproc *rproc)
 
 	dev_info(dev, "remoteproc initialized in fast boot mode\n");
 
+	/* nothing is loaded on attach, a later recovery is a boot of its own */
+	chip->boot_stat.prepared = false;
+
 #if IS_ENABLED(CONFIG_SUNXI_RPROC_SHARE_IRQ)
 	sunxi_arch_interrupt_save(rproc_priv->share_irq);
 #endif
@@ -444,6 +518,7 @@ static int sunxi_rproc_detach(struct rproc *rproc)
 static int sunxi_rproc_prepare(struct rproc *rproc)
 {
 	struct device *dev = rproc->dev.parent;
+	struct sunxi_rproc *chip = rproc->priv;
 	struct device_node *np = dev->of_node;
 	struct of_phandle_iterator it;
 	struct rproc_mem_entry *mem, *tmp;
@@ -452,6 +527,10 @@ static int sunxi_rproc_prepare(struct rproc *rproc)
 	int ret;
 	u64 da;
 
+	sunxi_rproc_boot_begin(chip);
+	chip->boot_stat.prepared = true;
+	sunxi_rproc_boot_mark(chip, SUNXI_RPROC_PHASE_PREPARE);
+
 	/* Register associated reserved memory regions */
 	ret = of_phandle_iterator_init(&it, np, "memory-region", NULL, 0);
 	if (ret) {
@@ -532,6 +611,7 @@ static int sunxi_rproc_parse_fw(struct rproc *rproc, const struct firmware *fw)
 
 	dev_dbg(dev, "%s,%d\n", __func__, __LINE__);
 
+	sunxi_rproc_boot_mark(chip, SUNXI_RPROC_PHASE_PARSE_FW);
 	chip->rproc_priv->pc_entry = ehdr->e_entry;
 
 	/* check segment name, such as .resource_table */
@@ -608,18 +688,352 @@ static int sunxi_rproc_elf_find_section(struct rproc *rproc,
 
 }
 
+#if IS_ENABLED(CONFIG_AW_RPROC_DMA_LOAD)
+struct sunxi_rproc_dma_seg {
+	struct sg_table sgt;
+	struct device *dma_dev;
+	dma_addr_t dst;
+	void *va;
+	const u8 *src;
+	u32 len;
+};
+
+/*
+ * One load: segments are spread over up to SUNXI_RPROC_DMA_CHANS memcpy
+ * channels and all of them are issued at once, the CPU meanwhile clears
+ * the .bss tails and copies the segments too small to be worth a transfer.
+ */
+struct sunxi_rproc_dma_load {
+	struct dma_chan *chan[SUNXI_RPROC_DMA_CHANS];
+	int nr_chan;
+	struct sunxi_rproc_dma_seg *seg;
+	int nr_seg;
+	atomic_t pending;
+	struct completion done;
+	int err;
+};
+
+static void sunxi_rproc_dma_release(struct sunxi_rproc_dma_load *dl)
+{
+	int i;
+
+	for (i = 0; i < dl->nr_chan; i++)
+		dma_release_channel(dl->chan[i]);
+	dl->nr_chan = 0;
+	kfree(dl->seg);
+	dl->seg = NULL;
+}
+
+static int sunxi_rproc_dma_init(struct sunxi_rproc_dma_load *dl, int max_seg)
+{
+	struct dma_chan *chan;
+	dma_cap_mask_t mask;
+
+	memset(dl, 0, sizeof(*dl));
+	init_completion(&dl->done);
+	/* bias, dropped by the finish once everything is queued */
+	atomic_set(&dl->pending, 1);
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_MEMCPY, mask);
+	while (dl->nr_chan < SUNXI_RPROC_DMA_CHANS) {
+		chan = dma_request_chan_by_mask(&mask);
+		if (IS_ERR(chan))
+			break;
+		dl->chan[dl->nr_chan++] = chan;
+	}
+	if (!dl->nr_chan)
+		return -ENODEV;
+
+	dl->seg = kcalloc(max_seg, sizeof(*dl->seg), GFP_KERNEL);
+	if (!dl->seg) {
+		sunxi_rproc_dma_release(dl);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void sunxi_rproc_dma_callback(void *param,
+				     const struct dmaengine_result *result)
+{
+	struct sunxi_rproc_dma_load *dl = param;
+
+	if (result && result->result != DMA_TRANS_NOERROR)
+		WRITE_ONCE(dl->err, -EIO);
+
+	if (atomic_dec_and_test(&dl->pending))
+		complete(&dl->done);
+}
+
+static void sunxi_rproc_dma_unmap(struct sunxi_rproc_dma_seg *seg)
+{
+	dma_unmap_resource(seg->dma_dev, seg->dst, seg->len, DMA_FROM_DEVICE, 0);
+	dma_unmap_sgtable(seg->dma_dev, &seg->sgt, DMA_TO_DEVICE, 0);
+	sg_free_table(&seg->sgt);
+}
+
+/*
+ * Queue the copy of one segment and start it, so it runs while the next
+ * segments are prepared. The firmware image is usually vmalloc'ed, so the
+ * source is described page by page and merged where the pages happen to be
+ * contiguous; an image outside vmalloc and the linear map (built into the
+ * kernel .rodata with CONFIG_EXTRA_FIRMWARE) has no page to describe. A
+ * non zero return means nothing was queued and the caller copies the
+ * segment itself; failures after the first descriptor went in are left in
+ * dl->err and handled by the finish.
+ */
+static int sunxi_rproc_dma_submit(struct sunxi_rproc_dma_load *dl, void *va,
+				  phys_addr_t pa, const u8 *src, u32 len)
+{
+	struct sunxi_rproc_dma_seg *seg = &dl->seg[dl->nr_seg];
+	struct dma_chan *chan = dl->chan[dl->nr_seg % dl->nr_chan];
+	struct device *dma_dev = chan->device->dev;
+	struct dma_async_tx_descriptor *tx;
+	unsigned int off = offset_in_page(src);
+	int nr_pages = DIV_ROUND_UP(off + len, PAGE_SIZE);
+	struct page **pages;
+	struct scatterlist *sg;
+	dma_addr_t dst;
+	const u8 *p;
+	int i, ret;
+
+	if (len < SUNXI_RPROC_DMA_MIN_LEN || READ_ONCE(dl->err))
+		return -EINVAL;
+
+	pages = kmalloc_array(nr_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	for (i = 0, p = src - off; i < nr_pages; i++, p += PAGE_SIZE) {
+		if (is_vmalloc_addr(p)) {
+			pages[i] = vmalloc_to_page(p);
+		} else if (virt_addr_valid(p)) {
+			pages[i] = virt_to_page(p);
+		} else {
+			kfree(pages);
+			return -EINVAL;
+		}
+	}
+
+	ret = sg_alloc_table_from_pages(&seg->sgt, pages, nr_pages, off, len,
+					GFP_KERNEL);
+	kfree(pages);
+	if (ret)
+		return ret;
+
+	ret = dma_map_sgtable(dma_dev, &seg->sgt, DMA_TO_DEVICE, 0);
+	if (ret)
+		goto free_table;
+
+	seg->dst = dma_map_resource(dma_dev, pa, len, DMA_FROM_DEVICE, 0);
+	if (dma_mapping_error(dma_dev, seg->dst)) {
+		ret = -ENOMEM;
+		goto unmap_src;
+	}
+
+	seg->dma_dev = dma_dev;
+	seg->va = va;
+	seg->src = src;
+	seg->len = len;
+	dl->nr_seg++;
+
+	dst = seg->dst;
+	for_each_sgtable_dma_sg(&seg->sgt, sg, i) {
+		unsigned long flags = DMA_CTRL_ACK;
+
+		/* a channel completes in order, the last one covers the segment */
+		if (i == seg->sgt.nents - 1)
+			flags |= DMA_PREP_INTERRUPT;
+
+		tx = dmaengine_prep_dma_memcpy(chan, dst, sg_dma_address(sg),
+					       sg_dma_len(sg), flags);
+		if (!tx) {
+			WRITE_ONCE(dl->err, -EIO);
+			return 0;
+		}
+
+		if (flags & DMA_PREP_INTERRUPT) {
+			tx->callback_result = sunxi_rproc_dma_callback;
+			tx->callback_param = dl;
+			atomic_inc(&dl->pending);
+		}
+
+		if (dma_submit_error(dmaengine_submit(tx))) {
+			if (flags & DMA_PREP_INTERRUPT)
+				atomic_dec(&dl->pending);
+			WRITE_ONCE(dl->err, -EIO);
+			return 0;
+		}
+		dst += sg_dma_len(sg);
+	}
+	dma_async_issue_pending(chan);
+
+	return 0;
+
+unmap_src:
+	dma_unmap_sgtable(dma_dev, &seg->sgt, DMA_TO_DEVICE, 0);
+free_table:
+	sg_free_table(&seg->sgt);
+	return ret;
+}
+
+/*
+ * Wait for everything queued. Whatever went wrong, the segments of this
+ * load are copied again by the CPU, so the remote never starts on a half
+ * written image.
+ */
+static void sunxi_rproc_dma_finish(struct sunxi_rproc_dma_load *dl,
+				   struct device *dev,
+				   struct sunxi_rproc_boot_stat *st)
+{
+	struct sunxi_rproc_dma_seg *seg;
+	int i, ret = READ_ONCE(dl->err);
+
+	if (!ret) {
+		if (!atomic_dec_and_test(&dl->pending) &&
+		    !wait_for_completion_timeout(&dl->done,
+				msecs_to_jiffies(SUNXI_RPROC_DMA_TIMEOUT_MS)))
+			ret = -ETIMEDOUT;
+		if (!ret)
+			ret = READ_ONCE(dl->err);
+	}
+
+	if (ret) {
+		for (i = 0; i < dl->nr_chan; i++)
+			dmaengine_terminate_sync(dl->chan[i]);
+		if (dl->nr_seg)
+			dev_warn(dev, "dma load failed: %d, fall back to cpu copy\n", ret);
+	}
+
+	for (i = 0; i < dl->nr_seg; i++) {
+		seg = &dl->seg[i];
+		sunxi_rproc_dma_unmap(seg);
+		if (ret) {
+			memcpy(seg->va, seg->src, seg->len);
+			st->cpu_bytes += seg->len;
+		} else {
+			st->dma_bytes += seg->len;
+		}
+	}
+
+	st->dma_chans = dl->nr_chan;
+	sunxi_rproc_dma_release(dl);
+}
+#else
+struct sunxi_rproc_dma_load {
+	int nr_chan;
+};
+
+static inline int sunxi_rproc_dma_init(struct sunxi_rproc_dma_load *dl, int max_seg)
+{
+	dl->nr_chan = 0;
+	return -ENODEV;
+}
+
+static inline int sunxi_rproc_dma_submit(struct sunxi_rproc_dma_load *dl, void *va,
+					 phys_addr_t pa, const u8 *src, u32 len)
+{
+	return -ENODEV;
+}
+
+static inline void sunxi_rproc_dma_finish(struct sunxi_rproc_dma_load *dl,
+					  struct device *dev,
+					  struct sunxi_rproc_boot_stat *st)
+{
+}
+#endif
+
+/*
+ * With "fw-resident" the driver keeps its own reference on the firmware
+ * after the first load. The firmware loader hands out the same buffer to
+ * every request_firmware() of that name while a reference is held, so a
+ * restart after a crash, or a stop/start from sysfs, no longer goes to the
+ * filesystem. The image is checked against the crc taken at the first load
+ * before it is loaded again.
+ */
+static int sunxi_rproc_fw_resident_verify(struct rproc *rproc,
+					  const struct firmware *fw)
+{
+	struct sunxi_rproc *chip = rproc->priv;
+
+	if (!chip->fw_resident || chip->fw_resident->data != fw->data)
+		return 0;
+
+	if (crc32_le(~0, fw->data, fw->size) != chip->fw_resident_crc) {
+		dev_err(&rproc->dev, "resident firmware '%s' corrupted, drop it\n",
+			rproc->firmware);
+		release_firmware(chip->fw_resident);
+		chip->fw_resident = NULL;
+		return -EBADMSG;
+	}
+
+	chip->boot_stat.resident_hits++;
+	return 0;
+}
+
+static void sunxi_rproc_fw_resident_hold(struct rproc *rproc,
+					 const struct firmware *fw)
+{
+	struct sunxi_rproc *chip = rproc->priv;
+	int ret;
+
+	if (!chip->fw_resident_en)
+		return;
+	if (chip->fw_resident && chip->fw_resident->data == fw->data)
+		return;
+
+	/* another firmware was loaded, e.g. renamed through sysfs */
+	release_firmware(chip->fw_resident);
+	chip->fw_resident = NULL;
+
+	/* @fw is still held by the core, this is served from the cache */
+	ret = request_firmware(&chip->fw_resident, rproc->firmware, &rproc->dev);
+	if (ret < 0) {
+		dev_warn(&rproc->dev, "keep firmware resident failed: %d\n", ret);
+		chip->fw_resident = NULL;
+		return;
+	}
+
+	if (chip->fw_resident->data != fw->data) {
+		release_firmware(chip->fw_resident);
+		chip->fw_resident = NULL;
+		return;
+	}
+
+	chip->fw_resident_crc = crc32_le(~0, fw->data, fw->size);
+	dev_info(&rproc->dev, "firmware '%s' resident, size: %zu\n",
+		 rproc->firmware, fw->size);
+}
+
 static int sunxi_rproc_elf_load_segments(struct rproc *rproc, const struct firmware *fw)
 {
 	struct device *dev = &rproc->dev;
 	struct sunxi_rproc *chip = rproc->priv;
+	struct sunxi_rproc_boot_stat *st = &chip->boot_stat;
+	struct sunxi_rproc_dma_load dl;
 	struct elf32_hdr *ehdr;
 	struct elf32_phdr *phdr;
 	struct elf32_shdr *shdr;
 	int i, ret = 0;
 	const u8 *elf_data = fw->data;
 	u32 offset, da, memsz, filesz;
+	phys_addr_t pa;
+	bool use_dma;
 	void *ptr;
 
+	/* crash recovery goes straight from stop to load, prepare is skipped */
+	if (!st->prepared) {
+		sunxi_rproc_boot_begin(chip);
+		st->recoveries++;
+	}
+	st->prepared = false;
+	sunxi_rproc_boot_mark(chip, SUNXI_RPROC_PHASE_LOAD);
+
+	ret = sunxi_rproc_fw_resident_verify(rproc, fw);
+	if (ret)
+		return ret;
+
 	/* get version from elf  */
 	ret = sunxi_rproc_elf_find_section(rproc, fw, ".version_table", &shdr);
 	if (ret) {
@@ -660,7 +1074,11 @@ static int sunxi_rproc_elf_load_segments(struct rproc *rproc, const struct firmw
 	/* arm can write/read local ram */
 	sunxi_rproc_priv_set_localram(chip->rproc_priv, 1);
 
-	dev_dbg(dev, "%s,%d\n", __func__, __LINE__);
+	use_dma = !sunxi_rproc_dma_init(&dl, ehdr->e_phnum);
+	st->dma_bytes = 0;
+	st->cpu_bytes = 0;
+
+	dev_dbg(dev, "%s,%d dma %d\n", __func__, __LINE__, use_dma);
 
 	/* go through the available ELF segments */
 	for (i = 0; i < ehdr->e_phnum; i++, phdr++) {
@@ -700,9 +1118,16 @@ static int sunxi_rproc_elf_load_segments(struct rproc *rproc, const struct firmw
 			break;
 		}
 
-		/* put the segment where the remote processor expects it */
-		if (phdr->p_filesz)
-			memcpy(ptr, elf_data + phdr->p_offset, filesz);
+		/*
+		 * put the segment where the remote processor expects it, large
+		 * segments go to the dma channels and run in parallel with the
+		 * rest of this loop.
+		 */
+		if (!use_dma || sunxi_rproc_da_to_pa(rproc, da, &pa) ||
+		    sunxi_rproc_dma_submit(&dl, ptr, pa, elf_data + offset, filesz)) {
+			memcpy(ptr, elf_data + offset, filesz);
+			st->cpu_bytes += filesz;
+		}
 
 		/*
 		 * Zero out remaining memory for this segment.
@@ -715,6 +1140,15 @@ static int sunxi_rproc_elf_load_segments(struct rproc *rproc, const struct firmw
 			memset(ptr + filesz, 0, memsz - filesz);
 	}
 
+	/* also on error, nothing may still be in flight when we return */
+	if (use_dma)
+		sunxi_rproc_dma_finish(&dl, dev, st);
+
+	sunxi_rproc_boot_mark(chip, SUNXI_RPROC_PHASE_LOADED);
+
+	if (!ret)
+		sunxi_rproc_fw_resident_hold(rproc, fw);
+
 	return ret;
 }
 
@@ -932,6 +1366,40 @@ static void sunxi_rproc_resource_put(struct rproc *rproc, struct platform_device
 
 }
 
+static int sunxi_rproc_boot_time_show(struct seq_file *s, void *unused)
+{
+	struct sunxi_rproc *chip = s->private;
+	struct sunxi_rproc_boot_stat *st = &chip->boot_stat;
+	ktime_t base = 0, prev;
+	int i;
+
+	/* a recovery starts at load, the phases before it stay empty */
+	for (i = 0; i < SUNXI_RPROC_PHASE_MAX && !base; i++)
+		base = st->ts[i];
+	prev = base;
+
+	seq_printf(s, "boots: %u, recoveries: %u\n", st->boots, st->recoveries);
+	seq_printf(s, "resident: %s, hits: %u\n",
+		   chip->fw_resident ? "yes" : "no", st->resident_hits);
+	seq_printf(s, "load: dma %zu bytes (%d chans), cpu %zu bytes\n",
+		   st->dma_bytes, st->dma_chans, st->cpu_bytes);
+
+	/* time of each phase since the boot began, and since the previous phase */
+	for (i = 0; i < SUNXI_RPROC_PHASE_MAX; i++) {
+		if (!st->ts[i]) {
+			seq_printf(s, "%-9s: -\n", sunxi_rproc_phase_name[i]);
+			continue;
+		}
+		seq_printf(s, "%-9s: %lld us (+%lld us)\n", sunxi_rproc_phase_name[i],
+			   ktime_us_delta(st->ts[i], base),
+			   ktime_us_delta(st->ts[i], prev));
+		prev = st->ts[i];
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sunxi_rproc_boot_time);
+
 int sunxi_rproc_report_crash(const char *name, enum rproc_crash_type type)
 {
 	struct sunxi_rproc *chip, *tmp;
@@ -990,6 +1458,7 @@ static int sunxi_rproc_probe(struct platform_device *pdev)
 	chip = rproc->priv;
 	chip->rproc = rproc;
 	chip->name = (char *)of_id->data;
+	chip->fw_resident_en = of_property_read_bool(np, "fw-resident");
 
 	ret = sunxi_rproc_resource_get(rproc, pdev);
 	if (ret) {
@@ -1055,6 +1524,11 @@ static int sunxi_rproc_probe(struct platform_device *pdev)
 
 	list_add(&chip->list, &sunxi_rproc_list);
 
+	/* removed along with dbg_dir in rproc_del() */
+	if (rproc->dbg_dir)
+		debugfs_create_file("boot_time", 0400, rproc->dbg_dir, chip,
+				    &sunxi_rproc_boot_time_fops);
+
 	dev_info(dev, "sunxi rproc driver probe ok\n");
 
 	return ret;
@@ -1153,6 +1627,9 @@ static int sunxi_rproc_remove(struct platform_device *pdev)
 
 	rproc_del(rproc);
 
+	release_firmware(chip->fw_resident);
+	chip->fw_resident = NULL;
+
 	sunxi_rproc_free_mbox(rproc);
 
 	destroy_workqueue(chip->workqueue);
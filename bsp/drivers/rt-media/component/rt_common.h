@@ -169,6 +169,7 @@ typedef enum comp_index_type {
 	COMP_INDEX_VENC_CONFIG_CATCH_JPEG_START,
 	COMP_INDEX_VENC_CONFIG_CATCH_JPEG_STOP,
 	COMP_INDEX_VENC_CONFIG_CATCH_JPEG_GET_DATA,
+	COMP_INDEX_VENC_CONFIG_CATCH_JPEG_GET_DMABUF,
 
 	COMP_INDEX_VENC_CONFIG_GET_VBV_BUF_INFO,
 	COMP_INDEX_VENC_CONFIG_GET_STREAM_HEADER,
@@ -8,6 +8,9 @@
 #include <linux/module.h>
 //#include <linux/g2d_driver.h>
 #include <linux/fs.h>
+#include <linux/version.h>
+#include <linux/dma-heap.h>
+#include <linux/dma-buf.h>
 #include "vin_video_api.h"
 #define LOG_TAG "rt_venc_comp"
 #include "../ven_adapter/vencoder.h"
@@ -981,6 +984,105 @@ catch_jpeg_get_data_exit:
 	return result;
 }
 
+/*
+ * Copy a finished jpeg into a freshly allocated dma-buf for the caller, who
+ * owns the returned reference. The jpeg lives in the encoder's private vbv, so one kernel copy
+ * is needed, but the caller gets a handle it can mmap or pass on without
+ * another copy through user space.
+ */
+int rt_venc_export_jpeg_dmabuf(const void *data, unsigned int size,
+			       rt_jpeg_dmabuf *jpeg_dmabuf)
+{
+	struct dma_heap *dma_heap;
+	struct dma_buf *dmabuf;
+	unsigned int buf_size = PAGE_ALIGN(size);
+	void *vaddr;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	struct dma_buf_map map;
+	int ret;
+#endif
+
+	if (!data || !size) {
+		RT_LOGE("invalid jpeg: data = %px, size = %d", data, size);
+		return -EINVAL;
+	}
+
+	/* cached heap first: the jpeg is read by the cpu on the other side */
+	dma_heap = dma_heap_find("system");
+	if (!dma_heap)
+		dma_heap = dma_heap_find("system-uncached");
+	if (!dma_heap) {
+		RT_LOGE("dma_heap_find failed");
+		return -ENODEV;
+	}
+
+	dmabuf = dma_heap_buffer_alloc(dma_heap, buf_size, O_RDWR, 0);
+	dma_heap_put(dma_heap);
+	if (IS_ERR(dmabuf)) {
+		RT_LOGE("dma_heap_buffer_alloc failed, size = %d", buf_size);
+		return PTR_ERR(dmabuf);
+	}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	ret = dma_buf_vmap(dmabuf, &map);
+	if (ret) {
+		RT_LOGE("dma_buf_vmap failed: %d", ret);
+		dma_heap_buffer_free(dmabuf);
+		return ret;
+	}
+	vaddr = map.vaddr;
+#else
+	vaddr = dma_buf_vmap(dmabuf);
+	if (IS_ERR_OR_NULL(vaddr)) {
+		RT_LOGE("dma_buf_vmap failed");
+		dma_heap_buffer_free(dmabuf);
+		return -ENOMEM;
+	}
+#endif
+
+	dma_buf_begin_cpu_access(dmabuf, DMA_TO_DEVICE);
+	memcpy(vaddr, data, size);
+	dma_buf_end_cpu_access(dmabuf, DMA_TO_DEVICE);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	dma_buf_vunmap(dmabuf, &map);
+#else
+	dma_buf_vunmap(dmabuf, vaddr);
+#endif
+
+	jpeg_dmabuf->dmabuf	   = dmabuf;
+	jpeg_dmabuf->info.size	   = size;
+	jpeg_dmabuf->info.buf_size = buf_size;
+
+	return 0;
+}
+
+static int catch_jpeg_get_dmabuf(venc_comp_ctx *venc_comp, rt_jpeg_dmabuf *jpeg_dmabuf)
+{
+	int result = 0;
+	VencOutputBuffer out_buffer;
+	catch_jpeg_cxt *jpeg_cxt = &venc_comp->jpeg_cxt;
+
+	if (jpeg_cxt->enable == 0 || !jpeg_cxt->vencoder) {
+		RT_LOGE("error: enable = %d, vencoder = %px", jpeg_cxt->enable, jpeg_cxt->vencoder);
+		return -1;
+	}
+
+	memset(&out_buffer, 0, sizeof(VencOutputBuffer));
+
+	result = VencDequeueOutputBuf(jpeg_cxt->vencoder, &out_buffer);
+	if (result != 0) {
+		RT_LOGE("have no bitstream");
+		return -1;
+	}
+
+	result = rt_venc_export_jpeg_dmabuf(out_buffer.pData0, out_buffer.nSize0, jpeg_dmabuf);
+
+	VencQueueOutputBuf(jpeg_cxt->vencoder, &out_buffer);
+
+	return result;
+}
+
 typedef struct osd_convert_dst_info {
 	unsigned int dst_ext_buf_size;
 	unsigned int dst_w_ext;
@@ -1255,6 +1357,11 @@ static error_type config_dynamic_param(
 			error = ERROR_TYPE_ERROR;
 		break;
 	}
+	case COMP_INDEX_VENC_CONFIG_CATCH_JPEG_GET_DMABUF: {
+		if (catch_jpeg_get_dmabuf(venc_comp, (rt_jpeg_dmabuf *)param_data) != 0)
+			error = ERROR_TYPE_ERROR;
+		break;
+	}
 	case COMP_INDEX_VENC_CONFIG_SET_OSD: {
 #if ENABLE_SAVE_NATIVE_OVERLAY_DATA
 		VencOverlayInfoS *pOverlayInfo = &global_osd_info->sOverlayInfo;
@@ -118,6 +118,19 @@ typedef struct venc_inbuf_manager {
 	int no_frame_flag;
 } venc_inbuf_manager;
 
+/*
+ * Kernel side of IOCTL_CATCH_JPEG_GET_DMABUF: the component fills in the
+ * dma-buf and sizes, the ioctl installs the fd once the reply reached the
+ * caller.
+ */
+typedef struct rt_jpeg_dmabuf {
+	catch_jpeg_dmabuf_info info;
+	struct dma_buf *dmabuf;
+} rt_jpeg_dmabuf;
+
+int rt_venc_export_jpeg_dmabuf(const void *data, unsigned int size,
+			       rt_jpeg_dmabuf *jpeg_dmabuf);
+
 error_type venc_comp_component_init(PARAM_IN comp_handle component, const rt_media_config_s *pmedia_config);
 
 #endif
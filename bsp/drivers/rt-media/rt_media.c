@@ -17,6 +17,10 @@
 #include <linux/wait.h>
 #include <linux/semaphore.h>
 #include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
 #include <asm/uaccess.h>
 
 #include "rt_media.h"
@@ -30,6 +34,7 @@
 #include <uapi/linux/sched/types.h>
 #include <linux/dma-heap.h>
 #include <linux/dma-buf.h>
+#include <linux/file.h>
 #ifndef RT_MEDIA_DEV_MAJOR
 #define RT_MEDIA_DEV_MAJOR (160)
 #endif
@@ -56,6 +61,13 @@ typedef struct stream_buffer_manager {
 	wait_queue_head_t wait_bitstream;
 	unsigned int wait_bitstream_condition;
 	unsigned int need_wait_up_flag;
+
+	/* mmap'd descriptor ring, frames go straight to caller_hold when set */
+	rt_stream_ring *ring;
+	struct file *ring_owner;
+
+	struct eventfd_ctx *stream_evfd;
+	struct file *evfd_owner;
 } stream_buffer_manager;
 
 typedef enum rt_media_state {
@@ -137,6 +149,10 @@ static struct rt_media_dev *rt_media_devp;
 static int bvin_is_ready_rt_not_probe[VIDEO_INPUT_CHANNEL_NUM];//Deal with the fact that rt_media not registered
 static struct csi_status_pair g_csi_status_pair[VIDEO_INPUT_CHANNEL_NUM];
 
+#if VENC_OUT_BUFFER_LIST_NODE_NUM > RT_STREAM_RING_ENTRY_NUM
+#error "stream ring can not hold every stream node"
+#endif
+
 static video_stream_s *ioctl_get_stream_data(video_recoder *recoder);
 static int ioctl_return_stream_data(video_recoder *recoder,
 				    video_stream_s *video_stream);
@@ -176,7 +192,33 @@ error_type rt_venc_empty_in_buffer_done(
 	return 0;
 }
 
-/* empty_list --> valid_list*/
+/* publish a frame in the mapped ring, called with stream_buf_mgr->mutex held */
+static void stream_ring_publish(stream_buffer_manager *stream_buf_mgr,
+				video_stream_node *stream_node)
+{
+	rt_stream_ring *ring	     = stream_buf_mgr->ring;
+	video_stream_s *video_stream = &stream_node->video_stream;
+	rt_stream_ring_entry *entry  = &ring->entry[ring->head & (RT_STREAM_RING_ENTRY_NUM - 1)];
+
+	entry->id	     = video_stream->id;
+	entry->flag	     = video_stream->flag;
+	entry->pts	     = video_stream->pts;
+	entry->size0	     = video_stream->size0;
+	entry->size1	     = video_stream->size1;
+	entry->size2	     = video_stream->size2;
+	entry->offset0	     = video_stream->offset0;
+	entry->offset1	     = video_stream->offset1;
+	entry->offset2	     = video_stream->offset2;
+	entry->keyframe_flag = video_stream->keyframe_flag;
+
+	/* entry must be visible before the new head */
+	smp_wmb();
+	WRITE_ONCE(ring->head, ring->head + 1);
+
+	list_move_tail(&stream_node->mList, &stream_buf_mgr->caller_hold_stream_list);
+}
+
+/* empty_list --> valid_list, or --> caller_hold_list when the ring is mapped */
 error_type rt_venc_fill_out_buffer_done(
 	PARAM_IN comp_handle component,
 	PARAM_IN void *pAppData,
@@ -204,13 +246,26 @@ error_type rt_venc_fill_out_buffer_done(
 	memcpy(&stream_node->video_stream, video_stream, sizeof(video_stream_s));
 
 	stream_buf_mgr->empty_num--;
-	list_move_tail(&stream_node->mList, &stream_buf_mgr->valid_stream_list);
+	if (stream_buf_mgr->ring_owner)
+		stream_ring_publish(stream_buf_mgr, stream_node);
+	else
+		list_move_tail(&stream_node->mList, &stream_buf_mgr->valid_stream_list);
 
 	if (stream_buf_mgr->need_wait_up_flag == 1) {
 		stream_buf_mgr->need_wait_up_flag	= 0;
 		stream_buf_mgr->wait_bitstream_condition = 1;
 		wake_up(&stream_buf_mgr->wait_bitstream);
+	} else if (wq_has_sleeper(&stream_buf_mgr->wait_bitstream)) {
+		/* poll() and batch waiters */
+		wake_up(&stream_buf_mgr->wait_bitstream);
 	}
+
+	if (stream_buf_mgr->stream_evfd)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+		eventfd_signal(stream_buf_mgr->stream_evfd);
+#else
+		eventfd_signal(stream_buf_mgr->stream_evfd, 1);
+#endif
 	mutex_unlock(&stream_buf_mgr->mutex);
 
 	/* todo; */
@@ -520,6 +575,12 @@ int ioctl_init(video_recoder *recoder)
 	}
 	init_waitqueue_head(&stream_buf_mgr->wait_bitstream);
 
+	if (stream_buf_mgr->ring) {
+		stream_buf_mgr->ring->head = 0;
+		stream_buf_mgr->ring->done = 0;
+		stream_buf_mgr->ring->rd   = 0;
+	}
+
 	return 0;
 }
 
@@ -915,6 +976,146 @@ static int ioctl_return_stream_data(video_recoder *recoder,
 	return 0;
 }
 
+/* valid_list --> caller_hold_list, up to batch->num frames in one lock */
+static int ioctl_get_stream_data_batch(video_recoder *recoder,
+				       video_stream_batch_s *batch)
+{
+	video_stream_node *stream_node	= NULL;
+	stream_buffer_manager *stream_buf_mgr = &recoder->stream_buf_manager;
+	unsigned int max_num		      = min_t(unsigned int, batch->num, RT_STREAM_BATCH_MAX_NUM);
+	unsigned int num		      = 0;
+	long ret			      = 0;
+
+	if (batch->timeout_ms) {
+		ret = wait_event_interruptible_timeout(stream_buf_mgr->wait_bitstream,
+						       !list_empty(&stream_buf_mgr->valid_stream_list),
+						       msecs_to_jiffies(batch->timeout_ms));
+		if (ret < 0)
+			return ret;
+	}
+
+	mutex_lock(&stream_buf_mgr->mutex);
+
+	while (num < max_num && !list_empty(&stream_buf_mgr->valid_stream_list)) {
+		stream_node = list_first_entry(&stream_buf_mgr->valid_stream_list, video_stream_node, mList);
+		memcpy(&batch->stream[num], &stream_node->video_stream, sizeof(video_stream_s));
+		list_move_tail(&stream_node->mList, &stream_buf_mgr->caller_hold_stream_list);
+		num++;
+	}
+
+	mutex_unlock(&stream_buf_mgr->mutex);
+
+	batch->num = num;
+
+	return 0;
+}
+
+/*
+ * caller_hold_list --> empty_list, up to batch->num frames in one lock. In ring
+ * mode the kept copy of each frame is handed back and batch->stream[] is filled
+ * with it, otherwise the caller's copy is used as in ioctl_return_stream_data().
+ */
+static int ioctl_return_stream_data_batch(video_recoder *recoder,
+					  video_stream_batch_s *batch)
+{
+	video_stream_node *stream_node	= NULL;
+	stream_buffer_manager *stream_buf_mgr = &recoder->stream_buf_manager;
+	comp_buffer_header_type buffer_header;
+	unsigned int max_num		      = min_t(unsigned int, batch->num, RT_STREAM_BATCH_MAX_NUM);
+	unsigned int num		      = 0;
+	int ring_mode;
+
+	mutex_lock(&stream_buf_mgr->mutex);
+
+	ring_mode = stream_buf_mgr->ring_owner != NULL;
+	while (num < max_num && !list_empty(&stream_buf_mgr->caller_hold_stream_list)) {
+		stream_node = list_first_entry(&stream_buf_mgr->caller_hold_stream_list, video_stream_node, mList);
+		if (ring_mode)
+			memcpy(&batch->stream[num], &stream_node->video_stream, sizeof(video_stream_s));
+		else
+			memcpy(&stream_node->video_stream, &batch->stream[num], sizeof(video_stream_s));
+
+		list_move_tail(&stream_node->mList, &stream_buf_mgr->empty_stream_list);
+		stream_buf_mgr->empty_num++;
+		num++;
+	}
+
+	if (ring_mode)
+		WRITE_ONCE(stream_buf_mgr->ring->done, stream_buf_mgr->ring->done + num);
+
+	mutex_unlock(&stream_buf_mgr->mutex);
+
+	if (num < max_num)
+		RT_LOGW("return stream batch: only %d of %d frames are held", num, max_num);
+
+	batch->num = num;
+
+	for (num = 0; num < batch->num; num++) {
+		memset(&buffer_header, 0, sizeof(comp_buffer_header_type));
+		buffer_header.private = &batch->stream[num];
+		comp_fill_this_out_buffer(recoder->venc_comp, &buffer_header);
+	}
+
+	return 0;
+}
+
+/* hand every frame still held through the ring back to the encoder */
+static void stream_ring_release(video_recoder *recoder)
+{
+	video_stream_node *stream_node	= NULL;
+	stream_buffer_manager *stream_buf_mgr = &recoder->stream_buf_manager;
+	comp_buffer_header_type buffer_header;
+	video_stream_s mvideo_stream;
+
+	mutex_lock(&stream_buf_mgr->mutex);
+	stream_buf_mgr->ring_owner = NULL;
+
+	while (!list_empty(&stream_buf_mgr->caller_hold_stream_list)) {
+		stream_node = list_first_entry(&stream_buf_mgr->caller_hold_stream_list, video_stream_node, mList);
+		memcpy(&mvideo_stream, &stream_node->video_stream, sizeof(video_stream_s));
+		list_move_tail(&stream_node->mList, &stream_buf_mgr->empty_stream_list);
+		stream_buf_mgr->empty_num++;
+		stream_buf_mgr->ring->done++;
+		mutex_unlock(&stream_buf_mgr->mutex);
+
+		if (recoder->venc_comp) {
+			memset(&buffer_header, 0, sizeof(comp_buffer_header_type));
+			buffer_header.private = &mvideo_stream;
+			comp_fill_this_out_buffer(recoder->venc_comp, &buffer_header);
+		}
+
+		mutex_lock(&stream_buf_mgr->mutex);
+	}
+
+	mutex_unlock(&stream_buf_mgr->mutex);
+}
+
+static int ioctl_set_stream_eventfd(video_recoder *recoder, struct file *filp, int fd)
+{
+	stream_buffer_manager *stream_buf_mgr = &recoder->stream_buf_manager;
+	struct eventfd_ctx *evfd	      = NULL;
+	struct eventfd_ctx *old_evfd	      = NULL;
+
+	if (fd >= 0) {
+		evfd = eventfd_ctx_fdget(fd);
+		if (IS_ERR(evfd)) {
+			RT_LOGE("invalid eventfd: %d", fd);
+			return PTR_ERR(evfd);
+		}
+	}
+
+	mutex_lock(&stream_buf_mgr->mutex);
+	old_evfd		   = stream_buf_mgr->stream_evfd;
+	stream_buf_mgr->stream_evfd = evfd;
+	stream_buf_mgr->evfd_owner  = evfd ? filp : NULL;
+	mutex_unlock(&stream_buf_mgr->mutex);
+
+	if (old_evfd)
+		eventfd_ctx_put(old_evfd);
+
+	return 0;
+}
+
 static int copy_jpeg_data(void *user_buf_info, video_stream_s *video_stream)
 {
 	int result = 0;
@@ -1033,8 +1234,10 @@ static int ioctl_output_yuv_catch_jpeg_stop(video_recoder *recoder)
 }
 
 static int ioctl_output_yuv_catch_jpeg_getData(video_recoder *recoder,
-					       void *user_buf_info)
+					       void *user_buf_info,
+					       rt_jpeg_dmabuf *jpeg_dmabuf)
 {
+	int ret			     = 0;
 	video_stream_s *video_stream = NULL;
 	int loop_count		     = 0;
 	int loop_max_count	   = 200; /* mean 2 s*/
@@ -1065,11 +1268,14 @@ catch_jpeg_get_stream_data:
 	RT_LOGI("video_stream->offset0 = %d, size0 = %d, data0 = %px",
 		video_stream->offset0, video_stream->size0, video_stream->data0);
 
-	copy_jpeg_data(user_buf_info, video_stream);
+	if (jpeg_dmabuf)
+		ret = rt_venc_export_jpeg_dmabuf(video_stream->data0, video_stream->size0, jpeg_dmabuf);
+	else
+		copy_jpeg_data(user_buf_info, video_stream);
 
 	ioctl_return_stream_data(recoder, video_stream);
 
-	return 0;
+	return ret;
 }
 
 static int ioctl_reset_encoder_type(video_recoder *recoder, int encoder_type)
@@ -1148,11 +1354,102 @@ static int ioctl_reset_encoder_type(video_recoder *recoder, int encoder_type)
 
 	return 0;
 }
+/* map the bitstream descriptor ring of the channel, see rt_stream_ring */
 static int fops_mmap(struct file *filp, struct vm_area_struct *vma)
 {
-	//* todo
+	media_private_info *media_info = filp->private_data;
+	unsigned long ring_size	       = PAGE_ALIGN(sizeof(rt_stream_ring));
+	stream_buffer_manager *stream_buf_mgr;
+	video_recoder *recoder;
+	video_stream_node *stream_node;
+	int ret = 0;
 
-	return 0;
+	if (media_info->channel < 0)
+		return -EINVAL;
+
+	recoder = &rt_media_devp->recoder[media_info->channel];
+	if (recoder->state == RT_MEDIA_STATE_IDLE ||
+	    recoder->config.output_mode != OUTPUT_MODE_STREAM) {
+		RT_LOGE("mmap: channel %d is not a configured stream channel", media_info->channel);
+		return -EINVAL;
+	}
+
+	if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > ring_size)
+		return -EINVAL;
+
+	stream_buf_mgr = &recoder->stream_buf_manager;
+	mutex_lock(&stream_buf_mgr->mutex);
+
+	if (stream_buf_mgr->ring_owner && stream_buf_mgr->ring_owner != filp) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (!stream_buf_mgr->ring_owner && !list_empty(&stream_buf_mgr->caller_hold_stream_list)) {
+		RT_LOGE("mmap: frames are still held by IOCTL_GET_STREAM_DATA");
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (!stream_buf_mgr->ring) {
+		stream_buf_mgr->ring = vmalloc_user(ring_size);
+		if (!stream_buf_mgr->ring) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		stream_buf_mgr->ring->magic	= RT_STREAM_RING_MAGIC;
+		stream_buf_mgr->ring->entry_num = RT_STREAM_RING_ENTRY_NUM;
+	}
+
+	ret = remap_vmalloc_range(vma, stream_buf_mgr->ring, 0);
+	if (ret)
+		goto out;
+
+	if (!stream_buf_mgr->ring_owner) {
+		stream_buf_mgr->ring->head = 0;
+		stream_buf_mgr->ring->done = 0;
+		stream_buf_mgr->ring->rd   = 0;
+		stream_buf_mgr->ring_owner = filp;
+
+		/* frames already encoded go to the ring first */
+		while (!list_empty(&stream_buf_mgr->valid_stream_list)) {
+			stream_node = list_first_entry(&stream_buf_mgr->valid_stream_list, video_stream_node, mList);
+			stream_ring_publish(stream_buf_mgr, stream_node);
+		}
+	}
+
+out:
+	mutex_unlock(&stream_buf_mgr->mutex);
+	return ret;
+}
+
+static __poll_t fops_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	media_private_info *media_info = filp->private_data;
+	stream_buffer_manager *stream_buf_mgr;
+	video_recoder *recoder;
+	__poll_t mask = 0;
+
+	if (media_info->channel < 0)
+		return EPOLLERR;
+
+	recoder = &rt_media_devp->recoder[media_info->channel];
+	if (recoder->state == RT_MEDIA_STATE_IDLE)
+		return EPOLLERR;
+
+	stream_buf_mgr = &recoder->stream_buf_manager;
+	poll_wait(filp, &stream_buf_mgr->wait_bitstream, wait);
+
+	mutex_lock(&stream_buf_mgr->mutex);
+	if (stream_buf_mgr->ring_owner == filp) {
+		if (stream_buf_mgr->ring->head != READ_ONCE(stream_buf_mgr->ring->rd))
+			mask |= EPOLLIN | EPOLLRDNORM;
+	} else if (!list_empty(&stream_buf_mgr->valid_stream_list)) {
+		mask |= EPOLLIN | EPOLLRDNORM;
+	}
+	mutex_unlock(&stream_buf_mgr->mutex);
+
+	return mask;
 }
 
 static int fops_open(struct inode *inode, struct file *filp)
@@ -1176,6 +1473,17 @@ static int fops_release(struct inode *inode, struct file *filp)
 {
 	/* todo */
 	media_private_info *media_info = filp->private_data;
+	stream_buffer_manager *stream_buf_mgr;
+
+	if (media_info->channel >= 0) {
+		stream_buf_mgr = &rt_media_devp->recoder[media_info->channel].stream_buf_manager;
+
+		if (stream_buf_mgr->ring_owner == filp)
+			stream_ring_release(&rt_media_devp->recoder[media_info->channel]);
+
+		if (stream_buf_mgr->evfd_owner == filp)
+			ioctl_set_stream_eventfd(&rt_media_devp->recoder[media_info->channel], filp, -1);
+	}
 
 	kfree(media_info);
 
@@ -1397,6 +1705,55 @@ static long fops_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 		break;
 	}
+	case IOCTL_GET_STREAM_DATA_BATCH:
+	case IOCTL_RETURN_STREAM_DATA_BATCH: {
+		video_stream_batch_s *batch = NULL;
+
+		if (recoder->venc_comp == NULL) {
+			RT_LOGE("stream batch: recoder->venc_comp is null\n");
+			return -EFAULT;
+		}
+
+		batch = kmalloc(sizeof(video_stream_batch_s), GFP_KERNEL);
+		if (!batch)
+			return -ENOMEM;
+
+		if (copy_from_user(batch, (void __user *)arg, sizeof(video_stream_batch_s))) {
+			RT_LOGE("stream batch copy_from_user fail\n");
+			kfree(batch);
+			return -EFAULT;
+		}
+
+		if (cmd == IOCTL_GET_STREAM_DATA_BATCH)
+			ret = ioctl_get_stream_data_batch(recoder, batch);
+		else
+			ret = ioctl_return_stream_data_batch(recoder, batch);
+
+		if (ret == 0 && copy_to_user((void __user *)arg, batch,
+					     offsetof(video_stream_batch_s, stream) +
+					     batch->num * sizeof(video_stream_s))) {
+			RT_LOGE("stream batch copy_to_user fail\n");
+			ret = -EFAULT;
+		}
+
+		kfree(batch);
+		return ret;
+	}
+	case IOCTL_SET_STREAM_EVENTFD: {
+		int fd = -1;
+
+		if (recoder->state == RT_MEDIA_STATE_IDLE) {
+			RT_LOGE("IOCTL_SET_STREAM_EVENTFD: channel is not configured\n");
+			return -EINVAL;
+		}
+
+		if (copy_from_user(&fd, (void __user *)arg, sizeof(int))) {
+			RT_LOGE("IOCTL_SET_STREAM_EVENTFD copy_from_user fail\n");
+			return -EFAULT;
+		}
+
+		return ioctl_set_stream_eventfd(recoder, filp, fd);
+	}
 	case IOCTL_CATCH_JPEG_START: {
 		catch_jpeg_config jpeg_config;
 		memset(&jpeg_config, 0, sizeof(catch_jpeg_config));
@@ -1438,7 +1795,49 @@ static long fops_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 				return -EFAULT;
 			}
 		} else
-			return ioctl_output_yuv_catch_jpeg_getData(recoder, (void *)arg);
+			return ioctl_output_yuv_catch_jpeg_getData(recoder, (void *)arg, NULL);
+
+		break;
+	}
+	case IOCTL_CATCH_JPEG_GET_DMABUF: {
+		rt_jpeg_dmabuf jpeg_dmabuf;
+		int fd;
+
+		memset(&jpeg_dmabuf, 0, sizeof(rt_jpeg_dmabuf));
+		jpeg_dmabuf.info.fd = -1;
+
+		if (recoder->config.output_mode == OUTPUT_MODE_STREAM) {
+			ret = comp_set_config(recoder->venc_comp, COMP_INDEX_VENC_CONFIG_CATCH_JPEG_GET_DMABUF, &jpeg_dmabuf);
+			if (ret != 0) {
+				RT_LOGE("COMP_INDEX_VENC_CONFIG_CATCH_JPEG_GET_DMABUF failed");
+				return -EFAULT;
+			}
+		} else {
+			ret = ioctl_output_yuv_catch_jpeg_getData(recoder, NULL, &jpeg_dmabuf);
+			if (ret != 0)
+				return ret;
+		}
+
+		if (!jpeg_dmabuf.dmabuf)
+			return -EFAULT;
+
+		/* the fd only becomes visible once the caller got to know it */
+		fd = get_unused_fd_flags(O_CLOEXEC);
+		if (fd < 0) {
+			RT_LOGE("get_unused_fd_flags failed: %d", fd);
+			dma_buf_put(jpeg_dmabuf.dmabuf);
+			return fd;
+		}
+		jpeg_dmabuf.info.fd = fd;
+
+		if (copy_to_user((void __user *)arg, &jpeg_dmabuf.info, sizeof(catch_jpeg_dmabuf_info))) {
+			RT_LOGE("IOCTL_CATCH_JPEG_GET_DMABUF copy_to_user fail\n");
+			put_unused_fd(fd);
+			dma_buf_put(jpeg_dmabuf.dmabuf);
+			return -EFAULT;
+		}
+
+		fd_install(fd, jpeg_dmabuf.dmabuf->file);
 
 		break;
 	}
@@ -2334,6 +2733,7 @@ static long fops_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 static const struct file_operations rt_media_fops = {
 	.owner		= THIS_MODULE,
 	.mmap		= fops_mmap,
+	.poll		= fops_poll,
 	.open		= fops_open,
 	.release	= fops_release,
 	.llseek		= no_llseek,
@@ -2716,6 +3116,7 @@ static int rt_media_probe(struct platform_device *pdev)
 }
 static int rt_media_remove(struct platform_device *pdev)
 {
+	int i = 0;
 	dev_t dev;
 
 	dev = MKDEV(g_rt_media_dev_major, g_rt_media_dev_minor);
@@ -2728,6 +3129,9 @@ static int rt_media_remove(struct platform_device *pdev)
 		if (rt_media_devp->reset_high_fps_thread)
 			kthread_stop(rt_media_devp->reset_high_fps_thread);
 
+		for (i = 0; i < VIDEO_INPUT_CHANNEL_NUM; i++)
+			vfree(rt_media_devp->recoder[i].stream_buf_manager.ring);
+
 		cdev_del(&rt_media_devp->cdev);
 		device_destroy(rt_media_devp->class, dev);
 		class_destroy(rt_media_devp->class);
@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner SPI transfer benchmark
+ *
+ * Compares spi_sync() with pinned messages on an already probed spi device,
+ * usually a spidev node. With MOSI wired to MISO the received data is
+ * checked against the transmitted pattern. The test runs once when the
+ * module is loaded, results go to the kernel log:
+ *
+ *   insmod spi-sunxi-bench.ko bus=1 cs=0 len=4096 iterations=1000
+ */
+
+#define pr_fmt(fmt) "spi-sunxi-bench: " fmt
+
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/spi/spi.h>
+#include "spi-sunxi.h"
+
+static unsigned int bus = 1;
+module_param(bus, uint, 0444);
+MODULE_PARM_DESC(bus, "SPI bus number (default: 1)");
+
+static unsigned int cs;
+module_param(cs, uint, 0444);
+MODULE_PARM_DESC(cs, "Chip select of the device (default: 0)");
+
+static unsigned int len = 4096;
+module_param(len, uint, 0444);
+MODULE_PARM_DESC(len, "Full duplex transfer size in bytes (default: 4096)");
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Number of messages per test (default: 1000)");
+
+static unsigned int speed;
+module_param(speed, uint, 0444);
+MODULE_PARM_DESC(speed, "Transfer speed in Hz, 0 for the device default");
+
+struct bench_ctx {
+	struct spi_device	*spi;
+	struct spi_message	msg;
+	struct spi_transfer	xfer;
+	u8			*tx;
+	u8			*rx;
+};
+
+struct bench_stat {
+	u64			total_ns;
+	u64			max_ns;
+	u32			count;
+};
+
+static void bench_stat_add(struct bench_stat *stat, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	stat->total_ns += ns;
+	stat->count++;
+	if (ns > stat->max_ns)
+		stat->max_ns = ns;
+}
+
+static void bench_stat_print(const char *name, struct bench_stat *stat)
+{
+	if (!stat->count)
+		return;
+
+	pr_info("%-8s latency: avg %llu ns, max %llu ns, %llu KB/s (%u runs)\n",
+		name, div_u64(stat->total_ns, stat->count), stat->max_ns,
+		div64_u64((u64)len * stat->count * NSEC_PER_SEC,
+			  max_t(u64, stat->total_ns, 1)) >> 10,
+		stat->count);
+}
+
+/* only meaningful with MOSI wired to MISO */
+static void bench_check(struct bench_ctx *ctx, const char *name)
+{
+	if (memcmp(ctx->tx, ctx->rx, len))
+		pr_warn("%s: rx differs from tx, no loopback?\n", name);
+	else
+		pr_info("%s: loopback data ok\n", name);
+}
+
+static int bench_sync(struct bench_ctx *ctx)
+{
+	struct bench_stat stat = { 0 };
+	ktime_t start;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < iterations; i++) {
+		start = ktime_get();
+		ret = spi_sync(ctx->spi, &ctx->msg);
+		if (ret) {
+			pr_err("spi_sync failed at run %u: %d\n", i, ret);
+			return ret;
+		}
+		bench_stat_add(&stat, start);
+
+		if (!i)
+			bench_check(ctx, "sync");
+	}
+
+	bench_stat_print("sync", &stat);
+
+	return 0;
+}
+
+static int bench_pinned(struct bench_ctx *ctx)
+{
+	struct sunxi_spi_pinned *pin;
+	struct bench_stat stat = { 0 };
+	ktime_t start;
+	unsigned int i;
+	int ret = 0;
+
+	pin = sunxi_spi_pin_message(ctx->spi, &ctx->msg);
+	if (IS_ERR(pin)) {
+		pr_info("pinned messages not supported: %ld\n", PTR_ERR(pin));
+		return 0;
+	}
+
+	for (i = 0; i < iterations; i++) {
+		memset(ctx->rx, 0, len);
+
+		start = ktime_get();
+		ret = sunxi_spi_sync_pinned(pin);
+		if (ret) {
+			pr_err("pinned sync failed at run %u: %d\n", i, ret);
+			break;
+		}
+		bench_stat_add(&stat, start);
+
+		if (!i)
+			bench_check(ctx, "pinned");
+	}
+
+	sunxi_spi_unpin_message(pin);
+
+	bench_stat_print("pinned", &stat);
+
+	return ret;
+}
+
+static int __init sunxi_spi_bench_init(void)
+{
+	struct bench_ctx *ctx;
+	struct device *dev;
+	char name[16];
+	unsigned int i;
+	int ret;
+
+	if (!iterations || !len)
+		return -EINVAL;
+
+	scnprintf(name, sizeof(name), "spi%u.%u", bus, cs);
+	dev = bus_find_device_by_name(&spi_bus_type, NULL, name);
+	if (!dev) {
+		pr_err("no device %s\n", name);
+		return -ENODEV;
+	}
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx) {
+		ret = -ENOMEM;
+		goto err_put_dev;
+	}
+	ctx->spi = to_spi_device(dev);
+
+	ctx->tx = kmalloc(len, GFP_KERNEL | GFP_DMA);
+	ctx->rx = kzalloc(len, GFP_KERNEL | GFP_DMA);
+	if (!ctx->tx || !ctx->rx) {
+		ret = -ENOMEM;
+		goto err_free_buf;
+	}
+	for (i = 0; i < len; i++)
+		ctx->tx[i] = i ^ (i >> 8);
+
+	ctx->xfer.tx_buf = ctx->tx;
+	ctx->xfer.rx_buf = ctx->rx;
+	ctx->xfer.len = len;
+	ctx->xfer.speed_hz = speed;
+	spi_message_init(&ctx->msg);
+	spi_message_add_tail(&ctx->xfer, &ctx->msg);
+
+	pr_info("%s: %u iterations, %u bytes, %u Hz\n", name, iterations, len,
+		speed ? speed : ctx->spi->max_speed_hz);
+
+	ret = bench_sync(ctx);
+	if (!ret)
+		ret = bench_pinned(ctx);
+
+err_free_buf:
+	kfree(ctx->rx);
+	kfree(ctx->tx);
+	kfree(ctx);
+err_put_dev:
+	put_device(dev);
+	return ret;
+}
+module_init(sunxi_spi_bench_init);
+
+static void __exit sunxi_spi_bench_exit(void)
+{
+}
+module_exit(sunxi_spi_bench_exit);
+
+MODULE_DESCRIPTION("Allwinner SPI transfer benchmark");
+MODULE_LICENSE("GPL");
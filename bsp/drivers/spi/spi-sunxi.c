@@ -42,6 +42,8 @@
 #include <linux/signal.h>
 #include <linux/dmaengine.h>
 #include <linux/dma-mapping.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
 //#include <sunxi-clk.h>
 #include <linux/regulator/consumer.h>
 #include "spi-sunxi.h"
@@ -91,6 +93,48 @@ typedef struct {
 	struct page *pages[SPI_MAX_PAGES];
 } spi_dma_info_t;
 
+/* buffer and descriptor of one direction of a pinned transfer */
+struct sunxi_spi_pinned_dma {
+	struct scatterlist sg;
+	struct dma_async_tx_descriptor *desc;
+};
+
+struct sunxi_spi_pinned_xfer {
+	struct spi_transfer *t;
+	struct sunxi_spi_pinned_dma tx;
+	struct sunxi_spi_pinned_dma rx;
+};
+
+/* a recurring spi_message, mapped and prepared once */
+struct sunxi_spi_pinned {
+	struct spi_device *spi;
+	struct spi_message *msg;
+	/* speed shared by all transfers, 0 if they differ */
+	u32 speed_hz;
+	int nr_xfers;
+	struct sunxi_spi_pinned_xfer xfers[];
+};
+
+/* slave mode: continuous rx into a cyclic dma ring */
+struct sunxi_spi_slave_ring {
+	struct sunxi_spi *sspi;
+	struct miscdevice misc;
+	char name[16];
+	void *buf;
+	dma_addr_t dma;
+	u32 size;
+	u32 period;
+	/* bytes written by the dma / consumed by the reader */
+	u64 head;
+	u64 tail;
+	u64 overrun;
+	dma_cookie_t cookie;
+	/* the dma reports its position within a period */
+	bool residue;
+	spinlock_t lock;
+	wait_queue_head_t wait;
+};
+
 #endif
 
 struct sunxi_spi {
@@ -101,6 +145,11 @@ struct sunxi_spi {
 #if IS_ENABLED(CONFIG_DMA_ENGINE)
 	spi_dma_info_t dma_rx;
 	spi_dma_info_t dma_tx;
+	/* pinned transfer in flight */
+	struct sunxi_spi_pinned_xfer *pinned;
+	/* pinned message the clock and mode were last set up for */
+	struct sunxi_spi_pinned *pinned_setup;
+	struct sunxi_spi_slave_ring *ring;
 #endif
 
 	struct platform_device *pdev;
@@ -1004,11 +1053,32 @@ static int sunxi_spi_prepare_dma(struct device *dev, spi_dma_info_t *_info,
 	return 0;
 }
 
+static void sunxi_spi_dma_slave_config(struct sunxi_spi *sspi, struct dma_chan *chan,
+				       enum dma_transfer_direction dir, u32 len)
+{
+	struct dma_slave_config dma_conf = {0};
+
+	dma_conf.direction = dir;
+	if (dir == DMA_DEV_TO_MEM)
+		dma_conf.src_addr = sspi->base_addr_phy + SPI_RXDATA_REG;
+	else
+		dma_conf.dst_addr = sspi->base_addr_phy + SPI_TXDATA_REG;
+	if (len%DMA_SLAVE_BUSWIDTH_4_BYTES) {
+		dma_conf.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
+		dma_conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
+	} else {
+		dma_conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+		dma_conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	}
+	dma_conf.src_maxburst = 4;
+	dma_conf.dst_maxburst = 4;
+	dmaengine_slave_config(chan, &dma_conf);
+}
+
 static int sunxi_spi_config_dma_rx(struct sunxi_spi *sspi, struct spi_transfer *t)
 {
 	int ret = 0;
 	int nents = 0;
-	struct dma_slave_config dma_conf = {0};
 	struct dma_async_tx_descriptor *dma_desc = NULL;
 	unsigned int i, j;
 	u8 buf[64], cnt = 0;
@@ -1031,18 +1101,7 @@ static int sunxi_spi_config_dma_rx(struct sunxi_spi *sspi, struct spi_transfer *
 	if (ret != 0)
 		return ret;
 
-	dma_conf.direction = DMA_DEV_TO_MEM;
-	dma_conf.src_addr = sspi->base_addr_phy + SPI_RXDATA_REG;
-	if (t->len%DMA_SLAVE_BUSWIDTH_4_BYTES) {
-		dma_conf.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
-		dma_conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
-	} else {
-		dma_conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-		dma_conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-	}
-	dma_conf.src_maxburst = 4;
-	dma_conf.dst_maxburst = 4;
-	dmaengine_slave_config(sspi->dma_rx.chan, &dma_conf);
+	sunxi_spi_dma_slave_config(sspi, sspi->dma_rx.chan, DMA_DEV_TO_MEM, t->len);
 
 	nents = dma_map_sg(&sspi->pdev->dev, sspi->dma_rx.sg,
 			   sspi->dma_rx.nents, DMA_FROM_DEVICE);
@@ -1076,7 +1135,6 @@ static int sunxi_spi_config_dma_tx(struct sunxi_spi *sspi, struct spi_transfer *
 {
 	int ret = 0;
 	int nents = 0;
-	struct dma_slave_config dma_conf = {0};
 	struct dma_async_tx_descriptor *dma_desc = NULL;
 	unsigned int i, j;
 	u8 buf[64], cnt = 0;
@@ -1100,18 +1158,7 @@ static int sunxi_spi_config_dma_tx(struct sunxi_spi *sspi, struct spi_transfer *
 	if (ret != 0)
 		return ret;
 
-	dma_conf.direction = DMA_MEM_TO_DEV;
-	dma_conf.dst_addr = sspi->base_addr_phy + SPI_TXDATA_REG;
-	if (t->len%DMA_SLAVE_BUSWIDTH_4_BYTES) {
-		dma_conf.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
-		dma_conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
-	} else {
-		dma_conf.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-		dma_conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-	}
-	dma_conf.src_maxburst = 4;
-	dma_conf.dst_maxburst = 4;
-	dmaengine_slave_config(sspi->dma_tx.chan, &dma_conf);
+	sunxi_spi_dma_slave_config(sspi, sspi->dma_tx.chan, DMA_MEM_TO_DEV, t->len);
 
 	nents = dma_map_sg(&sspi->pdev->dev, sspi->dma_tx.sg, sspi->dma_tx.nents, DMA_TO_DEVICE);
 	if (!nents) {
@@ -1188,6 +1235,123 @@ static int sunxi_spi_release_dma(struct sunxi_spi *sspi, struct spi_transfer *t)
 	spin_unlock_irqrestore(&sspi->lock, flags);
 	return 0;
 }
+
+/* ------------------------------- pinned message ----------------------- */
+static struct sunxi_spi_pinned *sunxi_spi_msg_pinned(struct spi_message *msg)
+{
+	struct sunxi_spi_pinned *pin = msg ? msg->state : NULL;
+
+	return (pin && pin->msg == msg) ? pin : NULL;
+}
+
+static struct sunxi_spi_pinned_xfer *sunxi_spi_pinned_lookup(struct sunxi_spi_pinned *pin,
+							     struct spi_transfer *t)
+{
+	int i;
+
+	for (i = 0; i < pin->nr_xfers; i++) {
+		if (pin->xfers[i].t == t)
+			return &pin->xfers[i];
+	}
+	return NULL;
+}
+
+/* map the buffer and prepare a reusable descriptor, done once per pin */
+static int sunxi_spi_pin_dma(struct sunxi_spi *sspi, spi_dma_info_t *info,
+			     enum spi_dma_dir dir, const char *name,
+			     struct sunxi_spi_pinned_dma *pd, void *buf, u32 len)
+{
+	struct device *dev = &sspi->pdev->dev;
+	enum dma_transfer_direction tdir;
+	int ret;
+
+	if (!virt_addr_valid(buf) || !virt_addr_valid(buf + len - 1))
+		return -EOPNOTSUPP;
+
+	/* keep dir untouched, the buffer is not unmapped by sunxi_spi_release_dma() */
+	if (IS_ERR_OR_NULL(info->chan)) {
+		info->chan = dma_request_chan(dev, name);
+		if (IS_ERR(info->chan)) {
+			ret = PTR_ERR(info->chan);
+			info->chan = NULL;
+			return ret;
+		}
+	}
+
+	tdir = (dir == SPI_DMA_RDEV) ? DMA_DEV_TO_MEM : DMA_MEM_TO_DEV;
+	sunxi_spi_dma_slave_config(sspi, info->chan, tdir, len);
+
+	sg_init_one(&pd->sg, buf, len);
+	if (!dma_map_sg(dev, &pd->sg, 1, (enum dma_data_direction)dir))
+		return -ENOMEM;
+
+	pd->desc = dmaengine_prep_slave_sg(info->chan, &pd->sg, 1, tdir,
+					   DMA_PREP_INTERRUPT|DMA_CTRL_ACK);
+	if (!pd->desc)
+		goto err_unmap;
+
+	if (dmaengine_desc_set_reuse(pd->desc)) {
+		dmaengine_desc_free(pd->desc);
+		pd->desc = NULL;
+		goto err_unmap;
+	}
+
+	if (dir == SPI_DMA_RDEV)
+		pd->desc->callback = sunxi_spi_dma_cb_rx;
+	else
+		pd->desc->callback = sunxi_spi_dma_cb_tx;
+	pd->desc->callback_param = (void *)sspi;
+	return 0;
+
+err_unmap:
+	dma_unmap_sg(dev, &pd->sg, 1, (enum dma_data_direction)dir);
+	return -EOPNOTSUPP;
+}
+
+static void sunxi_spi_unpin_dma(struct sunxi_spi *sspi, struct sunxi_spi_pinned_dma *pd,
+				enum spi_dma_dir dir)
+{
+	if (!pd->desc)
+		return;
+
+	dmaengine_desc_free(pd->desc);
+	pd->desc = NULL;
+	dma_unmap_sg(&sspi->pdev->dev, &pd->sg, 1, (enum dma_data_direction)dir);
+}
+
+/* hand the pre-mapped buffer back to the device and kick the prepared descriptor */
+static int sunxi_spi_pinned_submit(struct sunxi_spi *sspi, struct dma_chan *chan,
+				   struct sunxi_spi_pinned_dma *pd, enum spi_dma_dir dir)
+{
+	dma_sync_sg_for_device(&sspi->pdev->dev, &pd->sg, 1, (enum dma_data_direction)dir);
+	if (dma_submit_error(dmaengine_submit(pd->desc)))
+		return -EIO;
+
+	dma_async_issue_pending(chan);
+	return 0;
+}
+
+static void sunxi_spi_pinned_finish(struct sunxi_spi *sspi, struct sunxi_spi_pinned_xfer *px,
+				    int error)
+{
+	/*
+	 * The callback runs before the descriptor goes back to the allocated
+	 * list, wait for the completion tasklet before it can be resubmitted.
+	 */
+	if (px->rx.desc) {
+		if (error)
+			dmaengine_terminate_sync(sspi->dma_rx.chan);
+		else
+			dmaengine_synchronize(sspi->dma_rx.chan);
+		dma_sync_sg_for_cpu(&sspi->pdev->dev, &px->rx.sg, 1, DMA_FROM_DEVICE);
+	}
+	if (px->tx.desc) {
+		if (error)
+			dmaengine_terminate_sync(sspi->dma_tx.chan);
+		else
+			dmaengine_synchronize(sspi->dma_tx.chan);
+	}
+}
 #endif
 
 /* sunxi_spi_set_cs : spi control set cs to connect device
@@ -1226,6 +1390,9 @@ static int sunxi_spi_xfer_setup(struct spi_device *spi, struct spi_transfer *t)
 	void __iomem *base_addr = sspi->base_addr;
 
 	spi_speed_hz  = (t && t->speed_hz) ? t->speed_hz : spi->max_speed_hz;
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	sspi->pinned_setup = NULL;
+#endif
 
 	if (sspi->sample_delay == SAMP_MODE_DL_DEFAULT) {
 		if (spi_speed_hz >= SPI_HIGH_FREQUENCY)
@@ -1413,6 +1580,9 @@ static int sunxi_spi_dma_rx_config(struct spi_device *spi, struct spi_transfer *
 
 	/* rxFIFO reday dma request enable */
 	spi_enable_dma_irq(SPI_FIFO_CTL_RX_DRQEN, base_addr);
+	if (sspi->pinned && sspi->pinned->rx.desc)
+		return sunxi_spi_pinned_submit(sspi, sspi->dma_rx.chan,
+					       &sspi->pinned->rx, SPI_DMA_RDEV);
 	ret = sunxi_spi_prepare_dma(&sspi->pdev->dev, &sspi->dma_rx,
 				SPI_DMA_RDEV, "rx");
 	if (ret < 0) {
@@ -1433,6 +1603,9 @@ static int sunxi_spi_dma_tx_config(struct spi_device *spi, struct spi_transfer *
 	int ret = 0;
 
 	spi_enable_dma_irq(SPI_FIFO_CTL_TX_DRQEN, base_addr);
+	if (sspi->pinned && sspi->pinned->tx.desc)
+		return sunxi_spi_pinned_submit(sspi, sspi->dma_tx.chan,
+					       &sspi->pinned->tx, SPI_DMA_WDEV);
 	ret = sunxi_spi_prepare_dma(&sspi->pdev->dev, &sspi->dma_tx,
 				SPI_DMA_WDEV, "tx");
 	if (ret < 0) {
@@ -1591,17 +1764,31 @@ static int sunxi_spi_transfer_one(struct spi_controller *master,
 	unsigned long timeout = 0;
 	int ret = 0;
 	static int xfer_setup;
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	struct sunxi_spi_pinned *pin = sunxi_spi_msg_pinned(master->cur_msg);
+	struct sunxi_spi_pinned_xfer *px = pin ? sunxi_spi_pinned_lookup(pin, t) : NULL;
+#endif
 
 	dprintk(DEBUG_INFO, "[spi%d] begin transfer, txbuf %p, rxbuf %p, len %d\n",
 		spi->master->bus_num, tx_buf, rx_buf, t->len);
 	if ((!t->tx_buf && !t->rx_buf) || !t->len)
 		return -EINVAL;
 
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	/* a pinned message at one speed only needs the clock set up once */
+	if (!px || !pin->speed_hz || sspi->pinned_setup != pin)
+#endif
 	if (!xfer_setup || spi->master->bus_num) {
 		if (sunxi_spi_xfer_setup(spi, t) < 0)
 			return -EINVAL;
 		xfer_setup = 1;
 	}
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	if (px) {
+		sspi->pinned = px;
+		sspi->pinned_setup = pin;
+	}
+#endif
 
 	/* write 1 to clear 0 */
 	spi_clr_irq_pending(SPI_INT_STA_MASK, base_addr);
@@ -1656,6 +1843,11 @@ static int sunxi_spi_transfer_one(struct spi_controller *master,
 	}
 
 #if IS_ENABLED(CONFIG_DMA_ENGINE)
+	if (sspi->pinned) {
+		sunxi_spi_pinned_finish(sspi, sspi->pinned, ret);
+		sspi->pinned = NULL;
+	}
+
 	/* release dma resource if necessary */
 	sunxi_spi_release_dma(sspi, t);
 
@@ -1668,6 +1860,111 @@ static int sunxi_spi_transfer_one(struct spi_controller *master,
 
 	return ret;
 }
+
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+void sunxi_spi_unpin_message(struct sunxi_spi_pinned *pin)
+{
+	struct sunxi_spi *sspi;
+	int i;
+
+	if (IS_ERR_OR_NULL(pin))
+		return;
+
+	sspi = spi_master_get_devdata(pin->spi->master);
+	for (i = 0; i < pin->nr_xfers; i++) {
+		sunxi_spi_unpin_dma(sspi, &pin->xfers[i].rx, SPI_DMA_RDEV);
+		sunxi_spi_unpin_dma(sspi, &pin->xfers[i].tx, SPI_DMA_WDEV);
+	}
+
+	if (sspi->pinned_setup == pin)
+		sspi->pinned_setup = NULL;
+	if (pin->msg->state == pin)
+		pin->msg->state = NULL;
+	kfree(pin);
+}
+EXPORT_SYMBOL_GPL(sunxi_spi_unpin_message);
+
+/*
+ * Map the buffers of @msg and prepare reusable dma descriptors for its
+ * transfers above BULK_DATA_BOUNDARY, the rest still go through the fifo.
+ * Buffers must be in the linear mapping, one sg entry per direction.
+ */
+struct sunxi_spi_pinned *sunxi_spi_pin_message(struct spi_device *spi, struct spi_message *msg)
+{
+	struct spi_master *master = spi->master;
+	struct sunxi_spi *sspi;
+	struct sunxi_spi_pinned *pin;
+	struct sunxi_spi_pinned_xfer *px;
+	struct spi_transfer *t;
+	u32 speed_hz;
+	int n = 0, ret;
+
+	if (master->transfer_one != sunxi_spi_transfer_one)
+		return ERR_PTR(-ENODEV);
+
+	sspi = spi_master_get_devdata(master);
+	if (sspi->mode || sspi->dbi_enabled)
+		return ERR_PTR(-EOPNOTSUPP);
+
+	list_for_each_entry(t, &msg->transfers, transfer_list)
+		n++;
+	if (!n)
+		return ERR_PTR(-EINVAL);
+
+	pin = kzalloc(struct_size(pin, xfers, n), GFP_KERNEL);
+	if (!pin)
+		return ERR_PTR(-ENOMEM);
+
+	pin->spi = spi;
+	pin->msg = msg;
+
+	px = pin->xfers;
+	list_for_each_entry(t, &msg->transfers, transfer_list) {
+		speed_hz = t->speed_hz ? t->speed_hz : spi->max_speed_hz;
+		if (!pin->nr_xfers)
+			pin->speed_hz = speed_hz;
+		else if (pin->speed_hz != speed_hz)
+			pin->speed_hz = 0;
+
+		px->t = t;
+		pin->nr_xfers++;
+
+		if (t->len > BULK_DATA_BOUNDARY && t->rx_buf) {
+			ret = sunxi_spi_pin_dma(sspi, &sspi->dma_rx, SPI_DMA_RDEV, "rx",
+						&px->rx, t->rx_buf, t->len);
+			if (ret)
+				goto err;
+		}
+		if (t->len > BULK_DATA_BOUNDARY && t->tx_buf) {
+			ret = sunxi_spi_pin_dma(sspi, &sspi->dma_tx, SPI_DMA_WDEV, "tx",
+						&px->tx, (void *)t->tx_buf, t->len);
+			if (ret)
+				goto err;
+		}
+		px++;
+	}
+
+	msg->state = pin;
+	dprintk(DEBUG_INFO, "[spi%d] pinned message, %d transfers\n",
+		master->bus_num, pin->nr_xfers);
+	return pin;
+
+err:
+	SPI_ERR("[spi%d] failed to pin message: %d\n", master->bus_num, ret);
+	sunxi_spi_unpin_message(pin);
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL_GPL(sunxi_spi_pin_message);
+
+/* the core still owns queueing, chip select and statistics */
+int sunxi_spi_sync_pinned(struct sunxi_spi_pinned *pin)
+{
+	pin->msg->state = pin;
+	return spi_sync(pin->spi, pin->msg);
+}
+EXPORT_SYMBOL_GPL(sunxi_spi_sync_pinned);
+#endif
+
 #ifdef CONFIG_AW_MTD_SPINAND
 /* tx_len : all data to transfer(single io tx data + quad io tx data)
  * stc_len: single io tx data */
@@ -2181,6 +2478,14 @@ static irqreturn_t sunxi_spi_handler(int irq, void *dev_id)
 
 	sspi->result = 0; /* assume succeed */
 
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	/* the master let go of cs, the reader picks up the partial period */
+	if (sspi->ring && (enable & SPI_INTEN_SSI) && (status & SPI_INT_STA_SSI)) {
+		wake_up_interruptible(&sspi->ring->wait);
+		return IRQ_HANDLED;
+	}
+#endif
+
 	if (sspi->mode) {
 		if ((enable & SPI_INTEN_RX_RDY) && (status & SPI_INT_STA_RX_RDY)) {
 			dprintk(DEBUG_INFO, "[spi%d] spi data is ready\n", sspi->master->bus_num);
@@ -2255,6 +2560,11 @@ static int sunxi_spi_setup(struct spi_device *spi)
 static bool sunxi_spi_can_dma(struct spi_master *master, struct spi_device *spi,
 				 struct spi_transfer *xfer)
 {
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	/* pinned transfers are mapped once by sunxi_spi_pin_message() */
+	if (sunxi_spi_msg_pinned(master->cur_msg))
+		return false;
+#endif
 	return (xfer->len > BULK_DATA_BOUNDARY);
 }
 
@@ -2538,6 +2848,291 @@ static int sunxi_spi_slave_task(void *data)
 	return 0;
 }
 
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+/* ------------------------------- slave rx ring ----------------------- */
+/*
+ * @len more bytes have been written, the reader may lag by all but the
+ * period in flight. Called with ring->lock held.
+ */
+static void sunxi_spi_slave_ring_advance(struct sunxi_spi_slave_ring *ring, u32 len)
+{
+	u32 limit = ring->size - ring->period;
+
+	ring->head += len;
+	if (ring->head - ring->tail > limit) {
+		ring->overrun += ring->head - ring->tail - limit;
+		ring->tail = ring->head - limit;
+	}
+}
+
+/*
+ * Move head up to where the dma is, so a tail shorter than a period is
+ * seen without waiting for the master to clock in more. Called with
+ * ring->lock held.
+ */
+static void sunxi_spi_slave_ring_sync(struct sunxi_spi_slave_ring *ring)
+{
+	struct dma_chan *chan = ring->sspi->dma_rx.chan;
+	struct dma_tx_state state;
+	u32 pos;
+
+	if (!ring->residue || !chan)
+		return;
+	if (dmaengine_tx_status(chan, ring->cookie, &state) != DMA_IN_PROGRESS)
+		return;
+
+	/* the residue counts down from the ring size to the end of the lap */
+	pos = (ring->size - state.residue) & (ring->size - 1);
+	sunxi_spi_slave_ring_advance(ring, (pos - (u32)ring->head) & (ring->size - 1));
+}
+
+static u64 sunxi_spi_slave_ring_avail(struct sunxi_spi_slave_ring *ring)
+{
+	unsigned long flags;
+	u64 avail;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	sunxi_spi_slave_ring_sync(ring);
+	avail = ring->head - ring->tail;
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	return avail;
+}
+
+/* at least one period has been written since the last callback */
+static void sunxi_spi_slave_ring_cb(void *data)
+{
+	struct sunxi_spi_slave_ring *ring = (struct sunxi_spi_slave_ring *)data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	if (ring->residue)
+		sunxi_spi_slave_ring_sync(ring);
+	else
+		sunxi_spi_slave_ring_advance(ring, ring->period);
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	wake_up_interruptible(&ring->wait);
+}
+
+static int sunxi_spi_slave_ring_start(struct sunxi_spi_slave_ring *ring)
+{
+	struct sunxi_spi *sspi = ring->sspi;
+	void __iomem *base_addr = sspi->base_addr;
+	struct dma_slave_config dma_conf = {0};
+	struct dma_async_tx_descriptor *dma_desc;
+	struct dma_slave_caps caps;
+	unsigned long flags;
+	bool residue;
+	int ret;
+
+	ret = sunxi_spi_prepare_dma(&sspi->pdev->dev, &sspi->dma_rx,
+				    SPI_DMA_RDEV, "rx");
+	if (ret < 0) {
+		sspi->dma_rx.chan = NULL;
+		return ret;
+	}
+
+	residue = !dma_get_slave_caps(sspi->dma_rx.chan, &caps) &&
+		  caps.residue_granularity != DMA_RESIDUE_GRANULARITY_DESCRIPTOR;
+
+	/* the amount a master clocks in is unknown, move it byte by byte */
+	dma_conf.direction = DMA_DEV_TO_MEM;
+	dma_conf.src_addr = sspi->base_addr_phy + SPI_RXDATA_REG;
+	dma_conf.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
+	dma_conf.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
+	dma_conf.src_maxburst = 1;
+	dma_conf.dst_maxburst = 1;
+	dmaengine_slave_config(sspi->dma_rx.chan, &dma_conf);
+
+	dma_desc = dmaengine_prep_dma_cyclic(sspi->dma_rx.chan, ring->dma,
+					     ring->size, ring->period,
+					     DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!dma_desc) {
+		SPI_ERR("[spi%d] dmaengine_prep_dma_cyclic() failed!\n",
+			sspi->master->bus_num);
+		return -ENOMEM;
+	}
+	dma_desc->callback = sunxi_spi_slave_ring_cb;
+	dma_desc->callback_param = (void *)ring;
+
+	/* the dma restarts at the beginning of the ring */
+	spin_lock_irqsave(&ring->lock, flags);
+	ring->head = 0;
+	ring->tail = 0;
+	ring->residue = residue;
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	spi_reset_fifo(base_addr);
+	spi_set_rx_trig(1, base_addr);
+	spi_clr_irq_pending(SPI_INT_STA_MASK, base_addr);
+	spi_disable_irq(SPI_INTEN_MASK, base_addr);
+	spi_set_bc_tc_stc(0, 0, 0, 0, base_addr);
+	spi_enable_dma_irq(SPI_FIFO_CTL_RX_DRQEN, base_addr);
+	/* cs deassert flushes a partial period to the reader */
+	spi_enable_irq(SPI_INTEN_SSI, base_addr);
+
+	spin_lock_irqsave(&ring->lock, flags);
+	ring->cookie = dmaengine_submit(dma_desc);
+	spin_unlock_irqrestore(&ring->lock, flags);
+	dma_async_issue_pending(sspi->dma_rx.chan);
+
+	return 0;
+}
+
+static void sunxi_spi_slave_ring_stop(struct sunxi_spi_slave_ring *ring)
+{
+	struct sunxi_spi *sspi = ring->sspi;
+
+	spi_disable_irq(SPI_INTEN_SSI, sspi->base_addr);
+	spi_disable_dma_irq(SPI_FIFO_CTL_DRQEN_MASK, sspi->base_addr);
+	if (sspi->dma_rx.chan)
+		dmaengine_terminate_sync(sspi->dma_rx.chan);
+	spi_reset_fifo(sspi->base_addr);
+}
+
+static ssize_t sunxi_spi_slave_ring_read(struct file *file, char __user *ubuf,
+					 size_t count, loff_t *ppos)
+{
+	struct sunxi_spi_slave_ring *ring = container_of(file->private_data,
+							 struct sunxi_spi_slave_ring, misc);
+	unsigned long flags;
+	u64 tail;
+	u32 off, len;
+	int ret;
+
+	if (!count)
+		return 0;
+
+	if (!(file->f_flags & O_NONBLOCK)) {
+		ret = wait_event_interruptible(ring->wait,
+					       sunxi_spi_slave_ring_avail(ring));
+		if (ret)
+			return ret;
+	}
+
+	spin_lock_irqsave(&ring->lock, flags);
+	sunxi_spi_slave_ring_sync(ring);
+	tail = ring->tail;
+	len = min_t(u64, ring->head - tail, count);
+	spin_unlock_irqrestore(&ring->lock, flags);
+	if (!len)
+		return -EAGAIN;
+
+	/* straight from the coherent ring, no bounce buffer */
+	off = tail & (ring->size - 1);
+	len = min(len, ring->size - off);
+	if (copy_to_user(ubuf, ring->buf + off, len))
+		return -EFAULT;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	if (ring->tail != tail) {
+		/* lapped by the dma while copying, the data may be torn */
+		spin_unlock_irqrestore(&ring->lock, flags);
+		return -EOVERFLOW;
+	}
+	ring->tail += len;
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	return len;
+}
+
+static __poll_t sunxi_spi_slave_ring_poll(struct file *file, poll_table *wait)
+{
+	struct sunxi_spi_slave_ring *ring = container_of(file->private_data,
+							 struct sunxi_spi_slave_ring, misc);
+
+	poll_wait(file, &ring->wait, wait);
+
+	return sunxi_spi_slave_ring_avail(ring) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+static const struct file_operations sunxi_spi_slave_ring_fops = {
+	.owner		= THIS_MODULE,
+	.read		= sunxi_spi_slave_ring_read,
+	.poll		= sunxi_spi_slave_ring_poll,
+	.llseek		= noop_llseek,
+};
+
+/*
+ * "slave-ring-size" replaces the packet protocol of the slave task with a
+ * cyclic rx dma into a ring of that size, read through /dev/spiN-ring.
+ */
+static int sunxi_spi_slave_ring_init(struct sunxi_spi *sspi)
+{
+	struct device_node *np = sspi->pdev->dev.of_node;
+	struct sunxi_spi_slave_ring *ring;
+	u32 size = 0, period = 0;
+	int ret;
+
+	if (of_property_read_u32(np, "slave-ring-size", &size) || !size)
+		return -ENOENT;
+	if (of_property_read_u32(np, "slave-ring-period", &period))
+		period = size / 4;
+
+	if (!is_power_of_2(size) || !is_power_of_2(period) || period >= size) {
+		SPI_ERR("[spi%d] invalid slave ring %u/%u\n",
+			sspi->master->bus_num, size, period);
+		return -EINVAL;
+	}
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
+
+	ring->sspi = sspi;
+	ring->size = size;
+	ring->period = period;
+	spin_lock_init(&ring->lock);
+	init_waitqueue_head(&ring->wait);
+
+	ring->buf = dma_alloc_coherent(&sspi->pdev->dev, size, &ring->dma, GFP_KERNEL);
+	if (!ring->buf) {
+		ret = -ENOMEM;
+		goto err0;
+	}
+
+	ret = sunxi_spi_slave_ring_start(ring);
+	if (ret)
+		goto err1;
+
+	scnprintf(ring->name, sizeof(ring->name), "spi%d-ring", sspi->master->bus_num);
+	ring->misc.minor = MISC_DYNAMIC_MINOR;
+	ring->misc.name = ring->name;
+	ring->misc.fops = &sunxi_spi_slave_ring_fops;
+	ret = misc_register(&ring->misc);
+	if (ret)
+		goto err2;
+
+	sspi->ring = ring;
+	dprintk(DEBUG_INIT, "[spi%d] slave rx ring %u bytes, period %u\n",
+		sspi->master->bus_num, size, period);
+	return 0;
+
+err2:
+	sunxi_spi_slave_ring_stop(ring);
+err1:
+	dma_free_coherent(&sspi->pdev->dev, size, ring->buf, ring->dma);
+err0:
+	kfree(ring);
+	return ret;
+}
+
+static void sunxi_spi_slave_ring_exit(struct sunxi_spi *sspi)
+{
+	struct sunxi_spi_slave_ring *ring = sspi->ring;
+
+	if (!ring)
+		return;
+
+	misc_deregister(&ring->misc);
+	sunxi_spi_slave_ring_stop(ring);
+	dma_free_coherent(&sspi->pdev->dev, ring->size, ring->buf, ring->dma);
+	kfree(ring);
+	sspi->ring = NULL;
+}
+#endif
+
 static int sunxi_spi_select_gpio_state(struct pinctrl *pctrl, char *name, u32 no)
 {
 	int ret = 0;
@@ -2941,16 +3536,54 @@ static ssize_t sunxi_spi_status_show(struct device *dev,
 static struct device_attribute sunxi_spi_status_attr =
 	__ATTR(status, S_IRUGO, sunxi_spi_status_show, NULL);
 
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+static ssize_t sunxi_spi_slave_ring_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct spi_master *master = platform_get_drvdata(to_platform_device(dev));
+	struct sunxi_spi *sspi = spi_master_get_devdata(master);
+	struct sunxi_spi_slave_ring *ring = sspi->ring;
+	unsigned long flags;
+	u64 head, tail, overrun;
+
+	if (!ring)
+		return scnprintf(buf, PAGE_SIZE, "disabled\n");
+
+	spin_lock_irqsave(&ring->lock, flags);
+	sunxi_spi_slave_ring_sync(ring);
+	head = ring->head;
+	tail = ring->tail;
+	overrun = ring->overrun;
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	return scnprintf(buf, PAGE_SIZE,
+			"size     = %u\n"
+			"period   = %u\n"
+			"received = %llu\n"
+			"pending  = %llu\n"
+			"overrun  = %llu\n",
+			ring->size, ring->period, head, head - tail, overrun);
+}
+static struct device_attribute sunxi_spi_slave_ring_attr =
+	__ATTR(slave_ring, S_IRUGO, sunxi_spi_slave_ring_show, NULL);
+#endif
+
 static void sunxi_spi_create_sysfs(struct platform_device *_pdev)
 {
 	device_create_file(&_pdev->dev, &sunxi_spi_info_attr);
 	device_create_file(&_pdev->dev, &sunxi_spi_status_attr);
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	device_create_file(&_pdev->dev, &sunxi_spi_slave_ring_attr);
+#endif
 }
 
 static void sunxi_spi_remove_sysfs(struct platform_device *_pdev)
 {
 	device_remove_file(&_pdev->dev, &sunxi_spi_info_attr);
 	device_remove_file(&_pdev->dev, &sunxi_spi_status_attr);
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	device_remove_file(&_pdev->dev, &sunxi_spi_slave_ring_attr);
+#endif
 }
 
 static int sunxi_spi_probe(struct platform_device *pdev)
@@ -3124,6 +3757,16 @@ static int sunxi_spi_probe(struct platform_device *pdev)
 		}
 		sspi->slave = slave;
 		sspi->slave->set_up_txdata = sunxi_spi_slave_set_txdata;
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+		ret = sunxi_spi_slave_ring_init(sspi);
+		if (ret != -ENOENT) {
+			if (ret) {
+				SPI_ERR("[spi%d] slave ring init failed\n", sspi->master->bus_num);
+				goto err6;
+			}
+			goto out;
+		}
+#endif
 		sspi->task = kthread_create(sunxi_spi_slave_task, sspi, "spi_slave");
 		if (IS_ERR(sspi->task)) {
 			SPI_ERR("[spi%d] unable to start kernel thread.\n", sspi->master->bus_num);
@@ -3142,6 +3785,9 @@ static int sunxi_spi_probe(struct platform_device *pdev)
 		}
 	}
 
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+out:
+#endif
 	sunxi_spi_create_sysfs(pdev);
 
 	dprintk(DEBUG_INFO, "[spi%d] loaded for Bus with %d Slaves at most\n",
@@ -3191,7 +3837,10 @@ static int sunxi_spi_remove(struct platform_device *pdev)
 	sunxi_spi_remove_sysfs(pdev);
 	spi_unregister_master(master);
 
-	if (sspi->mode)
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	sunxi_spi_slave_ring_exit(sspi);
+#endif
+	if (sspi->mode && sspi->task)
 		if (!sspi->task_flag)
 			if (!IS_ERR(sspi->task))
 				kthread_stop(sspi->task);
@@ -3229,6 +3878,10 @@ static int sunxi_spi_suspend(struct device *dev)
 	while (sspi->busy & SPI_BUSY)
 		msleep(10);
 
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	if (sspi->ring)
+		sunxi_spi_slave_ring_stop(sspi->ring);
+#endif
 	sunxi_spi_hw_exit(sspi, pdev->dev.platform_data);
 
 	dprintk(DEBUG_SUSPEND, "[spi%d] suspend finish\n", master->bus_num);
@@ -3244,6 +3897,12 @@ static int sunxi_spi_resume(struct device *dev)
 	unsigned long flags;
 
 	sunxi_spi_hw_init(sspi, pdev->dev.platform_data, dev);
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+	/* the clock is back at its default */
+	sspi->pinned_setup = NULL;
+	if (sspi->ring && sunxi_spi_slave_ring_start(sspi->ring))
+		SPI_ERR("[spi%d] failed to restart slave ring\n", master->bus_num);
+#endif
 
 	spin_lock_irqsave(&sspi->lock, flags);
 	sspi->busy = SPI_FREE;
@@ -3301,4 +3960,4 @@ MODULE_AUTHOR("pannan");
 MODULE_DESCRIPTION("SUNXI SPI BUS Driver");
 MODULE_ALIAS("platform:"SUNXI_SPI_DEV_NAME);
 MODULE_LICENSE("GPL");
-MODULE_VERSION("1.0.2");
+MODULE_VERSION("1.0.3");
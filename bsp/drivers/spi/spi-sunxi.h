@@ -353,4 +353,16 @@ extern int spi_set_dbi_config(struct spi_device *spi, const struct spi_dbi_confi
 extern int sunxi_spi_sync_atomic(struct spi_device *spi, struct spi_message *message);
 #endif
 
+#if IS_ENABLED(CONFIG_DMA_ENGINE)
+/*
+ * Pinned messages: the buffers of a recurring spi_message are mapped and its
+ * dma descriptors prepared once, each sunxi_spi_sync_pinned() only resubmits
+ * them. The message and its buffers must stay unchanged while pinned.
+ */
+struct sunxi_spi_pinned;
+extern struct sunxi_spi_pinned *sunxi_spi_pin_message(struct spi_device *spi, struct spi_message *msg);
+extern int sunxi_spi_sync_pinned(struct sunxi_spi_pinned *pin);
+extern void sunxi_spi_unpin_message(struct sunxi_spi_pinned *pin);
+#endif
+
 #endif
@@ -5,6 +5,10 @@
 
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/etherdevice.h>
+#include <linux/interrupt.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 #include <linux/of_address.h>
 #include <linux/of_platform.h>
 #include <linux/of_net.h>
@@ -22,7 +26,7 @@
 #include "hwif.h"
 
 #define DRIVER_NAME	"sunxi_uio"
-#define DRIVER_VERSION	"0.0.1"
+#define DRIVER_VERSION	"0.1.0"
 
 #define TC_DEFAULT 64
 static int tc = TC_DEFAULT;
@@ -32,32 +36,117 @@ static int buf_sz = DEFAULT_BUFSIZE;
 
 #define STMMAC_RX_COPYBREAK	256
 
+/* rings and buffers come from whole hugepages */
+#define SUNXI_UIO_POOL_ALIGN	PMD_SIZE
+
+/* per queue uio memory maps */
+#define SUNXI_UIO_MAP_REGS	0
+#define SUNXI_UIO_MAP_RX_BD	1
+#define SUNXI_UIO_MAP_TX_BD	2
+#define SUNXI_UIO_MAP_BUF	3
+#define SUNXI_UIO_MAP_NUM	4
+
+#define SUNXI_UIO_BENCH_TIMEOUT	msecs_to_jiffies(5000)
+
+struct sunxi_uio;
+
 /**
- * sunxi_uio
- * local information for uio module driver
+ * sunxi_uio_queue
+ * one uio device per RX/TX queue pair
  *
- * @dev:      device pointer
- * @ndev:     network device pointer
+ * @chip:     parent uio module driver
+ * @chan:     queue and DMA channel index
  * @name:     uio name
  * @uio:      uio information
- * @map_num:  number of uio memory regions
+ * @rx_irq:   dedicated RX interrupt line, 0 if shared
+ * @tx_irq:   dedicated TX interrupt line, 0 if shared
+ * @rx_*:     RX descriptor ring in the pool
+ * @tx_*:     TX descriptor ring in the pool
+ * @buf_*:    packet buffers in the pool, RX buffers first
+ */
+struct sunxi_uio_queue {
+	struct sunxi_uio *chip;
+	u32 chan;
+	char name[24];
+	struct uio_info uio;
+	bool registered;
+	int rx_irq;
+	int tx_irq;
+	dma_addr_t rx_phy;
+	void *rx_virt;
+	size_t rx_size;
+	dma_addr_t tx_phy;
+	void *tx_virt;
+	size_t tx_size;
+	dma_addr_t buf_phy;
+	void *buf_virt;
+	size_t buf_size;
+};
+
+/**
+ * sunxi_uio_bench
+ * result of the last loopback benchmark
+ */
+struct sunxi_uio_bench {
+	u32 queue;
+	u32 len;
+	u32 sent;
+	u32 received;
+	u64 ns;
+};
+
+/**
+ * sunxi_uio
+ * local information for uio module driver
+ *
+ * @dev:        device pointer
+ * @ndev:       network device pointer
+ * @map_num:    number of uio memory regions per queue
+ * @pool_*:     contiguous pool all rings and buffers are carved from
+ * @buf_stride: bytes per packet buffer
+ * @irq_lock:   protects the DMA channel interrupt enables
+ * @irq:        MAC interrupt line
+ * @users:      open uio devices
+ * @bench_lock: serializes the benchmark against uio users
+ * @nr_queues:  number of exported queue pairs
  */
 struct sunxi_uio {
 	struct device *dev;
 	struct net_device *ndev;
-	char name[16];
-	struct uio_info uio;
 	int map_num;
+	void *pool_virt;
+	dma_addr_t pool_phy;
+	size_t pool_size;
+	u32 buf_stride;
+	spinlock_t irq_lock;
+	int irq;
+	atomic_t users;
+	struct mutex bench_lock;
+	struct sunxi_uio_bench bench;
+	u32 nr_queues;
+	struct sunxi_uio_queue queue[MTL_MAX_TX_QUEUES];
 };
 
 static int sunxi_uio_open(struct uio_info *info, struct inode *inode)
 {
+	struct sunxi_uio_queue *q = info->priv;
+
+	/* the loopback benchmark rewrites the rings */
+	if (!mutex_trylock(&q->chip->bench_lock))
+		return -EBUSY;
+	atomic_inc(&q->chip->users);
+	mutex_unlock(&q->chip->bench_lock);
+
 	return 0;
 }
 
 static int sunxi_uio_release(struct uio_info *info,
 				     struct inode *inode)
 {
+	struct sunxi_uio_queue *q = info->priv;
+
+	atomic_dec(&q->chip->users);
+
 	return 0;
 }
 
@@ -68,7 +157,10 @@ static int sunxi_uio_mmap(struct uio_info *info,
 
 	pfn = (info->mem[vma->vm_pgoff].addr) >> PAGE_SHIFT;
 
-	if (vma->vm_pgoff)
+	/* packet buffers match the normal non-cacheable kernel mapping */
+	if (vma->vm_pgoff == SUNXI_UIO_MAP_BUF)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	else if (vma->vm_pgoff)
 		vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
 	else
 		vma->vm_page_prot = pgprot_device(vma->vm_page_prot);
@@ -83,187 +175,224 @@ static int sunxi_uio_mmap(struct uio_info *info,
 }
 
 /**
- * sunxi_uio_free_dma_rx_desc_resources - free RX dma desc resources
- * @priv: private structure
+ * sunxi_uio_queue_event - service the DMA channel of one queue
+ * @q: queue
+ * Description: the channel interrupt is one shot, it stays masked until
+ * userspace writes 1 to the uio device once it drained the rings. A
+ * polling queue simply never re-arms it.
  */
-static void sunxi_uio_free_dma_rx_desc_resources(struct stmmac_priv *priv)
+static bool sunxi_uio_queue_event(struct sunxi_uio_queue *q)
 {
-	u32 queue, rx_count = priv->plat->rx_queues_to_use;
+	struct stmmac_priv *priv = netdev_priv(q->chip->ndev);
+	int status;
 
-	/* Free RX queue resources */
-	for (queue = 0; queue < rx_count; queue++) {
-		struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5, 15, 0))
+	status = stmmac_dma_interrupt_status(priv, priv->ioaddr, &priv->xstats,
+					     q->chan);
+#else
+	status = stmmac_dma_interrupt_status(priv, priv->ioaddr, &priv->xstats,
+					     q->chan, DMA_DIR_RXTX);
+#endif
+	if (!(status & (handle_rx | handle_tx)))
+		return false;
 
-		/* Free DMA regions of consistent memory previously allocated */
-		if (!priv->extend_desc)
-			dma_free_coherent(priv->device, priv->dma_rx_size *
-					  sizeof(struct dma_desc),
-					  rx_q->dma_rx, rx_q->dma_rx_phy);
-		else
-			dma_free_coherent(priv->device, priv->dma_rx_size *
-					  sizeof(struct dma_extended_desc),
-					  rx_q->dma_erx, rx_q->dma_rx_phy);
-	}
+	spin_lock(&q->chip->irq_lock);
+	stmmac_disable_dma_irq(priv, priv->ioaddr, q->chan, true, true);
+	spin_unlock(&q->chip->irq_lock);
+
+	uio_event_notify(&q->uio);
+
+	return true;
 }
 
-/**
- * sunxi_uio_free_dma_tx_desc_resources - free TX dma desc resources
- * @priv: private structure
- */
-static void sunxi_uio_free_dma_tx_desc_resources(struct stmmac_priv *priv)
-{
-	u32 queue, tx_count = priv->plat->tx_queues_to_use;
-
-	/* Free TX queue resources */
-	for (queue = 0; queue < tx_count; queue++) {
-		struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
-		size_t size;
-		void *addr;
-
-		if (priv->extend_desc) {
-			size = sizeof(struct dma_extended_desc);
-			addr = tx_q->dma_etx;
-		} else if (tx_q->tbs & STMMAC_TBS_AVAIL) {
-			size = sizeof(struct dma_edesc);
-			addr = tx_q->dma_entx;
-		} else {
-			size = sizeof(struct dma_desc);
-			addr = tx_q->dma_tx;
-		}
+static irqreturn_t sunxi_uio_interrupt(int irq, void *dev_id)
+{
+	struct sunxi_uio *chip = dev_id;
+	struct stmmac_priv *priv = netdev_priv(chip->ndev);
+	u32 queue;
 
-		size *= priv->dma_tx_size;
+	/* ack MAC and MTL events, userspace only owns the data path */
+	stmmac_host_irq_status(priv, priv->hw, &priv->xstats);
 
-		dma_free_coherent(priv->device, size, addr, tx_q->dma_tx_phy);
+	for (queue = 0; queue < chip->nr_queues; queue++) {
+		stmmac_host_mtl_irq_status(priv, priv->hw, queue);
+		sunxi_uio_queue_event(&chip->queue[queue]);
 	}
+
+	return IRQ_HANDLED;
 }
 
-/**
- * sunxi_uio_alloc_dma_rx_desc_resources - alloc RX resources.
- * @priv: private structure
- * Description: according to which descriptor can be used (extend or basic)
- * this function allocates the resources for TX and RX paths. In case of
- * reception, for example, it pre-allocated the RX socket buffer in order to
- * allow zero-copy mechanism.
- */
-static int sunxi_uio_alloc_dma_rx_desc_resources(struct stmmac_priv *priv)
-{
-	u32 queue, rx_count = priv->plat->rx_queues_to_use;
-	int ret = -ENOMEM;
-
-	/* RX queues buffers and DMA */
-	for (queue = 0; queue < rx_count; queue++) {
-		struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
-
-		if (priv->extend_desc) {
-			rx_q->dma_erx = dma_alloc_coherent(priv->device,
-							   priv->dma_rx_size *
-							   sizeof(struct dma_extended_desc),
-							   &rx_q->dma_rx_phy,
-							   GFP_KERNEL);
-			if (!rx_q->dma_erx)
-				goto err_dma;
-		} else {
-			rx_q->dma_rx = dma_alloc_coherent(priv->device,
-							  priv->dma_rx_size *
-							  sizeof(struct dma_desc),
-							  &rx_q->dma_rx_phy,
-							  GFP_KERNEL);
-			if (!rx_q->dma_rx)
-				goto err_dma;
-		}
-	}
+static irqreturn_t sunxi_uio_queue_interrupt(int irq, void *dev_id)
+{
+	sunxi_uio_queue_event(dev_id);
 
-	return 0;
+	return IRQ_HANDLED;
+}
 
-err_dma:
-	sunxi_uio_free_dma_rx_desc_resources(priv);
+static int sunxi_uio_irqcontrol(struct uio_info *info, s32 irq_on)
+{
+	struct sunxi_uio_queue *q = info->priv;
+	struct stmmac_priv *priv = netdev_priv(q->chip->ndev);
+	unsigned long flags;
 
-	return ret;
+	spin_lock_irqsave(&q->chip->irq_lock, flags);
+	if (irq_on)
+		stmmac_enable_dma_irq(priv, priv->ioaddr, q->chan, true, true);
+	else
+		stmmac_disable_dma_irq(priv, priv->ioaddr, q->chan, true, true);
+	spin_unlock_irqrestore(&q->chip->irq_lock, flags);
+
+	return 0;
 }
 
-/**
- * sunxi_uio_alloc_dma_tx_desc_resources - alloc TX resources.
- * @priv: private structure
- * Description: according to which descriptor can be used (extend or basic)
- * this function allocates the resources for TX and RX paths. In case of
- * reception, for example, it pre-allocated the RX socket buffer in order to
- * allow zero-copy mechanism.
- */
-static int sunxi_uio_alloc_dma_tx_desc_resources(struct stmmac_priv *priv)
+static size_t sunxi_uio_rx_desc_size(struct stmmac_priv *priv)
 {
-	u32 queue, tx_count = priv->plat->tx_queues_to_use;
-	int ret = -ENOMEM;
+	if (priv->extend_desc)
+		return sizeof(struct dma_extended_desc);
 
-	/* TX queues buffers and DMA */
-	for (queue = 0; queue < tx_count; queue++) {
-		struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
-		size_t size;
-		void *addr;
+	return sizeof(struct dma_desc);
+}
 
-		tx_q->queue_index = queue;
-		tx_q->priv_data = priv;
+static size_t sunxi_uio_tx_desc_size(struct stmmac_priv *priv, u32 queue)
+{
+	if (priv->extend_desc)
+		return sizeof(struct dma_extended_desc);
+	if (priv->tx_queue[queue].tbs & STMMAC_TBS_AVAIL)
+		return sizeof(struct dma_edesc);
 
-		if (priv->extend_desc)
-			size = sizeof(struct dma_extended_desc);
-		else if (tx_q->tbs & STMMAC_TBS_AVAIL)
-			size = sizeof(struct dma_edesc);
-		else
-			size = sizeof(struct dma_desc);
+	return sizeof(struct dma_desc);
+}
 
-		size *= priv->dma_tx_size;
+/**
+ * sunxi_uio_queue_layout - sizes of the pool slice of one queue
+ * @chip: uio private structure
+ * @queue: queue index
+ * @rx: RX ring bytes
+ * @tx: TX ring bytes
+ * @buf: packet buffer bytes, RX buffers first, then TX buffers
+ * Description: every part starts on a page so it can be mapped on its own.
+ */
+static void sunxi_uio_queue_layout(struct sunxi_uio *chip, u32 queue,
+				   size_t *rx, size_t *tx, size_t *buf)
+{
+	struct stmmac_priv *priv = netdev_priv(chip->ndev);
+	size_t nbuf = 0;
 
-		addr = dma_alloc_coherent(priv->device, size,
-					  &tx_q->dma_tx_phy, GFP_KERNEL);
-		if (!addr)
-			goto err_dma;
+	*rx = 0;
+	*tx = 0;
 
-		if (priv->extend_desc)
-			tx_q->dma_etx = addr;
-		else if (tx_q->tbs & STMMAC_TBS_AVAIL)
-			tx_q->dma_entx = addr;
-		else
-			tx_q->dma_tx = addr;
+	if (queue < priv->plat->rx_queues_to_use) {
+		*rx = PAGE_ALIGN(priv->dma_rx_size * sunxi_uio_rx_desc_size(priv));
+		nbuf += priv->dma_rx_size;
 	}
 
-	return 0;
+	if (queue < priv->plat->tx_queues_to_use) {
+		*tx = PAGE_ALIGN(priv->dma_tx_size * sunxi_uio_tx_desc_size(priv, queue));
+		nbuf += priv->dma_tx_size;
+	}
 
-err_dma:
-	sunxi_uio_free_dma_tx_desc_resources(priv);
-	return ret;
+	*buf = PAGE_ALIGN(nbuf * chip->buf_stride);
 }
 
 /**
  * sunxi_uio_alloc_dma_desc_resources - alloc TX/RX resources.
- * @priv: private structure
- * Description: according to which descriptor can be used (extend or basic)
- * this function allocates the resources for TX and RX paths. In case of
- * reception, for example, it pre-allocated the RX socket buffer in order to
- * allow zero-copy mechanism.
+ * @chip: uio private structure
+ * Description: the descriptor rings and packet buffers of all queues are
+ * carved from one physically contiguous pool, rounded up to whole
+ * hugepages, so that userspace can use physical addresses directly and the
+ * kernel linear map covers it with block mappings.
  */
-static int sunxi_uio_alloc_dma_desc_resources(struct stmmac_priv *priv)
+static int sunxi_uio_alloc_dma_desc_resources(struct sunxi_uio *chip)
 {
-	/* RX Allocation */
-	int ret = sunxi_uio_alloc_dma_rx_desc_resources(priv);
+	struct stmmac_priv *priv = netdev_priv(chip->ndev);
+	u32 queue, count = max(priv->plat->rx_queues_to_use,
+			       priv->plat->tx_queues_to_use);
+	size_t rx, tx, buf, off = 0;
 
-	if (ret)
-		return ret;
+	chip->buf_stride = roundup_pow_of_two(priv->dma_buf_sz);
 
-	ret = sunxi_uio_alloc_dma_tx_desc_resources(priv);
+	for (queue = 0; queue < count; queue++) {
+		sunxi_uio_queue_layout(chip, queue, &rx, &tx, &buf);
+		off += rx + tx + buf;
+	}
 
-	return ret;
+	chip->pool_size = ALIGN(off, SUNXI_UIO_POOL_ALIGN);
+	chip->pool_virt = dma_alloc_coherent(priv->device, chip->pool_size,
+					     &chip->pool_phy, GFP_KERNEL);
+	if (!chip->pool_virt)
+		return -ENOMEM;
+
+	if (!IS_ALIGNED(chip->pool_phy, SUNXI_UIO_POOL_ALIGN))
+		dev_warn(chip->dev, "descriptor pool at %pad is not hugepage aligned\n",
+			 &chip->pool_phy);
+
+	off = 0;
+	for (queue = 0; queue < count; queue++) {
+		struct sunxi_uio_queue *q = &chip->queue[queue];
+
+		sunxi_uio_queue_layout(chip, queue, &rx, &tx, &buf);
+
+		q->chip = chip;
+		q->chan = queue;
+
+		if (rx) {
+			struct stmmac_rx_queue *rx_q = &priv->rx_queue[queue];
+
+			q->rx_phy = chip->pool_phy + off;
+			q->rx_virt = chip->pool_virt + off;
+			q->rx_size = rx;
+
+			rx_q->dma_rx_phy = q->rx_phy;
+			if (priv->extend_desc)
+				rx_q->dma_erx = q->rx_virt;
+			else
+				rx_q->dma_rx = q->rx_virt;
+			off += rx;
+		}
+
+		if (tx) {
+			struct stmmac_tx_queue *tx_q = &priv->tx_queue[queue];
+
+			tx_q->queue_index = queue;
+			tx_q->priv_data = priv;
+
+			q->tx_phy = chip->pool_phy + off;
+			q->tx_virt = chip->pool_virt + off;
+			q->tx_size = tx;
+
+			tx_q->dma_tx_phy = q->tx_phy;
+			if (priv->extend_desc)
+				tx_q->dma_etx = q->tx_virt;
+			else if (tx_q->tbs & STMMAC_TBS_AVAIL)
+				tx_q->dma_entx = q->tx_virt;
+			else
+				tx_q->dma_tx = q->tx_virt;
+			off += tx;
+		}
+
+		q->buf_phy = chip->pool_phy + off;
+		q->buf_virt = chip->pool_virt + off;
+		q->buf_size = buf;
+		off += buf;
+	}
+
+	return 0;
 }
 
 /**
  * sunxi_uio_free_dma_desc_resources - free dma desc resources
- * @priv: private structure
+ * @chip: uio private structure
  */
-static void sunxi_uio_free_dma_desc_resources(struct stmmac_priv *priv)
+static void sunxi_uio_free_dma_desc_resources(struct sunxi_uio *chip)
 {
-	/* Release the DMA RX socket buffers */
-	sunxi_uio_free_dma_rx_desc_resources(priv);
+	struct stmmac_priv *priv = netdev_priv(chip->ndev);
 
-	/* Release the DMA TX socket buffers */
-	sunxi_uio_free_dma_tx_desc_resources(priv);
+	if (!chip->pool_virt)
+		return;
+
+	dma_free_coherent(priv->device, chip->pool_size, chip->pool_virt,
+			  chip->pool_phy);
+	chip->pool_virt = NULL;
 }
 
 /**
@@ -766,16 +895,18 @@ static int sunxi_uio_set_bfsize(int mtu, int bufsize)
 
 /**
  *  sunxi_uio_init - open entry point of the driver
- *  @dev : pointer to the device structure.
+ *  @chip : uio private structure.
  *  Description:
  *  This function is the open entry point of the driver.
  *  Return value:
  *  0 on success and an appropriate (-)ve integer as defined in errno.h
  *  file on failure.
  */
-static int sunxi_uio_init(struct net_device *dev)
+static int sunxi_uio_init(struct sunxi_uio *chip)
 {
+	struct net_device *dev = chip->ndev;
 	struct stmmac_priv *priv = netdev_priv(dev);
+	u32 chan, chan_count;
 	int ret, bfsize = 0;
 
 	if (priv->hw->pcs != STMMAC_PCS_TBI &&
@@ -810,7 +941,7 @@ static int sunxi_uio_init(struct net_device *dev)
 	if (!priv->dma_rx_size)
 		priv->dma_rx_size = DMA_DEFAULT_RX_SIZE;
 
-	ret = sunxi_uio_alloc_dma_desc_resources(priv);
+	ret = sunxi_uio_alloc_dma_desc_resources(chip);
 	if (ret < 0) {
 		netdev_err(priv->dev, "%s: DMA descriptors allocation failed\n",
 			   __func__);
@@ -823,6 +954,11 @@ static int sunxi_uio_init(struct net_device *dev)
 		goto init_error;
 	}
 
+	/* every queue starts in busy-poll mode */
+	chan_count = max(priv->plat->rx_queues_to_use, priv->plat->tx_queues_to_use);
+	for (chan = 0; chan < chan_count; chan++)
+		stmmac_disable_dma_irq(priv, priv->ioaddr, chan, true, true);
+
 	phylink_start(priv->phylink);
 	/* We may have called phylink_speed_down before */
 	phylink_speed_up(priv->phylink);
@@ -830,7 +966,7 @@ static int sunxi_uio_init(struct net_device *dev)
 	return 0;
 
 init_error:
-	sunxi_uio_free_dma_desc_resources(priv);
+	sunxi_uio_free_dma_desc_resources(chip);
 dma_desc_error:
 	phylink_disconnect_phy(priv->phylink);
 	return ret;
@@ -838,13 +974,15 @@ dma_desc_error:
 
 /**
  *  sunxi_uio_exit - close entry point of the driver
- *  @dev : device pointer.
+ *  @chip : uio private structure.
  *  Description:
  *  This is the stop entry point of the driver.
  */
-static int sunxi_uio_exit(struct net_device *dev)
+static int sunxi_uio_exit(struct sunxi_uio *chip)
 {
+	struct net_device *dev = chip->ndev;
 	struct stmmac_priv *priv = netdev_priv(dev);
+	u32 chan;
 
 	/* Stop and disconnect the PHY */
 	if (dev->phydev) {
@@ -852,8 +990,14 @@ static int sunxi_uio_exit(struct net_device *dev)
 		phy_disconnect(dev->phydev);
 	}
 
+	/* userspace may have left the channels running on the pool */
+	for (chan = 0; chan < priv->plat->rx_queues_to_use; chan++)
+		stmmac_stop_rx(priv, priv->ioaddr, chan);
+	for (chan = 0; chan < priv->plat->tx_queues_to_use; chan++)
+		stmmac_stop_tx(priv, priv->ioaddr, chan);
+
 	/* Release and free the Rx/Tx resources */
-	sunxi_uio_free_dma_desc_resources(priv);
+	sunxi_uio_free_dma_desc_resources(chip);
 
 	/* Disable the MAC Rx/Tx */
 	stmmac_mac_set(priv, priv->ioaddr, false);
@@ -863,6 +1007,346 @@ static int sunxi_uio_exit(struct net_device *dev)
 	return 0;
 }
 
+static struct dma_desc *sunxi_uio_rx_desc(struct stmmac_priv *priv,
+					  struct sunxi_uio_queue *q, u32 entry)
+{
+	if (priv->extend_desc)
+		return &((struct dma_extended_desc *)q->rx_virt)[entry].basic;
+
+	return &((struct dma_desc *)q->rx_virt)[entry];
+}
+
+static struct dma_desc *sunxi_uio_tx_desc(struct stmmac_priv *priv,
+					  struct sunxi_uio_queue *q, u32 entry)
+{
+	if (priv->extend_desc)
+		return &((struct dma_extended_desc *)q->tx_virt)[entry].basic;
+	if (priv->tx_queue[q->chan].tbs & STMMAC_TBS_AVAIL)
+		return &((struct dma_edesc *)q->tx_virt)[entry].basic;
+
+	return &((struct dma_desc *)q->tx_virt)[entry];
+}
+
+static void sunxi_uio_bench_refill(struct stmmac_priv *priv, struct sunxi_uio_queue *q,
+				   u32 entry)
+{
+	struct dma_desc *p = sunxi_uio_rx_desc(priv, q, entry);
+
+	stmmac_set_desc_addr(priv, p, q->buf_phy + entry * q->chip->buf_stride);
+	stmmac_init_rx_desc(priv, p, true, priv->mode,
+			    entry == priv->dma_rx_size - 1, priv->dma_buf_sz);
+}
+
+/**
+ * sunxi_uio_bench_run - MAC loopback packet rate of one queue
+ * @chip: uio private structure
+ * @q: queue under test
+ * @packets: frames to send
+ * @len: frame length without FCS
+ * Description: drives the rings of @q from the kernel the way a polling
+ * userspace driver would: frames to our own address go out on the TX ring
+ * and are reaped from the RX ring, with the channel interrupt masked.
+ */
+static int sunxi_uio_bench_run(struct sunxi_uio *chip, struct sunxi_uio_queue *q,
+			       u32 packets, u32 len)
+{
+	struct stmmac_priv *priv = netdev_priv(chip->ndev);
+	u32 rx_n = priv->dma_rx_size, tx_n = priv->dma_tx_size, chan = q->chan;
+	size_t rx_dsz = sunxi_uio_rx_desc_size(priv);
+	size_t tx_dsz = sunxi_uio_tx_desc_size(priv, chan);
+	dma_addr_t tx_buf = q->buf_phy + (dma_addr_t)rx_n * chip->buf_stride;
+	u32 sent = 0, received = 0, cur_tx = 0, dirty_tx = 0, cur_rx = 0, i;
+	unsigned long timeout;
+	struct ethhdr *eth;
+	ktime_t start;
+	int status;
+
+	for (i = 0; i < tx_n; i++) {
+		eth = q->buf_virt + (rx_n + i) * chip->buf_stride;
+		memset(eth, 0, len);
+		ether_addr_copy(eth->h_dest, chip->ndev->dev_addr);
+		ether_addr_copy(eth->h_source, chip->ndev->dev_addr);
+		eth->h_proto = htons(ETH_P_802_EX1);
+		stmmac_init_tx_desc(priv, sunxi_uio_tx_desc(priv, q, i), priv->mode,
+				    i == tx_n - 1);
+	}
+
+	for (i = 0; i < rx_n; i++)
+		sunxi_uio_bench_refill(priv, q, i);
+	dma_wmb();
+
+	spin_lock_irq(&chip->irq_lock);
+	stmmac_disable_dma_irq(priv, priv->ioaddr, chan, true, true);
+	spin_unlock_irq(&chip->irq_lock);
+
+	/* rewriting the ring bases also resets the current descriptors */
+	stmmac_init_rx_chan(priv, priv->ioaddr, priv->plat->dma_cfg, q->rx_phy, chan);
+	stmmac_init_tx_chan(priv, priv->ioaddr, priv->plat->dma_cfg, q->tx_phy, chan);
+	stmmac_set_rx_tail_ptr(priv, priv->ioaddr, q->rx_phy + rx_n * rx_dsz, chan);
+	stmmac_set_tx_tail_ptr(priv, priv->ioaddr, q->tx_phy, chan);
+
+	stmmac_set_mac_loopback(priv, priv->ioaddr, true);
+	stmmac_start_rx(priv, priv->ioaddr, chan);
+	stmmac_start_tx(priv, priv->ioaddr, chan);
+
+	start = ktime_get();
+	timeout = jiffies + SUNXI_UIO_BENCH_TIMEOUT;
+	while (received < packets && time_before(jiffies, timeout)) {
+		bool kick = false;
+
+		while (dirty_tx != cur_tx &&
+		       !stmmac_get_tx_owner(priv, sunxi_uio_tx_desc(priv, q, dirty_tx % tx_n)))
+			dirty_tx++;
+
+		/* never have more frames in flight than free RX descriptors */
+		while (sent < packets && cur_tx - dirty_tx < tx_n - 1 &&
+		       sent - received < rx_n - 1) {
+			u32 entry = cur_tx % tx_n;
+			struct dma_desc *p = sunxi_uio_tx_desc(priv, q, entry);
+
+			stmmac_set_desc_addr(priv, p, tx_buf + entry * chip->buf_stride);
+			stmmac_prepare_tx_desc(priv, p, 1, len, false, priv->mode, 1, 1, len);
+			cur_tx++;
+			sent++;
+			kick = true;
+		}
+
+		if (kick) {
+			dma_wmb();
+			stmmac_set_tx_tail_ptr(priv, priv->ioaddr,
+					       q->tx_phy + (cur_tx % tx_n) * tx_dsz, chan);
+		}
+
+		kick = false;
+		while (received < sent) {
+			u32 entry = cur_rx % rx_n;
+
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(6, 6, 0))
+			status = stmmac_rx_status(priv, &priv->dev->stats, &priv->xstats,
+						  sunxi_uio_rx_desc(priv, q, entry));
+#else
+			status = stmmac_rx_status(priv, &priv->xstats,
+						  sunxi_uio_rx_desc(priv, q, entry));
+#endif
+			if (status & dma_own)
+				break;
+
+			received++;
+			sunxi_uio_bench_refill(priv, q, entry);
+			cur_rx++;
+			kick = true;
+		}
+
+		if (kick) {
+			dma_wmb();
+			stmmac_set_rx_tail_ptr(priv, priv->ioaddr,
+					       q->rx_phy + (cur_rx % rx_n) * rx_dsz, chan);
+		}
+
+		cond_resched();
+	}
+
+	chip->bench.ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	chip->bench.queue = chan;
+	chip->bench.len = len;
+	chip->bench.sent = sent;
+	chip->bench.received = received;
+
+	stmmac_stop_tx(priv, priv->ioaddr, chan);
+	stmmac_stop_rx(priv, priv->ioaddr, chan);
+	stmmac_set_mac_loopback(priv, priv->ioaddr, false);
+
+	return received < packets ? -ETIMEDOUT : 0;
+}
+
+static ssize_t sunxi_uio_loopback_bench_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct sunxi_uio *chip = dev_get_drvdata(dev);
+	struct sunxi_uio_bench *b = &chip->bench;
+	u64 ns = max_t(u64, b->ns, 1);
+
+	if (!b->sent)
+		return sprintf(buf, "usage: echo <queue> <packets> [len] > loopback_bench\n");
+
+	return sprintf(buf, "queue %u: %u/%u frames of %u bytes in %llu us, %llu pps, %llu Mbps\n",
+		       b->queue, b->received, b->sent, b->len, div_u64(b->ns, NSEC_PER_USEC),
+		       div64_u64((u64)b->received * NSEC_PER_SEC, ns),
+		       div64_u64((u64)b->received * b->len * 8 * 1000, ns));
+}
+
+static ssize_t sunxi_uio_loopback_bench_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct sunxi_uio *chip = dev_get_drvdata(dev);
+	struct stmmac_priv *priv = netdev_priv(chip->ndev);
+	u32 queue, packets, len = ETH_ZLEN;
+	int ret;
+
+	if (sscanf(buf, "%u %u %u", &queue, &packets, &len) < 2)
+		return -EINVAL;
+
+	if (queue >= chip->nr_queues || !packets || len < ETH_ZLEN ||
+	    len > priv->dma_buf_sz)
+		return -EINVAL;
+
+	if (!mutex_trylock(&chip->bench_lock))
+		return -EBUSY;
+
+	if (atomic_read(&chip->users)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	ret = sunxi_uio_bench_run(chip, &chip->queue[queue], packets, len);
+	if (ret)
+		dev_warn(dev, "loopback bench: %u of %u frames came back\n",
+			 chip->bench.received, chip->bench.sent);
+
+out:
+	mutex_unlock(&chip->bench_lock);
+
+	return ret ? ret : count;
+}
+
+static struct device_attribute sunxi_uio_bench_attr =
+	__ATTR(loopback_bench, 0664, sunxi_uio_loopback_bench_show,
+	       sunxi_uio_loopback_bench_store);
+
+static void sunxi_uio_free_irqs(struct sunxi_uio *chip)
+{
+	u32 queue;
+
+	for (queue = 0; queue < chip->nr_queues; queue++) {
+		struct sunxi_uio_queue *q = &chip->queue[queue];
+
+		if (q->tx_irq)
+			free_irq(q->tx_irq, q);
+		if (q->rx_irq)
+			free_irq(q->rx_irq, q);
+		q->rx_irq = 0;
+		q->tx_irq = 0;
+	}
+
+	if (chip->irq > 0)
+		free_irq(chip->irq, chip);
+	chip->irq = 0;
+}
+
+/**
+ * sunxi_uio_request_irqs - take over the interrupt lines of the MAC
+ * @chip: uio private structure
+ * Description: the net device is closed, so its lines are free. Variants
+ * with one line per queue signal their queue directly, otherwise the MAC
+ * line is demultiplexed from the DMA channel status.
+ */
+static int sunxi_uio_request_irqs(struct sunxi_uio *chip)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0))
+	struct stmmac_priv *priv = netdev_priv(chip->ndev);
+	u32 queue;
+#endif
+	int ret;
+
+	ret = request_irq(chip->ndev->irq, sunxi_uio_interrupt, IRQF_SHARED,
+			  dev_name(chip->dev), chip);
+	if (ret)
+		return ret;
+	chip->irq = chip->ndev->irq;
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0))
+	for (queue = 0; queue < chip->nr_queues; queue++) {
+		struct sunxi_uio_queue *q = &chip->queue[queue];
+
+		if (priv->rx_irq[queue] > 0) {
+			ret = request_irq(priv->rx_irq[queue], sunxi_uio_queue_interrupt, 0,
+					  q->name, q);
+			if (ret)
+				goto err;
+			q->rx_irq = priv->rx_irq[queue];
+		}
+
+		if (priv->tx_irq[queue] > 0 && priv->tx_irq[queue] != q->rx_irq) {
+			ret = request_irq(priv->tx_irq[queue], sunxi_uio_queue_interrupt, 0,
+					  q->name, q);
+			if (ret)
+				goto err;
+			q->tx_irq = priv->tx_irq[queue];
+		}
+	}
+#endif
+
+	return 0;
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0))
+err:
+	sunxi_uio_free_irqs(chip);
+	return ret;
+#endif
+}
+
+static void sunxi_uio_unregister_queues(struct sunxi_uio *chip)
+{
+	u32 queue;
+
+	for (queue = 0; queue < chip->nr_queues; queue++) {
+		if (chip->queue[queue].registered)
+			uio_unregister_device(&chip->queue[queue].uio);
+		chip->queue[queue].registered = false;
+	}
+}
+
+/**
+ * sunxi_uio_register_queue - export one RX/TX queue pair
+ * @chip: uio private structure
+ * @q: queue
+ * @res: MAC register resource
+ * Description: queue 0 keeps the name and the first three maps of the
+ * single device this driver used to register.
+ */
+static int sunxi_uio_register_queue(struct sunxi_uio *chip, struct sunxi_uio_queue *q,
+				    struct resource *res)
+{
+	struct uio_info *uio = &q->uio;
+
+	if (q->chan)
+		snprintf(q->name, sizeof(q->name), "uio_%s_q%u", chip->ndev->name, q->chan);
+	else
+		snprintf(q->name, sizeof(q->name), "uio_%s", chip->ndev->name);
+	uio->name = q->name;
+	uio->version = DRIVER_VERSION;
+
+	uio->mem[SUNXI_UIO_MAP_REGS].name = "eth_regs";
+	uio->mem[SUNXI_UIO_MAP_REGS].addr = res->start & PAGE_MASK;
+	uio->mem[SUNXI_UIO_MAP_REGS].size = PAGE_ALIGN(resource_size(res));
+	uio->mem[SUNXI_UIO_MAP_REGS].memtype = UIO_MEM_PHYS;
+
+	uio->mem[SUNXI_UIO_MAP_RX_BD].name = "eth_rx_bd";
+	uio->mem[SUNXI_UIO_MAP_RX_BD].addr = q->rx_phy;
+	uio->mem[SUNXI_UIO_MAP_RX_BD].size = q->rx_size;
+	uio->mem[SUNXI_UIO_MAP_RX_BD].memtype = UIO_MEM_PHYS;
+
+	uio->mem[SUNXI_UIO_MAP_TX_BD].name = "eth_tx_bd";
+	uio->mem[SUNXI_UIO_MAP_TX_BD].addr = q->tx_phy;
+	uio->mem[SUNXI_UIO_MAP_TX_BD].size = q->tx_size;
+	uio->mem[SUNXI_UIO_MAP_TX_BD].memtype = UIO_MEM_PHYS;
+
+	uio->mem[SUNXI_UIO_MAP_BUF].name = "eth_buf";
+	uio->mem[SUNXI_UIO_MAP_BUF].addr = q->buf_phy;
+	uio->mem[SUNXI_UIO_MAP_BUF].size = q->buf_size;
+	uio->mem[SUNXI_UIO_MAP_BUF].memtype = UIO_MEM_PHYS;
+
+	uio->irq = UIO_IRQ_CUSTOM;
+	uio->irqcontrol = sunxi_uio_irqcontrol;
+	uio->open = sunxi_uio_open;
+	uio->release = sunxi_uio_release;
+	/* Custom mmap function. */
+	uio->mmap = sunxi_uio_mmap;
+	uio->priv = q;
+
+	return uio_register_device(chip->dev, uio);
+}
+
 /**
  * sunxi_uio_probe() platform driver probe routine
  * - register uio devices filled with memory maps retrieved
@@ -875,8 +1359,8 @@ static int sunxi_uio_probe(struct platform_device *pdev)
 	struct sunxi_uio *chip;
 	struct net_device *netdev;
 	struct stmmac_priv *priv;
-	struct uio_info *uio;
 	struct resource *res;
+	u32 queue;
 	int err = 0;
 
 	chip = devm_kzalloc(dev, sizeof(struct sunxi_uio),
@@ -884,8 +1368,15 @@ static int sunxi_uio_probe(struct platform_device *pdev)
 	if (!chip)
 		return -ENOMEM;
 
-	uio = &chip->uio;
 	chip->dev = dev;
+	spin_lock_init(&chip->irq_lock);
+	mutex_init(&chip->bench_lock);
+	atomic_set(&chip->users, 0);
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	if (!res)
+		return -ENODEV;
+
 	mac_node = of_parse_phandle(np, "sunxi,ethernet", 0);
 	if (!mac_node)
 		return -ENODEV;
@@ -906,7 +1397,7 @@ static int sunxi_uio_probe(struct platform_device *pdev)
 	rtnl_unlock();
 
 	rtnl_lock();
-	err = sunxi_uio_init(netdev);
+	err = sunxi_uio_init(chip);
 	if (err) {
 		rtnl_unlock();
 		dev_err(dev, "Failed to open stmmac resource: %d\n", err);
@@ -915,50 +1406,45 @@ static int sunxi_uio_probe(struct platform_device *pdev)
 	rtnl_unlock();
 
 	priv = netdev_priv(netdev);
-	snprintf(chip->name, sizeof(chip->name), "uio_%s",
-		 netdev->name);
-	uio->name = chip->name;
-	uio->version = DRIVER_VERSION;
-
-	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
-	if (!res)
-		return -ENODEV;
-
-	uio->mem[0].name = "eth_regs";
-	uio->mem[0].addr = res->start & PAGE_MASK;
-	uio->mem[0].size = PAGE_ALIGN(resource_size(res));
-	uio->mem[0].memtype = UIO_MEM_PHYS;
-
-	uio->mem[1].name = "eth_rx_bd";
-	uio->mem[1].addr = priv->rx_queue[0].dma_rx_phy;
-	uio->mem[1].size = priv->dma_rx_size * sizeof(struct dma_desc);
-	uio->mem[1].memtype = UIO_MEM_PHYS;
-
-	uio->mem[2].name = "eth_tx_bd";
-	uio->mem[2].addr = priv->tx_queue[0].dma_tx_phy;
-	uio->mem[2].size = priv->dma_tx_size * sizeof(struct dma_desc);
-	uio->mem[2].memtype = UIO_MEM_PHYS;
-
-	uio->open = sunxi_uio_open;
-	uio->release = sunxi_uio_release;
-	/* Custom mmap function. */
-	uio->mmap = sunxi_uio_mmap;
-	uio->priv = chip;
+	chip->nr_queues = min(priv->plat->rx_queues_to_use,
+			      priv->plat->tx_queues_to_use);
+	if (priv->plat->rx_queues_to_use != priv->plat->tx_queues_to_use)
+		dev_warn(dev, "%u rx and %u tx queues, exporting %u pairs\n",
+			 priv->plat->rx_queues_to_use, priv->plat->tx_queues_to_use,
+			 chip->nr_queues);
+
+	for (queue = 0; queue < chip->nr_queues; queue++) {
+		err = sunxi_uio_register_queue(chip, &chip->queue[queue], res);
+		if (err) {
+			dev_err(dev, "Failed to register uio device %u: %d\n", queue, err);
+			goto err_unregister;
+		}
+		chip->queue[queue].registered = true;
+	}
 
-	err = uio_register_device(dev, uio);
+	err = sunxi_uio_request_irqs(chip);
 	if (err) {
-		dev_err(dev, "Failed to register uio device: %d\n", err);
-		return err;
+		dev_err(dev, "Failed to request interrupts: %d\n", err);
+		goto err_unregister;
 	}
 
-	chip->map_num = 3;
-
-	dev_info(dev, "Registered %s uio devices, %d register maps attached\n",
-		 chip->name, chip->map_num);
+	chip->map_num = SUNXI_UIO_MAP_NUM;
 
 	platform_set_drvdata(pdev, chip);
+	device_create_file(dev, &sunxi_uio_bench_attr);
+
+	dev_info(dev, "Registered %u uio queue devices, %d maps each, %zu KiB pool\n",
+		 chip->nr_queues, chip->map_num, chip->pool_size >> 10);
 
 	return 0;
+
+err_unregister:
+	sunxi_uio_unregister_queues(chip);
+	rtnl_lock();
+	sunxi_uio_exit(chip);
+	dev_open(netdev, NULL);
+	rtnl_unlock();
+	return err;
 }
 
 /**
@@ -975,11 +1461,13 @@ static int sunxi_uio_remove(struct platform_device *pdev)
 
 	netdev = chip->ndev;
 
-	uio_unregister_device(&chip->uio);
+	device_remove_file(&pdev->dev, &sunxi_uio_bench_attr);
+	sunxi_uio_free_irqs(chip);
+	sunxi_uio_unregister_queues(chip);
 
 	if (netdev) {
 		rtnl_lock();
-		sunxi_uio_exit(netdev);
+		sunxi_uio_exit(chip);
 		rtnl_unlock();
 	}
 
@@ -1,7 +1,21 @@
 /* SPDX-License-Identifier: GPL-2.0-or-later */
 /* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
 /*
- * Allwinner SoCs power domain test driver.
+ * Allwinner SoCs cpufreq thermal clamp.
+ *
+ * A PID controller in the style of the power allocator governor: the
+ * temperature error against control_temp is turned into a power budget,
+ * the budget is split between the cpufreq clusters by weight and every
+ * cluster gets the highest OPP that fits its share through a frequency
+ * QoS request. Below switch_on_temp all limits are released and, when the
+ * sensor has alarm interrupts, the controller sleeps until the thermal
+ * zone reports a trip crossing; the zone needs a trip at or below
+ * switch_on_temp for that. Without alarm interrupts it falls back to slow
+ * polling.
+ *
+ * Writing to the "simulate" parameter runs the controller against a first
+ * order thermal model with synthetic ambient curves and reports whether
+ * the frequency settles; the QoS requests are not touched.
  *
  * This file is licensed under the terms of the GNU General Public
  * License version 2.  This program is licensed "as is" without any
@@ -12,105 +26,627 @@
 #include <linux/errno.h>
 #include <linux/kernel.h>
 #include <linux/delay.h>
+#include <linux/pm_opp.h>
 #include <linux/pm_qos.h>
 #include <linux/slab.h>
 #include <linux/init.h>
 #include <linux/wait.h>
 #include <linux/cpu.h>
 #include <linux/cpufreq.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/sort.h>
 #include <linux/thermal.h>
 #include <linux/module.h>
 
-/* KHz */
-#define CPUB_UPPER_LIMIT_FREQ		(1992000 - 1)
+#include "sunxi_thermal.h"
+
+#define CPUB_THERMAL_ZONE		"cpub_thermal_zone"
+
+#define CLAMP_MAX_CLUSTERS		4
+#define CLAMP_MAX_OPPS			32
+
+/* fixed point gains, as in the power allocator governor */
+#define FRAC_BITS			10
+#define int_to_frac(x)			((x) << FRAC_BITS)
+#define frac_to_int(x)			((x) >> FRAC_BITS)
+
+/* millidegree Celsius */
+static int switch_on_temp = 70000;
+module_param(switch_on_temp, int, 0644);
+MODULE_PARM_DESC(switch_on_temp, "Temperature the controller starts at (default: 70000)");
+
+static int control_temp = 75000;
+module_param(control_temp, int, 0644);
+MODULE_PARM_DESC(control_temp, "Temperature the controller holds (default: 75000)");
+
+/* mW, 0: half of the maximum power of all clusters */
+static unsigned int sustainable_power;
+module_param(sustainable_power, uint, 0644);
+MODULE_PARM_DESC(sustainable_power, "Power at control_temp in mW, 0 to estimate");
+
+/* FRAC_BITS fixed point, 0: estimated from sustainable_power */
+static unsigned int k_po;
+module_param(k_po, uint, 0644);
+MODULE_PARM_DESC(k_po, "Proportional gain above control_temp, 0 to estimate");
+
+static unsigned int k_pu;
+module_param(k_pu, uint, 0644);
+MODULE_PARM_DESC(k_pu, "Proportional gain below control_temp, 0 to estimate");
+
+static unsigned int k_i = int_to_frac(10) / 1000;
+module_param(k_i, uint, 0644);
+MODULE_PARM_DESC(k_i, "Integral gain (default: 10)");
+
+static unsigned int k_d;
+module_param(k_d, uint, 0644);
+MODULE_PARM_DESC(k_d, "Derivative gain (default: 0)");
+
+static int integral_cutoff;
+module_param(integral_cutoff, int, 0644);
+MODULE_PARM_DESC(integral_cutoff, "Integrate only while control_temp - temp is below this (default: 0)");
 
 /* ms */
-#define THERMAL_POLLING_DELAY		(10 * 1000)
+static unsigned int polling_ms = 100;
+module_param(polling_ms, uint, 0644);
+MODULE_PARM_DESC(polling_ms, "Sampling period while above switch_on_temp (default: 100)");
 
-/* Celsius */
-#define CPUB_UPPER_LIMIT_TEMP		(70)
-#define HYSTERESIS			(3)
+static unsigned int idle_polling_ms = 10 * 1000;
+module_param(idle_polling_ms, uint, 0644);
+MODULE_PARM_DESC(idle_polling_ms, "Sampling period below switch_on_temp without alarm irq (default: 10000)");
 
-#define CPUB_CORE_NUM			(4)
-#define CPUB_THERMAL_ZONE		"cpub_thermal_zone"
+/* simulator plant: millidegree per mW and time constant */
+static unsigned int sim_rth = 20;
+module_param(sim_rth, uint, 0644);
+MODULE_PARM_DESC(sim_rth, "Simulated thermal resistance in mC/mW (default: 20)");
+
+static unsigned int sim_tau_ms = 20000;
+module_param(sim_tau_ms, uint, 0644);
+MODULE_PARM_DESC(sim_tau_ms, "Simulated thermal time constant in ms (default: 20000)");
+
+static unsigned int sim_steps = 3000;
+module_param(sim_steps, uint, 0644);
+MODULE_PARM_DESC(sim_steps, "Simulated controller periods per curve (default: 3000)");
+
+struct sunxi_clamp_opp {
+	u32				freq;	/* KHz */
+	u32				power;	/* mW, all cpus of the cluster */
+};
+
+struct sunxi_clamp_cluster {
+	int				cpu;
+	unsigned int			nr_cpus;
+	unsigned int			weight;
+	struct freq_qos_request		qos_req;
+	struct sunxi_clamp_opp		opp[CLAMP_MAX_OPPS];
+	unsigned int			nr_opps;
+	/* index into opp of the current limit */
+	unsigned int			limit;
+};
+
+struct sunxi_clamp_pid {
+	s64				err_integral;
+	s32				prev_err;
+};
 
 static struct sunxi_clamp_control *clamp_control;
 
 struct sunxi_clamp_control {
-	bool				clamped;
-	struct freq_qos_request		qos_req;
+	bool				active;
+	bool				irq_driven;
 	struct thermal_zone_device	*thermal;
 	struct delayed_work		thermal_mon;
+	struct notifier_block		alarm_nb;
+	/* protects pid and the cluster limits */
+	struct mutex			lock;
+	struct sunxi_clamp_pid		pid;
+	u32				max_power;
+	unsigned int			nr_clusters;
+	struct sunxi_clamp_cluster	cluster[CLAMP_MAX_CLUSTERS];
 };
 
+static u32 sunxi_clamp_sustainable(struct sunxi_clamp_control *clamp)
+{
+	return sustainable_power ? sustainable_power : clamp->max_power / 2;
+}
+
+/* returns the power budget in mW for @temp */
+static u32 sunxi_clamp_pid_step(struct sunxi_clamp_control *clamp,
+				struct sunxi_clamp_pid *pid, int temp)
+{
+	u32 sustainable = sunxi_clamp_sustainable(clamp);
+	s32 threshold = max(control_temp - switch_on_temp, 1000);
+	s32 err = control_temp - temp;
+	s64 kpo, kpu, p, i, d, power;
+
+	kpo = k_po ? k_po : div_s64(int_to_frac((s64)sustainable), threshold);
+	kpu = k_pu ? k_pu : div_s64(int_to_frac(2 * (s64)sustainable), threshold);
+
+	p = frac_to_int((err < 0 ? kpo : kpu) * err);
+
+	/* anti windup: stop integrating once the term alone saturates */
+	if (err < integral_cutoff) {
+		s64 next = pid->err_integral + err;
+
+		if (abs(frac_to_int((s64)k_i * next)) <= clamp->max_power)
+			pid->err_integral = next;
+	}
+	i = frac_to_int((s64)k_i * pid->err_integral);
+
+	d = frac_to_int((s64)k_d * (err - pid->prev_err));
+	pid->prev_err = err;
+
+	power = sustainable + p + i + d;
+
+	return clamp_val(power, 0, clamp->max_power);
+}
+
+static u32 sunxi_clamp_max_power(struct sunxi_clamp_cluster *c)
+{
+	return c->opp[c->nr_opps - 1].power;
+}
+
+/*
+ * Split @budget between the clusters in proportion to weight * max power,
+ * hand what a cluster cannot use to the others, then pick the highest OPP
+ * of every cluster that fits its share. The lowest OPP is always allowed.
+ */
+static void sunxi_clamp_divvy(struct sunxi_clamp_control *clamp, u32 budget,
+			      unsigned int *limit)
+{
+	u64 grant[CLAMP_MAX_CLUSTERS] = { 0 };
+	u64 left = budget, total;
+	bool full[CLAMP_MAX_CLUSTERS] = { false };
+	unsigned int n, pass, j;
+
+	for (pass = 0; pass < clamp->nr_clusters && left; pass++) {
+		u64 given = 0;
+
+		total = 0;
+		for (n = 0; n < clamp->nr_clusters; n++) {
+			if (!full[n])
+				total += (u64)clamp->cluster[n].weight *
+					 sunxi_clamp_max_power(&clamp->cluster[n]);
+		}
+		if (!total)
+			break;
+
+		for (n = 0; n < clamp->nr_clusters; n++) {
+			struct sunxi_clamp_cluster *c = &clamp->cluster[n];
+			u64 share, room;
+
+			if (full[n])
+				continue;
+
+			share = div64_u64(left * c->weight * sunxi_clamp_max_power(c), total);
+			room = sunxi_clamp_max_power(c) - grant[n];
+			if (share >= room) {
+				share = room;
+				full[n] = true;
+			}
+			grant[n] += share;
+			given += share;
+		}
+		left -= min(left, given);
+	}
+
+	for (n = 0; n < clamp->nr_clusters; n++) {
+		struct sunxi_clamp_cluster *c = &clamp->cluster[n];
+
+		limit[n] = 0;
+		for (j = c->nr_opps; j > 0; j--) {
+			if (c->opp[j - 1].power <= grant[n]) {
+				limit[n] = j - 1;
+				break;
+			}
+		}
+	}
+}
+
+static void sunxi_clamp_apply(struct sunxi_clamp_control *clamp, unsigned int *limit)
+{
+	unsigned int n;
+
+	for (n = 0; n < clamp->nr_clusters; n++) {
+		struct sunxi_clamp_cluster *c = &clamp->cluster[n];
+
+		if (c->limit == limit[n])
+			continue;
+
+		c->limit = limit[n];
+		freq_qos_update_request(&c->qos_req, c->opp[c->limit].freq);
+	}
+}
+
+static void sunxi_clamp_release(struct sunxi_clamp_control *clamp)
+{
+	unsigned int n;
+
+	for (n = 0; n < clamp->nr_clusters; n++) {
+		struct sunxi_clamp_cluster *c = &clamp->cluster[n];
+
+		c->limit = c->nr_opps - 1;
+		freq_qos_update_request(&c->qos_req, INT_MAX);
+	}
+}
+
 static void thermal_zone_monitor(struct work_struct *work)
 {
 	struct sunxi_clamp_control *clamp =
 		container_of(work, typeof(*clamp), thermal_mon.work);
+	unsigned int limit[CLAMP_MAX_CLUSTERS];
+	unsigned int delay;
 	int ret, temperature = 0;
 
 	ret = thermal_zone_get_temp(clamp->thermal, &temperature);
 	if (ret) {
 		sunxi_err(NULL, "Failed to get temperature (%d)\n", ret);
+		schedule_delayed_work(&clamp->thermal_mon, msecs_to_jiffies(idle_polling_ms));
+		return;
+	}
+
+	mutex_lock(&clamp->lock);
+
+	if (temperature < switch_on_temp) {
+		if (clamp->active) {
+			clamp->active = false;
+			memset(&clamp->pid, 0, sizeof(clamp->pid));
+			sunxi_clamp_release(clamp);
+			sunxi_info(NULL, "%s: CPU frequency unclamped\n", __func__);
+		}
+		mutex_unlock(&clamp->lock);
+
+		/* the next trip crossing wakes us up again */
+		if (clamp->irq_driven)
+			return;
+
+		schedule_delayed_work(&clamp->thermal_mon, msecs_to_jiffies(idle_polling_ms));
+		return;
+	}
+
+	if (!clamp->active) {
+		clamp->active = true;
+		sunxi_info(NULL, "%s: Clamping CPU frequency at %d\n", __func__, temperature);
+	}
+
+	sunxi_clamp_divvy(clamp, sunxi_clamp_pid_step(clamp, &clamp->pid, temperature), limit);
+	sunxi_clamp_apply(clamp, limit);
+	delay = max(polling_ms, 1U);
+
+	mutex_unlock(&clamp->lock);
+
+	schedule_delayed_work(&clamp->thermal_mon, msecs_to_jiffies(delay));
+}
+
+static int sunxi_clamp_alarm_notify(struct notifier_block *nb, unsigned long sensor,
+				    void *data)
+{
+	struct sunxi_clamp_control *clamp = container_of(nb, typeof(*clamp), alarm_nb);
+
+	if (data != clamp->thermal)
+		return NOTIFY_DONE;
+
+	mod_delayed_work(system_wq, &clamp->thermal_mon, 0);
+
+	return NOTIFY_OK;
+}
+
+struct sunxi_clamp_curve {
+	const char			*name;
+	int				amb_start;
+	int				amb_end;
+	/* jump to amb_end half way instead of a linear ramp */
+	bool				step;
+};
+
+static const struct sunxi_clamp_curve sunxi_clamp_curves[] = {
+	{ "constant 25C",  25000, 25000, false },
+	{ "step 25C->45C", 25000, 45000, true },
+	{ "ramp 20C->40C", 20000, 40000, false },
+};
+
+static int sunxi_clamp_sim_ambient(const struct sunxi_clamp_curve *curve, unsigned int step)
+{
+	if (curve->step)
+		return step < sim_steps / 2 ? curve->amb_start : curve->amb_end;
+
+	return curve->amb_start +
+	       div_s64((s64)(curve->amb_end - curve->amb_start) * step, sim_steps);
+}
+
+/*
+ * First order plant with every cpu fully loaded:
+ *   dT/dt = (ambient + P * rth - T) / tau
+ * The last quarter of the run is the steady state window: the temperature
+ * has to average within 2C of control_temp, or every cluster has to sit at
+ * its top OPP if the plant cannot get that hot, and no cluster may move by
+ * more than one OPP.
+ */
+static bool sunxi_clamp_sim_curve(struct sunxi_clamp_control *clamp,
+				  const struct sunxi_clamp_curve *curve)
+{
+	unsigned int lo[CLAMP_MAX_CLUSTERS], hi[CLAMP_MAX_CLUSTERS];
+	unsigned int limit[CLAMP_MAX_CLUSTERS];
+	unsigned int dt = max(polling_ms, 1U), window = sim_steps / 4;
+	struct sunxi_clamp_pid pid = { 0 };
+	s64 temp_sum = 0, freq_sum[CLAMP_MAX_CLUSTERS] = { 0 };
+	int temp, amb = 0, peak = INT_MIN;
+	unsigned int step, n;
+	bool active = false, pass = true, reachable;
+
+	temp = sunxi_clamp_sim_ambient(curve, 0);
+	for (n = 0; n < clamp->nr_clusters; n++) {
+		limit[n] = clamp->cluster[n].nr_opps - 1;
+		lo[n] = UINT_MAX;
+		hi[n] = 0;
 	}
-	temperature /= 1000;
 
-	if (temperature >= CPUB_UPPER_LIMIT_TEMP && !clamp->clamped) {
-		clamp->clamped = true;
-		freq_qos_update_request(&clamp->qos_req, CPUB_UPPER_LIMIT_FREQ);
-		sunxi_info(NULL, "%s: Clamping CPU frequency to %d\n", __func__, CPUB_UPPER_LIMIT_FREQ);
-	} else if (temperature < (CPUB_UPPER_LIMIT_TEMP - HYSTERESIS) && clamp->clamped) {
-		clamp->clamped = false;
-		freq_qos_update_request(&clamp->qos_req, INT_MAX);
-		sunxi_info(NULL, "%s: CPU frequency unclamped\n", __func__);
+	for (step = 0; step < sim_steps; step++) {
+		u32 power = 0;
+
+		if (temp < switch_on_temp) {
+			if (active) {
+				memset(&pid, 0, sizeof(pid));
+				for (n = 0; n < clamp->nr_clusters; n++)
+					limit[n] = clamp->cluster[n].nr_opps - 1;
+			}
+			active = false;
+		} else {
+			active = true;
+			sunxi_clamp_divvy(clamp, sunxi_clamp_pid_step(clamp, &pid, temp), limit);
+		}
+
+		for (n = 0; n < clamp->nr_clusters; n++)
+			power += clamp->cluster[n].opp[limit[n]].power;
+
+		amb = sunxi_clamp_sim_ambient(curve, step);
+		temp += div_s64(((s64)amb + (s64)power * sim_rth - temp) * dt,
+				max(sim_tau_ms, dt));
+
+		if (step < sim_steps - window)
+			continue;
+
+		temp_sum += temp;
+		peak = max(peak, temp);
+		for (n = 0; n < clamp->nr_clusters; n++) {
+			lo[n] = min(lo[n], limit[n]);
+			hi[n] = max(hi[n], limit[n]);
+			freq_sum[n] += clamp->cluster[n].opp[limit[n]].freq;
+		}
 	}
 
-	schedule_delayed_work(&clamp->thermal_mon, msecs_to_jiffies(THERMAL_POLLING_DELAY));
+	temp = div_s64(temp_sum, window);
+	reachable = amb + (s64)clamp->max_power * sim_rth >= control_temp;
+
+	for (n = 0; n < clamp->nr_clusters; n++) {
+		struct sunxi_clamp_cluster *c = &clamp->cluster[n];
+
+		sunxi_info(NULL, "sim %s: cpu%d avg %lld KHz, opp %u..%u of %u\n",
+			   curve->name, c->cpu, div_s64(freq_sum[n], window),
+			   lo[n], hi[n], c->nr_opps);
+
+		if (hi[n] - lo[n] > 1)
+			pass = false;
+		if (!reachable && lo[n] != c->nr_opps - 1)
+			pass = false;
+	}
+
+	if (reachable && abs(temp - control_temp) > 2000)
+		pass = false;
+
+	sunxi_info(NULL, "sim %s: avg %d peak %d mC, %s\n", curve->name, temp, peak,
+		   pass ? "PASS" : "FAIL");
+
+	return pass;
+}
+
+static int sunxi_clamp_simulate(const char *val, const struct kernel_param *kp)
+{
+	struct sunxi_clamp_control *clamp = clamp_control;
+	unsigned int i, failed = 0;
+
+	if (!clamp || !sim_steps || sim_steps < 4)
+		return -EINVAL;
+
+	mutex_lock(&clamp->lock);
+	for (i = 0; i < ARRAY_SIZE(sunxi_clamp_curves); i++) {
+		if (!sunxi_clamp_sim_curve(clamp, &sunxi_clamp_curves[i]))
+			failed++;
+	}
+	mutex_unlock(&clamp->lock);
+
+	sunxi_info(NULL, "sim: %u of %zu curves failed\n", failed, ARRAY_SIZE(sunxi_clamp_curves));
+
+	return failed ? -EDOM : 0;
+}
+
+static const struct kernel_param_ops sunxi_clamp_simulate_ops = {
+	.set = sunxi_clamp_simulate,
+};
+module_param_cb(simulate, &sunxi_clamp_simulate_ops, NULL, 0200);
+MODULE_PARM_DESC(simulate, "Write to run the controller against synthetic temperature curves");
+
+static int sunxi_clamp_opp_cmp(const void *a, const void *b)
+{
+	const struct sunxi_clamp_opp *x = a, *y = b;
+
+	return x->freq < y->freq ? -1 : x->freq > y->freq;
+}
+
+/*
+ * P = C * V^2 * f per cpu, as cpufreq_cooling does, with the capacitance
+ * from "dynamic-power-coefficient". Without it the frequency in MHz is used
+ * as a relative power so the OPP order is still right.
+ */
+static u32 sunxi_clamp_opp_power(struct device *cpu_dev, u32 coeff, u32 freq)
+{
+	struct dev_pm_opp *opp;
+	unsigned long hz = (unsigned long)freq * 1000;
+	u64 power, mv;
+
+	if (!coeff || !cpu_dev)
+		return freq / 1000;
+
+	opp = dev_pm_opp_find_freq_exact(cpu_dev, hz, true);
+	if (IS_ERR(opp))
+		return freq / 1000;
+
+	mv = dev_pm_opp_get_voltage(opp) / 1000;
+	dev_pm_opp_put(opp);
+
+	power = (u64)coeff * (freq / 1000) * mv * mv;
+	do_div(power, 1000000000);
+
+	return max_t(u32, power, 1);
+}
+
+static int sunxi_clamp_cluster_init(struct sunxi_clamp_cluster *c,
+				    struct cpufreq_policy *policy, unsigned int weight)
+{
+	struct cpufreq_frequency_table *pos;
+	struct device *cpu_dev = get_cpu_device(policy->cpu);
+	struct device_node *np;
+	u32 coeff = 0;
+	unsigned int i;
+
+	np = of_cpu_device_node_get(policy->cpu);
+	if (np) {
+		of_property_read_u32(np, "dynamic-power-coefficient", &coeff);
+		of_node_put(np);
+	}
+
+	c->cpu = policy->cpu;
+	c->nr_cpus = cpumask_weight(policy->related_cpus);
+	c->weight = weight;
+
+	cpufreq_for_each_valid_entry(pos, policy->freq_table) {
+		if (c->nr_opps == CLAMP_MAX_OPPS)
+			break;
+		c->opp[c->nr_opps++].freq = pos->frequency;
+	}
+	if (!c->nr_opps)
+		return -ENODEV;
+
+	sort(c->opp, c->nr_opps, sizeof(c->opp[0]), sunxi_clamp_opp_cmp, NULL);
+	for (i = 0; i < c->nr_opps; i++)
+		c->opp[i].power = sunxi_clamp_opp_power(cpu_dev, coeff, c->opp[i].freq) *
+				  c->nr_cpus;
+	c->limit = c->nr_opps - 1;
+
+	return freq_qos_add_request(&policy->constraints, &c->qos_req, FREQ_QOS_MAX,
+				    FREQ_QOS_MAX_DEFAULT_VALUE);
+}
+
+/*
+ * Optional "allwinner,sunxi-cpufreq-clamp" node: thermal-zone,
+ * switch-on-temp, control-temp, sustainable-power, polling-delay-ms and
+ * budget-weights, one weight per cluster in cpu order. Module parameters
+ * can change everything but the zone at runtime.
+ */
+static const char *sunxi_clamp_parse_dt(u32 *weights)
+{
+	const char *zone = CPUB_THERMAL_ZONE;
+	struct device_node *np;
+
+	np = of_find_compatible_node(NULL, NULL, "allwinner,sunxi-cpufreq-clamp");
+	if (!np)
+		return zone;
+
+	of_property_read_string(np, "thermal-zone", &zone);
+	of_property_read_s32(np, "switch-on-temp", &switch_on_temp);
+	of_property_read_s32(np, "control-temp", &control_temp);
+	of_property_read_u32(np, "sustainable-power", &sustainable_power);
+	of_property_read_u32(np, "polling-delay-ms", &polling_ms);
+	of_property_read_variable_u32_array(np, "budget-weights", weights, 1,
+					    CLAMP_MAX_CLUSTERS);
+	of_node_put(np);
+
+	return zone;
+}
+
+static void sunxi_clamp_clusters_exit(struct sunxi_clamp_control *clamp)
+{
+	unsigned int n;
+
+	for (n = 0; n < clamp->nr_clusters; n++)
+		freq_qos_remove_request(&clamp->cluster[n].qos_req);
 }
 
 static int __init sunxi_cpufreq_clamp_init(void)
 {
+	u32 weights[CLAMP_MAX_CLUSTERS] = { 1, 1, 1, 1 };
 	struct cpufreq_policy *policy;
 	struct sunxi_clamp_control *clamp;
-	int ret;
+	const char *zone;
+	unsigned int n;
+	int cpu, ret;
 
 	clamp = kzalloc(sizeof(struct sunxi_clamp_control), GFP_KERNEL);
 	if (clamp == NULL) {
 		ret = -ENOMEM;
 		return ret;
 	}
+	mutex_init(&clamp->lock);
+
+	zone = sunxi_clamp_parse_dt(weights);
 
-	clamp->thermal = thermal_zone_get_zone_by_name(CPUB_THERMAL_ZONE);
+	clamp->thermal = thermal_zone_get_zone_by_name(zone);
 	if (IS_ERR(clamp->thermal)) {
 		sunxi_err(NULL, "Failed to get thermal zone (%ld)\n", PTR_ERR(clamp->thermal));
 		ret = -EPROBE_DEFER;
 		goto fail;
 	}
 
-	policy = cpufreq_cpu_get(CPUB_CORE_NUM);
-	if (!policy) {
-		sunxi_warn(NULL, "Cpufreq policy not found cpu0\n");
-		ret = -EPROBE_DEFER;
-		goto fail;
-	}
+	for_each_possible_cpu(cpu) {
+		if (clamp->nr_clusters == CLAMP_MAX_CLUSTERS)
+			break;
+
+		policy = cpufreq_cpu_get(cpu);
+		if (!policy)
+			continue;
+
+		/* one entry per policy, owned by its first cpu */
+		if (policy->cpu != cpu) {
+			cpufreq_cpu_put(policy);
+			continue;
+		}
 
-	ret = freq_qos_add_request(&policy->constraints, &clamp->qos_req, FREQ_QOS_MAX,
-				   policy->cpuinfo.max_freq);
+		n = clamp->nr_clusters;
+		ret = sunxi_clamp_cluster_init(&clamp->cluster[n], policy, weights[n]);
+		cpufreq_cpu_put(policy);
+		if (ret < 0) {
+			sunxi_err(NULL, "Failed to add freq constraint for cpu%d (%d)\n", cpu, ret);
+			goto fail_clusters;
+		}
 
-	cpufreq_cpu_put(policy);
+		clamp->max_power += sunxi_clamp_max_power(&clamp->cluster[n]);
+		clamp->nr_clusters++;
+	}
 
-	if (ret < 0) {
-		sunxi_err(NULL, "Failed to add freq constraint (%d)\n", ret);
+	if (!clamp->nr_clusters) {
+		sunxi_warn(NULL, "Cpufreq policy not found\n");
+		ret = -EPROBE_DEFER;
 		goto fail;
 	}
 
 	clamp_control = clamp;
 
 	INIT_DELAYED_WORK(&clamp->thermal_mon, thermal_zone_monitor);
-	schedule_delayed_work(&clamp->thermal_mon, msecs_to_jiffies(THERMAL_POLLING_DELAY));
+
+	clamp->alarm_nb.notifier_call = sunxi_clamp_alarm_notify;
+	clamp->irq_driven = !sunxi_ths_register_alarm_notifier(&clamp->alarm_nb);
+
+	sunxi_info(NULL, "%u cluster(s), %u mW max, %s\n", clamp->nr_clusters,
+		   clamp->max_power, clamp->irq_driven ? "alarm irq" : "polling");
+
+	/* one sample to catch a zone that is already hot */
+	schedule_delayed_work(&clamp->thermal_mon, 0);
 
 	return 0;
 
+fail_clusters:
+	sunxi_clamp_clusters_exit(clamp);
 fail:
 	kfree(clamp);
 
@@ -122,8 +658,11 @@ static void __exit sunxi_cpufreq_clamp_exit(void)
 	struct sunxi_clamp_control *clamp = clamp_control;
 
 	if (clamp) {
+		if (clamp->irq_driven)
+			sunxi_ths_unregister_alarm_notifier(&clamp->alarm_nb);
 		cancel_delayed_work_sync(&clamp->thermal_mon);
-		freq_qos_remove_request(&clamp->qos_req);
+		sunxi_clamp_clusters_exit(clamp);
+		clamp_control = NULL;
 		kfree(clamp);
 	}
 }
@@ -132,6 +671,6 @@ late_initcall(sunxi_cpufreq_clamp_init);
 module_exit(sunxi_cpufreq_clamp_exit);
 
 MODULE_AUTHOR("Maijianzhang<maijianzhang@allwinnertech.com");
-MODULE_VERSION("1.0.0");
+MODULE_VERSION("2.0.0");
 MODULE_DESCRIPTION("CPU frequency clamp for thermal control");
 MODULE_LICENSE("GPL");
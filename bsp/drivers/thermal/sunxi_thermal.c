@@ -30,8 +30,12 @@
 #define SUN50I_H616_THS_CTRL0			0x00
 #define SUN50I_H616_THS_ENABLE			0x04
 #define SUN50I_H616_THS_PC			0x08
+#define SUN50I_H616_THS_ALARM_INTC		0x18
 #define SUN50I_H616_THS_DATA_INTS		0x20
+#define SUN50I_H616_THS_ALARMO_INTS		0x28
+#define SUN50I_H616_THS_ALARM_INTS		0x2c
 #define SUN50I_H616_THS_MFC			0x30
+#define SUN50I_H616_THS_ALARM_CTRL(n)		(0x40 + 0x4 * (n))
 #define SUN50I_H616_THS_TEMP_CALIB		0xa0
 #define SUN50I_H616_THS_TEMP_DATA		0xc0
 
@@ -40,6 +44,8 @@
 #define SUN50I_THS_FILTER_EN			BIT(2)
 #define SUN50I_THS_FILTER_TYPE(x)		(GENMASK(1, 0) & (x))
 #define SUN50I_H616_THS_PC_TEMP_PERIOD(x)	((GENMASK(19, 0) & (x)) << 12)
+#define SUN50I_H616_THS_ALARM_T_HOT(x)		((GENMASK(11, 0) & (x)) << 16)
+#define SUN50I_H616_THS_ALARM_T_HYST(x)		(GENMASK(11, 0) & (x))
 
 #define SUN8IW11_THS_CTRL0			(0x00)
 #define SUN8IW11_THS_CTRL1			(0x04)
@@ -53,12 +59,144 @@
 #define SUN8IW11_THS_0_DATA			(0x80)
 #define SUN8IW11_THS_1_DATA			(0x84)
 
+static BLOCKING_NOTIFIER_HEAD(sunxi_ths_alarm_chain);
+static atomic_t sunxi_ths_alarm_devs = ATOMIC_INIT(0);
+
 /* Temp Unit: millidegree Celsius */
 static int sunxi_ths_reg2temp(struct ths_device *tmdev, int reg)
 {
 	return (reg + tmdev->chip->offset) * tmdev->chip->scale;
 }
 
+/* inverse of sun8i_ths_get_temp(), for the alarm thresholds */
+static u32 sunxi_ths_temp2reg(struct ths_device *tmdev, int temp)
+{
+	int reg;
+
+	if (tmdev->has_calibration)
+		temp -= tmdev->chip->ft_deviation;
+
+	reg = temp / tmdev->chip->scale - tmdev->chip->offset;
+
+	return clamp_t(int, reg, 0, TEMP_CALIB_MASK);
+}
+
+/*
+ * The sensor code falls as the temperature rises: the hot alarm fires when
+ * the code drops below T_HOT, the alarm-off interrupt when it climbs back
+ * above T_HYST.
+ */
+static void sunxi_ths_alarm_write(struct tsensor *s)
+{
+	struct ths_device *tmdev = s->tmdev;
+	u32 hot = 0, hyst = TEMP_CALIB_MASK;
+
+	if (s->alarm_high != INT_MAX)
+		hot = sunxi_ths_temp2reg(tmdev, s->alarm_high);
+	if (s->alarm_low != -INT_MAX)
+		hyst = sunxi_ths_temp2reg(tmdev, s->alarm_low);
+
+	regmap_write(tmdev->regmap, SUN50I_H616_THS_ALARM_CTRL(s->id),
+		     SUN50I_H616_THS_ALARM_T_HOT(hot) | SUN50I_H616_THS_ALARM_T_HYST(hyst));
+	regmap_update_bits(tmdev->regmap, SUN50I_H616_THS_ALARM_INTC,
+			   BIT(s->id), BIT(s->id));
+}
+
+static int sunxi_ths_set_alarm(struct tsensor *s, int low, int high)
+{
+	if (!s->tmdev->alarm_irq)
+		return -EOPNOTSUPP;
+
+	s->alarm_low = low;
+	s->alarm_high = high;
+	s->alarm_armed = true;
+	sunxi_ths_alarm_write(s);
+
+	return 0;
+}
+
+static irqreturn_t sunxi_ths_alarm_irq_thread(int irq, void *data)
+{
+	struct ths_device *tmdev = data;
+	unsigned int hot = 0, off = 0;
+	int i;
+
+	regmap_read(tmdev->regmap, SUN50I_H616_THS_ALARM_INTS, &hot);
+	regmap_read(tmdev->regmap, SUN50I_H616_THS_ALARMO_INTS, &off);
+	regmap_write(tmdev->regmap, SUN50I_H616_THS_ALARM_INTS, hot);
+	regmap_write(tmdev->regmap, SUN50I_H616_THS_ALARMO_INTS, off);
+
+	if (!(hot | off))
+		return IRQ_NONE;
+
+	for (i = 0; i < tmdev->chip->sensor_num; i++) {
+		struct tsensor *s = &tmdev->sensor[i];
+
+		if (!((hot | off) & BIT(i)) || IS_ERR_OR_NULL(s->tzd))
+			continue;
+
+		thermal_zone_device_update(s->tzd, THERMAL_EVENT_UNSPECIFIED);
+		blocking_notifier_call_chain(&sunxi_ths_alarm_chain, i, s->tzd);
+	}
+
+	return IRQ_HANDLED;
+}
+
+static int sunxi_ths_alarm_init(struct ths_device *tmdev)
+{
+	struct platform_device *pdev = to_platform_device(tmdev->dev);
+	int irq, ret;
+
+	if (!tmdev->chip->has_alarm)
+		return 0;
+
+	irq = platform_get_irq_optional(pdev, 0);
+	if (irq <= 0)
+		return 0;
+
+	regmap_write(tmdev->regmap, SUN50I_H616_THS_ALARM_INTC, 0);
+	ret = devm_request_threaded_irq(tmdev->dev, irq, NULL, sunxi_ths_alarm_irq_thread,
+					IRQF_ONESHOT, dev_name(tmdev->dev), tmdev);
+	if (ret) {
+		sunxi_err(tmdev->dev, "failed to request alarm irq\n");
+		return ret;
+	}
+
+	tmdev->alarm_irq = irq;
+	atomic_inc(&sunxi_ths_alarm_devs);
+
+	return 0;
+}
+
+/* re-arm the alarms after the registers were lost over suspend */
+static void sunxi_ths_alarm_restore(struct ths_device *tmdev)
+{
+	int i;
+
+	if (!tmdev->alarm_irq)
+		return;
+
+	for (i = 0; i < tmdev->chip->sensor_num; i++) {
+		if (tmdev->sensor[i].alarm_armed)
+			sunxi_ths_alarm_write(&tmdev->sensor[i]);
+	}
+}
+
+int sunxi_ths_register_alarm_notifier(struct notifier_block *nb)
+{
+	if (!atomic_read(&sunxi_ths_alarm_devs))
+		return -ENODEV;
+
+	return blocking_notifier_chain_register(&sunxi_ths_alarm_chain, nb);
+}
+EXPORT_SYMBOL_GPL(sunxi_ths_register_alarm_notifier);
+
+int sunxi_ths_unregister_alarm_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&sunxi_ths_alarm_chain, nb);
+}
+EXPORT_SYMBOL_GPL(sunxi_ths_unregister_alarm_notifier);
+
 static int sun8i_ths_get_temp(void *data, int *temp)
 {
 	struct tsensor *s = data;
@@ -228,9 +366,20 @@ static int sunxi_ths_get_temp(void *data, int *temp)
 	return tmdev->chip->get_temp(s, temp);
 }
 
+static int sunxi_ths_set_trips(void *data, int low, int high)
+{
+	return sunxi_ths_set_alarm(data, low, high);
+}
+
 static const struct thermal_zone_of_device_ops ths_ops = {
 	.get_temp = sunxi_ths_get_temp,
 };
+
+/* only with an alarm irq, otherwise the core polls the zone */
+static const struct thermal_zone_of_device_ops ths_alarm_ops = {
+	.get_temp = sunxi_ths_get_temp,
+	.set_trips = sunxi_ths_set_trips,
+};
 #else
 static int sunxi_ths_get_temp(struct thermal_zone_device *data, int *temp)
 {
@@ -240,10 +389,21 @@ static int sunxi_ths_get_temp(struct thermal_zone_device *data, int *temp)
 	return tmdev->chip->get_temp(s, temp);
 }
 
+static int sunxi_ths_set_trips(struct thermal_zone_device *data, int low, int high)
+{
+	return sunxi_ths_set_alarm((struct tsensor *)data->devdata, low, high);
+}
+
 static const struct thermal_zone_device_ops ths_ops = {
 	.get_temp = sunxi_ths_get_temp,
 };
 
+/* only with an alarm irq, otherwise the core polls the zone */
+static const struct thermal_zone_device_ops ths_alarm_ops = {
+	.get_temp = sunxi_ths_get_temp,
+	.set_trips = sunxi_ths_set_trips,
+};
+
 #endif
 static const struct regmap_config config = {
 	.reg_bits = 32,
@@ -660,7 +820,8 @@ static int sunxi_ths_register(struct ths_device *tmdev)
 			devm_thermal_zone_of_sensor_register(tmdev->dev,
 							     i,
 							     &tmdev->sensor[i],
-							     &ths_ops);
+							     tmdev->alarm_irq ?
+							     &ths_alarm_ops : &ths_ops);
 		if (IS_ERR(tmdev->sensor[i].tzd))
 			return PTR_ERR(tmdev->sensor[i].tzd);
 	}
@@ -679,7 +840,8 @@ static int sunxi_ths_register(struct ths_device *tmdev)
 			devm_thermal_of_zone_register(tmdev->dev,
 							i,
 							&tmdev->sensor[i],
-							&ths_ops);
+							tmdev->alarm_irq ?
+							&ths_alarm_ops : &ths_ops);
 		if (IS_ERR(tmdev->sensor[i].tzd))
 			return PTR_ERR(tmdev->sensor[i].tzd);
 	}
@@ -713,6 +875,10 @@ static int sunxi_ths_probe(struct platform_device *pdev)
 	if (ret)
 		return ret;
 
+	ret = sunxi_ths_alarm_init(tmdev);
+	if (ret)
+		return ret;
+
 #if IS_ENABLED(CONFIG_AW_THERMAL_CRITICAL_HANDLER)
 	ret = sunxi_ths_critical_handler_init(dev, tmdev);
 	if (ret)
@@ -738,6 +904,9 @@ static int sunxi_ths_remove(struct platform_device *pdev)
 	clk_disable_unprepare(tmdev->gpadc_clk);
 	clk_disable_unprepare(tmdev->ths_sclk);
 
+	if (tmdev->alarm_irq)
+		atomic_dec(&sunxi_ths_alarm_devs);
+
 #if IS_ENABLED(CONFIG_AW_THERMAL_CRITICAL_HANDLER)
 	sunxi_ths_critical_handler_deinit();
 #endif
@@ -773,11 +942,13 @@ static int __maybe_unused sunxi_thermal_resume(struct device *dev)
 	clk_prepare_enable(tmdev->bus_clk);
 	sunxi_ths_calibrate(tmdev);
 	tmdev->chip->init(tmdev);
+	sunxi_ths_alarm_restore(tmdev);
 
 	return 0;
 }
 
 static const struct ths_thermal_chip sun50iw9p1_ths = {
+	.has_alarm = true,
 	.sensor_num = 4,
 	.has_bus_clk = true,
 	.offset = -3255,
@@ -790,6 +961,7 @@ static const struct ths_thermal_chip sun50iw9p1_ths = {
 };
 
 static const struct ths_thermal_chip sun50iw10p1_ths = {
+	.has_alarm = true,
 	.sensor_num = 3,
 	.has_bus_clk = true,
 	.offset = -2794,
@@ -802,6 +974,7 @@ static const struct ths_thermal_chip sun50iw10p1_ths = {
 };
 
 static const struct ths_thermal_chip sun8iw20p1_ths = {
+	.has_alarm = true,
 	.sensor_num = 1,
 	.has_bus_clk = true,
 	.offset = -2800,
@@ -827,6 +1000,7 @@ static const struct ths_thermal_chip sun8iw11p1_ths = {
 };
 
 static const struct ths_thermal_chip sun8iw18p1_ths = {
+	.has_alarm = true,
 	.sensor_num = 1,
 	.has_bus_clk = true,
 	.offset = -2794,
@@ -898,5 +1072,5 @@ module_platform_driver(ths_driver);
 
 MODULE_DESCRIPTION("Thermal sensor driver for Allwinner SOC");
 MODULE_LICENSE("GPL v2");
-MODULE_VERSION("1.0.0");
+MODULE_VERSION("1.1.0");
 MODULE_AUTHOR("ALLWINNER");
@@ -9,6 +9,7 @@
 #define __SUNXI_THERMAL_H__
 #include <linux/clk.h>
 #include <linux/device.h>
+#include <linux/notifier.h>
 #include <linux/thermal.h>
 
 #define MAX_SENSOR_NUM	4
@@ -19,6 +20,10 @@ struct tsensor {
 	struct ths_device		*tmdev;
 	struct thermal_zone_device	*tzd;
 	int				id;
+	/* window last programmed by the thermal core through set_trips */
+	int				alarm_low;
+	int				alarm_high;
+	bool				alarm_armed;
 #if IS_ENABLED(CONFIG_AW_THERMAL_CRITICAL_HANDLER)
 	int				last_temp;
 #endif
@@ -28,6 +33,8 @@ struct ths_thermal_chip {
 	bool            has_bus_clk;
 	bool            has_ths_sclk;
 	bool            has_gpadc_clk;
+	/* per sensor hot/hysteresis alarm, linear offset/scale chips only */
+	bool            has_alarm;
 	int		sensor_num;
 	int		offset;
 	int		scale;
@@ -48,6 +55,14 @@ struct ths_device {
 	struct clk				*gpadc_clk;
 	struct tsensor				sensor[MAX_SENSOR_NUM];
 	struct reset_control			*reset;
+	int					alarm_irq;
 };
 
+/*
+ * Called from the alarm interrupt thread with the sensor id as action and
+ * the thermal zone as data, after the zone has been updated.
+ */
+int sunxi_ths_register_alarm_notifier(struct notifier_block *nb);
+int sunxi_ths_unregister_alarm_notifier(struct notifier_block *nb);
+
 #endif
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner TWI register poll benchmark
+ *
+ * Reads one register of a slave @count times per round, either as @count
+ * separate i2c_transfer() calls or as one i2c_transfer() of @count
+ * write+read pairs, which the drv-mode engine runs as a single packet
+ * sequence. Reports transactions per second and the CPU time the caller
+ * spends per transaction. Switch the bus to drv-mode (twi_mode = 1) to
+ * compare against the engine-mode path. The test runs once when the module
+ * is loaded, results go to the kernel log:
+ *
+ *   insmod twi-sunxi-bench.ko bus=1 addr=0x50 reg=0x00 len=2 count=16
+ */
+
+#define pr_fmt(fmt) "twi-sunxi-bench: " fmt
+
+#include <linux/i2c.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+static unsigned int bus = 1;
+module_param(bus, uint, 0444);
+MODULE_PARM_DESC(bus, "TWI bus number (default: 1)");
+
+static unsigned int addr = 0x50;
+module_param(addr, uint, 0444);
+MODULE_PARM_DESC(addr, "7-bit slave address (default: 0x50)");
+
+static unsigned int reg;
+module_param(reg, uint, 0444);
+MODULE_PARM_DESC(reg, "Register to poll (default: 0)");
+
+static unsigned int len = 2;
+module_param(len, uint, 0444);
+MODULE_PARM_DESC(len, "Bytes read per transaction (default: 2)");
+
+static unsigned int count = 16;
+module_param(count, uint, 0444);
+MODULE_PARM_DESC(count, "Transactions per round (default: 16)");
+
+static unsigned int iterations = 100;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Number of rounds per test (default: 100)");
+
+struct bench_ctx {
+	struct i2c_adapter	*adap;
+	struct i2c_msg		*msgs;
+	u8			reg;
+	u8			*buf;
+};
+
+static void bench_print(const char *name, u64 ns, u64 cpu_ns)
+{
+	u64 xfers = (u64)count * iterations;
+
+	pr_info("%-8s %llu transactions/s, %llu ns cpu per transaction\n", name,
+		div64_u64(xfers * NSEC_PER_SEC, max_t(u64, ns, 1)),
+		div64_u64(cpu_ns, xfers));
+}
+
+/* one i2c_transfer() per register read */
+static int bench_single(struct bench_ctx *ctx)
+{
+	u64 cpu, ns;
+	ktime_t start;
+	unsigned int i, j;
+	int ret;
+
+	cpu = current->se.sum_exec_runtime;
+	start = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < count; j++) {
+			ret = i2c_transfer(ctx->adap, &ctx->msgs[j * 2], 2);
+			if (ret != 2) {
+				pr_err("transfer failed at round %u: %d\n", i, ret);
+				return ret < 0 ? ret : -EIO;
+			}
+		}
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	bench_print("single", ns, current->se.sum_exec_runtime - cpu);
+
+	return 0;
+}
+
+/* all register reads of a round in one i2c_transfer() */
+static int bench_batch(struct bench_ctx *ctx)
+{
+	u64 cpu, ns;
+	ktime_t start;
+	unsigned int i;
+	int ret;
+
+	cpu = current->se.sum_exec_runtime;
+	start = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		ret = i2c_transfer(ctx->adap, ctx->msgs, count * 2);
+		if (ret != count * 2) {
+			pr_err("transfer failed at round %u: %d\n", i, ret);
+			return ret < 0 ? ret : -EIO;
+		}
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	bench_print("batched", ns, current->se.sum_exec_runtime - cpu);
+
+	/* every packet of the sequence must have read the same register */
+	for (i = 1; i < count; i++) {
+		if (memcmp(ctx->buf, ctx->buf + i * len, len))
+			pr_warn("packet %u differs from packet 0\n", i);
+	}
+
+	return 0;
+}
+
+static int __init sunxi_twi_bench_init(void)
+{
+	struct bench_ctx *ctx;
+	unsigned int i;
+	int ret;
+
+	if (!iterations || !count || !len || count > 1024)
+		return -EINVAL;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->adap = i2c_get_adapter(bus);
+	if (!ctx->adap) {
+		pr_err("no adapter %u\n", bus);
+		ret = -ENODEV;
+		goto err_free_ctx;
+	}
+
+	ctx->msgs = kcalloc(count * 2, sizeof(*ctx->msgs), GFP_KERNEL);
+	ctx->buf = kzalloc(count * len, GFP_KERNEL);
+	if (!ctx->msgs || !ctx->buf) {
+		ret = -ENOMEM;
+		goto err_free_buf;
+	}
+
+	ctx->reg = reg;
+	for (i = 0; i < count; i++) {
+		ctx->msgs[i * 2].addr = addr;
+		ctx->msgs[i * 2].len = 1;
+		ctx->msgs[i * 2].buf = &ctx->reg;
+		ctx->msgs[i * 2 + 1].addr = addr;
+		ctx->msgs[i * 2 + 1].flags = I2C_M_RD;
+		ctx->msgs[i * 2 + 1].len = len;
+		ctx->msgs[i * 2 + 1].buf = ctx->buf + i * len;
+	}
+
+	pr_info("%s: slave 0x%02x reg 0x%02x, %u bytes, %u x %u transactions\n",
+		ctx->adap->name, addr, reg, len, iterations, count);
+
+	ret = bench_single(ctx);
+	if (!ret)
+		ret = bench_batch(ctx);
+
+err_free_buf:
+	kfree(ctx->buf);
+	kfree(ctx->msgs);
+	i2c_put_adapter(ctx->adap);
+err_free_ctx:
+	kfree(ctx);
+	return ret;
+}
+module_init(sunxi_twi_bench_init);
+
+static void __exit sunxi_twi_bench_exit(void)
+{
+}
+module_exit(sunxi_twi_bench_exit);
+
+MODULE_DESCRIPTION("Allwinner TWI register poll benchmark");
+MODULE_LICENSE("GPL");
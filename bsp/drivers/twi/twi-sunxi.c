@@ -57,7 +57,7 @@
 #include <linux/rpbuf.h>
 #endif /* CONFIG_AW_TWI_DELAYINIT */
 
-#define SUNXI_TWI_VERSION	"2.6.9"
+#define SUNXI_TWI_VERSION	"2.7.0"
 
 /* TWI Register Offset */
 /* 31:8bit reserved,7-1bit for slave addr,0 bit for GCE */
@@ -360,6 +360,8 @@
 #define REG_CL			(0x0c)
 #define DMA_THRESHOLD	32
 #define MAX_FIFO		32
+/* bounce buffer of a drv-mode packet sequence */
+#define TWI_BATCH_BUF_SIZE	PAGE_SIZE
 #define DMA_TIMEOUT		1000
 #define TWI_READ	true
 #define TWI_WRITE	false
@@ -460,6 +462,12 @@ struct sunxi_twi {
 	u8 *dma_buf;
 	u32 vol;  /* the twi io voltage */
 
+	/* drv-mode packet sequence in flight, see sunxi_twi_drv_xfer_batch() */
+	bool batch;
+	u8 *batch_buf;
+	u64 batch_seq;
+	u64 batch_pkt;
+
 	/* other data */
 	int bus_num;
 	enum SUNXI_TWI_XFER_STATUS status; /* error, idle, running, shutdown */
@@ -1194,7 +1202,6 @@ static void sunxi_twi_drv_set_data_byte(void __iomem *base_addr, u32 len)
 }
 
 /* interval between each packet in 32*Fscl cycles */
-/*
 static void sunxi_twi_drv_set_packet_interval(void __iomem *base_addr, u32 val)
 {
 	u32 reg_val = readl(base_addr + TWI_DRV_CFG);
@@ -1204,7 +1211,6 @@ static void sunxi_twi_drv_set_packet_interval(void __iomem *base_addr, u32 val)
 
 	writel(reg_val, base_addr + TWI_DRV_CFG);
 }
-*/
 
 /* FIFO data be transmitted as PACKET_CNT packets in current format */
 static void sunxi_twi_drv_set_packet_cnt(void __iomem *base_addr, u32 val)
@@ -1689,8 +1695,20 @@ static int sunxi_twi_drv_core_process(struct sunxi_twi *twi)
 		 * dma read tiggered by DMA_RX_Req(RECV_FIFO not empty)
 		 * */
 		if (twi->msg->flags & I2C_M_RD) {
-			if (twi->msg->len <= MAX_FIFO) /* cpu read */
+			if (twi->msg->len <= MAX_FIFO && !twi->batch) /* cpu read */
 				return 0; /* current read opration not end, go on and get data by next RX_REQ_PD */
+
+			/* RX_REQ is off for a packet sequence, every packet is in the fifo now */
+			if (twi->msg->len <= MAX_FIFO) {
+				if (sunxi_twi_drv_recv_msg(twi, twi->msg))
+					twi->status = SUNXI_TWI_XFER_STATUS_ERROR;
+				else
+					twi->status = SUNXI_TWI_XFER_STATUS_COMPLETE;
+
+				sunxi_twi_drv_disable_irq(twi->base_addr, TWI_DRV_INT_EN_MASK);
+				wake_up(&twi->wait);
+				return 0;
+			}
 		}
 
 		/* dma read end or write end */
@@ -2049,6 +2067,20 @@ static irqreturn_t sunxi_twi_handler(int this_irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+/*
+ * Every drv-mode sequence of one i2c_transfer() waits for its own completion,
+ * put the status back to running once the previous sequence completed.
+ */
+static void sunxi_twi_drv_rearm(struct sunxi_twi *twi)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&twi->lock, flags);
+	if (twi->status == SUNXI_TWI_XFER_STATUS_COMPLETE)
+		twi->status = SUNXI_TWI_XFER_STATUS_RUNNING;
+	spin_unlock_irqrestore(&twi->lock, flags);
+}
+
 /* twi controller tx xfer function
  * return the xfered msgs num on success,or the negative error num on failed
  */
@@ -2065,6 +2097,7 @@ static int sunxi_twi_drv_tx_one_msg(struct sunxi_twi *twi, struct i2c_msg *msg)
 	twi->buf_idx = 0;
 	spin_unlock_irqrestore(&twi->lock, flags);
 
+	sunxi_twi_drv_rearm(twi);
 	sunxi_twi_drv_disable_read_mode(twi->base_addr);
 	sunxi_twi_drv_set_slave_addr(twi, msg);
 	if (msg->len == 1) {
@@ -2160,6 +2193,7 @@ sunxi_twi_drv_rx_msgs(struct sunxi_twi *twi, struct i2c_msg *msgs, int num)
 
 	twi->msg = rmsg;
 
+	sunxi_twi_drv_rearm(twi);
 	sunxi_twi_drv_set_slave_addr(twi, rmsg);
 	sunxi_twi_drv_set_packet_cnt(twi->base_addr, 1);
 	sunxi_twi_drv_set_data_byte(twi->base_addr, rmsg->len);
@@ -2206,6 +2240,185 @@ err_dma:
 	return ret;
 }
 
+/*
+ * Count the transactions at @msgs sharing one drv-mode packet format: same
+ * slave and lengths, all single writes, all single reads or all write+read
+ * register reads (@step 2). The register addresses of a read sequence are
+ * preloaded into the send fifo, the data of a sequence goes through
+ * batch_buf.
+ */
+static int sunxi_twi_drv_batch_cnt(struct sunxi_twi *twi, struct i2c_msg *msgs,
+				   int num, int *step)
+{
+	const u16 flags_ok = I2C_M_RD | I2C_M_TEN;
+	struct i2c_msg *n;
+	int s, k, cnt;
+	u32 tx_len, rx_len;
+
+	if (!twi->batch_buf || num < 2)
+		return 1;
+
+	if (!(msgs[0].flags & I2C_M_RD) && (msgs[1].flags & I2C_M_RD))
+		s = 2;
+	else
+		s = 1;
+	*step = s;
+
+	for (k = 0; k < s; k++) {
+		if (!msgs[k].len || (msgs[k].flags & ~flags_ok) ||
+		    msgs[k].addr != msgs[0].addr)
+			return 1;
+	}
+
+	if (s == 2) {
+		tx_len = msgs[0].len;
+		rx_len = msgs[1].len;
+	} else if (msgs[0].flags & I2C_M_RD) {
+		tx_len = 0;
+		rx_len = msgs[0].len;
+	} else {
+		tx_len = msgs[0].len;
+		rx_len = 0;
+	}
+
+	for (cnt = 1; (cnt + 1) * s <= num && cnt < PACKET_CNT; cnt++) {
+		n = &msgs[cnt * s];
+		for (k = 0; k < s; k++) {
+			if (n[k].addr != msgs[k].addr || n[k].flags != msgs[k].flags ||
+			    n[k].len != msgs[k].len)
+				return cnt;
+		}
+
+		/* a write followed by a read belongs to a register read */
+		if (s == 1 && !(n->flags & I2C_M_RD) && (cnt + 1) < num &&
+		    (n[1].flags & I2C_M_RD))
+			return cnt;
+
+		if (rx_len) {
+			if ((cnt + 1) * tx_len > MAX_FIFO ||
+			    (cnt + 1) * rx_len > TWI_BATCH_BUF_SIZE)
+				return cnt;
+		} else if ((cnt + 1) * tx_len > TWI_BATCH_BUF_SIZE) {
+			return cnt;
+		}
+	}
+
+	return cnt;
+}
+
+/*
+ * Run @cnt transactions of the same format as one drv-mode packet sequence:
+ * PACKET_CNT packets separated by pkt_interval, the fifo (or dma) carries
+ * the register address or write data of all packets back to back, and a
+ * single TRAN_COM interrupt ends the whole sequence.
+ */
+static int sunxi_twi_drv_xfer_batch(struct sunxi_twi *twi, struct i2c_msg *msgs,
+				    int step, int cnt)
+{
+	struct i2c_msg *dmsg = &msgs[step - 1];
+	bool read = dmsg->flags & I2C_M_RD;
+	struct i2c_msg bmsg, amsg;
+	u32 addr_len, data_len, len = 0;
+	unsigned long flags;
+	int i, ret;
+
+	TWI_DBG(twi, "drv-mode: %d packets, slave_addr=0x%x, step %d, data_len=0x%x\n",
+			cnt, dmsg->addr, step, dmsg->len);
+
+	if (read) {
+		addr_len = (step == 2) ? msgs[0].len : 0;
+		data_len = dmsg->len;
+	} else {
+		addr_len = (dmsg->len == 1) ? 0 : 1;
+		data_len = dmsg->len - addr_len;
+	}
+
+	/* register addresses of a read, the whole payload of a write */
+	for (i = 0; i < cnt && (!read || addr_len); i++) {
+		memcpy(twi->batch_buf + len, msgs[i * step].buf, msgs[i * step].len);
+		len += msgs[i * step].len;
+	}
+
+	bmsg.addr = dmsg->addr;
+	bmsg.flags = dmsg->flags | I2C_M_DMA_SAFE;
+	bmsg.len = read ? data_len * cnt : len;
+	bmsg.buf = twi->batch_buf;
+
+	spin_lock_irqsave(&twi->lock, flags);
+	twi->msg = &bmsg;
+	twi->buf_idx = 0;
+	twi->batch = true;
+	spin_unlock_irqrestore(&twi->lock, flags);
+
+	sunxi_twi_drv_rearm(twi);
+	if (read && !addr_len)
+		sunxi_twi_drv_enable_read_mode(twi->base_addr);
+	else
+		sunxi_twi_drv_disable_read_mode(twi->base_addr);
+	sunxi_twi_drv_set_slave_addr(twi, dmsg);
+	sunxi_twi_drv_set_addr_byte(twi->base_addr, addr_len);
+	sunxi_twi_drv_set_data_byte(twi->base_addr, data_len);
+	sunxi_twi_drv_set_packet_cnt(twi->base_addr, cnt);
+	sunxi_twi_drv_set_packet_interval(twi->base_addr, twi->pkt_interval);
+
+	if (read && len) {
+		/* fits the fifo, checked by sunxi_twi_drv_batch_cnt() */
+		amsg = bmsg;
+		amsg.len = len;
+		sunxi_twi_drv_send_msg(twi, &amsg);
+	}
+
+	if (bmsg.len > MAX_FIFO) {
+		ret = read ? sunxi_twi_dma_rx_config(twi) : sunxi_twi_dma_tx_config(twi);
+		if (ret) {
+			sunxi_err(twi->dev, "drv-mode: batch dma config failed\n");
+			goto out;
+		}
+	} else {
+		if (read) {
+			sunxi_twi_drv_set_rx_trig(twi->base_addr, MAX_FIFO);
+		} else {
+			sunxi_twi_drv_set_tx_trig(twi->base_addr, bmsg.len);
+			sunxi_twi_drv_send_msg(twi, &bmsg);
+		}
+		sunxi_twi_drv_start_xfer(twi);
+	}
+	sunxi_twi_drv_enable_irq(twi->base_addr, TRAN_ERR_INT_EN | TRAN_COM_INT_EN);
+
+	ret = sunxi_twi_drv_wait_complete(twi);
+
+	if (bmsg.len > MAX_FIFO) {
+		struct sunxi_twi_dma **dma = read ? &twi->dma_rx : &twi->dma_tx;
+
+		if (ret < 0)
+			dmaengine_terminate_sync((*dma)->chan);
+		sunxi_twi_drv_dma_deinit(twi, dma);
+		sunxi_twi_drv_disable_dma_irq(twi->base_addr, read ? DMA_RX_EN : DMA_TX_EN);
+	}
+
+	if (!ret && read) {
+		for (i = 0; i < cnt; i++)
+			memcpy(msgs[i * step + step - 1].buf,
+			       twi->batch_buf + i * data_len, data_len);
+	}
+
+	if (!ret) {
+		twi->batch_seq++;
+		twi->batch_pkt += cnt;
+	}
+
+out:
+	sunxi_twi_drv_disable_irq(twi->base_addr, TWI_DRV_INT_EN_MASK);
+	sunxi_twi_drv_set_packet_interval(twi->base_addr, 0);
+
+	spin_lock_irqsave(&twi->lock, flags);
+	twi->batch = false;
+	twi->msg = dmsg;
+	spin_unlock_irqrestore(&twi->lock, flags);
+
+	return ret;
+}
+
 /**
  * @twi: struct of sunxi_twi
  * @msgs: One or more messages to execute before STOP is issued to terminate
@@ -2217,7 +2430,7 @@ err_dma:
 static int
 sunxi_twi_drv_xfer(struct sunxi_twi *twi, struct i2c_msg *msgs, int num)
 {
-	int i = 0;
+	int i = 0, cnt, step;
 
 	sunxi_twi_drv_clear_irq(twi->base_addr, TWI_DRV_INT_STA_MASK);
 	sunxi_twi_drv_disable_irq(twi->base_addr, TWI_DRV_INT_STA_MASK);
@@ -2229,7 +2442,13 @@ sunxi_twi_drv_xfer(struct sunxi_twi *twi, struct i2c_msg *msgs, int num)
 	while (i < num) {
 		TWI_DBG(twi, "drv-mode: addr: 0x%x, flag:%x, len:%d\n",
 			msgs[i].addr, msgs[i].flags, msgs[i].len);
-		if (msgs[i].flags & I2C_M_RD) {
+		cnt = sunxi_twi_drv_batch_cnt(twi, &msgs[i], num - i, &step);
+		if (cnt > 1) {
+			/* same format transactions in one packet sequence */
+			if (sunxi_twi_drv_xfer_batch(twi, &msgs[i], step, cnt))
+				return -EINVAL;
+			i += cnt * step;
+		} else if (msgs[i].flags & I2C_M_RD) {
 			/* one msg read */
 			if (sunxi_twi_drv_rx_msgs(twi, &msgs[i], 1))
 				return -EINVAL;
@@ -2850,6 +3069,7 @@ static ssize_t sunxi_twi_status_show(struct device *dev,
 			"twi->bus_freq  = %u\n"
 			"twi->irq       = %d\n"
 			"twi->debug_state = %u\n"
+			"twi->batch_seq = %llu, ->batch_pkt = %llu\n"
 			"twi->base_addr = 0x%p, the TWI control register:\n"
 			"[ADDR] 0x%02x = 0x%08x, [XADDR] 0x%02x = 0x%08x\n"
 			"[DATA] 0x%02x = 0x%08x, [CNTR] 0x%02x = 0x%08x\n"
@@ -2859,6 +3079,7 @@ static ssize_t sunxi_twi_status_show(struct device *dev,
 			twi->bus_num, twi->status,  twi_status[twi->status],
 			twi->msg_num, twi->msg_idx, twi->buf_idx,
 			twi->bus_freq, twi->irq, twi->debug_state,
+			twi->batch_seq, twi->batch_pkt,
 			twi->base_addr,
 			TWI_ADDR,	readl(twi->base_addr + TWI_ADDR),
 			TWI_XADDR,	readl(twi->base_addr + TWI_XADDR),
@@ -3111,6 +3332,10 @@ static int sunxi_twi_probe(struct platform_device *pdev)
 	spin_lock_init(&twi->lock);
 	init_waitqueue_head(&twi->wait);
 
+	/* without it every drv-mode transaction runs as its own sequence */
+	if (!of_property_read_bool(pdev->dev.of_node, "twi_no_batch"))
+		twi->batch_buf = devm_kzalloc(twi->dev, TWI_BATCH_BUF_SIZE, GFP_KERNEL);
+
 	sunxi_twi_create_sysfs(pdev);
 
 	pm_runtime_set_active(twi->dev);
@@ -31,6 +31,8 @@
 #include <linux/delay.h>
 #include <linux/ctype.h>
 #include <linux/slab.h>
+#include <linux/sizes.h>
+#include <linux/log2.h>
 #include <linux/proc_fs.h>
 #include <linux/platform_device.h>
 #include <linux/pinctrl/consumer.h>
@@ -80,14 +82,19 @@ static inline bool sw_is_console_port(struct uart_port *port)
 #define TX_DMA		1
 #define RX_DMA		2
 #define DMA_SERIAL_BUFFER_SIZE	(PAGE_SIZE)
+#define DMA_SERIAL_BUFFER_MAX	(SZ_64K)
+/* the rx ring is split in two periods: half and full buffer callbacks */
+#define DMA_SERIAL_RX_PERIODS	2
+/* the dma channel timer counts in 20.48us steps, up to 511 */
+#define DMA_SERIAL_STEP_NS	20480
+#define DMA_SERIAL_STEP_MAX	511
+/* idle time before the rx ring is drained, in characters */
+#define DMA_SERIAL_IDLE_CHARS	4
+/* rx polling period when the dma channel has no timeout, in ns */
+#define DMA_SERIAL_RX_POLL_NS	2000000
 #define SERIAL_CIRC_CNT_TO_END(xmit) \
 	CIRC_CNT_TO_END(xmit->head, xmit->tail, UART_XMIT_SIZE)
 
-enum uart_time_use {
-	UART_NO_USE_TIMER = 0,
-	UART_USE_TIMER,
-};
-
 #if IS_ENABLED(CONFIG_AW_SERIAL_DMA)
 static void sw_uart_stop_dma_tx(struct sw_uart_port *sw_uport);
 static void sw_uart_release_dma_tx(struct sw_uart_port *sw_uport);
@@ -98,8 +105,7 @@ static void sw_uart_stop_dma_tx(struct sw_uart_port *sw_uport);
 static void sw_uart_release_dma_rx(struct sw_uart_port *sw_uport);
 static int sw_uart_init_dma_rx(struct sw_uart_port *sw_uport);
 static int sw_uart_start_dma_rx(struct sw_uart_port *sw_uport);
-static void sw_uart_update_rb_addr(struct sw_uart_port *sw_uport);
-static enum hrtimer_restart  sw_uart_report_dma_rx(struct hrtimer *rx_hrtimer);
+static unsigned int sw_uart_dma_rx_drain(struct sw_uart_port *sw_uport);
 #endif
 
 #if IS_ENABLED(CONFIG_SW_UART_DUMP_DATA)
@@ -215,10 +221,17 @@ static unsigned int sw_uart_handle_rx(struct sw_uart_port *sw_uport, unsigned in
 
 #if IS_ENABLED(CONFIG_AW_SERIAL_DMA)
 	if ((sw_uport->dma->use_dma & RX_DMA)) {
+		if (lsr & SUNXI_UART_LSR_OE)
+			sw_uport->port.icount.overrun++;
 		if (lsr & SUNXI_UART_LSR_RXFIFOE) {
 			sunxi_info(sw_uport->port.dev, "error:lsr=0x%x\n", lsr);
 			lsr = serial_in(&sw_uport->port, SUNXI_UART_LSR);
-			return lsr;
+		}
+		if (sw_uart_dma_rx_drain(sw_uport)) {
+			sw_uport->dma->rx_irq_drains++;
+			spin_unlock(&sw_uport->port.lock);
+			tty_flip_buffer_push(&sw_uport->port.state->port);
+			spin_lock(&sw_uport->port.lock);
 		}
 		return lsr;
 	}
@@ -631,19 +644,191 @@ static void sw_uart_stop_dma_rx(struct sw_uart_port *sw_uport)
 	struct sw_uart_dma *uart_dma = sw_uport->dma;
 
 	if (uart_dma && uart_dma->rx_dma_used) {
-		hrtimer_cancel(&sw_uport->rx_hrtimer);
+		/*
+		 * Called with port->lock held, a poll waiting for the lock
+		 * sees rx_dma_used cleared and does not restart.
+		 */
+		if (uart_dma->use_timer)
+			hrtimer_try_to_cancel(&sw_uport->rx_hrtimer);
 		dmaengine_terminate_all(uart_dma->dma_chan_rx);
+		uart_dma->rb_head = 0;
 		uart_dma->rb_tail = 0;
 		uart_dma->rx_dma_used = 0;
 	}
 }
 
+/*
+ * Move everything the dma has written since the last call into the tty
+ * flip buffer, in at most two chunks. Called with port->lock held; the
+ * caller pushes the flip buffer once the lock is dropped.
+ */
+static unsigned int sw_uart_dma_rx_drain(struct sw_uart_port *sw_uport)
+{
+	struct uart_port *port = &sw_uport->port;
+	struct sw_uart_dma *uart_dma = sw_uport->dma;
+	struct tty_port *tport = &port->state->port;
+	struct dma_tx_state state;
+	unsigned int total, count, flip;
+	ktime_t now;
+	s64 lat_us;
+
+	if (!uart_dma->rx_dma_used)
+		return 0;
+
+	dmaengine_tx_status(uart_dma->dma_chan_rx, uart_dma->rx_cookie, &state);
+	uart_dma->rb_head = (uart_dma->rb_size - state.residue) &
+				(uart_dma->rb_size - 1);
+
+	total = CIRC_CNT(uart_dma->rb_head, uart_dma->rb_tail, uart_dma->rb_size);
+	if (!total)
+		return 0;
+
+	/*
+	 * Every byte received since the previous drain is at most this old,
+	 * so the gap between two drains bounds the rx latency.
+	 */
+	now = ktime_get();
+	lat_us = ktime_us_delta(now, uart_dma->rx_last_drain);
+	uart_dma->rx_last_drain = now;
+	if (lat_us > uart_dma->rx_lat_max_us)
+		uart_dma->rx_lat_max_us = min_t(s64, lat_us, U32_MAX);
+	if (total > uart_dma->rx_max_chunk)
+		uart_dma->rx_max_chunk = total;
+
+	count = CIRC_CNT_TO_END(uart_dma->rb_head, uart_dma->rb_tail,
+				uart_dma->rb_size);
+	flip = tty_insert_flip_string(tport,
+			uart_dma->rx_buffer + uart_dma->rb_tail, count);
+	if (total > count)
+		flip += tty_insert_flip_string(tport, uart_dma->rx_buffer,
+					       total - count);
+
+	if (unlikely(flip != total)) {
+		SERIAL_DBG(port->dev, "flip buffer overrun, %u dropped\n",
+			   total - flip);
+		port->icount.buf_overrun++;
+	}
+
+	uart_dma->rb_tail = uart_dma->rb_head;
+	port->icount.rx += total;
+
+	return total;
+}
+
+static void sw_uart_dma_rx_complete(struct sw_uart_port *sw_uport, bool idle)
+{
+	struct uart_port *port = &sw_uport->port;
+	struct sw_uart_dma *uart_dma = sw_uport->dma;
+	unsigned int count;
+	unsigned long flags;
+
+	spin_lock_irqsave(&port->lock, flags);
+	if (idle)
+		uart_dma->rx_idle_events++;
+	else
+		uart_dma->rx_period_events++;
+	count = sw_uart_dma_rx_drain(sw_uport);
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	if (count)
+		tty_flip_buffer_push(&port->state->port);
+}
+
+/* half or full rx ring */
+static void sw_uart_dma_rx_period(void *arg)
+{
+	sw_uart_dma_rx_complete(arg, false);
+}
+
+/* dma channel timeout: the line went idle with data left in the ring */
+static void sw_uart_dma_rx_idle(void *arg)
+{
+	sw_uart_dma_rx_complete(arg, true);
+}
+
+/* rx poll, for dma channels without timeout support */
+static enum hrtimer_restart sw_uart_report_dma_rx(struct hrtimer *rx_hrtimer)
+{
+	struct sw_uart_port *sw_uport = container_of(rx_hrtimer,
+						struct sw_uart_port, rx_hrtimer);
+	struct uart_port *port = &sw_uport->port;
+	struct sw_uart_dma *uart_dma = sw_uport->dma;
+	unsigned int count;
+	unsigned long flags;
+
+	spin_lock_irqsave(&port->lock, flags);
+	if (!uart_dma->rx_dma_used) {
+		spin_unlock_irqrestore(&port->lock, flags);
+		return HRTIMER_NORESTART;
+	}
+	count = sw_uart_dma_rx_drain(sw_uport);
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	if (count)
+		tty_flip_buffer_push(&port->state->port);
+
+	hrtimer_forward_now(rx_hrtimer, ns_to_ktime(uart_dma->rx_timeout));
+	return HRTIMER_RESTART;
+}
+
+/* Only these dma controller revisions implement the channel timeout */
+static bool sw_uart_dma_has_timeout(struct dma_chan *chan)
+{
+	static const char * const compat[] = {
+		"allwinner,dma-v105",
+		"allwinner,dma-v106",
+		"allwinner,dma-v107",
+		NULL
+	};
+
+	return of_device_compatible_match(chan->device->dev->of_node, compat);
+}
+
+/* Convert DMA_SERIAL_IDLE_CHARS at @baud into dma channel timer steps */
+static void sw_uart_dma_rx_set_idle(struct sw_uart_port *sw_uport,
+				    unsigned int baud)
+{
+	struct sw_uart_dma *uart_dma = sw_uport->dma;
+	u64 idle_ns;
+	u32 steps;
+
+	if (!baud)
+		return;
+
+	/* 10 bits per character: start, 8 data bits and stop */
+	idle_ns = div_u64(DMA_SERIAL_IDLE_CHARS * 10ULL * NSEC_PER_SEC, baud);
+	steps = clamp_t(u64, DIV_ROUND_UP_ULL(idle_ns, DMA_SERIAL_STEP_NS),
+			1, DMA_SERIAL_STEP_MAX);
+
+	if (steps == uart_dma->rx_idle_steps)
+		return;
+
+	uart_dma->rx_idle_steps = steps;
+	uart_dma->sunxi_desc.timeout_steps = steps;
+
+	/*
+	 * The timer is part of the descriptor, restart with the new value.
+	 * Called with port->lock held: the ring is drained first so nothing
+	 * received before the restart is lost, the flip buffer push only
+	 * queues work.
+	 */
+	if (uart_dma->rx_dma_used && !uart_dma->use_timer) {
+		if (sw_uart_dma_rx_drain(sw_uport))
+			tty_flip_buffer_push(&sw_uport->port.state->port);
+		sw_uart_stop_dma_rx(sw_uport);
+		sw_uart_start_dma_rx(sw_uport);
+	}
+}
+
 static void sw_uart_release_dma_rx(struct sw_uart_port *sw_uport)
 {
 	struct sw_uart_dma *uart_dma = sw_uport->dma;
 
 	if (uart_dma && uart_dma->rx_dma_inited) {
 		sw_uart_stop_dma_rx(sw_uport);
+		if (uart_dma->use_timer)
+			hrtimer_cancel(&sw_uport->rx_hrtimer);
+		dmaengine_synchronize(uart_dma->dma_chan_rx);
 		dma_free_coherent(sw_uport->port.dev, sw_uport->dma->rb_size,
 			sw_uport->dma->rx_buffer, sw_uport->dma->rx_phy_addr);
 		dma_release_channel(uart_dma->dma_chan_rx);
@@ -658,6 +843,7 @@ static int sw_uart_init_dma_rx(struct sw_uart_port *sw_uport)
 	struct uart_port *port = &sw_uport->port;
 	struct dma_slave_config slave_config;
 	struct sw_uart_dma *uart_dma = sw_uport->dma;
+	struct sunxi_dma_desc *sunxi_desc;
 
 	if (!uart_dma) {
 		sunxi_info(port->dev, "sw_uart_init_dma_rx: port fail\n");
@@ -668,11 +854,29 @@ static int sw_uart_init_dma_rx(struct sw_uart_port *sw_uport)
 		return 0;
 
 	uart_dma->dma_chan_rx = dma_request_chan(sw_uport->port.dev, "rx");
-	if (!uart_dma->dma_chan_rx) {
+	if (IS_ERR_OR_NULL(uart_dma->dma_chan_rx)) {
 		sunxi_err(port->dev, "cannot get the DMA channel.\n");
+		uart_dma->dma_chan_rx = NULL;
 		return -1;
 	}
 
+	/*
+	 * Let the dma channel timer report the end of a burst, the ring is
+	 * then drained right away. Controllers without the timer ignore the
+	 * setting, keep polling the ring there.
+	 */
+	uart_dma->use_timer = !sw_uart_dma_has_timeout(uart_dma->dma_chan_rx);
+	sunxi_desc = &uart_dma->sunxi_desc;
+	sunxi_desc->is_bmode = 1;
+	sunxi_desc->is_timeout = 1;
+	if (!uart_dma->rx_idle_steps)
+		uart_dma->rx_idle_steps = 100;
+	sunxi_desc->timeout_steps = uart_dma->rx_idle_steps;
+	sunxi_desc->timeout_fun = 0x0; /* dma pending, no other option */
+	sunxi_desc->callback = sw_uart_dma_rx_idle;
+	sunxi_desc->callback_param = sw_uport;
+	uart_dma->dma_chan_rx->private = sunxi_desc;
+
 	slave_config.direction = DMA_DEV_TO_MEM;
 	slave_config.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
 	slave_config.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE;
@@ -708,8 +912,9 @@ static int sw_uart_start_dma_rx(struct sw_uart_port *sw_uport)
 		return -1;
 	}
 	desc = dmaengine_prep_dma_cyclic(uart_dma->dma_chan_rx,
-				uart_dma->rx_phy_addr, uart_dma->rb_size, 1,
-					DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+				uart_dma->rx_phy_addr, uart_dma->rb_size,
+				uart_dma->rb_size / DMA_SERIAL_RX_PERIODS,
+				DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
 
 	if (!desc) {
 		sunxi_err(port->dev, "get rx dma descriptor failed!\n");
@@ -717,68 +922,104 @@ static int sw_uart_start_dma_rx(struct sw_uart_port *sw_uport)
 	}
 
 	SERIAL_DBG(port->dev, "RX: prepare for the DMA.\n");
+	desc->callback = sw_uart_dma_rx_period;
+	desc->callback_param = sw_uport;
+	uart_dma->rb_head = 0;
+	uart_dma->rb_tail = 0;
+	uart_dma->rx_last_drain = ktime_get();
 	uart_dma->rx_cookie = dmaengine_submit(desc);
 	dma_async_issue_pending(uart_dma->dma_chan_rx);
 
 	uart_dma->rx_dma_used = 1;
-	if (uart_dma->use_timer == 1) {
+	if (uart_dma->use_timer)
 		hrtimer_start(&sw_uport->rx_hrtimer,
 			ns_to_ktime(uart_dma->rx_timeout), HRTIMER_MODE_REL);
-	}
 	return 1;
 }
 
-static void sw_uart_update_rb_addr(struct sw_uart_port *sw_uport)
-{
-	struct sw_uart_dma *uart_dma = sw_uport->dma;
-	struct dma_tx_state state;
-	uart_dma->rx_size = 0;
-	if (uart_dma->rx_dma_used == 1) {
-		dmaengine_tx_status(uart_dma->dma_chan_rx, uart_dma->rx_cookie,
-									&state);
-		if ((uart_dma->rb_size - state.residue) !=
-						sw_uport->rx_last_pos) {
-			uart_dma->rb_head = uart_dma->rb_size - state.residue;
-			sw_uport->rx_last_pos = uart_dma->rb_head;
-		}
-	}
-}
-
-static enum hrtimer_restart sw_uart_report_dma_rx(struct hrtimer *rx_hrtimer)
+/*
+ * Resize the rx ring at runtime. The dma is stopped while the buffers are
+ * swapped, whatever was left in the old ring is pushed to the tty first.
+ * The tty port mutex keeps startup()/shutdown() from running meanwhile.
+ */
+static int sw_uart_dma_rx_resize(struct sw_uart_port *sw_uport, u32 size)
 {
-	int count, flip = 0;
-	struct sw_uart_port *sw_uport = container_of(rx_hrtimer,
-						struct sw_uart_port, rx_hrtimer);
 	struct uart_port *port = &sw_uport->port;
 	struct sw_uart_dma *uart_dma = sw_uport->dma;
+	struct tty_port *tport;
+	dma_addr_t new_phy, old_phy;
+	char *new_buf, *old_buf;
+	unsigned int count = 0;
+	unsigned long flags;
+	u32 old_size;
+	bool running;
 
-	if (!uart_dma->rx_dma_used || !port->state->port.tty)
-		return HRTIMER_NORESTART;
+	if (!is_power_of_2(size) || size < DMA_SERIAL_BUFFER_SIZE ||
+	    size > DMA_SERIAL_BUFFER_MAX)
+		return -EINVAL;
 
-	sw_uart_update_rb_addr(sw_uport);
-	while (1) {
-		count = CIRC_CNT_TO_END(uart_dma->rb_head, uart_dma->rb_tail,
-							uart_dma->rb_size);
-		if (count <= 0)
-			break;
-		port->icount.rx += count;
-		flip = tty_insert_flip_string(&port->state->port,
-				uart_dma->rx_buffer + uart_dma->rb_tail, count);
-		tty_flip_buffer_push(&port->state->port);
-		uart_dma->rb_tail =
-			(uart_dma->rb_tail + count) & (uart_dma->rb_size - 1);
+	/* not registered with the serial core yet */
+	if (!port->state)
+		return -ENODEV;
+	tport = &port->state->port;
+
+	mutex_lock(&tport->mutex);
+	if (size == uart_dma->rb_size) {
+		mutex_unlock(&tport->mutex);
+		return 0;
 	}
 
-	if (uart_dma->use_timer == 1) {
-		hrtimer_forward_now(&sw_uport->rx_hrtimer,
-				ns_to_ktime(uart_dma->rx_timeout));
+	new_buf = dma_alloc_coherent(port->dev, size, &new_phy, GFP_KERNEL);
+	if (!new_buf) {
+		mutex_unlock(&tport->mutex);
+		return -ENOMEM;
 	}
 
-	return HRTIMER_RESTART;
+	spin_lock_irqsave(&port->lock, flags);
+	running = uart_dma->rx_dma_used;
+	if (running) {
+		count = sw_uart_dma_rx_drain(sw_uport);
+		sw_uart_stop_dma_rx(sw_uport);
+	}
+	old_buf = uart_dma->rx_buffer;
+	old_phy = uart_dma->rx_phy_addr;
+	old_size = uart_dma->rb_size;
+	uart_dma->rx_buffer = new_buf;
+	uart_dma->rx_phy_addr = new_phy;
+	uart_dma->rb_size = size;
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	if (count)
+		tty_flip_buffer_push(tport);
+
+	if (uart_dma->dma_chan_rx)
+		dmaengine_synchronize(uart_dma->dma_chan_rx);
+	dma_free_coherent(port->dev, old_size, old_buf, old_phy);
+
+	if (running) {
+		spin_lock_irqsave(&port->lock, flags);
+		sw_uart_start_dma_rx(sw_uport);
+		spin_unlock_irqrestore(&port->lock, flags);
+	}
+	mutex_unlock(&tport->mutex);
+
+	return 0;
 }
 
 #endif
 
+static void sw_uart_handle_charto(struct sw_uart_port *sw_uport)
+{
+#if IS_ENABLED(CONFIG_AW_SERIAL_DMA)
+	/* the byte belongs to the rx dma, collect the ring instead */
+	if (sw_uport->dma->use_dma & RX_DMA) {
+		sw_uart_handle_rx(sw_uport, 0);
+		return;
+	}
+#endif
+	serial_in(&sw_uport->port, SUNXI_UART_RBR);
+}
+
 static irqreturn_t sw_uart_irq(int irq, void *dev_id)
 {
 	struct uart_port *port = dev_id;
@@ -799,7 +1040,7 @@ static irqreturn_t sw_uart_irq(int irq, void *dev_id)
 			lsr = sw_uart_handle_rx(sw_uport, lsr);
 		/* has charto irq but no dr lsr? just read and ignore */
 		else if (iir & SUNXI_UART_IIR_IID_CHARTO)
-			serial_in(&sw_uport->port, SUNXI_UART_RBR);
+			sw_uart_handle_charto(sw_uport);
 		sw_uart_modem_status(sw_uport);
 #if IS_ENABLED(CONFIG_SW_UART_PTIME_MODE)
 		if (iir == SUNXI_UART_IIR_IID_THREMP)
@@ -1279,6 +1520,7 @@ static void sw_uart_set_termios(struct uart_port *port, struct ktermios *termios
 	if (sw_uport->dma->use_dma & RX_DMA) {
 		/* disable the receive data interrupt */
 		sw_uport->ier &= ~SUNXI_UART_IER_RDI;
+		sw_uart_dma_rx_set_idle(sw_uport, baud);
 		sw_uart_start_dma_rx(sw_uport);
 	}
 #endif
@@ -1807,12 +2049,84 @@ static ssize_t sunxi_uart_ctrl_info_show(struct device *dev,
 static struct device_attribute sunxi_uart_ctrl_info_attr =
 	__ATTR(ctrl_info, S_IRUGO, sunxi_uart_ctrl_info_show, NULL);
 
+#if IS_ENABLED(CONFIG_AW_SERIAL_DMA)
+static ssize_t sunxi_uart_rx_dma_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct uart_port *port = dev_get_drvdata(dev);
+	struct sw_uart_port *sw_uport = UART_TO_SPORT(port);
+	struct sw_uart_dma *uart_dma = sw_uport->dma;
+
+	if (!(uart_dma->use_dma & RX_DMA))
+		return scnprintf(buf, PAGE_SIZE, "rx dma disabled\n");
+
+	return scnprintf(buf, PAGE_SIZE,
+		" ring size  : %u\n"
+		" idle steps : %u (x 20.48us)\n"
+		" idle source: %s\n"
+		" running    : %d\n"
+		" idle events: %u\n"
+		" period events: %u\n"
+		" irq drains : %u\n"
+		" max chunk  : %u\n"
+		" max latency: %u us\n"
+		" overrun    : %d\n"
+		" buf overrun: %d\n",
+		uart_dma->rb_size, uart_dma->rx_idle_steps,
+		uart_dma->use_timer ? "poll" : "dma timeout",
+		uart_dma->rx_dma_used, uart_dma->rx_idle_events,
+		uart_dma->rx_period_events, uart_dma->rx_irq_drains,
+		uart_dma->rx_max_chunk, uart_dma->rx_lat_max_us,
+		port->icount.overrun, port->icount.buf_overrun);
+}
+
+/* writing "0" clears the statistics, a power of two resizes the rx ring */
+static ssize_t sunxi_uart_rx_dma_store(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	struct uart_port *port = dev_get_drvdata(dev);
+	struct sw_uart_port *sw_uport = UART_TO_SPORT(port);
+	struct sw_uart_dma *uart_dma = sw_uport->dma;
+	unsigned long flags;
+	u32 size;
+	int ret;
+
+	if (!(uart_dma->use_dma & RX_DMA))
+		return -ENODEV;
+
+	ret = kstrtou32(buf, 0, &size);
+	if (ret)
+		return ret;
+
+	if (!size) {
+		spin_lock_irqsave(&port->lock, flags);
+		uart_dma->rx_idle_events = 0;
+		uart_dma->rx_period_events = 0;
+		uart_dma->rx_irq_drains = 0;
+		uart_dma->rx_max_chunk = 0;
+		uart_dma->rx_lat_max_us = 0;
+		spin_unlock_irqrestore(&port->lock, flags);
+		return count;
+	}
+
+	ret = sw_uart_dma_rx_resize(sw_uport, size);
+
+	return ret ? ret : count;
+}
+static struct device_attribute sunxi_uart_rx_dma_attr =
+	__ATTR(rx_dma, S_IRUGO|S_IWUSR, sunxi_uart_rx_dma_show, sunxi_uart_rx_dma_store);
+#endif
+
 static void sunxi_uart_sysfs(struct platform_device *_pdev)
 {
 	device_create_file(&_pdev->dev, &sunxi_uart_dev_info_attr);
 	device_create_file(&_pdev->dev, &sunxi_uart_status_attr);
 	device_create_file(&_pdev->dev, &sunxi_uart_loopback_attr);
 	device_create_file(&_pdev->dev, &sunxi_uart_ctrl_info_attr);
+#if IS_ENABLED(CONFIG_AW_SERIAL_DMA)
+	device_create_file(&_pdev->dev, &sunxi_uart_rx_dma_attr);
+#endif
 }
 
 #if IS_ENABLED(CONFIG_AW_SERIAL_CONSOLE)
@@ -2202,8 +2516,7 @@ static int sw_uart_probe(struct platform_device *pdev)
 	pdev->dev.coherent_dma_mask = DMA_BIT_MASK(32);
 	if (sw_uport->dma->use_dma & RX_DMA) {
 		/* timer */
-		sw_uport->dma->use_timer = UART_USE_TIMER;
-		sw_uport->dma->rx_timeout = 2000000;
+		sw_uport->dma->rx_timeout = DMA_SERIAL_RX_POLL_NS;
 		hrtimer_init(&sw_uport->rx_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 		sw_uport->rx_hrtimer.function = sw_uart_report_dma_rx;
 
@@ -25,6 +25,7 @@
 //include <linux/serial_core.h>
 #include <linux/ktime.h>
 #include <sunxi-gpio.h>
+#include <sunxi-dma.h>
 
 /* SUNXI UART PORT definition */
 #define PORT_MAX_USED	PORT_LINFLEXUART  /* see include/uapi/linux/serial_core.h */
@@ -53,7 +54,6 @@ struct sw_uart_dma {
 	/* regard the rx buffer as a circular buffer */
 	u32 rb_head;
 	u32 rb_tail;
-	u32 rx_size;
 
 	dma_cookie_t rx_cookie;
 
@@ -62,10 +62,25 @@ struct sw_uart_dma {
 	char tx_dma_used;   /* 1:dma tx is working */
 	char rx_dma_used;   /* 1:dma rx is working */
 
-	/* timer to poll activity on rx dma */
+	/*
+	 * rx is drained on the dma channel timeout (line idle) and on every
+	 * half of the ring, see sw_uart_dma_rx_drain()
+	 */
+	struct sunxi_dma_desc sunxi_desc;
+	u32 rx_idle_steps;
+
+	/* timer to poll rx dma, when the dma channel has no timeout */
 	char use_timer;
 	int rx_timeout;
 
+	/* rx statistics */
+	u32 rx_idle_events;
+	u32 rx_period_events;
+	u32 rx_irq_drains;
+	u32 rx_max_chunk;
+	u32 rx_lat_max_us;
+	ktime_t rx_last_drain;
+
 	struct dma_chan *dma_chan_rx, *dma_chan_tx;
 	struct scatterlist rx_sgl, tx_sgl;
 	unsigned int		rx_bytes, tx_bytes;
@@ -93,7 +108,6 @@ struct sw_uart_port {
 #if IS_ENABLED(CONFIG_AW_SERIAL_DMA)
 	struct sw_uart_dma *dma;
 	struct hrtimer rx_hrtimer;
-	u32 rx_last_pos;
 #define SUNXI_UART_DRQ_RX(ch)		(DRQSRC_UART0_RX + ch)
 #define SUNXI_UART_DRQ_TX(ch)		(DRQDST_UART0_TX + ch)
 #endif
@@ -10,6 +10,7 @@
 #include <linux/fs.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/string.h>
@@ -38,6 +39,12 @@ module_param(bulk_streaming_ep, bool, 0644);
 MODULE_PARM_DESC(bulk_streaming_ep, "0 (Use ISOC video streaming ep) / "
 					"1 (Use BULK video streaming ep)");
 
+static bool sg_payloads = true;
+module_param(sg_payloads, bool, 0644);
+MODULE_PARM_DESC(sg_payloads, "0 (Copy video data to the USB requests) / "
+				"1 (Point the USB requests into the video buffers, "
+				"if the UDC supports scatter-gather)");
+
 /* --------------------------------------------------------------------------
  * Function descriptors
  */
@@ -584,6 +591,58 @@ static ssize_t function_name_show(struct device *dev,
 
 static DEVICE_ATTR_RO(function_name);
 
+/*
+ * Streaming statistics since the last stream on or write: frame rate and
+ * the share of one CPU spent filling and queueing video requests.
+ */
+static ssize_t stats_show(struct device *dev,
+			  struct device_attribute *attr, char *buf)
+{
+	struct uvc_device *uvc = dev_get_drvdata(dev);
+	struct uvc_video *video = &uvc->video;
+	u64 frames, bytes, busy, elapsed, fps, cpu;
+	unsigned long flags;
+
+	spin_lock_irqsave(&video->queue.irqlock, flags);
+	frames = video->stats_frames;
+	bytes = video->stats_bytes;
+	busy = video->stats_busy_ns;
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), video->stats_start));
+	spin_unlock_irqrestore(&video->queue.irqlock, flags);
+
+	elapsed = max_t(u64, elapsed, 1);
+	fps = div64_u64(frames * 100 * NSEC_PER_SEC, elapsed);
+	cpu = div64_u64(busy * 10000, elapsed);
+
+	return sprintf(buf, "mode: %s\nframes: %llu\nbytes: %llu\n"
+		       "fps: %llu.%02llu\nthroughput: %llu KiB/s\n"
+		       "cpu: %llu.%02llu%%\n",
+		       video->use_sg ? "sg" : "copy", frames, bytes,
+		       fps / 100, fps % 100,
+		       div64_u64(bytes * NSEC_PER_SEC, elapsed) >> 10,
+		       cpu / 100, cpu % 100);
+}
+
+static ssize_t stats_store(struct device *dev,
+			   struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	struct uvc_device *uvc = dev_get_drvdata(dev);
+	struct uvc_video *video = &uvc->video;
+	unsigned long flags;
+
+	spin_lock_irqsave(&video->queue.irqlock, flags);
+	video->stats_start = ktime_get();
+	video->stats_frames = 0;
+	video->stats_bytes = 0;
+	video->stats_busy_ns = 0;
+	spin_unlock_irqrestore(&video->queue.irqlock, flags);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(stats);
+
 static int
 uvc_register_video(struct uvc_device *uvc)
 {
@@ -612,6 +671,13 @@ uvc_register_video(struct uvc_device *uvc)
 		return ret;
 	}
 
+	ret = device_create_file(&uvc->vdev.dev, &dev_attr_stats);
+	if (ret < 0) {
+		device_remove_file(&uvc->vdev.dev, &dev_attr_function_name);
+		video_unregister_device(&uvc->vdev);
+		return ret;
+	}
+
 	return 0;
 }
 
@@ -797,6 +863,9 @@ uvc_function_bind(struct usb_configuration *c, struct usb_function *f)
 	if (bulk_streaming_ep)
 		uvc->video.bulk_streaming_ep = bulk_streaming_ep;
 
+	/* Zero-copy payloads need a UDC that takes scatter-gather requests. */
+	uvc->video.use_sg = sg_payloads && cdev->gadget->sg_supported;
+
 	opts = fi_to_f_uvc_opts(f->fi);
 	/* Sanity check the streaming endpoint module parameters.
 	 */
@@ -1167,6 +1236,7 @@ static void uvc_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	uvcg_info(f, "%s\n", __func__);
 
+	device_remove_file(&uvc->vdev.dev, &dev_attr_stats);
 	device_remove_file(&uvc->vdev.dev, &dev_attr_function_name);
 	video_unregister_device(&uvc->vdev);
 	v4l2_device_unregister(&uvc->v4l2_dev);
@@ -9,10 +9,13 @@
 #ifndef _UVC_GADGET_H_
 #define _UVC_GADGET_H_
 
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/mutex.h>
+#include <linux/scatterlist.h>
 #include <linux/spinlock.h>
 #include <linux/usb/composite.h>
+#include <linux/version.h>
 #include <linux/videodev2.h>
 
 #include <media/v4l2-device.h>
@@ -69,10 +72,35 @@ extern unsigned int uvc_gadget_trace_param;
 #define UVC_MAX_REQUEST_SIZE			64
 #define UVC_MAX_EVENTS				4
 
+#define UVCG_REQUEST_HEADER_LEN			2
+
 /* ------------------------------------------------------------------------
  * Structures
  */
 
+/*
+ * The UDC core takes scatterlists that are already DMA mapped: requests
+ * then carry the addresses of the UDC's own mapping of the video buffer
+ * instead of its pages.
+ */
+#define UVCG_SG_PREMAPPED	(LINUX_VERSION_CODE >= KERNEL_VERSION(6, 9, 0))
+
+/*
+ * A video streaming USB request. In copy mode the payload is copied to
+ * req_buffer, in scatter-gather mode sgt holds the header and entries
+ * pointing into the video buffer. last_buf is the video buffer whose last
+ * bytes the request carries, returned to userspace when it completes.
+ */
+struct uvc_request {
+	struct usb_request *req;
+	u8 *req_buffer;
+	struct uvc_video *video;
+	struct sg_table sgt;
+	struct uvc_buffer *last_buf;
+	u8 header[UVCG_REQUEST_HEADER_LEN];
+	dma_addr_t header_dma;
+};
+
 struct uvc_video {
 	struct uvc_device *uvc;
 	struct usb_ep *ep;
@@ -87,8 +115,7 @@ struct uvc_video {
 
 	/* Requests */
 	unsigned int req_size;
-	struct usb_request *req[UVC_NUM_REQUESTS];
-	__u8 *req_buffer[UVC_NUM_REQUESTS];
+	struct uvc_request *ureq;
 	struct list_head req_free;
 	spinlock_t req_lock;
 
@@ -102,6 +129,13 @@ struct uvc_video {
 	struct uvc_video_queue queue;
 	unsigned int fid;
 	bool bulk_streaming_ep;
+	bool use_sg;
+
+	/* Streaming statistics, protected by queue.irqlock */
+	ktime_t stats_start;
+	u64 stats_frames;
+	u64 stats_bytes;
+	u64 stats_busy_ns;
 };
 
 enum uvc_state {
@@ -8,8 +8,11 @@
 
 #include <media/videobuf2-v4l2.h>
 
+struct device;
 struct file;
 struct mutex;
+struct scatterlist;
+struct sg_table;
 
 /* Maximum frame size in bytes, for sanity checking. */
 #define UVC_MAX_FRAME_SIZE	(16*1024*1024)
@@ -36,6 +39,11 @@ struct uvc_buffer {
 	void *mem;
 	unsigned int length;
 	unsigned int bytesused;
+
+	/* Scatter-gather mode: plane table and position of the next payload */
+	struct sg_table *sgt;
+	struct scatterlist *sg;
+	unsigned int offset;
 };
 
 #define UVC_QUEUE_DISCONNECTED		(1 << 0)
@@ -59,8 +67,8 @@ static inline int uvc_queue_streaming(struct uvc_video_queue *queue)
 	return vb2_is_streaming(&queue->queue);
 }
 
-int uvcg_queue_init(struct uvc_video_queue *queue, enum v4l2_buf_type type,
-		    struct mutex *lock);
+int uvcg_queue_init(struct uvc_video_queue *queue, struct device *dev,
+		    enum v4l2_buf_type type, struct mutex *lock);
 
 void uvcg_free_buffers(struct uvc_video_queue *queue);
 
@@ -91,6 +99,9 @@ int uvcg_queue_enable(struct uvc_video_queue *queue, int enable);
 struct uvc_buffer *uvcg_queue_next_buffer(struct uvc_video_queue *queue,
 					  struct uvc_buffer *buf);
 
+void uvcg_queue_complete_buffer(struct uvc_video_queue *queue,
+				struct uvc_buffer *buf, int status);
+
 struct uvc_buffer *uvcg_queue_head(struct uvc_video_queue *queue);
 
 #endif /* _UVC_QUEUE_H_ */
@@ -8,7 +8,11 @@
 
 #include <linux/kernel.h>
 #include <linux/device.h>
+#include <linux/dma-mapping.h>
 #include <linux/errno.h>
+#include <linux/ktime.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
 #include <linux/usb/ch9.h>
 #include <linux/usb/gadget.h>
 #include <linux/usb/video.h>
@@ -54,6 +58,183 @@ uvc_video_encode_data(struct uvc_video *video, struct uvc_buffer *buf,
 	return nbytes;
 }
 
+/*
+ * Point the request's scatterlist at the next @len bytes of the video buffer
+ * instead of copying them. Entries are appended after the @nents ones already
+ * in use. The position in the buffer advances, queue->buf_used does not.
+ *
+ * The plane table is mapped for the UDC by videobuf2. With UVCG_SG_PREMAPPED
+ * the entries take the DMA addresses of that mapping, they are valid for
+ * imported dma-bufs too, whose table only describes the exporter's mapping.
+ * Otherwise they take the pages, which the UDC core maps once more.
+ */
+static int
+uvc_video_encode_data_sg(struct uvc_video *video, struct uvc_buffer *buf,
+		struct uvc_request *ureq, unsigned int *nents, int len)
+{
+	struct uvc_video_queue *queue = &video->queue;
+	struct scatterlist *sg;
+	unsigned int size, nbytes = 0;
+	unsigned int left, part;
+
+	size = min((unsigned int)len, buf->bytesused - queue->buf_used);
+
+	while (nbytes < size && buf->sg && *nents < ureq->sgt.orig_nents) {
+		sg = &ureq->sgt.sgl[(*nents)++];
+#if UVCG_SG_PREMAPPED
+		left = sg_dma_len(buf->sg) - buf->offset;
+		part = min(size - nbytes, left);
+
+		sg->length = part;
+		sg_dma_address(sg) = sg_dma_address(buf->sg) + buf->offset;
+		sg_dma_len(sg) = part;
+#else
+		left = buf->sg->length - buf->offset;
+		part = min(size - nbytes, left);
+
+		sg_set_page(sg, sg_page(buf->sg), part,
+			    buf->sg->offset + buf->offset);
+#endif
+
+		if (part == left) {
+			buf->sg = sg_next(buf->sg);
+			buf->offset = 0;
+		} else {
+			buf->offset += part;
+		}
+		nbytes += part;
+	}
+
+	return nbytes;
+}
+
+static void
+uvc_video_complete_buffer(struct uvc_video *video, struct uvc_buffer *buf)
+{
+	video->queue.buf_used = 0;
+	buf->state = UVC_BUF_STATE_DONE;
+	video->stats_frames++;
+	uvcg_queue_next_buffer(&video->queue, buf);
+	video->fid ^= UVC_STREAM_FID;
+}
+
+/*
+ * All of @buf is in requests, but the UDC has yet to read it: take it off the
+ * irq queue so the next request starts the next buffer, and leave it to the
+ * completion of @ureq, which carries its last bytes.
+ */
+static void
+uvc_video_release_buffer(struct uvc_video *video, struct uvc_buffer *buf,
+		struct uvc_request *ureq)
+{
+	video->queue.buf_used = 0;
+	buf->state = UVC_BUF_STATE_DONE;
+	buf->sg = buf->sgt->sgl;
+	buf->offset = 0;
+	list_del(&buf->queue);
+	ureq->last_buf = buf;
+	video->stats_frames++;
+	video->fid ^= UVC_STREAM_FID;
+}
+
+/* Entry 0 of the request's table: the payload header */
+static void
+uvc_video_sg_set_header(struct uvc_video *video, struct uvc_request *ureq,
+		unsigned int len)
+{
+	struct scatterlist *sg = ureq->sgt.sgl;
+
+#if UVCG_SG_PREMAPPED
+	dma_sync_single_for_device(video->queue.queue.dev, ureq->header_dma,
+				   len, DMA_TO_DEVICE);
+	sg->length = len;
+	sg_dma_address(sg) = ureq->header_dma;
+	sg_dma_len(sg) = len;
+#else
+	sg_set_buf(sg, ureq->header, len);
+#endif
+}
+
+/*
+ * Entry 0 of the table is the payload header, the data entries follow. The
+ * header is written once the data is mapped, so the EOF flag matches what
+ * the request actually carries.
+ */
+static void
+uvc_video_encode_bulk_sg(struct usb_request *req, struct uvc_video *video,
+		struct uvc_buffer *buf)
+{
+	struct uvc_request *ureq = req->context;
+	struct scatterlist *sgl = ureq->sgt.sgl;
+	unsigned int nents = 1;
+	int len = video->req_size;
+	int header_len = 0;
+	int ret;
+
+	sg_init_table(sgl, ureq->sgt.orig_nents);
+
+	if (video->payload_size == 0) {
+		header_len = UVCG_REQUEST_HEADER_LEN;
+		video->payload_size += header_len;
+		len -= header_len;
+	}
+
+	len = min((int)(video->max_payload_size - video->payload_size), len);
+	ret = uvc_video_encode_data_sg(video, buf, ureq, &nents, len);
+
+	if (header_len) {
+		uvc_video_encode_header(video, buf, ureq->header, ret + header_len);
+		uvc_video_sg_set_header(video, ureq, header_len);
+	}
+	sg_mark_end(&sgl[nents - 1]);
+
+	video->queue.buf_used += ret;
+	video->payload_size += ret;
+
+	req->buf = NULL;
+	req->sg = header_len ? sgl : sg_next(sgl);
+	req->num_sgs = header_len ? nents : nents - 1;
+	req->length = header_len + ret;
+	req->zero = video->payload_size == video->max_payload_size;
+
+	if (buf->bytesused == video->queue.buf_used) {
+		uvc_video_release_buffer(video, buf, ureq);
+		video->payload_size = 0;
+	}
+
+	if (video->payload_size == video->max_payload_size)
+		video->payload_size = 0;
+}
+
+static void
+uvc_video_encode_isoc_sg(struct usb_request *req, struct uvc_video *video,
+		struct uvc_buffer *buf)
+{
+	struct uvc_request *ureq = req->context;
+	struct scatterlist *sgl = ureq->sgt.sgl;
+	unsigned int nents = 1;
+	int ret;
+
+	sg_init_table(sgl, ureq->sgt.orig_nents);
+
+	ret = uvc_video_encode_data_sg(video, buf, ureq, &nents,
+				       video->req_size - UVCG_REQUEST_HEADER_LEN);
+	uvc_video_encode_header(video, buf, ureq->header,
+				ret + UVCG_REQUEST_HEADER_LEN);
+	uvc_video_sg_set_header(video, ureq, UVCG_REQUEST_HEADER_LEN);
+	sg_mark_end(&sgl[nents - 1]);
+
+	video->queue.buf_used += ret;
+
+	req->buf = NULL;
+	req->sg = sgl;
+	req->num_sgs = nents;
+	req->length = UVCG_REQUEST_HEADER_LEN + ret;
+
+	if (buf->bytesused == video->queue.buf_used)
+		uvc_video_release_buffer(video, buf, ureq);
+}
+
 static void
 uvc_video_encode_bulk(struct usb_request *req, struct uvc_video *video,
 		struct uvc_buffer *buf)
@@ -81,11 +262,7 @@ uvc_video_encode_bulk(struct usb_request *req, struct uvc_video *video,
 	req->zero = video->payload_size == video->max_payload_size;
 
 	if (buf->bytesused == video->queue.buf_used) {
-		video->queue.buf_used = 0;
-		buf->state = UVC_BUF_STATE_DONE;
-		uvcg_queue_next_buffer(&video->queue, buf);
-		video->fid ^= UVC_STREAM_FID;
-
+		uvc_video_complete_buffer(video, buf);
 		video->payload_size = 0;
 	}
 
@@ -113,12 +290,8 @@ uvc_video_encode_isoc(struct usb_request *req, struct uvc_video *video,
 
 	req->length = video->req_size - len;
 
-	if (buf->bytesused == video->queue.buf_used) {
-		video->queue.buf_used = 0;
-		buf->state = UVC_BUF_STATE_DONE;
-		uvcg_queue_next_buffer(&video->queue, buf);
-		video->fid ^= UVC_STREAM_FID;
-	}
+	if (buf->bytesused == video->queue.buf_used)
+		uvc_video_complete_buffer(video, buf);
 }
 
 /* --------------------------------------------------------------------------
@@ -142,6 +315,33 @@ static int uvcg_video_ep_queue(struct uvc_video *video, struct usb_request *req)
 	return ret;
 }
 
+/*
+ * Fill and queue one request, called with the queue irqlock held. The time
+ * spent here is what streaming costs the CPU: the payload copy in copy mode,
+ * the scatterlist setup and its DMA mapping by the UDC in scatter-gather mode.
+ */
+static int uvcg_video_encode_queue(struct uvc_video *video,
+				   struct usb_request *req,
+				   struct uvc_buffer *buf)
+{
+	struct uvc_request *ureq = req->context;
+	u64 start = ktime_get_ns();
+	int ret;
+
+	video->encode(req, video, buf);
+	ret = uvcg_video_ep_queue(video, req);
+	if (ret < 0 && ureq->last_buf) {
+		uvcg_queue_complete_buffer(&video->queue, ureq->last_buf, ret);
+		ureq->last_buf = NULL;
+	}
+
+	video->stats_busy_ns += ktime_get_ns() - start;
+	if (ret >= 0)
+		video->stats_bytes += req->length;
+
+	return ret;
+}
+
 /*
  * I somehow feel that synchronisation won't be easy to achieve here. We have
  * three events that control USB requests submission:
@@ -175,12 +375,21 @@ static int uvcg_video_ep_queue(struct uvc_video *video, struct usb_request *req)
 static void
 uvc_video_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct uvc_video *video = req->context;
+	struct uvc_request *ureq = req->context;
+	struct uvc_video *video = ureq->video;
 	struct uvc_video_queue *queue = &video->queue;
 	struct uvc_buffer *buf;
 	unsigned long flags;
 	int ret;
 
+	/* the UDC is done with the buffer, whatever the status */
+	if (ureq->last_buf) {
+		spin_lock_irqsave(&queue->irqlock, flags);
+		uvcg_queue_complete_buffer(queue, ureq->last_buf, req->status);
+		spin_unlock_irqrestore(&queue->irqlock, flags);
+		ureq->last_buf = NULL;
+	}
+
 	switch (req->status) {
 	case 0:
 		break;
@@ -205,9 +414,7 @@ uvc_video_complete(struct usb_ep *ep, struct usb_request *req)
 		goto requeue;
 	}
 
-	video->encode(req, video, buf);
-
-	ret = uvcg_video_ep_queue(video, req);
+	ret = uvcg_video_encode_queue(video, req, buf);
 	spin_unlock_irqrestore(&video->queue.irqlock, flags);
 
 	if (ret < 0) {
@@ -226,18 +433,28 @@ requeue:
 static int
 uvc_video_free_requests(struct uvc_video *video)
 {
+	struct uvc_request *ureq;
 	unsigned int i;
 
-	for (i = 0; i < UVC_NUM_REQUESTS; ++i) {
-		if (video->req[i]) {
-			usb_ep_free_request(video->ep, video->req[i]);
-			video->req[i] = NULL;
+	if (video->ureq) {
+		for (i = 0; i < UVC_NUM_REQUESTS; ++i) {
+			ureq = &video->ureq[i];
+
+			if (ureq->req)
+				usb_ep_free_request(video->ep, ureq->req);
+			kfree(ureq->req_buffer);
+			sg_free_table(&ureq->sgt);
+#if UVCG_SG_PREMAPPED
+			if (ureq->header_dma)
+				dma_unmap_single(video->queue.queue.dev,
+						 ureq->header_dma,
+						 UVCG_REQUEST_HEADER_LEN,
+						 DMA_TO_DEVICE);
+#endif
 		}
 
-		if (video->req_buffer[i]) {
-			kfree(video->req_buffer[i]);
-			video->req_buffer[i] = NULL;
-		}
+		kfree(video->ureq);
+		video->ureq = NULL;
 	}
 
 	INIT_LIST_HEAD(&video->req_free);
@@ -248,6 +465,7 @@ uvc_video_free_requests(struct uvc_video *video)
 static int
 uvc_video_alloc_requests(struct uvc_video *video)
 {
+	struct uvc_request *ureq;
 	unsigned int req_size;
 	unsigned int i;
 	int ret = -ENOMEM;
@@ -262,21 +480,54 @@ uvc_video_alloc_requests(struct uvc_video *video)
 		req_size = video->ep->maxpacket
 			* max_t(unsigned int, video->ep->maxburst, 1);
 
+	video->ureq = kcalloc(UVC_NUM_REQUESTS, sizeof(*video->ureq), GFP_KERNEL);
+	if (video->ureq == NULL)
+		return -ENOMEM;
+
 	for (i = 0; i < UVC_NUM_REQUESTS; ++i) {
-		video->req_buffer[i] = kmalloc(req_size, GFP_KERNEL);
-		if (video->req_buffer[i] == NULL)
-			goto error;
+		ureq = &video->ureq[i];
+
+		/*
+		 * A scatter-gather request needs the header entry plus one
+		 * entry per page the payload can touch.
+		 */
+		if (video->use_sg) {
+			if (sg_alloc_table(&ureq->sgt,
+					   DIV_ROUND_UP(req_size, PAGE_SIZE) + 2,
+					   GFP_KERNEL))
+				goto error;
+#if UVCG_SG_PREMAPPED
+			/* the whole table goes to the UDC already mapped */
+			ureq->header_dma = dma_map_single(video->queue.queue.dev,
+							  ureq->header,
+							  UVCG_REQUEST_HEADER_LEN,
+							  DMA_TO_DEVICE);
+			if (dma_mapping_error(video->queue.queue.dev,
+					      ureq->header_dma)) {
+				ureq->header_dma = 0;
+				goto error;
+			}
+#endif
+		} else {
+			ureq->req_buffer = kmalloc(req_size, GFP_KERNEL);
+			if (ureq->req_buffer == NULL)
+				goto error;
+		}
 
-		video->req[i] = usb_ep_alloc_request(video->ep, GFP_KERNEL);
-		if (video->req[i] == NULL)
+		ureq->req = usb_ep_alloc_request(video->ep, GFP_KERNEL);
+		if (ureq->req == NULL)
 			goto error;
 
-		video->req[i]->buf = video->req_buffer[i];
-		video->req[i]->length = 0;
-		video->req[i]->complete = uvc_video_complete;
-		video->req[i]->context = video;
+		ureq->video = video;
+#if UVCG_SG_PREMAPPED
+		ureq->req->sg_was_mapped = video->use_sg;
+#endif
+		ureq->req->buf = ureq->req_buffer;
+		ureq->req->length = 0;
+		ureq->req->complete = uvc_video_complete;
+		ureq->req->context = ureq;
 
-		list_add_tail(&video->req[i]->list, &video->req_free);
+		list_add_tail(&ureq->req->list, &video->req_free);
 	}
 
 	video->req_size = req_size;
@@ -334,10 +585,8 @@ int uvcg_video_pump(struct uvc_video *video)
 			break;
 		}
 
-		video->encode(req, video, buf);
-
-		/* Queue the USB request */
-		ret = uvcg_video_ep_queue(video, req);
+		/* Fill and queue the USB request */
+		ret = uvcg_video_encode_queue(video, req, buf);
 		spin_unlock_irqrestore(&queue->irqlock, flags);
 
 		if (ret < 0) {
@@ -369,9 +618,9 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 	}
 
 	if (!enable) {
-		for (i = 0; i < UVC_NUM_REQUESTS; ++i)
-			if (video->req[i])
-				usb_ep_dequeue(video->ep, video->req[i]);
+		for (i = 0; video->ureq && i < UVC_NUM_REQUESTS; ++i)
+			if (video->ureq[i].req)
+				usb_ep_dequeue(video->ep, video->ureq[i].req);
 
 		uvc_video_free_requests(video);
 		uvcg_queue_enable(&video->queue, 0);
@@ -386,10 +635,12 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 		return ret;
 
 	if (video->max_payload_size) {
-		video->encode = uvc_video_encode_bulk;
+		video->encode = video->use_sg ? uvc_video_encode_bulk_sg :
+						uvc_video_encode_bulk;
 		video->payload_size = 0;
 	} else
-		video->encode = uvc_video_encode_isoc;
+		video->encode = video->use_sg ? uvc_video_encode_isoc_sg :
+						uvc_video_encode_isoc;
 
 	spin_lock_irqsave(&video->queue.irqlock, flags);
 	while (1) {
@@ -401,6 +652,11 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 		uvcg_queue_next_buffer(&video->queue, buf);
 		video->fid ^= UVC_STREAM_FID;
 	}
+
+	video->stats_start = ktime_get();
+	video->stats_frames = 0;
+	video->stats_bytes = 0;
+	video->stats_busy_ns = 0;
 	spin_unlock_irqrestore(&video->queue.irqlock, flags);
 
 	return 0;
@@ -425,8 +681,8 @@ int uvcg_video_init(struct uvc_video *video, struct uvc_device *uvc)
 		video->max_payload_size = video->imagesize;
 
 	/* Initialize the video buffers queue. */
-	uvcg_queue_init(&video->queue, V4L2_BUF_TYPE_VIDEO_OUTPUT,
-			&video->mutex);
+	uvcg_queue_init(&video->queue, uvc->v4l2_dev.dev->parent,
+			V4L2_BUF_TYPE_VIDEO_OUTPUT, &video->mutex);
 	return 0;
 }
 
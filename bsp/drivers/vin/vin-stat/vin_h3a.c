@@ -17,6 +17,8 @@
 #include "../utility/vin_log.h"
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <media/v4l2-ioctl.h>
+#include <media/videobuf2-dma-contig.h>
 
 #include "vin_h3a.h"
 
@@ -38,6 +40,12 @@ static struct ispstat_buffer *__isp_stat_buf_find(struct isp_stat *stat, int loo
 		if (curr == stat->locked_buf || curr == stat->active_buf)
 			continue;
 
+#if !defined CONFIG_ISP_SERVER_MELIS
+		/* Lent to the meta capture node, owned by the hardware. */
+		if (curr->meta)
+			continue;
+#endif
+
 		/* Don't select uninitialised buffers if it's not required */
 		if (!look_empty && curr->empty)
 			continue;
@@ -76,6 +84,126 @@ static inline struct ispstat_buffer *isp_stat_buf_find_oldest_or_empty(struct is
 	return __isp_stat_buf_find(stat, 1);
 }
 
+#if !defined CONFIG_ISP_SERVER_MELIS
+static inline u32 isp_stat_meta_size(struct isp_stat *stat)
+{
+#if defined ISP_600
+	return ISP_STAT_TOTAL_SIZE + ISP_SAVE_LOAD_STATISTIC_SIZE;
+#else
+	return ISP_STAT_TOTAL_SIZE;
+#endif
+}
+
+/* Lend the oldest queued meta buffer to an idle slot, called with isp->slock held. */
+static struct ispstat_buffer *isp_stat_meta_buf_bind(struct isp_stat *stat)
+{
+	struct isp_stat_meta *meta = &stat->meta;
+	struct isp_stat_meta_buffer *mbuf;
+	struct ispstat_buffer *buf;
+	int i;
+
+	if (list_empty(&meta->queued))
+		return NULL;
+
+	/* slot 0 is the isp's own statistics buffer, never lend it out */
+	for (i = 1; i < stat->buf_cnt; i++) {
+		buf = &stat->buf[i];
+
+		if (buf->meta || buf == stat->locked_buf || buf == stat->active_buf)
+			continue;
+		if (buf->state != ISPSTAT_IDLE)
+			continue;
+
+		mbuf = list_first_entry(&meta->queued, struct isp_stat_meta_buffer, list);
+		list_del(&mbuf->list);
+
+		buf->own_virt_addr = buf->virt_addr;
+		buf->own_dma_addr = buf->dma_addr;
+		buf->virt_addr = mbuf->vaddr;
+		buf->dma_addr = (void *)(unsigned long)mbuf->dma_addr;
+		buf->meta = mbuf;
+		buf->empty = 1;
+		meta->inflight++;
+
+		return buf;
+	}
+
+	return NULL;
+}
+
+static struct isp_stat_meta_buffer *isp_stat_meta_buf_unbind(struct isp_stat *stat,
+							     struct ispstat_buffer *buf)
+{
+	struct isp_stat_meta_buffer *mbuf = buf->meta;
+
+	buf->virt_addr = buf->own_virt_addr;
+	buf->dma_addr = buf->own_dma_addr;
+	buf->meta = NULL;
+	buf->empty = 1;
+	buf->state = ISPSTAT_IDLE;
+
+	if (--stat->meta.inflight == 0)
+		wake_up(&stat->meta.drain_wait);
+
+	return mbuf;
+}
+
+/*
+ * Statistics of @buf are complete: give the lent buffer back to the meta
+ * node, or recycle the slot at once if the node is streaming but had no
+ * buffer queued in time. Called with isp->slock held.
+ */
+static void isp_stat_meta_buf_done(struct isp_stat *stat, struct ispstat_buffer *buf)
+{
+	struct isp_stat_meta_buffer *mbuf;
+	struct vb2_buffer *vb;
+	u32 size = stat->buf_size;
+
+	if (!buf->meta) {
+		if (stat->meta.streaming) {
+			stat->meta.dropped++;
+			buf->empty = 1;
+			buf->state = ISPSTAT_IDLE;
+		}
+		return;
+	}
+
+#if defined ISP_600
+	if (buf->virt_addr) {
+		memcpy(buf->virt_addr + stat->buf_size,
+		       stat->isp->isp_save_load.vir_addr + ISP_SAVE_LOAD_REG_SIZE,
+		       ISP_SAVE_LOAD_STATISTIC_SIZE);
+		size += ISP_SAVE_LOAD_STATISTIC_SIZE;
+	}
+#endif
+	mbuf = isp_stat_meta_buf_unbind(stat, buf);
+	vb = &mbuf->vb.vb2_buf;
+	mbuf->vb.sequence = buf->frame_number;
+	vb->timestamp = ktime_get_ns();
+	vb2_set_plane_payload(vb, 0, size);
+	vb2_buffer_done(vb, VB2_BUF_STATE_DONE);
+}
+#endif
+
+/*
+ * The hardware did not take the active buffer: if a meta buffer was lent
+ * to it, put it back at the head of the meta queue before dropping the
+ * slot, so it is neither leaked nor counted as inflight.
+ */
+static void isp_stat_active_buf_drop(struct isp_stat *stat)
+{
+#if !defined CONFIG_ISP_SERVER_MELIS
+	struct ispstat_buffer *buf = stat->active_buf;
+	struct isp_stat_meta_buffer *mbuf;
+
+	if (buf && buf->meta) {
+		mbuf = isp_stat_meta_buf_unbind(stat, buf);
+		list_add(&mbuf->list, &stat->meta.queued);
+	}
+#endif
+	stat->active_buf = NULL;
+}
+
 /* Get next free buffer to write the statistics to and mark it active. */
 static void isp_stat_buf_next(struct isp_stat *stat)
 {
@@ -87,6 +215,13 @@ static void isp_stat_buf_next(struct isp_stat *stat)
 		vin_log(VIN_LOG_STAT, "new buffer requested without queuing active one.\n");
 #endif
 	} else {
+#if !defined CONFIG_ISP_SERVER_MELIS
+		if (stat->meta.streaming) {
+			stat->active_buf = isp_stat_meta_buf_bind(stat);
+			if (stat->active_buf)
+				return;
+		}
+#endif
 		stat->active_buf = isp_stat_buf_find_oldest_or_empty(stat);
 	}
 }
@@ -271,6 +406,12 @@ int isp_stat_request_statistics(struct isp_stat *stat,
 	}
 	vin_log(VIN_LOG_STAT, "user wants to request statistics.\n");
 
+	if (stat->meta.streaming) {
+		vin_log(VIN_LOG_STAT, "%s: statistics are delivered by %s.\n",
+			stat->sd.name, video_device_node_name(&stat->meta.vdev));
+		return -EBUSY;
+	}
+
 	mutex_lock(&stat->ioctl_lock);
 	buf = isp_stat_buf_get(stat, data);
 	if (IS_ERR(buf)) {
@@ -301,6 +442,12 @@ int isp_stat_config(struct isp_stat *stat, void *new_conf)
 
 	mutex_lock(&stat->ioctl_lock);
 
+	/* slots may hold buffers lent by the meta node */
+	if (stat->meta.streaming) {
+		mutex_unlock(&stat->ioctl_lock);
+		return -EBUSY;
+	}
+
 	user_cfg->buf_size = ISP_STAT_TOTAL_SIZE;
 
 #if defined ISP_600
@@ -397,7 +544,7 @@ static int isp_stat_buf_process(struct isp_stat *stat, int buf_state)
 		dma_addr = (dma_addr_t)(stat->active_buf->dma_addr);
 		bsp_isp_set_statistics_addr(stat->isp->id, dma_addr);
 		if (bsp_isp_get_irq_status(stat->isp->id, PARA_LOAD_PD)) {
-			stat->active_buf = NULL;
+			isp_stat_active_buf_drop(stat);
 			vin_warn("para_load_pd, set active bufffer failed!\n");
 		} else
 			stat->active_buf->state = ISPSTAT_LOAD_SET;
@@ -463,6 +610,7 @@ next:
 			stat->buf[i].state = ISPSTAT_READY;
 			stat->buf[i].empty = 0;
 			ret = STAT_BUF_DONE;
+			isp_stat_meta_buf_done(stat, &stat->buf[i]);
 		}
 		vin_log(VIN_LOG_STAT, "save buffer%d stat is %d\n", i, stat->buf[i].state);
 	}
@@ -486,6 +634,7 @@ static int isp_stat_buf_queue(struct isp_stat *stat)
 
 	stat->active_buf->frame_number = stat->frame_number;
 	stat->active_buf->empty = 0;
+	isp_stat_meta_buf_done(stat, stat->active_buf);
 	stat->active_buf = NULL;
 
 	return STAT_BUF_DONE;
@@ -718,6 +867,271 @@ int isp_stat_subscribe_event(struct v4l2_subdev *subdev,
 	return v4l2_event_subscribe(fh, sub, STAT_NEVENTS, NULL);
 }
 
+/*
+ * Statistics meta capture node
+ */
+static int isp_stat_meta_queue_setup(struct vb2_queue *vq,
+				     unsigned int *nbuffers, unsigned int *nplanes,
+				     unsigned int sizes[], struct device *alloc_devs[])
+{
+	struct isp_stat *stat = vb2_get_drv_priv(vq);
+	u32 size = isp_stat_meta_size(stat);
+
+	if (*nplanes)
+		return sizes[0] < size ? -EINVAL : 0;
+
+	*nplanes = 1;
+	sizes[0] = size;
+	if (*nbuffers < 2)
+		*nbuffers = 2;
+
+	return 0;
+}
+
+static int isp_stat_meta_buf_prepare(struct vb2_buffer *vb)
+{
+	struct isp_stat *stat = vb2_get_drv_priv(vb->vb2_queue);
+	struct vb2_v4l2_buffer *vvb = to_vb2_v4l2_buffer(vb);
+	struct isp_stat_meta_buffer *mbuf = container_of(vvb, struct isp_stat_meta_buffer, vb);
+
+	if (vb2_plane_size(vb, 0) < isp_stat_meta_size(stat)) {
+		vin_err("%s: meta buffer too small (%lu < %u)\n", stat->sd.name,
+			vb2_plane_size(vb, 0), isp_stat_meta_size(stat));
+		return -EINVAL;
+	}
+
+	/* resolved here, the slot is bound in interrupt context */
+	mbuf->vaddr = vb2_plane_vaddr(vb, 0);
+	mbuf->dma_addr = vb2_dma_contig_plane_dma_addr(vb, 0);
+
+	return 0;
+}
+
+static void isp_stat_meta_buf_queue(struct vb2_buffer *vb)
+{
+	struct isp_stat *stat = vb2_get_drv_priv(vb->vb2_queue);
+	struct vb2_v4l2_buffer *vvb = to_vb2_v4l2_buffer(vb);
+	struct isp_stat_meta_buffer *mbuf = container_of(vvb, struct isp_stat_meta_buffer, vb);
+	unsigned long flags;
+
+	spin_lock_irqsave(&stat->isp->slock, flags);
+	list_add_tail(&mbuf->list, &stat->meta.queued);
+	spin_unlock_irqrestore(&stat->isp->slock, flags);
+}
+
+static void isp_stat_meta_return_queued(struct isp_stat *stat, enum vb2_buffer_state state)
+{
+	struct isp_stat_meta_buffer *mbuf, *tmp;
+
+	list_for_each_entry_safe(mbuf, tmp, &stat->meta.queued, list) {
+		list_del(&mbuf->list);
+		vb2_buffer_done(&mbuf->vb.vb2_buf, state);
+	}
+}
+
+static int isp_stat_meta_start_streaming(struct vb2_queue *vq, unsigned int count)
+{
+	struct isp_stat *stat = vb2_get_drv_priv(vq);
+	unsigned long flags;
+
+	mutex_lock(&stat->ioctl_lock);
+	spin_lock_irqsave(&stat->isp->slock, flags);
+
+	if (!stat->configured || stat->locked_buf) {
+		isp_stat_meta_return_queued(stat, VB2_BUF_STATE_QUEUED);
+		spin_unlock_irqrestore(&stat->isp->slock, flags);
+		mutex_unlock(&stat->ioctl_lock);
+		vin_err("%s: configure statistics before streaming meta buffers\n", stat->sd.name);
+		return -EINVAL;
+	}
+	stat->meta.dropped = 0;
+	stat->meta.streaming = true;
+
+	spin_unlock_irqrestore(&stat->isp->slock, flags);
+	mutex_unlock(&stat->ioctl_lock);
+
+	return 0;
+}
+
+static void isp_stat_meta_stop_streaming(struct vb2_queue *vq)
+{
+	struct isp_stat *stat = vb2_get_drv_priv(vq);
+	struct isp_stat_meta *meta = &stat->meta;
+	struct isp_stat_meta_buffer *mbuf;
+	struct ispstat_buffer *buf;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&stat->isp->slock, flags);
+	meta->streaming = false;
+	isp_stat_meta_return_queued(stat, VB2_BUF_STATE_ERROR);
+	spin_unlock_irqrestore(&stat->isp->slock, flags);
+
+	/* let the hardware finish writing the buffers it has been given */
+	if (stat->state == ISPSTAT_ENABLED &&
+	    !wait_event_timeout(meta->drain_wait, !READ_ONCE(meta->inflight),
+				msecs_to_jiffies(STAT_META_DRAIN_MS)))
+		vin_warn("%s: %u meta buffers still owned by hardware\n",
+			 stat->sd.name, READ_ONCE(meta->inflight));
+
+	spin_lock_irqsave(&stat->isp->slock, flags);
+	for (i = 0; i < stat->buf_cnt; i++) {
+		buf = &stat->buf[i];
+		if (!buf->meta)
+			continue;
+
+		mbuf = isp_stat_meta_buf_unbind(stat, buf);
+		if (buf == stat->active_buf) {
+			if (buf->dma_addr)
+				bsp_isp_set_statistics_addr(stat->isp->id, (dma_addr_t)buf->dma_addr);
+			else
+				stat->active_buf = NULL;
+		}
+		vb2_buffer_done(&mbuf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+	}
+	spin_unlock_irqrestore(&stat->isp->slock, flags);
+
+	vin_log(VIN_LOG_STAT, "%s: meta stream off, %u frames dropped\n",
+		stat->sd.name, meta->dropped);
+}
+
+static const struct vb2_ops isp_stat_meta_qops = {
+	.queue_setup = isp_stat_meta_queue_setup,
+	.buf_prepare = isp_stat_meta_buf_prepare,
+	.buf_queue = isp_stat_meta_buf_queue,
+	.start_streaming = isp_stat_meta_start_streaming,
+	.stop_streaming = isp_stat_meta_stop_streaming,
+	.wait_prepare = vb2_ops_wait_prepare,
+	.wait_finish = vb2_ops_wait_finish,
+};
+
+static int isp_stat_meta_querycap(struct file *file, void *priv,
+				  struct v4l2_capability *cap)
+{
+	struct isp_stat *stat = video_drvdata(file);
+
+	strscpy(cap->driver, "sunxi-vin", sizeof(cap->driver));
+	strscpy(cap->card, stat->sd.name, sizeof(cap->card));
+
+	return 0;
+}
+
+static int isp_stat_meta_enum_fmt(struct file *file, void *priv,
+				  struct v4l2_fmtdesc *f)
+{
+	if (f->index > 0)
+		return -EINVAL;
+
+	f->pixelformat = V4L2_META_FMT_VIN_H3A;
+
+	return 0;
+}
+
+static int isp_stat_meta_g_fmt(struct file *file, void *priv,
+			       struct v4l2_format *f)
+{
+	struct isp_stat *stat = video_drvdata(file);
+
+	f->fmt.meta.dataformat = V4L2_META_FMT_VIN_H3A;
+	f->fmt.meta.buffersize = isp_stat_meta_size(stat);
+
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops isp_stat_meta_ioctl_ops = {
+	.vidioc_querycap = isp_stat_meta_querycap,
+	.vidioc_enum_fmt_meta_cap = isp_stat_meta_enum_fmt,
+	.vidioc_g_fmt_meta_cap = isp_stat_meta_g_fmt,
+	.vidioc_s_fmt_meta_cap = isp_stat_meta_g_fmt,
+	.vidioc_try_fmt_meta_cap = isp_stat_meta_g_fmt,
+	.vidioc_reqbufs = vb2_ioctl_reqbufs,
+	.vidioc_querybuf = vb2_ioctl_querybuf,
+	.vidioc_qbuf = vb2_ioctl_qbuf,
+	.vidioc_dqbuf = vb2_ioctl_dqbuf,
+	.vidioc_expbuf = vb2_ioctl_expbuf,
+	.vidioc_create_bufs = vb2_ioctl_create_bufs,
+	.vidioc_prepare_buf = vb2_ioctl_prepare_buf,
+	.vidioc_streamon = vb2_ioctl_streamon,
+	.vidioc_streamoff = vb2_ioctl_streamoff,
+};
+
+static const struct v4l2_file_operations isp_stat_meta_fops = {
+	.owner = THIS_MODULE,
+	.open = v4l2_fh_open,
+	.release = vb2_fop_release,
+	.poll = vb2_fop_poll,
+	.mmap = vb2_fop_mmap,
+	.unlocked_ioctl = video_ioctl2,
+};
+
+static int h3a_subdev_registered(struct v4l2_subdev *sd)
+{
+	struct isp_stat *stat = v4l2_get_subdevdata(sd);
+	struct isp_stat_meta *meta = &stat->meta;
+	struct video_device *vdev = &meta->vdev;
+	struct vb2_queue *q = &meta->queue;
+	int ret;
+
+	q->type = V4L2_BUF_TYPE_META_CAPTURE;
+	q->io_modes = VB2_MMAP | VB2_DMABUF;
+	q->drv_priv = stat;
+	q->buf_struct_size = sizeof(struct isp_stat_meta_buffer);
+	q->ops = &isp_stat_meta_qops;
+	q->mem_ops = &vb2_dma_contig_memops;
+	q->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+	q->lock = &meta->lock;
+	q->dev = &stat->isp->pdev->dev;
+	ret = vb2_queue_init(q);
+	if (ret) {
+		vin_err("%s: meta vb2_queue_init failed\n", sd->name);
+		return ret;
+	}
+
+	meta->pad.flags = MEDIA_PAD_FL_SINK;
+	ret = media_entity_pads_init(&vdev->entity, 1, &meta->pad);
+	if (ret)
+		return ret;
+
+	snprintf(vdev->name, sizeof(vdev->name), "sunxi_h3a_meta.%u", stat->isp->id);
+	vdev->fops = &isp_stat_meta_fops;
+	vdev->ioctl_ops = &isp_stat_meta_ioctl_ops;
+	vdev->device_caps = V4L2_CAP_META_CAPTURE | V4L2_CAP_STREAMING;
+	vdev->vfl_dir = VFL_DIR_RX;
+	vdev->release = video_device_release_empty;
+	vdev->v4l2_dev = sd->v4l2_dev;
+	vdev->queue = q;
+	vdev->lock = &meta->lock;
+	video_set_drvdata(vdev, stat);
+
+	ret = video_register_device(vdev, VFL_TYPE_VIDEO, -1);
+	if (ret < 0) {
+		vin_err("%s: meta video_register_device failed\n", sd->name);
+		media_entity_cleanup(&vdev->entity);
+		return ret;
+	}
+	vin_log(VIN_LOG_STAT, "%s: statistics meta node %s\n", sd->name,
+		video_device_node_name(vdev));
+
+	return 0;
+}
+
+static void h3a_subdev_unregistered(struct v4l2_subdev *sd)
+{
+	struct isp_stat *stat = v4l2_get_subdevdata(sd);
+	struct video_device *vdev = &stat->meta.vdev;
+
+	if (!video_is_registered(vdev))
+		return;
+
+	video_unregister_device(vdev);
+	media_entity_cleanup(&vdev->entity);
+}
+
+static const struct v4l2_subdev_internal_ops h3a_subdev_internal_ops = {
+	.registered = h3a_subdev_registered,
+	.unregistered = h3a_subdev_unregistered,
+};
+
 static const struct v4l2_subdev_core_ops h3a_subdev_core_ops = {
 	.ioctl = h3a_ioctl,
 #if IS_ENABLED(CONFIG_COMPAT)
@@ -741,8 +1155,12 @@ int vin_isp_h3a_init(struct isp_dev *isp)
 	stat->event_type = V4L2_EVENT_VIN_H3A;
 
 	mutex_init(&stat->ioctl_lock);
+	mutex_init(&stat->meta.lock);
+	INIT_LIST_HEAD(&stat->meta.queued);
+	init_waitqueue_head(&stat->meta.drain_wait);
 
 	v4l2_subdev_init(&stat->sd, &h3a_subdev_ops);
+	stat->sd.internal_ops = &h3a_subdev_internal_ops;
 	snprintf(stat->sd.name, V4L2_SUBDEV_NAME_SIZE, "sunxi_h3a.%u", isp->id);
 	stat->sd.grp_id = VIN_GRP_ID_STAT;
 	stat->sd.flags |= V4L2_SUBDEV_FL_HAS_EVENTS | V4L2_SUBDEV_FL_HAS_DEVNODE;
@@ -762,6 +1180,7 @@ void vin_isp_h3a_cleanup(struct isp_dev *isp)
 
 	media_entity_cleanup(&stat->sd.entity);
 	mutex_destroy(&stat->ioctl_lock);
+	mutex_destroy(&stat->meta.lock);
 	isp_stat_bufs_free(stat);
 }
 #else //CONFIG_ISP_SERVER_MELIS
@@ -933,7 +1352,7 @@ static int isp_stat_buf_process(struct isp_stat *stat, int buf_state)
 		dma_addr = (dma_addr_t)(stat->active_buf->dma_addr);
 		bsp_isp_set_statistics_addr(stat->isp->id, dma_addr);
 		if (bsp_isp_get_irq_status(stat->isp->id, PARA_LOAD_PD)) {
-			stat->active_buf = NULL;
+			isp_stat_active_buf_drop(stat);
 			vin_warn("para_load_pd, set active bufffer failed!\n");
 		} else
 			stat->active_buf->state = ISPSTAT_LOAD_SET;
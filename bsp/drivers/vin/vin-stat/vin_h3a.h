@@ -21,6 +21,7 @@
 #include <linux/types.h>
 #include <media/v4l2-event.h>
 #include <media/v4l2-device.h>
+#include <media/videobuf2-v4l2.h>
 
 #include "../vin-video/vin_video.h"
 
@@ -38,6 +39,15 @@ enum ispstat_buf_state_t {
 	ISPSTAT_READY,
 };
 
+#define STAT_META_DRAIN_MS	200
+
+struct isp_stat_meta_buffer {
+	struct vb2_v4l2_buffer vb;
+	struct list_head list;
+	void *vaddr;
+	dma_addr_t dma_addr;
+};
+
 struct ispstat_buffer {
 	void *virt_addr;
 	void *dma_addr;
@@ -45,6 +55,10 @@ struct ispstat_buffer {
 	u32 frame_number;
 	u8 empty;
 	enum ispstat_buf_state_t state;
+	/* meta capture buffer lent to this slot, own memory saved aside */
+	struct isp_stat_meta_buffer *meta;
+	void *own_virt_addr;
+	void *own_dma_addr;
 };
 
 enum ispstat_state_t {
@@ -52,6 +66,23 @@ enum ispstat_state_t {
 	ISPSTAT_ENABLED,
 };
 
+/*
+ * V4L2 meta capture node: when streaming, the statistics engine writes
+ * straight into the queued vb2 buffers and VIDIOC_VIN_ISP_STAT_REQ is
+ * not served.
+ */
+struct isp_stat_meta {
+	struct video_device vdev;
+	struct vb2_queue queue;
+	struct media_pad pad;
+	struct mutex lock;	/* serialize video node ioctls */
+	struct list_head queued;	/* protected by isp->slock */
+	wait_queue_head_t drain_wait;
+	bool streaming;
+	u32 inflight;
+	u32 dropped;
+};
+
 struct isp_dev;
 
 struct isp_stat {
@@ -75,6 +106,8 @@ struct isp_stat {
 	struct ispstat_buffer buf[STAT_MAX_BUFS];
 	struct ispstat_buffer *active_buf;
 	struct ispstat_buffer *locked_buf;
+
+	struct isp_stat_meta meta;
 };
 
 void isp_stat_load_set(struct isp_stat *stat);
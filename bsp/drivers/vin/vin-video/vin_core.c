@@ -44,6 +44,7 @@
 #include <linux/regulator/consumer.h>
 
 #include "vin_core.h"
+#include "vin_osd.h"
 #include "../vin-cci/cci_helper.h"
 #include "../utility/config.h"
 #include "../modules/sensor/camera_cfg.h"
@@ -2222,6 +2223,7 @@ int sunxi_vin_debug_register_driver(void)
 		vi_debugfs_root = NULL;
 		return -ENODEV;
 	}
+	vin_osd_bench_register(vi_debugfs_root);
 
 	return 0;
 }
@@ -2252,6 +2254,7 @@ void sunxi_vin_debug_unregister_driver(void)
 {
 	if (vi_debugfs_root == NULL)
 		return;
+	vin_osd_bench_unregister();
 #if IS_ENABLED(CONFIG_SUNXI_MPP)
 	debugfs_remove_recursive(vi_node);
 #else
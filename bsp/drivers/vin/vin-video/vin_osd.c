@@ -0,0 +1,516 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * vin_osd.c for vipp overlay bitmap preparation
+ *
+ * The user bitmap is staged in two persistent buffers so that each
+ * update can be compared with the previous one. Only windows whose
+ * pixels or geometry changed are written to the (uncached) vipp mask
+ * buffer and have their luma average recomputed.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "../utility/vin_log.h"
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/bitmap.h>
+
+#include "../utility/vin_os.h"
+#include "vin_video.h"
+#include "vin_osd.h"
+
+/* rgb to yuv matrix of the vipp, Q10 coefficients */
+#define OSD_JC0		306
+#define OSD_JC1		601
+#define OSD_JC2		117
+#define OSD_JC3		(-173)
+#define OSD_JC4		(-339)
+#define OSD_JC5		512
+#define OSD_JC6		512
+#define OSD_JC7		(-429)
+#define OSD_JC8		(-83)
+#define OSD_JC9		0
+#define OSD_JC10	128
+#define OSD_JC11	128
+
+/* per channel partial products (jc * c >> 6), expanded at build time */
+#define OSD_T(c, x)	(((c) * (x)) >> 6)
+#define OSD_T4(c, x)	OSD_T(c, x), OSD_T(c, (x) + 1), OSD_T(c, (x) + 2), OSD_T(c, (x) + 3)
+#define OSD_T16(c, x)	OSD_T4(c, x), OSD_T4(c, (x) + 4), OSD_T4(c, (x) + 8), OSD_T4(c, (x) + 12)
+#define OSD_T64(c, x)	OSD_T16(c, x), OSD_T16(c, (x) + 16), OSD_T16(c, (x) + 32), OSD_T16(c, (x) + 48)
+#define OSD_T256(c)	{ OSD_T64(c, 0), OSD_T64(c, 64), OSD_T64(c, 128), OSD_T64(c, 192) }
+
+static const s16 osd_coef_tab[9][256] = {
+	OSD_T256(OSD_JC0), OSD_T256(OSD_JC1), OSD_T256(OSD_JC2),
+	OSD_T256(OSD_JC3), OSD_T256(OSD_JC4), OSD_T256(OSD_JC5),
+	OSD_T256(OSD_JC6), OSD_T256(OSD_JC7), OSD_T256(OSD_JC8),
+};
+
+static inline u8 vin_osd_luma(u8 r, u8 g, u8 b)
+{
+	u32 y_tmp = ((osd_coef_tab[0][r] + osd_coef_tab[1][g] + osd_coef_tab[2][b]) >> 4) + OSD_JC9;
+
+	return clamp_val(y_tmp, 0, 255);
+}
+
+void vin_osd_rgb_to_yuv(u8 r, u8 g, u8 b, u8 *y, u8 *u, u8 *v)
+{
+	u32 u_tmp, v_tmp;
+
+	*y = vin_osd_luma(r, g, b);
+
+	u_tmp = ((osd_coef_tab[3][r] + osd_coef_tab[4][g] + osd_coef_tab[5][b]) >> 4) + OSD_JC10;
+	*u = clamp_val(u_tmp, 0, 255);
+
+	v_tmp = ((osd_coef_tab[6][r] + osd_coef_tab[7][g] + osd_coef_tab[8][b]) >> 4) + OSD_JC11;
+	*v = clamp_val(v_tmp, 0, 255);
+}
+
+#define OSD_EXPAND5(c)	(((c) << 3) + ((c) >> 2))
+#define OSD_EXPAND4(c)	(((c) << 4) + (c))
+
+/*
+ * Mean luma of the pixels that are at least 80% opaque. The alpha
+ * thresholds below are that percentage in each format's alpha range.
+ */
+static __maybe_unused u8 vin_osd_y_average(const void *src, unsigned int pixels, enum vipp_osd_argb fmt)
+{
+	u32 y_sum = 0, valid_pix = 1;
+	unsigned int j;
+
+	switch (fmt) {
+	case ARGB1555: {
+		const u16 *p = src;
+
+		for (j = 0; j < pixels; j++) {
+			u16 px = p[j];
+
+			if (!(px & 0x8000))
+				continue;
+			y_sum += vin_osd_luma(OSD_EXPAND5((px >> 10) & 0x1f),
+					      OSD_EXPAND5((px >> 5) & 0x1f),
+					      OSD_EXPAND5(px & 0x1f));
+			valid_pix++;
+		}
+		break;
+	}
+	case ARGB4444: {
+		const u16 *p = src;
+
+		for (j = 0; j < pixels; j++) {
+			u16 px = p[j];
+
+			if ((px >> 12) < 12)
+				continue;
+			y_sum += vin_osd_luma(OSD_EXPAND4((px >> 8) & 0x0f),
+					      OSD_EXPAND4((px >> 4) & 0x0f),
+					      OSD_EXPAND4(px & 0x0f));
+			valid_pix++;
+		}
+		break;
+	}
+	default: {
+		const u32 *p = src;
+
+		for (j = 0; j < pixels; j++) {
+			u32 px = p[j];
+
+			if ((px >> 24) < 204)
+				continue;
+			y_sum += vin_osd_luma((px >> 16) & 0xff, (px >> 8) & 0xff, px & 0xff);
+			valid_pix++;
+		}
+		break;
+	}
+	}
+
+	return y_sum / valid_pix;
+}
+
+/* Window offsets in the user bitmap and the left-to-right window order. */
+static void vin_osd_layout(struct vin_osd *osd, unsigned int pix_size)
+{
+	unsigned int offset = 0;
+	int i, j;
+
+	for (i = 0; i < osd->overlay_cnt; i++) {
+		osd->ov_offset[i] = offset;
+		offset += osd->ov_win[i].width * osd->ov_win[i].height * pix_size;
+
+		for (j = i; j > 0 && osd->ov_win[osd->ov_order[j - 1]].left > osd->ov_win[i].left; j--)
+			osd->ov_order[j] = osd->ov_order[j - 1];
+		osd->ov_order[j] = i;
+	}
+
+	/* generation 0 marks a mask buffer with unknown content */
+	if (++osd->layout_gen == 0)
+		osd->layout_gen = 1;
+}
+
+/*
+ * Copy the dirty windows into the mask buffer the vipp will load next.
+ * The vipp on sun8iw12 fetches overlay rows in raster order, windows
+ * sharing a line are packed left to right; later vipps take the user
+ * layout as is.
+ */
+static void vin_osd_render(struct vin_osd *osd, const void *src, unsigned int pix_size)
+{
+	int m = osd->ov_set_cnt % 2;
+	bool full = osd->mask_layout[m] != osd->layout_gen;
+	void *dst = osd->ov_mask[m].vir_addr;
+	int i;
+#if IS_ENABLED(CONFIG_ARCH_SUN8IW12P1)
+	int y, k, y_start = INT_MAX, y_end = INT_MIN;
+
+	for (i = 0; i < osd->overlay_cnt; i++) {
+		y_start = min(y_start, (int)osd->ov_win[i].top);
+		y_end = max(y_end, (int)(osd->ov_win[i].top + osd->ov_win[i].height));
+	}
+
+	for (y = y_start; y < y_end; y++) {
+		for (k = 0; k < osd->overlay_cnt; k++) {
+			struct v4l2_rect *win;
+			unsigned int row;
+
+			i = osd->ov_order[k];
+			win = &osd->ov_win[i];
+			if (y < win->top || y >= win->top + win->height)
+				continue;
+
+			row = win->width * pix_size;
+			if (full || osd->mask_gen[m][i] != osd->ov_gen[i])
+				memcpy(dst, src + osd->ov_offset[i] + (y - win->top) * row, row);
+			dst += row;
+		}
+	}
+
+	for (i = 0; i < osd->overlay_cnt; i++)
+		osd->mask_gen[m][i] = osd->ov_gen[i];
+#else
+	for (i = 0; i < osd->overlay_cnt; i++) {
+		if (!full && osd->mask_gen[m][i] == osd->ov_gen[i])
+			continue;
+		memcpy(dst + osd->ov_offset[i], src + osd->ov_offset[i],
+		       osd->ov_win[i].width * osd->ov_win[i].height * pix_size);
+		osd->mask_gen[m][i] = osd->ov_gen[i];
+	}
+#endif
+	osd->mask_layout[m] = osd->layout_gen;
+}
+
+static int vin_osd_stage_reserve(struct vin_osd *osd, unsigned int len)
+{
+	unsigned int size = PAGE_ALIGN(len);
+	int i;
+
+	if (osd->stage_size >= len)
+		return 0;
+
+	for (i = 0; i < 2; i++) {
+		kvfree(osd->stage[i]);
+		osd->stage[i] = kvmalloc(size, GFP_KERNEL);
+		if (!osd->stage[i]) {
+			vin_err("%s - Alloc of osd stage failed\n", __func__);
+			kvfree(osd->stage[!i]);
+			osd->stage[!i] = NULL;
+			osd->stage_size = 0;
+			return -ENOMEM;
+		}
+	}
+	osd->stage_size = size;
+	osd->stage_valid = 0;
+
+	return 0;
+}
+
+/* Mask buffers only grow, so updates of the same or smaller size reuse them. */
+static int vin_osd_mask_reserve(struct device *dev, struct vin_osd *osd, unsigned int len)
+{
+	int m = osd->ov_set_cnt % 2;
+	struct vin_mm *mask = &osd->ov_mask[m];
+
+	if (mask->phy_addr && mask->size >= len)
+		return 0;
+
+	if (mask->phy_addr) {
+		os_mem_free(dev, mask);
+		mask->phy_addr = NULL;
+	}
+	mask->size = PAGE_ALIGN(len);
+	if (os_mem_alloc(dev, mask) < 0) {
+		vin_err("osd bitmap load addr requset failed!\n");
+		mask->size = 0;
+		return -ENOMEM;
+	}
+	osd->mask_layout[m] = 0;
+
+	return 0;
+}
+
+/*
+ * Load a new overlay bitmap of @len bytes. Windows, chromakey and
+ * overlay_fmt must already be set in @osd; @layout_changed tells that
+ * one of them differs from the previous update.
+ */
+int vin_osd_update(struct device *dev, struct vin_osd *osd,
+		   const void __user *bitmap, unsigned int len, bool layout_changed)
+{
+	DECLARE_BITMAP(dirty, MAX_OVERLAY_NUM + 1);
+	unsigned int pix_size = osd->fmt->depth[0] / 8;
+	int cur = !osd->stage_cur;
+	void *src, *prev;
+	int i, ret;
+
+	ret = vin_osd_stage_reserve(osd, len);
+	if (ret)
+		return ret;
+
+	layout_changed |= !osd->stage_valid;
+	osd->stage_valid = 0;
+
+	src = osd->stage[cur];
+	prev = osd->stage[!cur];
+	if (copy_from_user(src, bitmap, len))
+		return -EFAULT;
+
+	if (layout_changed)
+		vin_osd_layout(osd, pix_size);
+
+	bitmap_zero(dirty, MAX_OVERLAY_NUM + 1);
+	for (i = 0; i < osd->overlay_cnt; i++) {
+		unsigned int size = osd->ov_win[i].width * osd->ov_win[i].height * pix_size;
+
+		if (layout_changed ||
+		    memcmp(src + osd->ov_offset[i], prev + osd->ov_offset[i], size)) {
+			osd->ov_gen[i]++;
+			__set_bit(i, dirty);
+		}
+	}
+
+	osd->ov_set_cnt++;
+	ret = vin_osd_mask_reserve(dev, osd, len);
+	if (ret)
+		return ret;
+
+	vin_osd_render(osd, src, pix_size);
+
+#if IS_ENABLED(CONFIG_ARCH_SUN8IW12P1)
+	for_each_set_bit(i, dirty, osd->overlay_cnt)
+		osd->y_bmp_avp[i] = vin_osd_y_average(src + osd->ov_offset[i],
+				osd->ov_win[i].width * osd->ov_win[i].height,
+				osd->overlay_fmt);
+#endif
+
+	osd->stage_cur = cur;
+	osd->stage_valid = 1;
+	vin_log(VIN_LOG_VIDEO, "osd update %u bytes, %u/%u windows dirty\n",
+		len, bitmap_weight(dirty, MAX_OVERLAY_NUM + 1), osd->overlay_cnt);
+
+	return 0;
+}
+
+void vin_osd_release(struct device *dev, struct vin_osd *osd)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (osd->ov_mask[i].phy_addr) {
+			os_mem_free(dev, &osd->ov_mask[i]);
+			osd->ov_mask[i].phy_addr = NULL;
+			osd->ov_mask[i].size = 0;
+		}
+		osd->mask_layout[i] = 0;
+		kvfree(osd->stage[i]);
+		osd->stage[i] = NULL;
+	}
+	osd->stage_size = 0;
+	osd->stage_valid = 0;
+}
+
+#if IS_ENABLED(CONFIG_VIN_OSD_BENCH) && IS_ENABLED(CONFIG_DEBUG_FS)
+#define OSD_BENCH_W		128
+#define OSD_BENCH_H		64
+#define OSD_BENCH_WINS		min(MAX_OVERLAY_NUM, 16)
+#define OSD_BENCH_LOOPS		16
+
+/* the per pixel conversion the table driven one replaced, kept as reference */
+static void vin_osd_rgb_to_yuv_ref(u8 r, u8 g, u8 b, u8 *y, u8 *u, u8 *v)
+{
+	int jc0	= 0x00000132;
+	int jc1 = 0x00000259;
+	int jc2 = 0x00000075;
+	int jc3 = 0xffffff53;
+	int jc4 = 0xfffffead;
+	int jc5 = 0x00000200;
+	int jc6 = 0x00000200;
+	int jc7 = 0xfffffe53;
+	int jc8 = 0xffffffad;
+	int jc9 = 0x00000000;
+	int jc10 = 0x00000080;
+	int jc11 = 0x00000080;
+	u32 y_tmp, u_tmp, v_tmp;
+
+	y_tmp = (((jc0 * r >> 6) + (jc1 * g >> 6) + (jc2 * b >> 6)) >> 4) + jc9;
+	*y = clamp_val(y_tmp, 0, 255);
+
+	u_tmp = (((jc3 * r >> 6) + (jc4 * g >> 6) + (jc5 * b >> 6)) >> 4) + jc10;
+	*u = clamp_val(u_tmp, 0, 255);
+
+	v_tmp = (((jc6 * r >> 6) + (jc7 * g >> 6) + (jc8 * b >> 6)) >> 4) + jc11;
+	*v = clamp_val(v_tmp, 0, 255);
+}
+
+static u8 vin_osd_y_average_ref(const void *databuf, int bmp_size, enum vipp_osd_argb fmt)
+{
+	u8 alpha, r, g, b, y, u, v;
+	int j, y_sum = 0, bmp, valid_pix = 1;
+
+	for (j = 0; j < bmp_size; j++) {
+		switch (fmt) {
+		case ARGB1555:
+			bmp = *(short *)databuf;
+			alpha = (int)((bmp >> 15) & 0x01) * 100;
+			r = (bmp >> 10) & 0x1f;
+			r = (r << 3) + (r >> 2);
+			g = (bmp >> 5) & 0x1f;
+			g = (g << 3) + (g >> 2);
+			b = bmp & 0x1f;
+			b = (b << 3) + (b >> 2);
+			databuf += 2;
+			break;
+		case ARGB4444:
+			bmp = *(short *)databuf;
+			alpha = (int)((bmp >> 12) & 0x0f) * 100 / 15;
+			r = (bmp >> 8) & 0x0f;
+			r = (r << 4) + r;
+			g = (bmp >> 4) & 0x0f;
+			g = (g << 4) + g;
+			b = bmp & 0x0f;
+			b = (b << 4) + b;
+			databuf += 2;
+			break;
+		default:
+			bmp = *(int *)databuf;
+			alpha = (int)((bmp >> 24) & 0xff) * 100 / 255;
+			r = (bmp >> 16) & 0xff;
+			g = (bmp >> 8) & 0xff;
+			b = bmp & 0xff;
+			databuf += 4;
+			break;
+		}
+		if (alpha >= 80) {
+			vin_osd_rgb_to_yuv_ref(r, g, b, &y, &u, &v);
+			y_sum += y;
+			valid_pix++;
+		}
+	}
+
+	return y_sum / valid_pix;
+}
+
+static int vin_osd_bench_show(struct seq_file *s, void *unused)
+{
+	static const char * const fmt_name[] = { "ARGB1555", "ARGB4444", "ARGB8888" };
+	unsigned int pixels = OSD_BENCH_W * OSD_BENCH_H * OSD_BENCH_WINS;
+	struct vin_osd *osd;
+	u32 *bitmap, *mask;
+	u64 t0, t_ref, t_new, t_full, t_dirty;
+	int fmt, i, n, wins = OSD_BENCH_WINS;
+	u8 ref = 0, new = 0;
+
+	if (!wins) {
+		seq_puts(s, "vipp has no overlay\n");
+		return 0;
+	}
+
+	bitmap = vmalloc(pixels * 4);
+	mask = vmalloc(pixels * 4);
+	osd = kzalloc(sizeof(*osd), GFP_KERNEL);
+	if (!bitmap || !mask || !osd) {
+		vfree(bitmap);
+		vfree(mask);
+		kfree(osd);
+		return -ENOMEM;
+	}
+	for (i = 0; i < pixels; i++)
+		bitmap[i] = (i * 2654435761u) ^ (i << 7);
+
+	seq_printf(s, "luma average, %u pixels x %d loops\n", pixels, OSD_BENCH_LOOPS);
+	for (fmt = ARGB1555; fmt <= ARGB8888; fmt++) {
+		t0 = ktime_get_ns();
+		for (n = 0; n < OSD_BENCH_LOOPS; n++)
+			ref = vin_osd_y_average_ref(bitmap, pixels, fmt);
+		t_ref = ktime_get_ns() - t0;
+
+		t0 = ktime_get_ns();
+		for (n = 0; n < OSD_BENCH_LOOPS; n++)
+			new = vin_osd_y_average(bitmap, pixels, fmt);
+		t_new = ktime_get_ns() - t0;
+
+		seq_printf(s, "%s: ref %llu Mpix/s, table %llu Mpix/s, %s\n", fmt_name[fmt],
+			   div64_u64((u64)pixels * OSD_BENCH_LOOPS * 1000, t_ref ? t_ref : 1),
+			   div64_u64((u64)pixels * OSD_BENCH_LOOPS * 1000, t_new ? t_new : 1),
+			   ref == new ? "match" : "MISMATCH");
+	}
+
+	/* a grid of windows, then the same bitmap with one window changed */
+	osd->overlay_cnt = wins;
+	for (i = 0; i < wins; i++) {
+		osd->ov_win[i].left = (i % 4) * OSD_BENCH_W;
+		osd->ov_win[i].top = (i / 4) * OSD_BENCH_H;
+		osd->ov_win[i].width = OSD_BENCH_W;
+		osd->ov_win[i].height = OSD_BENCH_H;
+	}
+	osd->ov_mask[0].vir_addr = mask;
+	osd->ov_mask[1].vir_addr = mask;
+	vin_osd_layout(osd, 4);
+
+	t0 = ktime_get_ns();
+	for (n = 0; n < OSD_BENCH_LOOPS; n++) {
+		osd->mask_layout[0] = 0;
+		osd->mask_layout[1] = 0;
+		vin_osd_render(osd, bitmap, 4);
+	}
+	t_full = ktime_get_ns() - t0;
+
+	t0 = ktime_get_ns();
+	for (n = 0; n < OSD_BENCH_LOOPS; n++) {
+		osd->ov_gen[n % wins]++;
+		vin_osd_render(osd, bitmap, 4);
+	}
+	t_dirty = ktime_get_ns() - t0;
+
+	seq_printf(s, "render %d windows %dx%d: full %llu us, one dirty %llu us\n",
+		   wins, OSD_BENCH_W, OSD_BENCH_H,
+		   div64_u64(t_full, OSD_BENCH_LOOPS * 1000),
+		   div64_u64(t_dirty, OSD_BENCH_LOOPS * 1000));
+
+	vfree(bitmap);
+	vfree(mask);
+	kfree(osd);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(vin_osd_bench);
+
+static struct dentry *vin_osd_bench_node;
+
+void vin_osd_bench_register(struct dentry *root)
+{
+	vin_osd_bench_node = debugfs_create_file("vi_osd_bench", 0444, root,
+						 NULL, &vin_osd_bench_fops);
+}
+
+void vin_osd_bench_unregister(void)
+{
+	debugfs_remove(vin_osd_bench_node);
+	vin_osd_bench_node = NULL;
+}
+#endif
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * vin_osd.h for vipp overlay bitmap preparation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _VIN_OSD_H_
+#define _VIN_OSD_H_
+
+#include <linux/types.h>
+#include <linux/device.h>
+#include <linux/debugfs.h>
+
+struct vin_osd;
+
+void vin_osd_rgb_to_yuv(u8 r, u8 g, u8 b, u8 *y, u8 *u, u8 *v);
+int vin_osd_update(struct device *dev, struct vin_osd *osd,
+		   const void __user *bitmap, unsigned int len, bool layout_changed);
+void vin_osd_release(struct device *dev, struct vin_osd *osd);
+
+#if IS_ENABLED(CONFIG_VIN_OSD_BENCH) && IS_ENABLED(CONFIG_DEBUG_FS)
+void vin_osd_bench_register(struct dentry *root);
+void vin_osd_bench_unregister(void);
+#else
+static inline void vin_osd_bench_register(struct dentry *root) {}
+static inline void vin_osd_bench_unregister(void) {}
+#endif
+
+#endif /* _VIN_OSD_H_ */
@@ -17,7 +17,6 @@
 #include <linux/videodev2.h>
 #include <linux/string.h>
 #include <linux/freezer.h>
-#include <linux/sort.h>
 #include <linux/platform_device.h>
 #include <linux/interrupt.h>
 #include <linux/i2c.h>
@@ -48,6 +47,7 @@
 #include "../vin-mipi/sunxi_mipi.h"
 #include "../vin-tdm/vin_tdm.h"
 #include "../vin.h"
+#include "vin_osd.h"
 #if IS_ENABLED(CONFIG_ISP_SERVER_MELIS)
 #include "../vin-isp/isp_tuning_priv.h"
 #endif
@@ -1394,196 +1394,20 @@ static int vidioc_try_fmt_vid_overlay(struct file *file, void *__fh,
 	return 0;
 }
 
-void __osd_bitmap2dram(struct vin_osd *osd, void *databuf)
-{
-#if IS_ENABLED(CONFIG_ARCH_SUN8IW12P1)
-	int i, j, k, m = 0, n = 0;
-	int kend = 0, idx = 0, ww = 0, ysn = 0;
-	int y_num = 0, *y_temp = NULL;
-	int *hor_num = NULL, *hor_index = NULL;
-	int *x_temp = NULL, *xbuf = NULL, *x_idx = NULL;
-	int addr_offset = 0, pix_size = osd->fmt->depth[0]/8;
-	int cnt = osd->overlay_cnt;
-	void *dram_addr = osd->ov_mask[osd->ov_set_cnt % 2].vir_addr;
-
-	y_temp = (int *)kzalloc(2 * cnt * sizeof(int), GFP_KERNEL);
-	for (i = 0; i < cnt; i++) {
-		y_temp[i] = osd->ov_win[i].top;
-		y_temp[i + cnt] = osd->ov_win[i].top + osd->ov_win[i].height - 1;
-	}
-	sort(y_temp, 2 * cnt, sizeof(int), vin_cmp, vin_swap);
-	y_num = vin_unique(y_temp, 2 * cnt);
-	hor_num = (int *)kzalloc(y_num * sizeof(int), GFP_KERNEL); /* 0~y_num-1 */
-	hor_index = (int *)kzalloc(y_num * cnt * sizeof(int), GFP_KERNEL); /* (0~y_num-1) * (0~N+1) */
-
-	for (j = 0; j < y_num; j++) {
-		ysn = 0;
-		for (i = 0; i < cnt; i++) {
-			if (osd->ov_win[i].top <= y_temp[j] &&
-			   (osd->ov_win[i].top + osd->ov_win[i].height) > y_temp[j]) {
-				hor_num[j]++;
-				hor_index[j * cnt + ysn] = i;
-				ysn = ysn + 1;
-			}
-		}
-	}
-
-	for (j = 0; j < y_num; j++) {
-		x_temp = (int *)kzalloc(hor_num[j] * sizeof(int), GFP_KERNEL);
-		xbuf = (int *)kzalloc(hor_num[j] * sizeof(int), GFP_KERNEL);
-		x_idx = (int *)kzalloc(hor_num[j] * sizeof(int), GFP_KERNEL);
-		for (k = 0; k < hor_num[j]; k++)
-			x_temp[k] = osd->ov_win[hor_index[j * cnt + k]].left;
-		memcpy(xbuf, x_temp, hor_num[j] * sizeof(int));
-		sort(x_temp, hor_num[j], sizeof(int), vin_cmp, vin_swap);
-
-		for (k = 0; k < hor_num[j]; k++)	{
-			for (m = 0; m < hor_num[j]; m++) {
-				if (x_temp[k] == xbuf[m]) {
-					x_idx[k] = m;
-					break;
-				}
-			}
-		}
-
-		if (j == y_num - 1)
-			kend = y_temp[j];
-		else
-			kend = y_temp[j + 1] - 1;
-		for (k = y_temp[j]; k <= kend; k++) {
-			for (i = 0; i < hor_num[j]; i++)	{
-				idx = hor_index[j * cnt + x_idx[i]];
-				addr_offset = 0;
-				for (n = 0; n < idx; n++)
-					addr_offset +=	(osd->ov_win[n].width * osd->ov_win[n].height) * pix_size;
-				ww = osd->ov_win[idx].width;
-				if (k < (osd->ov_win[idx].top + osd->ov_win[idx].height)) {
-					memcpy(dram_addr, databuf + addr_offset
-						+ ww * (k - osd->ov_win[idx].top) * pix_size,
-						ww * pix_size);
-					dram_addr += ww * pix_size;
-				}
-			}
-		}
-		kfree(x_temp);
-		kfree(xbuf);
-		kfree(x_idx);
-		x_temp = NULL;
-		xbuf = NULL;
-		x_idx = NULL;
-	}
-	kfree(hor_num);
-	kfree(hor_index);
-	kfree(y_temp);
-	y_temp = NULL;
-	hor_index = NULL;
-	hor_num = NULL;
-#else
-	memcpy(osd->ov_mask[osd->ov_set_cnt % 2].vir_addr, databuf, osd->ov_mask[osd->ov_set_cnt % 2].size);
-#endif
-}
-
-static void __osd_rgb_to_yuv(u8 r, u8 g, u8 b, u8 *y, u8 *u, u8 *v)
-{
-	int jc0	= 0x00000132;
-	int jc1 = 0x00000259;
-	int jc2 = 0x00000075;
-	int jc3 = 0xffffff53;
-	int jc4 = 0xfffffead;
-	int jc5 = 0x00000200;
-	int jc6 = 0x00000200;
-	int jc7 = 0xfffffe53;
-	int jc8 = 0xffffffad;
-	int jc9 = 0x00000000;
-	int jc10 = 0x00000080;
-	int jc11 = 0x00000080;
-	u32 y_tmp, u_tmp, v_tmp;
-
-	y_tmp = (((jc0 * r >> 6) + (jc1 * g >> 6) + (jc2 * b >> 6)) >> 4) + jc9;
-	*y = clamp_val(y_tmp, 0, 255);
-
-	u_tmp = (((jc3 * r >> 6) + (jc4 * g >> 6) + (jc5 * b >> 6)) >> 4) + jc10;
-	*u = clamp_val(u_tmp, 0, 255);
-
-	v_tmp = (((jc6 * r >> 6) + (jc7 * g >> 6) + (jc8 * b >> 6)) >> 4) + jc11;
-	*v = clamp_val(v_tmp, 0, 255);
-}
-
-static void __osd_bmp_to_yuv(struct vin_osd *osd, void *databuf)
-{
-#if IS_ENABLED(CONFIG_ARCH_SUN8IW12P1)
-	u8 alpha, r, g, b, y, u, v;
-	int i, j, y_sum, bmp;
-
-	for (i = 0; i < osd->overlay_cnt; i++) {
-		int bmp_size = osd->ov_win[i].height * osd->ov_win[i].width;
-		int valid_pix = 1;
-
-		y_sum = 0;
-		for (j = 0; j < bmp_size; j++) {
-			switch (osd->overlay_fmt) {
-			case 0:
-				bmp = *(short *)databuf;
-				alpha = (int)((bmp >> 15) & 0x01) * 100;
-				r = (bmp >> 10) & 0x1f;
-				r = (r << 3) + (r >> 2);
-				g = (bmp >> 5) & 0x1f;
-				g = (g << 3) + (g >> 2);
-				b = bmp & 0x1f;
-				b = (b << 3) + (b >> 2);
-				databuf += 2;
-				break;
-			case 1:
-				bmp = *(short *)databuf;
-				alpha = (int)((bmp >> 12) & 0x0f) * 100 / 15;
-				r = (bmp >> 8) & 0x0f;
-				r = (r << 4) + r;
-				g = (bmp >> 4) & 0x0f;
-				g = (g << 4) + g;
-				b = bmp & 0x0f;
-				b = (b << 4) + b;
-				databuf += 2;
-				break;
-			case 2:
-				bmp = *(int *)databuf;
-				alpha = (int)((bmp >> 24) & 0xff) * 100 / 255;
-				r = (bmp >> 16) & 0xff;
-				g = (bmp >> 8) & 0xff;
-				b = bmp & 0xff;
-				databuf += 4;
-				break;
-			default:
-				bmp = *(int *)databuf;
-				alpha = (int)((bmp >> 24) & 0xff) * 100 / 255;
-				r = (bmp >> 16) & 0xff;
-				g = (bmp >> 8) & 0xff;
-				b = bmp & 0xff;
-				databuf += 4;
-				break;
-			}
-			if (alpha >= 80) {
-				__osd_rgb_to_yuv(r, g, b, &y, &u, &v);
-				y_sum += y;
-				valid_pix++;
-			}
-		}
-		osd->y_bmp_avp[i] = y_sum / valid_pix;
-	}
-#endif
-}
-
 static int vidioc_s_fmt_vid_overlay(struct file *file, void *__fh,
 					struct v4l2_format *f)
 {
 	struct vin_core *vinc = video_drvdata(file);
 	struct vin_osd *osd = &vinc->vid_cap.osd;
 	struct v4l2_clip *clip = NULL;
-	void *bitmap = NULL;
 	unsigned int bitmap_size = 0, pix_size = 0;
+	bool layout_changed = false;
 	int ret = 0, i = 0;
 
 	__osd_win_check(&f->fmt.win);
 
+	if (osd->chromakey != f->fmt.win.chromakey)
+		layout_changed = true;
 	osd->chromakey = f->fmt.win.chromakey;
 
 	if (f->fmt.win.bitmap) {
@@ -1593,6 +1417,8 @@ static int vidioc_s_fmt_vid_overlay(struct file *file, void *__fh,
 		} else {
 			if (MAX_OVERLAY_NUM) {
 				osd->overlay_en = 1;
+				if (osd->overlay_cnt != f->fmt.win.clipcount)
+					layout_changed = true;
 				osd->overlay_cnt = f->fmt.win.clipcount;
 			} else {
 				osd->overlay_en = 0;
@@ -1617,6 +1443,8 @@ static int vidioc_s_fmt_vid_overlay(struct file *file, void *__fh,
 #endif
 		/* save global alpha in the win top for diff overlay */
 		for (i = 0; i < osd->overlay_cnt; i++) {
+			if (memcmp(&osd->ov_win[i], &clip[i].c, sizeof(clip[i].c)))
+				layout_changed = true;
 			osd->ov_win[i] = clip[i].c;
 			bitmap_size += clip[i].c.width * clip[i].c.height;
 			if (f->fmt.win.global_alpha == 255)
@@ -1638,35 +1466,6 @@ static int vidioc_s_fmt_vid_overlay(struct file *file, void *__fh,
 		}
 		pix_size = osd->fmt->depth[0]/8;
 
-		bitmap = vmalloc(bitmap_size * pix_size);
-		if (bitmap == NULL) {
-			vin_err("%s - Alloc of bitmap buf failed\n", __func__);
-			return -ENOMEM;
-		}
-		if (copy_from_user(bitmap, f->fmt.win.bitmap,
-				bitmap_size * pix_size)) {
-			vfree(bitmap);
-			return -EFAULT;
-		}
-
-		osd->ov_set_cnt++;
-
-		if (osd->ov_mask[osd->ov_set_cnt % 2].size != bitmap_size * pix_size) {
-			if (osd->ov_mask[osd->ov_set_cnt % 2].phy_addr) {
-				os_mem_free(&vinc->pdev->dev, &osd->ov_mask[osd->ov_set_cnt % 2]);
-				osd->ov_mask[osd->ov_set_cnt % 2].phy_addr = NULL;
-			}
-			osd->ov_mask[osd->ov_set_cnt % 2].size = bitmap_size * pix_size;
-			ret = os_mem_alloc(&vinc->pdev->dev, &osd->ov_mask[osd->ov_set_cnt % 2]);
-			if (ret < 0) {
-				vin_err("osd bitmap load addr requset failed!\n");
-				vfree(bitmap);
-				return -ENOMEM;
-			}
-		}
-		memset(osd->ov_mask[osd->ov_set_cnt % 2].vir_addr, 0, bitmap_size * pix_size);
-		__osd_bitmap2dram(osd, bitmap);
-
 		switch (osd->chromakey) {
 		case V4L2_PIX_FMT_RGB555:
 			osd->overlay_fmt = ARGB1555;
@@ -1681,8 +1480,11 @@ static int vidioc_s_fmt_vid_overlay(struct file *file, void *__fh,
 			osd->overlay_fmt = ARGB8888;
 			break;
 		}
-		__osd_bmp_to_yuv(osd, bitmap);
-		vfree(bitmap);
+
+		ret = vin_osd_update(&vinc->pdev->dev, osd, f->fmt.win.bitmap,
+				     bitmap_size * pix_size, layout_changed);
+		if (ret)
+			return ret;
 	} else {
 		if (f->fmt.win.clipcount <= 0) {
 			osd->cover_en = 0;
@@ -1737,7 +1539,7 @@ static int vidioc_s_fmt_vid_overlay(struct file *file, void *__fh,
 				r = (osd->rgb_orl[i] >> 16) & 0xff;
 				g = (osd->rgb_orl[i] >> 8) & 0xff;
 				b = osd->rgb_orl[i] & 0xff;
-				__osd_rgb_to_yuv(r, g, b, &osd->yuv_orl[0][i],
+				vin_osd_rgb_to_yuv(r, g, b, &osd->yuv_orl[0][i],
 					&osd->yuv_orl[1][i], &osd->yuv_orl[2][i]);
 			}
 		}
@@ -1752,7 +1554,7 @@ static int vidioc_s_fmt_vid_overlay(struct file *file, void *__fh,
 				r = (osd->rgb_cover[i] >> 16) & 0xff;
 				g = (osd->rgb_cover[i] >> 8) & 0xff;
 				b = osd->rgb_cover[i] & 0xff;
-				__osd_rgb_to_yuv(r, g, b, &osd->yuv_cover[0][i],
+				vin_osd_rgb_to_yuv(r, g, b, &osd->yuv_cover[0][i],
 					&osd->yuv_cover[1][i], &osd->yuv_cover[2][i]);
 
 			}
@@ -1911,17 +1713,10 @@ static int vidioc_overlay(struct file *file, void *__fh, unsigned int on)
 {
 	struct vin_core *vinc = video_drvdata(file);
 	struct vin_osd *osd = &vinc->vid_cap.osd;
-	int i;
 	int ret = 0;
 
 	if (!on) {
-		for (i = 0; i < 2; i++) {
-			if (osd->ov_mask[i].phy_addr) {
-				os_mem_free(&vinc->pdev->dev, &osd->ov_mask[i]);
-				osd->ov_mask[i].phy_addr = NULL;
-				osd->ov_mask[i].size = 0;
-			}
-		}
+		vin_osd_release(&vinc->pdev->dev, osd);
 		osd->ov_set_cnt = 0;
 		osd->overlay_en = 0;
 		osd->cover_en = 0;
@@ -5058,7 +4853,7 @@ int vin_s_fmt_overlay_special(int id, struct v4l2_format *f)
 				r = (osd->rgb_orl[i] >> 16) & 0xff;
 				g = (osd->rgb_orl[i] >> 8) & 0xff;
 				b = osd->rgb_orl[i] & 0xff;
-				__osd_rgb_to_yuv(r, g, b, &osd->yuv_orl[0][i],
+				vin_osd_rgb_to_yuv(r, g, b, &osd->yuv_orl[0][i],
 					&osd->yuv_orl[1][i], &osd->yuv_orl[2][i]);
 			}
 		}
@@ -5076,17 +4871,10 @@ int vin_overlay_special(int id, unsigned int on)
 {
 	struct vin_core *vinc = vin_core_gbl[id];
 	struct vin_osd *osd = &vinc->vid_cap.osd;
-	int i;
 	int ret = 0;
 
 	if (!on) {
-		for (i = 0; i < 2; i++) {
-			if (osd->ov_mask[i].phy_addr) {
-				os_mem_free(&vinc->pdev->dev, &osd->ov_mask[i]);
-				osd->ov_mask[i].phy_addr = NULL;
-				osd->ov_mask[i].size = 0;
-			}
-		}
+		vin_osd_release(&vinc->pdev->dev, osd);
 		osd->ov_set_cnt = 0;
 		osd->overlay_en = 0;
 		osd->cover_en = 0;
@@ -286,6 +286,17 @@ struct vin_osd {
 	int rgb_cover[MAX_COVER_NUM + 1];
 	int rgb_orl[MAX_ORL_NUM];
 	struct vin_fmt *fmt;
+	/* persistent bitmap staging and dirty tracking, see vin_osd.c */
+	void *stage[2];
+	unsigned int stage_size;
+	u8 stage_cur;
+	u8 stage_valid;
+	u8 ov_order[MAX_OVERLAY_NUM + 1];	/* windows sorted by left */
+	unsigned int ov_offset[MAX_OVERLAY_NUM + 1];	/* window offset in bitmap */
+	u32 ov_gen[MAX_OVERLAY_NUM + 1];
+	u32 mask_gen[2][MAX_OVERLAY_NUM + 1];
+	u32 mask_layout[2];
+	u32 layout_gen;
 };
 
 struct vin_vid_cap {
@@ -327,32 +338,6 @@ struct vin_vid_cap {
 	void (*online_csi_reset_callback)(int id);
 };
 
-#if IS_ENABLED(CONFIG_ARCH_SUN8IW12P1)
-static inline int vin_cmp(const void *a, const void *b)
-{
-	return *(int *)a - *(int *)b;
-}
-
-static inline void vin_swap(void *a, void *b, int size)
-{
-	int t = *(int *)a;
-	*(int *)a = *(int *)b;
-	*(int *)b = t;
-}
-
-static inline int vin_unique(int *a, int number)
-{
-	int i, k = 0;
-
-	for (i = 1; i < number; i++) {
-		if (a[k] != a[i]) {
-			k++;
-			a[k] = a[i];
-		}
-	}
-	return k + 1;
-}
-#endif
 int vin_set_addr(struct vin_core *vinc, struct vb2_buffer *vb,
 		      struct vin_frame *frame, struct vin_addr *paddr);
 int vin_timer_init(struct vin_core *vinc);
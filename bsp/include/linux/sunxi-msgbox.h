@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner msgbox batched transfer interface.
+ *
+ * mbox_send_message() on a msgbox channel moves one u32 per call and waits
+ * for the tx_done of every word. Clients that own a channel and stream
+ * several words, e.g. doorbells carrying a vring index and a payload, can
+ * instead hand the whole run to sunxi_msgbox_send_batch(), which fills the
+ * free FIFO entries in one go.
+ *
+ * This file is licensed under the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+
+#ifndef __SUNXI_MSGBOX_H__
+#define __SUNXI_MSGBOX_H__
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+struct mbox_chan;
+
+#if IS_ENABLED(CONFIG_AW_MSGBOX)
+int sunxi_msgbox_send_batch(struct mbox_chan *chan, const u32 *msg, int count);
+#else
+static inline int sunxi_msgbox_send_batch(struct mbox_chan *chan, const u32 *msg, int count)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* __SUNXI_MSGBOX_H__ */
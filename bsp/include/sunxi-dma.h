@@ -19,6 +19,8 @@
 #ifndef __SUNXI_DMA_H
 #define __SUNXI_DMA_H
 
+#include <linux/errno.h>
+
 typedef void (*sunxi_dma_timeout_callback)(void *param);
 
 struct sunxi_dma_desc {
@@ -30,4 +32,19 @@ struct sunxi_dma_desc {
 	void *callback_param;
 };
 
+struct dma_async_tx_descriptor;
+struct scatterlist;
+
+#if IS_ENABLED(CONFIG_AW_DMA)
+int sunxi_dma_desc_update_sg(struct dma_async_tx_descriptor *tx,
+			     struct scatterlist *sgl, unsigned int sg_len);
+#else
+static inline int sunxi_dma_desc_update_sg(struct dma_async_tx_descriptor *tx,
+					   struct scatterlist *sgl,
+					   unsigned int sg_len)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif
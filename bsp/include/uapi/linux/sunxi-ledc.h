@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/* Copyright(c) 2020 - 2023 Allwinner Technology Co.,Ltd. All rights reserved. */
+/*
+ * Allwinner LEDC frame interface.
+ *
+ * /dev/sunxi-ledc maps SUNXI_LEDC_FRAME_BUFS frame buffers of frame_size
+ * bytes each, back to back from offset 0. A frame holds one 32 bit word
+ * per LED, 0x00GGRRBB, the controller reorders the colors on the wire as
+ * set by its output mode. Fill the buffer returned by
+ * SUNXI_LEDC_IOC_WAIT_FRAME and hand it over with SUNXI_LEDC_IOC_QUEUE_FRAME;
+ * the next frame is started as soon as the current one has shifted out.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ */
+
+#ifndef __UAPI_SUNXI_LEDC_H__
+#define __UAPI_SUNXI_LEDC_H__
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define SUNXI_LEDC_FRAME_BUFS	2
+
+struct sunxi_ledc_frame_info {
+	__u32 led_count;	/* LEDs per frame at most */
+	__u32 frame_size;	/* bytes per buffer, page aligned */
+	__u32 nr_buffers;
+	__u32 reserved;
+	__u64 frames_done;
+	__u64 frames_dropped;
+};
+
+struct sunxi_ledc_frame {
+	__u32 index;		/* buffer, returned by WAIT_FRAME */
+	__u32 length;		/* LEDs to send, QUEUE_FRAME only */
+	__s32 timeout_ms;	/* WAIT_FRAME only, < 0 waits forever */
+	__u32 reserved;
+};
+
+#define SUNXI_LEDC_IOC_MAGIC	0xb9
+#define SUNXI_LEDC_IOC_GET_INFO \
+	_IOR(SUNXI_LEDC_IOC_MAGIC, 0x1, struct sunxi_ledc_frame_info)
+#define SUNXI_LEDC_IOC_WAIT_FRAME \
+	_IOWR(SUNXI_LEDC_IOC_MAGIC, 0x2, struct sunxi_ledc_frame)
+#define SUNXI_LEDC_IOC_QUEUE_FRAME \
+	_IOW(SUNXI_LEDC_IOC_MAGIC, 0x3, struct sunxi_ledc_frame)
+
+#endif /* __UAPI_SUNXI_LEDC_H__ */
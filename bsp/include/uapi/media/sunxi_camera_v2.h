@@ -624,6 +624,16 @@ struct vin_vsync_event_data {
 #define VIDIOC_VIN_ISP_STAT_EN \
 	_IOWR('V', BASE_VIDIOC_PRIVATE + 33, unsigned int)
 
+/*
+ * Statistics meta capture node
+ *
+ * The same data returned by VIDIOC_VIN_ISP_STAT_REQ, delivered as
+ * V4L2_BUF_TYPE_META_CAPTURE buffers. The buffer sequence is the
+ * statistics frame number. While the node is streaming,
+ * VIDIOC_VIN_ISP_STAT_REQ returns -EBUSY.
+ */
+#define V4L2_META_FMT_VIN_H3A	v4l2_fourcc('A', 'W', 'H', '3')
+
 /*
 * large image dma merge mode
 *
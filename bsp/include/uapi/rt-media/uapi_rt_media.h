@@ -184,6 +184,11 @@ enum RT_MEDIA_IOCTL_CMD {
 	IOCTL_SET_TDM_DROP_FRAME,
 	IOCTL_SET_INPUT_BIT_WIDTH_START,
 	IOCTL_SET_INPUT_BIT_WIDTH_STOP,
+
+	IOCTL_GET_STREAM_DATA_BATCH,
+	IOCTL_RETURN_STREAM_DATA_BATCH,
+	IOCTL_SET_STREAM_EVENTFD,
+	IOCTL_CATCH_JPEG_GET_DMABUF,
 };
 
 typedef struct KERNEL_VBV_BUFFER_INFO{
@@ -219,6 +224,57 @@ typedef struct video_stream_s{
 } video_stream_s;
 typedef video_stream_s STREAM_DATA_INFO;
 
+/*
+ * IOCTL_GET_STREAM_DATA_BATCH: num is the capacity of stream[] on input and
+ * the number of frames dequeued on output. If no frame is ready, wait up to
+ * timeout_ms (0 means return immediately with num = 0).
+ * IOCTL_RETURN_STREAM_DATA_BATCH: return the first num entries of stream[],
+ * in the order they were dequeued. When the stream ring is mapped, stream[]
+ * is ignored and the num oldest published frames are returned.
+ */
+#define RT_STREAM_BATCH_MAX_NUM (16)
+
+typedef struct video_stream_batch_s {
+	unsigned int num;
+	unsigned int timeout_ms;
+	video_stream_s stream[RT_STREAM_BATCH_MAX_NUM];
+} video_stream_batch_s;
+
+/*
+ * Bitstream descriptor ring, mapped by mmap() at offset 0 of a configured
+ * stream channel. The kernel publishes one entry per encoded frame and bumps
+ * head; offsetN index into the vbv buffer (see IOCTL_GET_VBV_BUFFER_INFO).
+ * The caller consumes entries from rd to head, stores the new rd, and hands
+ * the frames back with IOCTL_RETURN_STREAM_DATA_BATCH, after which done is
+ * advanced. poll() reports POLLIN while head != rd.
+ */
+#define RT_STREAM_RING_MAGIC (0x52545352) /* "RTSR" */
+#define RT_STREAM_RING_ENTRY_NUM (64) /* power of 2 */
+
+typedef struct rt_stream_ring_entry {
+	int id;
+	unsigned int flag;
+	uint64_t pts;
+	unsigned int size0;
+	unsigned int size1;
+	unsigned int size2;
+	unsigned int offset0;
+	unsigned int offset1;
+	unsigned int offset2;
+	int keyframe_flag;
+	unsigned int reserved;
+} rt_stream_ring_entry;
+
+typedef struct rt_stream_ring {
+	unsigned int magic;
+	unsigned int entry_num;
+	unsigned int head; /* written by kernel */
+	unsigned int done; /* written by kernel */
+	unsigned int rd;   /* written by caller */
+	unsigned int reserved[11];
+	rt_stream_ring_entry entry[RT_STREAM_RING_ENTRY_NUM];
+} rt_stream_ring;
+
 /* overlay related */
 #define MAX_OVERLAY_ITEM_SIZE  (64)
 
@@ -278,6 +334,12 @@ typedef struct catch_jpeg_buf_info {
 	unsigned char *buf;
 } catch_jpeg_buf_info;
 
+typedef struct catch_jpeg_dmabuf_info {
+	int fd;               // return dma-buf fd, owned by the caller
+	unsigned int size;    // return valid jpeg size
+	unsigned int buf_size; // return size of the dma-buf
+} catch_jpeg_dmabuf_info;
+
 //typedef struct VideoGetBinImageBufInfo {
 //	unsigned int   max_size;
 //	unsigned char  *buf;